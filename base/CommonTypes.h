@@ -1,5 +1,6 @@
 #pragma once
 #include "GlobalConfigs.h"
+#include "SurfelTypes.h"
 #include <base/DeviceAPI/convenience.cuh>
 #include <base/DeviceAPI/device_array.hpp>
 #include <base/DeviceAPI/kernel_containers.hpp>
@@ -91,32 +92,6 @@ namespace SparseSurfelFusion {
 	//向上取整函数，算网格数量的，同convenience.cuh中的getGridDim()函数
 	using pcl::gpu::divUp;
 
-	/**
-	 * \brief 辅助结构体记录像素.
-	 */
-	struct PixelCoordinate {
-		unsigned int row;	// 图像的高，像素点y坐标
-		unsigned int col;	// 图像的宽，像素点x坐标
-		__host__ __device__ PixelCoordinate() : row(0), col(0) {}
-		__host__ __device__ PixelCoordinate(const unsigned row_, const unsigned col_)
-			: row(row_), col(col_) {}
-
-		__host__ __device__ const unsigned int& x() const { return col; }
-		__host__ __device__ const unsigned int& y() const { return row; }
-		__host__ __device__ unsigned int& x() { return col; }
-		__host__ __device__ unsigned int& y() { return row; }
-	};
-
-	/**
-	 * \brief 从深度图像构建的surfel结构应该在设备上访问.
-	 */
-	struct DepthSurfel {
-		PixelCoordinate pixelCoordinate;	// pixelCoordinate面元来自哪里
-		float4 VertexAndConfidence;			// VertexAndConfidence (x, y, z)为相机帧中的位置，(w)为置信度值。
-		float4 NormalAndRadius;				// NormalAndRadius (x, y, z)是归一化法线方向，w是半径
-		float4 ColorAndTime;				// ColorAndTime (x, y, z)是浮点编码的RGB值;
-	};
-
 	struct KNNAndWeight {
 		ushort4 knn;		// 临近4个点的ID
 		float4 weight;		// 临近4个点的权重
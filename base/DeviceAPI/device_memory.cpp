@@ -37,6 +37,7 @@
 #include "device_memory.hpp"
 #include "convenience.cuh"
 #include "safe_call.hpp"
+#include "device_memory_pool.h"
 
 #include "cuda_runtime_api.h"
 #include "assert.h"
@@ -113,7 +114,7 @@ void DeviceMemory::create(size_t sizeBytes_arg)
 
         sizeBytes_ = sizeBytes_arg;
                         
-        cudaSafeCall( cudaMalloc(&data_, sizeBytes_) );        
+        data_ = SparseSurfelFusion::DeviceMemoryPool::Allocate(sizeBytes_);
 
         refcount_ = new int;
         *refcount_ = 1;
@@ -137,7 +138,7 @@ void DeviceMemory::release()
     if( refcount_ && CV_XADD(refcount_, -1) == 1 )
     {
         delete refcount_;
-        CHECKCUDA( cudaFree(data_) );
+        SparseSurfelFusion::DeviceMemoryPool::Release(data_);
     }
     data_ = 0;
     sizeBytes_ = 0;
@@ -0,0 +1,187 @@
+/*****************************************************************//**
+ * \file   device_memory_pool.cpp
+ * \brief  进程级显存池实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "device_memory_pool.h"
+#include <algorithm>
+
+namespace {
+	thread_local SparseSurfelFusion::MemoryPoolTag currentTag = SparseSurfelFusion::MemoryPoolTag::Other;	// 本线程当前的模块
+}
+
+std::mutex SparseSurfelFusion::DeviceMemoryPool::recordMutex;
+
+const char* SparseSurfelFusion::MemoryPoolTagName(const MemoryPoolTag tag)
+{
+	switch (tag) {
+	case MemoryPoolTag::Octree:			return "octree";
+	case MemoryPoolTag::VectorField:	return "vector_field";
+	case MemoryPoolTag::Divergence:		return "divergence";
+	case MemoryPoolTag::Solver:			return "solver";
+	case MemoryPoolTag::Geometry:		return "geometry";
+	case MemoryPoolTag::Triangulation:	return "triangulation";
+	case MemoryPoolTag::Render:			return "render";
+	case MemoryPoolTag::Input:			return "input";
+	default:							return "other";
+	}
+}
+
+SparseSurfelFusion::MemoryPoolTagScope::MemoryPoolTagScope(const MemoryPoolTag tag) : previous(currentTag)
+{
+	currentTag = tag;
+}
+
+SparseSurfelFusion::MemoryPoolTagScope::~MemoryPoolTagScope()
+{
+	currentTag = previous;
+}
+
+SparseSurfelFusion::MemoryPoolTag SparseSurfelFusion::MemoryPoolTagScope::Current()
+{
+	return currentTag;
+}
+
+std::unordered_map<void*, SparseSurfelFusion::DeviceMemoryPool::AllocationRecord>& SparseSurfelFusion::DeviceMemoryPool::allocations()
+{
+	static std::unordered_map<void*, AllocationRecord>* records = new std::unordered_map<void*, AllocationRecord>();	// 不在静态析构时销毁，全局DeviceArray可能晚于它释放
+	return *records;
+}
+
+SparseSurfelFusion::DeviceMemoryPool& SparseSurfelFusion::DeviceMemoryPool::Instance(const int deviceId)
+{
+	// 池随进程存在，不在静态析构时销毁(此时CUDA上下文可能已经释放)，由驱动在进程退出时回收
+	static std::mutex instanceMutex;
+	static DeviceMemoryPool* instances[MAX_RECONSTRUCTION_DEVICES] = { NULL };
+	int device = deviceId;
+	if (device < 0) CHECKCUDA(cudaGetDevice(&device));
+	if (device >= MAX_RECONSTRUCTION_DEVICES) LOGGING(FATAL) << "DeviceMemoryPool: 设备号 " << device << " 超出MAX_RECONSTRUCTION_DEVICES";
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	if (instances[device] == NULL) instances[device] = new DeviceMemoryPool(device);
+	return *instances[device];
+}
+
+SparseSurfelFusion::DeviceMemoryPool::DeviceMemoryPool(const int device) : deviceId(device)
+{
+	int poolsSupported = 0;
+	CHECKCUDA(cudaDeviceGetAttribute(&poolsSupported, cudaDevAttrMemoryPoolsSupported, deviceId));
+	supported = poolsSupported != 0;
+	if (!supported) return;
+
+	int previousDevice = 0;
+	CHECKCUDA(cudaGetDevice(&previousDevice));
+	CHECKCUDA(cudaSetDevice(deviceId));
+	cudaMemPoolProps props = {};
+	props.allocType = cudaMemAllocationTypePinned;
+	props.location.type = cudaMemLocationTypeDevice;
+	props.location.id = deviceId;
+	CHECKCUDA(cudaMemPoolCreate(&pool, &props));
+	CHECKCUDA(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+	unsigned long long threshold = releaseThreshold;
+	CHECKCUDA(cudaMemPoolSetAttribute(pool, cudaMemPoolAttrReleaseThreshold, &threshold));
+	CHECKCUDA(cudaSetDevice(previousDevice));
+}
+
+void* SparseSurfelFusion::DeviceMemoryPool::Allocate(const size_t bytes)
+{
+	if (bytes == 0) return NULL;
+	int device = 0;
+	CHECKCUDA(cudaGetDevice(&device));
+	DeviceMemoryPool& instance = Instance(device);
+	void* ptr = NULL;
+	if (instance.supported) {
+		// 在池的流上按流序开辟后立即同步，之后任意流都可以使用
+		CHECKCUDA(cudaMallocFromPoolAsync(&ptr, bytes, instance.pool, instance.stream));
+		CHECKCUDA(cudaStreamSynchronize(instance.stream));
+	}
+	else {
+		CHECKCUDA(cudaMalloc(&ptr, bytes));
+	}
+
+	const MemoryPoolTag tag = currentTag;
+	const int tagIndex = (int)tag;
+	std::lock_guard<std::mutex> lock(recordMutex);
+	AllocationRecord& record = allocations()[ptr];
+	record.deviceId = device;
+	record.bytes = bytes;
+	record.tag = tag;
+	MemoryPoolStatistics& statistics = instance.statistics;
+	statistics.currentBytes += bytes;
+	statistics.tagCurrentBytes[tagIndex] += bytes;
+	statistics.peakBytes = std::max(statistics.peakBytes, statistics.currentBytes);
+	statistics.tagPeakBytes[tagIndex] = std::max(statistics.tagPeakBytes[tagIndex], statistics.tagCurrentBytes[tagIndex]);
+	statistics.allocationCount++;
+	return ptr;
+}
+
+void SparseSurfelFusion::DeviceMemoryPool::Release(void* ptr)
+{
+	if (ptr == NULL) return;
+	AllocationRecord record;
+	{
+		std::lock_guard<std::mutex> lock(recordMutex);
+		auto it = allocations().find(ptr);
+		if (it == allocations().end()) LOGGING(FATAL) << "DeviceMemoryPool: 释放的地址不是由显存池开辟的";
+		record = it->second;
+		allocations().erase(it);
+		MemoryPoolStatistics& statistics = Instance(record.deviceId).statistics;
+		statistics.currentBytes -= record.bytes;
+		statistics.tagCurrentBytes[(int)record.tag] -= record.bytes;
+	}
+
+	DeviceMemoryPool& instance = Instance(record.deviceId);
+	if (!instance.supported) {
+		CHECKCUDA(cudaFree(ptr));
+		return;
+	}
+	int previousDevice = 0;
+	CHECKCUDA(cudaGetDevice(&previousDevice));
+	if (previousDevice != record.deviceId) CHECKCUDA(cudaSetDevice(record.deviceId));
+	// 与cudaFree相同，先等待设备上已提交的任务完成，归还池的显存不会再被正在执行的核函数访问
+	CHECKCUDA(cudaDeviceSynchronize());
+	CHECKCUDA(cudaFreeAsync(ptr, instance.stream));
+	if (previousDevice != record.deviceId) CHECKCUDA(cudaSetDevice(previousDevice));
+}
+
+void SparseSurfelFusion::DeviceMemoryPool::SetReleaseThreshold(const size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(recordMutex);
+	releaseThreshold = thresholdConfigured ? std::max(releaseThreshold, bytes) : bytes;
+	thresholdConfigured = true;
+	if (!supported) return;
+	unsigned long long threshold = releaseThreshold;
+	CHECKCUDA(cudaMemPoolSetAttribute(pool, cudaMemPoolAttrReleaseThreshold, &threshold));
+}
+
+void SparseSurfelFusion::DeviceMemoryPool::TrimTo(const size_t minBytesToKeep)
+{
+	if (!supported) return;
+	CHECKCUDA(cudaMemPoolTrimTo(pool, minBytesToKeep));
+}
+
+SparseSurfelFusion::MemoryPoolStatistics SparseSurfelFusion::DeviceMemoryPool::GetStatistics()
+{
+	unsigned long long reserved = 0, reservedHigh = 0;
+	if (supported) {
+		CHECKCUDA(cudaMemPoolGetAttribute(pool, cudaMemPoolAttrReservedMemCurrent, &reserved));
+		CHECKCUDA(cudaMemPoolGetAttribute(pool, cudaMemPoolAttrReservedMemHigh, &reservedHigh));
+	}
+	std::lock_guard<std::mutex> lock(recordMutex);
+	MemoryPoolStatistics result = statistics;
+	result.reservedBytes = supported ? reserved : statistics.currentBytes;
+	result.reservedPeakBytes = supported ? reservedHigh : statistics.peakBytes;
+	return result;
+}
+
+void SparseSurfelFusion::DeviceMemoryPool::ResetPeak()
+{
+	if (supported) {
+		unsigned long long zero = 0;	// 驱动只接受0，表示重置为当前值
+		CHECKCUDA(cudaMemPoolSetAttribute(pool, cudaMemPoolAttrReservedMemHigh, &zero));
+	}
+	std::lock_guard<std::mutex> lock(recordMutex);
+	statistics.peakBytes = statistics.currentBytes;
+	for (int i = 0; i < (int)MemoryPoolTag::TagNum; i++) statistics.tagPeakBytes[i] = statistics.tagCurrentBytes[i];
+}
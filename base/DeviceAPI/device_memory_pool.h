@@ -0,0 +1,162 @@
+/*****************************************************************//**
+ * \file   device_memory_pool.h
+ * \brief  进程级显存池：DeviceArray/DeviceBufferArray的显存都从每个设备一个的显式cudaMemPool_t中分配，
+ *         释放阈值可配置，按模块统计当前与峰值占用
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+#include <cuda_runtime_api.h>
+#include <base/Logging.h>
+#include <base/GlobalConfigs.h>
+#include <base/DeviceAPI/safe_call.hpp>
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 显存所属的模块，用于分模块统计.
+	 */
+	enum class MemoryPoolTag {
+		Other = 0,			// 未标记
+		Octree,				// 八叉树构建
+		VectorField,		// 向量场与点积表
+		Divergence,			// 散度
+		Solver,				// 拉普拉斯求解
+		Geometry,			// 顶点、边、面
+		Triangulation,		// 三角剖分与细分
+		Render,				// 绘制
+		Input,				// 输入点云与法线
+		TagNum				// 模块数量
+	};
+
+	/**
+	 * \brief 模块名称，用于输出统计.
+	 */
+	const char* MemoryPoolTagName(const MemoryPoolTag tag);
+
+	/**
+	 * \brief 显存池统计.
+	 */
+	struct MemoryPoolStatistics {
+		size_t currentBytes = 0;										// 当前被持有的字节数
+		size_t peakBytes = 0;											// 持有字节数的峰值
+		unsigned long long allocationCount = 0;							// 累计分配次数
+		size_t tagCurrentBytes[(int)MemoryPoolTag::TagNum] = { 0 };		// 各模块当前持有的字节数
+		size_t tagPeakBytes[(int)MemoryPoolTag::TagNum] = { 0 };		// 各模块持有字节数的峰值
+		size_t reservedBytes = 0;										// 池从驱动取得的显存(含已归还池但未释放给驱动的部分)
+		size_t reservedPeakBytes = 0;									// 池从驱动取得的显存峰值
+	};
+
+	/**
+	 * \brief 在作用域内把本线程之后的显存分配记在tag名下，作用域结束时恢复之前的模块，可嵌套.
+	 */
+	class MemoryPoolTagScope {
+	public:
+		explicit MemoryPoolTagScope(const MemoryPoolTag tag);
+		~MemoryPoolTagScope();
+
+		/**
+		 * \brief 本线程当前的模块.
+		 */
+		static MemoryPoolTag Current();
+
+	private:
+		MemoryPoolTagScope(const MemoryPoolTagScope&) = delete;
+		MemoryPoolTagScope& operator=(const MemoryPoolTagScope&) = delete;
+
+		MemoryPoolTag previous;		// 进入作用域之前的模块
+	};
+
+	/**
+	 * \brief 显存池外观：DeviceMemory::create/release(即DeviceArray与DeviceBufferArray的开辟与释放)都经由这里.
+	 *        默认池的释放阈值为0，同步点之后空闲显存会归还驱动；本池默认保留全部空闲显存，
+	 *        缓存扩容时释放的旧缓存留在池中供之后的开辟复用，稳态帧不再向驱动申请显存.
+	 *        开辟与释放的同步语义与cudaMalloc/cudaFree相同：返回后显存即可在任意流上使用，释放前等待设备上已提交的任务完成.
+	 *        每个设备一个实例，进程内共享，线程安全；设备不支持显存池时退回cudaMalloc/cudaFree，只做统计.
+	 */
+	class DeviceMemoryPool
+	{
+	public:
+		/**
+		 * \brief 取得设备的显存池，首次调用时创建.
+		 *
+		 * \param deviceId 设备号，-1表示当前设备
+		 * \return 显存池
+		 */
+		static DeviceMemoryPool& Instance(const int deviceId = -1);
+
+		/**
+		 * \brief 在当前设备上开辟显存，记在本线程当前的模块名下.
+		 *
+		 * \param bytes 字节数
+		 * \return 显存地址，bytes为0时返回NULL
+		 */
+		static void* Allocate(const size_t bytes);
+
+		/**
+		 * \brief 释放Allocate开辟的显存，可在任意设备为当前设备时调用.
+		 *
+		 * \param ptr Allocate返回的地址，NULL直接返回
+		 */
+		static void Release(void* ptr);
+
+		/**
+		 * \brief 设置释放阈值：池中空闲显存超过该值时，同步点会把多出的部分归还驱动.
+		 *        同一设备上的多个实例共用一个池，取各次设置的最大值，后构造的实例不会让先前实例的显存被归还.
+		 *
+		 * \param bytes 阈值(字节)，SIZE_MAX表示从不归还
+		 */
+		void SetReleaseThreshold(const size_t bytes);
+
+		/**
+		 * \brief 把池中空闲显存归还驱动，至多保留minBytesToKeep字节.
+		 */
+		void TrimTo(const size_t minBytesToKeep);
+
+		/**
+		 * \brief 获得统计.
+		 */
+		MemoryPoolStatistics GetStatistics();
+
+		/**
+		 * \brief 把各峰值重置为当前值.
+		 */
+		void ResetPeak();
+
+	private:
+		/**
+		 * \brief 创建设备deviceId上的池.
+		 */
+		explicit DeviceMemoryPool(const int deviceId);
+
+		DeviceMemoryPool(const DeviceMemoryPool&) = delete;
+		DeviceMemoryPool& operator=(const DeviceMemoryPool&) = delete;
+
+		/**
+		 * \brief 一次开辟的记录.
+		 */
+		struct AllocationRecord {
+			int deviceId = 0;
+			size_t bytes = 0;
+			MemoryPoolTag tag = MemoryPoolTag::Other;
+		};
+
+		/**
+		 * \brief 尚未释放的开辟，所有设备共用，释放时由地址找到所属的池.
+		 */
+		static std::unordered_map<void*, AllocationRecord>& allocations();
+
+		static std::mutex recordMutex;									// 保护allocations与各池的统计
+
+		int deviceId = 0;												// 池所在的设备
+		bool supported = false;											// 设备是否支持显存池
+		cudaMemPool_t pool = NULL;										// 显式创建的池
+		cudaStream_t stream = NULL;										// 开辟与释放所在的流，开辟后立即同步
+		bool thresholdConfigured = false;								// 是否已由SetReleaseThreshold设置过
+		size_t releaseThreshold = SIZE_MAX;								// 当前的释放阈值
+		MemoryPoolStatistics statistics;								// 统计(不含reserved两项，查询时从池读取)
+	};
+}
@@ -1,9 +1,31 @@
 #pragma once
 
-//#define CHECK_MESH_BUILD_TIME_COST	// 查看网格重建过程中每个步骤时间消耗
+//#define CHECK_MESH_BUILD_TIME_COST	// 调试用：逐步骤同步流并打印耗时(会改变被测的并发)，运行时计时请使用PoissonReconstruction::SetProfiling
 
 #define CUB_IGNORE_DEPRECATED_API
 
+#ifndef RECONSTRUCTION_WITH_RENDER
+#define RECONSTRUCTION_WITH_RENDER 1	// 是否编译OpenGL绘制(DrawMesh、render/)，无窗口的poissongpu库为0
+#endif // !RECONSTRUCTION_WITH_RENDER
+
+#ifndef RECONSTRUCTION_WITH_PCL_IO
+#define RECONSTRUCTION_WITH_PCL_IO 1	// 是否编译PCL文件读写、CPU法线估计与PCL可视化，无窗口的poissongpu库为0
+#endif // !RECONSTRUCTION_WITH_PCL_IO
+
+#ifndef RECONSTRUCTION_WITH_CUDA	// CMake在BUILD_CUDA_BACKEND关闭时定义为0，直接用编译器编译时按能否找到CUDA头文件决定
+#if defined(__CUDACC__)
+#define RECONSTRUCTION_WITH_CUDA 1
+#elif defined(__has_include)
+#if __has_include(<cuda_runtime_api.h>)
+#define RECONSTRUCTION_WITH_CUDA 1
+#else
+#define RECONSTRUCTION_WITH_CUDA 0
+#endif
+#else
+#define RECONSTRUCTION_WITH_CUDA 1
+#endif
+#endif // !RECONSTRUCTION_WITH_CUDA
+
 #define MAX_SURFEL_COUNT 300000			// 最大面元个数
 #define MAX_MESH_TRIANGLE_COUNT 1000000	// 最大网格三角形数量
 
@@ -31,10 +53,17 @@
 
 #define MAX_THREADS 10
 
-#define MAX_DEPTH_OCTREE 7	// octree最大深度
+#ifndef MAX_DEPTH_OCTREE	// 允许由编译选项覆盖(如基准测试按深度分别编译)
+#define MAX_DEPTH_OCTREE 7	// octree最大深度，超过10层时节点key为64位
+#endif // !MAX_DEPTH_OCTREE
+
+#define OCTREE_CODE_SHIFT ((MAX_DEPTH_OCTREE) > 10 ? (63 - 3 * (MAX_DEPTH_OCTREE)) : 32)	// 稠密点64位排序编码中八叉树编码的起始位，低位记录稠密点index
+#define OCTREE_INDEX_MASK ((1ll << OCTREE_CODE_SHIFT) - 1)								// 稠密点64位排序编码中稠密点index的掩码
 
 #define MAX_MESH_STREAM 5	// 最大执行mesh任务的cuda流数量
 
+#define MAX_RECONSTRUCTION_DEVICES 8	// 多GPU重建支持的最大设备数量
+
 #define F_DATA_RES ((1 << (MAX_DEPTH_OCTREE + 1)) - 1)					// 2^(maxDepth + 1) - 1
 #define F_DATA_RES_SQUARE F_DATA_RES * F_DATA_RES						// 2047^2
 
@@ -0,0 +1,52 @@
+/*****************************************************************//**
+ * \file   HostDeviceCompat.h
+ * \brief  host/device共用头文件的CUDA依赖：RECONSTRUCTION_WITH_CUDA为1时使用CUDA的函数修饰符与向量类型，
+ *         为0时(只编译CPU后端)定义为空的修饰符与布局相同的Host端向量类型，几何、多项式等头文件不再需要CUDA工具链
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include "GlobalConfigs.h"
+
+#if RECONSTRUCTION_WITH_CUDA
+#include <cuda_runtime_api.h>
+#include <device_launch_parameters.h>
+#include <vector_functions.h>
+#else
+#ifndef __host__
+#define __host__
+#endif // !__host__
+#ifndef __device__
+#define __device__
+#endif // !__device__
+#ifndef __forceinline__
+#define __forceinline__ inline
+#endif // !__forceinline__
+
+/**
+ * \brief 与CUDA的float3布局一致.
+ */
+struct float3 {
+	float x, y, z;
+};
+
+/**
+ * \brief 与CUDA的float4布局一致(16字节对齐)，DepthSurfel等结构体在两种编译下大小相同.
+ */
+struct alignas(16) float4 {
+	float x, y, z, w;
+};
+
+inline float3 make_float3(const float x, const float y, const float z)
+{
+	float3 result = { x, y, z };
+	return result;
+}
+
+inline float4 make_float4(const float x, const float y, const float z, const float w)
+{
+	float4 result = { x, y, z, w };
+	return result;
+}
+#endif // RECONSTRUCTION_WITH_CUDA
@@ -0,0 +1,37 @@
+/*****************************************************************//**
+ * \file   SurfelTypes.h
+ * \brief  输入面元类型：GPU与CPU后端共用，只依赖HostDeviceCompat.h，可在没有CUDA工具链时编译
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include "HostDeviceCompat.h"
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 辅助结构体记录像素.
+	 */
+	struct PixelCoordinate {
+		unsigned int row;	// 图像的高，像素点y坐标
+		unsigned int col;	// 图像的宽，像素点x坐标
+		__host__ __device__ PixelCoordinate() : row(0), col(0) {}
+		__host__ __device__ PixelCoordinate(const unsigned row_, const unsigned col_)
+			: row(row_), col(col_) {}
+
+		__host__ __device__ const unsigned int& x() const { return col; }
+		__host__ __device__ const unsigned int& y() const { return row; }
+		__host__ __device__ unsigned int& x() { return col; }
+		__host__ __device__ unsigned int& y() { return row; }
+	};
+
+	/**
+	 * \brief 从深度图像构建的surfel结构应该在设备上访问.
+	 */
+	struct DepthSurfel {
+		PixelCoordinate pixelCoordinate;	// pixelCoordinate面元来自哪里
+		float4 VertexAndConfidence;			// VertexAndConfidence (x, y, z)为相机帧中的位置，(w)为置信度值。
+		float4 NormalAndRadius;				// NormalAndRadius (x, y, z)是归一化法线方向，w是半径
+		float4 ColorAndTime;				// ColorAndTime (x, y, z)是浮点编码的RGB值;
+	};
+}
@@ -1,139 +1,129 @@
 ﻿/*****************************************************************//**
  * \file   ThreadPool.h
- * \brief  构建任务线程池
+ * \brief  构建任务线程池：每个工作线程一组按优先级划分的双端队列，空闲线程从其他线程的队列窃取任务
  * 
  * \author LUO
  * \date   January 18th 2024
  *********************************************************************/
 #pragma once
 #include <iostream>
+#include <algorithm>
 #include <functional>
 #include <mutex>
 #include <vector>
-#include <queue>
+#include <deque>
+#include <memory>
+#include <atomic>
 #include <thread>
 #include <condition_variable>
 #include <future>
 #include "Logging.h"
 
 /**
- * \brief 为了防止多个线程同时访问队列，因此封装的安全队列对象.
+ * \brief 任务优先级，空闲线程总是先取(或窃取)高优先级的任务.
  */
-template <typename T>
-class SafeQueue
+enum class TaskPriority {
+	High = 0,		// 关键路径上的CPU工作(如文件解析)
+	Normal = 1,		// 默认
+	Low = 2,		// 可延后的工作(如网格导出、统计)
+	PriorityNum = 3	// 优先级数量
+};
+
+/**
+ * \brief 线程池对象：每个工作线程拥有一组按优先级划分的双端队列，各自一把锁.
+ *        工作线程内提交的任务进入自己的队列并从队尾取(后进先出，数据仍在缓存中)，外部线程提交的任务轮流分发到各线程队列；
+ *        自己的队列为空时从其他线程的队首窃取(先进先出，窃取最早、通常最大的任务)，因此线程之间几乎不争用同一把锁.
+ *        析构时执行完所有已提交的任务再退出.
+ */
+class ThreadPool
 {
 private:
-	std::queue<T> safeQueue; // 利用模板函数构造队列
-
-	std::mutex mutexlock; // 访问互斥信号量	
-
-public:
-	/**
-	 * \brief 构造安全队列对象，这样的对象会避免多个线程访问同一个队列.
-	 * 
-	 */
-	SafeQueue() {}
 	/**
-	 * \brief 构造安全队列.
-	 * 
-	 * \param other 一个安全队列
+	 * \brief 一个工作线程的任务队列.
 	 */
-	SafeQueue(SafeQueue&& other) {}
-	/**
-	 * \brief 析构安全队列.
-	 * 
-	 */
-	~SafeQueue() {}
+	struct WorkerQueue {
+		std::mutex mutex;																// 保护本线程的队列
+		std::deque<std::function<void()>> tasks[(int)TaskPriority::PriorityNum];		// 按优先级划分的任务
+	};
 
-	/**
-	 * \brief 获取当前队列是否为空.
-	 * 
-	 * \return 为空返回true，不为空返回false
-	 */
-	bool Empty() {
-		std::unique_lock<std::mutex> lock(mutexlock);// 互斥信号变量加锁，防止safeQueue被改变
-		return safeQueue.empty();
-	}
+	std::vector<std::unique_ptr<WorkerQueue>> queues;	// 每个工作线程的队列
+	std::vector<std::thread> workers;					// 用来工作的线程，一共多少个线程
+	std::atomic<int> pendingTasks;						// 已提交但尚未被取出的任务数量
+	std::atomic<unsigned int> nextQueue;				// 外部线程提交时轮流分发的队列
+	std::atomic<bool> stop;								// 是否停止，Submit在队列锁而非mutex_下读取
+	std::condition_variable cond_;						// 没有任务时休眠的工作线程在此等待
+	std::mutex mutex_;									// 线程休眠锁互斥变量
 
 	/**
-	 * \brief 返回队列中元素个数.
-	 *
-	 * \return 元素个数
+	 * \brief 当前线程所属的线程池与工作线程index(非工作线程为NULL与-1).
 	 */
-	int Size() {
-		std::unique_lock<std::mutex> lock(mutexlock); // 互斥信号变量加锁，防止safeQueue被改变
-		return safeQueue.size();
-	}
+	static ThreadPool*& currentPool() { thread_local ThreadPool* pool = NULL; return pool; }
+	static int& currentWorker() { thread_local int worker = -1; return worker; }
 
 	/**
-	 * \brief 队列添加元素.
+	 * \brief 从队列取一个priority优先级的任务.
 	 *
-	 * \param t 添加的元素
+	 * \param queue 队列
+	 * \param priority 优先级
+	 * \param fromBack true为所有者从队尾取，false为窃取者从队首取
+	 * \param task 【输出】任务
+	 * \return 是否取到
 	 */
-	void Enqueue(T& t) {
-		std::unique_lock<std::mutex> lock(mutexlock);
-		safeQueue.emplace(t); // emplace既能接收左值，也能接收右值
+	static bool popTask(WorkerQueue& queue, const int priority, const bool fromBack, std::function<void()>& task) {
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		std::deque<std::function<void()>>& tasks = queue.tasks[priority];
+		if (tasks.empty()) return false;
+		if (fromBack) {
+			task = std::move(tasks.back());
+			tasks.pop_back();
+		}
+		else {
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		return true;
 	}
 
 	/**
-	 * \brief 队列取出元素.
+	 * \brief 按优先级从高到低，先取自己的队列，再从其他线程窃取.
 	 *
-	 * \param t 元素出队
-	 * \return
+	 * \param workerID 工作线程index
+	 * \param task 【输出】任务
+	 * \return 是否取到
 	 */
-	bool Dequeue(T& t) {
-		std::unique_lock<std::mutex> lock(mutexlock); // 队列加锁
-		if (safeQueue.empty())	return false;
-		t = std::move(safeQueue.front()); // 取出队首元素，返回队首元素值，并进行右值引用
-		safeQueue.pop(); // 弹出入队的第一个元素
-		return true;
+	bool takeTask(const int workerID, std::function<void()>& task) {
+		const int workerNum = (int)queues.size();
+		for (int priority = 0; priority < (int)TaskPriority::PriorityNum; priority++) {
+			if (popTask(*queues[workerID], priority, true, task)) return true;
+			for (int offset = 1; offset < workerNum; offset++) {
+				if (popTask(*queues[(workerID + offset) % workerNum], priority, false, task)) return true;
+			}
+		}
+		return false;
 	}
-};
-
-/**
- * \brief 线程池对象.
- */
-class ThreadPool
-{
-private:
-	bool stop;										// 是否停止
-	SafeQueue<std::function<void()>> tasks;			// 线程池的任务队列，传入线程中执行的函数
-	std::vector<std::thread> workers;				// 用来工作的线程，一共多少个线程
-	std::condition_variable cond_;					// 控制某线程是否阻塞
-	std::mutex mutex_;								// 线程休眠锁互斥变量
 
-private:
 	/**
-	 * \brief 内置的工作线程类.
+	 * \brief 工作线程的主循环.
+	 *
+	 * \param workerID 工作线程index
 	 */
-	class ThreadWorker
-	{
-	private:
-		int workerID;		//线程工作的ID
-		ThreadPool* threadPool;	//所属线程池
-	public:
-		ThreadWorker(const int id, ThreadPool* pool) : workerID(id), threadPool(pool) {}
-		// 重载()操作
-		void operator ()()
-		{
-			std::function<void()> task; // 定义基础函数类，创建任务task，即需要执行的函数
-			bool isDequeued;			// 是否正在取出队列中元素
-			while (!threadPool->stop) {	// 线程池没有关闭，死循环等待，下面是判断是否继续循环执行任务的临界区域
-				{	// {}：标定lock的作用域
-					// 为线程环境加锁，互访问工作线程的休眠和唤醒
-					std::unique_lock<std::mutex> lock(threadPool->mutex_);
-					if (threadPool->tasks.Empty())		// 如果任务队列为空，阻塞当前线程
-					{
-						threadPool->cond_.wait(lock);	// 等待条件变量通知，开启线程
-					}
-					// 取出任务队列中的元素
-					isDequeued = threadPool->tasks.Dequeue(task);	//将队列的头部移动给task
-				}	// 临界区结束，自动释放锁 mutex_
-				if (isDequeued) task();		//出队成功执行task任务
+	void workerLoop(const int workerID) {
+		currentPool() = this;
+		currentWorker() = workerID;
+		std::function<void()> task;
+		while (true) {
+			if (takeTask(workerID, task)) {
+				pendingTasks--;
+				task();
+				task = nullptr;		// 尽早释放任务捕获的资源
+				continue;
 			}
+			std::unique_lock<std::mutex> lock(mutex_);
+			// pendingTasks在入队之后、通知之前增加，检查与休眠都在锁内，不会错过通知
+			cond_.wait(lock, [this]() { return stop || pendingTasks.load() > 0; });
+			if (stop && pendingTasks.load() == 0) return;	// 退出前执行完所有已提交的任务
 		}
-	};
-
+	}
 
 public:
 
@@ -142,9 +132,11 @@ public:
 	 * 
 	 * \param size 构造的线程池有多少个线程
 	 */
-	ThreadPool(const int threadNum) : workers(std::vector<std::thread>(threadNum)), stop(false) {
+	ThreadPool(const int threadNum) : pendingTasks(0), nextQueue(0), stop(false) {
+		if (threadNum <= 0) LOGGING(FATAL) << "线程池至少需要1个线程";
+		for (int i = 0; i < threadNum; i++) queues.emplace_back(new WorkerQueue());
 		for (int i = 0; i < threadNum; i++) { // 分配线程
-			workers.at(i) = std::thread(ThreadWorker(i, this));
+			workers.emplace_back(&ThreadPool::workerLoop, this, i);
 		}
 	}
 
@@ -161,9 +153,10 @@ public:
 	 * 
 	 */
 	inline ~ThreadPool() {
-		
-		std::unique_lock<std::mutex> lock(mutex_);		// 临界区开始  锁住stop 将其赋值为true 通知线程退出循环
-		stop = true;									// 临界区结束 自动释放锁 mutex_
+		{
+			std::unique_lock<std::mutex> lock(mutex_);	// 临界区开始  锁住stop 将其赋值为true 通知线程退出循环
+			stop = true;
+		}
 		cond_.notify_all();								// 通知所有的线程退出循环
 		for (int i = 0; i < workers.size(); i++) {		// 等待直到所有线程结束
 			if (workers.at(i).joinable()) {
@@ -172,62 +165,68 @@ public:
 		}
 	}
 
-	///**
-	// * \brief 通过完美转发进行任务入队列. C++17
-	// * 
-	// * \param 传入需要加入线程池的函数
-	// * \param ...args 
-	// * \return 
-	// */
-	//template<class F, class ... Args>			// 类型可推导，通用模板
-	//auto AddTask(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type> {	// 用auto将返回值后置,用future在未来获得函数类型
-	//	using returnType = std::future<typename std::invoke_result<F, Args...>::type>;// 用推导得到返回值类型
-
-	//	std::function<typename std::invoke_result<F, Args...>::type()> func =
-	//		std::bind(std::forward<F>(f), std::forward<Args>(args)...);// 连接函数和参数定义，特殊函数类型，避免左右值错误
-	//	// 用packageed_task包装一个函数对象，可以异步调用这个函数对象，就是吧一个普通函数对象转成异步执行的任务
-	//	auto task = std::make_shared< std::packaged_task<typename std::invoke_result<F, Args...>::type()> >( func );
-
-	//	std::function<void()> warpperFunction = [task]() {(*task)(); };
-	//	returnType res = task->get_future();
-	//	{
-	//		//临界区开始 锁任务队列
-	//		std::unique_lock<std::mutex> lock(mutex_);
-	//		if (stop) LOGGING(FATAL) << "线程已经停止，不允许入队";
-	//		//如果已经将线程池析构,就不允许再入队列
-	//		tasks.Enqueue(warpperFunction);
-	//	}
-	//	cond_.notify_one(); //通知任意一个线程接收任务
-	//	return res;
-	//}
+	/**
+	 * \brief 线程数量.
+	 */
+	int ThreadNum() const { return (int)workers.size(); }
 
 	/**
-	 * \brief 通过完美转发进行任务入队列. C++14
+	 * \brief 进程内共享的线程池(线程数量为硬件线程数)：多个重建实例(批量重建的通道、多设备重建)提交到同一个池，
+	 *        CPU端总线程数不随实例数量成倍增加.没有实例持有时自动析构，之后再获取时重新创建.
 	 *
+	 * \return 共享线程池
+	 */
+	static std::shared_ptr<ThreadPool> Shared() {
+		static std::mutex sharedMutex;
+		static std::weak_ptr<ThreadPool> sharedPool;
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		std::shared_ptr<ThreadPool> pool = sharedPool.lock();
+		if (pool == nullptr) {
+			pool = std::make_shared<ThreadPool>((int)std::max(1u, std::thread::hardware_concurrency()));
+			sharedPool = pool;
+		}
+		return pool;
+	}
+
+	/**
+	 * \brief 按优先级提交任务. C++14
+	 *
+	 * \param priority 优先级
 	 * \param 传入需要加入线程池的函数
 	 * \param ...args
-	 * \return
+	 * \return 任务结果的future
 	 */
-	template<class F, class ... Args>			// 类型可推导，通用模板
-	auto AddTask(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type> {	// 用auto将返回值后置,用future在未来获得函数类型
-		using returnType = std::future<typename std::result_of<F(Args...)>::type>;// 用推导得到返回值类型
-
-		std::function<typename std::result_of<F(Args...)>::type()> func =
-			std::bind(std::forward<F>(f), std::forward<Args>(args)...);// 连接函数和参数定义，特殊函数类型，避免左右值错误
+	template<class F, class ... Args>
+	auto Submit(const TaskPriority priority, F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type> {
+		using resultType = typename std::result_of<F(Args...)>::type;
 		// 用packageed_task包装一个函数对象，可以异步调用这个函数对象，就是吧一个普通函数对象转成异步执行的任务
-		auto task = std::make_shared< std::packaged_task<typename std::result_of<F(Args...)>::type()> >(func);
+		auto task = std::make_shared<std::packaged_task<resultType()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+		std::future<resultType> res = task->get_future();
 
-		std::function<void()> warpperFunction = [task]() {(*task)(); };
-		returnType res = task->get_future();
+		// 工作线程内提交的任务留在自己的队列，外部提交轮流分发
+		const int worker = currentPool() == this ? currentWorker() : (int)(nextQueue++ % queues.size());
 		{
-			//临界区开始 锁任务队列
-			std::unique_lock<std::mutex> lock(mutex_);
+			std::lock_guard<std::mutex> lock(queues[worker]->mutex);
 			if (stop) LOGGING(FATAL) << "线程已经停止，不允许入队";
-			//如果已经将线程池析构,就不允许再入队列
-			tasks.Enqueue(warpperFunction);
+			queues[worker]->tasks[(int)priority].emplace_back([task]() { (*task)(); });
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex_);	// 与休眠检查互斥，避免错过通知
+			pendingTasks++;
 		}
 		cond_.notify_one(); //通知任意一个线程接收任务
 		return res;
 	}
-};
 
+	/**
+	 * \brief 通过完美转发进行任务入队列，优先级为Normal. C++14
+	 *
+	 * \param 传入需要加入线程池的函数
+	 * \param ...args
+	 * \return
+	 */
+	template<class F, class ... Args>			// 类型可推导，通用模板
+	auto AddTask(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type> {	// 用auto将返回值后置,用future在未来获得函数类型
+		return Submit(TaskPriority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
+	}
+};
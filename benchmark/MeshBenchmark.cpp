@@ -0,0 +1,237 @@
+/*****************************************************************//**
+ * \file   MeshBenchmark.cpp
+ * \brief  无窗口的重建基准测试：扫描PointCloudData中的数据集，预热后统计每个阶段耗时的p50/p95/p99与帧间常驻显存的最大值
+ *
+ * \author LUOJIAXUAN
+ * \date   June 10th 2024
+ *********************************************************************/
+#include <map>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+#include <mesh/PoissonReconstruction.h>
+
+using namespace SparseSurfelFusion;
+
+namespace {
+	/**
+	 * \brief 基准测试参数.
+	 */
+	struct BenchmarkOptions {
+		std::string dataRoot = "./PointCloudData";	// 数据集根目录
+		std::vector<std::string> files;				// 指定的数据文件，为空则扫描dataRoot
+		unsigned int warmupFrames = 10;				// 预热帧数，不计入统计
+		unsigned int frames = 100;					// 统计帧数
+		std::string csvPath;						// 汇总结果CSV路径，为空则只输出到终端
+		std::string jsonDirectory;					// 每个数据集最后一帧的计时JSON目录，为空则不导出
+	};
+
+	/**
+	 * \brief 一个阶段在所有统计帧上的耗时.
+	 */
+	struct StageSamples {
+		std::string name;				// 阶段名称，每层的阶段为name[depth]
+		std::vector<double> values;		// 每帧的耗时(ms)
+	};
+
+	/**
+	 * \brief 列出目录中扩展名为extension的文件，按文件名排序.
+	 */
+	std::vector<std::string> listFiles(const std::string& directory, const std::string& extension)
+	{
+		std::vector<std::string> files;
+#if defined(_WIN32)
+		WIN32_FIND_DATAA data;
+		HANDLE handle = FindFirstFileA((directory + "/*" + extension).c_str(), &data);
+		if (handle == INVALID_HANDLE_VALUE) return files;
+		do {
+			if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) files.push_back(directory + "/" + data.cFileName);
+		} while (FindNextFileA(handle, &data));
+		FindClose(handle);
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (dir == NULL) return files;
+		while (dirent* entry = readdir(dir)) {
+			const std::string name = entry->d_name;
+			if (name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0) {
+				files.push_back(directory + "/" + name);
+			}
+		}
+		closedir(dir);
+#endif
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
+	/**
+	 * \brief 最近秩法求分位数.
+	 *
+	 * \param sorted 升序排列的样本
+	 * \param percentile 分位[0, 100]
+	 */
+	double percentileOf(const std::vector<double>& sorted, const double percentile)
+	{
+		if (sorted.empty()) return 0.0;
+		size_t rank = (size_t)std::ceil(percentile / 100.0 * sorted.size());
+		if (rank < 1) rank = 1;
+		return sorted[std::min(rank, sorted.size()) - 1];
+	}
+
+	/**
+	 * \brief 当前设备已使用的显存(字节).只在帧与帧之间采样，得到的是常驻显存(预先开辟与按需扩容的buffer)，
+	 *        帧内临时开辟又释放的显存(如cub临时空间)不在其中.
+	 */
+	size_t usedDeviceMemory()
+	{
+		size_t freeBytes = 0, totalBytes = 0;
+		CHECKCUDA(cudaMemGetInfo(&freeBytes, &totalBytes));
+		return totalBytes - freeBytes;
+	}
+
+	/**
+	 * \brief 只为按点数生成配置而在Host端统计点数量，不解析坐标、不占用显存，格式不支持时返回0.
+	 */
+	unsigned int countPoints(const std::string& path)
+	{
+		PointCloudLoader loader(1);
+		unsigned int count = 0;
+		loader.CountPoints(path, count);
+		return count;
+	}
+
+	bool endsWith(const std::string& text, const std::string& suffix)
+	{
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	std::string baseName(const std::string& path)
+	{
+		const size_t slash = path.find_last_of("/\\");
+		const std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		const size_t dot = name.find_last_of('.');
+		return dot == std::string::npos ? name : name.substr(0, dot);
+	}
+
+	void printUsage()
+	{
+		std::cout << "用法: MeshBenchmark [--data-root dir] [--warmup n] [--frames n] [--csv path] [--json-dir dir] [file ...]" << std::endl;
+		std::cout << "  未指定文件时扫描 <data-root>/data_txt/*.txt 与 <data-root>/data_pcd_without_normal/*.pcd" << std::endl;
+	}
+
+	bool parseOptions(int argc, char** argv, BenchmarkOptions& options)
+	{
+		for (int i = 1; i < argc; i++) {
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if (arg == "--help" || arg == "-h") return false;
+			else if (arg == "--data-root" && hasValue) options.dataRoot = argv[++i];
+			else if (arg == "--warmup" && hasValue) options.warmupFrames = (unsigned int)std::stoul(argv[++i]);
+			else if (arg == "--frames" && hasValue) options.frames = (unsigned int)std::stoul(argv[++i]);
+			else if (arg == "--csv" && hasValue) options.csvPath = argv[++i];
+			else if (arg == "--json-dir" && hasValue) options.jsonDirectory = argv[++i];
+			else if (arg.compare(0, 2, "--") == 0) return false;
+			else options.files.push_back(arg);
+		}
+		return options.frames > 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return 1;
+	}
+	if (options.files.empty()) {
+		const std::vector<std::string> txtFiles = listFiles(options.dataRoot + "/data_txt", ".txt");
+		const std::vector<std::string> pcdFiles = listFiles(options.dataRoot + "/data_pcd_without_normal", ".pcd");
+		options.files.insert(options.files.end(), txtFiles.begin(), txtFiles.end());
+		options.files.insert(options.files.end(), pcdFiles.begin(), pcdFiles.end());
+	}
+	if (options.files.empty()) {
+		std::cout << "未找到数据集: " << options.dataRoot << std::endl;
+		return 1;
+	}
+
+	std::ofstream csv;
+	if (!options.csvPath.empty()) {
+		csv.open(options.csvPath);
+		if (!csv.is_open()) LOGGING(FATAL) << "无法写入 " << options.csvPath;
+		csv << "dataset,depth,points,stage,p50_ms,p95_ms,p99_ms,resident_vram_mb\n";
+	}
+
+	for (const std::string& path : options.files) {
+		const unsigned int pointsNum = countPoints(path);
+		ReconstructionConfig config = pointsNum > 0 ? ReconstructionConfig::FromPointCount(pointsNum) : ReconstructionConfig();
+		config.enableRender = false;	// 不创建OpenGL窗口与DrawMesh
+
+		CHECKCUDA(cudaSetDevice(config.deviceId));
+		CHECKCUDA(cudaDeviceSynchronize());
+		const size_t baselineMemory = usedDeviceMemory();
+		size_t residentMemory = baselineMemory;	// 帧间采样的常驻显存最大值
+		{
+			PoissonReconstruction reconstruction(config);
+			if (endsWith(path, ".txt")) reconstruction.readTXTFile(path);
+			else reconstruction.readPCDFile(path);
+			reconstruction.SetProfiling(true);
+
+			std::vector<StageSamples> stages;
+			std::map<std::string, size_t> stageIndex;
+			for (unsigned int frame = 0; frame < options.warmupFrames + options.frames; frame++) {
+				auto start = std::chrono::high_resolution_clock::now();
+				reconstruction.SolvePoissionReconstructionMesh(reconstruction.getDenseSurfel());
+				auto end = std::chrono::high_resolution_clock::now();
+				reconstruction.ResolveProfile();
+				residentMemory = std::max(residentMemory, usedDeviceMemory());
+				if (frame < options.warmupFrames) continue;
+
+				// 同一阶段在一帧内出现多次(如分块重建)时累加
+				std::map<std::string, double> frameTimings;
+				std::vector<std::string> frameOrder;
+				frameOrder.push_back("frame_total");
+				frameTimings["frame_total"] = std::chrono::duration<double, std::milli>(end - start).count();
+				for (const StageTiming& timing : reconstruction.GetProfiler()->GetTimings()) {
+					const std::string name = timing.depth < 0 ? timing.name : timing.name + "[" + std::to_string(timing.depth) + "]";
+					if (frameTimings.find(name) == frameTimings.end()) frameOrder.push_back(name);
+					frameTimings[name] += timing.milliseconds;
+				}
+				for (const std::string& name : frameOrder) {
+					auto found = stageIndex.find(name);
+					if (found == stageIndex.end()) {
+						found = stageIndex.insert(std::make_pair(name, stages.size())).first;
+						stages.push_back(StageSamples());
+						stages.back().name = name;
+					}
+					stages[found->second].values.push_back(frameTimings[name]);
+				}
+			}
+			if (!options.jsonDirectory.empty()) {
+				const std::string jsonPath = options.jsonDirectory + "/" + baseName(path) + "_D" + std::to_string(MAX_DEPTH_OCTREE) + ".json";
+				if (!reconstruction.GetProfiler()->ExportJSON(jsonPath)) std::cout << "无法写入 " << jsonPath << std::endl;
+			}
+
+			const double residentMB = (residentMemory - baselineMemory) / (1024.0 * 1024.0);
+			printf("\n%s  depth = %d  points = %u  frames = %u (warm-up %u)  resident VRAM (between frames) = %.1f MB\n", path.c_str(), MAX_DEPTH_OCTREE, pointsNum, options.frames, options.warmupFrames, residentMB);
+			printf("%-28s %10s %10s %10s\n", "stage", "p50(ms)", "p95(ms)", "p99(ms)");
+			for (StageSamples& stage : stages) {
+				std::sort(stage.values.begin(), stage.values.end());
+				const double p50 = percentileOf(stage.values, 50.0), p95 = percentileOf(stage.values, 95.0), p99 = percentileOf(stage.values, 99.0);
+				printf("%-28s %10.3f %10.3f %10.3f\n", stage.name.c_str(), p50, p95, p99);
+				if (csv.is_open()) {
+					csv << "\"" << baseName(path) << "\"," << MAX_DEPTH_OCTREE << "," << pointsNum << "," << stage.name << "," << p50 << "," << p95 << "," << p99 << "," << residentMB << "\n";
+				}
+			}
+		}
+	}
+	return 0;
+}
@@ -115,3 +115,44 @@ void SparseSurfelFusion::KeyValueSort<KeyT, ValueT>::Sort(const DeviceArray<KeyT
     );
 }
 
+template<typename KeyT, typename ValueT>
+void SparseSurfelFusion::KeyValueSort<KeyT, ValueT>::SortInBitRange(const DeviceArray<KeyT>& key_in, const DeviceArray<ValueT>& value_in, int begin_bit, int end_bit, cudaStream_t stream)
+{
+    //如果缓冲区不够，则分配缓冲区
+    AllocateBuffer(key_in.size());
+
+    //构造大小正确的结果
+    valid_sorted_key = DeviceArray<KeyT>(m_sorted_key_buffer.ptr(), key_in.size());
+    valid_sorted_value = DeviceArray<ValueT>(m_sorted_value_buffer.ptr(), value_in.size());
+
+    //只排序[begin_bit, end_bit)位
+    size_t required_temp_bytes = m_temp_storage.sizeBytes();
+    cub::DeviceRadixSort::SortPairs<KeyT, ValueT>(
+        m_temp_storage.ptr(), required_temp_bytes,
+        key_in.ptr(), valid_sorted_key.ptr(),
+        value_in.ptr(), valid_sorted_value.ptr(),
+        (int)key_in.size(),
+        begin_bit, end_bit,
+        stream
+    );
+}
+
+template<typename KeyT, typename ValueT>
+void SparseSurfelFusion::KeyValueSort<KeyT, ValueT>::SortKeysInBitRange(const DeviceArray<KeyT>& key_in, int begin_bit, int end_bit, cudaStream_t stream)
+{
+    //如果缓冲区不够，则分配缓冲区
+    AllocateBuffer(key_in.size());
+
+    //构造大小正确的结果，值缓存留给调用者收集
+    valid_sorted_key = DeviceArray<KeyT>(m_sorted_key_buffer.ptr(), key_in.size());
+    valid_sorted_value = DeviceArray<ValueT>(m_sorted_value_buffer.ptr(), key_in.size());
+
+    //只排序[begin_bit, end_bit)位，SortKeys所需临时空间不超过SortPairs
+    size_t required_temp_bytes = m_temp_storage.sizeBytes();
+    cub::DeviceRadixSort::SortKeys(
+        m_temp_storage.ptr(), required_temp_bytes,
+        key_in.ptr(), valid_sorted_key.ptr(), (int)key_in.size(),
+        begin_bit, end_bit,
+        stream
+    );
+}
@@ -141,6 +141,17 @@ namespace SparseSurfelFusion {
 		 */
 		void AllocateBuffer(size_t input_size);
 
+		/**
+		 * \brief 释放m_temp_storage、m_sorted_key_buffer、m_sorted_value_buffer的缓存.
+		 */
+		void ReleaseBuffer() {
+			m_temp_storage.release();
+			m_sorted_key_buffer.release();
+			m_sorted_value_buffer.release();
+			valid_sorted_key = DeviceArray<KeyT>();
+			valid_sorted_value = DeviceArray<ValueT>();
+		}
+
 		/**
 		 * \brief 根据键key_in，对value_in进行排序.
 		 * 
@@ -181,6 +192,28 @@ namespace SparseSurfelFusion {
 		 */
 		void Sort(const DeviceArray<KeyT>& key_in, cudaStream_t stream = 0, int end_bit = sizeof(KeyT) * 8, bool debug_sync = false);
 
+		/**
+		 * \brief 只按键的[begin_bit, end_bit)位对键值对排序，其余位不参与基数排序，可减少排序轮数.
+		 * 
+		 * \param key_in 键值
+		 * \param value_in 数值
+		 * \param begin_bit 参与排序的最低位
+		 * \param end_bit 参与排序的最高位(不包含)
+		 * \param stream CUDA流ID
+		 */
+		void SortInBitRange(const DeviceArray<KeyT>& key_in, const DeviceArray<ValueT>& value_in, int begin_bit, int end_bit, cudaStream_t stream = 0);
+
+		/**
+		 * \brief 只按键的[begin_bit, end_bit)位对键排序，值不参与每一轮基数排序的搬运.
+		 *		  排序后valid_sorted_value指向大小与键相同的值缓存，由调用者根据键中记录的原始索引收集(gather)数值.
+		 * 
+		 * \param key_in 键值
+		 * \param begin_bit 参与排序的最低位
+		 * \param end_bit 参与排序的最高位(不包含)
+		 * \param stream CUDA流ID
+		 */
+		void SortKeysInBitRange(const DeviceArray<KeyT>& key_in, int begin_bit, int end_bit, cudaStream_t stream = 0);
+
 		//Sorted value
 		DeviceArray<KeyT> valid_sorted_key;			//有效排列的键  （数组首地址）
 		DeviceArray<ValueT> valid_sorted_value;		//有效排列的值  （数组首地址）
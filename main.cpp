@@ -25,7 +25,7 @@ int main(int argc, char** argv) {
 		printf("・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・  第 %lld 帧  ・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・・  \n", Frame);
 		auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
 		PoissonRecon.SolvePoissionReconstructionMesh(PoissonRecon.getDenseSurfel());
-		PoissonRecon.DrawRebuildMesh();
+		PoissonRecon.DrawRebuildMeshPipelined();	// 本帧的渲染与下一帧的重建重叠
 
 		auto end = std::chrono::high_resolution_clock::now();							// 记录结束时间点
 		std::chrono::duration<double, std::milli> duration = end - start;				// 计算执行时间（以ms为单位）
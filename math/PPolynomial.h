@@ -6,9 +6,11 @@
  * \date   May 21st 2024
  *********************************************************************/
 #pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "Polynomial.h"
-#include <cuda_runtime_api.h>
-#include <device_launch_parameters.h>
+#include <base/HostDeviceCompat.h>
 namespace SparseSurfelFusion {
 
     /**
@@ -582,6 +584,7 @@ namespace SparseSurfelFusion {
     }
 
 
+#if RECONSTRUCTION_WITH_CUDA
     template<int Degree>
     __host__ void copySinglePPolynomialHostToDevice(PPolynomial<Degree>* pp_h, PPolynomial<Degree>*& pp_d) {
         cudaMalloc((PPolynomial<Degree> **) & pp_d, sizeof(PPolynomial<Degree>));
@@ -616,6 +619,7 @@ namespace SparseSurfelFusion {
             pp_h[i].polys = host_pointer_v[i];
         }
     }
+#endif // RECONSTRUCTION_WITH_CUDA
 
 
     template<int Degree>
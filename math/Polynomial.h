@@ -1,7 +1,7 @@
 #pragma once
 #include <vector>
-#include <device_launch_parameters.h>
-#include <cuda_runtime_api.h>
+#include <cfloat>
+#include <base/HostDeviceCompat.h>
 #include <math/Factor.h>
 
 namespace SparseSurfelFusion {
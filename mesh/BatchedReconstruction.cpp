@@ -0,0 +1,91 @@
+/*****************************************************************//**
+ * \file   BatchedReconstruction.cpp
+ * \brief  批量重建多个小点云，结果写入连续的顶点、三角形缓冲
+ * 
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#include "BatchedReconstruction.h"
+
+SparseSurfelFusion::BatchedReconstruction::BatchedReconstruction(const ReconstructionConfig& config, const int laneCount) : config(config)
+{
+	if (laneCount <= 0) LOGGING(FATAL) << "BatchedReconstruction的通道数量必须大于0";
+	this->config.enableRender = false;
+	for (int i = 0; i < laneCount; i++) {
+		lanes.push_back(std::make_shared<PoissonReconstruction>(this->config));
+	}
+	CHECKCUDA(cudaSetDevice(this->config.deviceId));
+	laneStreams.resize(laneCount);
+	laneVertices.resize(laneCount);
+	laneTriangles.resize(laneCount);
+	for (int i = 0; i < laneCount; i++) {
+		CHECKCUDA(cudaStreamCreate(&laneStreams[i]));
+		laneVertices[i].AllocateBuffer(this->config.maxSurfelCount);
+		laneTriangles[i].AllocateBuffer(this->config.maxMeshTriangleCount);
+	}
+	BatchVertices.AllocateBuffer(this->config.maxSurfelCount);
+	BatchTriangles.AllocateBuffer(this->config.maxMeshTriangleCount);
+}
+
+SparseSurfelFusion::BatchedReconstruction::~BatchedReconstruction()
+{
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	for (int i = 0; i < laneStreams.size(); i++) {
+		CHECKCUDA(cudaStreamDestroy(laneStreams[i]));
+		laneVertices[i].ReleaseBuffer();
+		laneTriangles[i].ReleaseBuffer();
+	}
+	BatchVertices.ReleaseBuffer();
+	BatchTriangles.ReleaseBuffer();
+}
+
+void SparseSurfelFusion::BatchedReconstruction::SolveBatch(const std::vector<DeviceArrayView<DepthSurfel>>& clouds, std::vector<MeshRange>& ranges)
+{
+	const int laneCount = lanes.size();
+	const int cloudCount = clouds.size();
+	ranges.assign(cloudCount, MeshRange());
+	std::vector<int> cloudLane(cloudCount, -1);		// 点云由哪条通道重建
+	std::vector<MeshRange> laneRanges(cloudCount);	// 点云网格在通道暂存缓冲中的范围
+	for (int i = 0; i < laneCount; i++) {
+		laneVertices[i].ResizeArray(0);
+		laneTriangles[i].ResizeArray(0);
+	}
+
+	// 各通道动态领取点云，点云之间互不依赖
+	std::atomic<int> nextCloud(0);
+	std::vector<std::thread> workers;
+	for (int lane = 0; lane < laneCount; lane++) {
+		workers.emplace_back([&, lane]() {
+			CHECKCUDA(cudaSetDevice(config.deviceId));
+			for (int cloud = nextCloud++; cloud < cloudCount; cloud = nextCloud++) {
+				if (clouds[cloud].Size() == 0) continue;
+				lanes[lane]->SolvePoissionReconstructionMesh(clouds[cloud]);
+				collectLaneMesh(lane, laneRanges[cloud]);
+				cloudLane[cloud] = lane;
+			}
+		});
+	}
+	for (std::thread& worker : workers) worker.join();
+
+	// 按点云顺序拼接到连续缓冲
+	unsigned int totalVertices = 0, totalTriangles = 0;
+	for (int cloud = 0; cloud < cloudCount; cloud++) {
+		ranges[cloud].vertexOffset = totalVertices;
+		ranges[cloud].triangleOffset = totalTriangles;
+		if (cloudLane[cloud] < 0) continue;
+		ranges[cloud].vertexCount = laneRanges[cloud].vertexCount;
+		ranges[cloud].triangleCount = laneRanges[cloud].triangleCount;
+		totalVertices += ranges[cloud].vertexCount;
+		totalTriangles += ranges[cloud].triangleCount;
+	}
+	BatchVertices.ResizeArray(totalVertices, true);
+	BatchTriangles.ResizeArray(totalTriangles, true);
+	cudaStream_t stream = laneStreams[0];
+	for (int cloud = 0; cloud < cloudCount; cloud++) {
+		const int lane = cloudLane[cloud];
+		if (lane < 0) continue;
+		if (ranges[cloud].vertexCount > 0) CHECKCUDA(cudaMemcpyAsync(BatchVertices.Ptr() + ranges[cloud].vertexOffset, laneVertices[lane].Ptr() + laneRanges[cloud].vertexOffset, sizeof(Point3D<float>) * ranges[cloud].vertexCount, cudaMemcpyDeviceToDevice, stream));
+		if (ranges[cloud].triangleCount > 0) CHECKCUDA(cudaMemcpyAsync(BatchTriangles.Ptr() + ranges[cloud].triangleOffset, laneTriangles[lane].Ptr() + laneRanges[cloud].triangleOffset, sizeof(TriangleIndex) * ranges[cloud].triangleCount, cudaMemcpyDeviceToDevice, stream));
+	}
+	CHECKCUDA(cudaStreamSynchronize(stream));
+}
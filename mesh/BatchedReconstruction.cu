@@ -0,0 +1,45 @@
+/*****************************************************************//**
+ * \file   BatchedReconstruction.cu
+ * \brief  批量重建多个小点云，结果写入连续的顶点、三角形缓冲
+ * 
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#include "BatchedReconstruction.h"
+
+__global__ void SparseSurfelFusion::device::denormalizeMeshVerticesKernel(DeviceArrayView<Point3D<float>> normalizedVertices, const Point3D<float> center, const float maxEdge, const unsigned int verticesNum, Point3D<float>* vertices)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= verticesNum) return;
+	Point3D<float> vertex;
+	for (int i = 0; i < DIMENSION; i++) {
+		vertex.coords[i] = normalizedVertices[idx].coords[i] * maxEdge + center.coords[i];
+	}
+	vertices[idx] = vertex;
+}
+
+void SparseSurfelFusion::BatchedReconstruction::collectLaneMesh(const int lane, MeshRange& laneRange)
+{
+	DeviceArrayView<Point3D<float>> meshVertices = lanes[lane]->GetRebuildMeshVertices();
+	DeviceArrayView<TriangleIndex> meshTriangles = lanes[lane]->GetRebuildMeshTriangleIndices();
+	const Point3D<float> center = lanes[lane]->GetNormalizeCenter();
+	const float maxEdge = lanes[lane]->GetNormalizeMaxEdge();
+	cudaStream_t stream = laneStreams[lane];
+
+	laneRange.vertexOffset = laneVertices[lane].ArraySize();
+	laneRange.vertexCount = meshVertices.Size();
+	laneRange.triangleOffset = laneTriangles[lane].ArraySize();
+	laneRange.triangleCount = meshTriangles.Size();
+	laneVertices[lane].ResizeArray(laneRange.vertexOffset + laneRange.vertexCount, true);		// 不足时扩容并保留已暂存的网格
+	laneTriangles[lane].ResizeArray(laneRange.triangleOffset + laneRange.triangleCount, true);
+
+	if (laneRange.vertexCount > 0) {
+		dim3 block(128);
+		dim3 grid(divUp(laneRange.vertexCount, block.x));
+		device::denormalizeMeshVerticesKernel << <grid, block, 0, stream >> > (meshVertices, center, maxEdge, laneRange.vertexCount, laneVertices[lane].Ptr() + laneRange.vertexOffset);
+	}
+	if (laneRange.triangleCount > 0) {
+		CHECKCUDA(cudaMemcpyAsync(laneTriangles[lane].Ptr() + laneRange.triangleOffset, meshTriangles.RawPtr(), sizeof(TriangleIndex) * laneRange.triangleCount, cudaMemcpyDeviceToDevice, stream));
+	}
+	CHECKCUDA(cudaStreamSynchronize(stream));	// 通道的下一次重建会覆盖当前网格
+}
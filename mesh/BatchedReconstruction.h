@@ -0,0 +1,94 @@
+/*****************************************************************//**
+ * \file   BatchedReconstruction.h
+ * \brief  批量重建多个小点云，结果写入连续的顶点、三角形缓冲
+ * 
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "PoissonReconstruction.h"
+
+namespace SparseSurfelFusion {
+	namespace device {
+		/**
+		 * \brief 将归一化坐标的网格顶点变换回原始坐标系并写入目标缓冲.
+		 * 
+		 * \param normalizedVertices 归一化坐标的网格顶点
+		 * \param center 归一化偏移
+		 * \param maxEdge 归一化放缩边长
+		 * \param verticesNum 顶点数量
+		 * \param vertices 【输出】原始坐标系的网格顶点
+		 */
+		__global__ void denormalizeMeshVerticesKernel(DeviceArrayView<Point3D<float>> normalizedVertices, const Point3D<float> center, const float maxEdge, const unsigned int verticesNum, Point3D<float>* vertices);
+	}
+
+	/**
+	 * \brief 批量重建中某个点云的网格在连续缓冲中的范围，三角形索引相对于本点云的vertexOffset.
+	 */
+	struct MeshRange {
+		unsigned int vertexOffset = 0;		// 顶点在连续顶点缓冲中的起始位置
+		unsigned int vertexCount = 0;		// 顶点数量
+		unsigned int triangleOffset = 0;	// 三角形在连续三角形缓冲中的起始位置
+		unsigned int triangleCount = 0;		// 三角形数量
+	};
+
+	/**
+	 * \brief 批量重建：同一设备上持有多条无渲染的重建通道，每条通道只同步自己的流，
+	 *        一条通道在逐层求解、Host同步时其余通道的核函数填满GPU.
+	 */
+	class BatchedReconstruction
+	{
+	public:
+		using Ptr = std::shared_ptr<BatchedReconstruction>;
+
+		/**
+		 * \brief 构造批量重建通道.
+		 * 
+		 * \param config 每条通道的容量配置(按单个点云的最大点数设置，enableRender会被覆盖)
+		 * \param laneCount 并发的重建通道数量
+		 */
+		BatchedReconstruction(const ReconstructionConfig& config = ReconstructionConfig(), const int laneCount = 4);
+
+		~BatchedReconstruction();
+
+		/**
+		 * \brief 重建一批点云，所有网格写入连续的顶点、三角形缓冲.
+		 * 
+		 * \param clouds 一批点云(须位于config.deviceId上)
+		 * \param ranges 【输出】每个点云网格在连续缓冲中的范围，与clouds一一对应
+		 */
+		void SolveBatch(const std::vector<DeviceArrayView<DepthSurfel>>& clouds, std::vector<MeshRange>& ranges);
+
+		/**
+		 * \brief 获得批量重建的连续顶点缓冲(原始坐标系).
+		 */
+		DeviceArrayView<Point3D<float>> GetBatchMeshVertices() const { return BatchVertices.ArrayView(); }
+
+		/**
+		 * \brief 获得批量重建的连续三角形缓冲.
+		 */
+		DeviceArrayView<TriangleIndex> GetBatchMeshTriangleIndices() const { return BatchTriangles.ArrayView(); }
+
+	private:
+		ReconstructionConfig config;										// 通道的容量配置
+		std::vector<std::shared_ptr<PoissonReconstruction>> lanes;			// 重建通道
+		std::vector<cudaStream_t> laneStreams;								// 每条通道拷贝结果使用的流
+		std::vector<DeviceBufferArray<Point3D<float>>> laneVertices;		// 每条通道暂存的网格顶点
+		std::vector<DeviceBufferArray<TriangleIndex>> laneTriangles;		// 每条通道暂存的三角形
+
+		DeviceBufferArray<Point3D<float>> BatchVertices;					// 连续顶点缓冲
+		DeviceBufferArray<TriangleIndex> BatchTriangles;					// 连续三角形缓冲
+
+		/**
+		 * \brief 将通道当前重建的网格追加到通道暂存缓冲.
+		 * 
+		 * \param lane 通道
+		 * \param laneRange 【输出】网格在通道暂存缓冲中的范围
+		 */
+		void collectLaneMesh(const int lane, MeshRange& laneRange);
+	};
+}
@@ -6,8 +6,7 @@
  * \date   May 18th 2024
  *********************************************************************/
 #pragma once
-#include <cuda_runtime_api.h>
-#include <device_launch_parameters.h>
+#include <base/HostDeviceCompat.h>
 
 namespace SparseSurfelFusion {
 	template<class Real>
@@ -7,15 +7,16 @@
  *********************************************************************/
 #include "BuildMeshGeometry.h"
 
-SparseSurfelFusion::BuildMeshGeometry::BuildMeshGeometry()
+SparseSurfelFusion::BuildMeshGeometry::BuildMeshGeometry(const ReconstructionConfig& config)
 {
-	VertexArray.AllocateBuffer(TOTAL_VERTEXARRAY_MAX_COUNT);	// NodeArray大小的8倍(若最大面元是50w则此处耗费2.09G)		【在实际运行过程中，是需要一个previous来生成最终的Array，因此此处需要乘2来决定GPU的显存是否满足算法】 
-	EdgeArray.AllocateBuffer(TOTAL_EDGEARRAY_MAX_COUNT);		// maxDepth层节点数量的12倍(若最大面元是50w则此处耗费1.07G)	【在实际运行过程中，是需要一个previous来生成最终的Array，因此此处需要乘2来决定GPU的显存是否满足算法】 
-	FaceArray.AllocateBuffer(TOTAL_FACEARRAY_MAX_COUNT);		// NodeArray大小的6倍(若最大面元是50w则此处耗费0.559G)		【在实际运行过程中，是需要一个previous来生成最终的Array，因此此处需要乘2来决定GPU的显存是否满足算法】 
-
-	markValidVertexArray.AllocateBuffer(TOTAL_VERTEXARRAY_MAX_COUNT);
-	markValidEdgeArray.AllocateBuffer(TOTAL_EDGEARRAY_MAX_COUNT);
-	markValidFaceArray.AllocateBuffer(TOTAL_FACEARRAY_MAX_COUNT);
+	// 顶点、边、面数组通过哈希去重得到实际数量后再按需分配，不再按NodeArray的8/12/6倍预分配
+	for (int i = 0; i < 3; i++) {
+		CHECKCUDA(cudaStreamCreate(&ElementStream[i]));
+		CHECKCUDA(cudaEventCreateWithFlags(&CountReadyEvent[i], cudaEventDisableTiming));
+		CHECKCUDA(cudaEventCreateWithFlags(&ElementReadyEvent[i], cudaEventDisableTiming));
+	}
+	CHECKCUDA(cudaEventCreateWithFlags(&DependEvent, cudaEventDisableTiming));
+	CHECKCUDA(cudaMallocHost((void**)&ElementCountHost, sizeof(unsigned int) * 3));
 }
 
 SparseSurfelFusion::BuildMeshGeometry::~BuildMeshGeometry()
@@ -24,7 +25,21 @@ SparseSurfelFusion::BuildMeshGeometry::~BuildMeshGeometry()
 	EdgeArray.ReleaseBuffer();
 	FaceArray.ReleaseBuffer();
 
-	markValidVertexArray.ReleaseBuffer();
-	markValidEdgeArray.ReleaseBuffer();
-	markValidFaceArray.ReleaseBuffer();
+	NodeVertexIndex.ReleaseBuffer();
+	NodeEdgeIndex.ReleaseBuffer();
+	NodeFaceIndex.ReleaseBuffer();
+
+	for (int i = 0; i < 3; i++) {
+		CompactBuffer[i].HashKey.ReleaseBuffer();
+		CompactBuffer[i].HashOwner.ReleaseBuffer();
+		CompactBuffer[i].OwnedMask.ReleaseBuffer();
+		CompactBuffer[i].OwnedCount.ReleaseBuffer();
+		CompactBuffer[i].OwnedAddress.ReleaseBuffer();
+		CompactBuffer[i].TempStorage.ReleaseBuffer();
+		CHECKCUDA(cudaStreamDestroy(ElementStream[i]));
+		CHECKCUDA(cudaEventDestroy(CountReadyEvent[i]));
+		CHECKCUDA(cudaEventDestroy(ElementReadyEvent[i]));
+	}
+	CHECKCUDA(cudaEventDestroy(DependEvent));
+	CHECKCUDA(cudaFreeHost(ElementCountHost));
 }
@@ -14,6 +14,8 @@ namespace SparseSurfelFusion {
 	namespace device {
 		__device__ __constant__ int maxIntValue = 0x7fffffff;		// 最大int值
 
+		__device__ __constant__ OctKey maxKeyValue = MAX_OCTKEY_VALUE;	// 最大key值
+
 		__device__ __constant__ int maxDepth = MAX_DEPTH_OCTREE;
 
 		__device__ __constant__ int parentFaceKind[8][6] = {{ 0, -1,  2, -1,  4, -1},
@@ -39,63 +41,163 @@ namespace SparseSurfelFusion {
 }
 
 
-__global__ void SparseSurfelFusion::device::initVertexOwner(DeviceArrayView<OctNode> NodeArray, const unsigned int NodeArraySize, DeviceArrayView<unsigned int> depthBuffer, DeviceArrayView<Point3D<float>> centerBuffer, VertexNode* preVertexArray, bool* markPreVertexArray)
+__forceinline__ __device__ int SparseSurfelFusion::device::GeometryElementsPerNode(const int ElementType)
 {
-	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-	if (idx >= NodeArraySize)	return;
+	return ElementType == VertexElement ? 8 : (ElementType == EdgeElement ? 12 : 6);
+}
 
-	int NodeOwnerKey[8] = { device::maxIntValue, device::maxIntValue, device::maxIntValue, device::maxIntValue ,
-							device::maxIntValue, device::maxIntValue, device::maxIntValue, device::maxIntValue };	// 初始无效值
-	int NodeOwnerIdx[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };				// 初始无效值
-	int depth = depthBuffer[idx];
-	float halfWidth = 1.0f / (1 << (depth + 1));							// 节点体素一半的宽
-	float Width = 1.0f / (1 << depth);										// 节点体素的宽
-	float WidthSquare = Width * Width;										// 节点体素宽的平方
-	Point3D<float> neighborCenter[27];										// 节点的27个邻居节点的中心位置
-	int neighbor[27];														// 节点的27个邻居的index
-#pragma unroll
-	for (int i = 0; i < 27; i++) {
-		neighbor[i] = NodeArray[idx].neighs[i];
-		if (neighbor[i] != -1) {	// 邻居不为空
-			neighborCenter[i] = centerBuffer[neighbor[i]];
+__forceinline__ __device__ void SparseSurfelFusion::device::GeometryElementOffset(const int ElementType, const int kind, int offset[3])
+{
+	if (ElementType == VertexElement) {				// 顶点：每个维度偏移半个节点宽
+		offset[0] = 2 * (kind & 1) - 1;
+		offset[1] = 2 * ((kind & 2) >> 1) - 1;
+		offset[2] = 2 * ((kind & 4) >> 2) - 1;
+	}
+	else if (ElementType == EdgeElement) {			// 边：沿orientation方向不偏移，其余两个维度偏移半个节点宽
+		const int orientation = kind >> 2;
+		int dim = 0;
+		for (int i = 0; i < 3; i++) {
+			if (orientation == i) {
+				offset[i] = 0;
+			}
+			else {
+				offset[i] = 2 * ((kind >> dim) & 1) - 1;
+				dim++;
+			}
 		}
 	}
-	const Point3D<float>& nodeCenter = neighborCenter[13];	// 中心节点就是当前节点自己
+	else {											// 面：只在orientation方向偏移半个节点宽
+		offset[0] = offset[1] = offset[2] = 0;
+		offset[kind >> 1] = 2 * (kind & 1) - 1;
+	}
+}
 
-	Point3D<float> vertexPos[8];	// 顶点位置，标记节点体素的顶点位置，一个节点 = 一个体素块，一个体素块(正方体)有8个顶点
+__forceinline__ __device__ unsigned long long SparseSurfelFusion::device::GeometryElementKey(const Point3D<float>& center, const int depth, const int offset[3])
+{
+	// 以半个节点宽为单位，节点中心为奇数坐标，顶点/边/面的中心坐标在[0, 2^(depth + 1)]内，均可精确表示
+	// 坐标最大为2^(maxDepth + 1)，需要maxDepth + 2位；层数在最高的GEOMETRY_ELEMENT_DEPTH_BITS位之内
+	const float scale = float(1 << (depth + 1));
+	unsigned long long key = (unsigned long long)depth;
 #pragma unroll
-	for (int i = 0; i < 8; i++) {	// 计算顶点位置(顶点的顺序是，顶点的顺序是，以立方体为参考：x从前到后，y从左到右，z从下到上)
-		vertexPos[i].coords[0] = nodeCenter.coords[0] + (2 * (i & 1) - 1) * halfWidth;
-		vertexPos[i].coords[1] = nodeCenter.coords[1] + (2 * ((i & 2) >> 1) - 1) * halfWidth;
-		vertexPos[i].coords[2] = nodeCenter.coords[2] + (2 * ((i & 4) >> 2) - 1) * halfWidth;
+	for (int i = 0; i < 3; i++) {
+		const int coord = __float2int_rn(center.coords[i] * scale) + offset[i];
+		key = (key << GEOMETRY_ELEMENT_COORD_BITS) | (unsigned long long)coord;
 	}
+	return key;
+}
 
-#pragma unroll
-	for (int i = 0; i < 8; i++) {			// 为每个顶点找一个对应的节点
-		for (int j = 0; j < 27; j++) {		// 遍历节点及邻居(供27个节点)，顶点对应key最小的节点，即key最小的节点拥有这个vertex
-			if ((neighbor[j] != -1) && (device::SquareDistance(vertexPos[i], neighborCenter[j]) < WidthSquare)) { // 邻居节点必须有效，拥有这个vertex的节点不可以超过一个体素的宽
-				int neighborKey = NodeArray[neighbor[j]].key;
-				if (NodeOwnerKey[i] > neighborKey) {	// 如果neighborKey更小
-					NodeOwnerKey[i] = neighborKey;
-					NodeOwnerIdx[i] = neighbor[j];		// 将这个节点的index给NodeOwnerIdx
-				}
-			}
+__forceinline__ __device__ unsigned int SparseSurfelFusion::device::GeometryElementHash(unsigned long long key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return (unsigned int)key;
+}
+
+__global__ void SparseSurfelFusion::device::insertGeometryElementHash(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int NodeOffset, const unsigned int NodeCount, const int ElementType, const unsigned int TableMask, unsigned long long* TableKey, int* TableOwner)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= NodeCount)	return;
+	const int node = idx + NodeOffset;
+	const int depth = DepthBuffer[node];
+	const Point3D<float> center = CenterBuffer[node];
+	const int elementsNum = GeometryElementsPerNode(ElementType);
+	for (int i = 0; i < elementsNum; i++) {
+		int offset[3];
+		GeometryElementOffset(ElementType, i, offset);
+		const unsigned long long key = GeometryElementKey(center, depth, offset);
+		unsigned int slot = GeometryElementHash(key) & TableMask;
+		while (true) {		// 线性探测，第一个插入者占据槽位，相同key的节点共享槽位
+			const unsigned long long previous = atomicCAS(&TableKey[slot], GEOMETRY_ELEMENT_EMPTY_KEY, key);
+			if (previous == GEOMETRY_ELEMENT_EMPTY_KEY || previous == key) break;
+			slot = (slot + 1) & TableMask;
 		}
+		atomicMin(&TableOwner[slot], node);	// 同层节点按key排序，index最小即key最小，与原先Owner的定义一致
 	}
-#pragma unroll
-	for (int i = 0; i < 8; i++) {		// 遍历这8个顶点
-		int vertexIdx = 8 * idx + i;	// 将preVertexArray每隔8个存一次，并且对应的位置是8个节点中的第几个
-		if (NodeOwnerIdx[i] == idx) {	// 如果这个顶点是NodeArray中这个节点所拥有
-			preVertexArray[vertexIdx].ownerNodeIdx = idx;						// vertex被当前这个NodeArray中的节点拥有
-			preVertexArray[vertexIdx].pos.coords[0] = vertexPos[i].coords[0];	// 将vertex的位置赋值给pos
-			preVertexArray[vertexIdx].pos.coords[1] = vertexPos[i].coords[1];	// 将vertex的位置赋值给pos
-			preVertexArray[vertexIdx].pos.coords[2] = vertexPos[i].coords[2];	// 将vertex的位置赋值给pos
-			preVertexArray[vertexIdx].vertexKind = i;							// 立方体的几号顶点
-			preVertexArray[vertexIdx].depth = depth;							// 当前vertex的深度 = 当前节点的深度
-			markPreVertexArray[vertexIdx] = true;
+}
+
+__global__ void SparseSurfelFusion::device::markOwnedGeometryElement(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int NodeOffset, const unsigned int NodeCount, const int ElementType, const unsigned int TableMask, const unsigned long long* TableKey, const int* TableOwner, unsigned short* OwnedMask, unsigned int* OwnedCount)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= NodeCount)	return;
+	const int node = idx + NodeOffset;
+	const int depth = DepthBuffer[node];
+	const Point3D<float> center = CenterBuffer[node];
+	const int elementsNum = GeometryElementsPerNode(ElementType);
+	unsigned int mask = 0;
+	for (int i = 0; i < elementsNum; i++) {
+		int offset[3];
+		GeometryElementOffset(ElementType, i, offset);
+		const unsigned long long key = GeometryElementKey(center, depth, offset);
+		unsigned int slot = GeometryElementHash(key) & TableMask;
+		while (TableKey[slot] != key) slot = (slot + 1) & TableMask;	// 插入阶段已保证key存在
+		if (TableOwner[slot] == node) mask |= (1u << i);
+	}
+	OwnedMask[idx] = (unsigned short)mask;
+	OwnedCount[idx] = __popc(mask);
+}
+
+__global__ void SparseSurfelFusion::device::generateVertexArray(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int NodeArraySize, const unsigned short* OwnedMask, const unsigned int* OwnedAddress, VertexNode* VertexArray)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= NodeArraySize)	return;
+	const unsigned int mask = OwnedMask[idx];
+	if (mask == 0) return;
+	const int depth = DepthBuffer[idx];
+	const float halfWidth = 1.0f / (1 << (depth + 1));
+	const Point3D<float> center = CenterBuffer[idx];
+	unsigned int address = OwnedAddress[idx] - __popc(mask);	// 包含式前缀和减去自身数量即写入起点，顺序与按节点、按顶点编号筛选一致
+	for (int i = 0; i < 8; i++) {
+		if (!(mask & (1u << i))) continue;
+		int offset[3];
+		GeometryElementOffset(VertexElement, i, offset);
+		VertexNode& vertex = VertexArray[address++];
+		vertex.ownerNodeIdx = idx;
+		vertex.pos.coords[0] = center.coords[0] + offset[0] * halfWidth;
+		vertex.pos.coords[1] = center.coords[1] + offset[1] * halfWidth;
+		vertex.pos.coords[2] = center.coords[2] + offset[2] * halfWidth;
+		vertex.vertexKind = i;
+		vertex.depth = depth;
+	}
+}
+
+__global__ void SparseSurfelFusion::device::generateEdgeArray(const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const unsigned short* OwnedMask, const unsigned int* OwnedAddress, EdgeNode* EdgeArray)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= DLevelNodeCount)	return;
+	const unsigned int mask = OwnedMask[idx];
+	if (mask == 0) return;
+	unsigned int address = OwnedAddress[idx] - __popc(mask);
+	for (int i = 0; i < 12; i++) {
+		if (!(mask & (1u << i))) continue;
+		EdgeNode& edge = EdgeArray[address++];
+		edge.ownerNodeIdx = idx + DLevelOffset;
+		edge.edgeKind = i;
+	}
+}
+
+__global__ void SparseSurfelFusion::device::generateFaceArray(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<unsigned int> DepthBuffer, const unsigned int NodeArraySize, const unsigned short* OwnedMask, const unsigned int* OwnedAddress, FaceNode* FaceArray)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= NodeArraySize)	return;
+	const unsigned int mask = OwnedMask[idx];
+	if (mask == 0) return;
+	const int nowDepth = DepthBuffer[idx];
+	const int parent = NodeArray[idx].parent;
+	const int sonKey = int(NodeArray[idx].key >> (3 * (device::maxDepth - nowDepth))) & 7;
+	unsigned int address = OwnedAddress[idx] - __popc(mask);
+	for (int i = 0; i < 6; i++) {
+		if (!(mask & (1u << i))) continue;
+		FaceNode& face = FaceArray[address++];
+		face.ownerNodeIdx = idx;
+		face.faceKind = i;
+		if (parent != -1 && device::parentFaceKind[sonKey][i] != -1) {
+			face.hasParentFace = 1;
 		}
 		else {
-			markPreVertexArray[vertexIdx] = false;	// 不是有效的全部标记为false
+			face.hasParentFace = -1;
 		}
 	}
 }
@@ -105,7 +207,7 @@ __forceinline__ __device__ double SparseSurfelFusion::device::SquareDistance(con
 	return (p1.coords[0] - p2.coords[0]) * (p1.coords[0] - p2.coords[0]) + (p1.coords[1] - p2.coords[1]) * (p1.coords[1] - p2.coords[1]) + (p1.coords[2] - p2.coords[2]) * (p1.coords[2] - p2.coords[2]);
 }
 
-__global__ void SparseSurfelFusion::device::maintainVertexNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int VertexArraySize, VertexNode* VertexArray, OctNode* NodeArray)
+__global__ void SparseSurfelFusion::device::maintainVertexNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int VertexArraySize, VertexNode* VertexArray, int* NodeVertexIndex)
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= VertexArraySize)	return;
@@ -141,85 +243,12 @@ __global__ void SparseSurfelFusion::device::maintainVertexNodePointer(DeviceArra
 					index += 3;
 				}
 			}
-			NodeArray[neighbor[i]].vertices[index] = idx + 1;	// 这里给Vertice数据写入，并不影响对NodeArray的OctNode中其他数据值进行读取，因此可以并行
-		}
-	}
-}
-
-__global__ void SparseSurfelFusion::device::initEdgeArray(DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, EdgeNode* preEdgeArray, bool* markPreEdgeArray)
-{
-	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-	if (idx >= DLevelNodeCount)	return;
-	const unsigned int offset = idx + DLevelOffset;
-	int NodeOwnerKey[12] = { device::maxIntValue, device::maxIntValue, device::maxIntValue, 
-							 device::maxIntValue, device::maxIntValue, device::maxIntValue,
-							 device::maxIntValue, device::maxIntValue, device::maxIntValue, 
-							 device::maxIntValue, device::maxIntValue, device::maxIntValue };
-	int NodeOwnerIdx[12] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
-	int depth = DepthBuffer[offset];
-	float halfWidth = 1.0f / (1 << (depth + 1));
-	float Width = 1.0f / (1 << depth);
-	float WidthSquare = Width * Width;
-	Point3D<float> neighCenter[27];
-	int neighbor[27];
-#pragma unroll
-	for (int i = 0; i < 27; i++) {
-		neighbor[i] = NodeArray[offset].neighs[i];
-		if (neighbor[i] != -1) {
-			neighCenter[i] = CenterBuffer[neighbor[i]];
-		}
-	}
-	const Point3D<float>& nodeCenter = neighCenter[13];
-	Point3D<float> edgeCenterPos[12];
-	int orientation[12];
-	int off[24];
-#pragma unroll
-	for (int i = 0; i < 12; i++) {
-		orientation[i] = i >> 2;
-		off[2 * i] = i & 1;
-		off[2 * i + 1] = (i & 2) >> 1;
-		int multi[3];
-		int dim = 2 * i;
-		for (int j = 0; j < 3; j++) {
-			if (orientation[i] == j) {
-				multi[j] = 0;
-			}
-			else {
-				multi[j] = (2 * off[dim] - 1);
-				dim++;
-			}
-		}
-		edgeCenterPos[i].coords[0] = nodeCenter.coords[0] + multi[0] * halfWidth;
-		edgeCenterPos[i].coords[1] = nodeCenter.coords[1] + multi[1] * halfWidth;
-		edgeCenterPos[i].coords[2] = nodeCenter.coords[2] + multi[2] * halfWidth;
-	}
-#pragma unroll
-	for (int i = 0; i < 12; i++) {
-		for (int j = 0; j < 27; j++) {
-			if (neighbor[j] != -1 && SquareDistance(edgeCenterPos[i], neighCenter[j]) < WidthSquare) {
-				int neighKey = NodeArray[neighbor[j]].key;
-				if (NodeOwnerKey[i] > neighKey) {
-					NodeOwnerKey[i] = neighKey;
-					NodeOwnerIdx[i] = neighbor[j];
-				}
-			}
-		}
-	}
-#pragma unroll
-	for (int i = 0; i < 12; i++) {
-		int edgeIdx = 12 * idx + i;
-		if (NodeOwnerIdx[i] == offset) {
-			preEdgeArray[edgeIdx].ownerNodeIdx = offset;
-			preEdgeArray[edgeIdx].edgeKind = i;
-			markPreEdgeArray[edgeIdx] = true;
-		}
-		else {
-			markPreEdgeArray[edgeIdx] = false;
+			NodeVertexIndex[8 * neighbor[i] + index] = idx + 1;	// 写入独立的节点顶点表，NodeArray只读，与边、面的生成互不影响
 		}
 	}
 }
 
-__global__ void SparseSurfelFusion::device::maintainEdgeNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int EdgeArraySize, EdgeNode* EdgeArray, OctNode* NodeArray)
+__global__ void SparseSurfelFusion::device::maintainEdgeNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int EdgeArraySize, EdgeNode* EdgeArray, int* NodeEdgeIndex)
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= EdgeArraySize)	return;
@@ -274,86 +303,12 @@ __global__ void SparseSurfelFusion::device::maintainEdgeNodePointer(DeviceArrayV
 					dim++;
 				}
 			}
-			NodeArray[neigh[i]].edges[index] = idx + 1;
+			NodeEdgeIndex[12 * (neigh[i] - DLevelOffset) + index] = idx + 1;
 		}
 	}
 }
 
-__global__ void SparseSurfelFusion::device::initFaceArray(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int NodeArraySize, FaceNode* preFaceArray, bool* markPreFaceArray)
-{
-	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-	if (idx >= NodeArraySize)	return;
-	int NodeOwnerKey[6] = { device::maxIntValue, device::maxIntValue, device::maxIntValue,
-						    device::maxIntValue, device::maxIntValue, device::maxIntValue };
-	int NodeOwnerIdx[6] = { -1,-1,-1,-1,-1,-1 };
-	int nowDepth = DepthBuffer[idx];
-	float halfWidth = 1.0f / (1 << (nowDepth + 1));
-	float Width = 1.0f / (1 << nowDepth);
-	float WidthSquare = Width * Width;
-	Point3D<float> neighCenter[27];
-	int neighbor[27];
-#pragma unroll
-	for (int i = 0; i < 27; i++) {
-		neighbor[i] = NodeArray[idx].neighs[i];
-		if (neighbor[i] != -1) {
-			neighCenter[i] = CenterBuffer[neighbor[i]];
-		}
-	}
-	const Point3D<float>& nodeCenter = neighCenter[13];
-
-	Point3D<float> faceCenterPos[6];
-	int orientation;
-	int off;
-	int multi;
-	for (int i = 0; i < 6; i++) {
-		orientation = i >> 1;
-		off = i & 1;
-		multi = (2 * off) - 1;
-		faceCenterPos[i].coords[0] = nodeCenter.coords[0];
-		faceCenterPos[i].coords[1] = nodeCenter.coords[1];
-		faceCenterPos[i].coords[2] = nodeCenter.coords[2];
-		faceCenterPos[i].coords[orientation] += multi * halfWidth;
-	}
-
-	for (int i = 0; i < 6; i++) {
-		for (int j = 0; j < 27; j++) {
-			if (neighbor[j] != -1 && SquareDistance(faceCenterPos[i], neighCenter[j]) < WidthSquare) {
-				int neighKey = NodeArray[neighbor[j]].key;
-				if (NodeOwnerKey[i] > neighKey) {
-					NodeOwnerKey[i] = neighKey;
-					NodeOwnerIdx[i] = neighbor[j];
-				}
-			}
-		}
-	}
-
-	int parent = NodeArray[idx].parent;
-	int sonKey = (NodeArray[idx].key >> (3 * (device::maxDepth - nowDepth))) & 7;
-	for (int i = 0; i < 6; i++) {
-		int faceIdx = 6 * idx + i;
-		if (NodeOwnerIdx[i] == idx) {
-			preFaceArray[faceIdx].ownerNodeIdx = idx;
-			preFaceArray[faceIdx].faceKind = i;
-			if (parent == -1) {
-				preFaceArray[faceIdx].hasParentFace = -1;
-			}
-			else {
-				if (device::parentFaceKind[sonKey][i] != -1) {
-					preFaceArray[faceIdx].hasParentFace = 1;
-				}
-				else {
-					preFaceArray[faceIdx].hasParentFace = -1;
-				}
-			}
-			markPreFaceArray[faceIdx] = true;
-		}
-		else {
-			markPreFaceArray[faceIdx] = false;
-		}
-	}
-}
-
-__global__ void SparseSurfelFusion::device::maintainFaceNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int FaceArraySize, OctNode* NodeArray, FaceNode* FaceArray)
+__global__ void SparseSurfelFusion::device::maintainFaceNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int FaceArraySize, FaceNode* FaceArray, int* NodeFaceIndex)
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= FaceArraySize)	return;
@@ -393,154 +348,169 @@ __global__ void SparseSurfelFusion::device::maintainFaceNodePointer(DeviceArrayV
 			if (neighCenter[i].coords[orientation] - faceCenterPos.coords[orientation] < 0) {
 				index++;
 			}
-			NodeArray[neighbor[i]].faces[index] = idx + 1;
+			NodeFaceIndex[6 * neighbor[i] + index] = idx + 1;
 		}
 	}
 
 }
 
 
-void SparseSurfelFusion::BuildMeshGeometry::GenerateVertexArray(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, cudaStream_t stream)
+__global__ void SparseSurfelFusion::device::commitNodeElementIndex(const int* NodeVertexIndex, const int* NodeEdgeIndex, const int* NodeFaceIndex, const unsigned int NodeArraySize, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, OctNode* NodeArray)
 {
-#ifdef CHECK_MESH_BUILD_TIME_COST
-	auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
-#endif // CHECK_MESH_BUILD_TIME_COST
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= NodeArraySize)	return;
+#pragma unroll
+	for (int i = 0; i < 8; i++) {
+		NodeArray[idx].vertices[i] = NodeVertexIndex[8 * idx + i];
+	}
+#pragma unroll
+	for (int i = 0; i < 6; i++) {
+		NodeArray[idx].faces[i] = NodeFaceIndex[6 * idx + i];
+	}
+	if (idx >= DLevelOffset && idx < DLevelOffset + DLevelNodeCount) {	// 只有maxDepth层节点有边
+#pragma unroll
+		for (int i = 0; i < 12; i++) {
+			NodeArray[idx].edges[i] = NodeEdgeIndex[12 * (idx - DLevelOffset) + i];
+		}
+	}
+}
 
-	const unsigned int NodeArraySize = NodeArray.ArraySize();
-	markValidVertexArray.ResizeArrayOrException(NodeArraySize * 8);
-	VertexNode* preVertexArray = NULL;	//【中间变量】预先计算每个节点的Vertex数组，供以后筛选，占用内存巨大，内存不充足的情况下建议动态分配
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&preVertexArray), sizeof(VertexNode) * NodeArraySize * 8, stream));
 
-	int* VertexArraySize = NULL;		// 【中间变量，用完即释放】获得压缩val后数量，理论上应该和valNums相等
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&VertexArraySize), sizeof(int), stream));
+void SparseSurfelFusion::BuildMeshGeometry::compactGeometryElement(DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, const unsigned int NodeOffset, const unsigned int NodeCount, const int ElementType)
+{
+	cudaStream_t stream = ElementStream[ElementType];
+	ElementCompactBuffer& buffer = CompactBuffer[ElementType];
+	if (NodeCount == 0) {
+		ElementCountHost[ElementType] = 0;
+		CHECKCUDA(cudaEventRecord(CountReadyEvent[ElementType], stream));
+		return;
+	}
 
-	dim3 block_1(128);
-	dim3 grid_1(divUp(NodeArraySize, block_1.x));
-	device::initVertexOwner << <grid_1, block_1, 0, stream >> > (NodeArray.ArrayView(), NodeArraySize, NodeArrayDepthIndex, NodeArrayNodeCenter, preVertexArray, markValidVertexArray.Array().ptr());
+	// 每层节点以8个兄弟为一组(每层最多多出一个不满的组)，一组最多拥有27个顶点、54条边、36个面，哈希表容量取上界2倍以上的2的幂，负载不超过0.5
+	const size_t perSiblingGroup = ElementType == device::VertexElement ? 27 : (ElementType == device::EdgeElement ? 54 : 36);
+	const size_t elementsBound = (divUp(NodeCount, 8) + MAX_DEPTH_OCTREE + 1) * perSiblingGroup;
+	size_t tableCapacity = 1;
+	while (tableCapacity < 2 * elementsBound) tableCapacity <<= 1;
+
+	unsigned long long* tableKey = reserveGeometryBuffer(buffer.HashKey, tableCapacity);
+	int* tableOwner = reserveGeometryBuffer(buffer.HashOwner, tableCapacity);
+	unsigned short* ownedMask = reserveGeometryBuffer(buffer.OwnedMask, NodeCount);
+	unsigned int* ownedCount = reserveGeometryBuffer(buffer.OwnedCount, NodeCount);
+	unsigned int* ownedAddress = reserveGeometryBuffer(buffer.OwnedAddress, NodeCount);
+	CHECKCUDA(cudaMemsetAsync(tableKey, 0xFF, sizeof(unsigned long long) * tableCapacity, stream));	// 全1为空槽
+	CHECKCUDA(cudaMemsetAsync(tableOwner, 0x7F, sizeof(int) * tableCapacity, stream));				// 0x7F7F7F7F大于任何节点index
+
+	dim3 block(128);
+	dim3 grid(divUp(NodeCount, block.x));
+	device::insertGeometryElementHash << <grid, block, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, NodeOffset, NodeCount, ElementType, (unsigned int)(tableCapacity - 1), tableKey, tableOwner);
+	device::markOwnedGeometryElement << <grid, block, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, NodeOffset, NodeCount, ElementType, (unsigned int)(tableCapacity - 1), tableKey, tableOwner, ownedMask, ownedCount);
 
-	void* d_temp_storage = NULL;
 	size_t temp_storage_bytes = 0;
-	CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage, temp_storage_bytes, preVertexArray, markValidVertexArray.Array().ptr(), VertexArray.Array().ptr(), VertexArraySize, NodeArraySize * 8, stream, false));	// 确定临时设备存储需求
-	CHECKCUDA(cudaMallocAsync(&d_temp_storage, temp_storage_bytes, stream));
-	CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage, temp_storage_bytes, preVertexArray, markValidVertexArray.Array().ptr(), VertexArray.Array().ptr(), VertexArraySize, NodeArraySize * 8, stream, false));	// 筛选	
-	int VertexArraySizeHost = -1;
-	CHECKCUDA(cudaMemcpyAsync(&VertexArraySizeHost, VertexArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-	VertexArray.ResizeArrayOrException(VertexArraySizeHost);
-	//printf("NodeArrayCount = %d\nVertexArrayCount = %d\n", NodeArraySize, VertexArraySizeHost);
+	CHECKCUDA(cub::DeviceScan::InclusiveSum(NULL, temp_storage_bytes, ownedCount, ownedAddress, NodeCount, stream));
+	void* d_temp_storage = reserveGeometryBuffer(buffer.TempStorage, temp_storage_bytes > 0 ? temp_storage_bytes : 1);
+	CHECKCUDA(cub::DeviceScan::InclusiveSum(d_temp_storage, temp_storage_bytes, ownedCount, ownedAddress, NodeCount, stream));
 
-	CHECKCUDA(cudaFreeAsync(d_temp_storage, stream));	// 释放中间遍历
-	CHECKCUDA(cudaFreeAsync(VertexArraySize, stream));	// 释放中间遍历
-	CHECKCUDA(cudaFreeAsync(preVertexArray, stream));	// 释放中间遍历
+	CHECKCUDA(cudaMemcpyAsync(&ElementCountHost[ElementType], ownedAddress + NodeCount - 1, sizeof(unsigned int), cudaMemcpyDeviceToHost, stream));
+	CHECKCUDA(cudaEventRecord(CountReadyEvent[ElementType], stream));
+}
 
-	dim3 block_2(128);
-	dim3 grid_2(divUp(VertexArraySizeHost, block_2.x));
-	device::maintainVertexNodePointer << <grid_2, block_2, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, VertexArraySizeHost, VertexArray.Array().ptr(), NodeArray.Array().ptr());
+void SparseSurfelFusion::BuildMeshGeometry::BeginGenerate(DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, cudaStream_t dependStream)
+{
+	NodeArraySize = NodeArray.Size();
+	this->DLevelOffset = DLevelOffset;
+	this->DLevelNodeCount = DLevelNodeCount;
 
+	reserveGeometryBuffer(NodeVertexIndex, 8 * (size_t)NodeArraySize);
+	reserveGeometryBuffer(NodeEdgeIndex, 12 * (size_t)DLevelNodeCount);
+	reserveGeometryBuffer(NodeFaceIndex, 6 * (size_t)NodeArraySize);
 
-#ifdef CHECK_MESH_BUILD_TIME_COST
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-	auto end = std::chrono::high_resolution_clock::now();						// 记录结束时间点
-	std::chrono::duration<double, std::milli> duration = end - start;			// 计算执行时间（以ms为单位）
-	std::cout << "生成顶点Vertex索引数组的时间: " << duration.count() << " ms" << std::endl;		// 输出
-	std::cout << std::endl;
-	std::cout << "-----------------------------------------------------" << std::endl;	// 输出
-	std::cout << std::endl;
-#endif // CHECK_MESH_BUILD_TIME_COST
+	CHECKCUDA(cudaEventRecord(DependEvent, dependStream));
+	for (int i = 0; i < 3; i++) {
+		CHECKCUDA(cudaStreamWaitEvent(ElementStream[i], DependEvent, 0));
+	}
+	compactGeometryElement(NodeArrayDepthIndex, NodeArrayNodeCenter, 0, NodeArraySize, device::VertexElement);
+	compactGeometryElement(NodeArrayDepthIndex, NodeArrayNodeCenter, DLevelOffset, DLevelNodeCount, device::EdgeElement);
+	compactGeometryElement(NodeArrayDepthIndex, NodeArrayNodeCenter, 0, NodeArraySize, device::FaceElement);
 }
 
-void SparseSurfelFusion::BuildMeshGeometry::GenerateEdgeArray(DeviceBufferArray<OctNode>& NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, cudaStream_t stream)
+void SparseSurfelFusion::BuildMeshGeometry::FinishGenerate(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter)
 {
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
 #endif // CHECK_MESH_BUILD_TIME_COST
 
-	//printf("BaseAddressArray = %d  NodeArrayCount = %d\n", DLevelOffset, DLevelNodeCount);
-
-	EdgeNode* preEdgeArray = NULL;
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&preEdgeArray), sizeof(EdgeNode) * 12 * DLevelNodeCount, stream));
-
-	int* EdgeArraySize = NULL;		// 【中间变量，用完即释放】获得压缩val后数量，理论上应该和valNums相等
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&EdgeArraySize), sizeof(int), stream));
-
-	dim3 block_1(128);
-	dim3 grid_1(divUp(DLevelNodeCount, block_1.x));
-	device::initEdgeArray << <grid_1, block_1, 0, stream >> > (NodeArray.ArrayView(), DLevelOffset, DLevelNodeCount, NodeArrayDepthIndex, NodeArrayNodeCenter, preEdgeArray, markValidEdgeArray.Array().ptr());
+	// 顶点
+	CHECKCUDA(cudaEventSynchronize(CountReadyEvent[device::VertexElement]));	// 只等待顶点去重阶段
+	const unsigned int VertexArraySizeHost = ElementCountHost[device::VertexElement];
+	reserveGeometryBuffer(VertexArray, VertexArraySizeHost);	// 按实际数量分配
+	//printf("NodeArrayCount = %d\nVertexArrayCount = %d\n", NodeArraySize, VertexArraySizeHost);
+	if (VertexArraySizeHost > 0) {
+		cudaStream_t stream = ElementStream[device::VertexElement];
+		const ElementCompactBuffer& buffer = CompactBuffer[device::VertexElement];
+		dim3 block_1(128);
+		dim3 grid_1(divUp(NodeArraySize, block_1.x));
+		device::generateVertexArray << <grid_1, block_1, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, NodeArraySize, buffer.OwnedMask.Ptr(), buffer.OwnedAddress.Ptr(), VertexArray.Array().ptr());
+
+		dim3 block_2(128);
+		dim3 grid_2(divUp(VertexArraySizeHost, block_2.x));
+		device::maintainVertexNodePointer << <grid_2, block_2, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, NodeArray, VertexArraySizeHost, VertexArray.Array().ptr(), NodeVertexIndex.Ptr());
+	}
+	CHECKCUDA(cudaEventRecord(ElementReadyEvent[device::VertexElement], ElementStream[device::VertexElement]));
 
-	void* d_temp_storage = NULL;
-	size_t temp_storage_bytes = 0;
-	CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage, temp_storage_bytes, preEdgeArray, markValidEdgeArray.Array().ptr(), EdgeArray.Array().ptr(), EdgeArraySize, DLevelNodeCount * 12, stream, false));	// 确定临时设备存储需求
-	CHECKCUDA(cudaMallocAsync(&d_temp_storage, temp_storage_bytes, stream));			  
-	CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage, temp_storage_bytes, preEdgeArray, markValidEdgeArray.Array().ptr(), EdgeArray.Array().ptr(), EdgeArraySize, DLevelNodeCount * 12, stream, false));	// 筛选	
-	int EdgeArraySizeHost = -1;
-	CHECKCUDA(cudaMemcpyAsync(&EdgeArraySizeHost, EdgeArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-	EdgeArray.ResizeArrayOrException(EdgeArraySizeHost);
+	// 边
+	CHECKCUDA(cudaEventSynchronize(CountReadyEvent[device::EdgeElement]));
+	const unsigned int EdgeArraySizeHost = ElementCountHost[device::EdgeElement];
+	reserveGeometryBuffer(EdgeArray, EdgeArraySizeHost);
 	//printf("EdgeArrayCount = %d\n", EdgeArraySizeHost);
+	if (EdgeArraySizeHost > 0) {
+		cudaStream_t stream = ElementStream[device::EdgeElement];
+		const ElementCompactBuffer& buffer = CompactBuffer[device::EdgeElement];
+		dim3 block_1(128);
+		dim3 grid_1(divUp(DLevelNodeCount, block_1.x));
+		device::generateEdgeArray << <grid_1, block_1, 0, stream >> > (DLevelOffset, DLevelNodeCount, buffer.OwnedMask.Ptr(), buffer.OwnedAddress.Ptr(), EdgeArray.Array().ptr());
+
+		dim3 block_2(128);
+		dim3 grid_2(divUp(EdgeArraySizeHost, block_2.x));
+		device::maintainEdgeNodePointer << <grid_2, block_2, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, NodeArray, DLevelOffset, EdgeArraySizeHost, EdgeArray.Array().ptr(), NodeEdgeIndex.Ptr());
+	}
+	CHECKCUDA(cudaEventRecord(ElementReadyEvent[device::EdgeElement], ElementStream[device::EdgeElement]));
 
-	CHECKCUDA(cudaFreeAsync(preEdgeArray, stream));		// 释放中间遍历
-	CHECKCUDA(cudaFreeAsync(d_temp_storage, stream));	// 释放中间遍历
-	CHECKCUDA(cudaFreeAsync(EdgeArraySize, stream));	// 释放中间遍历
-
-	dim3 block_2(128);
-	dim3 grid_2(divUp(EdgeArraySizeHost, block_2.x));
-	device::maintainEdgeNodePointer << <grid_2, block_2, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, EdgeArraySizeHost, EdgeArray.Array().ptr(), NodeArray.Array().ptr());
-
+	// 面
+	CHECKCUDA(cudaEventSynchronize(CountReadyEvent[device::FaceElement]));
+	const unsigned int FaceArraySizeHost = ElementCountHost[device::FaceElement];
+	reserveGeometryBuffer(FaceArray, FaceArraySizeHost);
+	//printf("FaceArraySizeHost = %d\n",FaceArraySizeHost);
+	if (FaceArraySizeHost > 0) {
+		cudaStream_t stream = ElementStream[device::FaceElement];
+		const ElementCompactBuffer& buffer = CompactBuffer[device::FaceElement];
+		dim3 block_1(128);
+		dim3 grid_1(divUp(NodeArraySize, block_1.x));
+		device::generateFaceArray << <grid_1, block_1, 0, stream >> > (NodeArray, NodeArrayDepthIndex, NodeArraySize, buffer.OwnedMask.Ptr(), buffer.OwnedAddress.Ptr(), FaceArray.Array().ptr());
+
+		dim3 block_2(128);
+		dim3 grid_2(divUp(FaceArraySizeHost, block_2.x));
+		device::maintainFaceNodePointer << <grid_2, block_2, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, NodeArray, FaceArraySizeHost, FaceArray.Array().ptr(), NodeFaceIndex.Ptr());
+	}
+	CHECKCUDA(cudaEventRecord(ElementReadyEvent[device::FaceElement], ElementStream[device::FaceElement]));
 
 #ifdef CHECK_MESH_BUILD_TIME_COST
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
+	for (int i = 0; i < 3; i++) CHECKCUDA(cudaStreamSynchronize(ElementStream[i]));	// 流同步
 	auto end = std::chrono::high_resolution_clock::now();						// 记录结束时间点
 	std::chrono::duration<double, std::milli> duration = end - start;			// 计算执行时间（以ms为单位）
-	std::cout << "生成边Edge索引数组的时间: " << duration.count() << " ms" << std::endl;		// 输出
+	std::cout << "生成顶点、边、面索引数组的时间: " << duration.count() << " ms" << std::endl;		// 输出
 	std::cout << std::endl;
 	std::cout << "-----------------------------------------------------" << std::endl;	// 输出
 	std::cout << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 }
 
-void SparseSurfelFusion::BuildMeshGeometry::GenerateFaceArray(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, cudaStream_t stream)
+void SparseSurfelFusion::BuildMeshGeometry::CommitNodeElementIndex(DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream)
 {
-#ifdef CHECK_MESH_BUILD_TIME_COST
-	auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
-#endif // CHECK_MESH_BUILD_TIME_COST
-	const unsigned int NodeArraySize = NodeArray.ArraySize();
-
-	FaceNode* preFaceArray = NULL;
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&preFaceArray), sizeof(FaceNode) * 6 * NodeArraySize, stream));
-
-	int* FaceArraySize = NULL;		// 【中间变量，用完即释放】获得压缩val后数量，理论上应该和valNums相等
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&FaceArraySize), sizeof(int), stream));
-
-	dim3 block_1(128);
-	dim3 grid_1(divUp(NodeArraySize, block_1.x));
-	device::initFaceArray << <grid_1, block_1, 0, stream >> > (NodeArray.ArrayView(), NodeArrayDepthIndex, NodeArrayNodeCenter, NodeArraySize, preFaceArray, markValidFaceArray.Array().ptr());
-
-	void* d_temp_storage = NULL;
-	size_t temp_storage_bytes = 0;
-	CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage, temp_storage_bytes, preFaceArray, markValidFaceArray.Array().ptr(), FaceArray.Array().ptr(), FaceArraySize, NodeArraySize * 6, stream, false));	// 确定临时设备存储需求
-	CHECKCUDA(cudaMallocAsync(&d_temp_storage, temp_storage_bytes, stream));
-	CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage, temp_storage_bytes, preFaceArray, markValidFaceArray.Array().ptr(), FaceArray.Array().ptr(), FaceArraySize, NodeArraySize * 6, stream, false));	// 筛选	
-	int FaceArraySizeHost = -1;
-	CHECKCUDA(cudaMemcpyAsync(&FaceArraySizeHost, FaceArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-	FaceArray.ResizeArrayOrException(FaceArraySizeHost);
-	//printf("FaceArraySizeHost = %d\n",FaceArraySizeHost);
-
-	CHECKCUDA(cudaFreeAsync(preFaceArray, stream));		// 释放中间遍历
-	CHECKCUDA(cudaFreeAsync(FaceArraySize, stream));	// 释放中间遍历
-	CHECKCUDA(cudaFreeAsync(d_temp_storage, stream));	// 释放中间遍历
-
-	dim3 block_2(128);
-	dim3 grid_2(divUp(FaceArraySizeHost, block_2.x));
-	device::maintainFaceNodePointer << <grid_2, block_2, 0, stream >> > (NodeArrayDepthIndex, NodeArrayNodeCenter, FaceArraySizeHost, NodeArray.Array().ptr(), FaceArray.Array().ptr());
-
-#ifdef CHECK_MESH_BUILD_TIME_COST
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-	auto end = std::chrono::high_resolution_clock::now();						// 记录结束时间点
-	std::chrono::duration<double, std::milli> duration = end - start;			// 计算执行时间（以ms为单位）
-	std::cout << "生成面Face索引数组的时间: " << duration.count() << " ms" << std::endl;		// 输出
-	std::cout << std::endl;
-	std::cout << "-----------------------------------------------------" << std::endl;	// 输出
-	std::cout << std::endl;
-#endif // CHECK_MESH_BUILD_TIME_COST
+	for (int i = 0; i < 3; i++) {
+		CHECKCUDA(cudaStreamWaitEvent(stream, ElementReadyEvent[i], 0));
+	}
+	if (NodeArraySize == 0) return;
+	dim3 block(128);
+	dim3 grid(divUp(NodeArraySize, block.x));
+	device::commitNodeElementIndex << <grid, block, 0, stream >> > (NodeVertexIndex.Ptr(), NodeEdgeIndex.Ptr(), NodeFaceIndex.Ptr(), NodeArraySize, DLevelOffset, DLevelNodeCount, NodeArray.Array().ptr());
 }
@@ -10,91 +10,185 @@
 #include <base/DeviceAPI/safe_call.hpp>
 #include <base/DeviceReadWrite/DeviceBufferArray.h>
 #include <mesh/OctNode.cuh>
+#include <mesh/ReconstructionConfig.h>
+
+#define GEOMETRY_ELEMENT_COORD_BITS (MAX_DEPTH_OCTREE + 2)			// 顶点/边/面中心每个维度坐标(以半个节点宽为单位)的位数，坐标在[0, 2^(maxDepth + 1)]内
+#define GEOMETRY_ELEMENT_DEPTH_BITS 5								// 元素key中层数的位数
+#define GEOMETRY_ELEMENT_EMPTY_KEY 0xffffffffffffffffull			// 去重哈希表中的空槽
+
+// 层数与三个坐标共占用的位数小于64时，任何元素的key都不会与空槽相同
+static_assert(GEOMETRY_ELEMENT_DEPTH_BITS + 3 * GEOMETRY_ELEMENT_COORD_BITS < 64, "顶点/边/面的去重key超过64位，MAX_DEPTH_OCTREE过大");
+static_assert(MAX_DEPTH_OCTREE < (1 << GEOMETRY_ELEMENT_DEPTH_BITS), "层数超过元素key中层数的位数");
+
 namespace SparseSurfelFusion {
 	namespace device {
 		/**
-		 * \brief 初始化顶点的Owner.
+		 * \brief 去重的几何元素类型.
+		 */
+		enum GeometryElementType {
+			VertexElement = 0,	// 顶点，每个节点8个
+			EdgeElement = 1,	// 边，每个节点12条
+			FaceElement = 2		// 面，每个节点6个
+		};
+
+		/**
+		 * \brief 每个节点拥有的该类型元素数量.
+		 */
+		__forceinline__ __device__ int GeometryElementsPerNode(const int ElementType);
+
+		/**
+		 * \brief 第kind个元素中心相对节点中心的偏移(以半个节点宽为单位)，与原顶点/边/面的编号方式一致.
+		 *
+		 * \param ElementType 元素类型
+		 * \param kind 元素在节点中的编号
+		 * \param offset 【输出】每个维度的偏移，取值-1、0、1
+		 */
+		__forceinline__ __device__ void GeometryElementOffset(const int ElementType, const int kind, int offset[3]);
+
+		/**
+		 * \brief 元素的去重key：(深度, 以半个节点宽为单位的整数中心坐标)，同层相邻节点共享的元素key相同.
+		 *
+		 * \param center 节点中心
+		 * \param depth 节点深度
+		 * \param offset 元素中心相对节点中心的偏移
+		 * \return 去重key
+		 */
+		__forceinline__ __device__ unsigned long long GeometryElementKey(const Point3D<float>& center, const int depth, const int offset[3]);
+
+		/**
+		 * \brief 去重key的哈希.
+		 */
+		__forceinline__ __device__ unsigned int GeometryElementHash(unsigned long long key);
+
+		/**
+		 * \brief 将每个节点的元素插入去重哈希表，共享元素的节点中index最小的成为Owner.
 		 *
-		 * \param NodeArray 八叉树节点数组
-		 * \param NodeArraySize 八叉树节点数组大小
 		 * \param DepthBuffer 节点数组NodeArray深度查询表
 		 * \param CenterBuffer 节点数组NodeArray节点中心查询表
-		 * \param preVertexArray 预处理顶点数组计算
-		 * \param markPreVertexArray 标记有效的vertex的索引
+		 * \param NodeOffset 参与去重的第一个节点
+		 * \param NodeCount 参与去重的节点数量
+		 * \param ElementType 元素类型
+		 * \param TableMask 哈希表容量 - 1(容量为2的幂)
+		 * \param TableKey 哈希表的key，空槽为GEOMETRY_ELEMENT_EMPTY_KEY
+		 * \param TableOwner 哈希表中每个元素的Owner节点index
 		 */
-		__global__ void initVertexOwner(DeviceArrayView<OctNode> NodeArray, const unsigned int NodeArraySize, DeviceArrayView<unsigned int> depthBuffer, DeviceArrayView<Point3D<float>> centerBuffer, VertexNode* preVertexArray, bool* markPreVertexArray);
+		__global__ void insertGeometryElementHash(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int NodeOffset, const unsigned int NodeCount, const int ElementType, const unsigned int TableMask, unsigned long long* TableKey, int* TableOwner);
 
 		/**
-		 * \brief 计算两点之间距离平方.
+		 * \brief 标记每个节点拥有的元素，并统计数量.
 		 *
-		 * \param p1 点1
-		 * \param p2 点2
-		 * \return 返回两点之间距离平方
+		 * \param DepthBuffer 节点数组NodeArray深度查询表
+		 * \param CenterBuffer 节点数组NodeArray节点中心查询表
+		 * \param NodeOffset 参与去重的第一个节点
+		 * \param NodeCount 参与去重的节点数量
+		 * \param ElementType 元素类型
+		 * \param TableMask 哈希表容量 - 1
+		 * \param TableKey 哈希表的key
+		 * \param TableOwner 哈希表中每个元素的Owner节点index
+		 * \param OwnedMask 【输出】节点拥有的元素位掩码
+		 * \param OwnedCount 【输出】节点拥有的元素数量
 		 */
-		__forceinline__ __device__ double SquareDistance(const Point3D<float>& p1, const Point3D<float>& p2);
+		__global__ void markOwnedGeometryElement(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int NodeOffset, const unsigned int NodeCount, const int ElementType, const unsigned int TableMask, const unsigned long long* TableKey, const int* TableOwner, unsigned short* OwnedMask, unsigned int* OwnedCount);
 
 		/**
-		 * \brief 生成VertexArray并且将NodeArray中的vertice[8]参数赋值.
-		 * 
+		 * \brief Owner节点按前缀和地址直接写入紧凑的顶点数组.
+		 *
 		 * \param DepthBuffer 节点数组NodeArray深度查询表
 		 * \param CenterBuffer 节点数组NodeArray节点中心查询表
-		 * \param VertexArraySize 顶点数组的数量
-		 * \param VertexArray 顶点数组【可写入】
-		 * \param NodeArray 八叉树节点数组
+		 * \param NodeArraySize 八叉树节点数组大小
+		 * \param OwnedMask 节点拥有的顶点位掩码
+		 * \param OwnedAddress 节点拥有顶点数量的包含式前缀和
+		 * \param VertexArray 【输出】顶点数组
 		 */
-		__global__ void maintainVertexNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int VertexArraySize, VertexNode* VertexArray, OctNode* NodeArray);
+		__global__ void generateVertexArray(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int NodeArraySize, const unsigned short* OwnedMask, const unsigned int* OwnedAddress, VertexNode* VertexArray);
 
 		/**
-		 * \brief 初始化边数组.
-		 * 
-		 * \param NodeArray 八叉树节点数组
+		 * \brief Owner节点按前缀和地址直接写入紧凑的边数组.
+		 *
 		 * \param DLevelOffset maxDepth层节点的偏移
 		 * \param DLevelNodeCount maxDepth层节点数量
+		 * \param OwnedMask 节点拥有的边位掩码
+		 * \param OwnedAddress 节点拥有边数量的包含式前缀和
+		 * \param EdgeArray 【输出】边数组
+		 */
+		__global__ void generateEdgeArray(const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const unsigned short* OwnedMask, const unsigned int* OwnedAddress, EdgeNode* EdgeArray);
+
+		/**
+		 * \brief Owner节点按前缀和地址直接写入紧凑的面数组.
+		 *
+		 * \param NodeArray 八叉树节点数组
 		 * \param DepthBuffer 节点数组NodeArray深度查询表
-		 * \param CenterBuffer 节点数组NodeArray节点中心查询表
-		 * \param preEdgeArray 预处理的边数组
-		 * \param markPreEdgeArray 标记有效的Edge索引
+		 * \param NodeArraySize 八叉树节点数组大小
+		 * \param OwnedMask 节点拥有的面位掩码
+		 * \param OwnedAddress 节点拥有面数量的包含式前缀和
+		 * \param FaceArray 【输出】面数组
+		 */
+		__global__ void generateFaceArray(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<unsigned int> DepthBuffer, const unsigned int NodeArraySize, const unsigned short* OwnedMask, const unsigned int* OwnedAddress, FaceNode* FaceArray);
+
+		/**
+		 * \brief 计算两点之间距离平方.
+		 *
+		 * \param p1 点1
+		 * \param p2 点2
+		 * \return 返回两点之间距离平方
 		 */
-		__global__ void initEdgeArray(DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, EdgeNode* preEdgeArray, bool* markPreEdgeArray);
+		__forceinline__ __device__ double SquareDistance(const Point3D<float>& p1, const Point3D<float>& p2);
 
 		/**
-		 * \brief 生成EdgeArray并且将NodeArray中的edges[12]参数赋值.
+		 * \brief 维护VertexArray的nodes[8]，并将顶点index写入节点的顶点表(不写NodeArray，三种元素可以并发生成).
 		 * 
 		 * \param DepthBuffer 节点数组NodeArray深度查询表
 		 * \param CenterBuffer 节点数组NodeArray节点中心查询表
-		 * \param EdgeArraySize 边数组数量
-		 * \param EdgeArray 有效边数组
-		 * \param NodeArray 节点数组【可写入】
+		 * \param NodeArray 八叉树节点数组【只读】
+		 * \param VertexArraySize 顶点数组的数量
+		 * \param VertexArray 顶点数组【可写入】
+		 * \param NodeVertexIndex 【输出】每个节点8个顶点在VertexArray中的index + 1
 		 */
-		__global__ void maintainEdgeNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int EdgeArraySize, EdgeNode* EdgeArray, OctNode* NodeArray);
+		__global__ void maintainVertexNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int VertexArraySize, VertexNode* VertexArray, int* NodeVertexIndex);
 
 		/**
-		 * \brief 初始化面数组.
+		 * \brief 维护EdgeArray的nodes[4]，并将边index写入maxDepth层节点的边表.
 		 * 
-		 * \param NodeArray 八叉树节点数组【只读】
 		 * \param DepthBuffer 节点数组NodeArray深度查询表
 		 * \param CenterBuffer 节点数组NodeArray节点中心查询表
-		 * \param NodeArraySize 八叉树节点数组大小
-		 * \param preFaceArray 预处理的面数组
+		 * \param NodeArray 八叉树节点数组【只读】
+		 * \param DLevelOffset maxDepth层节点的偏移
+		 * \param EdgeArraySize 边数组数量
+		 * \param EdgeArray 有效边数组
+		 * \param NodeEdgeIndex 【输出】每个maxDepth层节点12条边在EdgeArray中的index + 1
 		 */
-		__global__ void initFaceArray(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int NodeArraySize, FaceNode* preFaceArray, bool* markPreFaceArray);
+		__global__ void maintainEdgeNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int EdgeArraySize, EdgeNode* EdgeArray, int* NodeEdgeIndex);
 
 		/**
-		 * \brief 生成FaceArray并且将NodeArray中的faces[6]参数赋值.
+		 * \brief 维护FaceArray的nodes[2]，并将面index写入节点的面表.
 		 * 
 		 * \param DepthBuffer 节点数组NodeArray深度查询表
 		 * \param CenterBuffer 节点数组NodeArray节点中心查询表
+		 * \param NodeArray 八叉树节点数组【只读】
 		 * \param FaceArraySize 面数组数量
 		 * \param FaceArray 有效面数组
-		 * \param NodeArray 节点数组【可写入】
+		 * \param NodeFaceIndex 【输出】每个节点6个面在FaceArray中的index + 1
+		 */
+		__global__ void maintainFaceNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int FaceArraySize, FaceNode* FaceArray, int* NodeFaceIndex);
+
+		/**
+		 * \brief 三种元素全部生成后，将节点的顶点、边、面表一次写回NodeArray的vertices、edges、faces.
+		 *
+		 * \param NodeVertexIndex 每个节点的顶点表
+		 * \param NodeEdgeIndex 每个maxDepth层节点的边表
+		 * \param NodeFaceIndex 每个节点的面表
+		 * \param NodeArraySize 八叉树节点数组大小
+		 * \param DLevelOffset maxDepth层节点的偏移
+		 * \param DLevelNodeCount maxDepth层节点数量
+		 * \param NodeArray 八叉树节点数组【可写入】
 		 */
-		__global__ void maintainFaceNodePointer(DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int FaceArraySize, OctNode* NodeArray, FaceNode* FaceArray);
+		__global__ void commitNodeElementIndex(const int* NodeVertexIndex, const int* NodeEdgeIndex, const int* NodeFaceIndex, const unsigned int NodeArraySize, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, OctNode* NodeArray);
 	}
 
 	class BuildMeshGeometry
 	{
 	public:
-		BuildMeshGeometry();
+		BuildMeshGeometry(const ReconstructionConfig& config = ReconstructionConfig());
 
 		~BuildMeshGeometry();
 
@@ -120,47 +214,91 @@ namespace SparseSurfelFusion {
 		 * \return 返回面数组
 		 */
 		DeviceArrayView<FaceNode> GetFaceArray() { return FaceArray.ArrayView(); }
+
 		/**
-		 * \brief 计算顶点vertex数组，并将NodeArray中的vertices数组中记录对应在VertexArray中的index，以供后续调用.
+		 * \brief 在顶点、边、面各自的流上发起哈希去重，只读NodeArray，立即返回.
+		 *        调用顺序：BeginGenerate -> FinishGenerate -> CommitNodeElementIndex，中间可以插入其他不依赖网格元素的算法(如求解器).
 		 * 
-		 * \param NodeArray 节点数组
+		 * \param NodeArray 节点数组【只读】
+		 * \param DLevelOffset maxDepth层偏移
+		 * \param DLevelNodeCount maxDepth层节点数量
 		 * \param NodeArrayDepthIndex 节点深度查询数组
 		 * \param NodeArrayNodeCenter 节点中心查询数组
-		 * \param stream cuda流
+		 * \param dependStream 生成NodeArray的流，三个元素流先等待它
 		 */
-		void GenerateVertexArray(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, cudaStream_t stream);
+		void BeginGenerate(DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, cudaStream_t dependStream);
 
 		/**
-		 * \brief 计算边edge数组，并将NodeArray中的edges数组中记录对应在EdgeArray中的index，以供后续调用.
+		 * \brief 等待去重数量(只等待元素流上的去重阶段)，按实际数量分配元素数组，并在元素流上发起生成与节点表维护，立即返回.
 		 * 
-		 * \param NodeArray 节点数组
-		 * \param DLevelOffset maxDepth层偏移
-		 * \param DLevelNodeCount maxDepth层节点数量
+		 * \param NodeArray 节点数组【只读】
 		 * \param NodeArrayDepthIndex 节点深度查询数组
 		 * \param NodeArrayNodeCenter 节点中心查询数组
-		 * \param stream cuda流
 		 */
-		void GenerateEdgeArray(DeviceBufferArray<OctNode>& NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, cudaStream_t stream);
+		void FinishGenerate(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter);
 
 		/**
-		 * \brief 计算顶点face数组，并将NodeArray中的faces数组中记录对应在FaceArray中的index，以供后续调用.
-		 *
-		 * \param NodeArray 节点数组
-		 * \param NodeArrayDepthIndex 节点深度查询数组
-		 * \param NodeArrayNodeCenter 节点中心查询数组
-		 * \param stream cuda流
+		 * \brief stream等待三个元素流完成，再将节点的顶点、边、面表写回NodeArray，之后stream上的算法可以使用VertexArray、EdgeArray、FaceArray与NodeArray中的索引.
+		 * 
+		 * \param NodeArray 节点数组【可写入】
+		 * \param stream 后续使用网格元素的流
 		 */
-		void GenerateFaceArray(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, cudaStream_t stream);
+		void CommitNodeElementIndex(DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream);
 
 	private:
+		/**
+		 * \brief 单种元素哈希去重使用的缓存，三种元素各一份，以便在各自的流上并发.
+		 */
+		struct ElementCompactBuffer {
+			DeviceBufferArray<unsigned long long> HashKey;		// 去重哈希表的key
+			DeviceBufferArray<int> HashOwner;					// 去重哈希表中元素的Owner节点
+			DeviceBufferArray<unsigned short> OwnedMask;		// 节点拥有的元素位掩码
+			DeviceBufferArray<unsigned int> OwnedCount;			// 节点拥有的元素数量
+			DeviceBufferArray<unsigned int> OwnedAddress;		// 节点拥有元素数量的包含式前缀和
+			DeviceBufferArray<unsigned char> TempStorage;		// cub临时存储
+		};
+
 		DeviceBufferArray<VertexNode> VertexArray;			// 顶点数组
 		DeviceBufferArray<EdgeNode> EdgeArray;				// 边数组
 		DeviceBufferArray<FaceNode> FaceArray;				// 面数组
 
-		DeviceBufferArray<bool> markValidVertexArray;		// 记录有效的顶点位置，即ownerNodeIdx > 0找到了拥有者节点的vertex 
-		DeviceBufferArray<bool> markValidEdgeArray;			// 记录有效边
-		DeviceBufferArray<bool> markValidFaceArray;			// 记录有效面
-	};
-}
+		DeviceBufferArray<int> NodeVertexIndex;				// 每个节点8个顶点的index + 1，与OctNode::vertices一致
+		DeviceBufferArray<int> NodeEdgeIndex;				// 每个maxDepth层节点12条边的index + 1，与OctNode::edges一致
+		DeviceBufferArray<int> NodeFaceIndex;				// 每个节点6个面的index + 1，与OctNode::faces一致
+
+		ElementCompactBuffer CompactBuffer[3];				// 按GeometryElementType索引
+		cudaStream_t ElementStream[3];						// 顶点、边、面各自的流
+		cudaEvent_t DependEvent;							// NodeArray生成完毕
+		cudaEvent_t CountReadyEvent[3];						// 去重数量已拷贝到Host
+		cudaEvent_t ElementReadyEvent[3];					// 元素数组与节点表已生成
+		unsigned int* ElementCountHost = NULL;				// 【页锁定】去重后的元素数量
+		unsigned int NodeArraySize = 0;						// 本次生成的节点数量
+		unsigned int DLevelOffset = 0;						// 本次生成的maxDepth层偏移
+		unsigned int DLevelNodeCount = 0;					// 本次生成的maxDepth层节点数量
 
+		/**
+		 * \brief 保证buffer至少容纳size个元素并将数组大小设为size，不足时按1.5倍扩容(不保留原数据).
+		 */
+		template<typename T>
+		static T* reserveGeometryBuffer(DeviceBufferArray<T>& buffer, const size_t size) {
+			if (size > buffer.BufferSize()) {
+				buffer.ReleaseBuffer();		// cudaFree会等待设备上已提交的任务完成，旧缓存不会被正在执行的核函数访问
+				buffer.AllocateBuffer(static_cast<size_t>(size * 1.5));
+			}
+			buffer.ResizeArrayOrException(size);
+			return buffer.Ptr();
+		}
 
+		/**
+		 * \brief 在ElementStream[ElementType]上哈希去重[NodeOffset, NodeOffset + NodeCount)节点的顶点/边/面，
+		 *        结果留在CompactBuffer[ElementType]中，去重数量异步拷贝到ElementCountHost[ElementType].
+		 *
+		 * \param NodeArrayDepthIndex 节点深度查询数组
+		 * \param NodeArrayNodeCenter 节点中心查询数组
+		 * \param NodeOffset 参与去重的第一个节点
+		 * \param NodeCount 参与去重的节点数量
+		 * \param ElementType 元素类型
+		 */
+		void compactGeometryElement(DeviceArrayView<unsigned int> NodeArrayDepthIndex, DeviceArrayView<Point3D<float>> NodeArrayNodeCenter, const unsigned int NodeOffset, const unsigned int NodeCount, const int ElementType);
+	};
+}
@@ -7,46 +7,61 @@
  *********************************************************************/
 #include "BuildOctree.h"
 
-SparseSurfelFusion::BuildOctree::BuildOctree()
+SparseSurfelFusion::BuildOctree::BuildOctree(const ReconstructionConfig& config)
 {
 	
-	sampleOrientedPoints.AllocateBuffer(MAX_SURFEL_COUNT);
-	perBlockMaxPoint.AllocateBuffer(divUp(MAX_SURFEL_COUNT, device::MaxCudaThreadsPerBlock));
-	perBlockMinPoint.AllocateBuffer(divUp(MAX_SURFEL_COUNT, device::MaxCudaThreadsPerBlock));
-	sortCode.AllocateBuffer(MAX_SURFEL_COUNT);
+	sampleOrientedPoints.AllocateBuffer(config.maxSurfelCount);
+	boundingBox.AllocateBuffer(1);
+	normalizeTransform.AllocateBuffer(1);
+	CHECKCUDA(cudaMemset(normalizeTransform.Ptr(), 0, sizeof(NormalizeTransform)));
+	CHECKCUDA(cudaMallocHost(reinterpret_cast<void**>(&normalizeTransformHost), sizeof(NormalizeTransform)));
+	normalizeTransformHost->center = make_float3(0.0f, 0.0f, 0.0f);
+	normalizeTransformHost->maxEdge = 1.0f;
+	normalizeTransformHost->recomputed = 0;
+	CHECKCUDA(cudaEventCreateWithFlags(&normalizeTransformReady, cudaEventDisableTiming));
+	sortCode.AllocateBuffer(config.maxSurfelCount);
 
-	pointKeySort.AllocateBuffer(MAX_SURFEL_COUNT);
-	keyLabel.AllocateBuffer(MAX_SURFEL_COUNT);
-	uniqueCode.AllocateBuffer(MAX_SURFEL_COUNT);
-	compactedVerticesOffset.AllocateBuffer(MAX_SURFEL_COUNT);
+	pointKeySort.AllocateBuffer(config.maxSurfelCount);
+	keyLabel.AllocateBuffer(config.maxSurfelCount);
+	uniqueCode.AllocateBuffer(config.maxSurfelCount);
+	compactedVerticesOffset.AllocateBuffer(config.maxSurfelCount);
 
-	nodeNums.AllocateBuffer(MAX_SURFEL_COUNT);
-	nodeNumsPrefixsum.AllocateBuffer(MAX_SURFEL_COUNT);
+	nodeNums.AllocateBuffer(config.maxSurfelCount);
+	nodeNumsPrefixsum.AllocateBuffer(config.maxSurfelCount);
 
-	Point2NodeArray.AllocateBuffer(MAX_SURFEL_COUNT);
+	Point2NodeArray.AllocateBuffer(config.maxSurfelCount);
 
-	uniqueNodeD.AllocateBuffer(MAX_SURFEL_COUNT);
-	uniqueNodePrevious.AllocateBuffer(MAX_SURFEL_COUNT);
+	uniqueNodeD.AllocateBuffer(config.maxSurfelCount);
+	uniqueNodePrevious.AllocateBuffer(config.maxSurfelCount);
 
-	nodeAddressD.AllocateBuffer(MAX_SURFEL_COUNT);
-	nodeAddressPrevious.AllocateBuffer(MAX_SURFEL_COUNT);
+	nodeAddressD.AllocateBuffer(config.maxSurfelCount);
+	nodeAddressPrevious.AllocateBuffer(config.maxSurfelCount);
 
-	NodeArray.AllocateBuffer(TOTAL_NODEARRAY_MAX_COUNT);					// 预估10倍最大节点
-	EncodedFunctionNodeIndex.AllocateBuffer(TOTAL_NODEARRAY_MAX_COUNT);
-	NodeAddressFull.AllocateBuffer(D_LEVEL_MAX_NODE);						// 最坏情况应该是8 * MAX_SURFEL_COUNT
+	NodeArray.AllocateBuffer(config.TotalNodeArrayCount());					// 预估10倍最大节点
+	EncodedFunctionNodeIndex.AllocateBuffer(config.TotalNodeArrayCount());
+	NodeAddressFull.AllocateBuffer(config.DLevelMaxNode());						// 最坏情况应该是8 * maxSurfelCount
 
 	BaseAddressArray_Device.AllocateBuffer(Constants::maxDepth_Host + 1);
 
-	NodeArrayDepthIndex.AllocateBuffer(TOTAL_NODEARRAY_MAX_COUNT);
-	NodeArrayNodeCenter.AllocateBuffer(TOTAL_NODEARRAY_MAX_COUNT);
+	NodeArrayDepthIndex.AllocateBuffer(config.TotalNodeArrayCount());
+	NodeArrayNodeCenter.AllocateBuffer(config.TotalNodeArrayCount());
+
+	dirtyCounter.AllocateBuffer(2);
+	dirtyCounter.ResizeArrayOrException(2);
+	levelUniqueCount.AllocateBuffer(Constants::maxDepth_Host + 1);
+	levelUniqueCount.ResizeArrayOrException(Constants::maxDepth_Host + 1);
 
 }
 
 SparseSurfelFusion::BuildOctree::~BuildOctree()
 {
 	sampleOrientedPoints.ReleaseBuffer();
-	perBlockMaxPoint.DeviceArray().release();
-	perBlockMinPoint.DeviceArray().release();
+	CHECKCUDA(cudaEventSynchronize(normalizeTransformReady));
+	CHECKCUDA(cudaEventDestroy(normalizeTransformReady));
+	CHECKCUDA(cudaFreeHost(normalizeTransformHost));
+	boundingBox.ReleaseBuffer();
+	normalizeTransform.ReleaseBuffer();
+	reduceTempStorage.ReleaseBuffer();
 	sortCode.ReleaseBuffer();
 
 	keyLabel.ReleaseBuffer();
@@ -70,9 +85,36 @@ SparseSurfelFusion::BuildOctree::~BuildOctree()
 	NodeArrayDepthIndex.ReleaseBuffer();
 	NodeArrayNodeCenter.ReleaseBuffer();
 
+	NodeKeys.ReleaseBuffer();
+	NodeParents.ReleaseBuffer();
+	NodeChildren.ReleaseBuffer();
+	NodeNeighbors.ReleaseBuffer();
+
+	previousKeysD.ReleaseBuffer();
+	previousSignatureD.ReleaseBuffer();
+	KeysD.ReleaseBuffer();
+	SignatureD.ReleaseBuffer();
+	DirtyNodeD.ReleaseBuffer();
+	dirtyCounter.DeviceArray().release();
+	levelUniqueCount.DeviceArray().release();
+}
+
+void SparseSurfelFusion::BuildOctree::SetFixedBoundingBox(const Point3D<float>& minPoint, const Point3D<float>& maxPoint, const float scaleFactor)
+{
+	float maxEdge = 0.0f;
+	for (int i = 0; i < DIMENSION; i++) {
+		if (maxPoint[i] - minPoint[i] > maxEdge) maxEdge = maxPoint[i] - minPoint[i];
+	}
+	if (maxEdge <= 0.0f) LOGGING(FATAL) << "固定包围盒的最长边必须大于0";
+	maxEdge *= scaleFactor;		// 与自动包围盒相同的放缩与居中
+	fixedTransform.center = make_float3((maxPoint[0] + minPoint[0]) / 2.0f - maxEdge / 2.0f, (maxPoint[1] + minPoint[1]) / 2.0f - maxEdge / 2.0f, (maxPoint[2] + minPoint[2]) / 2.0f - maxEdge / 2.0f);
+	fixedTransform.maxEdge = maxEdge;
+	fixedTransform.recomputed = 1;
+	fixedBoundingBox = true;
+	fixedTransformPending = true;
 }
 
-void SparseSurfelFusion::BuildOctree::BuildNodesArray(DeviceArrayView<DepthSurfel> depthSurfel, pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals, cudaStream_t stream)
+void SparseSurfelFusion::BuildOctree::BuildNodesArray(DeviceArrayView<DepthSurfel> depthSurfel, pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals, cudaStream_t stream, cudaEvent_t inputReady, cudaEvent_t inputConsumed)
 {
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
@@ -84,10 +126,6 @@ void SparseSurfelFusion::BuildOctree::BuildNodesArray(DeviceArrayView<DepthSurfe
 	sampleOrientedPoints.ResizeArrayOrException(count);
 
 	/***************************************** Step.1：计算BoundingBox *****************************************/
-	Point3D<float> MaxPoint = Point3D<float>(float(-1e6), float(-1e6), float(-1e6));// 用于框定点云x,y,z最大值
-	Point3D<float> MinPoint = Point3D<float>(float(1e6), float(1e6), float(1e6));	// 用于框定点云x,y,z最小值
-	Point3D<float> center;		// BoundingBox的中心
-	float maxEdge = 1.0f;		// BoundingBox的最长的边长
 	float scaleFactor = 1.25f;	// 放缩尺寸【大于1：将所有点云在[0, 1]的范围压缩；小于1：点云将超出[0, 1]；等于1：x,y,z最大分量 == 1】
 
 #ifdef CHECK_MESH_BUILD_TIME_COST
@@ -95,16 +133,12 @@ void SparseSurfelFusion::BuildOctree::BuildNodesArray(DeviceArrayView<DepthSurfe
 #endif // CHECK_MESH_BUILD_TIME_COST
 
 
-	// DenseSurfel转成Point3D
+	// DenseSurfel转成Point3D，之后不再读取depthSurfel
+	if (inputReady != NULL) CHECKCUDA(cudaStreamWaitEvent(stream, inputReady, 0));
 	getCoordinateAndNormal(depthSurfel, stream);		
-	// 获得包围盒(归约算法)
-	getBoundingBox(sampleOrientedPoints.ArrayView(), MaxPoint, MinPoint, stream);
-
-	//// 包围盒可视化
-	//BoundBoxVisualization(cloud, MaxPoint, MinPoint);
-
-	// 调整根据scaleFactor调整各个点云坐标位置
-	adjustPointsCoordinateAndNormal(sampleOrientedPoints, MaxPoint, MinPoint, maxEdge, scaleFactor, center, stream);
+	if (inputConsumed != NULL) CHECKCUDA(cudaEventRecord(inputConsumed, stream));
+	// 获得包围盒与归一化变换(设备端归约，增量模式下包围盒仍在冻结的归一化范围内则复用，固定包围盒时跳过归约)
+	computeNormalizeTransform(sampleOrientedPoints.ArrayView(), scaleFactor, stream);
 
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));
@@ -113,8 +147,8 @@ void SparseSurfelFusion::BuildOctree::BuildNodesArray(DeviceArrayView<DepthSurfe
 	std::cout << "调整坐标时间: " << duration1.count() << " ms" << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 
-	/***************************************** Step.2：计算打乱的xyz键和排序编码 *****************************************/
-	generateCode(sampleOrientedPoints, sortCode, count, stream);	// 计算编码
+	/***************************************** Step.2：归一化坐标、放缩法线并计算打乱的xyz键和排序编码 *****************************************/
+	normalizeAndEncode(sampleOrientedPoints, sortCode, count, stream);	// 融合的归一化与编码
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));
 	auto time3 = std::chrono::high_resolution_clock::now();							// 记录结束时间点
@@ -143,7 +177,8 @@ void SparseSurfelFusion::BuildOctree::BuildNodesArray(DeviceArrayView<DepthSurfe
 #endif // CHECK_MESH_BUILD_TIME_COST
 
 	/***************************************** Step.6 创建Octree节点数组：NodeArrayD *****************************************/
-	buildNodeArrayD(sampleOrientedPoints.ArrayView(), uniqueNodeD.ArrayView(), uniqueCode.ArrayView(), nodeAddressD, NodeAddressFull, Point2NodeArray, NodeArrays[Constants::maxDepth_Host], stream);
+	computeLevelLayout(uniqueCode.ArrayView(), stream);		// 一次确定所有层的规模与偏移
+	buildNodeArrayD(sampleOrientedPoints.ArrayView(), uniqueNodeD.ArrayView(), uniqueCode.ArrayView(), nodeAddressD, NodeAddressFull, Point2NodeArray, NodeArray, stream);
 
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));
@@ -171,8 +206,18 @@ void SparseSurfelFusion::BuildOctree::BuildNodesArray(DeviceArrayView<DepthSurfe
 #endif // CHECK_MESH_BUILD_TIME_COST
 
 	/***************************************** Step.9 构建每个节点的邻居节点 *****************************************/
-	computeNodeNeighbor(NodeArray, stream);
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 此时需要同步，后续这里的参数要被两个不同流同时使用
+	if (incrementalMode) detectDirtyNodes(stream);	// 与上一帧比较D层节点
+	if (incrementalMode && topologyUnchanged && !compressedTopology) {
+		restoreNodeNeighbor(NodeArray, stream);		// 拓扑与上一帧相同，邻居与SoA拓扑数组沿用上一帧
+	}
+	else if (incrementalMode && topologyUnchanged) {
+		computeNodeNeighbor(NodeArray, stream);		// 压缩拓扑模式没有SoA邻居可恢复，重新计算OctNode::neighs，SoA的key/父子沿用上一帧
+	}
+	else {
+		computeNodeNeighbor(NodeArray, stream);
+		splitNodeTopology(NodeArray, stream);		// 拓扑已不再变化，拆分出只读的SoA拓扑数组
+	}
+	// 不在此处同步：其他流上的算法由调用方通过事件等待stream
 
 	//printf("NodeArrayCount = %d\n", NodeArray.ArraySize());
 
@@ -193,6 +238,7 @@ void SparseSurfelFusion::BuildOctree::BuildNodesArray(DeviceArrayView<DepthSurfe
 
 }
 
+#if RECONSTRUCTION_WITH_PCL_IO
 void SparseSurfelFusion::BuildOctree::BoundBoxVisualization(const pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, Point3D<float> MaxPoint, Point3D<float> MinPoint)
 {
 	//----------------可视化--------------
@@ -210,4 +256,5 @@ void SparseSurfelFusion::BuildOctree::BoundBoxVisualization(const pcl::PointClou
 		viewer->spinOnce(100);
 	}
 	system("pause");
-}
\ No newline at end of file
+}
+#endif // RECONSTRUCTION_WITH_PCL_IO
\ No newline at end of file
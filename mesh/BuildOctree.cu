@@ -6,10 +6,34 @@
  * \date   May 5th 2024
  *********************************************************************/
 #include "BuildOctree.h"
+#include <cfloat>
+#include <cub/cub.cuh>
 
 namespace SparseSurfelFusion {
 	namespace device {
-		__device__ __constant__ int BaseAddressArray_Device[Constants::maxDepth_Host + 1] = { 0 };	// 记录每层节点首地址的位置
+		/**
+		 * \brief 单个点的退化包围盒，作为cub归约的输入迭代器变换.
+		 */
+		struct PointToBoundingBox {
+			__host__ __device__ __forceinline__ PointBoundingBox operator()(const OrientedPoint3D<float>& point) const {
+				PointBoundingBox box;
+				box.minPoint = make_float3(point.point.coords[0], point.point.coords[1], point.point.coords[2]);
+				box.maxPoint = box.minPoint;
+				return box;
+			}
+		};
+
+		/**
+		 * \brief 合并两个包围盒，cub归约算子.
+		 */
+		struct MergeBoundingBox {
+			__host__ __device__ __forceinline__ PointBoundingBox operator()(const PointBoundingBox& lhs, const PointBoundingBox& rhs) const {
+				PointBoundingBox box;
+				box.minPoint = make_float3(fminf(lhs.minPoint.x, rhs.minPoint.x), fminf(lhs.minPoint.y, rhs.minPoint.y), fminf(lhs.minPoint.z, rhs.minPoint.z));
+				box.maxPoint = make_float3(fmaxf(lhs.maxPoint.x, rhs.maxPoint.x), fmaxf(lhs.maxPoint.y, rhs.maxPoint.y), fmaxf(lhs.maxPoint.z, rhs.maxPoint.z));
+				return box;
+			}
+		};
 
 		__device__ __constant__ double eps = EPSILON;
 
@@ -48,88 +72,33 @@ __device__ float SparseSurfelFusion::device::Length(const float3& vec)
 	return sqrtf(vec.x * vec.x + vec.y * vec.y + vec.z * vec.z);
 }
 
-__global__ void SparseSurfelFusion::device::reduceMaxMinKernel(Point3D<float>* maxBlockData, Point3D<float>* minBlockData, DeviceArrayView<OrientedPoint3D<float>> points, const unsigned int pointsCount)
+__global__ void SparseSurfelFusion::device::computeNormalizeTransformKernel(const PointBoundingBox* boundingBox, const float scaleFactor, const bool reuseFrozen, NormalizeTransform* transform)
 {
-	unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
-	__shared__ float MaxPointX[MaxCudaThreadsPerBlock];
-	__shared__ float MaxPointY[MaxCudaThreadsPerBlock];
-	__shared__ float MaxPointZ[MaxCudaThreadsPerBlock];
-	__shared__ float MinPointX[MaxCudaThreadsPerBlock];
-	__shared__ float MinPointY[MaxCudaThreadsPerBlock];
-	__shared__ float MinPointZ[MaxCudaThreadsPerBlock];
-	if (idx < pointsCount) {	// 下方reduce的时候可能会访存出界(threadIdx.x + stride >= pointsCount)，如果上面直接返回的话，__shared__数组在某个线程上必然有没赋值的情况
-		MaxPointX[threadIdx.x] = points[idx].point.coords[0];
-		MaxPointY[threadIdx.x] = points[idx].point.coords[1];
-		MaxPointZ[threadIdx.x] = points[idx].point.coords[2];
-		MinPointX[threadIdx.x] = points[idx].point.coords[0];
-		MinPointY[threadIdx.x] = points[idx].point.coords[1];
-		MinPointZ[threadIdx.x] = points[idx].point.coords[2];
-	}
-	else {
-		MaxPointX[threadIdx.x] = -1e6;
-		MaxPointY[threadIdx.x] = -1e6;
-		MaxPointZ[threadIdx.x] = -1e6;
-		MinPointX[threadIdx.x] = 1e6;
-		MinPointY[threadIdx.x] = 1e6;
-		MinPointZ[threadIdx.x] = 1e6;
-	}
-
-	__syncthreads();
-	// 顺序寻址
-	for (int stride = blockDim.x / 2; stride > 0; stride /= 2) {
-		if (threadIdx.x < stride) {
-			float lhs, rhs;
-			/** 最大值 **/
-			lhs = MaxPointX[threadIdx.x];
-			rhs = MaxPointX[threadIdx.x + stride];
-			MaxPointX[threadIdx.x] = lhs < rhs ? rhs : lhs;
-
-			lhs = MaxPointY[threadIdx.x];
-			rhs = MaxPointY[threadIdx.x + stride];
-			MaxPointY[threadIdx.x] = lhs < rhs ? rhs : lhs;
-
-			lhs = MaxPointZ[threadIdx.x];
-			rhs = MaxPointZ[threadIdx.x + stride];
-			MaxPointZ[threadIdx.x] = lhs < rhs ? rhs : lhs;
-
-			/** 最小值 **/
-			lhs = MinPointX[threadIdx.x];
-			rhs = MinPointX[threadIdx.x + stride];
-			MinPointX[threadIdx.x] = lhs > rhs ? rhs : lhs;
-
-			lhs = MinPointY[threadIdx.x];
-			rhs = MinPointY[threadIdx.x + stride];
-			MinPointY[threadIdx.x] = lhs > rhs ? rhs : lhs;
-
-			lhs = MinPointZ[threadIdx.x];
-			rhs = MinPointZ[threadIdx.x + stride];
-			MinPointZ[threadIdx.x] = lhs > rhs ? rhs : lhs;
+	const float3 minPoint = boundingBox->minPoint;
+	const float3 maxPoint = boundingBox->maxPoint;
+	if (reuseFrozen) {
+		const NormalizeTransform frozen = *transform;
+		const float frozenMargin = 0.5f * (1.0f - 1.0f / scaleFactor) * 0.5f * frozen.maxEdge;
+		const bool inside = minPoint.x >= frozen.center.x + frozenMargin && maxPoint.x <= frozen.center.x + frozen.maxEdge - frozenMargin &&
+							minPoint.y >= frozen.center.y + frozenMargin && maxPoint.y <= frozen.center.y + frozen.maxEdge - frozenMargin &&
+							minPoint.z >= frozen.center.z + frozenMargin && maxPoint.z <= frozen.center.z + frozen.maxEdge - frozenMargin;
+		if (inside) {
+			transform->recomputed = 0;
+			return;
 		}
-		__syncthreads();
-	}
-	if (threadIdx.x == 0) {	// 该block的第一个线程
-		maxBlockData[blockIdx.x].coords[0] = MaxPointX[threadIdx.x];
-		maxBlockData[blockIdx.x].coords[1] = MaxPointY[threadIdx.x];
-		maxBlockData[blockIdx.x].coords[2] = MaxPointZ[threadIdx.x];
-
-		minBlockData[blockIdx.x].coords[0] = MinPointX[threadIdx.x];
-		minBlockData[blockIdx.x].coords[1] = MinPointY[threadIdx.x];
-		minBlockData[blockIdx.x].coords[2] = MinPointZ[threadIdx.x];
 	}
+	// 获取BoundingBox最长的一条边并调整尺寸，BoundingBox中点移到[0, 1]立方体中心
+	const float maxEdge = fmaxf(fmaxf(maxPoint.x - minPoint.x, maxPoint.y - minPoint.y), maxPoint.z - minPoint.z) * scaleFactor;
+	NormalizeTransform result;
+	result.center = make_float3((maxPoint.x + minPoint.x) / 2.0f - maxEdge / 2.0f, (maxPoint.y + minPoint.y) / 2.0f - maxEdge / 2.0f, (maxPoint.z + minPoint.z) / 2.0f - maxEdge / 2.0f);
+	result.maxEdge = maxEdge;
+	result.recomputed = 1;
+	*transform = result;
 }
 
-__host__ void SparseSurfelFusion::device::findMaxMinPoint(Point3D<float>& MaxPoint, Point3D<float>& MinPoint, Point3D<float>* maxArray, Point3D<float>* minArray, const unsigned int GridNum)
+__global__ void SparseSurfelFusion::device::setNormalizeTransformKernel(const NormalizeTransform fixedTransform, NormalizeTransform* transform)
 {
-	// 通常不超过1000
-	for (unsigned int i = 0; i < GridNum; i++) {
-		MaxPoint.coords[0] = MaxPoint.coords[0] < maxArray[i].coords[0] ? maxArray[i].coords[0] : MaxPoint.coords[0];
-		MaxPoint.coords[1] = MaxPoint.coords[1] < maxArray[i].coords[1] ? maxArray[i].coords[1] : MaxPoint.coords[1];
-		MaxPoint.coords[2] = MaxPoint.coords[2] < maxArray[i].coords[2] ? maxArray[i].coords[2] : MaxPoint.coords[2];
-
-		MinPoint.coords[0] = MinPoint.coords[0] > minArray[i].coords[0] ? minArray[i].coords[0] : MinPoint.coords[0];
-		MinPoint.coords[1] = MinPoint.coords[1] > minArray[i].coords[1] ? minArray[i].coords[1] : MinPoint.coords[1];
-		MinPoint.coords[2] = MinPoint.coords[2] > minArray[i].coords[2] ? minArray[i].coords[2] : MinPoint.coords[2];
-	}
+	*transform = fixedTransform;
 }
 
 __global__ void SparseSurfelFusion::device::getCoordinateAndNormalKernel(OrientedPoint3D<float>* point, DeviceArrayView<DepthSurfel> PointCloud, const unsigned int pointsCount)
@@ -141,56 +110,31 @@ __global__ void SparseSurfelFusion::device::getCoordinateAndNormalKernel(Oriente
 	point[idx].color = Point3D<float>(PointCloud[idx].ColorAndTime.x, PointCloud[idx].ColorAndTime.y, PointCloud[idx].ColorAndTime.z);
 }
 
-__global__ void SparseSurfelFusion::device::adjustPointsCoordinateAndNormalKernel(OrientedPoint3D<float>* points, const Point3D<float> center, const float maxEdge, const unsigned int pointsCount)
-{
-	unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
-	if (idx >= pointsCount) return;
-	for (int i = 0; i < DIMENSION; i++) {
-		points[idx].point.coords[i] = (points[idx].point.coords[i] - center.coords[i]) * 1.0f / maxEdge;
-	}
-
-	// 将法线放缩到[-2^(maxDepth + 1), 2^(maxDepth + 1)]这个区间，而非[-1, 1]
-	float3 PointNormal;
-	PointNormal.x = points[idx].normal.coords[0];
-	PointNormal.y = points[idx].normal.coords[1];
-	PointNormal.z = points[idx].normal.coords[2];
-	float len = device::Length(PointNormal);
-	if (len > device::eps) {
-		len = 1.0f / len;
-	}
-	len *= (2 << device::maxDepth);
-	for (int i = 0; i < DIMENSION; i++) {
-		points[idx].normal.coords[i] *= len;
-	}
-}
-
-__global__ void SparseSurfelFusion::device::generateCodeKernel(OrientedPoint3D<float>* pos, long long* keys, const unsigned int pointsNum)
+__device__ long long SparseSurfelFusion::device::computePointCode(const Point3D<float>& point)
 {
-	unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;	// unsigned int 到 2 * (2^31 - 1) = 42.95亿 
-	if (idx >= pointsNum)	return;
 	long long key = 0ll;	// 当前稠密点的key
 	Point3D<float> myCenter = Point3D<float>(0.5f, 0.5f, 0.5f);
 	float myWidth = 0.25f;
-	// node编码规则，Key前32位：x0y0z0 x1y1z1 ... xD-1 yD-1 zD-1  ->  D最多10层
+	// node编码规则，从OCTREE_CODE_SHIFT位开始：x0y0z0 x1y1z1 ... xD-1 yD-1 zD-1  ->  D不超过10层时从32位开始，否则低位的index让出位数
 	for (int i = device::maxDepth - 1; i >= 0; i--) {	// 从0层开始构建
-		if (pos[idx].point.coords[0] > myCenter.coords[0]) {	// x在中心点右边，编码为1
-			key |= 1ll << (3 * i + 34);		// 按照编码顺序将1移到对应位置
+		if (point.coords[0] > myCenter.coords[0]) {	// x在中心点右边，编码为1
+			key |= 1ll << (3 * i + OCTREE_CODE_SHIFT + 2);		// 按照编码顺序将1移到对应位置
 			myCenter.coords[0] += myWidth;
 		}
 		else {								// key默认为0，在左边则无需将编码为置为0
 			myCenter.coords[0] -= myWidth;	
 		}
 
-		if (pos[idx].point.coords[1] > myCenter.coords[1]) {
-			key |= 1ll << (3 * i + 33);
+		if (point.coords[1] > myCenter.coords[1]) {
+			key |= 1ll << (3 * i + OCTREE_CODE_SHIFT + 1);
 			myCenter.coords[1] += myWidth;
 		}
 		else {
 			myCenter.coords[1] -= myWidth;
 		}
 
-		if (pos[idx].point.coords[2] > myCenter.coords[2]) {
-			key |= 1ll << (3 * i + 32);
+		if (point.coords[2] > myCenter.coords[2]) {
+			key |= 1ll << (3 * i + OCTREE_CODE_SHIFT);
 			myCenter.coords[2] += myWidth;
 		}
 		else {
@@ -198,13 +142,38 @@ __global__ void SparseSurfelFusion::device::generateCodeKernel(OrientedPoint3D<f
 		}
 		myWidth /= 2.0f;
 	}
+	return key;
+}
+
+__global__ void SparseSurfelFusion::device::normalizeAndEncodeKernel(OrientedPoint3D<float>* points, const NormalizeTransform* transform, long long* keys, const unsigned int pointsNum)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;	// unsigned int 到 2 * (2^31 - 1) = 42.95亿 
+	if (idx >= pointsNum)	return;
+	const NormalizeTransform normalize = *transform;
+	OrientedPoint3D<float> point = points[idx];
+	point.point.coords[0] = (point.point.coords[0] - normalize.center.x) / normalize.maxEdge;
+	point.point.coords[1] = (point.point.coords[1] - normalize.center.y) / normalize.maxEdge;
+	point.point.coords[2] = (point.point.coords[2] - normalize.center.z) / normalize.maxEdge;
+
+	// 将法线放缩到[-2^(maxDepth + 1), 2^(maxDepth + 1)]这个区间，而非[-1, 1]
+	float len = device::Length(make_float3(point.normal.coords[0], point.normal.coords[1], point.normal.coords[2]));
+	if (len > device::eps) {
+		len = 1.0f / len;
+	}
+	len *= (2 << device::maxDepth);
+	for (int i = 0; i < DIMENSION; i++) {
+		point.normal.coords[i] *= len;
+	}
+	points[idx] = point;
 	// 既记录了node的位置，又记录了这个稠密点在verticeArray中的位置, 而且node编码在高位，排序的时候idx完全不会影响node的顺序，仍然还是octree的顺序
-	keys[idx] = key + idx;	
-	//if (idx % 1000 == 0) {
-	//	const int keyHigher32bits = int(keys[idx] >> 32);					// Octree编码
-	//	const int keyLower32bits = int(keys[idx] & ((1ll << 31) - 1));	// 在原始数组中的idx
-	//	printf("idx = %d  High = %d  Low = %d\n", idx, keyHigher32bits, keyLower32bits);
-	//}
+	keys[idx] = computePointCode(point.point) + idx;
+}
+
+__global__ void SparseSurfelFusion::device::gatherSortedPointsKernel(const long long* sortedKeys, const OrientedPoint3D<float>* points, const unsigned int pointsNum, OrientedPoint3D<float>* sortedPoints)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= pointsNum)	return;
+	sortedPoints[idx] = points[int(sortedKeys[idx] & OCTREE_INDEX_MASK)];
 }
 
 __global__ void SparseSurfelFusion::device::updataLower32ForSortedDensePoints(const unsigned int sortedKeysCount, long long* sortedVerticesKey)
@@ -212,10 +181,10 @@ __global__ void SparseSurfelFusion::device::updataLower32ForSortedDensePoints(co
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= sortedKeysCount)	return;
 	if (idx == 0) {
-		sortedVerticesKey[idx] &= ~((1ll << 32) - 1);	// 取高32位的数据，低32位置为0，因为此时DensePoint数组已经被排序，之前低32位的数据需要重置成当下的idx
+		sortedVerticesKey[idx] &= ~OCTREE_INDEX_MASK;	// 取高32位的数据，低32位置为0，因为此时DensePoint数组已经被排序，之前低32位的数据需要重置成当下的idx
 	}
 	else {
-		sortedVerticesKey[idx] &= ~((1ll << 32) - 1);
+		sortedVerticesKey[idx] &= ~OCTREE_INDEX_MASK;
 		sortedVerticesKey[idx] += idx;						// 这里必须重置低32位的idx，之前的idx是DensePoints数组没有排序的idx，现在DensePoints已经被排序，必须更新
 	}
 }
@@ -229,8 +198,8 @@ __global__ void SparseSurfelFusion::device::labelSortedVerticesKeysKernel(const
 	}
 	else {	// 因为此处需要访问前一个的idx，所以如果在同一个核函数更新一定存在访存冲突
 		// 只比较Octree编码部分，因为D层节点，同父节点的部分只允许有8个叶子节点
-		const unsigned int Higher32Bits_Current = int(sortedVerticesKey[idx] >> 32);
-		const unsigned int Higher32Bits_Previous = int(sortedVerticesKey[idx - 1] >> 32);
+		const OctKey Higher32Bits_Current = OctKey(sortedVerticesKey[idx] >> OCTREE_CODE_SHIFT);
+		const OctKey Higher32Bits_Previous = OctKey(sortedVerticesKey[idx - 1] >> OCTREE_CODE_SHIFT);
 		if (Higher32Bits_Current != Higher32Bits_Previous) { keyLabel[idx] = 1; }
 		else { keyLabel[idx] = 0; }
 	}
@@ -257,8 +226,8 @@ __global__ void SparseSurfelFusion::device::initUniqueNodeKernel(OctNode* unique
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= compactedNum) return;	// 压缩后的个数
-	const int keyHigher32bits = int(compactedKey[idx] >> 32);					// Octree编码
-	const int keyLower32bits = int(compactedKey[idx] & ((1ll << 31) - 1));		// 在原始数组中的idx
+	const OctKey keyHigher32bits = OctKey(compactedKey[idx] >> OCTREE_CODE_SHIFT);	// Octree编码
+	const int keyLower32bits = int(compactedKey[idx] & OCTREE_INDEX_MASK);		// 在原始数组中的idx
 	uniqueNode[idx].key = keyHigher32bits;										// 记录节点的key
 	uniqueNode[idx].pidx = compactedOffset[idx];								// 标记第一个节点的位置
 	uniqueNode[idx].pnum = compactedOffset[idx + 1] - compactedOffset[idx];		// 标记相同key值节点的数量
@@ -271,7 +240,7 @@ __global__ void SparseSurfelFusion::device::generateNodeNumsKernel(const DeviceA
 	if (idx == 0) {	// 首节点设置为0，方便后面节点定位
 		nodeNums[idx] = 0;
 	}
-	else if ((uniqueCode[idx - 1] >> 35) != (uniqueCode[idx] >> 35)) {		// 32 + 3 = 35  ->  末端节点的上一层节点  ->  父节点相同
+	else if ((uniqueCode[idx - 1] >> (OCTREE_CODE_SHIFT + 3)) != (uniqueCode[idx] >> (OCTREE_CODE_SHIFT + 3))) {		// 去掉末端3位  ->  末端节点的上一层节点  ->  父节点相同
 		nodeNums[idx] = 8;
 	}
 	else {
@@ -286,7 +255,7 @@ __global__ void SparseSurfelFusion::device::buildNodeArrayDKernel(DeviceArrayVie
 	int DLevelNodeIndex = nodeAddress[idx] + (uniqueNode[idx].key & 7);	// D层节点的位置
 	NodeArrayD[DLevelNodeIndex] = uniqueNode[idx];
 	NodeArrayDAddressFull[DLevelNodeIndex] = nodeAddress[idx];
-	const int keyLower32bits = int(compactedKey[idx] & ((1ll << 31) - 1));				// 在原始数组中的idx
+	const int keyLower32bits = int(compactedKey[idx] & OCTREE_INDEX_MASK);				// 在原始数组中的idx
 	Point2NodeArrayD[keyLower32bits] = DLevelNodeIndex;									// 建立稠密点到节点的映射
 	//if (idx % 1000 == 0)	printf("nodeIndex = %d   keyLower32bits = %d\n", idx, keyLower32bits);
 }
@@ -299,6 +268,20 @@ __global__ void SparseSurfelFusion::device::initNodeArrayDidxDnumKernel(OctNode*
 	NodeArrayD[idx].didx = idx;
 }
 
+__global__ void SparseSurfelFusion::device::countLevelUniqueNodeKernel(DeviceArrayView<long long> uniqueCode, const unsigned int nodesCount, unsigned int* levelUniqueCount)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	const unsigned int lane = threadIdx.x & 31;
+	// 不提前返回：越界线程也参与warp投票
+	for (int depth = 0; depth < device::maxDepth; depth++) {
+		const int shift = OCTREE_CODE_SHIFT + 3 * (device::maxDepth - depth);	// 去掉(maxDepth - depth)段，保留第depth层节点的key
+		bool isNewNode = false;
+		if (idx < nodesCount) isNewNode = (idx == 0) || ((uniqueCode[idx - 1] >> shift) != (uniqueCode[idx] >> shift));
+		const unsigned int newNodeMask = __ballot_sync(0xffffffff, isNewNode);
+		if (lane == 0 && newNodeMask != 0) atomicAdd(&levelUniqueCount[depth], __popc(newNodeMask));	// 每个warp一次原子操作
+	}
+}
+
 __global__ void SparseSurfelFusion::device::processPoint2NodeArrayDKernel(int* Point2NodeArrayD, const unsigned int verticesCount)
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
@@ -340,9 +323,9 @@ __global__ void SparseSurfelFusion::device::generateUniqueNodeArrayPreviousLevel
 		}
 	}
 	else {	// 如果是有效点
-		const int fatherKey = NodeArrayD[idx].key & (~(7 << (3 * (device::maxDepth - depth))));	// 当前点的父节点Key，不管是否是有效点
+		const OctKey fatherKey = NodeArrayD[idx].key & (~(OctKey(7) << (3 * (device::maxDepth - depth))));	// 当前点的父节点Key，不管是否是有效点
 		const int fatherIdx = NodeAddressFull[idx] / 8;											// 当前点的父节点
-		const int sonKey = (NodeArrayD[idx].key >> (3 * (device::maxDepth - depth))) & 7;		// 儿子节点的键，其实就是当前层的那三个bit值
+		const int sonKey = int(NodeArrayD[idx].key >> (3 * (device::maxDepth - depth))) & 7;		// 儿子节点的键，其实就是当前层的那三个bit值
 		uniqueNodeArrayPreviousLevel[fatherIdx].key = fatherKey;								// uniqueNodeArrayPreviousLevel上一层的NodeArrays开始记录父节点
 		//if (depth == device::maxDepth) printf("index = %d  fatherIdx = %d  NA_pnum = %d   Prev_pnum = %d\n", idx, fatherIdx, NodeArrayD[idx].pnum, uniqueNodeArrayPreviousLevel[fatherIdx].pnum);
 		atomicAdd(&uniqueNodeArrayPreviousLevel[fatherIdx].pnum, NodeArrayD[idx].pnum);			// 上一层父节点包含当前节点的所有pnum的和，即与当前层父节点是同一个Key的稠密点个数(只有有效点才有pnum值，无效点是0)
@@ -389,14 +372,14 @@ __global__ void SparseSurfelFusion::device::generateNodeArrayPreviousLevelKernel
 	}
 }
 
-__global__ void SparseSurfelFusion::device::updateNodeArrayParentAndChildrenKernel(const unsigned int totalNodeArrayLength, OctNode* NodeArray)
+__global__ void SparseSurfelFusion::device::updateNodeArrayParentAndChildrenKernel(DeviceArrayView<int> BaseAddressArray, const unsigned int totalNodeArrayLength, OctNode* NodeArray)
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= totalNodeArrayLength)	return;
 	if (NodeArray[idx].pnum == 0)	return;		// 如果是无效点则无需更新孩子和父亲节点
 	int depth = 0;
 	for (depth = 0; depth < device::maxDepth; depth++) {				// 寻找idx在哪一层
-		if (device::BaseAddressArray_Device[depth] <= idx && idx < device::BaseAddressArray_Device[depth + 1]) {
+		if (BaseAddressArray[depth] <= idx && idx < BaseAddressArray[depth + 1]) {
 			break;
 		}
 	}
@@ -404,18 +387,18 @@ __global__ void SparseSurfelFusion::device::updateNodeArrayParentAndChildrenKern
 		NodeArray[idx].parent = -1;										// 如果是第0层节点
 #pragma unroll	// 展开循环，加速运算
 		for (int child = 0; child < 8; child++) {						// 计算Children在NodeArray的位置
-			//NodeArray[idx].children[child] += BaseAddressArray_Device[depth + 1];
+			//NodeArray[idx].children[child] += BaseAddressArray[depth + 1];
 			NodeArray[idx].children[child] = child + 1;		// 第一层节点可以有某些节点完全是空的，但是作为第一层节点必须满排，不能有index错误的
 		}
 	}
 	else {
-		NodeArray[idx].parent += BaseAddressArray_Device[depth - 1];	// 计算Parent在NodeArray中的位置
+		NodeArray[idx].parent += BaseAddressArray[depth - 1];	// 计算Parent在NodeArray中的位置
 
 		if (depth < device::maxDepth) {										// 最后一层没有child节点
 #pragma unroll	// 展开循环，加速运算
 			for (int child = 0; child < 8; child++) {						// 计算Children在NodeArray的位置
 				if (NodeArray[idx].children[child] != 0) {					// 孩子节点为有效节点
-					NodeArray[idx].children[child] += BaseAddressArray_Device[depth + 1];
+					NodeArray[idx].children[child] += BaseAddressArray[depth + 1];
 				}
 			} 
 		}
@@ -423,7 +406,7 @@ __global__ void SparseSurfelFusion::device::updateNodeArrayParentAndChildrenKern
 	}	
 }
 
-__global__ void SparseSurfelFusion::device::updateEmptyNodeInfo(const unsigned int totalNodeArrayLength, OctNode* NodeArray)
+__global__ void SparseSurfelFusion::device::updateEmptyNodeInfo(DeviceArrayView<int> BaseAddressArray, const unsigned int totalNodeArrayLength, OctNode* NodeArray)
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= totalNodeArrayLength || idx == 0)	return;
@@ -442,13 +425,13 @@ __global__ void SparseSurfelFusion::device::updateEmptyNodeInfo(const unsigned i
 		}
 		int depth = 0;
 		for (depth = 0; depth < device::maxDepth; depth++) {				// 寻找idx在哪一层
-			if (device::BaseAddressArray_Device[depth] <= idx && idx < device::BaseAddressArray_Device[depth + 1]) {
+			if (BaseAddressArray[depth] <= idx && idx < BaseAddressArray[depth + 1]) {
 				break;
 			}
 		}
 		
 		// 通过层数去当前层的基本编码，即当前层的同父亲编码
-		int baseKey = NodeArray[idx + validIdx].key - ((NodeArray[idx + validIdx].key) & (7 << (3 * (device::maxDepth - depth))));
+		OctKey baseKey = NodeArray[idx + validIdx].key - ((NodeArray[idx + validIdx].key) & (OctKey(7) << (3 * (device::maxDepth - depth))));
 
 		for (int j = 0; j < 8; j++) {									// 再次遍历这8个点
 			int index = idx + j;										// 点在NodeArray位置
@@ -474,7 +457,7 @@ __global__ void SparseSurfelFusion::device::updateEmptyNodeInfo(const unsigned i
 					}
 				}
 			}
-			NodeArray[index].key = baseKey + (j << (3 * (device::maxDepth - depth)));	// 更新当前点的key
+			NodeArray[index].key = baseKey + (OctKey(j) << (3 * (device::maxDepth - depth)));	// 更新当前点的key
 			NodeArray[index].pidx = nowPIdx;		// 首个key不同的首个稠密点在稠密点数组的index
 			nowPIdx += NodeArray[index].pnum;		// 跨过key相同的稠密点
 
@@ -493,7 +476,7 @@ __global__ void SparseSurfelFusion::device::computeNodeNeighborKernel(const unsi
 	if (idx >= thisLevelNodeCount)	return;	// 0层邻居已经初始化
 	const unsigned int offset = idx + left;	// 当前层的节点在NodeArray中的位置
 	for (int i = 0; i < 27; i++) {
-		int sonKey = (NodeArray[offset].key >> (3 * (device::maxDepth - depth))) & 7;
+		int sonKey = int(NodeArray[offset].key >> (3 * (device::maxDepth - depth))) & 7;
 		//if (depth == 1) {
 		//	if (idx == 7)	printf("idx = %d   offset = %d   neighborIdx = %d   sonKey = %d\n", idx, offset, i, sonKey);
 		//}
@@ -511,7 +494,7 @@ __global__ void SparseSurfelFusion::device::computeNodeNeighborKernel(const unsi
 	}
 }
 
-__global__ void SparseSurfelFusion::device::computeEncodedFunctionNodeIndexKernel(DeviceArrayView<unsigned int> depthBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int totalNodeCount, int* NodeIndexInFunction)
+__global__ void SparseSurfelFusion::device::computeEncodedFunctionNodeIndexKernel(DeviceArrayView<unsigned int> depthBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int totalNodeCount, EncodedFunctionIndex* NodeIndexInFunction)
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= totalNodeCount)	return;
@@ -519,7 +502,7 @@ __global__ void SparseSurfelFusion::device::computeEncodedFunctionNodeIndexKerne
 	getEncodedFunctionNodeIndex(NodeArray[idx].key, depth, NodeIndexInFunction[idx]);
 }
 
-__device__ void SparseSurfelFusion::device::getEncodedFunctionNodeIndex(const int& key, const int& CurrentDepth, int& index)
+__device__ void SparseSurfelFusion::device::getEncodedFunctionNodeIndex(const OctKey& key, const int& CurrentDepth, EncodedFunctionIndex& index)
 {
 	/*
 	 * Part_1 = (1 + (1 << (device::maxDepth + 1)) + (1 << (2 * (device::maxDepth + 1))))
@@ -529,7 +512,9 @@ __device__ void SparseSurfelFusion::device::getEncodedFunctionNodeIndex(const in
 	 * Part_1 * Part2 <=> 将Code_2分别写到code的三个区间[0, 11], [12, 21], [22, 31]
 	 * index  = 00011111111 00011111111 00011111111
 	*/ 
-	index = ((1 << CurrentDepth) - 1) * (1 + (1 << (device::maxDepth + 1)) + (1 << (2 * (device::maxDepth + 1))));
+	const EncodedFunctionIndex offset_1 = EncodedFunctionIndex(1) << (device::maxDepth + 1);
+	const EncodedFunctionIndex offset_2 = EncodedFunctionIndex(1) << (2 * (device::maxDepth + 1));
+	index = EncodedFunctionIndex((1 << CurrentDepth) - 1) * (1 + offset_1 + offset_2);
 
 	/*
 	 * 【假设：sonKey = 111, CurrentDepth = 8】
@@ -540,22 +525,20 @@ __device__ void SparseSurfelFusion::device::getEncodedFunctionNodeIndex(const in
 	 * idx+P3 = 00100000000 00011111111 00100000000
 	*/
 	for (int depth = CurrentDepth; depth >= 1; depth--) {
-		int sonKeyX = (key >> (3 * (device::maxDepth - depth) + 2)) & 1;
-		int sonKeyY = (key >> (3 * (device::maxDepth - depth) + 1)) & 1;
-		int sonKeyZ = (key >> (3 * (device::maxDepth - depth)    )) & 1;
-		index += sonKeyX * (1 << (CurrentDepth - depth)) +
-			     sonKeyY * (1 << (CurrentDepth - depth)) * (1 <<      (device::maxDepth + 1)) +
-			     sonKeyZ * (1 << (CurrentDepth - depth)) * (1 << (2 * (device::maxDepth + 1)));
+		int sonKeyX = int(key >> (3 * (device::maxDepth - depth) + 2)) & 1;
+		int sonKeyY = int(key >> (3 * (device::maxDepth - depth) + 1)) & 1;
+		int sonKeyZ = int(key >> (3 * (device::maxDepth - depth)    )) & 1;
+		index += (sonKeyX + sonKeyY * offset_1 + sonKeyZ * offset_2) * EncodedFunctionIndex(1 << (CurrentDepth - depth));
 	}
 }
 
-__global__ void SparseSurfelFusion::device::ComputeDepthAndCenterKernel(DeviceArrayView<OctNode> NodeArray, const unsigned int NodeArraySize, unsigned int* DepthBuffer, Point3D<float>* CenterBuffer)
+__global__ void SparseSurfelFusion::device::ComputeDepthAndCenterKernel(DeviceArrayView<int> BaseAddressArray, DeviceArrayView<OctNode> NodeArray, const unsigned int NodeArraySize, unsigned int* DepthBuffer, Point3D<float>* CenterBuffer)
 {
 	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
 	if (idx >= NodeArraySize)	return;
 	int depth = 0;
 	for (depth = 0; depth < device::maxDepth; depth++) {				// 寻找idx在哪一层
-		if (device::BaseAddressArray_Device[depth] <= idx && idx < device::BaseAddressArray_Device[depth + 1]) {
+		if (BaseAddressArray[depth] <= idx && idx < BaseAddressArray[depth + 1]) {
 			break;
 		}
 	}
@@ -565,7 +548,7 @@ __global__ void SparseSurfelFusion::device::ComputeDepthAndCenterKernel(DeviceAr
 	CenterBuffer[idx] = center;
 }
 
-__device__ void SparseSurfelFusion::device::getNodeCenterAllDepth(const int& key, int currentDepth, Point3D<float>& Center)
+__device__ void SparseSurfelFusion::device::getNodeCenterAllDepth(const OctKey& key, int currentDepth, Point3D<float>& Center)
 {
 	Center.coords[0] = float(0.5f);
 	Center.coords[1] = float(0.5f);
@@ -585,76 +568,145 @@ __device__ void SparseSurfelFusion::device::getNodeCenterAllDepth(const int& key
 	}
 }
 
-void SparseSurfelFusion::BuildOctree::getCoordinateAndNormal(DeviceArrayView<DepthSurfel> denseSurfel, cudaStream_t stream)
+__global__ void SparseSurfelFusion::device::splitNodeTopologyKernel(DeviceArrayView<OctNode> NodeArray, const unsigned int NodeArraySize, OctKey* key, int* parent, int* children, int* neighs)
 {
-	unsigned int num = denseSurfel.Size();
-	dim3 block(128);
-	dim3 grid(divUp(denseSurfel.Size(), block.x));
-	device::getCoordinateAndNormalKernel << <grid, block, 0, stream >> > (sampleOrientedPoints.Array().ptr(), denseSurfel, num);
+	const unsigned int idx = blockDim.x * blockIdx.x + threadIdx.x;
+	if (idx >= NodeArraySize)	return;
+	key[idx] = NodeArray[idx].key;
+	parent[idx] = NodeArray[idx].parent;
+#pragma unroll
+	for (int i = 0; i < 8; i++) {
+		children[8 * idx + i] = NodeArray[idx].children[i];
+	}
+	if (neighs == NULL) return;		// 压缩拓扑模式不存储邻居
+#pragma unroll
+	for (int i = 0; i < 27; i++) {
+		neighs[27 * idx + i] = NodeArray[idx].neighs[i];
+	}
 }
 
-void SparseSurfelFusion::BuildOctree::getBoundingBox(DeviceArrayView<OrientedPoint3D<float>> points, Point3D<float>& MaxPoint, Point3D<float>& MinPoint, cudaStream_t stream)
+__global__ void SparseSurfelFusion::device::computeNodeSignatureKernel(DeviceArrayView<OctNode> NodeArrayD, DeviceArrayView<OrientedPoint3D<float>> points, const unsigned int nodeNum, OctKey* keys, float4* signature)
 {
-	/********************* 归约求解每个Block最大最小Point3D *********************/
-	const unsigned int num = points.Size();
-	//printf("pointsCount = %d\n", num);
-	const unsigned int gridNum = divUp(num, device::MaxCudaThreadsPerBlock);
-	dim3 blockReduce(device::MaxCudaThreadsPerBlock);
-	dim3 gridReduce(gridNum);
-	perBlockMaxPoint.ResizeArrayOrException(gridNum);
-	perBlockMinPoint.ResizeArrayOrException(gridNum);
-	Point3D<float>* maxArray = perBlockMaxPoint.DeviceArray().ptr();
-	Point3D<float>* minArray = perBlockMinPoint.DeviceArray().ptr();
-	device::reduceMaxMinKernel << <gridReduce, blockReduce, 0, stream >> > (maxArray, minArray, points, num);
-	/********************* 将每个Block值下载到Host端求解所有点的最值 *********************/
-	perBlockMaxPoint.SynchronizeToHost(stream, true);
-	perBlockMinPoint.SynchronizeToHost(stream, true);
-	Point3D<float>* maxArrayHost = perBlockMaxPoint.HostArray().data();
-	Point3D<float>* minArrayHost = perBlockMinPoint.HostArray().data();
-	device::findMaxMinPoint(MaxPoint, MinPoint, maxArrayHost, minArrayHost, gridNum);
-	//printf("MaxPoint(%.5f, %.5f, %.5f)   MinPoint(%.5f, %.5f, %.5f)\n", MaxPoint.coords[0], MaxPoint.coords[1], MaxPoint.coords[2], MinPoint.coords[0], MinPoint.coords[1], MinPoint.coords[2]);
-
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= nodeNum) return;
+	const int pidx = NodeArrayD[idx].pidx;
+	const int pnum = NodeArrayD[idx].pnum;
+	float4 sum = make_float4(0.0f, 0.0f, 0.0f, float(pnum));
+	for (int i = 0; i < pnum; i++) {
+		sum.x += points[pidx + i].point.coords[0];
+		sum.y += points[pidx + i].point.coords[1];
+		sum.z += points[pidx + i].point.coords[2];
+	}
+	keys[idx] = NodeArrayD[idx].key;
+	signature[idx] = sum;
 }
 
-void SparseSurfelFusion::BuildOctree::adjustPointsCoordinateAndNormal(DeviceBufferArray<OrientedPoint3D<float>>& points, const Point3D<float> MxPoint, const Point3D<float> MnPoint, float& MaxEdge, float ScaleFactor, Point3D<float>& Center, cudaStream_t stream)
+__global__ void SparseSurfelFusion::device::markDirtyNodeKernel(DeviceArrayView<OctNode> NodeArrayD, const float4* signature, const OctKey* previousKeys, const float4* previousSignature, const unsigned int nodeNum, const unsigned int previousNodeNum, const float tolerance, const NormalizeTransform* transform, unsigned char* dirty, unsigned int* counter)
 {
-	for (int i = 0; i < DIMENSION; i++) {
-		// 当下是要获取BoundingBox最长的一条边赋值给MaxEdge
-		if (i == 0 || MaxEdge < (MxPoint[i] - MnPoint[i])) {
-			MaxEdge = float(MxPoint[i] - MnPoint[i]);
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= nodeNum) return;
+	if (transform->recomputed) {	// 归一化变化，节点key与上一帧不可比较，全部节点需要重算
+		atomicAdd(&counter[0], 1);
+		atomicAdd(&counter[1], 1);
+		dirty[idx] = 1;
+		return;
+	}
+	const OctKey key = NodeArrayD[idx].key;
+	int previous = -1;
+	if (idx < previousNodeNum && previousKeys[idx] == key) previous = idx;	// 拓扑未变化时节点位置不变
+	else {
+		atomicAdd(&counter[0], 1);
+		int left = 0, right = (int)previousNodeNum - 1;
+		while (left <= right) {
+			const int middle = (left + right) >> 1;
+			const OctKey middleKey = previousKeys[middle];
+			if (middleKey == key) { previous = middle; break; }
+			else if (middleKey < key) left = middle + 1;
+			else right = middle - 1;
 		}
-		Center.coords[i] = float(MxPoint[i] + MnPoint[i]) / 2.0f;	// 中点位置
 	}
-	MaxEdge *= ScaleFactor * 1.0f;	// 调整BoundingBox的尺寸
-	for (int i = 0; i < DIMENSION; i++) {
-		Center.coords[i] -= MaxEdge / 2.0f;	// 调整中心点的位置
+	bool isDirty = true;
+	if (previous >= 0) {
+		const float4 current = signature[idx];
+		const float4 last = previousSignature[previous];
+		isDirty = (current.w != last.w) || (fabsf(current.x - last.x) > tolerance) || (fabsf(current.y - last.y) > tolerance) || (fabsf(current.z - last.z) > tolerance);
 	}
-	dim3 block(128);
-	dim3 grid(divUp(points.ArraySize(), block.x));
-	device::adjustPointsCoordinateAndNormalKernel << <grid, block, 0, stream >> > (points.Array().ptr(), Center, MaxEdge, points.ArrayView().Size());
+	dirty[idx] = isDirty ? 1 : 0;
+	if (isDirty) atomicAdd(&counter[1], 1);
+}
 
-	//std::vector<OrientedPoint3D<float>> orientedPoint_Host(points.ArraySize());
-	//CHECKCUDA(cudaMemcpyAsync(orientedPoint_Host.data(), points.Ptr(), sizeof(OrientedPoint3D<float>) * points.ArraySize(), cudaMemcpyDeviceToHost, stream));
-	//CHECKCUDA(cudaStreamSynchronize(stream));
-	//for (int i = 0; i < points.ArraySize(); i++) {
-	//	if (i % 10 == 0) printf("index = %d  coor = (%.5f, %.5f, %.5f)  normal = (%.5f, %.5f, %.5f)\n", i, orientedPoint_Host[i].point.coords[0], orientedPoint_Host[i].point.coords[1], orientedPoint_Host[i].point.coords[2], orientedPoint_Host[i].normal.coords[0], orientedPoint_Host[i].normal.coords[1], orientedPoint_Host[i].normal.coords[2]);
-	//}
+__global__ void SparseSurfelFusion::device::restoreNodeNeighborKernel(const int* neighs, const unsigned int NodeArraySize, OctNode* NodeArray)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= NodeArraySize) return;
+#pragma unroll
+	for (int i = 0; i < 27; i++) {
+		NodeArray[idx].neighs[i] = neighs[27 * idx + i];
+	}
+}
 
+void SparseSurfelFusion::BuildOctree::getCoordinateAndNormal(DeviceArrayView<DepthSurfel> denseSurfel, cudaStream_t stream)
+{
+	unsigned int num = denseSurfel.Size();
+	dim3 block(128);
+	dim3 grid(divUp(denseSurfel.Size(), block.x));
+	device::getCoordinateAndNormalKernel << <grid, block, 0, stream >> > (sampleOrientedPoints.Array().ptr(), denseSurfel, num);
 }
 
-void SparseSurfelFusion::BuildOctree::generateCode(DeviceBufferArray<OrientedPoint3D<float>>& points, DeviceBufferArray<long long>& keys, size_t count, cudaStream_t stream)
+void SparseSurfelFusion::BuildOctree::computeNormalizeTransform(DeviceArrayView<OrientedPoint3D<float>> points, const float scaleFactor, cudaStream_t stream)
 {
-	sortCode.ResizeArrayOrException(count);		// 分配Array
+	if (fixedBoundingBox) {
+		// 固定包围盒：跳过归约，只有设置后的第一帧标记为重新计算
+		NormalizeTransform transform = fixedTransform;
+		transform.recomputed = fixedTransformPending ? 1 : 0;
+		device::setNormalizeTransformKernel << <1, 1, 0, stream >> > (transform, normalizeTransform.Ptr());
+		fixedTransformPending = false;
+	}
+	else {
+		/********************* cub归约包围盒，结果留在显存 *********************/
+		const int num = (int)points.Size();
+		cub::TransformInputIterator<PointBoundingBox, device::PointToBoundingBox, const OrientedPoint3D<float>*> boxIterator(points.RawPtr(), device::PointToBoundingBox());
+		PointBoundingBox emptyBox;
+		emptyBox.minPoint = make_float3(FLT_MAX, FLT_MAX, FLT_MAX);
+		emptyBox.maxPoint = make_float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		size_t tempStorageBytes = 0;
+		CHECKCUDA(cub::DeviceReduce::Reduce(NULL, tempStorageBytes, boxIterator, boundingBox.Ptr(), num, device::MergeBoundingBox(), emptyBox, stream));
+		if (tempStorageBytes > reduceTempStorage.Capacity()) reduceTempStorage.AllocateBuffer(tempStorageBytes);
+		CHECKCUDA(cub::DeviceReduce::Reduce(reduceTempStorage.Ptr(), tempStorageBytes, boxIterator, boundingBox.Ptr(), num, device::MergeBoundingBox(), emptyBox, stream));
+		/********************* 由包围盒计算归一化变换，增量模式下可复用冻结的变换 *********************/
+		device::computeNormalizeTransformKernel << <1, 1, 0, stream >> > (boundingBox.Ptr(), scaleFactor, incrementalMode && normalizationFrozen, normalizeTransform.Ptr());
+		normalizationFrozen = incrementalMode;
+		fixedTransformPending = true;	// 再次切换到固定包围盒时需要重新写入
+	}
+	// 只在使用归一化参数(网格变换回原坐标)时等待
+	CHECKCUDA(cudaMemcpyAsync(normalizeTransformHost, normalizeTransform.Ptr(), sizeof(NormalizeTransform), cudaMemcpyDeviceToHost, stream));
+	CHECKCUDA(cudaEventRecord(normalizeTransformReady, stream));
+}
+
+void SparseSurfelFusion::BuildOctree::normalizeAndEncode(DeviceBufferArray<OrientedPoint3D<float>>& points, DeviceBufferArray<long long>& keys, size_t count, cudaStream_t stream)
+{
+	keys.ResizeArrayOrException(count);		// 分配Array
 	// 线程数应该够用
 	dim3 block(128);					// block ∈ [0, 1024]
 	dim3 grid(divUp(count, block.x));	// grid  ∈ [0, 2^31 - 1]
-	device::generateCodeKernel << <grid, block, 0, stream >> > (points.Array().ptr(), keys.Array().ptr(), count);
+	device::normalizeAndEncodeKernel << <grid, block, 0, stream >> > (points.Array().ptr(), normalizeTransform.Ptr(), keys.Array().ptr(), count);
 }
 
 void SparseSurfelFusion::BuildOctree::sortAndCompactVerticesKeys(DeviceArray<OrientedPoint3D<float>>& points, cudaStream_t stream)
 {
 	const unsigned int VerticesKeysNum = sortCode.ArrayView().Size();
-	pointKeySort.Sort(sortCode.Array(), points, stream);
+	// 编码只占[OCTREE_CODE_SHIFT, OCTREE_CODE_SHIFT + 3 * maxDepth)位，低位的idx本身升序，基数排序稳定，因此只排序编码位即可得到与排序全部64位相同的结果
+	const int codeBeginBit = OCTREE_CODE_SHIFT;
+	const int codeEndBit = OCTREE_CODE_SHIFT + 3 * Constants::maxDepth_Host;
+	if (sortKeysOnly) {
+		pointKeySort.SortKeysInBitRange(sortCode.Array(), codeBeginBit, codeEndBit, stream);
+		dim3 block(128);
+		dim3 grid(divUp(VerticesKeysNum, block.x));
+		device::gatherSortedPointsKernel << <grid, block, 0, stream >> > (pointKeySort.valid_sorted_key.ptr(), points.ptr(), VerticesKeysNum, pointKeySort.valid_sorted_value.ptr());
+	}
+	else {
+		pointKeySort.SortInBitRange(sortCode.Array(), points, codeBeginBit, codeEndBit, stream);
+	}
 	// 将point彻底更换为排列好的稠密点
 	CHECKCUDA(cudaMemcpyAsync(points.ptr(), pointKeySort.valid_sorted_value.ptr(), sizeof(OrientedPoint3D<float>) * VerticesKeysNum, cudaMemcpyDeviceToDevice, stream));
 	CHECKCUDA(cudaMemcpyAsync(sortCode.Array().ptr(), pointKeySort.valid_sorted_key.ptr(), sizeof(long long) * VerticesKeysNum, cudaMemcpyDeviceToDevice, stream));
@@ -732,29 +784,46 @@ void SparseSurfelFusion::BuildOctree::generateNodeNumsAndNodeAddress(DeviceBuffe
 	CHECKCUDA(cudaMemcpyAsync(NodeAddressPtr, prefixsumNodeNumsPtr, sizeof(unsigned int) * nodesCount, cudaMemcpyDeviceToDevice, stream));
 }
 
-void SparseSurfelFusion::BuildOctree::buildNodeArrayD(DeviceArrayView<OrientedPoint3D<float>> denseVertices, DeviceArrayView<OctNode> uniqueNode, DeviceArrayView<long long> compactedKey, DeviceBufferArray<unsigned int>& NodeAddress, DeviceBufferArray<unsigned int>& NodeAddressFull, DeviceBufferArray<int>& Point2NodeArray, DeviceBufferArray<OctNode>& NodeArrayD, cudaStream_t stream)
+void SparseSurfelFusion::BuildOctree::computeLevelLayout(DeviceArrayView<long long> uniqueCode, cudaStream_t stream)
+{
+	const unsigned int nodesCount = uniqueCode.Size();
+	CHECKCUDA(cudaMemsetAsync(levelUniqueCount.DevicePtr(), 0, sizeof(unsigned int) * (Constants::maxDepth_Host + 1), stream));
+	dim3 block(128);
+	dim3 grid(divUp(nodesCount, block.x));
+	device::countLevelUniqueNodeKernel << <grid, block, 0, stream >> > (uniqueCode, nodesCount, levelUniqueCount.DevicePtr());
+	levelUniqueCount.SynchronizeToHost(stream, true);	// 整个八叉树构建中唯一一次读回层规模
+
+	NodeArrayCount_Host[0] = 1;
+	BaseAddressArray_Host[0] = 0;
+	for (int depth = 1; depth <= Constants::maxDepth_Host; depth++) {
+		NodeArrayCount_Host[depth] = 8 * levelUniqueCount.HostArray()[depth - 1];		// 上一层每个Unique节点拥有满排的8个孩子
+		BaseAddressArray_Host[depth] = BaseAddressArray_Host[depth - 1] + NodeArrayCount_Host[depth - 1];
+	}
+	//for (int i = 0; i <= Constants::maxDepth_Host; i++) {
+	//	printf("BaseAddressArray[%d] = %d    NodeArrayCount[%d] = %d\n", i, BaseAddressArray_Host[i], i, NodeArrayCount_Host[i]);
+	//}
+	const unsigned int totalNodeArrayLength = BaseAddressArray_Host[Constants::maxDepth_Host] + NodeArrayCount_Host[Constants::maxDepth_Host];
+	NodeArray.ResizeArrayOrException(totalNodeArrayLength);
+	CHECKCUDA(cudaMemsetAsync(NodeArray.Array().ptr(), 0, sizeof(OctNode) * totalNodeArrayLength, stream));		// 所有层的节点默认都为0
+}
+
+void SparseSurfelFusion::BuildOctree::buildNodeArrayD(DeviceArrayView<OrientedPoint3D<float>> denseVertices, DeviceArrayView<OctNode> uniqueNode, DeviceArrayView<long long> compactedKey, DeviceBufferArray<unsigned int>& NodeAddress, DeviceBufferArray<unsigned int>& NodeAddressFull, DeviceBufferArray<int>& Point2NodeArray, DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream)
 {
 	const unsigned int nodesCount = NodeAddress.ArrayView().Size();		// Unique的数量，压缩后的
 	//printf("nodesCount = %u\n", nodesCount);
 	const unsigned int verticesCount = denseVertices.Size();
-	unsigned int TotalNodeNums;		// 总共D层子节点的个数
-	const unsigned int* nodeAddressPtr = NodeAddress.Array().ptr();
-	CHECKCUDA(cudaMemcpyAsync(&TotalNodeNums, nodeAddressPtr + nodesCount - 1, sizeof(unsigned int), cudaMemcpyDeviceToHost, stream));
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-	TotalNodeNums += 8;	// 首节点那对应的8个没算上，这里应该表示的是最后一层(D层)的节点
+	const unsigned int TotalNodeNums = NodeArrayCount_Host[Constants::maxDepth_Host];	// 总共D层子节点的个数，由computeLevelLayout确定，不再读回nodeAddress
+	OctNode* NodeArrayD = NodeArray.Array().ptr() + BaseAddressArray_Host[Constants::maxDepth_Host];	// D层节点直接构建在NodeArray中，已置0
 	//printf("D层总节点数目 = %u\n", TotalNodeNums);
-	NodeArrayD.AllocateBuffer(TotalNodeNums);
-	NodeArrayD.ResizeArrayOrException(TotalNodeNums);
 	NodeAddressFull.ResizeArrayOrException(TotalNodeNums);
 	Point2NodeArray.ResizeArrayOrException(verticesCount);
-	CHECKCUDA(cudaMemsetAsync(NodeArrayD.Array().ptr(), 0, sizeof(OctNode) * TotalNodeNums, stream));			// NodeArrayD默认都为0
 	CHECKCUDA(cudaMemsetAsync(Point2NodeArray.Array().ptr(), -1, sizeof(int) * verticesCount, stream));			// Point2NodeArray默认都为-1
 	dim3 block1(128);
 	dim3 grid1(divUp(nodesCount, block1.x));
-	device::buildNodeArrayDKernel << <grid1, block1, 0, stream >> > (uniqueNode, NodeAddress.ArrayView(), compactedKey, nodesCount, Point2NodeArray.Array().ptr(), NodeArrayD.Array().ptr(), NodeAddressFull.Array().ptr());
+	device::buildNodeArrayDKernel << <grid1, block1, 0, stream >> > (uniqueNode, NodeAddress.ArrayView(), compactedKey, nodesCount, Point2NodeArray.Array().ptr(), NodeArrayD, NodeAddressFull.Array().ptr());
 	dim3 block2(128);
 	dim3 grid2(divUp(TotalNodeNums, block2.x));
-	device::initNodeArrayDidxDnumKernel << <grid2, block2, 0, stream >> > (NodeArrayD.Array().ptr(), TotalNodeNums);
+	device::initNodeArrayDidxDnumKernel << <grid2, block2, 0, stream >> > (NodeArrayD, TotalNodeNums);
 	dim3 block3(128);
 	dim3 grid3(divUp(verticesCount, block3.x));
 	device::processPoint2NodeArrayDKernel << <grid3, block3, 0, stream >> > (Point2NodeArray.Array().ptr(), verticesCount);
@@ -762,12 +831,13 @@ void SparseSurfelFusion::BuildOctree::buildNodeArrayD(DeviceArrayView<OrientedPo
 
 void SparseSurfelFusion::BuildOctree::buildOtherDepthNodeArray(int* BaseAddressArray_Host, cudaStream_t stream)
 {
-	unsigned int allNodeNums_D = NodeArrays[Constants::maxDepth_Host].ArrayView().Size();		// 记录D层节点8个满排的节点数量
-	//printf("第 D 层Octree节点的总数 = %d\n", allNodeNums_D);
-	unsigned int TotalNodeNumsPreviousLevel;													// 上一层父节点的个数
+	// 每层规模已由computeLevelLayout确定，各层直接构建在NodeArray的对应偏移处，循环内不与Host同步
+	OctNode* NodeArrayPtr = NodeArray.Array().ptr();
 	for (int depth = Constants::maxDepth_Host; depth >= 1; depth--) {
-		NodeArrayCount_Host[depth] = allNodeNums_D;
-		int UniqueCountPrevious = allNodeNums_D / 8;	// 上一层Octree节点的数量【满排】,实际上是Unique
+		const unsigned int currentLevelNodeCount = NodeArrayCount_Host[depth];		// 当前层满排节点数量
+		const unsigned int UniqueCountPrevious = currentLevelNodeCount / 8;			// 上一层Unique节点数量
+		OctNode* currentLevelNodeArray = NodeArrayPtr + BaseAddressArray_Host[depth];
+		OctNode* previousLevelNodeArray = NodeArrayPtr + BaseAddressArray_Host[depth - 1];
 		OctNode* previousLevelUniqueNodePtr = uniqueNodePrevious.Array().ptr();	// 获得指针以便赋初值
 		unsigned int* previousLevelnodeAddress = nodeAddressPrevious.Array().ptr();	// 获得指针以便赋初值
 		// 给uniqueNodePreviousLevel开辟空间并赋初值
@@ -782,15 +852,12 @@ void SparseSurfelFusion::BuildOctree::buildOtherDepthNodeArray(int* BaseAddressA
 		device::setPidxDidxInvalidValue << <grid_PreLevel, block_PreLevel, 0, stream >> > (uniqueNodePrevious.Array().ptr(), UniqueCountPrevious);
 
 		dim3 block_D(128);
-		dim3 grid_D(divUp(allNodeNums_D, block_D.x));
-		device::generateUniqueNodeArrayPreviousLevelKernel << <grid_D, block_D, 0, stream >> > (NodeArrays[depth].ArrayView(), NodeAddressFull.ArrayView(), allNodeNums_D, depth, uniqueNodePrevious.Array().ptr());
+		dim3 grid_D(divUp(currentLevelNodeCount, block_D.x));
+		device::generateUniqueNodeArrayPreviousLevelKernel << <grid_D, block_D, 0, stream >> > (DeviceArrayView<OctNode>(currentLevelNodeArray, currentLevelNodeCount), NodeAddressFull.ArrayView(), currentLevelNodeCount, depth, uniqueNodePrevious.Array().ptr());
 		
 		// 每一层的UniqueNodePrev的pidx，pnum，didx，dnum都没问题
 		nodeNums.ResizeArrayOrException(UniqueCountPrevious);	// 调整nodeNums为上一层的Unique大小
 		device::generateNodeNumsPreviousLevelKernel << <grid_PreLevel, block_PreLevel, 0, stream >> > (uniqueNodePrevious.ArrayView(), UniqueCountPrevious, depth - 1, nodeNums.Array().ptr());
-			
-		CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-		//printf("UniqueCountPrevious = %d\n", UniqueCountPrevious);
 
 		// 上一层父节点的数量一定少于当前层节点，因此直接服用nodeNumsPrefixsum，无需再分配缓存
 		nodeNumsPrefixsum.InclusiveSum(nodeNums.ArrayView(), stream);
@@ -799,71 +866,33 @@ void SparseSurfelFusion::BuildOctree::buildOtherDepthNodeArray(int* BaseAddressA
 		CHECKCUDA(cudaMemcpyAsync(previousLevelnodeAddress, prefixsumNodeNumsPtr, sizeof(unsigned int) * UniqueCountPrevious, cudaMemcpyDeviceToDevice, stream));
 		
 		if (depth > 1) {	// 非第一层
-			CHECKCUDA(cudaMemcpyAsync(&TotalNodeNumsPreviousLevel, previousLevelnodeAddress + UniqueCountPrevious - 1, sizeof(unsigned int), cudaMemcpyDeviceToHost, stream));
-			TotalNodeNumsPreviousLevel += 8;			// 上一层父节点的数量，首个父节点为0，因此累和后应该+8
-			NodeArrays[depth - 1].AllocateBuffer(TotalNodeNumsPreviousLevel);
-			NodeArrays[depth - 1].ResizeArrayOrException(TotalNodeNumsPreviousLevel);
-			NodeAddressFull.ResizeArrayOrException(TotalNodeNumsPreviousLevel);			// (depth - 1)层满排节点NodeAddress表，确定上一层Unique的index
-			void* previousLevelNodeArrayPtr = NodeArrays[depth - 1].Array().ptr();		// 获得指针以便赋初值
-			CHECKCUDA(cudaMemsetAsync(previousLevelNodeArrayPtr, 0, sizeof(OctNode) * TotalNodeNumsPreviousLevel, stream));
-
+			NodeAddressFull.ResizeArrayOrException(NodeArrayCount_Host[depth - 1]);		// (depth - 1)层满排节点NodeAddress表，确定上一层Unique的index
 			// 构建上一层父节点的nodeArray，并给当前层的nodeArray中的parent赋值
-			device::generateNodeArrayPreviousLevelKernel << <grid_PreLevel, block_PreLevel, 0, stream >> > (uniqueNodePrevious.ArrayView(), nodeAddressPrevious.ArrayView(), UniqueCountPrevious, depth, NodeArrays[depth - 1].Array().ptr(), NodeArrays[depth].Array().ptr(), NodeAddressFull.Array().ptr());
-			
-			//CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-			//printf("TotalNodeNumsPreviousLevel = %d\n", TotalNodeNumsPreviousLevel);
-
-		}
-		else {
-			TotalNodeNumsPreviousLevel = 1;
-			NodeArrays[depth - 1].AllocateBuffer(TotalNodeNumsPreviousLevel);
-			NodeArrays[depth - 1].ResizeArrayOrException(TotalNodeNumsPreviousLevel);
-			OctNode* NodeArrays_0 = NodeArrays[depth - 1].Array().ptr();	// 暴露指针，直接赋值
-			CHECKCUDA(cudaMemcpyAsync(NodeArrays_0, uniqueNodePrevious.Array().ptr(), sizeof(OctNode) * 1, cudaMemcpyDeviceToDevice, stream));
-		}
-		allNodeNums_D = TotalNodeNumsPreviousLevel;
-	}
-
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-
-	for (int i = 0; i <= Constants::maxDepth_Host; i++) {
-		if (i == 0) {
-			NodeArrayCount_Host[i] = 1;
+			device::generateNodeArrayPreviousLevelKernel << <grid_PreLevel, block_PreLevel, 0, stream >> > (uniqueNodePrevious.ArrayView(), nodeAddressPrevious.ArrayView(), UniqueCountPrevious, depth, previousLevelNodeArray, currentLevelNodeArray, NodeAddressFull.Array().ptr());
 		}
 		else {
-			BaseAddressArray_Host[i] = BaseAddressArray_Host[i - 1] + NodeArrayCount_Host[i - 1];
+			CHECKCUDA(cudaMemcpyAsync(previousLevelNodeArray, uniqueNodePrevious.Array().ptr(), sizeof(OctNode) * 1, cudaMemcpyDeviceToDevice, stream));	// 第0层只有根节点
 		}
 	}
-	//for (int i = 0; i <= Constants::maxDepth_Host; i++) {
-	//	printf("BaseAddressArray[%d] = %d    NodeArrayCount[%d] = %d\n", i, BaseAddressArray_Host[i], i, NodeArrayCount_Host[i]);
-	//}
-	// 上述构建Octree已经cuda同步
 }
 
 void SparseSurfelFusion::BuildOctree::updateNodeInfo(int* BaseAddressArray_Host, DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream)
 {
 	BaseAddressArray_Device.ResizeArrayOrException(Constants::maxDepth_Host + 1);
 	CHECKCUDA(cudaMemcpyAsync(BaseAddressArray_Device.Array().ptr(), BaseAddressArray_Host, sizeof(int) * (Constants::maxDepth_Host + 1), cudaMemcpyHostToDevice, stream));
-	CHECKCUDA(cudaMemcpyToSymbolAsync(device::BaseAddressArray_Device, BaseAddressArray_Host, sizeof(int) * (Constants::maxDepth_Host + 1), 0, cudaMemcpyHostToDevice, stream));
 	// D层首个节点在NodeArrays的位置偏移 + D层节点数量 = 总NodeArray的节点数量
 	const unsigned int totalNodeArrayLength = BaseAddressArray_Host[Constants::maxDepth_Host] + NodeArrayCount_Host[Constants::maxDepth_Host];
 	//printf("NodeArray_sz = %d\n", totalNodeArrayLength);
-	NodeArray.ResizeArrayOrException(totalNodeArrayLength);
+	// 各层已直接构建在NodeArray中，无需逐层拷贝
 	NodeArrayDepthIndex.ResizeArrayOrException(totalNodeArrayLength);
 	NodeArrayNodeCenter.ResizeArrayOrException(totalNodeArrayLength);
-	for (int i = 0; i <= Constants::maxDepth_Host; i++) {
-		// 阻塞拷贝，防止未拷贝完成，但是下面的NodeArray释放了
-		CHECKCUDA(cudaMemcpyAsync(NodeArray.Array().ptr() + BaseAddressArray_Host[i], NodeArrays[i], sizeof(OctNode) * NodeArrayCount_Host[i], cudaMemcpyDeviceToDevice, stream));
-		CHECKCUDA(cudaStreamSynchronize(stream));
-		NodeArrays[i].ReleaseBuffer();
-	}
 	dim3 block(128);
 	dim3 grid(divUp(totalNodeArrayLength, block.x));
 	
-	device::updateNodeArrayParentAndChildrenKernel << <grid, block, 0, stream >> > (totalNodeArrayLength, NodeArray.Array().ptr());
+	device::updateNodeArrayParentAndChildrenKernel << <grid, block, 0, stream >> > (BaseAddressArray_Device.ArrayView(), totalNodeArrayLength, NodeArray.Array().ptr());
 
-	device::updateEmptyNodeInfo << <grid, block, 0, stream >> > (totalNodeArrayLength, NodeArray.Array().ptr());
-	device::ComputeDepthAndCenterKernel << <grid, block, 0, stream >> > (NodeArray.ArrayView(), totalNodeArrayLength, NodeArrayDepthIndex.Array().ptr(), NodeArrayNodeCenter.Array().ptr());
+	device::updateEmptyNodeInfo << <grid, block, 0, stream >> > (BaseAddressArray_Device.ArrayView(), totalNodeArrayLength, NodeArray.Array().ptr());
+	device::ComputeDepthAndCenterKernel << <grid, block, 0, stream >> > (BaseAddressArray_Device.ArrayView(), NodeArray.ArrayView(), totalNodeArrayLength, NodeArrayDepthIndex.Array().ptr(), NodeArrayNodeCenter.Array().ptr());
 
 }
 
@@ -887,12 +916,62 @@ void SparseSurfelFusion::BuildOctree::computeNodeNeighbor(DeviceBufferArray<OctN
 		device::computeNodeNeighborKernel << <grid, block, 0, stream >> > (BaseAddressArray_Host[depth], currentLevelNodeCount, depth, NodeArray.Array().ptr());
 
 	}
-	CHECKCUDA(cudaStreamSynchronize(stream));	// 这里需要流同步，后续算法分为两个流，均要用到当前计算结果
 
 }
 
+void SparseSurfelFusion::BuildOctree::splitNodeTopology(DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream)
+{
+	const unsigned int totalNodeArrayLength = NodeArray.ArraySize();
+	// 容量足够时AllocateBuffer直接返回，不足时按本帧节点数量重新开辟
+	NodeKeys.AllocateBuffer(totalNodeArrayLength);
+	NodeParents.AllocateBuffer(totalNodeArrayLength);
+	NodeChildren.AllocateBuffer(8 * totalNodeArrayLength);
+	if (compressedTopology) NodeNeighbors.ReleaseBuffer();	// 邻居由视图按key查找
+	else NodeNeighbors.AllocateBuffer(27 * totalNodeArrayLength);
+
+	dim3 block(128);
+	dim3 grid(divUp(totalNodeArrayLength, block.x));
+	device::splitNodeTopologyKernel << <grid, block, 0, stream >> > (NodeArray.ArrayView(), totalNodeArrayLength, NodeKeys.Ptr(), NodeParents.Ptr(), NodeChildren.Ptr(), compressedTopology ? NULL : NodeNeighbors.Ptr());
+}
+
+void SparseSurfelFusion::BuildOctree::detectDirtyNodes(cudaStream_t stream)
+{
+	const unsigned int nodeNumD = NodeArrayCount_Host[Constants::maxDepth_Host];
+	DeviceArrayView<OctNode> NodeArrayD(NodeArray.Ptr() + BaseAddressArray_Host[Constants::maxDepth_Host], nodeNumD);
+	KeysD.ResizeArray(nodeNumD, true);
+	SignatureD.ResizeArray(nodeNumD, true);
+	DirtyNodeD.ResizeArray(nodeNumD, true);
+
+	dim3 block(128);
+	dim3 grid(divUp(nodeNumD, block.x));
+	device::computeNodeSignatureKernel << <grid, block, 0, stream >> > (NodeArrayD, sampleOrientedPoints.ArrayView(), nodeNumD, KeysD.Ptr(), SignatureD.Ptr());
+	CHECKCUDA(cudaMemsetAsync(dirtyCounter.DevicePtr(), 0, sizeof(unsigned int) * 2, stream));
+	const float tolerance = 1e-6f;
+	device::markDirtyNodeKernel << <grid, block, 0, stream >> > (NodeArrayD, SignatureD.Ptr(), previousKeysD.Ptr(), previousSignatureD.Ptr(), nodeNumD, previousNodeNumD, tolerance, normalizeTransform.Ptr(), DirtyNodeD.Ptr(), dirtyCounter.DevicePtr());
+	dirtyCounter.SynchronizeToHost(stream, true);
+	const unsigned int mismatchedNodes = dirtyCounter.HostArray()[0];
+	dirtyNodeCountD = dirtyCounter.HostArray()[1];
+	// D层节点数量相同且逐个key相同，则整棵树(由D层节点唯一确定)与上一帧相同
+	topologyUnchanged = (previousNodeNumD > 0) && (previousNodeNumD == nodeNumD) && (mismatchedNodes == 0);
+
+	// 本帧D层节点记为上一帧(交换缓冲，不拷贝)
+	std::swap(previousKeysD, KeysD);
+	std::swap(previousSignatureD, SignatureD);
+	previousNodeNumD = nodeNumD;
+}
+
+void SparseSurfelFusion::BuildOctree::restoreNodeNeighbor(DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream)
+{
+	const unsigned int totalNodeArrayLength = NodeArray.ArraySize();
+	dim3 block(128);
+	dim3 grid(divUp(totalNodeArrayLength, block.x));
+	device::restoreNodeNeighborKernel << <grid, block, 0, stream >> > (NodeNeighbors.Ptr(), totalNodeArrayLength, NodeArray.Array().ptr());
+}
+
 void SparseSurfelFusion::BuildOctree::ComputeEncodedFunctionNodeIndex(cudaStream_t stream)
 {
+	if (incrementalMode && topologyUnchanged) return;	// 基函数索引只取决于节点key与深度，拓扑不变则沿用上一帧
+
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
 #endif // CHECK_MESH_BUILD_TIME_COST
@@ -14,22 +14,42 @@
 
 #include <core/AlgorithmTypes.h>
 
+#include <pcl/point_cloud.h>
+#include <pcl/common/common_headers.h>
+#if RECONSTRUCTION_WITH_PCL_IO
 #include <pcl/io/ply_io.h>  // ply 文件读取头文件
 #include <pcl/io/pcd_io.h>
-#include <pcl/point_cloud.h>
 #include <pcl/kdtree/kdtree_flann.h>
-#include <pcl/common/common_headers.h>
 #include <pcl/features/normal_3d_omp.h>
 #include <pcl/visualization/cloud_viewer.h>
 #include <pcl/visualization/pcl_visualizer.h>
+#endif // RECONSTRUCTION_WITH_PCL_IO
 
 #include <boost/thread/thread.hpp>
 
 #include "DebugTest.h"
 #include "Geometry.h"
 #include "OctNode.cuh"
+#include "ReconstructionConfig.h"
 
 namespace SparseSurfelFusion {
+	/**
+	 * \brief 点云包围盒，设备端归约的结果.
+	 */
+	struct PointBoundingBox {
+		float3 minPoint;		// x, y, z最小值
+		float3 maxPoint;		// x, y, z最大值
+	};
+
+	/**
+	 * \brief 常驻显存的归一化变换：归一化坐标 = (原坐标 - center) / maxEdge.
+	 */
+	struct NormalizeTransform {
+		float3 center;			// 归一化偏移
+		float maxEdge;			// 归一化放缩边长
+		int recomputed;			// 本帧是否重新计算了归一化(未复用冻结的归一化)，为1时节点key与上一帧不可比较
+	};
+
 	namespace device {
 
 		enum {
@@ -53,17 +73,24 @@ namespace SparseSurfelFusion {
 		 * \param points 稠密点云
 		 * \param pointsCount 点云数量
 		 */
-		__global__ void reduceMaxMinKernel(Point3D<float>* maxBlockData, Point3D<float>* minBlockData, DeviceArrayView<OrientedPoint3D<float>> points, const unsigned int pointsCount);
 		/**
-		 * \brief 找规约后的最大和最小点.
+		 * \brief 单线程由包围盒计算归一化变换：最长边放缩scaleFactor倍，包围盒居中.
+		 *        reuseFrozen为true且包围盒仍在冻结的归一化范围内(不进入放缩留出的边缘的前一半)时保留transform中的变换，保证节点key在帧间可比较.
 		 * 
-		 * \param MaxPoint 输出最大点
-		 * \param MinPoint 输出最小点
-		 * \param maxArray 每个block最大的点Array
-		 * \param minArray 每个block最小点点Array
-		 * \param GridNum 规约时分配的网格数量
+		 * \param boundingBox 设备端归约出的包围盒
+		 * \param scaleFactor 放缩尺寸
+		 * \param reuseFrozen transform中是否有可复用的冻结变换
+		 * \param transform 【输入输出】归一化变换
 		 */
-		__host__ void findMaxMinPoint(Point3D<float>& MaxPoint, Point3D<float>& MinPoint, Point3D<float>* maxArray, Point3D<float>* minArray, const unsigned int GridNum);
+		__global__ void computeNormalizeTransformKernel(const PointBoundingBox* boundingBox, const float scaleFactor, const bool reuseFrozen, NormalizeTransform* transform);
+
+		/**
+		 * \brief 写入固定包围盒的归一化变换，参数在启动时按值捕获.
+		 * 
+		 * \param fixedTransform 由固定包围盒计算的变换
+		 * \param transform 【输出】归一化变换
+		 */
+		__global__ void setNormalizeTransformKernel(const NormalizeTransform fixedTransform, NormalizeTransform* transform);
 
 		/**
 		 * \brief 将稠密面元中坐标和发现提取出来.
@@ -76,29 +103,38 @@ namespace SparseSurfelFusion {
 		__global__ void getCoordinateAndNormalKernel(OrientedPoint3D<float>* point, DeviceArrayView<DepthSurfel> PointCloud, const unsigned int pointsCount);
 		
 		/**
-		 * \brief 调整点坐标的核函数.
+		 * \brief 为归一化到[0, 1]的点生成编码，其中包括点在Octree中的Node位置，临近点，父节点，子节点等.
 		 * 
-		 * \param coordinate 需要变更的点的坐标
-		 * \param normal 点的法线
-		 * \param center 中心点的坐标
-		 * \param scale 坐标点放缩尺寸
+		 * \param point 归一化的点坐标
+		 * \return 八叉树编码(从OCTREE_CODE_SHIFT位开始，低位留给稠密点index)
 		 */
-		__global__ void adjustPointsCoordinateAndNormalKernel(OrientedPoint3D<float>* points, const Point3D<float> center, const float scale, const unsigned int pointsCount);
-		
+		__device__ long long computePointCode(const Point3D<float>& point);
+
 		/**
-		 * \brief 为每个稠密点生成一个编码，其中包括点在Octree中的Node位置，临近点，父节点，子节点等.
+		 * \brief 融合的归一化与编码：按设备端的变换调整点坐标，将法线放缩到[-2^(maxDepth + 1), 2^(maxDepth + 1)]，并生成排序编码.
 		 * 
-		 * \param pos 稠密点位置
-		 * \param keys 每个点的编码key
+		 * \param points 【输入输出】稠密点
+		 * \param transform 设备端的归一化变换
+		 * \param keys 【输出】每个点的编码key
 		 * \param pointsNum 点数量
 		 */
-		__global__ void generateCodeKernel(OrientedPoint3D<float>* pos, long long* keys, const unsigned int pointsNum);
+		__global__ void normalizeAndEncodeKernel(OrientedPoint3D<float>* points, const NormalizeTransform* transform, long long* keys, const unsigned int pointsNum);
 
 		/**
 		 * \brief 更新64位编码的后32位，这里需要重置低32位的index，因为DensePoints数组已经是有序的了，之前的index是无需的DensePoints数组.
 		 */
 		__global__ void updataLower32ForSortedDensePoints(const unsigned int sortedKeysCount, long long* sortedVerticesKey);
 
+		/**
+		 * \brief 根据只排序键后的结果，按键低32位记录的原始索引收集稠密点.
+		 * 
+		 * \param sortedKeys 排好序的键，低32位为稠密点在原始数组中的index
+		 * \param points 未排序的稠密点
+		 * \param pointsNum 点数量
+		 * \param sortedPoints 【输出】排好序的稠密点
+		 */
+		__global__ void gatherSortedPointsKernel(const long long* sortedKeys, const OrientedPoint3D<float>* points, const unsigned int pointsNum, OrientedPoint3D<float>* sortedPoints);
+
 		/**
 		 * \brief 【只比较高32bit情况】标记排列好的体素键值(如果当前值不等于前一个值则label = 1， 如果当前值等于前一个值则label = 0).
 		 *
@@ -157,6 +193,15 @@ namespace SparseSurfelFusion {
 		 */
 		__global__ void initNodeArrayDidxDnumKernel(OctNode* NodeArrayD, const unsigned int nodesCount);
 
+		/**
+		 * \brief 由有序的D层Unique编码一次性统计[0, D - 1]每层的Unique节点数量：第d层节点的key是编码的前d段，与前一个编码的前d段不同即为该层新节点.
+		 * 
+		 * \param uniqueCode 有序的D层Unique编码
+		 * \param nodesCount 编码数量
+		 * \param levelUniqueCount 【输出】每层Unique节点数量，需预先置0
+		 */
+		__global__ void countLevelUniqueNodeKernel(DeviceArrayView<long long> uniqueCode, const unsigned int nodesCount, unsigned int* levelUniqueCount);
+
 		/**
 		 * \brief 处理稠密点到NodeArrayD的映射，Num稠密点 >> NodeArrayD，将每个未分配Node的稠密点，往前寻找分配了node的稠密点.
 		 * 
@@ -210,19 +255,20 @@ namespace SparseSurfelFusion {
 		/**
 		 * \brief 更新节点NodeArray的父节点和孩子节点.
 		 * 
-		 * \param BaseAddressArray_Device 每一层节点在NodeArray中的偏移
+		 * \param BaseAddressArray 每一层节点在NodeArray中的偏移(每个实例独立的Device数组，并发的实例互不影响)
 		 * \param totalNodeArrayLength 整个NodeArray一共多少个节点
 		 * \param NodeArray 更新后的NodeArray
 		 */
-		__global__ void updateNodeArrayParentAndChildrenKernel(const unsigned int totalNodeArrayLength, OctNode* NodeArray);
+		__global__ void updateNodeArrayParentAndChildrenKernel(DeviceArrayView<int> BaseAddressArray, const unsigned int totalNodeArrayLength, OctNode* NodeArray);
 
 		/**
 		 * \brief 将无效节点也赋上相应的值.
 		 * 
+		 * \param BaseAddressArray 每一层节点在NodeArray中的偏移
 		 * \param totalNodeArrayLength 整个NodeArray一共多少个节点
 		 * \param NodeArray 更新后的NodeArray
 		 */
-		__global__ void updateEmptyNodeInfo(const unsigned int totalNodeArrayLength, OctNode* NodeArray);
+		__global__ void updateEmptyNodeInfo(DeviceArrayView<int> BaseAddressArray, const unsigned int totalNodeArrayLength, OctNode* NodeArray);
 
 		/**
 		 * \brief 计算节点的邻居，此时需要注意必须顺序计算每一层节点，不能所有层并行【原文：在计算节点的邻居时，需要计算其父节点的邻居。出于这个原因，我们使用顺序遍历八叉树每个层，对每一层执行清单2】
@@ -242,26 +288,75 @@ namespace SparseSurfelFusion {
 		 * \param totalNodeCount 八叉树节点数组NodeArray的节点数量
 		 * \param NodeIndexInFunction 
 		 */
-		__global__ void computeEncodedFunctionNodeIndexKernel(DeviceArrayView<unsigned int> depthBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int totalNodeCount, int* NodeIndexInFunction);
+		__global__ void computeEncodedFunctionNodeIndexKernel(DeviceArrayView<unsigned int> depthBuffer, DeviceArrayView<OctNode> NodeArray, const unsigned int totalNodeCount, EncodedFunctionIndex* NodeIndexInFunction);
 
 		/**
-		 * \brief 将key编码到int32的三个区间[0, 11], [12, 21], [22, 31].
+		 * \brief 将key编码到基函数索引的三个(maxDepth + 1)位区间.
 		 * 
 		 * \param key 传入的x,y,z键值
 		 * \param CurrentDepth 当前节点的在第几层
 		 * \param 计算得到的index
 		 */
-		__device__ void getEncodedFunctionNodeIndex(const int& key, const int& CurrentDepth, int& index);
+		__device__ void getEncodedFunctionNodeIndex(const OctKey& key, const int& CurrentDepth, EncodedFunctionIndex& index);
 
 		/**
 		 * \brief 计算NodeArray中每个节点在八叉树中的深度以及实际中心点.
 		 * 
+		 * \param BaseAddressArray 每一层节点在NodeArray中的偏移
 		 * \param NodeArray 八叉树节点数组
 		 * \param NodeArraySize 八叉树节点数组大小
 		 * \param DepthBuffer 节点数组NodeArrray中节点对应的深度(后续直接查表)
 		 * \param CenterBuffer 节点数组NodeArrray中节点对应中心点坐标(后续直接查表)
 		 */
-		__global__ void ComputeDepthAndCenterKernel(DeviceArrayView<OctNode> NodeArray, const unsigned int NodeArraySize, unsigned int* DepthBuffer, Point3D<float>* CenterBuffer);
+		__global__ void ComputeDepthAndCenterKernel(DeviceArrayView<int> BaseAddressArray, DeviceArrayView<OctNode> NodeArray, const unsigned int NodeArraySize, unsigned int* DepthBuffer, Point3D<float>* CenterBuffer);
+
+		/**
+		 * \brief 将NodeArray的拓扑属性拆分为SoA数组(key、父节点、孩子节点、邻居节点).
+		 * 
+		 * \param NodeArray 八叉树节点数组
+		 * \param NodeArraySize 八叉树节点数组大小
+		 * \param key 【输出】节点key，大小为NodeArraySize
+		 * \param parent 【输出】父节点，大小为NodeArraySize
+		 * \param children 【输出】孩子节点，大小为8 * NodeArraySize
+		 * \param neighs 【输出】邻居节点，大小为27 * NodeArraySize
+		 */
+		__global__ void splitNodeTopologyKernel(DeviceArrayView<OctNode> NodeArray, const unsigned int NodeArraySize, OctKey* key, int* parent, int* children, int* neighs);
+
+		/**
+		 * \brief 计算D层节点的签名(x, y, z为节点内稠密点坐标之和，w为稠密点数量)，用于判断节点的点是否变化.
+		 *
+		 * \param NodeArrayD D层节点
+		 * \param points 排序后的稠密点
+		 * \param nodeNum D层节点数量
+		 * \param keys 【输出】节点key
+		 * \param signature 【输出】节点签名
+		 */
+		__global__ void computeNodeSignatureKernel(DeviceArrayView<OctNode> NodeArrayD, DeviceArrayView<OrientedPoint3D<float>> points, const unsigned int nodeNum, OctKey* keys, float4* signature);
+
+		/**
+		 * \brief 与上一帧的D层节点比较，标记新增或点发生变化的节点，并统计拓扑是否变化.
+		 *
+		 * \param NodeArrayD 本帧D层节点
+		 * \param signature 本帧D层节点签名
+		 * \param previousKeys 上一帧D层节点key(升序)
+		 * \param previousSignature 上一帧D层节点签名
+		 * \param nodeNum 本帧D层节点数量
+		 * \param previousNodeNum 上一帧D层节点数量
+		 * \param tolerance 坐标之和允许的误差
+		 * \param dirty 【输出】节点是否需要重算
+		 * \param transform 本帧的归一化变换，重新计算过时与上一帧不可比较，全部节点需要重算
+		 * \param counter 【输出】counter[0]：位置或key与上一帧不一致的节点数量，counter[1]：需要重算的节点数量
+		 */
+		__global__ void markDirtyNodeKernel(DeviceArrayView<OctNode> NodeArrayD, const float4* signature, const OctKey* previousKeys, const float4* previousSignature, const unsigned int nodeNum, const unsigned int previousNodeNum, const float tolerance, const NormalizeTransform* transform, unsigned char* dirty, unsigned int* counter);
+
+		/**
+		 * \brief 拓扑未变化时，将上一帧的邻居写回重建的NodeArray.
+		 *
+		 * \param neighs 上一帧的邻居SoA数组
+		 * \param NodeArraySize 节点数量
+		 * \param NodeArray 【输出】节点数组
+		 */
+		__global__ void restoreNodeNeighborKernel(const int* neighs, const unsigned int NodeArraySize, OctNode* NodeArray);
 	
 
 		/**
@@ -271,7 +366,7 @@ namespace SparseSurfelFusion {
 		 * \param currentDepth 当前节点的深度
 		 * \param Center 计算获得当前节点的Key的实际中心点
 		 */
-		__device__ void getNodeCenterAllDepth(const int& key, int currentDepth, Point3D<float>& Center);
+		__device__ void getNodeCenterAllDepth(const OctKey& key, int currentDepth, Point3D<float>& Center);
 
 
 	}
@@ -285,9 +380,9 @@ namespace SparseSurfelFusion {
 		/**
 		 * \brief 传入需要重建的点云.
 		 * 
-		 * \param PointCloud
+		 * \param config 运行时容量配置，按最大面元数量预分配显存
 		 */
-		BuildOctree();
+		BuildOctree(const ReconstructionConfig& config = ReconstructionConfig());
 
 		/**
 		 * \brief 析构函数.
@@ -301,8 +396,10 @@ namespace SparseSurfelFusion {
 		 * \param cloud 点云xyz
 		 * \param normals 点云法线
 		 * \param stream cuda流
+		 * \param inputReady 面元上传完成的事件，非NULL时stream在GPU上等待后再读取depthSurfel
+		 * \param inputConsumed 非NULL时在depthSurfel拷贝进八叉树之后记录，之后面元显存可以被覆盖
 		 */
-		void BuildNodesArray(DeviceArrayView<DepthSurfel> depthSurfel, pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals, cudaStream_t stream = 0);
+		void BuildNodesArray(DeviceArrayView<DepthSurfel> depthSurfel, pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals, cudaStream_t stream = 0, cudaEvent_t inputReady = NULL, cudaEvent_t inputConsumed = NULL);
 
 		/**
 		 * \brief 预计算节点的基函数索引【函数内无阻塞】.
@@ -325,6 +422,84 @@ namespace SparseSurfelFusion {
 		 */
 		DeviceBufferArray<OctNode>& GetOctreeNodeArrayHandle() { return NodeArray; }
 
+		/**
+		 * \brief 设置稠密点排序方式：只排序键再按索引收集稠密点，或键值对一起排序(每一轮基数排序都搬运24字节的稠密点).
+		 *
+		 * \param enable 是否只排序键
+		 */
+		void SetSortKeysOnly(const bool enable) { sortKeysOnly = enable; }
+
+		/**
+		 * \brief 设置增量模式：冻结第一帧的归一化使节点key在帧间稳定，与上一帧比较D层节点并标记变化的节点；
+		 *        拓扑(D层节点key集合)未变化时复用上一帧的邻居、SoA拓扑和基函数索引.
+		 *
+		 * \param enable 是否开启
+		 */
+		void SetIncrementalMode(const bool enable) { incrementalMode = enable; normalizationFrozen = false; previousNodeNumD = 0; }
+
+		/**
+		 * \brief 设置压缩拓扑模式：不存储27 * N的SoA邻居数组，拓扑视图中的邻居由key在同层二分查找得到.
+		 *        OctNode::neighs仍在构建中计算(散度、向量场、网格几何与细分依赖它)，只省去SoA的那一份.
+		 *
+		 * \param enable 是否开启
+		 */
+		void SetCompressedTopology(const bool enable) { compressedTopology = enable; previousNodeNumD = 0; }
+
+		/**
+		 * \brief 设置固定包围盒(静止的采集装置连续帧场景)：跳过包围盒归约，直接以该包围盒归一化，节点key在帧间天然可比较.
+		 *        包围盒外的点会被编码到边界节点.
+		 *
+		 * \param minPoint 包围盒最小点
+		 * \param maxPoint 包围盒最大点
+		 * \param scaleFactor 放缩尺寸，与自动包围盒一致默认1.25
+		 */
+		void SetFixedBoundingBox(const Point3D<float>& minPoint, const Point3D<float>& maxPoint, const float scaleFactor = 1.25f);
+
+		/**
+		 * \brief 取消固定包围盒，恢复每帧在设备端归约包围盒.
+		 */
+		void ClearFixedBoundingBox() { fixedBoundingBox = false; }
+
+		/**
+		 * \brief 增量模式下本帧八叉树拓扑是否与上一帧相同.
+		 */
+		bool IsTopologyUnchanged() const { return topologyUnchanged; }
+
+		/**
+		 * \brief 增量模式下D层节点的变化标记，与NodeArray中D层节点(BaseAddressArray[maxDepth]开始)一一对应，1表示需要重算.
+		 */
+		DeviceArrayView<unsigned char> GetDirtyNodeMaskD() const { return DirtyNodeD.ArrayView(); }
+
+		/**
+		 * \brief 增量模式下本帧需要重算的D层节点数量.
+		 */
+		unsigned int GetDirtyNodeCountD() const { return dirtyNodeCountD; }
+
+		/**
+		 * \brief 获得八叉树拓扑属性(key、父节点、孩子节点、邻居节点)的SoA视图，只读取拓扑的核函数应优先使用.
+		 *
+		 * \return 八叉树拓扑视图
+		 */
+		OctNodeTopologyView GetOctreeTopologyView() const {
+			OctNodeTopologyView view;
+			view.key = NodeKeys.Ptr();
+			view.parent = NodeParents.Ptr();
+			view.children = NodeChildren.Ptr();
+			view.nodeNum = NodeArray.ArraySize();
+			if (compressedTopology) {
+				view.neighs = NULL;
+				view.depth = NodeArrayDepthIndex.Ptr();
+				for (int d = 0; d <= Constants::maxDepth_Host; d++) {
+					view.levelOffset[d] = BaseAddressArray_Host[d];
+					view.levelOffset[d + 1] = BaseAddressArray_Host[d] + NodeArrayCount_Host[d];
+				}
+			}
+			else {
+				view.neighs = NodeNeighbors.Ptr();
+			}
+			return view;
+		}
+
 		/**
 		 * \brief 获得NodeArray，每一层节点的数量.
 		 * 
@@ -358,7 +533,7 @@ namespace SparseSurfelFusion {
 		 * 
 		 * \return 预计算节点的函数索引
 		 */
-		DeviceArrayView<int> GetEncodedFunctionNodeIndex() { return EncodedFunctionNodeIndex.ArrayView(); }
+		DeviceArrayView<EncodedFunctionIndex> GetEncodedFunctionNodeIndex() { return EncodedFunctionNodeIndex.ArrayView(); }
 		
 		/**
 		 * \brief 获得BaseAddressArray_Device.
@@ -381,13 +556,46 @@ namespace SparseSurfelFusion {
 		 */
 		DeviceArrayView<Point3D<float>> GetNodeArrayNodeCenter() { return NodeArrayNodeCenter.ArrayView(); }
 
+		/**
+		 * \brief 获得点云归一化到[0, 1]时使用的偏移，原坐标 = 归一化坐标 * NormalizeMaxEdge + NormalizeCenter.
+		 * 
+		 * \return 归一化偏移
+		 */
+		Point3D<float> GetNormalizeCenter() const {
+			waitNormalizeTransform();
+			return Point3D<float>(normalizeTransformHost->center.x, normalizeTransformHost->center.y, normalizeTransformHost->center.z);
+		}
+
+		/**
+		 * \brief 获得点云归一化到[0, 1]时使用的放缩边长.
+		 * 
+		 * \return 归一化放缩边长
+		 */
+		float GetNormalizeMaxEdge() const {
+			waitNormalizeTransform();
+			return normalizeTransformHost->maxEdge;
+		}
+
 	private:
 
+		/**
+		 * \brief 等待最近一次构建的归一化变换读回页锁定内存(构建中只异步拷贝，使用时才等待).
+		 */
+		void waitNormalizeTransform() const { CHECKCUDA(cudaEventSynchronize(normalizeTransformReady)); }
+
+		DeviceBufferArray<PointBoundingBox> boundingBox;						// 设备端归约出的包围盒
+		DeviceBufferArray<NormalizeTransform> normalizeTransform;				// 常驻显存的归一化变换，冻结时跨帧保留
+		DeviceBufferArray<unsigned char> reduceTempStorage;						// 包围盒归约的cub临时存储
+		NormalizeTransform* normalizeTransformHost = NULL;						// 归一化变换的页锁定读回缓冲
+		cudaEvent_t normalizeTransformReady = NULL;								// 归一化变换读回完成
+		bool fixedBoundingBox = false;											// 是否使用固定包围盒
+		bool fixedTransformPending = false;										// 固定包围盒的变换尚未写入设备端
+		NormalizeTransform fixedTransform;										// 由固定包围盒计算的变换
+
 		DeviceBufferArray<OrientedPoint3D<float>> sampleOrientedPoints;			// 记录无顺序稠密点，后续排序
-		SynchronizeArray<Point3D<float>> perBlockMaxPoint;						// 记录每个线程块的最大点
-		SynchronizeArray<Point3D<float>> perBlockMinPoint;						// 记录每个线程块的最小点
 		DeviceBufferArray<long long> sortCode;									// <论文参数>记录稠密点对应的Octree编码Key
 
+		bool sortKeysOnly = true;												// 只排序键后按索引收集稠密点，不在每一轮基数排序中搬运稠密点
 		KeyValueSort<long long, OrientedPoint3D<float>> pointKeySort;			// 【将三维坐标映射到体素，并将体素编码，再将编码排序】对体素键执行排序和压缩
 		DeviceBufferArray<unsigned int> keyLabel;								// 【在排序后的编码中找到，与前一个编码不同的在数组中的index】记录着排序后的体素编码，如果m_voxel_label[idx] != m_voxel_label[idx-1]，则label = 1， 否则label = 0
 		PrefixSum nodeNumsPrefixsum;											// 【nodeNums的前缀和】体素label的前缀和，主要作用是显示前面有几个“与前一个编码不一样”的编码
@@ -403,8 +611,8 @@ namespace SparseSurfelFusion {
 
 		DeviceBufferArray<int> BaseAddressArray_Device;
 
-		DeviceBufferArray<OctNode> NodeArrays[Constants::maxDepth_Host + 1];	// 每层的NodeArray的首地址存在NodeArrays对应的数组中
-		DeviceBufferArray<OctNode> NodeArray;									// <论文参数>将每一层NodeArray数组(首地址)连接起来
+		DeviceBufferArray<OctNode> NodeArray;									// <论文参数>将每一层NodeArray数组(首地址)连接起来，每层直接构建在BaseAddressArray_Host对应的偏移处
+		SynchronizeArray<unsigned int> levelUniqueCount;						// 每层Unique节点数量，由D层编码一次性统计，确定每层满排节点数量与偏移
 		DeviceBufferArray<unsigned int> NodeAddressFull;						// 临时记录当前节点的Address的值,与每一层的NodeArray必须一样大，做到查表映射
 
 		DeviceBufferArray<OctNode> uniqueNodeD;									// 【中间变量】记录第 D 层的UniqueNode
@@ -413,11 +621,29 @@ namespace SparseSurfelFusion {
 		DeviceBufferArray<unsigned int> nodeAddressD;							// 【中间变量】记录第 D 层的NodeAddress
 		DeviceBufferArray<unsigned int> nodeAddressPrevious;					// 【中间变量】记录上一层的NodeAddress
 
-		DeviceBufferArray<int> EncodedFunctionNodeIndex;						// 预计算节点的函数索引
+		DeviceBufferArray<EncodedFunctionIndex> EncodedFunctionNodeIndex;						// 预计算节点的函数索引
 
 		DeviceBufferArray<unsigned int> NodeArrayDepthIndex;					// 记录NodeArray中每个顶点来自于哪一层
 		DeviceBufferArray<Point3D<float>> NodeArrayNodeCenter;					// 记录NodeArray中每个顶点的中心点
 
+		DeviceBufferArray<OctKey> NodeKeys;										// NodeArray拓扑SoA：节点key
+		DeviceBufferArray<int> NodeParents;										// NodeArray拓扑SoA：父节点
+		DeviceBufferArray<int> NodeChildren;									// NodeArray拓扑SoA：孩子节点，每个节点8个
+		DeviceBufferArray<int> NodeNeighbors;									// NodeArray拓扑SoA：邻居节点，每个节点27个
+
+		bool compressedTopology = false;										// 压缩拓扑模式，不存储SoA邻居数组
+		bool incrementalMode = false;											// 增量模式
+		bool normalizationFrozen = false;										// 增量模式下归一化参数是否已冻结
+		bool topologyUnchanged = false;											// 增量模式下本帧拓扑是否与上一帧相同
+		unsigned int previousNodeNumD = 0;										// 上一帧D层节点数量
+		unsigned int dirtyNodeCountD = 0;										// 本帧需要重算的D层节点数量
+		DeviceBufferArray<OctKey> previousKeysD;								// 上一帧D层节点key
+		DeviceBufferArray<float4> previousSignatureD;							// 上一帧D层节点签名
+		DeviceBufferArray<OctKey> KeysD;										// 本帧D层节点key
+		DeviceBufferArray<float4> SignatureD;									// 本帧D层节点签名
+		DeviceBufferArray<unsigned char> DirtyNodeD;							// 本帧D层节点是否需要重算
+		SynchronizeArray<unsigned int> dirtyCounter;							// [0]：与上一帧不一致的节点数量，[1]：需要重算的节点数量
+
 		/**
 		 * \brief 从depthsurfel中获得面元坐标和法线.
 		 *
@@ -427,14 +653,13 @@ namespace SparseSurfelFusion {
 		void getCoordinateAndNormal(DeviceArrayView<DepthSurfel> denseSurfel, cudaStream_t stream = 0);
 
 		/**
-		 * \brief 找到点云范围.
+		 * \brief 在设备端得到本帧的归一化变换：cub归约包围盒后单线程计算变换(固定包围盒时跳过归约)，并异步读回页锁定内存，全程不与Host同步.
 		 * 
 		 * \param points 传入点云
-		 * \param MaxPoint 计算得到的包围盒最大point
-		 * \param MinPoint 计算得到的包围盒最小point
+		 * \param scaleFactor 放缩尺寸
 		 * \param stream cuda流
 		 */
-		void getBoundingBox(DeviceArrayView<OrientedPoint3D<float>> points, Point3D<float>& MaxPoint, Point3D<float>& MinPoint, cudaStream_t stream = 0);
+		void computeNormalizeTransform(DeviceArrayView<OrientedPoint3D<float>> points, const float scaleFactor, cudaStream_t stream = 0);
 
 		/**
 		 * \brief 包围盒可视化.
@@ -443,29 +668,19 @@ namespace SparseSurfelFusion {
 		 * \param MaxPoint 传入最大坐标
 		 * \param MinPoint 传入最小坐标
 		 */
+#if RECONSTRUCTION_WITH_PCL_IO
 		void BoundBoxVisualization(const pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, Point3D<float> MaxPoint, Point3D<float> MinPoint);
+#endif // RECONSTRUCTION_WITH_PCL_IO
 
 		/**
-		 * \brief 调整点的坐标范围.
-		 *
-		 * \param points 需要修改的坐标点
-		 * \param normals 需要修改的法线
-		 * \param MxPoint 最大坐标
-		 * \param MnPoint 最小坐标
-		 * \param Scale BoundingBox最大的边
-		 * \param Center BoundingBox的中心点
-		 * \param stream cuda流
-		 */
-		void adjustPointsCoordinateAndNormal(DeviceBufferArray<OrientedPoint3D<float>>& points, const Point3D<float> MxPoint, const Point3D<float> MnPoint, float& MaxEdge, float ScaleFactor, Point3D<float>& Center, cudaStream_t stream = 0);
-		/**
-		 * \brief 为每个点生成编码.
+		 * \brief 按设备端的归一化变换调整点的坐标与法线，并为每个点生成编码(一个融合的核函数).
 		 * 
 		 * \param points 传入稠密点
 		 * \param key 编码Array
 		 * \param count 稠密点的个数
 		 * \param stream cuda流
 		 */
-		void generateCode(DeviceBufferArray<OrientedPoint3D<float>>& points, DeviceBufferArray<long long>& keys, size_t count, cudaStream_t stream = 0);
+		void normalizeAndEncode(DeviceBufferArray<OrientedPoint3D<float>>& points, DeviceBufferArray<long long>& keys, size_t count, cudaStream_t stream = 0);
 	
 		/**
 		 * \brief 排列点的键.
@@ -499,15 +714,24 @@ namespace SparseSurfelFusion {
 		 * \param compactedKey 压缩的键
 		 * \param NodeAddress 记录8个子节点的位置
 		 * \param Point2NodeArray 稠密点在NodeArray中的位置
-		 * \param NodeArrayD 构建第D层的节点数组
+		 * \param NodeArray 拼接的节点数组，D层构建在BaseAddressArray_Host[D]处
+		 * \param stream cuda流
+		 */
+		void buildNodeArrayD(DeviceArrayView<OrientedPoint3D<float>> denseVertices, DeviceArrayView<OctNode> uniqueNode, DeviceArrayView<long long> compactedKey, DeviceBufferArray<unsigned int>& NodeAddress, DeviceBufferArray<unsigned int>& NodeAddressFull, DeviceBufferArray<int>& Point2NodeArray, DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream = 0);
+
+		/**
+		 * \brief 由D层Unique编码一次性确定每层满排节点数量与偏移(整个构建唯一一次读回Host)，并将NodeArray调整为总节点数量并置0.
+		 *        第d层(d >= 1)满排节点数量 = 8 * 第(d - 1)层Unique节点数量，第0层只有根节点.
+		 * 
+		 * \param uniqueCode 有序的D层Unique编码
 		 * \param stream cuda流
 		 */
-		void buildNodeArrayD(DeviceArrayView<OrientedPoint3D<float>> denseVertices, DeviceArrayView<OctNode> uniqueNode, DeviceArrayView<long long> compactedKey, DeviceBufferArray<unsigned int>& NodeAddress, DeviceBufferArray<unsigned int>& NodeAddressFull, DeviceBufferArray<int>& Point2NodeArray, DeviceBufferArray<OctNode>& NodeArrayD, cudaStream_t stream = 0);
+		void computeLevelLayout(DeviceArrayView<long long> uniqueCode, cudaStream_t stream = 0);
 		
 		/**
-		 * \brief 构建所有层节点的拼接NodeArray以及每一层的首节点BaseAddressArray.
+		 * \brief 自底向上构建[0, D - 1]层节点，直接写入拼接的NodeArray，层间不再与Host同步.
 		 * 
-		 * \param BaseAddressArray 每一层的首节点BaseAddressArray
+		 * \param BaseAddressArray 每一层的首节点BaseAddressArray，由computeLevelLayout计算
 		 * \param stream cuda流
 		 */
 		void buildOtherDepthNodeArray(int* BaseAddressArray_Host, cudaStream_t stream = 0);
@@ -528,6 +752,29 @@ namespace SparseSurfelFusion {
 		 * \param stream cuda流
 		 */
 		void computeNodeNeighbor(DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream = 0);
+
+		/**
+		 * \brief 将构建完成的NodeArray拓扑属性拆分为SoA数组，容量按实际节点数量增长.
+		 * 
+		 * \param NodeArray 节点数组
+		 * \param stream cuda流
+		 */
+		void splitNodeTopology(DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream = 0);
+
+		/**
+		 * \brief 增量模式：与上一帧比较D层节点，得到变化标记和拓扑是否变化，并将本帧D层节点记为上一帧.
+		 * 
+		 * \param stream cuda流
+		 */
+		void detectDirtyNodes(cudaStream_t stream = 0);
+
+		/**
+		 * \brief 拓扑未变化时，将上一帧的邻居写回NodeArray.
+		 * 
+		 * \param NodeArray 节点数组
+		 * \param stream cuda流
+		 */
+		void restoreNodeNeighbor(DeviceBufferArray<OctNode>& NodeArray, cudaStream_t stream = 0);
 	};
 }
 
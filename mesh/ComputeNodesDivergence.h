@@ -12,25 +12,14 @@
 #include <mesh/BuildOctree.h>
 #include <core/AlgorithmTypes.h>
 #include <mesh/Geometry.h>
+#include <mesh/InnerProductTable.cuh>
 #include <base/DeviceReadWrite/DeviceBufferArray.h>
 
+#define DIVERGENCE_WORK_CHUNK_SIZE 32		// 每个线程处理的连续(节点, D层节点)对的数量
+
 namespace SparseSurfelFusion {
 
 	namespace device {
-		/**
-		 * \brief 计算精细节点的散度核函数.
-		 * 
-		 * \param BaseAddressArray 节点偏移数组
-		 * \param encodeNodeIndexInFunction 编码节点的在函数中索引
-		 * \param NodeArray 八叉树一维节点
-		 * \param VectorField 向量场
-		 * \param dot_F_DF 点积表
-		 * \param begin 在NodeArray偏移开始
-		 * \param calculatedNodeNum 需要参与计算的节点总数
-		 * \param Divergence 节点散度
-		 */
-		__global__ void computeFinerNodesDivergenceKernel(DeviceArrayView<int> BaseAddressArray, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<Point3D<float>> VectorField, DeviceArrayView<double> dot_F_DF, const unsigned int begin, const unsigned int calculatedNodeNum, float* Divergence);
-
 		/**
 		 * \brief 两个向量点乘.
 		 * 
@@ -40,38 +29,30 @@ namespace SparseSurfelFusion {
 		__device__ float DotProduct(const Point3D<float>& p1, const Point3D<float>& p2);
 
 		/**
-		 * \brief 计算该节点及其邻居节点所覆盖的maxDepth层节点的数量.
+		 * \brief 计算每个节点的工作量：该节点27个邻居在maxDepth层覆盖的节点数量之和.
 		 * 
 		 * \param NodeArray 八叉树一维节点
-		 * \param index 当前点在NodeArray中的位置
-		 * \param coverNums 覆盖的节点数量
+		 * \param nodeNum 节点数量
+		 * \param workCount 【输出】每个节点的工作量，大小为nodeNum + 1，最后一个元素置0用于扫描得到总数
 		 */
-		__global__ void computeCoverNums(DeviceArrayView<OctNode> NodeArray, const unsigned int index, unsigned int* coverNums);
+		__global__ void computeDivergenceWorkCountKernel(DeviceArrayView<OctNode> NodeArray, const unsigned int nodeNum, unsigned int* workCount);
 
 		/**
-		 * \brief 生成：idx = [0, totalCoverNum)个D层节点，将这些节点映射到D层对应的D_idx.
+		 * \brief 统一计算所有层节点散度的核函数.
+		 *        所有节点的(节点, 覆盖的D层节点)对按节点顺序展平为一个工作列表，每个线程处理连续的DIVERGENCE_WORK_CHUNK_SIZE个对，
+		 *        覆盖很大子树的粗糙节点被均匀分给多个线程，线程内按节点累加后原子加到散度上.
 		 * 
 		 * \param NodeArray 八叉树一维节点
-		 * \param index 当前点在NodeArray中的位置
-		 * \param coverNums 覆盖的节点数量
-		 * \param totalCoverNum 当前节点及其邻居节点覆盖的D层节点的节点总数
-		 * \param DLevelIndexArray 映射关系数组
-		 */
-		__global__ void generateDLevelIndexArrayKernel(DeviceArrayView<OctNode> NodeArray, const unsigned int index, const unsigned int* coverNums, const unsigned int totalCoverNum, unsigned int* DLevelIndexArray);
-
-		/**
-		 * \brief 计算当前节点散度的核函数.
-		 * 
-		 * \param BaseAddressArrayDevice 节点偏移数组
 		 * \param encodeNodeIndexInFunction 编码节点的在函数中索引
 		 * \param VectorField 向量场
-		 * \param dot_F_DF 点积表
-		 * \param index 当前所需要计算的节点在NodeArray中的index
-		 * \param DLevelIndexArray 映射关系数组
-		 * \param totalCoverNum 当前节点及其邻居节点覆盖的D层节点的节点总数
-		 * \param divg 需要计算的散度值，多个值
+		 * \param innerProduct 基函数紧凑内积表
+		 * \param workOffset 每个节点在工作列表中的起始位置，workOffset[nodeNum]为工作总数
+		 * \param nodeNum 节点数量
+		 * \param DLevelOffset maxDepth层首节点在NodeArray中的位置
+		 * \param chunkNum 启动的线程数量(工作总数的上界 / DIVERGENCE_WORK_CHUNK_SIZE)
+		 * \param Divergence 【输出】节点散度，需预先置0
 		 */
-		__global__ void computeCoarserNodesDivergenceKernel(DeviceArrayView<int> BaseAddressArrayDevice, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<Point3D<float>> VectorField, DeviceArrayView<double> dot_F_DF, const unsigned int index, const unsigned int* DLevelIndexArray, const unsigned int totalCoverNum, float* divg);
+		__global__ void computeNodesDivergenceKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<Point3D<float>> VectorField, InnerProductTableView innerProduct, const unsigned int* workOffset, const unsigned int nodeNum, const unsigned int DLevelOffset, const unsigned int chunkNum, float* Divergence);
 	}
 	/**
 	 * \brief 计算节点的散度.
@@ -79,7 +60,7 @@ namespace SparseSurfelFusion {
 	class ComputeNodesDivergence
 	{
 	public:
-		ComputeNodesDivergence();
+		ComputeNodesDivergence(const ReconstructionConfig& config = ReconstructionConfig());
 
 		~ComputeNodesDivergence();
 
@@ -87,18 +68,17 @@ namespace SparseSurfelFusion {
 
 
 		/**
-		 * \brief 计算节点的散度【两个流分别并行执行：时间减少44%】.
+		 * \brief 计算所有层节点的散度，所有层共用一个展平的工作列表，一次启动完成，不需要Host端同步.
 		 *
-		 * \param BaseAddressArrayDevice 节点偏移数组(Host)
+		 * \param BaseAddressArray 节点偏移数组(Host)
 		 * \param NodeArrayCount 每一层节点数量(Host)
 		 * \param encodeNodeIndexInFunction 编码节点的在函数中索引
 		 * \param NodeArray 八叉树一维节点
 		 * \param VectorField 向量场
-		 * \param dot_F_DF 点积表
-		 * \param stream_1 cuda流1
-		 * \param stream_2 cuda流2
+		 * \param innerProduct 基函数紧凑内积表
+		 * \param stream cuda流
 		 */
-		void CalculateNodesDivergence(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<int> BaseAddressArrayDevice, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<Point3D<float>> VectorField, DeviceArrayView<double> dot_F_DF, cudaStream_t stream_1, cudaStream_t stream_2);
+		void CalculateNodesDivergence(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<Point3D<float>> VectorField, const InnerProductTableView& innerProduct, cudaStream_t stream);
 
 		/**
 		 * \brief 获得节点散度(只读).
@@ -116,35 +96,22 @@ namespace SparseSurfelFusion {
 	private:
 
 		DeviceBufferArray<float> Divergence;			// 节点的散度
+		DeviceBufferArray<unsigned int> workCount;		// 每个节点的工作量
+		DeviceBufferArray<unsigned int> workOffset;		// 每个节点在工作列表中的起始位置
+		DeviceBufferArray<unsigned char> tempStorage;	// 扫描的临时空间
 
 		/**
-		 * \brief 计算精细节点的散度【计算[maxDepth - FinerLevelNum, maxDepth]层的节点散度，数据有相差30%，多数是1‰】.
+		 * \brief 扫描得到工作列表并一次启动计算全部节点的散度【不阻塞线程】.
 		 *
-		 * \param BaseAddressArrayDevice 节点偏移数组(GPU)
+		 * \param nodeNum NodeArray中参与计算的节点数量
+		 * \param DLevelOffset maxDepth层首节点在NodeArray中的位置
+		 * \param DLevelNodeNum maxDepth层节点的数量
 		 * \param encodeNodeIndexInFunction 编码节点的在函数中索引
 		 * \param NodeArray 八叉树一维节点
 		 * \param VectorField 向量场
-		 * \param dot_F_DF 点积表
-		 * \param left 参与计算的八叉树节点数组的左边界index  【参与计算节点index的区间范围为[left, right]】
-		 * \param right 参与计算的八叉树节点数组的右边界index 【参与计算节点index的区间范围为[left, right]】
-		 * \param cuda流
-		 */
-		void computeFinerNodesDivergence(DeviceArrayView<int> BaseAddressArrayDevice, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<Point3D<float>> VectorField, DeviceArrayView<double> dot_F_DF, const unsigned int left, const unsigned int right, cudaStream_t stream);
-
-		/**
-		 * \brief 计算粗糙节点的散度【计算[1, CoarserLevelNum]层节点的散度】【不阻塞线程】.
-		 *
-		 * \param BaseAddressArrayDevice 节点偏移数组(GPU)
-		 * \param encodeNodeIndexInFunction 编码节点的在函数中索引
-		 * \param NodeArray 八叉树一维节点
-		 * \param VectorField 向量场
-		 * \param dot_F_DF 点积表
-		 * \param left 参与计算的八叉树节点数组的左边界index  【参与计算节点index的区间范围为[left, right]】
-		 * \param right 参与计算的八叉树节点数组的右边界index 【参与计算节点index的区间范围为[left, right]】
+		 * \param innerProduct 基函数紧凑内积表
 		 * \param stream cuda流
 		 */
-		void computeCoarserNodesDivergence(const int* BaseAddressArray, DeviceArrayView<int> BaseAddressArrayDevice, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<Point3D<float>> VectorField, DeviceArrayView<double> dot_F_DF, const unsigned int left, const unsigned int right, cudaStream_t stream);
+		void computeNodesDivergence(const unsigned int nodeNum, const unsigned int DLevelOffset, const unsigned int DLevelNodeNum, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<Point3D<float>> VectorField, const InnerProductTableView& innerProduct, cudaStream_t stream);
 	};
 }
-
-
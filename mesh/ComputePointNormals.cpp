@@ -0,0 +1,59 @@
+/*****************************************************************//**
+ * \file   ComputePointNormals.cpp
+ * \brief  GPU估计点云法线方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#include "ComputePointNormals.h"
+
+SparseSurfelFusion::ComputePointNormals::ComputePointNormals(const ReconstructionConfig& config)
+{
+	perBlockMaxPoint.AllocateBuffer(divUp(config.maxSurfelCount, device::MaxCudaThreadsPerBlock));
+	perBlockMinPoint.AllocateBuffer(divUp(config.maxSurfelCount, device::MaxCudaThreadsPerBlock));
+	gridCode.AllocateBuffer(config.maxSurfelCount);
+	gridCodeSort.AllocateBuffer(config.maxSurfelCount);
+}
+
+SparseSurfelFusion::ComputePointNormals::~ComputePointNormals()
+{
+	perBlockMaxPoint.DeviceArray().release();
+	perBlockMinPoint.DeviceArray().release();
+	gridCode.ReleaseBuffer();
+	gridCodeSort.ReleaseBuffer();
+}
+
+void SparseSurfelFusion::ComputePointNormals::EstimateNormals(DeviceArrayView<pcl::PointXYZ> points, DeviceBufferArray<pcl::Normal>& normals, const int k, cudaStream_t stream)
+{
+	const unsigned int num = points.Size();
+	normals.ResizeArrayOrException(num);
+	if (num == 0) return;
+	if (k <= 0 || k > MAX_NORMAL_ESTIMATION_K) LOGGING(FATAL) << "法线估计近邻数量k必须在[1, " << MAX_NORMAL_ESTIMATION_K << "]范围内";
+
+#ifdef CHECK_MESH_BUILD_TIME_COST
+	auto time1 = std::chrono::high_resolution_clock::now();
+#endif // CHECK_MESH_BUILD_TIME_COST
+
+	float3 maxPoint, minPoint;
+	getBoundingBox(points, maxPoint, minPoint, stream);
+
+	// 网格边长取点的平均间距的2倍左右，使27邻域内平均包含足够多的点，同时每个维度不超过编码位数
+	const float lx = fmaxf(maxPoint.x - minPoint.x, 1e-6f);
+	const float ly = fmaxf(maxPoint.y - minPoint.y, 1e-6f);
+	const float lz = fmaxf(maxPoint.z - minPoint.z, 1e-6f);
+	const float maxEdge = fmaxf(lx, fmaxf(ly, lz));
+	float cellSize = 2.0f * sqrtf((lx * ly + ly * lz + lz * lx) / num);
+	cellSize = fmaxf(cellSize, maxEdge / ((1 << NORMAL_GRID_AXIS_BITS) - 1));
+	const float invCellSize = 1.0f / cellSize;
+	const int3 gridRes = make_int3(int(lx * invCellSize) + 1, int(ly * invCellSize) + 1, int(lz * invCellSize) + 1);
+
+	sortPointsByGrid(points, minPoint, invCellSize, gridRes, stream);
+	fitPointNormals(points, minPoint, invCellSize, gridRes, k, normals, stream);
+
+#ifdef CHECK_MESH_BUILD_TIME_COST
+	CHECKCUDA(cudaStreamSynchronize(stream));
+	auto time2 = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::milli> duration = time2 - time1;
+	std::cout << "GPU法线估计时间: " << duration.count() << " ms" << std::endl;
+#endif // CHECK_MESH_BUILD_TIME_COST
+}
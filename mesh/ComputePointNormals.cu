@@ -0,0 +1,265 @@
+/*****************************************************************//**
+ * \file   ComputePointNormals.cu
+ * \brief  GPU估计点云法线cuda方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#include <cfloat>
+#include "ComputePointNormals.h"
+
+__global__ void SparseSurfelFusion::device::reducePointsBoundingBoxKernel(DeviceArrayView<pcl::PointXYZ> points, const unsigned int pointsNum, float3* maxBlockData, float3* minBlockData)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	__shared__ float3 MaxPoint[MaxCudaThreadsPerBlock];
+	__shared__ float3 MinPoint[MaxCudaThreadsPerBlock];
+	if (idx < pointsNum) {	// 越界线程也要写入共享内存，保证reduce时每个位置都有值
+		const pcl::PointXYZ point = points[idx];
+		MaxPoint[threadIdx.x] = make_float3(point.x, point.y, point.z);
+		MinPoint[threadIdx.x] = make_float3(point.x, point.y, point.z);
+	}
+	else {
+		MaxPoint[threadIdx.x] = make_float3(-1e6f, -1e6f, -1e6f);
+		MinPoint[threadIdx.x] = make_float3(1e6f, 1e6f, 1e6f);
+	}
+	__syncthreads();
+	// 顺序寻址
+	for (int stride = blockDim.x / 2; stride > 0; stride /= 2) {
+		if (threadIdx.x < stride) {
+			const float3 maxRhs = MaxPoint[threadIdx.x + stride];
+			const float3 minRhs = MinPoint[threadIdx.x + stride];
+			float3& maxLhs = MaxPoint[threadIdx.x];
+			float3& minLhs = MinPoint[threadIdx.x];
+			maxLhs = make_float3(fmaxf(maxLhs.x, maxRhs.x), fmaxf(maxLhs.y, maxRhs.y), fmaxf(maxLhs.z, maxRhs.z));
+			minLhs = make_float3(fminf(minLhs.x, minRhs.x), fminf(minLhs.y, minRhs.y), fminf(minLhs.z, minRhs.z));
+		}
+		__syncthreads();
+	}
+	if (threadIdx.x == 0) {
+		maxBlockData[blockIdx.x] = MaxPoint[0];
+		minBlockData[blockIdx.x] = MinPoint[0];
+	}
+}
+
+__global__ void SparseSurfelFusion::device::computeGridCodeKernel(DeviceArrayView<pcl::PointXYZ> points, const unsigned int pointsNum, const float3 minPoint, const float invCellSize, const int3 gridRes, long long* sortCode)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= pointsNum) return;
+	const pcl::PointXYZ point = points[idx];
+	const int x = min(int((point.x - minPoint.x) * invCellSize), gridRes.x - 1);
+	const int y = min(int((point.y - minPoint.y) * invCellSize), gridRes.y - 1);
+	const int z = min(int((point.z - minPoint.z) * invCellSize), gridRes.z - 1);
+	const long long cell = ((long long)x * gridRes.y + y) * gridRes.z + z;
+	sortCode[idx] = (cell << NORMAL_GRID_CODE_SHIFT) | idx;
+}
+
+__device__ void SparseSurfelFusion::device::findGridCellRange(const long long* sortedCode, const unsigned int pointsNum, const long long cell, int& begin, int& end)
+{
+	const long long lowerCode = cell << NORMAL_GRID_CODE_SHIFT;
+	const long long upperCode = (cell + 1) << NORMAL_GRID_CODE_SHIFT;
+	int left = 0, right = pointsNum;
+	while (left < right) {		// 第一个 >= lowerCode 的位置
+		const int mid = (left + right) >> 1;
+		if (sortedCode[mid] < lowerCode) left = mid + 1;
+		else right = mid;
+	}
+	begin = left;
+	right = pointsNum;
+	while (left < right) {		// 第一个 >= upperCode 的位置
+		const int mid = (left + right) >> 1;
+		if (sortedCode[mid] < upperCode) left = mid + 1;
+		else right = mid;
+	}
+	end = left;
+}
+
+__device__ void SparseSurfelFusion::device::smallestEigenVector(const float cov[6], float3& normal, float& curvature)
+{
+	float a[3][3] = { { cov[0], cov[1], cov[2] }, { cov[1], cov[3], cov[4] }, { cov[2], cov[4], cov[5] } };
+	float v[3][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+	// 循环Jacobi旋转，3x3矩阵通常不超过6轮即可收敛
+	for (int sweep = 0; sweep < 10; sweep++) {
+		const float offDiagonal = fabsf(a[0][1]) + fabsf(a[0][2]) + fabsf(a[1][2]);
+		if (offDiagonal < 1e-12f) break;
+#pragma unroll
+		for (int p = 0; p < 2; p++) {
+#pragma unroll
+			for (int q = p + 1; q < 3; q++) {
+				if (fabsf(a[p][q]) < 1e-20f) continue;
+				const float theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+				const float t = copysignf(1.0f, theta) / (fabsf(theta) + sqrtf(theta * theta + 1.0f));
+				const float c = rsqrtf(t * t + 1.0f);
+				const float s = t * c;
+#pragma unroll
+				for (int r = 0; r < 3; r++) {	// A = A * J
+					const float arp = a[r][p], arq = a[r][q];
+					a[r][p] = c * arp - s * arq;
+					a[r][q] = s * arp + c * arq;
+				}
+#pragma unroll
+				for (int r = 0; r < 3; r++) {	// A = J^T * A
+					const float apr = a[p][r], aqr = a[q][r];
+					a[p][r] = c * apr - s * aqr;
+					a[q][r] = s * apr + c * aqr;
+				}
+#pragma unroll
+				for (int r = 0; r < 3; r++) {	// V = V * J
+					const float vrp = v[r][p], vrq = v[r][q];
+					v[r][p] = c * vrp - s * vrq;
+					v[r][q] = s * vrp + c * vrq;
+				}
+			}
+		}
+	}
+	int minIndex = 0;
+	if (a[1][1] < a[minIndex][minIndex]) minIndex = 1;
+	if (a[2][2] < a[minIndex][minIndex]) minIndex = 2;
+	normal = make_float3(v[0][minIndex], v[1][minIndex], v[2][minIndex]);
+	const float eigenSum = a[0][0] + a[1][1] + a[2][2];
+	curvature = eigenSum > 0.0f ? fabsf(a[minIndex][minIndex] / eigenSum) : 0.0f;
+}
+
+__global__ void SparseSurfelFusion::device::estimateNormalsKernel(DeviceArrayView<pcl::PointXYZ> points, const long long* sortedCode, const unsigned int pointsNum, const float3 minPoint, const float invCellSize, const int3 gridRes, const int k, const float3 viewPoint, pcl::Normal* normals)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= pointsNum) return;
+	const pcl::PointXYZ query = points[idx];
+	const int cx = min(int((query.x - minPoint.x) * invCellSize), gridRes.x - 1);
+	const int cy = min(int((query.y - minPoint.y) * invCellSize), gridRes.y - 1);
+	const int cz = min(int((query.z - minPoint.z) * invCellSize), gridRes.z - 1);
+
+	float knnDistance[MAX_NORMAL_ESTIMATION_K];
+	int knnIndex[MAX_NORMAL_ESTIMATION_K];
+	int found = 0;
+	const float cellSize = 1.0f / invCellSize;
+	const float qx = query.x - minPoint.x, qy = query.y - minPoint.y, qz = query.z - minPoint.z;
+	const int maxRing = max(max(max(cx, gridRes.x - 1 - cx), max(cy, gridRes.y - 1 - cy)), max(cz, gridRes.z - 1 - cz));
+	// 由内向外逐圈搜索：第ring圈为与查询点网格的切比雪夫距离恰为ring的网格.未搜索的点到查询点的距离不小于
+	// 已搜索立方体到查询点最近的面，已有k个近邻且第k近的距离不超过该距离时，结果即为精确的k近邻
+	for (int ring = 0; ring <= maxRing; ring++) {
+		for (int x = max(cx - ring, 0); x <= min(cx + ring, gridRes.x - 1); x++) {
+			const bool xOnShell = abs(x - cx) == ring;
+			for (int y = max(cy - ring, 0); y <= min(cy + ring, gridRes.y - 1); y++) {
+				const bool xyOnShell = xOnShell || abs(y - cy) == ring;
+				const int zStep = xyOnShell ? 1 : 2 * ring;		// (x, y)不在外壳上时只有z = cz ± ring在本圈
+				for (int z = cz - ring; z <= cz + ring; z += zStep) {
+					if (z < 0 || z >= gridRes.z) continue;
+					int begin, end;
+					findGridCellRange(sortedCode, pointsNum, ((long long)x * gridRes.y + y) * gridRes.z + z, begin, end);
+					for (int i = begin; i < end; i++) {
+						const int neighbor = int(sortedCode[i] & 0xFFFFFFFFll);
+						const pcl::PointXYZ point = points[neighbor];
+						const float distance = (point.x - query.x) * (point.x - query.x) + (point.y - query.y) * (point.y - query.y) + (point.z - query.z) * (point.z - query.z);
+						if (found == k && distance >= knnDistance[k - 1]) continue;
+						// 插入排序维护距离升序的前k个
+						int insert = found < k ? found++ : k - 1;
+						while (insert > 0 && knnDistance[insert - 1] > distance) {
+							knnDistance[insert] = knnDistance[insert - 1];
+							knnIndex[insert] = knnIndex[insert - 1];
+							insert--;
+						}
+						knnDistance[insert] = distance;
+						knnIndex[insert] = neighbor;
+					}
+				}
+			}
+		}
+		if (found == k) {
+			// 已搜索立方体[c - ring, c + ring]到查询点最近的面，越过网格边界的面之外没有点
+			float gap = FLT_MAX;
+			if (cx - ring > 0) gap = fminf(gap, qx - (cx - ring) * cellSize);
+			if (cx + ring < gridRes.x - 1) gap = fminf(gap, (cx + ring + 1) * cellSize - qx);
+			if (cy - ring > 0) gap = fminf(gap, qy - (cy - ring) * cellSize);
+			if (cy + ring < gridRes.y - 1) gap = fminf(gap, (cy + ring + 1) * cellSize - qy);
+			if (cz - ring > 0) gap = fminf(gap, qz - (cz - ring) * cellSize);
+			if (cz + ring < gridRes.z - 1) gap = fminf(gap, (cz + ring + 1) * cellSize - qz);
+			gap = fmaxf(gap, 0.0f);
+			if (gap == FLT_MAX || knnDistance[k - 1] <= gap * gap) break;
+		}
+	}
+
+	if (found < 3) {	// 与PCL一致，无法拟合平面时法线置为NaN
+		const float nan = __int_as_float(0x7fffffff);
+		normals[idx].normal_x = nan;
+		normals[idx].normal_y = nan;
+		normals[idx].normal_z = nan;
+		normals[idx].curvature = nan;
+		return;
+	}
+
+	float3 centroid = make_float3(0.0f, 0.0f, 0.0f);
+	for (int i = 0; i < found; i++) {
+		const pcl::PointXYZ point = points[knnIndex[i]];
+		centroid.x += point.x;
+		centroid.y += point.y;
+		centroid.z += point.z;
+	}
+	const float invFound = 1.0f / found;
+	centroid = make_float3(centroid.x * invFound, centroid.y * invFound, centroid.z * invFound);
+	float cov[6] = { 0.0f };
+	for (int i = 0; i < found; i++) {
+		const pcl::PointXYZ point = points[knnIndex[i]];
+		const float px = point.x - centroid.x, py = point.y - centroid.y, pz = point.z - centroid.z;
+		cov[0] += px * px;
+		cov[1] += px * py;
+		cov[2] += px * pz;
+		cov[3] += py * py;
+		cov[4] += py * pz;
+		cov[5] += pz * pz;
+	}
+#pragma unroll
+	for (int i = 0; i < 6; i++) cov[i] *= invFound;
+
+	float3 normal;
+	float curvature;
+	smallestEigenVector(cov, normal, curvature);
+	// 法线朝向视点(PCL flipNormalTowardsViewpoint)
+	const float toViewX = viewPoint.x - query.x, toViewY = viewPoint.y - query.y, toViewZ = viewPoint.z - query.z;
+	if (normal.x * toViewX + normal.y * toViewY + normal.z * toViewZ < 0.0f) {
+		normal = make_float3(-normal.x, -normal.y, -normal.z);
+	}
+	normals[idx].normal_x = normal.x;
+	normals[idx].normal_y = normal.y;
+	normals[idx].normal_z = normal.z;
+	normals[idx].curvature = curvature;
+}
+
+void SparseSurfelFusion::ComputePointNormals::getBoundingBox(DeviceArrayView<pcl::PointXYZ> points, float3& maxPoint, float3& minPoint, cudaStream_t stream)
+{
+	const unsigned int num = points.Size();
+	const unsigned int gridNum = divUp(num, device::MaxCudaThreadsPerBlock);
+	dim3 blockReduce(device::MaxCudaThreadsPerBlock);
+	dim3 gridReduce(gridNum);
+	perBlockMaxPoint.ResizeArrayOrException(gridNum);
+	perBlockMinPoint.ResizeArrayOrException(gridNum);
+	device::reducePointsBoundingBoxKernel << <gridReduce, blockReduce, 0, stream >> > (points, num, perBlockMaxPoint.DevicePtr(), perBlockMinPoint.DevicePtr());
+	perBlockMaxPoint.SynchronizeToHost(stream, true);
+	perBlockMinPoint.SynchronizeToHost(stream, true);
+	const float3* maxArrayHost = perBlockMaxPoint.HostArray().data();
+	const float3* minArrayHost = perBlockMinPoint.HostArray().data();
+	maxPoint = maxArrayHost[0];
+	minPoint = minArrayHost[0];
+	for (unsigned int i = 1; i < gridNum; i++) {
+		maxPoint = make_float3(fmaxf(maxPoint.x, maxArrayHost[i].x), fmaxf(maxPoint.y, maxArrayHost[i].y), fmaxf(maxPoint.z, maxArrayHost[i].z));
+		minPoint = make_float3(fminf(minPoint.x, minArrayHost[i].x), fminf(minPoint.y, minArrayHost[i].y), fminf(minPoint.z, minArrayHost[i].z));
+	}
+}
+
+void SparseSurfelFusion::ComputePointNormals::sortPointsByGrid(DeviceArrayView<pcl::PointXYZ> points, const float3 minPoint, const float invCellSize, const int3 gridRes, cudaStream_t stream)
+{
+	const unsigned int num = points.Size();
+	gridCode.ResizeArrayOrException(num);
+	dim3 block(128);
+	dim3 grid(divUp(num, block.x));
+	device::computeGridCodeKernel << <grid, block, 0, stream >> > (points, num, minPoint, invCellSize, gridRes, gridCode.Ptr());
+	// 低32位的index只用于还原点，不参与基数排序
+	gridCodeSort.SortKeysInBitRange(gridCode.Array(), NORMAL_GRID_CODE_SHIFT, NORMAL_GRID_CODE_SHIFT + 3 * NORMAL_GRID_AXIS_BITS, stream);
+}
+
+void SparseSurfelFusion::ComputePointNormals::fitPointNormals(DeviceArrayView<pcl::PointXYZ> points, const float3 minPoint, const float invCellSize, const int3 gridRes, const int k, DeviceBufferArray<pcl::Normal>& normals, cudaStream_t stream)
+{
+	const unsigned int num = points.Size();
+	dim3 block(128);
+	dim3 grid(divUp(num, block.x));
+	device::estimateNormalsKernel << <grid, block, 0, stream >> > (points, gridCodeSort.valid_sorted_key.ptr(), num, minPoint, invCellSize, gridRes, k, viewPoint, normals.Ptr());
+}
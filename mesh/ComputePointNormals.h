@@ -0,0 +1,154 @@
+/*****************************************************************//**
+ * \file   ComputePointNormals.h
+ * \brief  GPU估计无朝向点云的法线(网格哈希kNN + 协方差特征分解)
+ *
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#pragma once
+#include <chrono>
+#include <cuda_runtime_api.h>
+#include <device_launch_parameters.h>
+#include <pcl/point_types.h>
+#include <base/Constants.h>
+#include <base/DeviceReadWrite/SynchronizeArray.h>
+#include <base/DeviceReadWrite/DeviceBufferArray.h>
+#include <core/AlgorithmTypes.h>
+#include "ReconstructionConfig.h"
+
+#define MAX_NORMAL_ESTIMATION_K 16			// 法线估计kNN的最大近邻数量
+#define NORMAL_GRID_CODE_SHIFT 32			// 排序编码中网格编码的起始位，低位记录点的index
+#define NORMAL_GRID_AXIS_BITS 10			// 网格每个维度的编码位数
+
+namespace SparseSurfelFusion {
+	namespace device {
+		/**
+		 * \brief 归约求解每个线程块内点的最大、最小坐标.
+		 *
+		 * \param points 点云
+		 * \param pointsNum 点的数量
+		 * \param maxBlockData 【输出】每个线程块的最大坐标
+		 * \param minBlockData 【输出】每个线程块的最小坐标
+		 */
+		__global__ void reducePointsBoundingBoxKernel(DeviceArrayView<pcl::PointXYZ> points, const unsigned int pointsNum, float3* maxBlockData, float3* minBlockData);
+
+		/**
+		 * \brief 计算每个点所在网格的排序编码：高位为网格编码，低位为点的index.
+		 *
+		 * \param points 点云
+		 * \param pointsNum 点的数量
+		 * \param minPoint 网格原点
+		 * \param invCellSize 网格边长的倒数
+		 * \param gridRes 每个维度的网格数量
+		 * \param sortCode 【输出】排序编码
+		 */
+		__global__ void computeGridCodeKernel(DeviceArrayView<pcl::PointXYZ> points, const unsigned int pointsNum, const float3 minPoint, const float invCellSize, const int3 gridRes, long long* sortCode);
+
+		/**
+		 * \brief 由内向外逐圈扩展网格搜索精确的k近邻(直到第k近的距离不超过未搜索区域的最近距离)，计算协方差并特征分解得到法线，法线朝向视点.
+		 *
+		 * \param points 点云
+		 * \param sortedCode 升序排列的排序编码
+		 * \param pointsNum 点的数量
+		 * \param minPoint 网格原点
+		 * \param invCellSize 网格边长的倒数
+		 * \param gridRes 每个维度的网格数量
+		 * \param k 近邻数量
+		 * \param viewPoint 视点
+		 * \param normals 【输出】法线，curvature为最小特征值占特征值之和的比例
+		 */
+		__global__ void estimateNormalsKernel(DeviceArrayView<pcl::PointXYZ> points, const long long* sortedCode, const unsigned int pointsNum, const float3 minPoint, const float invCellSize, const int3 gridRes, const int k, const float3 viewPoint, pcl::Normal* normals);
+
+		/**
+		 * \brief 求3x3对称矩阵最小特征值对应的特征向量(Jacobi旋转).
+		 *
+		 * \param cov 对称矩阵的上三角(xx, xy, xz, yy, yz, zz)
+		 * \param normal 【输出】最小特征值对应的单位特征向量
+		 * \param curvature 【输出】最小特征值 / 特征值之和
+		 */
+		__device__ void smallestEigenVector(const float cov[6], float3& normal, float& curvature);
+
+		/**
+		 * \brief 在升序排序编码中查找网格编码为cell的点的范围[begin, end).
+		 *
+		 * \param sortedCode 升序排列的排序编码
+		 * \param pointsNum 点的数量
+		 * \param cell 网格编码
+		 * \param begin 【输出】范围起点
+		 * \param end 【输出】范围终点
+		 */
+		__device__ void findGridCellRange(const long long* sortedCode, const unsigned int pointsNum, const long long cell, int& begin, int& end);
+	}
+
+	/**
+	 * \brief GPU估计点云法线，替代PCL的NormalEstimationOMP：点按网格编码排序后由内向外逐圈扩展网格做精确kNN，
+	 *        每个点求协方差最小特征向量，并与PCL默认行为一致地朝向视点.
+	 */
+	class ComputePointNormals
+	{
+	public:
+		using Ptr = std::shared_ptr<ComputePointNormals>;
+
+		ComputePointNormals(const ReconstructionConfig& config = ReconstructionConfig());
+
+		~ComputePointNormals();
+
+		/**
+		 * \brief 估计点云法线.
+		 *
+		 * \param points 点云
+		 * \param normals 【输出】法线，与点一一对应
+		 * \param k 近邻数量(不超过MAX_NORMAL_ESTIMATION_K)
+		 * \param stream cuda流
+		 */
+		void EstimateNormals(DeviceArrayView<pcl::PointXYZ> points, DeviceBufferArray<pcl::Normal>& normals, const int k = 10, cudaStream_t stream = 0);
+
+		/**
+		 * \brief 设置法线朝向的视点，默认为原点(与PCL一致).
+		 *
+		 * \param point 视点
+		 */
+		void SetViewPoint(const float3 point) { viewPoint = point; }
+
+	private:
+		SynchronizeArray<float3> perBlockMaxPoint;			// 每个线程块的最大坐标
+		SynchronizeArray<float3> perBlockMinPoint;			// 每个线程块的最小坐标
+		DeviceBufferArray<long long> gridCode;				// 网格排序编码
+		KeyValueSort<long long, unsigned int> gridCodeSort;	// 只排序键
+		float3 viewPoint = make_float3(0.0f, 0.0f, 0.0f);	// 法线朝向的视点
+
+		/**
+		 * \brief 求点云包围盒.
+		 *
+		 * \param points 点云
+		 * \param maxPoint 【输出】最大坐标
+		 * \param minPoint 【输出】最小坐标
+		 * \param stream cuda流
+		 */
+		void getBoundingBox(DeviceArrayView<pcl::PointXYZ> points, float3& maxPoint, float3& minPoint, cudaStream_t stream);
+
+		/**
+		 * \brief 计算网格排序编码并按网格编码位排序.
+		 *
+		 * \param points 点云
+		 * \param minPoint 网格原点
+		 * \param invCellSize 网格边长的倒数
+		 * \param gridRes 每个维度的网格数量
+		 * \param stream cuda流
+		 */
+		void sortPointsByGrid(DeviceArrayView<pcl::PointXYZ> points, const float3 minPoint, const float invCellSize, const int3 gridRes, cudaStream_t stream);
+
+		/**
+		 * \brief 在已排序的网格中做kNN并拟合法线.
+		 *
+		 * \param points 点云
+		 * \param minPoint 网格原点
+		 * \param invCellSize 网格边长的倒数
+		 * \param gridRes 每个维度的网格数量
+		 * \param k 近邻数量
+		 * \param normals 【输出】法线
+		 * \param stream cuda流
+		 */
+		void fitPointNormals(DeviceArrayView<pcl::PointXYZ> points, const float3 minPoint, const float invCellSize, const int3 gridRes, const int k, DeviceBufferArray<pcl::Normal>& normals, cudaStream_t stream);
+	};
+}
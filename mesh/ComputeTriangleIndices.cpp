@@ -6,43 +6,49 @@
  * \date   June 3rd 2024
  *********************************************************************/
 #include "ComputeTriangleIndices.h"
+#include <algorithm>
 
-SparseSurfelFusion::ComputeTriangleIndices::ComputeTriangleIndices()
+SparseSurfelFusion::ComputeTriangleIndices::ComputeTriangleIndices(const ReconstructionConfig& config)
 {
-	vvalue.AllocateBuffer(TOTAL_VERTEXARRAY_MAX_COUNT);
-	vexNums.AllocateBuffer(TOTAL_EDGEARRAY_MAX_COUNT);
-	vexAddress.AllocateBuffer(TOTAL_EDGEARRAY_MAX_COUNT);
-	triNums.AllocateBuffer(D_LEVEL_MAX_NODE);
-	triAddress.AllocateBuffer(D_LEVEL_MAX_NODE);
-	cubeCatagory.AllocateBuffer(D_LEVEL_MAX_NODE);
-	markValidVertex.AllocateBuffer(TOTAL_EDGEARRAY_MAX_COUNT);
-	SubdivideNode.AllocateBuffer(TOTAL_NODEARRAY_MAX_COUNT - D_LEVEL_MAX_NODE);				// 非maxDepth层的最大节点数量
-	markValidSubdividedNode.AllocateBuffer(TOTAL_NODEARRAY_MAX_COUNT - D_LEVEL_MAX_NODE);	// 非maxDepth层的最大节点数量
-	SubdivideDepthBuffer.AllocateBuffer(TOTAL_NODEARRAY_MAX_COUNT - D_LEVEL_MAX_NODE);
+	vvalue.AllocateBuffer(config.TotalVertexArrayCount());
+	BaseFunctionValueTable.AllocateBuffer(F_DATA_RES * BASE_FUNCTION_TABLE_RES);
+	vexAddress.AllocateBuffer(config.TotalEdgeArrayCount());
+	hasSurfaceIntersection.AllocateBuffer(config.TotalFaceArrayCount());
+	meshElementCount.AllocateBuffer(2);
+	meshElementCount.ResizeArrayOrException(2);
+	CHECKCUDA(cudaMallocHost((void**)&meshElementCountHost, sizeof(int) * 2));
+	CHECKCUDA(cudaEventCreateWithFlags(&meshElementCountReady, cudaEventDisableTiming));
+	SubdivideNode.AllocateBuffer(config.CoarserNodeArrayCount());				// 非maxDepth层的最大节点数量
+	markValidSubdividedNode.AllocateBuffer(config.CoarserNodeArrayCount());	// 非maxDepth层的最大节点数量
+	SubdivideDepthBuffer.AllocateBuffer(config.CoarserNodeArrayCount());
 	markValidSubdivideVertex.AllocateBuffer(int(1 << 21));									// 设置最大为8^7
 	markValidSubdivideEdge.AllocateBuffer(int(1 << 21));
 	markValidSubdivedeVexNum.AllocateBuffer(int(1 << 21));
-	markValidFinerVexArray.AllocateBuffer(int(1 << 22));
-	markValidFinerEdge.AllocateBuffer(int(1 << 22));
-	markValidFinerVexNum.AllocateBuffer(int(1 << 22));
-
-	MeshTriangleIndex.AllocateBuffer(MAX_MESH_TRIANGLE_COUNT);
-	markValidTriangleIndex.AllocateBuffer(MAX_MESH_TRIANGLE_COUNT);
-	markValidTriangleIndex.ResizeArrayOrException(MAX_MESH_TRIANGLE_COUNT);
-	MeshTriangleVertex.AllocateBuffer(MAX_SURFEL_COUNT);
-	markValidTriangleVertex.AllocateBuffer(MAX_SURFEL_COUNT);
-	markValidTriangleVertex.ResizeArrayOrException(MAX_SURFEL_COUNT);
+	SubdivideCounter.AllocateBuffer(Constants::maxDepth_Host + 2);		// 每层数量(maxDepth + 1个)或每层偏移加总数(maxDepth + 2个)
+	SubdivideCounter.ResizeArrayOrException(Constants::maxDepth_Host + 2);
+
+	MeshTriangleIndex.AllocateBuffer(config.maxMeshTriangleCount);
+	markValidTriangleIndex.AllocateBuffer(config.maxMeshTriangleCount);
+	markValidTriangleIndex.ResizeArrayOrException(config.maxMeshTriangleCount);
+	MeshTriangleVertex.AllocateBuffer(config.maxSurfelCount);
+	markValidTriangleVertex.AllocateBuffer(config.maxSurfelCount);
+	markValidTriangleVertex.ResizeArrayOrException(config.maxSurfelCount);
+
+	previewTriangleCounter.AllocateBuffer(1);
+	previewTriangleCounter.ResizeArrayOrException(1);
+	previewIsoValueSum.AllocateBuffer(1);
+	previewIsoValueSum.ResizeArrayOrException(1);
 }
 
 SparseSurfelFusion::ComputeTriangleIndices::~ComputeTriangleIndices()
 {
 	vvalue.ReleaseBuffer();
-	vexNums.ReleaseBuffer();
+	BaseFunctionValueTable.ReleaseBuffer();
 	vexAddress.ReleaseBuffer();
-	triNums.ReleaseBuffer();
-	triAddress.ReleaseBuffer();
-	cubeCatagory.ReleaseBuffer();
-	markValidVertex.ReleaseBuffer();
+	hasSurfaceIntersection.ReleaseBuffer();
+	meshElementCount.ReleaseBuffer();
+	CHECKCUDA(cudaFreeHost(meshElementCountHost));
+	CHECKCUDA(cudaEventDestroy(meshElementCountReady));
 	SubdivideNode.ReleaseBuffer();
 	markValidSubdividedNode.ReleaseBuffer();
 	SubdivideDepthBuffer.DeviceArray().release();
@@ -50,29 +56,124 @@ SparseSurfelFusion::ComputeTriangleIndices::~ComputeTriangleIndices()
 	markValidSubdivideVertex.ReleaseBuffer();
 	markValidSubdivideEdge.ReleaseBuffer();
 	markValidSubdivedeVexNum.ReleaseBuffer();
-	markValidFinerVexArray.ReleaseBuffer();
-	markValidFinerEdge.ReleaseBuffer();
-	markValidFinerVexNum.ReleaseBuffer();
+	SubdivideRebuildArray.ReleaseBuffer();
+	SubdivideRebuildDepth.ReleaseBuffer();
+	SubdivideRebuildCenter.ReleaseBuffer();
+	SubdivideReplaceNodeId.ReleaseBuffer();
+	SubdivideIsRoot.ReleaseBuffer();
+	SubdivideFixedDepthNums.ReleaseBuffer();
+	SubdivideFixedDepthAddress.ReleaseBuffer();
+	SubdividePreVertexArray.ReleaseBuffer();
+	SubdivideVertexArray.ReleaseBuffer();
+	SubdividePreEdgeArray.ReleaseBuffer();
+	SubdivideEdgeArray.ReleaseBuffer();
+	SubdivideValidEdgeArray.ReleaseBuffer();
+	SubdivideVvalue.ReleaseBuffer();
+	SubdivideVexNums.ReleaseBuffer();
+	SubdivideVexAddress.ReleaseBuffer();
+	SubdivideValidVexAddress.ReleaseBuffer();
+	SubdivideTriNums.ReleaseBuffer();
+	SubdivideTriAddress.ReleaseBuffer();
+	SubdivideCubeCatagory.ReleaseBuffer();
+	SubdivideVertexBuffer.ReleaseBuffer();
+	SubdivideVertexKeyBuffer.ReleaseBuffer();
+	MeshVertexKey.ReleaseBuffer();
+	WeldSortedKey.ReleaseBuffer();
+	WeldVertexId.ReleaseBuffer();
+	WeldSortedVertexId.ReleaseBuffer();
+	WeldRepresentative.ReleaseBuffer();
+	WeldAddress.ReleaseBuffer();
+	WeldVertexRemap.ReleaseBuffer();
+	WeldVertexBuffer.ReleaseBuffer();
+	AdjacencyCornerVertex.ReleaseBuffer();
+	AdjacencyCornerTriangle.ReleaseBuffer();
+	AdjacencySortedVertex.ReleaseBuffer();
+	VertexTriangleOffset.ReleaseBuffer();
+	VertexTriangleList.ReleaseBuffer();
+	SubdivideTriangleBuffer.ReleaseBuffer();
+	SubdivideTempStorage.ReleaseBuffer();
+	SubdivideCounter.ReleaseBuffer();
 
 	MeshTriangleIndex.ReleaseBuffer();
 	markValidTriangleIndex.ReleaseBuffer();
 	MeshTriangleVertex.ReleaseBuffer();
 	markValidTriangleVertex.ReleaseBuffer();
+
+	SetPreviewMesh(false);
+	previewTriangleCounter.ReleaseBuffer();
+	previewIsoValueSum.ReleaseBuffer();
+}
+
+void SparseSurfelFusion::ComputeTriangleIndices::SetPreviewMesh(const bool enable, PreviewMeshCallback callback)
+{
+	std::lock_guard<std::mutex> lock(previewMutex);
+	previewCallback = enable ? callback : PreviewMeshCallback();
+	if (enable == IsPreviewEnabled()) return;
+	for (int i = 0; i < 2; i++) {
+		PreviewMeshSlot& slot = previewSlots[i];
+		if (enable) {
+			// 映射内存由核函数直接写入，发布时Host无需再发起拷贝
+			CHECKCUDA(cudaHostAlloc((void**)&slot.vertices, sizeof(Point3D<float>) * 3 * MAX_PREVIEW_TRIANGLE_COUNT, cudaHostAllocMapped));
+			CHECKCUDA(cudaHostAlloc((void**)&slot.triangles, sizeof(TriangleIndex) * MAX_PREVIEW_TRIANGLE_COUNT, cudaHostAllocMapped));
+			CHECKCUDA(cudaHostGetDevicePointer((void**)&slot.verticesDevice, slot.vertices, 0));
+			CHECKCUDA(cudaHostGetDevicePointer((void**)&slot.trianglesDevice, slot.triangles, 0));
+			CHECKCUDA(cudaMallocHost((void**)&slot.triangleCount, sizeof(int)));
+		}
+		else {
+			CHECKCUDA(cudaFreeHost(slot.vertices));
+			CHECKCUDA(cudaFreeHost(slot.triangles));
+			CHECKCUDA(cudaFreeHost(slot.triangleCount));
+			slot = PreviewMeshSlot();
+		}
+	}
+	previewPendingSlot = 1;
+	previewFrontSlot = -1;
+	previewFrontTriangleCount = 0;
 }
 
-void SparseSurfelFusion::ComputeTriangleIndices::calculateTriangleIndices(DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<FaceNode> FaceArray, DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const float isoValue, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream)
+bool SparseSurfelFusion::ComputeTriangleIndices::GetPreviewMesh(std::vector<Point3D<float>>& vertices, std::vector<TriangleIndex>& triangles)
+{
+	std::lock_guard<std::mutex> lock(previewMutex);
+	if (previewFrontSlot < 0) return false;
+	// 提取只写入另一个槽位，槽位在再次被写入前必须先经过一次发布(持锁)，持锁拷贝期间不会被覆盖
+	const PreviewMeshSlot& slot = previewSlots[previewFrontSlot];
+	vertices.assign(slot.vertices, slot.vertices + 3 * previewFrontTriangleCount);
+	triangles.assign(slot.triangles, slot.triangles + previewFrontTriangleCount);
+	return true;
+}
+
+void CUDART_CB SparseSurfelFusion::ComputeTriangleIndices::publishPreviewMesh(void* userData)
+{
+	ComputeTriangleIndices* self = static_cast<ComputeTriangleIndices*>(userData);
+	const PreviewMeshSlot& slot = self->previewSlots[self->previewPendingSlot];
+	const unsigned int triangleCount = std::min((unsigned int)*slot.triangleCount, (unsigned int)MAX_PREVIEW_TRIANGLE_COUNT);
+	PreviewMeshCallback callback;
+	{
+		std::lock_guard<std::mutex> lock(self->previewMutex);
+		self->previewFrontSlot = self->previewPendingSlot;
+		self->previewFrontTriangleCount = triangleCount;
+		callback = self->previewCallback;
+	}
+	// 本槽位要在下一次发布之后才会再被写入，而流上的后续工作要等本回调返回，回调期间槽位内容不变
+	if (callback) callback(slot.vertices, 3 * triangleCount, slot.triangles, triangleCount);
+}
+
+void SparseSurfelFusion::ComputeTriangleIndices::calculateTriangleIndices(DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<FaceNode> FaceArray, DeviceBufferArray<OctNode>& NodeArray, OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const float isoValue, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream)
 {
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	auto time1 = std::chrono::high_resolution_clock::now();					// 记录开始时间点
 #endif // CHECK_MESH_BUILD_TIME_COST
 	/**************************** Step 0: 清空上一帧的Mesh顶点及索引 ****************************/
-	MeshTriangleIndex.ResizeArrayOrException(0);
-	MeshTriangleVertex.ResizeArrayOrException(0);
+	MeshTriangleCount = 0;
+	MeshVertexCount = 0;
+	subdivisionAppended = false;
+	reserveSubdivideBuffer(MeshVertexKey, outputVertexCapacity());	// 编码与输出顶点一一对应，容量随输出槽
 
 	//printf("VertexCount = %d   EdgeCount = %d   FaceCount = %d\n", VertexArray.Size(), EdgeArray.Size(), FaceArray.Size());
 
+	const int marchingCubesStage = profiler == NULL ? -1 : profiler->Begin("marching_cubes", stream);
 	/**************************** Step 1: 计算八叉树顶点的隐式函数值 ****************************/
-	ComputeVertexImplicitFunctionValue(VertexArray, NodeArray.ArrayView(), BaseFunction, dx, encodeNodeIndexInFunction, isoValue, stream);
+	ComputeVertexImplicitFunctionValue(VertexArray, NodeTopology, BaseFunction, dx, encodeNodeIndexInFunction, isoValue, stream);
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));
 	auto time2 = std::chrono::high_resolution_clock::now();					// 记录结束时间点
@@ -80,31 +181,33 @@ void SparseSurfelFusion::ComputeTriangleIndices::calculateTriangleIndices(Device
 	std::cout << "计算顶点隐式函数值的时间: " << duration1.count() << " ms" << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 
-	/**************************** Step 2: 计算边的数量以及偏移 ****************************/
-	generateVertexNumsAndVertexAddress(EdgeArray, NodeArray.ArrayView(), vvalue.ArrayView(), DLevelOffset, stream);
+	/**************************** Step 2: 单趟生成等值面顶点 ****************************/
+	generateIsoVertices(EdgeArray, NodeArray.ArrayView(), VertexArray, stream);
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));
 	auto time3 = std::chrono::high_resolution_clock::now();							// 记录结束时间点
 	std::chrono::duration<double, std::milli> duration2 = time3 - time2;			// 计算执行时间（以ms为单位）
-	std::cout << "计算顶点数量以及顶点位置偏移的时间: " << duration2.count() << " ms" << std::endl;
+	std::cout << "生成等值面顶点的时间: " << duration2.count() << " ms" << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 
-	/**************************** Step 3: 计算三角形数量以及地址 ****************************/
-	generateTriangleNumsAndTriangleAddress(NodeArray.ArrayView(), vvalue.ArrayView(), DLevelOffset, DLevelNodeCount, stream);
+	/**************************** Step 3: 单趟生成maxDepth层三角形 ****************************/
+	generateIsoTriangles(NodeArray.ArrayView(), FaceArray, DLevelOffset, DLevelNodeCount, stream);
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));
 	auto time4 = std::chrono::high_resolution_clock::now();							// 记录结束时间点
 	std::chrono::duration<double, std::milli> duration3 = time4 - time3;			// 计算执行时间（以ms为单位）
-	std::cout << "计算三角剖分数量以及三角形偏移位置的时间: " << duration3.count() << " ms" << std::endl;
+	std::cout << "生成maxDepth层三角形的时间: " << duration3.count() << " ms" << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 
-	/**************************** Step 4 & 5: 生成节点及三角形网格 ****************************/
-	generateVerticesAndTriangle(NodeArray, VertexArray, EdgeArray, FaceArray, DLevelOffset, DLevelNodeCount, stream);
+	if (profiler != NULL) profiler->End(marchingCubesStage, stream);
+	const int subdivisionStage = profiler == NULL ? -1 : profiler->Begin("subdivision", stream);
+	/**************************** Step 4 & 5: 标记其他层可细分的叶子节点 ****************************/
+	processOtherDepthLeafNodes(NodeArray, VertexArray, DLevelOffset, stream);
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));
 	auto time5 = std::chrono::high_resolution_clock::now();							// 记录结束时间点
 	std::chrono::duration<double, std::milli> duration4 = time5 - time4;			// 计算执行时间（以ms为单位）
-	std::cout << "生成节点和网格Mesh的时间: " << duration4.count() << " ms" << std::endl;
+	std::cout << "标记其他层叶子节点的时间: " << duration4.count() << " ms" << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 
 	/**************************** Step 6: 生成细分节点数组及其每层细分节点偏移和细分节点数量 ****************************/
@@ -134,6 +237,31 @@ void SparseSurfelFusion::ComputeTriangleIndices::calculateTriangleIndices(Device
 	std::cout << "Finer节点细分重构网格的时间: " << duration7.count() << " ms" << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 
+	if (profiler != NULL) profiler->End(subdivisionStage, stream);
+	synchronizeMeshElementCount();	// 未发生细分插入时，在此同步maxDepth层的网格大小
+
+	/**************************** Step 9: 按边编码焊接maxDepth层与细分网格共享的顶点 ****************************/
+	if (vertexWelding && subdivisionAppended) {	// maxDepth层的顶点按边去重生成，没有细分插入时不存在共享顶点
+		StageProfiler::Scope stage(profiler, "vertex_welding", stream);
+		weldMeshVertices(stream);
+	}
+
+	/**************************** Step 10: 可选的网格简化，原地写回输出 ****************************/
+	if (simplification != NULL && simplification->IsEnabled()) {
+		StageProfiler::Scope stage(profiler, "mesh_simplification", stream);
+		simplification->Simplify(outputVertices(), MeshVertexCount, outputTriangles(), MeshTriangleCount, stream);
+	}
+
+	/**************************** Step 11: 可选的顶点→三角形邻接，供绘制时计算顶点法线 ****************************/
+	if (vertexTriangleAdjacency) {
+		StageProfiler::Scope stage(profiler, "vertex_adjacency", stream);
+		buildVertexTriangleAdjacency(stream);
+	}
+	else {
+		VertexTriangleOffset.ResizeArrayOrException(0);
+		VertexTriangleList.ResizeArrayOrException(0);
+	}
+
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
 	auto time9 = std::chrono::high_resolution_clock::now();						// 记录结束时间点
@@ -144,3 +272,11 @@ void SparseSurfelFusion::ComputeTriangleIndices::calculateTriangleIndices(Device
 	std::cout << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 }
+
+void SparseSurfelFusion::ComputeTriangleIndices::DetachOutputSink(cudaStream_t stream)
+{
+	if (!outputSink.IsValid()) return;
+	CHECKCUDA(cudaMemcpyAsync(MeshTriangleVertex.Ptr(), outputSink.vertices, sizeof(Point3D<float>) * MeshVertexCount, cudaMemcpyDeviceToDevice, stream));
+	CHECKCUDA(cudaMemcpyAsync(MeshTriangleIndex.Ptr(), outputSink.triangles, sizeof(TriangleIndex) * MeshTriangleCount, cudaMemcpyDeviceToDevice, stream));
+	ResetOutputSink();
+}
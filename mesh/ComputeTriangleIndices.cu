@@ -6,11 +6,14 @@
  * \date   June 3rd 2024
  *********************************************************************/
 #include "ComputeTriangleIndices.h"
+#include "MarchingCubesTables.h"
 #if defined(__CUDACC__)		// 如果由NVCC编译器编译
 #include <cub/cub.cuh>
 #endif
 #include <thrust/device_ptr.h>
 #include <thrust/copy.h>
+#include <thrust/sequence.h>
+#include <algorithm>
 namespace SparseSurfelFusion {
 
     struct ifSubdivide {
@@ -32,287 +35,17 @@ namespace SparseSurfelFusion {
 
         __device__ __constant__ int maxIntValue = 0x7fffffff;		// 最大int值
 
+        __device__ __constant__ OctKey maxKeyValue = MAX_OCTKEY_VALUE;	// 最大key值
+
         __device__ __constant__ float eps = EPSILON;
 
-        __device__ __constant__ int edgeVertex[12][2] = { {0,1}, {2,3}, {4,5}, {6,7}, {0,3}, {1,2},
-                                                          {4,7}, {5,6}, {0,4}, {1,5}, {3,7}, {2,6} };
+        __device__ __constant__ int edgeVertex[12][2] = MARCHING_CUBES_EDGE_VERTEX;
         
         // 立方体8个顶点，2^8 = 256
-        __constant__ int trianglesCount[256] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 2,
-                                                 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
-                                                 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3, 
-                                                 2, 3, 3, 2, 3, 4, 4, 3, 3, 4, 4, 3, 4, 5, 5, 2,
-                                                 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
-                                                 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 4,
-                                                 2, 3, 3, 4, 3, 4, 2, 3, 3, 4, 4, 5, 4, 5, 3, 2,
-                                                 3, 4, 4, 3, 4, 5, 3, 2, 4, 5, 5, 4, 5, 2, 4, 1,
-                                                 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
-                                                 2, 3, 3, 4, 3, 4, 4, 5, 3, 2, 4, 3, 4, 3, 5, 2,
-                                                 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 4,
-                                                 3, 4, 4, 3, 4, 5, 5, 4, 4, 3, 5, 2, 5, 4, 2, 1,
-                                                 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 2, 3, 3, 2,
-                                                 3, 4, 4, 5, 4, 5, 5, 2, 4, 3, 5, 4, 3, 2, 4, 1,
-                                                 3, 4, 4, 5, 4, 5, 3, 4, 4, 5, 5, 2, 3, 4, 2, 1,
-                                                 2, 3, 3, 2, 3, 4, 2, 1, 3, 2, 4, 1, 2, 1, 1, 0 };
+        __constant__ int trianglesCount[256] = MARCHING_CUBES_TRIANGLES_COUNT;
 
         // Marching Cube三角形查找表
-        __device__ __constant__ int triangles[256][16] = {
-        {  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   4,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   0,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   9,   5,   8,   5,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,   5,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   4,   8,   1,   5,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,  11,   1,   9,   1,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   9,  11,   8,  11,   1,   8,   1,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   1,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   8,   0,  10,   0,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   0,   9,   4,   1,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   8,   9,  10,   9,   5,  10,   5,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,  10,   4,  11,   4,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,  10,   8,  11,   8,   0,  11,   0,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,  11,  10,   9,  10,   4,   9,   4,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   9,  11,   8,  11,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   6,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   6,   2,   0,   4,   6,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   6,   2,   8,   5,   0,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   4,   6,   9,   5,   6,   2,   9,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,   5,  11,   8,   6,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,   5,  11,   6,   2,   0,   4,   6,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   6,   2,   8,   9,  11,   1,   9,   1,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,  11,   2,   2,  11,   1,   2,   1,   6,   6,   1,   4,  -1,  -1,  -1,  -1},
-        {   1,  10,   4,   2,   8,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,   0,   1,   6,   2,   1,  10,   6,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   0,   9,   4,   1,  10,   8,   6,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   2,   9,   5,   6,   2,   5,   1,   6,   1,  10,   6,  -1,  -1,  -1,  -1},
-        {   2,   8,   6,   4,   5,  11,   4,  11,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   2,   0,   6,   2,   5,  11,   6,   5,  10,   6,  11,  -1,  -1,  -1,  -1},
-        {   9,  11,  10,   9,  10,   4,   9,   4,   0,   8,   6,   2,  -1,  -1,  -1,  -1},
-        {   9,  11,   2,   2,  11,   6,  10,   6,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   2,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   9,   2,   4,   8,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   2,   7,   0,   7,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   5,   4,   2,   7,   4,   8,   2,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   9,   2,   5,  11,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,   5,  11,   0,   4,   8,   9,   2,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,   0,   2,   1,   2,   7,   1,   7,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,   7,  11,   1,   2,   7,   1,   4,   2,   4,   8,   2,  -1,  -1,  -1,  -1},
-        {   4,   1,  10,   9,   2,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   9,   2,   0,   1,  10,   0,  10,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   1,  10,   2,   7,   5,   0,   2,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,  10,   8,   1,  10,   2,   7,   1,   2,   5,   1,   7,  -1,  -1,  -1,  -1},
-        {   7,   9,   2,  10,   4,   5,  11,  10,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,  10,   8,  11,   8,   0,  11,   0,   5,   9,   2,   7,  -1,  -1,  -1,  -1},
-        {  11,  10,   7,   7,  10,   4,   7,   4,   2,   2,   4,   0,  -1,  -1,  -1,  -1},
-        {  11,  10,   7,   7,  10,   2,   8,   2,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   9,   8,   6,   7,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   6,   7,   0,   4,   7,   9,   0,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   6,   7,   5,   8,   6,   5,   0,   8,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   6,   7,   5,   4,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,  11,   1,   8,   6,   7,   9,   8,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   6,   7,   0,   4,   7,   9,   0,   7,  11,   1,   5,  -1,  -1,  -1,  -1},
-        {   8,   1,   0,  11,   1,   8,   6,  11,   8,   7,  11,   6,  -1,  -1,  -1,  -1},
-        {  11,   6,   7,   1,   6,  11,   6,   1,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,  10,   4,   6,   7,   9,   6,   9,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   1,   9,   9,   1,  10,   9,  10,   7,   7,  10,   6,  -1,  -1,  -1,  -1},
-        {   6,   7,   5,   8,   6,   5,   0,   8,   5,   1,  10,   4,  -1,  -1,  -1,  -1},
-        {   1,   7,   5,  10,   7,   1,   7,  10,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,  10,   4,  11,   4,   5,   7,   9,   8,   6,   7,   8,  -1,  -1,  -1,  -1},
-        {   0,   6,   9,   9,   6,   7,   6,   0,   5,   5,  11,  10,   5,  10,   6,  -1},
-        {   8,   7,   0,   6,   7,   8,   4,   0,   7,  11,  10,   4,   7,  11,   4,  -1},
-        {  11,  10,   6,  11,   6,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   7,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   4,   8,  11,   7,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   5,   0,  11,   7,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   7,   3,   4,   8,   9,   5,   4,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   1,   5,   3,   5,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   4,   8,   7,   3,   1,   5,   7,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   1,   0,   3,   0,   9,   3,   9,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   8,   9,   4,   8,   7,   3,   4,   7,   1,   4,   3,  -1,  -1,  -1,  -1},
-        {   1,  10,   4,   3,  11,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,  11,   7,   8,   0,   1,  10,   8,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   1,  10,   5,   0,   9,  11,   7,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   8,   9,  10,   9,   5,  10,   5,   1,  11,   7,   3,  -1,  -1,  -1,  -1},
-        {   4,   5,   7,   4,   7,   3,   4,   3,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   8,   3,   3,   8,   0,   3,   0,   7,   7,   0,   5,  -1,  -1,  -1,  -1},
-        {   4,   3,  10,   4,   7,   3,   4,   0,   7,   0,   9,   7,  -1,  -1,  -1,  -1},
-        {  10,   8,   3,   3,   8,   7,   9,   7,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   7,   3,   8,   6,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   7,   3,   2,   0,   4,   2,   4,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   7,   3,   8,   6,   2,   5,   0,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   4,   6,   9,   5,   6,   2,   9,   6,   3,  11,   7,  -1,  -1,  -1,  -1},
-        {   8,   6,   2,   3,   1,   5,   3,   5,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   1,   5,   3,   5,   7,   6,   2,   0,   4,   6,   0,  -1,  -1,  -1,  -1},
-        {   3,   1,   0,   3,   0,   9,   3,   9,   7,   2,   8,   6,  -1,  -1,  -1,  -1},
-        {   9,   4,   2,   2,   4,   6,   4,   9,   7,   7,   3,   1,   7,   1,   4,  -1},
-        {   8,   6,   2,  11,   7,   3,   4,   1,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,   0,   1,   6,   2,   1,  10,   6,   1,  11,   7,   3,  -1,  -1,  -1,  -1},
-        {   5,   0,   9,   4,   1,  10,   8,   6,   2,  11,   7,   3,  -1,  -1,  -1,  -1},
-        {  11,   7,   3,   5,   2,   9,   5,   6,   2,   5,   1,   6,   1,  10,   6,  -1},
-        {   4,   5,   7,   4,   7,   3,   4,   3,  10,   6,   2,   8,  -1,  -1,  -1,  -1},
-        {  10,   5,   3,   3,   5,   7,   5,  10,   6,   6,   2,   0,   6,   0,   5,  -1},
-        {   8,   6,   2,   4,   3,  10,   4,   7,   3,   4,   0,   7,   0,   9,   7,  -1},
-        {   9,   7,  10,  10,   7,   3,  10,   6,   9,   6,   2,   9,  -1,  -1,  -1,  -1},
-        {   3,  11,   9,   2,   3,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   8,   0,   2,   3,  11,   2,  11,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   2,   3,   0,   3,  11,   0,  11,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,   3,   8,   8,   3,  11,   8,  11,   4,   4,  11,   5,  -1,  -1,  -1,  -1},
-        {   2,   3,   1,   2,   1,   5,   2,   5,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,   3,   1,   2,   1,   5,   2,   5,   9,   0,   4,   8,  -1,  -1,  -1,  -1},
-        {   0,   2,   3,   0,   3,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,   3,   8,   8,   3,   4,   1,   4,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,  10,   4,   9,   2,   3,  11,   9,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   8,   0,  10,   0,   1,   3,  11,   9,   2,   3,   9,  -1,  -1,  -1,  -1},
-        {   0,   2,   3,   0,   3,  11,   0,  11,   5,   1,  10,   4,  -1,  -1,  -1,  -1},
-        {   5,   2,  11,  11,   2,   3,   2,   5,   1,   1,  10,   8,   1,   8,   2,  -1},
-        {  10,   2,   3,   9,   2,  10,   4,   9,  10,   5,   9,   4,  -1,  -1,  -1,  -1},
-        {   5,  10,   0,   0,  10,   8,  10,   5,   9,   9,   2,   3,   9,   3,  10,  -1},
-        {   0,   2,   4,   4,   2,  10,   3,  10,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   8,   2,  10,   2,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   9,   8,   3,  11,   8,   6,   3,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,  11,   9,   3,  11,   0,   4,   3,   0,   6,   3,   4,  -1,  -1,  -1,  -1},
-        {  11,   5,   3,   5,   0,   3,   0,   6,   3,   0,   8,   6,  -1,  -1,  -1,  -1},
-        {   3,   4,   6,  11,   4,   3,   4,  11,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   1,   6,   6,   1,   5,   6,   5,   8,   8,   5,   9,  -1,  -1,  -1,  -1},
-        {   0,   6,   9,   4,   6,   0,   5,   9,   6,   3,   1,   5,   6,   3,   5,  -1},
-        {   3,   1,   6,   6,   1,   8,   0,   8,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   1,   4,   3,   4,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   9,   8,   3,  11,   8,   6,   3,   8,   4,   1,  10,  -1,  -1,  -1,  -1},
-        {   3,   9,   6,  11,   9,   3,  10,   6,   9,   0,   1,  10,   9,   0,  10,  -1},
-        {   4,   1,  10,  11,   5,   3,   5,   0,   3,   0,   6,   3,   0,   8,   6,  -1},
-        {   5,  10,   6,   1,  10,   5,   6,  11,   5,   6,   3,  11,  -1,  -1,  -1,  -1},
-        {  10,   5,   3,   4,   5,  10,   6,   3,   5,   9,   8,   6,   5,   9,   6,  -1},
-        {   6,   3,  10,   9,   0,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,  10,   0,   0,  10,   4,   0,   8,   3,   8,   6,   3,  -1,  -1,  -1,  -1},
-        {   6,   3,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   3,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   6,  10,   0,   4,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   0,   9,  10,   3,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   6,  10,   8,   9,   5,   8,   5,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   1,   5,  10,   3,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   4,   8,   1,   5,  11,  10,   3,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   3,   6,   0,   9,  11,   1,   0,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   9,  11,   8,  11,   1,   8,   1,   4,  10,   3,   6,  -1,  -1,  -1,  -1},
-        {   4,   1,   3,   6,   4,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   1,   3,   8,   0,   3,   6,   8,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   0,   9,   3,   6,   4,   1,   3,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   9,   6,   6,   9,   5,   6,   5,   3,   3,   5,   1,  -1,  -1,  -1,  -1},
-        {   6,   4,   5,   6,   5,  11,   6,  11,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   6,   8,   0,   3,   6,   0,   5,   3,   5,  11,   3,  -1,  -1,  -1,  -1},
-        {   3,   9,  11,   0,   9,   3,   6,   0,   3,   4,   0,   6,  -1,  -1,  -1,  -1},
-        {   8,   9,   6,   6,   9,   3,  11,   3,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,   8,  10,   3,   2,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   2,   0,  10,   3,   0,   4,  10,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   0,   9,   8,  10,   3,   8,   3,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   3,   2,  10,   3,   9,   5,  10,   9,   4,  10,   5,  -1,  -1,  -1,  -1},
-        {  11,   1,   5,   2,   8,  10,   3,   2,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   2,   0,  10,   3,   0,   4,  10,   0,   5,  11,   1,  -1,  -1,  -1,  -1},
-        {   9,  11,   1,   9,   1,   0,   2,   8,  10,   3,   2,  10,  -1,  -1,  -1,  -1},
-        {  10,   2,   4,   3,   2,  10,   1,   4,   2,   9,  11,   1,   2,   9,   1,  -1},
-        {   1,   3,   2,   4,   1,   2,   8,   4,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   1,   3,   2,   0,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,   3,   2,   4,   1,   2,   8,   4,   2,   9,   5,   0,  -1,  -1,  -1,  -1},
-        {   9,   3,   2,   5,   3,   9,   3,   5,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   2,  11,  11,   2,   8,  11,   8,   5,   5,   8,   4,  -1,  -1,  -1,  -1},
-        {   5,   2,   0,  11,   2,   5,   2,  11,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   3,   8,   8,   3,   2,   3,   4,   0,   0,   9,  11,   0,  11,   3,  -1},
-        {   9,  11,   3,   9,   3,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   3,   6,   9,   2,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   2,   7,  10,   3,   6,   0,   4,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   3,   6,   7,   5,   0,   7,   0,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   5,   4,   2,   7,   4,   8,   2,   4,  10,   3,   6,  -1,  -1,  -1,  -1},
-        {  10,   3,   6,   9,   2,   7,   1,   5,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   3,   6,   9,   2,   7,   1,   5,  11,   0,   4,   8,  -1,  -1,  -1,  -1},
-        {   1,   0,   2,   1,   2,   7,   1,   7,  11,   3,   6,  10,  -1,  -1,  -1,  -1},
-        {  10,   3,   6,   1,   7,  11,   1,   2,   7,   1,   4,   2,   4,   8,   2,  -1},
-        {   9,   2,   7,   6,   4,   1,   6,   1,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   1,   3,   8,   0,   3,   6,   8,   3,   7,   9,   2,  -1,  -1,  -1,  -1},
-        {   0,   2,   7,   0,   7,   5,   4,   1,   3,   6,   4,   3,  -1,  -1,  -1,  -1},
-        {   2,   5,   8,   7,   5,   2,   6,   8,   5,   1,   3,   6,   5,   1,   6,  -1},
-        {   6,   4,   5,   6,   5,  11,   6,  11,   3,   7,   9,   2,  -1,  -1,  -1,  -1},
-        {   9,   2,   7,   0,   6,   8,   0,   3,   6,   0,   5,   3,   5,  11,   3,  -1},
-        {   3,   4,  11,   6,   4,   3,   7,  11,   4,   0,   2,   7,   4,   0,   7,  -1},
-        {  11,   3,   8,   8,   3,   6,   8,   2,  11,   2,   7,  11,  -1,  -1,  -1,  -1},
-        {   9,   8,  10,   7,   9,  10,   3,   7,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   0,   7,   0,   4,   7,   4,   3,   7,   4,  10,   3,  -1,  -1,  -1,  -1},
-        {   8,  10,   0,   0,  10,   3,   0,   3,   5,   5,   3,   7,  -1,  -1,  -1,  -1},
-        {  10,   5,   4,   3,   5,  10,   5,   3,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   8,  10,   7,   9,  10,   3,   7,  10,   1,   5,  11,  -1,  -1,  -1,  -1},
-        {   1,   5,  11,   9,   0,   7,   0,   4,   7,   4,   3,   7,   4,  10,   3,  -1},
-        {  11,   0,   7,   1,   0,  11,   3,   7,   0,   8,  10,   3,   0,   8,   3,  -1},
-        {   7,   1,   4,  11,   1,   7,   4,   3,   7,   4,  10,   3,  -1,  -1,  -1,  -1},
-        {   4,   9,   8,   7,   9,   4,   1,   7,   4,   3,   7,   1,  -1,  -1,  -1,  -1},
-        {   7,   1,   3,   9,   1,   7,   1,   9,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   7,   0,   0,   7,   5,   7,   8,   4,   4,   1,   3,   4,   3,   7,  -1},
-        {   5,   1,   3,   7,   5,   3,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   4,  11,  11,   4,   5,   4,   3,   7,   7,   9,   8,   7,   8,   4,  -1},
-        {   3,   9,   0,   7,   9,   3,   0,  11,   3,   0,   5,  11,  -1,  -1,  -1,  -1},
-        {   3,   7,  11,   8,   4,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   3,   7,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   6,  10,  11,   7,   6,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,   4,   8,  10,  11,   7,  10,   7,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   5,   0,   6,  10,  11,   7,   6,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   9,   5,   8,   5,   4,   6,  10,  11,   7,   6,  11,  -1,  -1,  -1,  -1},
-        {   5,   7,   6,   5,   6,  10,   5,  10,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   7,   6,   5,   6,  10,   5,  10,   1,   4,   8,   0,  -1,  -1,  -1,  -1},
-        {   1,   0,  10,  10,   0,   9,  10,   9,   6,   6,   9,   7,  -1,  -1,  -1,  -1},
-        {   1,   7,  10,  10,   7,   6,   7,   1,   4,   4,   8,   9,   4,   9,   7,  -1},
-        {   7,   6,   4,   7,   4,   1,   7,   1,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   0,   1,   8,   0,  11,   7,   8,  11,   6,   8,   7,  -1,  -1,  -1,  -1},
-        {   7,   6,   4,   7,   4,   1,   7,   1,  11,   5,   0,   9,  -1,  -1,  -1,  -1},
-        {  11,   6,   1,   7,   6,  11,   5,   1,   6,   8,   9,   5,   6,   8,   5,  -1},
-        {   4,   5,   7,   4,   7,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   7,   0,   0,   7,   8,   6,   8,   7,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   6,   9,   9,   6,   0,   4,   0,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   9,   7,   8,   7,   6,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,  10,  11,   2,   8,  11,   7,   2,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,  11,   4,   4,  11,   7,   4,   7,   0,   0,   7,   2,  -1,  -1,  -1,  -1},
-        {   8,  10,  11,   2,   8,  11,   7,   2,  11,   5,   0,   9,  -1,  -1,  -1,  -1},
-        {   9,   4,   2,   5,   4,   9,   7,   2,   4,  10,  11,   7,   4,  10,   7,  -1},
-        {   1,   8,  10,   2,   8,   1,   5,   2,   1,   7,   2,   5,  -1,  -1,  -1,  -1},
-        {   1,   7,  10,   5,   7,   1,   4,  10,   7,   2,   0,   4,   7,   2,   4,  -1},
-        {   7,   1,   9,   9,   1,   0,   1,   7,   2,   2,   8,  10,   2,  10,   1,  -1},
-        {   7,   2,   9,  10,   1,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   4,   2,   4,   1,   2,   1,   7,   2,   1,  11,   7,  -1,  -1,  -1,  -1},
-        {  11,   0,   1,   7,   0,  11,   0,   7,   2,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   0,   9,   8,   4,   2,   4,   1,   2,   1,   7,   2,   1,  11,   7,  -1},
-        {   2,   5,   1,   9,   5,   2,   1,   7,   2,   1,  11,   7,  -1,  -1,  -1,  -1},
-        {   4,   5,   8,   8,   5,   2,   7,   2,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   2,   0,   5,   7,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   7,   2,   4,   4,   2,   8,   4,   0,   7,   0,   9,   7,  -1,  -1,  -1,  -1},
-        {   7,   2,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,  11,   9,   6,  10,   9,   2,   6,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,  11,   9,   6,  10,   9,   2,   6,   9,   0,   4,   8,  -1,  -1,  -1,  -1},
-        {   5,  10,  11,   6,  10,   5,   0,   6,   5,   2,   6,   0,  -1,  -1,  -1,  -1},
-        {   2,   5,   8,   8,   5,   4,   5,   2,   6,   6,  10,  11,   6,  11,   5,  -1},
-        {  10,   1,   6,   1,   5,   6,   5,   2,   6,   5,   9,   2,  -1,  -1,  -1,  -1},
-        {   0,   4,   8,  10,   1,   6,   1,   5,   6,   5,   2,   6,   5,   9,   2,  -1},
-        {   1,   0,  10,  10,   0,   6,   2,   6,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,   6,   1,   1,   6,  10,   1,   4,   2,   4,   8,   2,  -1,  -1,  -1,  -1},
-        {  11,   9,   1,   1,   9,   2,   1,   2,   4,   4,   2,   6,  -1,  -1,  -1,  -1},
-        {   8,   1,   6,   0,   1,   8,   2,   6,   1,  11,   9,   2,   1,  11,   2,  -1},
-        {  11,   6,   1,   1,   6,   4,   6,  11,   5,   5,   0,   2,   5,   2,   6,  -1},
-        {   2,   6,   8,  11,   5,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   6,   4,   2,   2,   4,   9,   5,   9,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   9,   6,   6,   9,   2,   6,   8,   5,   8,   0,   5,  -1,  -1,  -1,  -1},
-        {   0,   2,   6,   0,   6,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   2,   6,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,  10,  11,   9,   8,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   0,  11,   9,   4,  11,   0,  11,   4,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,  10,  11,   0,  10,   5,  10,   0,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,  10,  11,   5,   4,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,   8,  10,   5,   8,   1,   8,   5,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   4,  10,   0,   4,   9,  10,   5,   9,  10,   1,   5,  -1,  -1,  -1,  -1},
-        {   0,   8,  10,   1,   0,  10,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  10,   1,   4,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   4,   9,   8,   1,   9,   4,   9,   1,  11,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   1,  11,   9,   0,   1,   9,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  11,   0,   8,   5,   0,  11,   8,   1,  11,   8,   4,   1,  -1,  -1,  -1,  -1},
-        {  11,   5,   1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   5,   9,   8,   4,   5,   8,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   9,   0,   5,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {   8,   4,   0,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1},
-        {  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1} };
+        __device__ __constant__ int triangles[256][16] = MARCHING_CUBES_TRIANGLES;
         
         __device__ __constant__ int faceEdges[6][4] = { {4,  6,  8,  10},
                                                         {5,  7,  9,  11},
@@ -343,54 +76,73 @@ namespace SparseSurfelFusion {
         };
 	}
 }
-__global__ void SparseSurfelFusion::device::ComputeVertexImplicitFunctionValueKernel(DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, const unsigned int VertexArraySize, const float isoValue, float* vvalue)
+__global__ void SparseSurfelFusion::device::buildBaseFunctionValueTableKernel(DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const unsigned int tableSize, float* BaseFunctionValueTable)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= tableSize)	return;
+    const unsigned int function = idx / BASE_FUNCTION_TABLE_RES;
+    const unsigned int gridIndex = idx % BASE_FUNCTION_TABLE_RES;
+    BaseFunctionValueTable[idx] = value(BaseFunctions[function], float(gridIndex) / float(1 << MAX_DEPTH_OCTREE));
+}
+
+__device__ __forceinline__ bool SparseSurfelFusion::device::vertexGridCoordinate(const Point3D<float>& pos, int3& gridCoord)
+{
+    const float scale = float(1 << MAX_DEPTH_OCTREE);
+    const float gx = pos.coords[0] * scale;
+    const float gy = pos.coords[1] * scale;
+    const float gz = pos.coords[2] * scale;
+    gridCoord = make_int3(__float2int_rn(gx), __float2int_rn(gy), __float2int_rn(gz));
+    if (fabsf(gx - gridCoord.x) > 1e-3f || fabsf(gy - gridCoord.y) > 1e-3f || fabsf(gz - gridCoord.z) > 1e-3f) return false;
+    return 0 <= gridCoord.x && gridCoord.x < BASE_FUNCTION_TABLE_RES && 0 <= gridCoord.y && gridCoord.y < BASE_FUNCTION_TABLE_RES && 0 <= gridCoord.z && gridCoord.z < BASE_FUNCTION_TABLE_RES;
+}
+
+__device__ __forceinline__ float SparseSurfelFusion::device::baseFunctionProductValue(const float* BaseFunctionValueTable, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const EncodedFunctionIndex encodeIdx, const Point3D<float>& pos, const bool onGrid, const int3& gridCoord)
+{
+    const int idxX = int(encodeIdx % decodeOffset_1);
+    const int idxY = int((encodeIdx / decodeOffset_1) % decodeOffset_1);
+    const int idxZ = int(encodeIdx / decodeOffset_2);
+    if (onGrid) {
+        return __ldg(&BaseFunctionValueTable[idxX * BASE_FUNCTION_TABLE_RES + gridCoord.x]) * __ldg(&BaseFunctionValueTable[idxY * BASE_FUNCTION_TABLE_RES + gridCoord.y]) * __ldg(&BaseFunctionValueTable[idxZ * BASE_FUNCTION_TABLE_RES + gridCoord.z]);
+    }
+    // 不在网格上(理论上不会出现)时逐段求多项式，按引用访问避免复制多项式
+    return value(BaseFunctions[idxX], pos.coords[0]) * value(BaseFunctions[idxY], pos.coords[1]) * value(BaseFunctions[idxZ], pos.coords[2]);
+}
+
+__global__ void SparseSurfelFusion::device::ComputeVertexImplicitFunctionValueKernel(DeviceArrayView<VertexNode> VertexArray, OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float* BaseFunctionValueTable, const unsigned int VertexArraySize, const float isoValue, const MeshRegionsOfInterest regions, float* vvalue)
 {
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
     if (idx >= VertexArraySize)	return;
     VertexNode nowVertex = VertexArray[idx];
     int depth = nowVertex.depth;
+    // 与区域相交的本层节点，其角点都在区域扩展一个节点宽的范围内；VertexArray按节点顺序排列，同一线程束的顶点在空间上相邻，裁剪基本不产生分支发散
+    if (regions.count > 0 && !regions.Contains(nowVertex.pos, 1.0f / (1 << depth))) {
+        vvalue[idx] = __int_as_float(0x7fc00000);   // NaN：与任何值比较均为false，不产生等值面顶点
+        return;
+    }
     float val = 0.0f;
+    int3 gridCoord;
+    const bool onGrid = vertexGridCoordinate(nowVertex.pos, gridCoord);   // 顶点在maxDepth网格上时基函数值直接查表
     int exceedChildrenId = childrenVertexKind[nowVertex.vertexKind];
     int nowNode = nowVertex.ownerNodeIdx;
     if (nowNode > 0) {
         while (nowNode != -1) {
             for (int i = 0; i < 27; i++) {
-                int neighbor = NodeArray[nowNode].neighs[i];
+                int neighbor = NodeTopology.Neighbor(nowNode, i);
                 if (neighbor != -1) {
-                    int idxO[3];
-                    int encode_idx = encodeNodeIndexInFunction[neighbor];
-                    idxO[0] = encode_idx % decodeOffset_1;
-                    idxO[1] = (encode_idx / decodeOffset_1) % decodeOffset_1;
-                    idxO[2] = encode_idx / decodeOffset_2;
-
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcX = BaseFunctions[idxO[0]];
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcY = BaseFunctions[idxO[1]];
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcZ = BaseFunctions[idxO[2]];
-
-                    val += dx[neighbor] * value(funcX, nowVertex.pos.coords[0]) * value(funcY, nowVertex.pos.coords[1]) * value(funcZ, nowVertex.pos.coords[2]);
+                    val += dx[neighbor] * baseFunctionProductValue(BaseFunctionValueTable, BaseFunctions, encodeNodeIndexInFunction[neighbor], nowVertex.pos, onGrid, gridCoord);
                 }
             }
-            nowNode = NodeArray[nowNode].parent;
+            nowNode = NodeTopology.Parent(nowNode);
         }
         nowNode = nowVertex.ownerNodeIdx;
         while (depth < device::maxDepth) {
             depth++;
-            nowNode = NodeArray[nowNode].children[exceedChildrenId];
+            nowNode = NodeTopology.Child(nowNode, exceedChildrenId);
             if (nowNode == -1) break;
             for (int i = 0; i < 27; i++) {
-                int neighbor = NodeArray[nowNode].neighs[i];
+                int neighbor = NodeTopology.Neighbor(nowNode, i);
                 if (neighbor != -1) {
-                    int idxO[3];
-                    int encode_idx = encodeNodeIndexInFunction[neighbor];
-                    idxO[0] = encode_idx % decodeOffset_1;
-                    idxO[1] = (encode_idx / decodeOffset_1) % decodeOffset_1;
-                    idxO[2] = encode_idx / decodeOffset_2;
-
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcX = BaseFunctions[idxO[0]];
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcY = BaseFunctions[idxO[1]];
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcZ = BaseFunctions[idxO[2]];
-
-                    val += dx[neighbor] * value(funcX, nowVertex.pos.coords[0]) * value(funcY, nowVertex.pos.coords[1]) * value(funcZ, nowVertex.pos.coords[2]);
+                    val += dx[neighbor] * baseFunctionProductValue(BaseFunctionValueTable, BaseFunctions, encodeNodeIndexInFunction[neighbor], nowVertex.pos, onGrid, gridCoord);
                 }
             }
         }
@@ -398,67 +150,99 @@ __global__ void SparseSurfelFusion::device::ComputeVertexImplicitFunctionValueKe
     vvalue[idx] = val - isoValue;
 }
 
-__global__ void SparseSurfelFusion::device::generateVertexNumsKernel(DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> vvalue, const unsigned int EdgeArraySize, int* vexNums, bool* markValidVertex)
+__device__ __forceinline__ int SparseSurfelFusion::device::warpAggregatedReserve(int* counter, const int count)
 {
-    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-    if (idx >= EdgeArraySize)	return;
-    EdgeNode nowEdge = EdgeArray[idx];
-    int owner = nowEdge.ownerNodeIdx;
-    int kind = nowEdge.edgeKind;
-    int index[2];
-    index[0] = device::edgeVertex[kind][0];
-    index[1] = device::edgeVertex[kind][1];
-
-    int v1 = NodeArray[owner].vertices[index[0]] - 1;
-    int v2 = NodeArray[owner].vertices[index[1]] - 1;
-    if (vvalue[v1] * vvalue[v2] <= 0) {
-        vexNums[idx] = 1;
-        markValidVertex[idx] = true;
-    }
-    else {
-        vexNums[idx] = 0;
-        markValidVertex[idx] = false;
+    const int lane = threadIdx.x & 31;
+    int inclusive = count;      // 线程束内包含式前缀和
+#pragma unroll
+    for (int delta = 1; delta < 32; delta <<= 1) {
+        const int neighbor = __shfl_up_sync(0xffffffff, inclusive, delta);
+        if (lane >= delta) inclusive += neighbor;
     }
+    int base = 0;
+    if (lane == 31 && inclusive > 0) base = atomicAdd(counter, inclusive);
+    base = __shfl_sync(0xffffffff, base, 31);
+    return base + inclusive - count;
 }
 
-__global__ void SparseSurfelFusion::device::generateTriangleNumsKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> vvalue, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, int* triNums, int* cubeCatagory)
+__global__ void SparseSurfelFusion::device::generateIsoVerticesKernel(DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<float> vvalue, const unsigned int EdgeArraySize, const unsigned int vertexCapacity, int* meshElementCount, int* vexAddress, Point3D<float>* MeshVertex, unsigned long long* MeshVertexKey)
 {
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-    if (idx >= DLevelNodeCount)	return;
-    const unsigned int offset = DLevelOffset + idx;
-    OctNode currentNode = NodeArray[offset];    // 当前最大层节点
-    int currentCubeCatagory = 0;                // 立方体类型
-    for (int i = 0; i < 8; i++) {
-        if (vvalue[currentNode.vertices[i] - 1] < 0) {
-            currentCubeCatagory |= 1 << i;
-        }
+    bool hasVertex = false;     // 越界线程同样参与线程束预留，不能提前返回
+    int kind = 0, v1 = 0, v2 = 0;
+    if (idx < EdgeArraySize) {
+        const EdgeNode nowEdge = EdgeArray[idx];
+        kind = nowEdge.edgeKind;
+        v1 = NodeArray[nowEdge.ownerNodeIdx].vertices[device::edgeVertex[kind][0]] - 1;
+        v2 = NodeArray[nowEdge.ownerNodeIdx].vertices[device::edgeVertex[kind][1]] - 1;
+        hasVertex = vvalue[v1] * vvalue[v2] <= 0;
     }
-    triNums[idx] = device::trianglesCount[currentCubeCatagory];
-    cubeCatagory[idx] = currentCubeCatagory;
+    const int slot = warpAggregatedReserve(&meshElementCount[0], hasVertex ? 1 : 0);
+    if (idx >= EdgeArraySize) return;
+    if (!hasVertex || slot >= vertexCapacity) {
+        vexAddress[idx] = -1;
+        return;
+    }
+    const float f1 = vvalue[v1];
+    const float f2 = vvalue[v2];
+    Point3D<float> isoPoint;
+    interpolatePoint(VertexArray[v1].pos, VertexArray[v2].pos, kind >> 2, f1, f2, isoPoint);
+    MeshVertex[slot] = isoPoint;
+    MeshVertexKey[slot] = encodeEdgeKey(VertexArray[v1].pos, VertexArray[v2].pos);
+    vexAddress[idx] = slot;
 }
 
-__global__ void SparseSurfelFusion::device::generateIntersectionPoint(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<float> vvalue, const EdgeNode* validEdgeArray, const int* validVexAddress, const unsigned int validEdgeArraySize, Point3D<float>* VertexBuffer)
+__global__ void SparseSurfelFusion::device::generateIsoTrianglesKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<FaceNode> FaceArray, DeviceArrayView<float> vvalue, const int* vexAddress, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const unsigned int triangleCapacity, int* meshElementCount, TriangleIndex* MeshTriangle, int* hasSurfaceIntersection)
 {
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-    if (idx >= validEdgeArraySize)	return;
-    int owner = validEdgeArray[idx].ownerNodeIdx;
-    int kind = validEdgeArray[idx].edgeKind;
-    int orientation = kind >> 2;
-
-    int index[2];
-
-    index[0] = edgeVertex[kind][0];
-    index[1] = edgeVertex[kind][1];
-
-    int v1 = NodeArray[owner].vertices[index[0]] - 1;
-    int v2 = NodeArray[owner].vertices[index[1]] - 1;
-    Point3D<float> p1 = VertexArray[v1].pos; 
-    Point3D<float> p2 = VertexArray[v2].pos;
-    float f1 = vvalue[v1];
-    float f2 = vvalue[v2];
-    Point3D<float> isoPoint;
-    interpolatePoint(p1, p2, orientation, f1, f2, isoPoint);
-    VertexBuffer[validVexAddress[idx]] = isoPoint;
+    TriangleIndex triangle[MAX_CUBE_TRIANGLE_NUM];
+    int validTriNum = 0;        // 越界线程同样参与线程束预留，不能提前返回
+    if (idx < DLevelNodeCount) {
+        const unsigned int offset = DLevelOffset + idx;
+        const OctNode& currentNode = NodeArray[offset];
+        int currentCubeCatagory = 0;                // 立方体类型
+        bool culled = false;                        // 角点不在感兴趣区域内(值为NaN)
+        for (int i = 0; i < 8; i++) {
+            const float cornerValue = vvalue[currentNode.vertices[i] - 1];
+            if (cornerValue < 0) {
+                currentCubeCatagory |= 1 << i;
+            }
+            culled |= isnan(cornerValue);
+        }
+        const int currentTriNum = culled ? 0 : device::trianglesCount[currentCubeCatagory];
+        int edgeHasVertex = 0;                      // 按位记录12条边是否有等值面顶点
+        for (int i = 0; i < currentTriNum; i++) {
+            bool triValid = true;
+            for (int j = 0; j < 3; j++) {
+                const int edgeIdx = device::triangles[currentCubeCatagory][3 * i + j];
+                edgeHasVertex |= 1 << edgeIdx;
+                triangle[validTriNum].idx[j] = vexAddress[currentNode.edges[edgeIdx] - 1];
+                if (triangle[validTriNum].idx[j] < 0) triValid = false;
+            }
+            if (triValid) validTriNum++;
+            else printf("三角索引构建错误！ node = %u   边上的顶点超出网格顶点容量\n", offset);
+        }
+        for (int i = 0; i < 6; i++) {
+            int mark = 0;              // 记录是否存在Surface-Edge Intersections(面边相交)
+            for (int j = 0; j < 4; j++) {
+                mark |= (edgeHasVertex >> device::faceEdges[i][j]) & 1;
+            }
+            if (mark == 1) {
+                int parentNodeIndex = currentNode.parent;
+                int currentFace = currentNode.faces[i] - 1;
+                hasSurfaceIntersection[currentFace] = 1;
+                while (FaceArray[currentFace].hasParentFace != -1) {
+                    currentFace = NodeArray[parentNodeIndex].faces[i] - 1;
+                    parentNodeIndex = NodeArray[parentNodeIndex].parent;
+                    hasSurfaceIntersection[currentFace] = 1;
+                }
+            }
+        }
+    }
+    const int slot = warpAggregatedReserve(&meshElementCount[1], validTriNum);
+    for (int i = 0; i < validTriNum; i++) {
+        if (slot + i < triangleCapacity) MeshTriangle[slot + i] = triangle[i];
+    }
 }
 
 __device__ void SparseSurfelFusion::device::interpolatePoint(const Point3D<float>& p1, const Point3D<float>& p2, const int& dim, const float& v1, const float& v2, Point3D<float>& out)
@@ -473,56 +257,16 @@ __device__ void SparseSurfelFusion::device::interpolatePoint(const Point3D<float
     out.coords[dim] = p2.coords[dim] * pivot + p1.coords[dim] * anotherPivot;
 }
 
-__global__ void SparseSurfelFusion::device::generateTrianglePos(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<FaceNode> FaceArray, DeviceArrayView<int> triNums, DeviceArrayView<int> cubeCatagory, DeviceArrayView<int> vexAddress, DeviceArrayView<int> triAddress, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, TriangleIndex* TriangleBuffer, int* hasSurfaceIntersection)
+__device__ unsigned long long SparseSurfelFusion::device::encodeEdgeKey(const Point3D<float>& p1, const Point3D<float>& p2)
 {
-    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-    if (idx >= DLevelNodeCount)	return;
-    const unsigned int offset = DLevelOffset + idx;
-    OctNode currentNode = NodeArray[offset];
-    int currentTriNum = triNums[idx];
-    int currentCubeCatagory = cubeCatagory[idx];
-    int currentTriangleBufferStart = triAddress[idx];
-    int edgeHasVertex[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-
-    //if (idx % 1000 == 0) printf("index = %d   TriNum = %d\n", idx, currentTriNum);
-
-    for (int i = 0; i < currentTriNum; i++) {
-        int edgeIdx[3];
-        edgeIdx[0] = device::triangles[currentCubeCatagory][3 * i];
-        edgeIdx[1] = device::triangles[currentCubeCatagory][3 * i + 1];
-        edgeIdx[2] = device::triangles[currentCubeCatagory][3 * i + 2];
-
-        edgeHasVertex[edgeIdx[0]] = 1;
-        edgeHasVertex[edgeIdx[1]] = 1;
-        edgeHasVertex[edgeIdx[2]] = 1;
-
-        int vertexIdx[3];
-        vertexIdx[0] = vexAddress[currentNode.edges[edgeIdx[0]] - 1];
-        vertexIdx[1] = vexAddress[currentNode.edges[edgeIdx[1]] - 1];
-        vertexIdx[2] = vexAddress[currentNode.edges[edgeIdx[2]] - 1];
-
-        TriangleBuffer[currentTriangleBufferStart + i].idx[0] = vertexIdx[0];
-        TriangleBuffer[currentTriangleBufferStart + i].idx[1] = vertexIdx[1];
-        TriangleBuffer[currentTriangleBufferStart + i].idx[2] = vertexIdx[2];
-    }
-    int currentFace;
-    int parentNodeIndex;
-    for (int i = 0; i < 6; i++) {
-        int mark = 0;              // 记录是否存在Surface-Edge Intersections(面边相交)
-        for (int j = 0; j < 4; j++) {
-            mark |= edgeHasVertex[device::faceEdges[i][j]];
-        }
-        if (mark == 1) {
-            parentNodeIndex = NodeArray[offset].parent;
-            currentFace = currentNode.faces[i] - 1;
-            hasSurfaceIntersection[currentFace] = 1;
-            while (FaceArray[currentFace].hasParentFace != -1) {
-                currentFace = NodeArray[parentNodeIndex].faces[i] - 1;
-                parentNodeIndex = NodeArray[parentNodeIndex].parent;
-                hasSurfaceIntersection[currentFace] = 1;
-            }
-        }
+    const float resolution = (float)(1 << (maxDepth + 1));     // 以2^-(maxDepth+1)为单位，p1 + p2即中点的2倍
+    unsigned long long key = 0;
+    for (int i = 0; i < 3; i++) {
+        long long coord = __float2ll_rn((p1.coords[i] + p2.coords[i]) * 0.5f * resolution);
+        coord = coord < 0 ? 0 : (coord > 0x1FFFFF ? 0x1FFFFF : coord);
+        key = (key << 21) | (unsigned long long)coord;
     }
+    return key;
 }
 
 __global__ void SparseSurfelFusion::device::generateSubdivideTrianglePos(const EasyOctNode* SubdivideArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const int* SubdivideTriNums, const int* SubdivideCubeCatagory, const int* SubdivideVexAddress, const int* SubdivideTriAddress, TriangleIndex* SubdivideTriangleBuffer)
@@ -557,6 +301,14 @@ __global__ void SparseSurfelFusion::device::ProcessLeafNodesAtOtherDepth(DeviceA
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
     if (idx >= OtherDepthNodeCount)	return;
     OctNode currentNode = NodeArray[idx];
+    bool culled = false;        // 角点不在感兴趣区域内(值为NaN)的节点与区域不相交，不细分
+    for (int i = 0; i < 8; i++) culled |= isnan(vvalue[currentNode.vertices[i] - 1]);
+    if (culled) {
+        NodeArray[idx].hasTriangle = 0;
+        NodeArray[idx].hasIntersection = 0;
+        markValidSubdividedNode[idx] = false;
+        return;
+    }
     int hasTri = 0;
     int sign = (vvalue[currentNode.vertices[0] - 1] < 0) ? -1 : 1;
     for (int i = 1; i < 8; i++) {
@@ -586,14 +338,22 @@ __global__ void SparseSurfelFusion::device::ProcessLeafNodesAtOtherDepth(DeviceA
     }
 }
 
-__global__ void SparseSurfelFusion::device::precomputeSubdivideDepth(DeviceArrayView<OctNode> SubdivideNode, DeviceArrayView<unsigned int> DepthBuffer, const int SubdivideNum, int* SubdivideDepthBuffer, int* SubdivideDepthNum)
+__global__ void SparseSurfelFusion::device::precomputeSubdivideDepth(DeviceArrayView<OctNode> SubdivideNode, DeviceArrayView<unsigned int> DepthBuffer, const int SubdivideNum, int* SubdivideDepthBuffer, int* SubdivideDepthCount)
 {
+    __shared__ int blockDepthCount[MAX_DEPTH_OCTREE + 1];
+    if (threadIdx.x <= maxDepth) blockDepthCount[threadIdx.x] = 0;
+    __syncthreads();
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-    if (idx >= SubdivideNum)	return;
-    int nodeIndex = SubdivideNode[idx].neighs[13];
-    int depth = DepthBuffer[nodeIndex];
-    SubdivideDepthBuffer[idx] = depth;
-    SubdivideDepthNum[idx + depth * SubdivideNum] = 1;
+    if (idx < SubdivideNum) {
+        int nodeIndex = SubdivideNode[idx].neighs[13];
+        int depth = DepthBuffer[nodeIndex];
+        SubdivideDepthBuffer[idx] = depth;
+        atomicAdd(&blockDepthCount[depth], 1);
+    }
+    __syncthreads();
+    if (threadIdx.x <= maxDepth && blockDepthCount[threadIdx.x] > 0) {
+        atomicAdd(&SubdivideDepthCount[threadIdx.x], blockDepthCount[threadIdx.x]);
+    }
 }
 
 __global__ void SparseSurfelFusion::device::singleRebuildArray(DeviceArrayView<OctNode> SubdivideNode, DeviceArrayView<int> SubdivideDepthBuffer, const unsigned int iterRound, const unsigned int NodeArraySize, const unsigned int SubdivideArraySize, EasyOctNode* SubdivideArray, int* SubdivideArrayDepthBuffer, Point3D<float>* SubdivideArrayCenterBuffer)
@@ -602,7 +362,7 @@ __global__ void SparseSurfelFusion::device::singleRebuildArray(DeviceArrayView<O
     if (idx >= SubdivideArraySize)	return;
     int rootId = SubdivideNode[iterRound].neighs[13];
     int rootDepth = SubdivideDepthBuffer[iterRound];
-    int rootKey = SubdivideNode[iterRound].key;
+    OctKey rootKey = SubdivideNode[iterRound].key;
     int thisNodeDepth = getSubdivideDepth(rootDepth, idx);
     int relativeDepth = thisNodeDepth - rootDepth;
     int idxOffset = idx - (powf(8, relativeDepth) - 1) / 7;
@@ -624,8 +384,8 @@ __global__ void SparseSurfelFusion::device::singleRebuildArray(DeviceArrayView<O
         SubdivideArray[idx].parent = NodeArraySize + parentDepthAddress + (idxOffset >> 3);
     }
 
-    int thisKey = rootKey;
-    thisKey |= (idxOffset) << (3 * (maxDepth - thisNodeDepth));
+    OctKey thisKey = rootKey;
+    thisKey |= OctKey(idxOffset) << (3 * (maxDepth - thisNodeDepth));
     SubdivideArray[idx].key = thisKey;
 
     SubdivideArrayDepthBuffer[idx] = thisNodeDepth;
@@ -646,7 +406,7 @@ __device__ int SparseSurfelFusion::device::getSubdivideDepth(const int& rootDept
     return rootDepth + relativeDepth;
 }
 
-__device__ void SparseSurfelFusion::device::getNodeCenterAllDepth(const int& key, const int& currentDepth, Point3D<float>& center)
+__device__ void SparseSurfelFusion::device::getNodeCenterAllDepth(const OctKey& key, const int& currentDepth, Point3D<float>& center)
 {
     center.coords[0] = float(0.5);
     center.coords[1] = float(0.5);
@@ -672,7 +432,7 @@ __global__ void SparseSurfelFusion::device::computeRebuildNeighbor(DeviceArrayVi
     if (idx >= currentLevelNodesCount)	return;
     const unsigned int offset = currentLevelOffset + idx;
     for (int i = 0; i < 27; i++) {
-        int sonKey = (SubdivideArray[offset].key >> (3 * (device::maxDepth - depth))) & 7;
+        int sonKey = int(SubdivideArray[offset].key >> (3 * (device::maxDepth - depth))) & 7;
         int parentIdx = SubdivideArray[offset].parent;
         int neighParent;
         if (parentIdx < NodeArraySize) {
@@ -700,8 +460,8 @@ __global__ void SparseSurfelFusion::device::initSubdivideVertexOwner(const EasyO
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
     if (idx >= currentLevelNodesCount)	return;
     const unsigned int offset = currentLevelOffset + idx;
-    int NodeOwnerKey[8] = { device::maxIntValue,device::maxIntValue, device::maxIntValue, device::maxIntValue,
-                            device::maxIntValue, device::maxIntValue, device::maxIntValue, device::maxIntValue };
+    OctKey NodeOwnerKey[8] = { device::maxKeyValue,device::maxKeyValue, device::maxKeyValue, device::maxKeyValue,
+                            device::maxKeyValue, device::maxKeyValue, device::maxKeyValue, device::maxKeyValue };
     int NodeOwnerIdx[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
     int depth = maxDepth;
     float halfWidth = 1.0f / (1 << (depth + 1));
@@ -731,7 +491,7 @@ __global__ void SparseSurfelFusion::device::initSubdivideVertexOwner(const EasyO
     for (int i = 0; i < 8; i++) {
         for (int j = 0; j < 27; j++) {
             if (neigh[j] != -1 && SquareDistance(vertexPos[i], neighCenter[j]) < Widthsq) {
-                int neighKey;
+                OctKey neighKey;
                 if (neigh[j] < NodeArraySize) continue;
                 else
                     neighKey = SubdivideArray[neigh[j] - NodeArraySize].key;
@@ -814,10 +574,10 @@ __global__ void SparseSurfelFusion::device::initSubdivideEdgeArray(const EasyOct
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
     if (idx >= DLevelNodeCount)	return;
     const unsigned int offset = DLevelOffset + idx;
-    int NodeOwnerKey[12] = { device::maxIntValue, device::maxIntValue, device::maxIntValue,
-                             device::maxIntValue, device::maxIntValue, device::maxIntValue,
-                             device::maxIntValue, device::maxIntValue, device::maxIntValue,
-                             device::maxIntValue, device::maxIntValue, device::maxIntValue };
+    OctKey NodeOwnerKey[12] = { device::maxKeyValue, device::maxKeyValue, device::maxKeyValue,
+                             device::maxKeyValue, device::maxKeyValue, device::maxKeyValue,
+                             device::maxKeyValue, device::maxKeyValue, device::maxKeyValue,
+                             device::maxKeyValue, device::maxKeyValue, device::maxKeyValue };
     int NodeOwnerIdx[12] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
     float halfWidth = 1.0f / (1 << (device::maxDepth + 1));
     float Width = 1.0f / (1 << device::maxDepth);
@@ -860,7 +620,7 @@ __global__ void SparseSurfelFusion::device::initSubdivideEdgeArray(const EasyOct
     for (int i = 0; i < 12; i++) {
         for (int j = 0; j < 27; j++) {
             if (neigh[j] != -1 && SquareDistance(edgeCenterPos[i], neighCenter[j]) < WidthSquare) {
-                int neighKey;
+                OctKey neighKey;
                 if (neigh[j] < NodeArraySize) continue;
                 else
                     neighKey = SubdivideArray[neigh[j] - NodeArraySize].key;
@@ -953,12 +713,14 @@ __forceinline__ __device__ double SparseSurfelFusion::device::SquareDistance(con
     return (p1.coords[0] - p2.coords[0]) * (p1.coords[0] - p2.coords[0]) + (p1.coords[1] - p2.coords[1]) * (p1.coords[1] - p2.coords[1]) + (p1.coords[2] - p2.coords[2]) * (p1.coords[2] - p2.coords[2]);
 }
 
-__global__ void SparseSurfelFusion::device::computeSubdivideVertexImplicitFunctionValue(const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> dx, DeviceArrayView<int> EncodedNodeIdxInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions, const unsigned int NodeArraySize, const unsigned int rootId, const unsigned int SubdivideVertexArraySize, const float isoValue, float* SubdivideVvalue)
+__global__ void SparseSurfelFusion::device::computeSubdivideVertexImplicitFunctionValue(const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> EncodedNodeIdxInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions, const float* BaseFunctionValueTable, const unsigned int NodeArraySize, const unsigned int rootId, const unsigned int SubdivideVertexArraySize, const float isoValue, float* SubdivideVvalue)
 {
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
     if (idx >= SubdivideVertexArraySize)	return;
     VertexNode nowVertex = SubdivideVertexArray[idx];
     float val = 0.0f;
+    int3 gridCoord;
+    const bool onGrid = vertexGridCoordinate(nowVertex.pos, gridCoord);
     int nowNode = nowVertex.ownerNodeIdx;
     if (nowNode > 0) {
         while (nowNode != -1) {
@@ -971,20 +733,8 @@ __global__ void SparseSurfelFusion::device::computeSubdivideVertexImplicitFuncti
                 if (neigh != -1) {
                     if (neigh == NodeArraySize)
                         neigh = rootId;
-                    int idxO[3];
-                    int encode_idx;
-                    if (neigh < NodeArraySize)
-                        encode_idx = EncodedNodeIdxInFunction[neigh];
-                    else continue;  // d_x = 0 in Subdivide space
-                    idxO[0] = encode_idx % decodeOffset_1;
-                    idxO[1] = (encode_idx / decodeOffset_1) % decodeOffset_1;
-                    idxO[2] = encode_idx / decodeOffset_2;
-
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcX = baseFunctions[idxO[0]];
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcY = baseFunctions[idxO[1]];
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcZ = baseFunctions[idxO[2]];
-
-                    val += dx[neigh] * value(funcX, nowVertex.pos.coords[0]) * value(funcY, nowVertex.pos.coords[1]) * value(funcZ, nowVertex.pos.coords[2]);
+                    if (neigh >= NodeArraySize) continue;  // d_x = 0 in Subdivide space
+                    val += dx[neigh] * baseFunctionProductValue(BaseFunctionValueTable, baseFunctions, EncodedNodeIdxInFunction[neigh], nowVertex.pos, onGrid, gridCoord);
                 }
             }
             if (nowNode < NodeArraySize)
@@ -996,12 +746,14 @@ __global__ void SparseSurfelFusion::device::computeSubdivideVertexImplicitFuncti
     SubdivideVvalue[idx] = val - isoValue;
 }
 
-__global__ void SparseSurfelFusion::device::computeSubdivideVertexImplicitFunctionValue(const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> dx, DeviceArrayView<int> EncodedNodeIdxInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions, const unsigned int NodeArraySize, const int* ReplacedNodeId, const int* IsRoot, const unsigned int SubdivideVertexArraySize, const float isoValue, float* SubdivideVvalue)
+__global__ void SparseSurfelFusion::device::computeSubdivideVertexImplicitFunctionValue(const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> EncodedNodeIdxInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions, const float* BaseFunctionValueTable, const unsigned int NodeArraySize, const int* ReplacedNodeId, const int* IsRoot, const unsigned int SubdivideVertexArraySize, const float isoValue, float* SubdivideVvalue)
 {
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
     if (idx >= SubdivideVertexArraySize)	return;
     VertexNode nowVertex = SubdivideVertexArray[idx];
     float val = 0.0f;
+    int3 gridCoord;
+    const bool onGrid = vertexGridCoordinate(nowVertex.pos, gridCoord);
     int nowNode = nowVertex.ownerNodeIdx;
     if (nowNode > 0) {
         while (nowNode != -1) {
@@ -1014,20 +766,8 @@ __global__ void SparseSurfelFusion::device::computeSubdivideVertexImplicitFuncti
                 if (neigh != -1) {
                     if (neigh >= NodeArraySize && IsRoot[neigh - NodeArraySize])
                         neigh = ReplacedNodeId[neigh - NodeArraySize];
-                    int idxO[3];
-                    int encode_idx;
-                    if (neigh < NodeArraySize)
-                        encode_idx = EncodedNodeIdxInFunction[neigh];
-                    else continue;  // d_x = 0 in Subdivide space
-                    idxO[0] = encode_idx % decodeOffset_1;
-                    idxO[1] = (encode_idx / decodeOffset_1) % decodeOffset_1;
-                    idxO[2] = encode_idx / decodeOffset_2;
-
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcX = baseFunctions[idxO[0]];
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcY = baseFunctions[idxO[1]];
-                    ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcZ = baseFunctions[idxO[2]];
-
-                    val += dx[neigh] * value(funcX, nowVertex.pos.coords[0]) * value(funcY, nowVertex.pos.coords[1]) * value(funcZ, nowVertex.pos.coords[2]);
+                    if (neigh >= NodeArraySize) continue;  // d_x = 0 in Subdivide space
+                    val += dx[neigh] * baseFunctionProductValue(BaseFunctionValueTable, baseFunctions, EncodedNodeIdxInFunction[neigh], nowVertex.pos, onGrid, gridCoord);
                 }
             }
             if (nowNode < NodeArraySize) nowNode = NodeArray[nowNode].parent;
@@ -1073,7 +813,7 @@ __global__ void SparseSurfelFusion::device::generateTriNums(const EasyOctNode* S
     cubeCatagory[idx] = currentCubeCatagory;
 }
 
-__global__ void SparseSurfelFusion::device::generateSubdivideIntersectionPoint(const EdgeNode* SubdivideValidEdgeArray, const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, const int* SubdivideValidVexAddress, const float* SubdivideVvalue, const unsigned int SubdivideValidEdgeArraySize, const unsigned int NodeArraySize, Point3D<float>* SubdivideVertexBuffer)
+__global__ void SparseSurfelFusion::device::generateSubdivideIntersectionPoint(const EdgeNode* SubdivideValidEdgeArray, const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, const int* SubdivideValidVexAddress, const float* SubdivideVvalue, const unsigned int SubdivideValidEdgeArraySize, const unsigned int NodeArraySize, Point3D<float>* SubdivideVertexBuffer, unsigned long long* SubdivideVertexKeyBuffer)
 {
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
     if (idx >= SubdivideValidEdgeArraySize)	return;
@@ -1093,6 +833,7 @@ __global__ void SparseSurfelFusion::device::generateSubdivideIntersectionPoint(c
     Point3D<float> isoPoint;
     device::interpolatePoint(p1, p2, orientation, f1, f2, isoPoint);
     SubdivideVertexBuffer[SubdivideValidVexAddress[idx]] = isoPoint;
+    SubdivideVertexKeyBuffer[SubdivideValidVexAddress[idx]] = encodeEdgeKey(p1, p2);
 }
 
 __global__ void SparseSurfelFusion::device::initFixedDepthNums(DeviceArrayView<OctNode> SubdivideNode, DeviceArrayView<int> SubdivideDepthBuffer, const unsigned int DepthOffset, const unsigned int DepthNodeCount, int* fixedDepthNums)
@@ -1107,18 +848,29 @@ __global__ void SparseSurfelFusion::device::initFixedDepthNums(DeviceArrayView<O
     }
 }
 
-__global__ void SparseSurfelFusion::device::wholeRebuildArray(DeviceArrayView<OctNode> SubdivideNode, const unsigned int finerDepthStart, const unsigned int finerSubdivideNum, const unsigned int NodeArraySize, const int* SubdivideDepthBuffer, const int* depthNodeAddress_Device, const int* fixedDepthAddress, EasyOctNode* RebuildArray, int* RebuildDepthBuffer, Point3D<float>* RebuildCenterBuffer, int* ReplaceNodeId, int* IsRoot, OctNode* NodeArray)
+__global__ void SparseSurfelFusion::device::extractRebuildDepthAddress(const int* fixedDepthNums, const int* fixedDepthAddress, const unsigned int finerSubdivideNum, int* depthNodeAddress)
 {
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-    if (idx >= finerSubdivideNum)	return;
-    int depthNodeAddress[MAX_DEPTH_OCTREE + 1];
-    for (int i = 0; i <= maxDepth; i++) {                   // 获得数据更快：L1缓存
-        depthNodeAddress[i] = depthNodeAddress_Device[i];   // depthNodeAddress_Device是Global内存，后续需要循环，时间开销大
+    if (idx > maxDepth + 1)	return;
+    if (idx == 0) {
+        depthNodeAddress[idx] = 0;
+    }
+    else if (idx <= maxDepth) {
+        depthNodeAddress[idx] = fixedDepthAddress[(idx - 1) * finerSubdivideNum];  // 按深度排布，每层第一个元素的前缀和即该层的偏移
     }
+    else {
+        const unsigned int last = maxDepth * finerSubdivideNum - 1;
+        depthNodeAddress[idx] = fixedDepthAddress[last] + fixedDepthNums[last];
+    }
+}
+
+__global__ void SparseSurfelFusion::device::wholeRebuildArray(DeviceArrayView<OctNode> SubdivideNode, const unsigned int finerDepthStart, const unsigned int finerSubdivideNum, const unsigned int NodeArraySize, const int* SubdivideDepthBuffer, const int* fixedDepthAddress, EasyOctNode* RebuildArray, int* RebuildDepthBuffer, Point3D<float>* RebuildCenterBuffer, int* ReplaceNodeId, int* IsRoot, OctNode* NodeArray)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= finerSubdivideNum)	return;
     const unsigned int offset = finerDepthStart + idx;
     int nowDepth = SubdivideDepthBuffer[offset];
-    int fixedDepthOffset = fixedDepthAddress[(nowDepth - 1) * finerSubdivideNum + idx];
-    int nowIdx = depthNodeAddress[nowDepth] + fixedDepthOffset;
+    int nowIdx = fixedDepthAddress[(nowDepth - 1) * finerSubdivideNum + idx];
     OctNode rootNode = SubdivideNode[offset];
     int replacedId = rootNode.neighs[13];
     rootNode.neighs[13] = NodeArraySize + nowIdx;
@@ -1133,22 +885,21 @@ __global__ void SparseSurfelFusion::device::wholeRebuildArray(DeviceArrayView<Oc
     getNodeCenterAllDepth(rootNode.key, nowDepth, thisNodeCenter);
     RebuildCenterBuffer[nowIdx] = thisNodeCenter;
 
-    int sonKey = (rootNode.key >> (3 * (device::maxDepth - nowDepth))) & 7;
+    int sonKey = int(rootNode.key >> (3 * (device::maxDepth - nowDepth))) & 7;
     NodeArray[rootNode.parent].children[sonKey] = NodeArraySize + nowIdx;
     int parentNodeIdx;
     int childrenNums = 8;
     while (nowDepth < device::maxDepth) {
         nowDepth++;
-        fixedDepthOffset = fixedDepthAddress[(nowDepth - 1) * finerSubdivideNum + idx];
-        nowIdx = depthNodeAddress[nowDepth] + fixedDepthOffset;
+        nowIdx = fixedDepthAddress[(nowDepth - 1) * finerSubdivideNum + idx];
+        const int fatherIdx = fixedDepthAddress[(nowDepth - 2) * finerSubdivideNum + idx];
         for (int j = 0; j < childrenNums; j += 8) {
-            int fatherFixedDepthOffset = fixedDepthAddress[(nowDepth - 2) * finerSubdivideNum + idx];
-            parentNodeIdx = depthNodeAddress[nowDepth - 1] + fatherFixedDepthOffset + j / 8;
+            parentNodeIdx = fatherIdx + j / 8;
             int parentGlobalIdx = RebuildArray[parentNodeIdx].neighs[13];
-            int parentKey = RebuildArray[parentNodeIdx].key;
+            OctKey parentKey = RebuildArray[parentNodeIdx].key;
             for (int k = 0; k < 8; k++) {
                 int thisRoundIdx = nowIdx + j + k;
-                int nowKey = parentKey | (k << (3 * (device::maxDepth - nowDepth)));
+                OctKey nowKey = parentKey | (OctKey(k) << (3 * (device::maxDepth - nowDepth)));
                 RebuildArray[thisRoundIdx].parent = parentGlobalIdx;
                 RebuildArray[thisRoundIdx].key = nowKey;
                 RebuildArray[thisRoundIdx].neighs[13] = NodeArraySize + thisRoundIdx;
@@ -1203,15 +954,176 @@ __global__ void SparseSurfelFusion::device::markValidMeshTriangleIndex(TriangleI
     }
 }
 
+__global__ void SparseSurfelFusion::device::markWeldRepresentativeKernel(const unsigned long long* sortedKey, const unsigned int vertexCount, int* isRepresentative)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= vertexCount) return;
+    isRepresentative[idx] = (idx == 0 || sortedKey[idx] != sortedKey[idx - 1]) ? 1 : 0;
+}
+
+__global__ void SparseSurfelFusion::device::scatterWeldedVerticesKernel(const int* sortedVertexId, const int* weldedAddress, const int* isRepresentative, const Point3D<float>* vertices, const unsigned int vertexCount, int* vertexRemap, Point3D<float>* weldedVertices)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= vertexCount) return;
+    const int vertexId = sortedVertexId[idx];
+    const int weldedId = weldedAddress[idx] - 1;
+    vertexRemap[vertexId] = weldedId;
+    if (isRepresentative[idx]) weldedVertices[weldedId] = vertices[vertexId];
+}
+
+__global__ void SparseSurfelFusion::device::remapWeldedTrianglesKernel(const int* vertexRemap, const unsigned int triangleCount, TriangleIndex* triangles)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= triangleCount) return;
+    TriangleIndex triangle = triangles[idx];
+    for (int i = 0; i < 3; i++) {
+        triangle.idx[i] = vertexRemap[triangle.idx[i]];
+    }
+    triangles[idx] = triangle;
+}
+
+__global__ void SparseSurfelFusion::device::scatterTriangleCornersKernel(const TriangleIndex* triangles, const unsigned int triangleCount, unsigned int* cornerVertex, int* cornerTriangle)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= triangleCount) return;
+    const TriangleIndex triangle = triangles[idx];
+    for (int i = 0; i < 3; i++) {
+        cornerVertex[3 * idx + i] = triangle.idx[i];
+        cornerTriangle[3 * idx + i] = idx;
+    }
+}
+
+__global__ void SparseSurfelFusion::device::computeVertexTriangleOffsetKernel(const unsigned int* sortedCornerVertex, const unsigned int cornerCount, const unsigned int vertexCount, int* vertexTriangleOffset)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx > vertexCount) return;
+    int left = 0, right = cornerCount;
+    while (left < right) {
+        const int mid = (left + right) >> 1;
+        if (sortedCornerVertex[mid] < idx) left = mid + 1;
+        else right = mid;
+    }
+    vertexTriangleOffset[idx] = left;
+}
+
+__device__ float SparseSurfelFusion::device::coarseImplicitFunctionValue(const OctNodeTopologyView& NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, int node, const Point3D<float>& pos)
+{
+    // 基函数值表在主流上构建，预览流上不能依赖它，逐段求多项式
+    const int3 gridCoord = make_int3(0, 0, 0);
+    float val = 0.0f;
+    while (node != -1) {
+        for (int i = 0; i < 27; i++) {
+            const int neighbor = NodeTopology.Neighbor(node, i);
+            if (neighbor != -1) {
+                val += dx[neighbor] * baseFunctionProductValue(NULL, BaseFunctions, encodeNodeIndexInFunction[neighbor], pos, false, gridCoord);
+            }
+        }
+        node = NodeTopology.Parent(node);
+    }
+    return val;
+}
+
+__global__ void SparseSurfelFusion::device::accumulatePreviewIsoValueKernel(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const unsigned int DLevelOffset, const int previewDepth, const unsigned int sampleStride, const unsigned int sampleCount, float* isoValueSum)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    float val = 0.0f;           // 越界线程同样参与线程束归约，不能提前返回
+    if (idx < sampleCount) {
+        const unsigned int pointIdx = idx * sampleStride;
+        int node = DLevelOffset + PointToNodeArrayDLevel[pointIdx];
+        for (int depth = device::maxDepth; depth > previewDepth && node != -1; depth--) node = NodeTopology.Parent(node);
+        val = coarseImplicitFunctionValue(NodeTopology, BaseFunctions, dx, encodeNodeIndexInFunction, node, DensePoints[pointIdx].point);
+    }
+    for (int offset = 16; offset > 0; offset >>= 1) val += __shfl_down_sync(0xffffffff, val, offset);
+    if ((threadIdx.x & 31) == 0 && val != 0.0f) atomicAdd(isoValueSum, val);
+}
+
+__global__ void SparseSurfelFusion::device::generatePreviewTrianglesKernel(OctNodeTopologyView NodeTopology, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const unsigned int previewOffset, const unsigned int previewNodeCount, const int previewDepth, const float* isoValueSum, const unsigned int sampleCount, const unsigned int triangleCapacity, int* triangleCount, Point3D<float>* previewVertices, TriangleIndex* previewTriangles)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    Point3D<float> cornerPos[8];
+    float cornerValue[8];
+    int cubeCatagory = 0;
+    int triNum = 0;             // 越界线程同样参与线程束预留，不能提前返回
+    if (idx < previewNodeCount) {
+        const int node = previewOffset + idx;
+        const float isoValue = *isoValueSum / sampleCount;
+        const float halfWidth = 1.0f / (1 << (previewDepth + 1));
+        const Point3D<float> center = CenterBuffer[node];
+        for (int i = 0; i < 8; i++) {
+            // 角点编号与NodeArray.vertices一致(edgeVertex、triangles表按此编号)：z负方向逆时针0~3，z正方向4~7
+            const int offsetY = (i & 2) >> 1;
+            const int offsetX = (i & 1) ^ offsetY;
+            const int offsetZ = (i & 4) >> 2;
+            cornerPos[i].coords[0] = center.coords[0] + (2 * offsetX - 1) * halfWidth;
+            cornerPos[i].coords[1] = center.coords[1] + (2 * offsetY - 1) * halfWidth;
+            cornerPos[i].coords[2] = center.coords[2] + (2 * offsetZ - 1) * halfWidth;
+            cornerValue[i] = coarseImplicitFunctionValue(NodeTopology, BaseFunctions, dx, encodeNodeIndexInFunction, node, cornerPos[i]) - isoValue;
+            if (cornerValue[i] < 0) cubeCatagory |= 1 << i;
+        }
+        triNum = device::trianglesCount[cubeCatagory];
+    }
+    const int slot = warpAggregatedReserve(triangleCount, triNum);
+    for (int i = 0; i < triNum && slot + i < triangleCapacity; i++) {
+        const int triangleIdx = slot + i;
+        TriangleIndex triangle;
+        for (int j = 0; j < 3; j++) {
+            const int edgeIdx = device::triangles[cubeCatagory][3 * i + j];
+            const int v1 = device::edgeVertex[edgeIdx][0];
+            const int v2 = device::edgeVertex[edgeIdx][1];
+            Point3D<float> isoPoint;
+            interpolatePoint(cornerPos[v1], cornerPos[v2], edgeIdx >> 2, cornerValue[v1], cornerValue[v2], isoPoint);
+            previewVertices[3 * triangleIdx + j] = isoPoint;
+            triangle.idx[j] = 3 * triangleIdx + j;
+        }
+        previewTriangles[triangleIdx] = triangle;
+    }
+}
 
+void SparseSurfelFusion::ComputeTriangleIndices::prepareBaseFunctionValueTable(DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, cudaStream_t stream)
+{
+    if (BaseFunction.RawPtr() == tabulatedBaseFunction) return;   // 基函数在整个生命周期内不变，只需构建一次
+    const unsigned int tableSize = BaseFunction.Size() * BASE_FUNCTION_TABLE_RES;
+    BaseFunctionValueTable.ResizeArray(tableSize, true);
+    dim3 block(256);
+    dim3 grid(divUp(tableSize, block.x));
+    device::buildBaseFunctionValueTableKernel << <grid, block, 0, stream >> > (BaseFunction, tableSize, BaseFunctionValueTable.Ptr());
+    tabulatedBaseFunction = BaseFunction.RawPtr();
+}
 
-void SparseSurfelFusion::ComputeTriangleIndices::ComputeVertexImplicitFunctionValue(DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream)
+void SparseSurfelFusion::ComputeTriangleIndices::ComputeVertexImplicitFunctionValue(DeviceArrayView<VertexNode> VertexArray, OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream)
 {
+    prepareBaseFunctionValueTable(BaseFunction, stream);
     const unsigned int VertexArraySize = VertexArray.Size();
     dim3 block(128);
     dim3 grid(divUp(VertexArraySize, block.x));
 
-    device::ComputeVertexImplicitFunctionValueKernel << <grid, block, 0, stream >> > (VertexArray, NodeArray, BaseFunction, dx, encodeNodeIndexInFunction, VertexArraySize, isoValue, vvalue.Array().ptr());
+    device::ComputeVertexImplicitFunctionValueKernel << <grid, block, 0, stream >> > (VertexArray, NodeTopology, BaseFunction, dx, encodeNodeIndexInFunction, BaseFunctionValueTable.Ptr(), VertexArraySize, isoValue, regionsOfInterest, vvalue.Array().ptr());
+}
+
+void SparseSurfelFusion::ComputeTriangleIndices::ExtractPreviewMesh(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, OctNodeTopologyView NodeTopology, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const unsigned int DLevelOffset, const unsigned int previewOffset, const unsigned int previewNodeCount, const int previewDepth, cudaStream_t stream)
+{
+    if (!IsPreviewEnabled() || previewNodeCount == 0) return;
+    StageProfiler::Scope stage(profiler, "preview_mesh", stream);
+    previewPendingSlot ^= 1;    // 上一次提取已在帧末完成并发布，写入另一个槽位
+    const PreviewMeshSlot& slot = previewSlots[previewPendingSlot];
+
+    // 等值取采样点处粗糙隐函数的均值，按步长抽样控制开销
+    const unsigned int pointsNum = DensePoints.Size();
+    const unsigned int sampleStride = std::max(1u, (pointsNum + PREVIEW_ISO_SAMPLE_COUNT - 1) / PREVIEW_ISO_SAMPLE_COUNT);
+    const unsigned int sampleCount = (pointsNum + sampleStride - 1) / sampleStride;
+    CHECKCUDA(cudaMemsetAsync(previewIsoValueSum.Ptr(), 0, sizeof(float), stream));
+    CHECKCUDA(cudaMemsetAsync(previewTriangleCounter.Ptr(), 0, sizeof(int), stream));
+    if (sampleCount > 0) {
+        dim3 block(128);
+        dim3 grid(divUp(sampleCount, block.x));
+        device::accumulatePreviewIsoValueKernel << <grid, block, 0, stream >> > (DensePoints, PointToNodeArrayDLevel, NodeTopology, BaseFunction, dx, encodeNodeIndexInFunction, DLevelOffset, previewDepth, sampleStride, sampleCount, previewIsoValueSum.Ptr());
+    }
+
+    dim3 block(128);
+    dim3 grid(divUp(previewNodeCount, block.x));
+    device::generatePreviewTrianglesKernel << <grid, block, 0, stream >> > (NodeTopology, CenterBuffer, BaseFunction, dx, encodeNodeIndexInFunction, previewOffset, previewNodeCount, previewDepth, previewIsoValueSum.Ptr(), std::max(sampleCount, 1u), MAX_PREVIEW_TRIANGLE_COUNT, previewTriangleCounter.Ptr(), slot.verticesDevice, slot.trianglesDevice);
+    CHECKCUDA(cudaMemcpyAsync(slot.triangleCount, previewTriangleCounter.Ptr(), sizeof(int), cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaLaunchHostFunc(stream, publishPreviewMesh, this));
 }
 
 void SparseSurfelFusion::ComputeTriangleIndices::insertTriangle(const Point3D<float>* VertexBufferHost, const int& allVexNums, const int* TriangleBufferHost, const int& allTriNums, CoredVectorMeshData& mesh)
@@ -1244,41 +1156,116 @@ void SparseSurfelFusion::ComputeTriangleIndices::insertTriangle(const Point3D<fl
     }
 }
 
-void SparseSurfelFusion::ComputeTriangleIndices::insertTriangle(Point3D<float>* VertexBuffer, const int allVexNums, TriangleIndex* TriangleBuffer, const int allTriNums, cudaStream_t stream)
+void SparseSurfelFusion::ComputeTriangleIndices::insertTriangle(Point3D<float>* VertexBuffer, const int allVexNums, TriangleIndex* TriangleBuffer, const int allTriNums, const unsigned long long* VertexKeyBuffer, cudaStream_t stream)
 {
+    synchronizeMeshElementCount();  // 顶点index需要以已有的网格顶点数量为偏移
+    int* validCount = SubdivideCounter.Ptr();   // [0]有效的顶点数量, [1]有效的三角索引数量
+
     dim3 block_vex(128);
     dim3 grid_vex(divUp(allVexNums, block_vex.x));
     device::markValidMeshVertexIndex << <grid_vex, block_vex, 0, stream >> > (VertexBuffer, allVexNums, markValidTriangleVertex.Ptr());
 
-    unsigned int* validVerticesCount = NULL;    // 有效的顶点
-    unsigned int validVerticesCountHost = 0;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&validVerticesCount), sizeof(unsigned int), stream));
-
-    void* d_temp_storage_1 = NULL;    // 中间变量，用完即可释放
-    size_t temp_storage_bytes_1 = 0;  // 中间变量
-    CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, VertexBuffer, markValidTriangleVertex.Ptr(), MeshTriangleVertex.Ptr() + MeshTriangleVertex.ArraySize(), validVerticesCount, allVexNums, stream, false));	// 确定临时设备存储需求
-    CHECKCUDA(cudaMallocAsync(&d_temp_storage_1, temp_storage_bytes_1, stream));
-    CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, VertexBuffer, markValidTriangleVertex.Ptr(), MeshTriangleVertex.Ptr() + MeshTriangleVertex.ArraySize(), validVerticesCount, allVexNums, stream, false));	// 筛选	
-    CHECKCUDA(cudaMemcpyAsync(&validVerticesCountHost, validVerticesCount, sizeof(unsigned int), cudaMemcpyDeviceToHost, stream));
-
     dim3 block_tri(128);
     dim3 grid_tri(divUp(allTriNums, block_tri.x));
-    device::markValidMeshTriangleIndex << <grid_tri, block_tri, 0, stream >> > (TriangleBuffer, MeshTriangleVertex.ArraySize(), allTriNums, allVexNums, markValidTriangleIndex.Ptr());
+    device::markValidMeshTriangleIndex << <grid_tri, block_tri, 0, stream >> > (TriangleBuffer, MeshVertexCount, allTriNums, allVexNums, markValidTriangleIndex.Ptr());
+
+    Point3D<float>* vertexOutput = outputVertices() + MeshVertexCount;
+    TriangleIndex* triangleOutput = outputTriangles() + MeshTriangleCount;
+    unsigned long long* keyOutput = MeshVertexKey.Ptr() + MeshVertexCount;
+    size_t vertexTempBytes = 0;
+    size_t triangleTempBytes = 0;
+    size_t keyTempBytes = 0;
+    CHECKCUDA(cub::DeviceSelect::Flagged(NULL, vertexTempBytes, VertexBuffer, markValidTriangleVertex.Ptr(), vertexOutput, validCount, allVexNums, stream, false));	// 确定临时设备存储需求
+    CHECKCUDA(cub::DeviceSelect::Flagged(NULL, triangleTempBytes, TriangleBuffer, markValidTriangleIndex.Ptr(), triangleOutput, validCount + 1, allTriNums, stream, false));
+    CHECKCUDA(cub::DeviceSelect::Flagged(NULL, keyTempBytes, VertexKeyBuffer, markValidTriangleVertex.Ptr(), keyOutput, validCount, allVexNums, stream, false));
+    void* tempStorage = reserveSubdivideTempStorage(std::max(std::max(vertexTempBytes, triangleTempBytes), keyTempBytes));
+    CHECKCUDA(cub::DeviceSelect::Flagged(tempStorage, vertexTempBytes, VertexBuffer, markValidTriangleVertex.Ptr(), vertexOutput, validCount, allVexNums, stream, false));	// 筛选
+    CHECKCUDA(cub::DeviceSelect::Flagged(tempStorage, triangleTempBytes, TriangleBuffer, markValidTriangleIndex.Ptr(), triangleOutput, validCount + 1, allTriNums, stream, false));
+    CHECKCUDA(cub::DeviceSelect::Flagged(tempStorage, keyTempBytes, VertexKeyBuffer, markValidTriangleVertex.Ptr(), keyOutput, validCount, allVexNums, stream, false));	// 与顶点相同的标记，编码与顶点保持一一对应
+
+    int validCountHost[2] = { 0 };
+    CHECKCUDA(cudaMemcpyAsync(validCountHost, validCount, sizeof(int) * 2, cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaStreamSynchronize(stream));
+    if (MeshVertexCount + validCountHost[0] > outputVertexCapacity() || MeshTriangleCount + validCountHost[1] > outputTriangleCapacity()) {
+        LOGGING(FATAL) << "细分网格超出输出容量：顶点 " << MeshVertexCount + validCountHost[0] << " / " << outputVertexCapacity() << "   三角形 " << MeshTriangleCount + validCountHost[1] << " / " << outputTriangleCapacity();
+    }
+    MeshVertexCount += validCountHost[0];
+    MeshTriangleCount += validCountHost[1];
+    if (validCountHost[0] > 0) subdivisionAppended = true;
+}
 
-    unsigned int* validTriangleIndicesCount = NULL;    // 有效的三角索引数组数量
-    unsigned int validTriangleIndicesCountHost = 0;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&validTriangleIndicesCount), sizeof(unsigned int), stream));
+void SparseSurfelFusion::ComputeTriangleIndices::weldMeshVertices(cudaStream_t stream)
+{
+    synchronizeMeshElementCount();
+    const unsigned int vertexCount = MeshVertexCount;
+    if (vertexCount == 0) return;
+
+    unsigned long long* sortedKey = reserveSubdivideBuffer(WeldSortedKey, vertexCount);
+    int* vertexId = reserveSubdivideBuffer(WeldVertexId, vertexCount);
+    int* sortedVertexId = reserveSubdivideBuffer(WeldSortedVertexId, vertexCount);
+    int* isRepresentative = reserveSubdivideBuffer(WeldRepresentative, vertexCount);
+    int* weldedAddress = reserveSubdivideBuffer(WeldAddress, vertexCount);
+    int* vertexRemap = reserveSubdivideBuffer(WeldVertexRemap, vertexCount);
+    Point3D<float>* weldedVertices = reserveSubdivideBuffer(WeldVertexBuffer, vertexCount);
+
+    thrust::device_ptr<int> vertexIdPtr = thrust::device_pointer_cast<int>(vertexId);
+    thrust::sequence(thrust::cuda::par.on(stream), vertexIdPtr, vertexIdPtr + vertexCount);
+
+    // 基数排序是稳定的，同一条边的顶点中maxDepth层(先写入)的顶点排在前面
+    const int keyBits = 63;
+    size_t sortTempBytes = 0;
+    size_t scanTempBytes = 0;
+    CHECKCUDA(cub::DeviceRadixSort::SortPairs(NULL, sortTempBytes, MeshVertexKey.Ptr(), sortedKey, vertexId, sortedVertexId, vertexCount, 0, keyBits, stream));
+    CHECKCUDA(cub::DeviceScan::InclusiveSum(NULL, scanTempBytes, isRepresentative, weldedAddress, vertexCount, stream));
+    void* tempStorage = reserveSubdivideTempStorage(std::max(sortTempBytes, scanTempBytes));
+    CHECKCUDA(cub::DeviceRadixSort::SortPairs(tempStorage, sortTempBytes, MeshVertexKey.Ptr(), sortedKey, vertexId, sortedVertexId, vertexCount, 0, keyBits, stream));
 
-    void* d_temp_storage_2 = NULL;    // 中间变量，用完即可释放
-    size_t temp_storage_bytes_2 = 0;  // 中间变量
-    CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, TriangleBuffer, markValidTriangleIndex.Ptr(), MeshTriangleIndex.Ptr() + MeshTriangleIndex.ArraySize(), validTriangleIndicesCount, allTriNums, stream, false));	// 确定临时设备存储需求
-    CHECKCUDA(cudaMallocAsync(&d_temp_storage_2, temp_storage_bytes_2, stream));
-    CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, TriangleBuffer, markValidTriangleIndex.Ptr(), MeshTriangleIndex.Ptr() + MeshTriangleIndex.ArraySize(), validTriangleIndicesCount, allTriNums, stream, false));	// 筛选	
-    CHECKCUDA(cudaMemcpyAsync(&validTriangleIndicesCountHost, validTriangleIndicesCount, sizeof(unsigned int), cudaMemcpyDeviceToHost, stream));
+    dim3 block(128);
+    dim3 grid(divUp(vertexCount, block.x));
+    device::markWeldRepresentativeKernel << <grid, block, 0, stream >> > (sortedKey, vertexCount, isRepresentative);
+    CHECKCUDA(cub::DeviceScan::InclusiveSum(tempStorage, scanTempBytes, isRepresentative, weldedAddress, vertexCount, stream));
+    device::scatterWeldedVerticesKernel << <grid, block, 0, stream >> > (sortedVertexId, weldedAddress, isRepresentative, outputVertices(), vertexCount, vertexRemap, weldedVertices);
+    if (MeshTriangleCount > 0) {
+        dim3 grid_tri(divUp(MeshTriangleCount, block.x));
+        device::remapWeldedTrianglesKernel << <grid_tri, block, 0, stream >> > (vertexRemap, MeshTriangleCount, outputTriangles());
+    }
 
+    int weldedCount = 0;
+    CHECKCUDA(cudaMemcpyAsync(&weldedCount, weldedAddress + vertexCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
     CHECKCUDA(cudaStreamSynchronize(stream));
-    MeshTriangleVertex.ResizeArrayOrException(validVerticesCountHost + MeshTriangleVertex.ArraySize());
-    MeshTriangleIndex.ResizeArrayOrException(validTriangleIndicesCountHost + MeshTriangleIndex.ArraySize());
+    // 焊接后的顶点写回输出(输出可能是映射的VBO)，GetRebuildMeshVertices仍指向输出
+    CHECKCUDA(cudaMemcpyAsync(outputVertices(), weldedVertices, sizeof(Point3D<float>) * weldedCount, cudaMemcpyDeviceToDevice, stream));
+    MeshVertexCount = weldedCount;
+}
+
+void SparseSurfelFusion::ComputeTriangleIndices::buildVertexTriangleAdjacency(cudaStream_t stream)
+{
+    const unsigned int vertexCount = MeshVertexCount;
+    const unsigned int cornerCount = 3 * MeshTriangleCount;
+    int* vertexTriangleOffset = reserveSubdivideBuffer(VertexTriangleOffset, vertexCount + 1);
+    int* vertexTriangleList = reserveSubdivideBuffer(VertexTriangleList, cornerCount);
+
+    if (cornerCount > 0) {
+        unsigned int* cornerVertex = reserveSubdivideBuffer(AdjacencyCornerVertex, cornerCount);
+        int* cornerTriangle = reserveSubdivideBuffer(AdjacencyCornerTriangle, cornerCount);
+        unsigned int* sortedVertex = reserveSubdivideBuffer(AdjacencySortedVertex, cornerCount);
+
+        dim3 block(128);
+        dim3 grid(divUp(MeshTriangleCount, block.x));
+        device::scatterTriangleCornersKernel << <grid, block, 0, stream >> > (outputTriangles(), MeshTriangleCount, cornerVertex, cornerTriangle);
+
+        // 只排序顶点index的有效位，基数排序稳定，同一顶点的三角形保持升序
+        int keyBits = 1;
+        while (keyBits < 32 && (1u << keyBits) < vertexCount) keyBits++;
+        size_t sortTempBytes = 0;
+        CHECKCUDA(cub::DeviceRadixSort::SortPairs(NULL, sortTempBytes, cornerVertex, sortedVertex, cornerTriangle, vertexTriangleList, cornerCount, 0, keyBits, stream));
+        void* tempStorage = reserveSubdivideTempStorage(sortTempBytes);
+        CHECKCUDA(cub::DeviceRadixSort::SortPairs(tempStorage, sortTempBytes, cornerVertex, sortedVertex, cornerTriangle, vertexTriangleList, cornerCount, 0, keyBits, stream));
+    }
+
+    dim3 block(128);
+    dim3 grid(divUp(vertexCount + 1, block.x));
+    device::computeVertexTriangleOffsetKernel << <grid, block, 0, stream >> > (AdjacencySortedVertex.Ptr(), cornerCount, vertexCount, vertexTriangleOffset);
 }
 
 void SparseSurfelFusion::ComputeTriangleIndices::generateSubdivideNodeArrayCountAndAddress(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, const unsigned int OtherDepthNodeCount, cudaStream_t stream)
@@ -1286,9 +1273,6 @@ void SparseSurfelFusion::ComputeTriangleIndices::generateSubdivideNodeArrayCount
     SubdivideNode.ResizeArrayOrException(OtherDepthNodeCount);
     CHECKCUDA(cudaMemsetAsync(SubdivideNode.Array().ptr(), 0, sizeof(OctNode) * OtherDepthNodeCount, stream));
 
-    int* SubdivideNodeNum = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideNodeNum), sizeof(int), stream));
-
     //// 这里无法使用cub::DeviceSelect::Flagged，调用API会导致共享内存溢出，主要是设置L1 Cache 和 Share Memory的比例
     //int* SubdivideNodeNumPtr = NULL;
     //CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideNodeNumPtr), sizeof(int), stream));
@@ -1309,31 +1293,17 @@ void SparseSurfelFusion::ComputeTriangleIndices::generateSubdivideNodeArrayCount
     CHECKCUDA(cudaStreamSynchronize(stream));
     SubdivideNodeNumHost = SubdivideNode_end - SubdivideNode_ptr;
 
-    int* SubdivideDepthNum = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideDepthNum), sizeof(int) * SubdivideNodeNumHost * (Constants::maxDepth_Host + 1), stream));
-    CHECKCUDA(cudaMemsetAsync(SubdivideDepthNum, 0, sizeof(int) * SubdivideNodeNumHost * (Constants::maxDepth_Host + 1), stream));
-
     SubdivideDepthBuffer.ResizeArrayOrException(SubdivideNodeNumHost);
-    
-    dim3 block(128);
-    dim3 grid(divUp(SubdivideNodeNumHost, block.x));
-    device::precomputeSubdivideDepth << <grid, block, 0, stream >> > (SubdivideNode.ArrayView(), DepthBuffer, SubdivideNodeNumHost, SubdivideDepthBuffer.DeviceArray().ptr(), SubdivideDepthNum);
-
-    int* subdivideDepthCount = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&subdivideDepthCount), sizeof(int), stream));
 
-
-    for (int i = 0; i <= Constants::maxDepth_Host; i++) {
-        void* d_temp_storage = NULL;
-        size_t temp_storage_bytes = 0;
-        cub::DeviceReduce::Sum(d_temp_storage, temp_storage_bytes, SubdivideDepthNum + i * SubdivideNodeNumHost, subdivideDepthCount, SubdivideNodeNumHost, stream);
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage, temp_storage_bytes, stream));
-        cub::DeviceReduce::Sum(d_temp_storage, temp_storage_bytes, SubdivideDepthNum + i * SubdivideNodeNumHost, subdivideDepthCount, SubdivideNodeNumHost, stream);
-        CHECKCUDA(cudaMemcpyAsync(&(SubdivideDepthCount[i]), subdivideDepthCount, sizeof(int), cudaMemcpyDeviceToHost, stream));
-        CHECKCUDA(cudaFreeAsync(d_temp_storage, stream));
+    // 每层细分节点的数量在同一个核函数中统计，一次拷贝取回
+    int* subdivideDepthCount = SubdivideCounter.Ptr();
+    CHECKCUDA(cudaMemsetAsync(subdivideDepthCount, 0, sizeof(int) * (Constants::maxDepth_Host + 1), stream));
+    if (SubdivideNodeNumHost > 0) {
+        dim3 block(128);
+        dim3 grid(divUp(SubdivideNodeNumHost, block.x));
+        device::precomputeSubdivideDepth << <grid, block, 0, stream >> > (SubdivideNode.ArrayView(), DepthBuffer, SubdivideNodeNumHost, SubdivideDepthBuffer.DeviceArray().ptr(), subdivideDepthCount);
     }
-
-    CHECKCUDA(cudaFreeAsync(SubdivideDepthNum, stream));    // 用完即刻释放，开销太大
+    CHECKCUDA(cudaMemcpyAsync(SubdivideDepthCount, subdivideDepthCount, sizeof(int) * (Constants::maxDepth_Host + 1), cudaMemcpyDeviceToHost, stream));
     CHECKCUDA(cudaStreamSynchronize(stream));
 
     for (int i = 0; i <= Constants::maxDepth_Host; i++) {
@@ -1347,133 +1317,57 @@ void SparseSurfelFusion::ComputeTriangleIndices::generateSubdivideNodeArrayCount
 
 
 
-void SparseSurfelFusion::ComputeTriangleIndices::generateVertexNumsAndVertexAddress(DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> vvalue, const unsigned int DLevelOffset, cudaStream_t stream)
+void SparseSurfelFusion::ComputeTriangleIndices::generateIsoVertices(DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<VertexNode> VertexArray, cudaStream_t stream)
 {
     const unsigned int EdgeArraySize = EdgeArray.Size();
-    vexNums.ResizeArrayOrException(EdgeArraySize);
     vexAddress.ResizeArrayOrException(EdgeArraySize);
-    markValidVertex.ResizeArrayOrException(EdgeArraySize);
-    dim3 block(128);
+    CHECKCUDA(cudaMemsetAsync(meshElementCount.Ptr(), 0, sizeof(int) * 2, stream));    // maxDepth层是本帧第一批网格元素，从0开始计数
+    dim3 block(128);    // 必须是32的倍数，线程束聚合预留需要整束参与
     dim3 grid(divUp(EdgeArraySize, block.x));
-    device::generateVertexNumsKernel << <grid, block, 0, stream >> > (EdgeArray, NodeArray, vvalue, EdgeArraySize, vexNums.Array().ptr(), markValidVertex.Array().ptr());
-
-    void* tempStorage = NULL;	//【算法临时变量，用完即释放】排他前缀和的临时变量
-    size_t tempStorageBytes = 0;
-    cub::DeviceScan::ExclusiveSum(tempStorage, tempStorageBytes, vexNums.Array().ptr(), vexAddress.Array().ptr(), EdgeArraySize, stream);
-    CHECKCUDA(cudaMallocAsync(&tempStorage, tempStorageBytes, stream));
-    cub::DeviceScan::ExclusiveSum(tempStorage, tempStorageBytes, vexNums.Array().ptr(), vexAddress.Array().ptr(), EdgeArraySize, stream);
-
-    CHECKCUDA(cudaFreeAsync(tempStorage, stream));
+    device::generateIsoVerticesKernel << <grid, block, 0, stream >> > (EdgeArray, NodeArray, VertexArray, vvalue.ArrayView(), EdgeArraySize, outputVertexCapacity(), meshElementCount.Ptr(), vexAddress.Ptr(), outputVertices(), MeshVertexKey.Ptr());
 }
 
-void SparseSurfelFusion::ComputeTriangleIndices::generateTriangleNumsAndTriangleAddress(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> vvalue, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream)
+void SparseSurfelFusion::ComputeTriangleIndices::generateIsoTriangles(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<FaceNode> FaceArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream)
 {
-    triNums.ResizeArrayOrException(DLevelNodeCount);
-    cubeCatagory.ResizeArrayOrException(DLevelNodeCount);
-    triAddress.ResizeArrayOrException(DLevelNodeCount);
-    dim3 block(128);
+    const unsigned int FaceArraySize = FaceArray.Size();
+    hasSurfaceIntersection.ResizeArrayOrException(FaceArraySize);
+    CHECKCUDA(cudaMemsetAsync(hasSurfaceIntersection.Ptr(), 0, sizeof(int) * FaceArraySize, stream));
+    dim3 block(128);    // 必须是32的倍数，线程束聚合预留需要整束参与
     dim3 grid(divUp(DLevelNodeCount, block.x));
-    device::generateTriangleNumsKernel << <grid, block, 0, stream >> > (NodeArray, vvalue, DLevelOffset, DLevelNodeCount, triNums.Array().ptr(), cubeCatagory.Array().ptr());
-
-    void* tempStorage = NULL;	//【算法临时变量，用完即释放】排他前缀和的临时变量
-    size_t tempStorageBytes = 0;
-    cub::DeviceScan::ExclusiveSum(tempStorage, tempStorageBytes, triNums.Array().ptr(), triAddress.Array().ptr(), DLevelNodeCount, stream);
-    CHECKCUDA(cudaMallocAsync(&tempStorage, tempStorageBytes, stream));
-    cub::DeviceScan::ExclusiveSum(tempStorage, tempStorageBytes, triNums.Array().ptr(), triAddress.Array().ptr(), DLevelNodeCount, stream);
-
-    CHECKCUDA(cudaFreeAsync(tempStorage, stream));
+    device::generateIsoTrianglesKernel << <grid, block, 0, stream >> > (NodeArray, FaceArray, vvalue.ArrayView(), vexAddress.Ptr(), DLevelOffset, DLevelNodeCount, outputTriangleCapacity(), meshElementCount.Ptr(), outputTriangles(), hasSurfaceIntersection.Ptr());
 }
 
-void SparseSurfelFusion::ComputeTriangleIndices::generateVerticesAndTriangle(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<FaceNode> FaceArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream)
+void SparseSurfelFusion::ComputeTriangleIndices::processOtherDepthLeafNodes(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<VertexNode> VertexArray, const unsigned int DLevelOffset, cudaStream_t stream)
 {
-    const unsigned int EdgeArraySize = EdgeArray.Size();
-    const unsigned int FaceArraySize = FaceArray.Size();
-
-    int lastVexAddr;
-    int lastVexNums;
-    CHECKCUDA(cudaMemcpyAsync(&lastVexAddr, vexAddress.Array().ptr() + EdgeArraySize - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-    CHECKCUDA(cudaMemcpyAsync(&lastVexNums, vexNums.Array().ptr() + EdgeArraySize - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-    CHECKCUDA(cudaStreamSynchronize(stream));   // 这里需要统计一下所有顶点的数量
-
-    int allVexNums = lastVexAddr + lastVexNums; // vertex的总数
-
-    Point3D<float>* VertexBuffer = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&VertexBuffer), sizeof(Point3D<float>) * allVexNums, stream));
-
-    EdgeNode* validEdgeArray = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&validEdgeArray), sizeof(EdgeNode) * allVexNums, stream));
-
-    int* validVertexAddress = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&validVertexAddress), sizeof(int) * allVexNums, stream));
-
-    int* validEdgeArrayNum = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&validEdgeArrayNum), sizeof(int), stream));
-
-    int* validVertexAddressNum = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&validVertexAddressNum), sizeof(int), stream));
-
-    void* d_temp_storage_1 = NULL;
-    size_t temp_storage_bytes_1 = 0;
-    CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, EdgeArray.RawPtr(), markValidVertex.Array().ptr(), validEdgeArray, validEdgeArrayNum, EdgeArraySize, stream, false));	// 确定临时设备存储需求
-    CHECKCUDA(cudaMallocAsync(&d_temp_storage_1, temp_storage_bytes_1, stream));
-    CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, EdgeArray.RawPtr(), markValidVertex.Array().ptr(), validEdgeArray, validEdgeArrayNum, EdgeArraySize, stream, false));	// 筛选	
-
-    void* d_temp_storage_2 = NULL;
-    size_t temp_storage_bytes_2 = 0;
-    CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, vexAddress.Array().ptr(), markValidVertex.Array().ptr(), validVertexAddress, validVertexAddressNum, EdgeArraySize, stream, false));
-    CHECKCUDA(cudaMallocAsync(&d_temp_storage_2, temp_storage_bytes_2, stream));
-    CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, vexAddress.Array().ptr(), markValidVertex.Array().ptr(), validVertexAddress, validVertexAddressNum, EdgeArraySize, stream, false));
-
-    assert(allVexNums == validEdgeArrayNum);        // 合理性检查
-    assert(allVexNums == validVertexAddressNum);    // 合理性检查
-
-    dim3 block_1(128);
-    dim3 grid_1(divUp(allVexNums, block_1.x));
-    device::generateIntersectionPoint << <grid_1, block_1, 0, stream >> > (NodeArray.ArrayView(), VertexArray, vvalue.ArrayView(), validEdgeArray, validVertexAddress, allVexNums, VertexBuffer);
-
-    int lastTriAddr;
-    int lastTriNums;
-    CHECKCUDA(cudaMemcpyAsync(&lastTriAddr, triAddress.Array().ptr() + DLevelNodeCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-    CHECKCUDA(cudaMemcpyAsync(&lastTriNums, triNums.Array().ptr() + DLevelNodeCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-    CHECKCUDA(cudaStreamSynchronize(stream));   // 这里需要统计一下所有顶点的数量
-    int allTriNums = lastTriAddr + lastTriNums;
-
-    TriangleIndex* TriangleBuffer = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&TriangleBuffer), sizeof(TriangleIndex) * allTriNums, stream));
-
-    int* hasSurfaceIntersection = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&hasSurfaceIntersection), sizeof(int) * FaceArraySize, stream));
-    CHECKCUDA(cudaMemsetAsync(hasSurfaceIntersection, 0, sizeof(int) * FaceArraySize, stream));
-
-    dim3 block_2(128);
-    dim3 grid_2(divUp(DLevelNodeCount, block_2.x));
-    device::generateTrianglePos << <grid_2, block_2, 0, stream >> > (NodeArray.ArrayView(), FaceArray, triNums.ArrayView(), cubeCatagory.ArrayView(), vexAddress.ArrayView(), triAddress.ArrayView(), DLevelOffset, DLevelNodeCount, TriangleBuffer, hasSurfaceIntersection);
-    CHECKCUDA(cudaStreamSynchronize(stream));   // 这里需要统计一下所有顶点的数量
-
-    insertTriangle(VertexBuffer, allVexNums, TriangleBuffer, allTriNums, stream);
-
     markValidSubdividedNode.ResizeArrayOrException(DLevelOffset);
 
-    dim3 block_3(128);
-    dim3 grid_3(divUp(DLevelOffset, block_3.x));
-    device::ProcessLeafNodesAtOtherDepth << <grid_3, block_3, 0, stream >> > (VertexArray, vvalue.ArrayView(), DLevelOffset, hasSurfaceIntersection, NodeArray.Array().ptr(), markValidSubdividedNode.Array().ptr());
-
-    // 变量用完即释放
-    CHECKCUDA(cudaFreeAsync(VertexBuffer, stream));
-    CHECKCUDA(cudaFreeAsync(validEdgeArray, stream));
-    CHECKCUDA(cudaFreeAsync(validVertexAddress, stream));
-    CHECKCUDA(cudaFreeAsync(validEdgeArrayNum, stream));
-    CHECKCUDA(cudaFreeAsync(validVertexAddressNum, stream));
-    CHECKCUDA(cudaFreeAsync(d_temp_storage_1, stream));
-    CHECKCUDA(cudaFreeAsync(d_temp_storage_2, stream));
-    CHECKCUDA(cudaFreeAsync(TriangleBuffer, stream));
-    CHECKCUDA(cudaFreeAsync(hasSurfaceIntersection, stream));
+    dim3 block(128);
+    dim3 grid(divUp(DLevelOffset, block.x));
+    device::ProcessLeafNodesAtOtherDepth << <grid, block, 0, stream >> > (VertexArray, vvalue.ArrayView(), DLevelOffset, hasSurfaceIntersection.Ptr(), NodeArray.Array().ptr(), markValidSubdividedNode.Array().ptr());
 
+    // 顶点、三角形数量随流异步取回，由后续第一次需要网格大小的地方同步
+    CHECKCUDA(cudaMemcpyAsync(meshElementCountHost, meshElementCount.Ptr(), sizeof(int) * 2, cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaEventRecord(meshElementCountReady, stream));
+    meshElementCountPending = true;
+}
+
+void SparseSurfelFusion::ComputeTriangleIndices::synchronizeMeshElementCount()
+{
+    if (!meshElementCountPending) return;
+    CHECKCUDA(cudaEventSynchronize(meshElementCountReady));
+    meshElementCountPending = false;
+    if (meshElementCountHost[0] > outputVertexCapacity() || meshElementCountHost[1] > outputTriangleCapacity()) {
+        LOGGING(FATAL) << "maxDepth层网格超出输出容量：顶点 " << meshElementCountHost[0] << " / " << outputVertexCapacity() << "   三角形 " << meshElementCountHost[1] << " / " << outputTriangleCapacity();
+    }
+    MeshVertexCount = meshElementCountHost[0];
+    MeshTriangleCount = meshElementCountHost[1];
 }
 
 
-void SparseSurfelFusion::ComputeTriangleIndices::CoarserSubdivideNodeAndRebuildMesh(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream)
+void SparseSurfelFusion::ComputeTriangleIndices::CoarserSubdivideNodeAndRebuildMesh(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream)
 {
+    prepareBaseFunctionValueTable(BaseFunction, stream);
+    if (SubdivideDepthAddress[finerDepth] == 0) return;     // 没有Coarser层的细分节点
     int minSubdivideRootDepth;
     SubdivideDepthBuffer.SynchronizeToHost(stream);
     std::vector<int>& SubdivideDepthBufferHost = SubdivideDepthBuffer.HostArray();
@@ -1481,16 +1375,14 @@ void SparseSurfelFusion::ComputeTriangleIndices::CoarserSubdivideNodeAndRebuildM
     SubdivideNode.ArrayView().Download(SubdivideNodeHost);
     minSubdivideRootDepth = SubdivideDepthBufferHost[0];
 
+    // Coarser节点展开后的子树过大(8^(maxDepth - rootDepth))，逐个节点重建，缓存按最浅的节点从缓存池中取一次
     int maxNodeNums = (powf(8, (Constants::maxDepth_Host - minSubdivideRootDepth + 1)) - 1) / 7;
+    EasyOctNode* SubdivideArray = reserveSubdivideBuffer(SubdivideRebuildArray, maxNodeNums);
+    int* SubdivideArrayDepthBuffer = reserveSubdivideBuffer(SubdivideRebuildDepth, maxNodeNums);
+    Point3D<float>* SubdivideArrayCenterBuffer = reserveSubdivideBuffer(SubdivideRebuildCenter, maxNodeNums);
 
-    EasyOctNode* SubdivideArray = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideArray), sizeof(EasyOctNode) * maxNodeNums, stream));
-
-    int* SubdivideArrayDepthBuffer = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideArrayDepthBuffer), sizeof(int) * maxNodeNums, stream));
-
-    Point3D<float>* SubdivideArrayCenterBuffer = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideArrayCenterBuffer), sizeof(Point3D<float>) * maxNodeNums, stream));
+    const int NodeArraySize = NodeArray.ArraySize();
+    OctNode* NodeArrayPtr = NodeArray.Array().ptr();
 
     for (int i = 0; i < SubdivideNodeNumHost; i++) {
         int rootDepth = SubdivideDepthBufferHost[i];
@@ -1503,25 +1395,17 @@ void SparseSurfelFusion::ComputeTriangleIndices::CoarserSubdivideNodeAndRebuildM
             currentNodeNum <<= 3;       // 乘8
         }
 
-        //for (int j = 0; j <= Constants::maxDepth_Host; j++) {
-        //    printf("fixedDepthNodeNum[%d] = %d\n", j, fixedDepthNodeNum[j]);
-        //}
-
-        //printf("SubdivideArraySize - (D-1) = %d   fixedDepthNodeNum = %d\n", SubdivideArraySize - fixedDepthNodeNum[Constants::maxDepth_Host - 1], fixedDepthNodeNum[Constants::maxDepth_Host]);
-
         for (int j = rootDepth; j <= Constants::maxDepth_Host; j++) {
             fixedDepthNodeAddress[j] = fixedDepthNodeAddress[j - 1] + fixedDepthNodeNum[j - 1];
         }
         OctNode rootNode = SubdivideNodeHost[i];
         int rootIndex = rootNode.neighs[13];
         int rootParent = rootNode.parent;
-        int rootKey = rootNode.key;
-        int rootSonKey = (rootKey >> (3 * (Constants::maxDepth_Host - rootDepth))) & 7;
+        OctKey rootKey = rootNode.key;
+        int rootSonKey = int(rootKey >> (3 * (Constants::maxDepth_Host - rootDepth))) & 7;
 
         CHECKCUDA(cudaMemsetAsync(SubdivideArray, 0, sizeof(EasyOctNode) * SubdivideArraySize, stream));
 
-        int NodeArraySize = NodeArray.ArraySize();
-        OctNode* NodeArrayPtr = NodeArray.Array().ptr();
         CHECKCUDA(cudaMemcpyAsync(&NodeArrayPtr[rootParent].children[rootSonKey], &NodeArraySize, sizeof(int), cudaMemcpyHostToDevice, stream));
         CHECKCUDA(cudaMemcpyAsync(&SubdivideArray[0].parent, &rootParent, sizeof(int), cudaMemcpyHostToDevice, stream));
 
@@ -1535,660 +1419,172 @@ void SparseSurfelFusion::ComputeTriangleIndices::CoarserSubdivideNodeAndRebuildM
             device::computeRebuildNeighbor << <grid_2, block_2, 0, stream >> > (NodeArray.ArrayView(), fixedDepthNodeAddress[depth], fixedDepthNodeNum[depth], NodeArraySize, depth, SubdivideArray);
         }
 
-        /**************************************** SubdivideVertexArray ****************************************/
-
-        VertexNode* SubdividePreVertexArray = NULL;     // 即时变量，用完即删
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdividePreVertexArray), sizeof(VertexNode) * 8 * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-        CHECKCUDA(cudaMemsetAsync(SubdividePreVertexArray, 0, sizeof(VertexNode) * 8 * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-
-        markValidSubdivideVertex.ResizeArrayOrException(fixedDepthNodeNum[Constants::maxDepth_Host]);
-
-        dim3 block_3(128);
-        dim3 grid_3(divUp(fixedDepthNodeNum[Constants::maxDepth_Host], block_3.x));
-        device::initSubdivideVertexOwner << <grid_3, block_3, 0, stream >> > (SubdivideArray, SubdivideArrayCenterBuffer, fixedDepthNodeAddress[Constants::maxDepth_Host], fixedDepthNodeNum[Constants::maxDepth_Host], NodeArraySize, SubdividePreVertexArray, markValidSubdivideVertex.Array().ptr());
-    
-        VertexNode* SubdivideVertexArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideVertexArray), sizeof(VertexNode) * 8 * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-        CHECKCUDA(cudaMemsetAsync(SubdivideVertexArray, 0, sizeof(VertexNode) * 8 * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-    
-        int* SubdivideVertexArraySize = NULL;
-        int SubdivideVertexArraySizeHost = -1;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideVertexArraySize), sizeof(int), stream));
-
-        void* d_temp_storage_1 = NULL;    // 中间变量，用完即可释放
-        size_t temp_storage_bytes_1 = 0;  // 中间变量
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, SubdividePreVertexArray, markValidSubdivideVertex.Array().ptr(), SubdivideVertexArray, SubdivideVertexArraySize, 8 * fixedDepthNodeNum[Constants::maxDepth_Host], stream, false));	// 确定临时设备存储需求
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_1, temp_storage_bytes_1, stream));
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, SubdividePreVertexArray, markValidSubdivideVertex.Array().ptr(), SubdivideVertexArray, SubdivideVertexArraySize, 8 * fixedDepthNodeNum[Constants::maxDepth_Host], stream, false));	// 筛选	
-        CHECKCUDA(cudaMemcpyAsync(&SubdivideVertexArraySizeHost, SubdivideVertexArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-        CHECKCUDA(cudaFreeAsync(SubdividePreVertexArray, stream));  // 即时变量，用完即删
-        CHECKCUDA(cudaFreeAsync(SubdivideVertexArraySize, stream));
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_1, stream));
-
-        CHECKCUDA(cudaStreamSynchronize(stream));       // 同步流，获得SubdivideVertexArraySizeHost
-
-        if (SubdivideVertexArraySizeHost == 0) {        // 该节点没有可细分的顶点【求隐式表面，顶点和边缺一不可】
-            CHECKCUDA(cudaFreeAsync(SubdivideVertexArray, stream));
-            continue;
-        }
-        //printf("SubdivideVertexArraySizeHost = %d\n", SubdivideVertexArraySizeHost);
-
-
-        dim3 block_4(128);
-        dim3 grid_4(divUp(SubdivideVertexArraySizeHost, block_4.x));
-        device::maintainSubdivideVertexNodePointer << <grid_4, block_4, 0, stream >> > (CenterBuffer, SubdivideVertexArraySizeHost, NodeArraySize, SubdivideArrayCenterBuffer, SubdivideVertexArray, SubdivideArray);
-
-        /**************************************** SubdivideEdgeArray ****************************************/
-
-        EdgeNode* SubdividePreEdgeArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdividePreEdgeArray), sizeof(EdgeNode) * 12 * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-        CHECKCUDA(cudaMemsetAsync(SubdividePreEdgeArray, 0, sizeof(EdgeNode) * 12 * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-
-        markValidSubdivideEdge.ResizeArrayOrException(fixedDepthNodeNum[Constants::maxDepth_Host]);
-
-        dim3 block_5(128);
-        dim3 grid_5(divUp(fixedDepthNodeNum[Constants::maxDepth_Host], block_5.x));
-        device::initSubdivideEdgeArray << <grid_5, block_5, 0, stream >> > (SubdivideArray, SubdivideArrayCenterBuffer, NodeArraySize, fixedDepthNodeAddress[Constants::maxDepth_Host], fixedDepthNodeNum[Constants::maxDepth_Host], SubdividePreEdgeArray, markValidSubdivideEdge.Array().ptr());
-
-        EdgeNode* SubdivideEdgeArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideEdgeArray), sizeof(EdgeNode) * 12 * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-        CHECKCUDA(cudaMemsetAsync(SubdivideEdgeArray, 0, sizeof(EdgeNode) * 12 * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-
-        int* SubdivideEdgeArraySize = NULL;
-        int SubdivideEdgeArraySizeHost = -1;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideEdgeArraySize), sizeof(int), stream));
-
-        void* d_temp_storage_2 = NULL;    // 中间变量，用完即可释放
-        size_t temp_storage_bytes_2 = 0;  // 中间变量
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, SubdividePreEdgeArray, markValidSubdivideEdge.Array().ptr(), SubdivideEdgeArray, SubdivideEdgeArraySize, 12 * fixedDepthNodeNum[Constants::maxDepth_Host], stream, false));	// 确定临时设备存储需求
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_2, temp_storage_bytes_2, stream));
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, SubdividePreEdgeArray, markValidSubdivideEdge.Array().ptr(), SubdivideEdgeArray, SubdivideEdgeArraySize, 12 * fixedDepthNodeNum[Constants::maxDepth_Host], stream, false));	// 筛选	
-        CHECKCUDA(cudaMemcpyAsync(&SubdivideEdgeArraySizeHost, SubdivideEdgeArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-        CHECKCUDA(cudaFreeAsync(SubdividePreEdgeArray, stream));  // 即时变量，用完即删
-        CHECKCUDA(cudaFreeAsync(SubdivideEdgeArraySize, stream));
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_2, stream));
-
-        CHECKCUDA(cudaStreamSynchronize(stream));       // 同步流，获得SubdivideEdgeArraySizeHost
-
-        if (SubdivideEdgeArraySizeHost == 0) {          // 该节点没有可细分的边【求隐式表面，顶点和边缺一不可】
-            CHECKCUDA(cudaFreeAsync(SubdivideVertexArray, stream));
-            CHECKCUDA(cudaFreeAsync(SubdivideEdgeArray, stream));
-            continue;
-        }
-        //printf("SubdivideEdgeArraySizeHost = %d\n", SubdivideEdgeArraySizeHost);
-
-
-        dim3 block_6(128);
-        dim3 grid_6(divUp(SubdivideEdgeArraySizeHost, block_6.x));
-        device::maintainSubdivideEdgeNodePointer << <grid_6, block_6, 0, stream >> > (CenterBuffer, SubdivideArrayCenterBuffer, SubdivideEdgeArraySizeHost, NodeArraySize, SubdivideArray, SubdivideEdgeArray);
-
-        /**************************************** 计算细分节点隐式函数的值, 生成细分顶点的vexNums和vexAddress ****************************************/
-        float* SubdivideVvalue = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideVvalue), sizeof(float) * SubdivideVertexArraySizeHost, stream));
-        CHECKCUDA(cudaMemsetAsync(SubdivideVvalue, 0, sizeof(float) * SubdivideVertexArraySizeHost, stream));
-        dim3 block_7(128);
-        dim3 grid_7(divUp(SubdivideVertexArraySizeHost, block_7.x));
-        device::computeSubdivideVertexImplicitFunctionValue << <grid_7, block_7, 0, stream >> > (SubdivideVertexArray, SubdivideArray, NodeArray.ArrayView(), dx, encodeNodeIndexInFunction, BaseFunction, NodeArraySize, rootIndex, SubdivideVertexArraySizeHost, isoValue, SubdivideVvalue);
-
-        int* SubdivideVexNums = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideVexNums), sizeof(int) * SubdivideEdgeArraySizeHost, stream));
-        CHECKCUDA(cudaMemsetAsync(SubdivideVexNums, 0, sizeof(int) * SubdivideEdgeArraySizeHost, stream));
-
-        markValidSubdivedeVexNum.ResizeArrayOrException(SubdivideEdgeArraySizeHost);
-        
-        dim3 block_8(128);
-        dim3 grid_8(divUp(SubdivideEdgeArraySizeHost, block_8.x));
-        device::generateSubdivideVexNums << <grid_8, block_8, 0, stream >> > (SubdivideEdgeArray, SubdivideArray, SubdivideEdgeArraySizeHost, NodeArraySize, SubdivideVvalue, SubdivideVexNums, markValidSubdivedeVexNum.Array().ptr());
-        
-        
-        //printf("SubdivideEdgeArraySizeHost = %d\n", SubdivideEdgeArraySizeHost);
-
-
-        int* SubdivideVexAddress = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideVexAddress), sizeof(int) * SubdivideEdgeArraySizeHost, stream));
-        CHECKCUDA(cudaMemsetAsync(SubdivideVexAddress, 0, sizeof(int) * SubdivideEdgeArraySizeHost, stream));
-
-        void* tempVexAddressStorage = NULL;	//【算法临时变量，用完即释放】排他前缀和的临时变量
-        size_t tempVexAddressStorageBytes = 0;
-        cub::DeviceScan::ExclusiveSum(tempVexAddressStorage, tempVexAddressStorageBytes, SubdivideVexNums, SubdivideVexAddress, SubdivideEdgeArraySizeHost, stream);
-        CHECKCUDA(cudaMallocAsync(&tempVexAddressStorage, tempVexAddressStorageBytes, stream));
-        cub::DeviceScan::ExclusiveSum(tempVexAddressStorage, tempVexAddressStorageBytes, SubdivideVexNums, SubdivideVexAddress, SubdivideEdgeArraySizeHost, stream);
-
-        CHECKCUDA(cudaFreeAsync(tempVexAddressStorage, stream));
-
-        int SubdivideLastVexAddr = -1;
-        int SubdivideLastVexNums = -1;
-        CHECKCUDA(cudaMemcpyAsync(&SubdivideLastVexAddr, SubdivideVexAddress + SubdivideEdgeArraySizeHost - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-        CHECKCUDA(cudaMemcpyAsync(&SubdivideLastVexNums, SubdivideVexNums + SubdivideEdgeArraySizeHost - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-
-        CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-
-        int SubdivideAllVexNums = SubdivideLastVexAddr + SubdivideLastVexNums;
-        //printf("SubdivideAllVexNums = %d\n", SubdivideAllVexNums);
-
-        if (SubdivideAllVexNums == 0) {
-            CHECKCUDA(cudaMemcpyAsync(&(NodeArray[rootParent].children[rootSonKey]), &rootIndex, sizeof(int), cudaMemcpyHostToDevice, stream));
-            CHECKCUDA(cudaFreeAsync(SubdivideVertexArray, stream));
-            CHECKCUDA(cudaFreeAsync(SubdivideEdgeArray, stream));
-            CHECKCUDA(cudaFreeAsync(SubdivideVvalue, stream));
-            CHECKCUDA(cudaFreeAsync(SubdivideVexNums, stream));
-            CHECKCUDA(cudaFreeAsync(SubdivideVexAddress, stream));
-            continue;
-        }
-
-        /**************************************** 计算细分顶点的三角形和立方体类型 ****************************************/
-
-        int* SubdivideTriNums = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideTriNums), sizeof(int) * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-        CHECKCUDA(cudaMemsetAsync(SubdivideTriNums, 0, sizeof(int) * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-
-        int* SubdivideCubeCatagory = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideCubeCatagory), sizeof(int) * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-        CHECKCUDA(cudaMemsetAsync(SubdivideCubeCatagory, 0, sizeof(int) * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-
-        dim3 block_9(128);
-        dim3 grid_9(divUp(fixedDepthNodeNum[Constants::maxDepth_Host], block_9.x));
-        device::generateTriNums << <grid_9, block_9, 0, stream >> > (SubdivideArray, fixedDepthNodeAddress[Constants::maxDepth_Host], fixedDepthNodeNum[Constants::maxDepth_Host], SubdivideVvalue, SubdivideTriNums, SubdivideCubeCatagory);
-
-        int* SubdivideTriAddress = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideTriAddress), sizeof(int) * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-        CHECKCUDA(cudaMemsetAsync(SubdivideTriAddress, 0, sizeof(int) * fixedDepthNodeNum[Constants::maxDepth_Host], stream));
-
-        void* tempTriAddressStorage = NULL;	//【算法临时变量，用完即释放】排他前缀和的临时变量
-        size_t tempTriAddressStorageBytes = 0;
-        cub::DeviceScan::ExclusiveSum(tempTriAddressStorage, tempTriAddressStorageBytes, SubdivideTriNums, SubdivideTriAddress, fixedDepthNodeNum[Constants::maxDepth_Host], stream);
-        CHECKCUDA(cudaMallocAsync(&tempTriAddressStorage, tempTriAddressStorageBytes, stream));
-        cub::DeviceScan::ExclusiveSum(tempTriAddressStorage, tempTriAddressStorageBytes, SubdivideTriNums, SubdivideTriAddress, fixedDepthNodeNum[Constants::maxDepth_Host], stream);
-
-        CHECKCUDA(cudaFreeAsync(tempTriAddressStorage, stream));
-
-        Point3D<float>* SubdivideVertexBuffer = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideVertexBuffer), sizeof(Point3D<float>) * SubdivideAllVexNums, stream));
-        //std::vector<Point3D<float>> SubdivideVertexBufferHost;
-        //SubdivideVertexBufferHost.resize(SubdivideAllVexNums);
-
-        EdgeNode* SubdivideValidEdgeArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideValidEdgeArray), sizeof(EdgeNode) * SubdivideAllVexNums, stream));
-
-        int* SubdivideValidEdgeArraySize = NULL;    // 有效的细分边device
-        int SubdivideValidEdgeArraySizeHost = -1;   // 有效的细分边Host
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideValidEdgeArraySize), sizeof(int), stream));
-
-        void* d_temp_storage_3 = NULL;    // 中间变量，用完即可释放
-        size_t temp_storage_bytes_3 = 0;  // 中间变量
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_3, temp_storage_bytes_3, SubdivideEdgeArray, markValidSubdivedeVexNum.Array().ptr(), SubdivideValidEdgeArray, SubdivideValidEdgeArraySize, SubdivideEdgeArraySizeHost, stream, false));	// 确定临时设备存储需求
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_3, temp_storage_bytes_3, stream));
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_3, temp_storage_bytes_3, SubdivideEdgeArray, markValidSubdivedeVexNum.Array().ptr(), SubdivideValidEdgeArray, SubdivideValidEdgeArraySize, SubdivideEdgeArraySizeHost, stream, false));	// 筛选	
-        CHECKCUDA(cudaMemcpyAsync(&SubdivideValidEdgeArraySizeHost, SubdivideValidEdgeArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-        int* SubdivideValidVexAddress = NULL;    // 有效的细分边device
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideValidVexAddress), sizeof(int) * SubdivideAllVexNums, stream));
-
-        int* SubdivideValidVexAddressSize = NULL;    // 有效的细分边device
-        int SubdivideValidVexAddressSizeHost = -1;   // 有效的细分边Host
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideValidVexAddressSize), sizeof(int), stream));
-
-        void* d_temp_storage_4 = NULL;    // 中间变量，用完即可释放
-        size_t temp_storage_bytes_4 = 0;  // 中间变量
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_4, temp_storage_bytes_4, SubdivideVexAddress, markValidSubdivedeVexNum.Array().ptr(), SubdivideValidVexAddress, SubdivideValidVexAddressSize, SubdivideEdgeArraySizeHost, stream, false));	// 确定临时设备存储需求
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_4, temp_storage_bytes_4, stream));
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_4, temp_storage_bytes_4, SubdivideVexAddress, markValidSubdivedeVexNum.Array().ptr(), SubdivideValidVexAddress, SubdivideValidVexAddressSize, SubdivideEdgeArraySizeHost, stream, false));	// 筛选	
-        CHECKCUDA(cudaMemcpyAsync(&SubdivideValidVexAddressSizeHost, SubdivideValidVexAddressSize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-        dim3 block_10(128);
-        dim3 grid_10(divUp(SubdivideAllVexNums, block_10.x));
-        device::generateSubdivideIntersectionPoint << <grid_10, block_10, 0, stream >> > (SubdivideValidEdgeArray, SubdivideVertexArray, SubdivideArray, SubdivideValidVexAddress, SubdivideVvalue, SubdivideValidEdgeArraySizeHost, NodeArraySize, SubdivideVertexBuffer);
-        //CHECKCUDA(cudaMemcpyAsync(SubdivideVertexBufferHost.data(), SubdivideVertexBuffer, sizeof(Point3D<float>) * SubdivideAllVexNums, cudaMemcpyDeviceToHost, stream));
-
-        CHECKCUDA(cudaFreeAsync(SubdivideValidEdgeArray, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideValidVexAddress, stream));
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_3, stream));
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_4, stream));
-
-        //CHECKCUDA(cudaStreamSynchronize(stream));
-        //printf("depth = %d   SubdivideValidVexAddressSize = %d\n", i, SubdivideValidVexAddressSizeHost);
-
-        int SubdivideLastTriAddr;
-        int SubdivideLastTriNums;
-        CHECKCUDA(cudaMemcpyAsync(&SubdivideLastTriAddr, SubdivideTriAddress + fixedDepthNodeNum[Constants::maxDepth_Host] - 1, sizeof(int), cudaMemcpyDeviceToHost));
-        CHECKCUDA(cudaMemcpyAsync(&SubdivideLastTriNums, SubdivideTriNums + fixedDepthNodeNum[Constants::maxDepth_Host] - 1, sizeof(int), cudaMemcpyDeviceToHost));
-        CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-        int SubdivideAllTriNums = SubdivideLastTriAddr + SubdivideLastTriNums;
-        //printf("depth = %d   SubdivideAllTriNums = %d\n", i, SubdivideAllTriNums);
-
-        TriangleIndex* SubdivideTriangleBuffer = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&SubdivideTriangleBuffer), sizeof(TriangleIndex) * SubdivideAllTriNums, stream));
-        //CHECKCUDA(cudaMemsetAsync(SubdivideTriangleBuffer, 0, sizeof(TriangleIndex) * SubdivideAllTriNums, stream));
-
-        //std::vector<int> SubdivideTriangleBufferHost;
-        //SubdivideTriangleBufferHost.resize(3 * SubdivideAllTriNums);
-
-        dim3 block_11(128);
-        dim3 grid_11(divUp(fixedDepthNodeNum[Constants::maxDepth_Host], block_11.x));
-        device::generateSubdivideTrianglePos << <grid_11, block_11, 0, stream >> > (SubdivideArray, fixedDepthNodeAddress[Constants::maxDepth_Host], fixedDepthNodeNum[Constants::maxDepth_Host], SubdivideTriNums, SubdivideCubeCatagory, SubdivideVexAddress, SubdivideTriAddress, SubdivideTriangleBuffer);
-
-
-
-        insertTriangle(SubdivideVertexBuffer, SubdivideAllVexNums, SubdivideTriangleBuffer, SubdivideAllTriNums, stream);
-        //CHECKCUDA(cudaMemcpyAsync(SubdivideTriangleBufferHost.data(), SubdivideTriangleBuffer, sizeof(int) * 3 * SubdivideAllTriNums, cudaMemcpyDeviceToHost, stream));
-
-        CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-        
-
+        rebuildSubdivideMesh(NodeArray.ArrayView(), CenterBuffer, BaseFunction, dx, encodeNodeIndexInFunction, isoValue, SubdivideArray, SubdivideArrayCenterBuffer, fixedDepthNodeAddress[Constants::maxDepth_Host], fixedDepthNodeNum[Constants::maxDepth_Host], rootIndex, NULL, NULL, stream);
 
-        //insertTriangle(SubdivideVertexBufferHost.data(), SubdivideAllVexNums, SubdivideTriangleBufferHost.data(), SubdivideAllTriNums, mesh);
-
-        CHECKCUDA(cudaMemcpy(&(NodeArray[rootParent].children[rootSonKey]), &rootIndex, sizeof(int), cudaMemcpyHostToDevice));
-        CHECKCUDA(cudaFreeAsync(SubdivideVertexArray, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideEdgeArray, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideVvalue, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideVexNums, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideVexAddress, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideTriNums, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideCubeCatagory, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideTriAddress, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideVertexBuffer, stream));
-        CHECKCUDA(cudaFreeAsync(SubdivideTriangleBuffer, stream));
+        CHECKCUDA(cudaMemcpyAsync(&NodeArrayPtr[rootParent].children[rootSonKey], &rootIndex, sizeof(int), cudaMemcpyHostToDevice, stream));
     }
-    CHECKCUDA(cudaFreeAsync(SubdivideArray, stream));
-    CHECKCUDA(cudaFreeAsync(SubdivideArrayCenterBuffer, stream));
-    CHECKCUDA(cudaFreeAsync(SubdivideArrayDepthBuffer, stream));
 }
 
-void SparseSurfelFusion::ComputeTriangleIndices::FinerSubdivideNodeAndRebuildMesh(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream)
+void SparseSurfelFusion::ComputeTriangleIndices::FinerSubdivideNodeAndRebuildMesh(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream)
 {
+    prepareBaseFunctionValueTable(BaseFunction, stream);
     const unsigned int NodeArraySize = NodeArray.ArraySize();
-    for (int i = finerDepth; i < Constants::maxDepth_Host; i++) {
-        int finerDepthStart = SubdivideDepthAddress[i];
-        int finerSubdivideNum = SubdivideDepthCount[i];
-        int* fixedDepthNums = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&fixedDepthNums), sizeof(int) * finerSubdivideNum * Constants::maxDepth_Host, stream));
-        CHECKCUDA(cudaMemsetAsync(fixedDepthNums, 0, sizeof(int) * finerSubdivideNum * Constants::maxDepth_Host, stream));
-
-        dim3 block_1(128);
-        dim3 grid_1(divUp(finerSubdivideNum, block_1.x));
-        device::initFixedDepthNums << <grid_1, block_1, 0, stream >> > (SubdivideNode.ArrayView(), SubdivideDepthBuffer.DeviceArrayReadOnly(), finerDepthStart, finerSubdivideNum, fixedDepthNums);
-
-        //CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-        //std::vector<int> fixedDepthNumsHost;
-        //fixedDepthNumsHost.resize(finerSubdivideNum * Constants::maxDepth_Host);
-        //CHECKCUDA(cudaMemcpyAsync(fixedDepthNumsHost.data(), fixedDepthNums, sizeof(int) * finerSubdivideNum * Constants::maxDepth_Host, cudaMemcpyDeviceToHost, stream));
-        //for (int j = 0; j < fixedDepthNumsHost.size(); j++) {
-        //    if (j % 1000 == 0) printf("depth = %d   fixedDepthNumsHost[%d] = %d\n", i, j, fixedDepthNumsHost[j]);
-        //}        
-
-
-        int* rebuildNumsDevice = NULL;
-        int rebuildNums = -1;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&rebuildNumsDevice), sizeof(int), stream));
-        
-        void* d_temp_storage = NULL;
-        size_t temp_storage_bytes = 0;
-        cub::DeviceReduce::Sum(d_temp_storage, temp_storage_bytes, fixedDepthNums, rebuildNumsDevice, finerSubdivideNum * Constants::maxDepth_Host, stream);
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage, temp_storage_bytes, stream));
-        cub::DeviceReduce::Sum(d_temp_storage, temp_storage_bytes, fixedDepthNums, rebuildNumsDevice, finerSubdivideNum * Constants::maxDepth_Host, stream);
-        CHECKCUDA(cudaMemcpyAsync(&rebuildNums, rebuildNumsDevice, sizeof(int), cudaMemcpyDeviceToHost, stream));
-        CHECKCUDA(cudaFreeAsync(d_temp_storage, stream));
-        CHECKCUDA(cudaFreeAsync(rebuildNumsDevice, stream));
-        //CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-        //printf("depth = %d   rebuildNums = %d\n", i, rebuildNums);
-
-        for (int depth = 1; depth <= Constants::maxDepth_Host; depth++) {
-            void* d_temp_storage_1 = NULL;
-            size_t temp_storage_bytes_1 = 0;
-            int* LevelNodeCount = NULL;
-            CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&LevelNodeCount), sizeof(int), stream));
-            cub::DeviceReduce::Sum(d_temp_storage_1, temp_storage_bytes_1, fixedDepthNums + (depth - 1) * finerSubdivideNum, LevelNodeCount, finerSubdivideNum, stream);
-            CHECKCUDA(cudaMallocAsync(&d_temp_storage_1, temp_storage_bytes_1, stream));
-            cub::DeviceReduce::Sum(d_temp_storage_1, temp_storage_bytes_1, fixedDepthNums + (depth - 1) * finerSubdivideNum, LevelNodeCount, finerSubdivideNum, stream);
-            CHECKCUDA(cudaMemcpyAsync(&depthNodeCount[depth], LevelNodeCount, sizeof(int), cudaMemcpyDeviceToHost, stream));
-            CHECKCUDA(cudaFreeAsync(d_temp_storage_1, stream));
-            CHECKCUDA(cudaFreeAsync(LevelNodeCount, stream));
-        }
-        //CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-        //for (int depth = 0; depth <= Constants::maxDepth_Host; depth++) {
-        //    printf("depth = %d   depthNodeCount[%d] = %d\n", i, depth, depthNodeCount[depth]);
-        //}
-
-        for (int depth = 0; depth <= Constants::maxDepth_Host; depth++) {
-            if (depth == 0) depthNodeAddress[depth] = 0;
-            else {
-                depthNodeAddress[depth] = depthNodeAddress[depth - 1] + depthNodeCount[depth - 1];
-            }
-        }
-
-        int* depthNodeAddress_Device = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&depthNodeAddress_Device), sizeof(int) * (Constants::maxDepth_Host + 1), stream));
-        CHECKCUDA(cudaMemcpyAsync(depthNodeAddress_Device, depthNodeAddress, sizeof(int) * (Constants::maxDepth_Host + 1), cudaMemcpyHostToDevice, stream));
-
-        int* fixedDepthAddress = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&fixedDepthAddress), sizeof(int) * finerSubdivideNum * Constants::maxDepth_Host, stream));
-        CHECKCUDA(cudaMemsetAsync(fixedDepthAddress, 0, sizeof(int) * finerSubdivideNum * Constants::maxDepth_Host, stream));
-        for (int depth = 1; depth <= Constants::maxDepth_Host; depth++) {
-            void* d_temp_storage = NULL;
-            size_t temp_storage_bytes = 0;
-            cub::DeviceScan::ExclusiveSum(d_temp_storage, temp_storage_bytes, fixedDepthNums + (depth - 1) * finerSubdivideNum, fixedDepthAddress + (depth - 1) * finerSubdivideNum, finerSubdivideNum, stream);
-            CHECKCUDA(cudaMallocAsync(&d_temp_storage, temp_storage_bytes, stream));
-            cub::DeviceScan::ExclusiveSum(d_temp_storage, temp_storage_bytes, fixedDepthNums + (depth - 1) * finerSubdivideNum, fixedDepthAddress + (depth - 1) * finerSubdivideNum, finerSubdivideNum, stream);
-            CHECKCUDA(cudaFreeAsync(d_temp_storage, stream));
-        }
-
-        //CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-        //std::vector<int> fixedDepthAddressTest;
-        //fixedDepthAddressTest.resize(finerSubdivideNum * Constants::maxDepth_Host);
-        //CHECKCUDA(cudaMemcpy(fixedDepthAddressTest.data(), fixedDepthAddress, sizeof(int) * finerSubdivideNum * Constants::maxDepth_Host, cudaMemcpyDeviceToHost));
-        //for (int j = 0; j < fixedDepthAddressTest.size(); j++) {
-        //    if (j % 1000 == 0) printf("depth = %d   fixedDepthAddress[%d] = %d\n", i, j, fixedDepthAddressTest[j]);
-        //}
-
-        CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步，获得rebuildNums
-
-        const unsigned int rebuildDLevelCount = rebuildNums - depthNodeAddress[Constants::maxDepth_Host];
-        //printf("Depth = %d  rebuildNums = %d  depthNodeCount[max] = %d\n", i, rebuildNums, depthNodeCount[Constants::maxDepth_Host]);
-
-        EasyOctNode* RebuildArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildArray), sizeof(EasyOctNode) * rebuildNums, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildArray, 0, sizeof(EasyOctNode) * rebuildNums, stream));
 
-        int* RebuildDepthBuffer = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildDepthBuffer), sizeof(int) * rebuildNums, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildDepthBuffer, 0, sizeof(int) * rebuildNums, stream));
+    // [finerDepth, maxDepth)层的细分节点在SubdivideNode中连续，所有深度放进同一个重建数组一起展开
+    const int finerDepthStart = SubdivideDepthAddress[finerDepth];
+    const int finerSubdivideNum = SubdivideNodeNumHost - finerDepthStart;
+    if (finerSubdivideNum <= 0) return;
+    const unsigned int fixedDepthSize = finerSubdivideNum * Constants::maxDepth_Host;
 
-        Point3D<float>* RebuildCenterBuffer = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildCenterBuffer), sizeof(Point3D<float>) * rebuildNums, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildCenterBuffer, 0, sizeof(Point3D<float>) * rebuildNums, stream));
+    int* fixedDepthNums = reserveSubdivideBuffer(SubdivideFixedDepthNums, fixedDepthSize);
+    int* fixedDepthAddress = reserveSubdivideBuffer(SubdivideFixedDepthAddress, fixedDepthSize);
+    CHECKCUDA(cudaMemsetAsync(fixedDepthNums, 0, sizeof(int) * fixedDepthSize, stream));
 
-        int* ReplaceNodeId = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&ReplaceNodeId), sizeof(int) * rebuildNums, stream));
-        CHECKCUDA(cudaMemsetAsync(ReplaceNodeId, 0, sizeof(int) * rebuildNums, stream));
-
-        int* IsRoot = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&IsRoot), sizeof(int) * rebuildNums, stream));
-        CHECKCUDA(cudaMemsetAsync(IsRoot, 0, sizeof(int) * rebuildNums, stream));
-
-        //printf("depth = %d   finerSubdivideNum = %d\n", i, finerSubdivideNum);
-        //printf("depth = %d   finerDepthStart = %d\n", i, finerDepthStart);
-        dim3 block_2(128);
-        dim3 grid_2(divUp(finerSubdivideNum, block_2.x));
-        device::wholeRebuildArray << <grid_2, block_2, 0, stream >> > (SubdivideNode.ArrayView(), finerDepthStart, finerSubdivideNum, NodeArraySize, SubdivideDepthBuffer.DeviceArray().ptr(), depthNodeAddress_Device, fixedDepthAddress, RebuildArray, RebuildDepthBuffer, RebuildCenterBuffer, ReplaceNodeId, IsRoot, NodeArray.Array().ptr());
-        
-        //CHECKCUDA(cudaStreamSynchronize(stream));
-        //std::vector<EasyOctNode> RebuildArrayTest;
-        //RebuildArrayTest.resize(rebuildNums);
-        //CHECKCUDA(cudaMemcpyAsync(RebuildArrayTest.data(), RebuildArray, sizeof(EasyOctNode) * rebuildNums, cudaMemcpyDeviceToHost, stream));
-        //for (int k = 0; k < RebuildArrayTest.size(); k++) {
-        //    if (i == finerDepth && k % 1000 == 0) printf("idx = %d    RebuildArray = %d\n", k, RebuildArrayTest[k].children[3]);
-        //}
-
-        for (int depth = finerDepth; depth <= Constants::maxDepth_Host; depth++) {
-            dim3 block(128);
-            dim3 grid(divUp(depthNodeCount[depth], block.x));
-            device::computeRebuildNeighbor << <grid, block, 0, stream >> > (NodeArray.ArrayView(), depthNodeAddress[depth], depthNodeCount[depth], NodeArraySize, depth, RebuildArray);
-        }
+    dim3 block_1(128);
+    dim3 grid_1(divUp(finerSubdivideNum, block_1.x));
+    device::initFixedDepthNums << <grid_1, block_1, 0, stream >> > (SubdivideNode.ArrayView(), SubdivideDepthBuffer.DeviceArrayReadOnly(), finerDepthStart, finerSubdivideNum, fixedDepthNums);
+
+    // fixedDepthNums按(深度, 节点)排布，一次整体前缀和即得到每个展开节点在重建数组中的全局位置，每层偏移与节点总数也就在其中
+    size_t scanTempBytes = 0;
+    CHECKCUDA(cub::DeviceScan::ExclusiveSum(NULL, scanTempBytes, fixedDepthNums, fixedDepthAddress, fixedDepthSize, stream));
+    CHECKCUDA(cub::DeviceScan::ExclusiveSum(reserveSubdivideTempStorage(scanTempBytes), scanTempBytes, fixedDepthNums, fixedDepthAddress, fixedDepthSize, stream));
+
+    int* rebuildDepthAddress = SubdivideCounter.Ptr();
+    device::extractRebuildDepthAddress << <1, 32, 0, stream >> > (fixedDepthNums, fixedDepthAddress, finerSubdivideNum, rebuildDepthAddress);
+    int rebuildDepthAddressHost[Constants::maxDepth_Host + 2] = { 0 };
+    CHECKCUDA(cudaMemcpyAsync(rebuildDepthAddressHost, rebuildDepthAddress, sizeof(int) * (Constants::maxDepth_Host + 2), cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步，获得每层偏移与rebuildNums
+
+    for (int depth = 0; depth <= Constants::maxDepth_Host; depth++) {
+        depthNodeAddress[depth] = rebuildDepthAddressHost[depth];
+        depthNodeCount[depth] = rebuildDepthAddressHost[depth + 1] - rebuildDepthAddressHost[depth];
+    }
+    const int rebuildNums = rebuildDepthAddressHost[Constants::maxDepth_Host + 1];
+    const unsigned int rebuildDLevelCount = depthNodeCount[Constants::maxDepth_Host];
+    //printf("rebuildNums = %d  depthNodeCount[max] = %d\n", rebuildNums, rebuildDLevelCount);
+
+    EasyOctNode* RebuildArray = reserveSubdivideBuffer(SubdivideRebuildArray, rebuildNums);
+    int* RebuildDepthBuffer = reserveSubdivideBuffer(SubdivideRebuildDepth, rebuildNums);
+    Point3D<float>* RebuildCenterBuffer = reserveSubdivideBuffer(SubdivideRebuildCenter, rebuildNums);
+    int* ReplaceNodeId = reserveSubdivideBuffer(SubdivideReplaceNodeId, rebuildNums);
+    int* IsRoot = reserveSubdivideBuffer(SubdivideIsRoot, rebuildNums);
+    CHECKCUDA(cudaMemsetAsync(RebuildArray, 0, sizeof(EasyOctNode) * rebuildNums, stream));
+    CHECKCUDA(cudaMemsetAsync(RebuildDepthBuffer, 0, sizeof(int) * rebuildNums, stream));
+    CHECKCUDA(cudaMemsetAsync(RebuildCenterBuffer, 0, sizeof(Point3D<float>) * rebuildNums, stream));
+    CHECKCUDA(cudaMemsetAsync(ReplaceNodeId, 0, sizeof(int) * rebuildNums, stream));
+    CHECKCUDA(cudaMemsetAsync(IsRoot, 0, sizeof(int) * rebuildNums, stream));
 
-        //CHECKCUDA(cudaStreamSynchronize(stream));
-        //std::vector<EasyOctNode> RebuildArrayTest;
-        //RebuildArrayTest.resize(rebuildNums);
-        //CHECKCUDA(cudaMemcpyAsync(RebuildArrayTest.data(), RebuildArray, sizeof(EasyOctNode) * rebuildNums, cudaMemcpyDeviceToHost, stream));
-        //for (int k = 0; k < RebuildArrayTest.size(); k++) {
-        //    if (i == finerDepth && k % 1000 == 0) printf("idx = %d    RebuildArray = %d\n", k, RebuildArrayTest[k].neighs[8]);
-        //}
+    dim3 block_2(128);
+    dim3 grid_2(divUp(finerSubdivideNum, block_2.x));
+    device::wholeRebuildArray << <grid_2, block_2, 0, stream >> > (SubdivideNode.ArrayView(), finerDepthStart, finerSubdivideNum, NodeArraySize, SubdivideDepthBuffer.DeviceArray().ptr(), fixedDepthAddress, RebuildArray, RebuildDepthBuffer, RebuildCenterBuffer, ReplaceNodeId, IsRoot, NodeArray.Array().ptr());
+
+    // 邻居依赖上一层，按层从浅到深各一次
+    for (int depth = finerDepth; depth <= Constants::maxDepth_Host; depth++) {
+        if (depthNodeCount[depth] == 0) continue;
+        dim3 block(128);
+        dim3 grid(divUp(depthNodeCount[depth], block.x));
+        device::computeRebuildNeighbor << <grid, block, 0, stream >> > (NodeArray.ArrayView(), depthNodeAddress[depth], depthNodeCount[depth], NodeArraySize, depth, RebuildArray);
+    }
 
-        VertexNode* RebuildPreVertexArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildPreVertexArray), sizeof(VertexNode) * rebuildDLevelCount * 8, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildPreVertexArray, 0, sizeof(VertexNode) * rebuildDLevelCount * 8, stream));
+    rebuildSubdivideMesh(NodeArray.ArrayView(), CenterBuffer, BaseFunction, dx, encodeNodeIndexInFunction, isoValue, RebuildArray, RebuildCenterBuffer, depthNodeAddress[Constants::maxDepth_Host], rebuildDLevelCount, -1, ReplaceNodeId, IsRoot, stream);
+}
 
-        markValidFinerVexArray.ResizeArrayOrException(rebuildDLevelCount * 8);
+void SparseSurfelFusion::ComputeTriangleIndices::rebuildSubdivideMesh(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, EasyOctNode* RebuildArray, const Point3D<float>* RebuildCenter, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const int rootId, const int* ReplaceNodeId, const int* IsRoot, cudaStream_t stream)
+{
+    if (DLevelNodeCount == 0) return;
+    const unsigned int NodeArraySize = NodeArray.Size();
+    const unsigned int maxVertexNum = 8 * DLevelNodeCount;
+    const unsigned int maxEdgeNum = 12 * DLevelNodeCount;
+    int* selectedCount = SubdivideCounter.Ptr();   // [0]顶点, [1]边, [2]有效边, [3]有效边的顶点偏移
+
+    /**************************************** 细分顶点与细分边：两次筛选，一次同步 ****************************************/
+    VertexNode* PreVertexArray = reserveSubdivideBuffer(SubdividePreVertexArray, maxVertexNum);
+    VertexNode* VertexArray = reserveSubdivideBuffer(SubdivideVertexArray, maxVertexNum);
+    bool* markValidVertex = reserveSubdivideBuffer(markValidSubdivideVertex, maxVertexNum);
+    EdgeNode* PreEdgeArray = reserveSubdivideBuffer(SubdividePreEdgeArray, maxEdgeNum);
+    EdgeNode* EdgeArray = reserveSubdivideBuffer(SubdivideEdgeArray, maxEdgeNum);
+    bool* markValidEdge = reserveSubdivideBuffer(markValidSubdivideEdge, maxEdgeNum);
+    CHECKCUDA(cudaMemsetAsync(PreVertexArray, 0, sizeof(VertexNode) * maxVertexNum, stream));
+    CHECKCUDA(cudaMemsetAsync(PreEdgeArray, 0, sizeof(EdgeNode) * maxEdgeNum, stream));
 
-        dim3 block_3(128);
-        dim3 grid_3(divUp(rebuildDLevelCount, block_3.x));
-        device::initSubdivideVertexOwner << <grid_3, block_3, 0, stream >> > (RebuildArray, RebuildCenterBuffer, depthNodeAddress[Constants::maxDepth_Host], rebuildDLevelCount, NodeArraySize, RebuildPreVertexArray, markValidFinerVexArray.Array().ptr());
-        
-        VertexNode* RebuildVertexArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildVertexArray), sizeof(VertexNode) * rebuildDLevelCount * 8, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildVertexArray, 0, sizeof(VertexNode) * rebuildDLevelCount * 8, stream));
-
-        int* RebuildVertexArraySize = NULL;
-        int RebuildVertexArraySizeHost = -1;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildVertexArraySize), sizeof(int), stream));
-
-        void* d_temp_storage_1 = NULL;    // 中间变量，用完即可释放
-        size_t temp_storage_bytes_1 = 0;  // 中间变量
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, RebuildPreVertexArray, markValidFinerVexArray.Array().ptr(), RebuildVertexArray, RebuildVertexArraySize, 8 * rebuildDLevelCount, stream, false));	// 确定临时设备存储需求
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_1, temp_storage_bytes_1, stream));
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, RebuildPreVertexArray, markValidFinerVexArray.Array().ptr(), RebuildVertexArray, RebuildVertexArraySize, 8 * rebuildDLevelCount, stream, false));	// 筛选	
-        CHECKCUDA(cudaMemcpyAsync(&RebuildVertexArraySizeHost, RebuildVertexArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-        CHECKCUDA(cudaFreeAsync(RebuildPreVertexArray, stream));   // 临时变量，即时删除
-        CHECKCUDA(cudaFreeAsync(RebuildVertexArraySize, stream));  // 临时变量，即时删除
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_1, stream));        // 临时变量，即时删除
-
-        CHECKCUDA(cudaStreamSynchronize(stream));                   // 获得RebuildVertexArraySizeHost
-        if (RebuildVertexArraySizeHost == 0) {                      // 细分顶点为0，则直接下一层【计算隐式函数值，顶点和边缺一不可】
-            CHECKCUDA(cudaFreeAsync(fixedDepthNums, stream));
-            CHECKCUDA(cudaFreeAsync(depthNodeAddress_Device, stream));
-            CHECKCUDA(cudaFreeAsync(fixedDepthAddress, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildArray, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildDepthBuffer, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildCenterBuffer, stream));
-            CHECKCUDA(cudaFreeAsync(ReplaceNodeId, stream));
-            CHECKCUDA(cudaFreeAsync(IsRoot, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildVertexArray, stream));
-            continue;
-        }
-        //printf("depth = %d  RebuildVertexArraySize = %d\n", i, RebuildVertexArraySizeHost);
-
-        dim3 block_4(128);
-        dim3 grid_4(divUp(RebuildVertexArraySizeHost, block_4.x));
-        device::maintainSubdivideVertexNodePointer << <grid_4, block_4, 0, stream >> > (CenterBuffer, RebuildVertexArraySizeHost, NodeArraySize, RebuildCenterBuffer, RebuildVertexArray, RebuildArray);
-
-        EdgeNode* RebuildPreEdgeArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildPreEdgeArray), sizeof(EdgeNode) * rebuildDLevelCount * 12, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildPreEdgeArray, 0, sizeof(EdgeNode) * rebuildDLevelCount * 12, stream));
-
-        markValidFinerEdge.ResizeArrayOrException(rebuildDLevelCount * 12);
-
-        dim3 block_5(128);
-        dim3 grid_5(divUp(rebuildDLevelCount, block_5.x));
-        device::initSubdivideEdgeArray << <grid_5, block_5, 0, stream >> > (RebuildArray, RebuildCenterBuffer, NodeArraySize, depthNodeAddress[Constants::maxDepth_Host], rebuildDLevelCount, RebuildPreEdgeArray, markValidFinerEdge.Array().ptr());
-
-        EdgeNode* RebuildEdgeArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildEdgeArray), sizeof(EdgeNode)* rebuildDLevelCount * 12, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildEdgeArray, 0, sizeof(EdgeNode)* rebuildDLevelCount * 12, stream));
-
-        int* RebuildEdgeArraySize = NULL;
-        int RebuildEdgeArraySizeHost = -1;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildEdgeArraySize), sizeof(int), stream));
-
-        void* d_temp_storage_2 = NULL;    // 中间变量，用完即可释放
-        size_t temp_storage_bytes_2 = 0;  // 中间变量
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, RebuildPreEdgeArray, markValidFinerEdge.Array().ptr(), RebuildEdgeArray, RebuildEdgeArraySize, 12 * rebuildDLevelCount, stream, false));	// 确定临时设备存储需求
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_2, temp_storage_bytes_2, stream));
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, RebuildPreEdgeArray, markValidFinerEdge.Array().ptr(), RebuildEdgeArray, RebuildEdgeArraySize, 12 * rebuildDLevelCount, stream, false));	// 筛选	
-        CHECKCUDA(cudaMemcpyAsync(&RebuildEdgeArraySizeHost, RebuildEdgeArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-        CHECKCUDA(cudaFreeAsync(RebuildPreEdgeArray, stream));      // 临时变量，即时删除
-        CHECKCUDA(cudaFreeAsync(RebuildEdgeArraySize, stream));     // 临时变量，即时删除
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_2, stream));         // 临时变量，即时删除
-
-        CHECKCUDA(cudaStreamSynchronize(stream));                   // 这里需要同步，获得RebuildEdgeArraySizeHost
-        if (RebuildEdgeArraySizeHost == 0) {                        // 细分边为0，则直接下一层【计算隐式函数值，顶点和边缺一不可】
-            CHECKCUDA(cudaFreeAsync(fixedDepthNums, stream));
-            CHECKCUDA(cudaFreeAsync(depthNodeAddress_Device, stream));
-            CHECKCUDA(cudaFreeAsync(fixedDepthAddress, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildArray, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildDepthBuffer, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildCenterBuffer, stream));
-            CHECKCUDA(cudaFreeAsync(ReplaceNodeId, stream));
-            CHECKCUDA(cudaFreeAsync(IsRoot, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildVertexArray, stream));
-            CHECKCUDA(cudaFreeAsync(RebuildEdgeArray, stream));
-            continue;
-        }
-        //printf("depth = %d  RebuildVertexArraySize = %d  RebuildEdgeArraySize = %d\n", i, RebuildVertexArraySizeHost, RebuildEdgeArraySizeHost);
-
-        dim3 block_6(128);
-        dim3 grid_6(divUp(RebuildEdgeArraySizeHost, block_6.x));
-        device::maintainSubdivideEdgeNodePointer << <grid_6, block_6, 0, stream >> > (CenterBuffer, RebuildCenterBuffer, RebuildEdgeArraySizeHost, NodeArraySize, RebuildArray, RebuildEdgeArray);
-
-        float* RebuildVvalue = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildVvalue), sizeof(float) * RebuildVertexArraySizeHost, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildVvalue, 0, sizeof(float) * RebuildVertexArraySizeHost, stream));
-
-        dim3 block_7(128);
-        dim3 grid_7(divUp(RebuildVertexArraySizeHost, block_7.x));
-        device::computeSubdivideVertexImplicitFunctionValue << <grid_7, block_7, 0, stream >> > (RebuildVertexArray, RebuildArray, NodeArray.ArrayView(), dx, encodeNodeIndexInFunction, BaseFunction, NodeArraySize, ReplaceNodeId, IsRoot, RebuildVertexArraySizeHost, isoValue, RebuildVvalue);
-
-        CHECKCUDA(cudaFreeAsync(ReplaceNodeId, stream));
-        CHECKCUDA(cudaFreeAsync(IsRoot, stream));
-
-        int* RebuildVexNums = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildVexNums), sizeof(int) * RebuildEdgeArraySizeHost, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildVexNums, 0, sizeof(int) * RebuildEdgeArraySizeHost, stream));
-
-        dim3 block_8(128);
-        dim3 grid_8(divUp(RebuildEdgeArraySizeHost, block_8.x));
-        device::generateSubdivideVexNums << <grid_8, block_8, 0, stream >> > (RebuildEdgeArray, RebuildArray, RebuildEdgeArraySizeHost, NodeArraySize, RebuildVvalue, RebuildVexNums, markValidFinerVexNum.Array().ptr());
-
-        int* RebuildVexAddress = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildVexAddress), sizeof(int) * RebuildEdgeArraySizeHost, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildVexAddress, 0, sizeof(int) * RebuildEdgeArraySizeHost, stream));
-
-        void* d_temp_storage_3 = NULL;
-        size_t temp_storage_bytes_3 = 0;
-        cub::DeviceScan::ExclusiveSum(d_temp_storage_3, temp_storage_bytes_3, RebuildVexNums, RebuildVexAddress, RebuildEdgeArraySizeHost, stream);
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_3, temp_storage_bytes_3, stream));
-        cub::DeviceScan::ExclusiveSum(d_temp_storage_3, temp_storage_bytes_3, RebuildVexNums, RebuildVexAddress, RebuildEdgeArraySizeHost, stream);
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_3, stream));
-
-        CHECKCUDA(cudaStreamSynchronize(stream));   // 需要同步
-        int RebuildLastVexAddr = -1;
-        int RebuildLastVexNums = -1;
-        CHECKCUDA(cudaMemcpyAsync(&RebuildLastVexAddr, RebuildVexAddress + RebuildEdgeArraySizeHost - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-        CHECKCUDA(cudaMemcpyAsync(&RebuildLastVexNums, RebuildVexNums + RebuildEdgeArraySizeHost - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-        int RebuildAllVexNums = RebuildLastVexAddr + RebuildLastVexNums;
-
-        CHECKCUDA(cudaStreamSynchronize(stream));   // 需要同步
-        //printf("depth = %d   RebuildAllVexNums = %d\n", i, RebuildAllVexNums);
-
-        int* RebuildTriNums = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildTriNums), sizeof(int) * rebuildDLevelCount, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildTriNums, 0, sizeof(int) * rebuildDLevelCount, stream));
-
-        int* RebuildCubeCatagory = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildCubeCatagory), sizeof(int) * rebuildDLevelCount, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildCubeCatagory, 0, sizeof(int) * rebuildDLevelCount, stream));
-
-        dim3 block_9(128);
-        dim3 grid_9(divUp(rebuildDLevelCount, block_9.x));
-        device::generateTriNums << <grid_9, block_9, 0, stream >> > (RebuildArray, depthNodeAddress[Constants::maxDepth_Host], rebuildDLevelCount, RebuildVvalue, RebuildTriNums, RebuildCubeCatagory);
-
-        int* RebuildTriAddress = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildTriAddress), sizeof(int)* rebuildDLevelCount, stream));
-        CHECKCUDA(cudaMemsetAsync(RebuildTriAddress, 0, sizeof(int)* rebuildDLevelCount, stream));
-
-        void* d_temp_storage_4 = NULL;
-        size_t temp_storage_bytes_4 = 0;
-        cub::DeviceScan::ExclusiveSum(d_temp_storage_4, temp_storage_bytes_4, RebuildTriNums, RebuildTriAddress, rebuildDLevelCount, stream);
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_4, temp_storage_bytes_4, stream));
-        cub::DeviceScan::ExclusiveSum(d_temp_storage_4, temp_storage_bytes_4, RebuildTriNums, RebuildTriAddress, rebuildDLevelCount, stream);
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_4, stream));
-
-        Point3D<float>* RebuildVertexBuffer = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildVertexBuffer), sizeof(Point3D<float>)* RebuildAllVexNums, stream));
-        //std::vector<Point3D<float>> RebuildVertexBufferHost;
-        //RebuildVertexBufferHost.resize(RebuildAllVexNums);
-
-        EdgeNode* RebuildValidEdgeArray = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildValidEdgeArray), sizeof(EdgeNode)* RebuildAllVexNums, stream));
-
-        int* RebuildValidEdgeArraySize = NULL;
-        int RebuildValidEdgeArraySizeHost = -1;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildValidEdgeArraySize), sizeof(int), stream));
-
-        void* d_temp_storage_5 = NULL;    // 中间变量，用完即可释放
-        size_t temp_storage_bytes_5 = 0;  // 中间变量
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_5, temp_storage_bytes_5, RebuildEdgeArray, markValidFinerVexNum.Array().ptr(), RebuildValidEdgeArray, RebuildValidEdgeArraySize, RebuildEdgeArraySizeHost, stream, false));	// 确定临时设备存储需求
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_5, temp_storage_bytes_5, stream));
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_5, temp_storage_bytes_5, RebuildEdgeArray, markValidFinerVexNum.Array().ptr(), RebuildValidEdgeArray, RebuildValidEdgeArraySize, RebuildEdgeArraySizeHost, stream, false));	// 筛选	
-        CHECKCUDA(cudaMemcpyAsync(&RebuildValidEdgeArraySizeHost, RebuildValidEdgeArraySize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_5, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildValidEdgeArraySize, stream));
-
-        int* RebuildValidVexAddress = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildValidVexAddress), sizeof(int)* RebuildAllVexNums, stream));
-
-        int* RebuildValidVexAddressSize = NULL;
-        int RebuildValidVexAddressSizeHost = -1;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildValidVexAddressSize), sizeof(int), stream));
-
-        void* d_temp_storage_6 = NULL;    // 中间变量，用完即可释放
-        size_t temp_storage_bytes_6 = 0;  // 中间变量
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_6, temp_storage_bytes_6, RebuildVexAddress, markValidFinerVexNum.Array().ptr(), RebuildValidVexAddress, RebuildValidVexAddressSize, RebuildEdgeArraySizeHost, stream, false));	// 确定临时设备存储需求
-        CHECKCUDA(cudaMallocAsync(&d_temp_storage_6, temp_storage_bytes_6, stream));
-        CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_6, temp_storage_bytes_6, RebuildVexAddress, markValidFinerVexNum.Array().ptr(), RebuildValidVexAddress, RebuildValidVexAddressSize, RebuildEdgeArraySizeHost, stream, false));	// 筛选	
-        CHECKCUDA(cudaMemcpyAsync(&RebuildValidVexAddressSizeHost, RebuildValidVexAddressSize, sizeof(int), cudaMemcpyDeviceToHost, stream));
-
-        CHECKCUDA(cudaFreeAsync(d_temp_storage_6, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildValidVexAddressSize, stream));
-
-        dim3 block_10(128);
-        dim3 grid_10(divUp(RebuildAllVexNums, block_10.x));
-        device::generateSubdivideIntersectionPoint << <grid_10, block_10, 0, stream >> > (RebuildValidEdgeArray, RebuildVertexArray, RebuildArray, RebuildValidVexAddress, RebuildVvalue, RebuildAllVexNums, NodeArraySize, RebuildVertexBuffer);
-
-        CHECKCUDA(cudaFreeAsync(RebuildValidEdgeArray, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildValidVexAddress, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildVvalue, stream));
-
-        int RebuildLastTriAddr = -1;
-        int RebuildLastTriNums = -1;
-
-        CHECKCUDA(cudaMemcpyAsync(&RebuildLastTriAddr, RebuildTriAddress + rebuildDLevelCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-        CHECKCUDA(cudaMemcpyAsync(&RebuildLastTriNums, RebuildTriNums + rebuildDLevelCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
-    
-        CHECKCUDA(cudaStreamSynchronize(stream));
-        int RebuildAllTriNums = RebuildLastTriAddr + RebuildLastTriNums;
-
-        CHECKCUDA(cudaFreeAsync(RebuildVexNums, stream));
-
-        //printf("RebuildAllTriNums = %d\n", RebuildAllTriNums);
-
-        TriangleIndex* RebuildTriangleBuffer = NULL;
-        CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RebuildTriangleBuffer), sizeof(TriangleIndex) * RebuildAllTriNums, stream));
-        //std::vector<int> RebuildTriangleBufferHost;
-        //RebuildTriangleBufferHost.resize(RebuildAllTriNums * 3);
-
-        CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-        //printf("###############################   Depth = %d   #################################\n", i);
-        dim3 block_11(128);
-        dim3 grid_11(divUp(rebuildDLevelCount, block_11.x));
-        device::generateSubdivideTrianglePos << <grid_11, block_11, 0, stream >> > (RebuildArray, depthNodeAddress[Constants::maxDepth_Host], rebuildDLevelCount, RebuildTriNums, RebuildCubeCatagory, RebuildVexAddress, RebuildTriAddress, RebuildTriangleBuffer);
-        insertTriangle(RebuildVertexBuffer, RebuildAllVexNums, RebuildTriangleBuffer, RebuildAllTriNums, stream);
-
-        //CHECKCUDA(cudaMemcpyAsync(RebuildVertexBufferHost.data(), RebuildVertexBuffer, sizeof(Point3D<float>) * RebuildAllVexNums, cudaMemcpyDeviceToHost, stream));
-        //CHECKCUDA(cudaMemcpyAsync(RebuildTriangleBufferHost.data(), RebuildTriangleBuffer, sizeof(int) * 3 * RebuildAllTriNums, cudaMemcpyDeviceToHost, stream));
-
-        //CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
-
-        //insertTriangle(RebuildVertexBufferHost.data(), RebuildAllVexNums, RebuildTriangleBufferHost.data(), RebuildAllTriNums, mesh);
-
-        CHECKCUDA(cudaFreeAsync(fixedDepthNums, stream));
-        CHECKCUDA(cudaFreeAsync(depthNodeAddress_Device, stream));
-        CHECKCUDA(cudaFreeAsync(fixedDepthAddress, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildArray, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildDepthBuffer, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildCenterBuffer, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildVertexArray, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildEdgeArray, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildVexAddress, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildTriNums, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildCubeCatagory, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildTriAddress, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildVertexBuffer, stream));
-        CHECKCUDA(cudaFreeAsync(RebuildTriangleBuffer, stream));
+    dim3 block(128);
+    dim3 grid(divUp(DLevelNodeCount, block.x));
+    device::initSubdivideVertexOwner << <grid, block, 0, stream >> > (RebuildArray, RebuildCenter, DLevelOffset, DLevelNodeCount, NodeArraySize, PreVertexArray, markValidVertex);
+    device::initSubdivideEdgeArray << <grid, block, 0, stream >> > (RebuildArray, RebuildCenter, NodeArraySize, DLevelOffset, DLevelNodeCount, PreEdgeArray, markValidEdge);
+
+    size_t vertexTempBytes = 0;
+    size_t edgeTempBytes = 0;
+    CHECKCUDA(cub::DeviceSelect::Flagged(NULL, vertexTempBytes, PreVertexArray, markValidVertex, VertexArray, selectedCount, maxVertexNum, stream, false));	// 确定临时设备存储需求
+    CHECKCUDA(cub::DeviceSelect::Flagged(NULL, edgeTempBytes, PreEdgeArray, markValidEdge, EdgeArray, selectedCount + 1, maxEdgeNum, stream, false));
+    void* tempStorage = reserveSubdivideTempStorage(std::max(vertexTempBytes, edgeTempBytes));
+    CHECKCUDA(cub::DeviceSelect::Flagged(tempStorage, vertexTempBytes, PreVertexArray, markValidVertex, VertexArray, selectedCount, maxVertexNum, stream, false));	// 筛选
+    CHECKCUDA(cub::DeviceSelect::Flagged(tempStorage, edgeTempBytes, PreEdgeArray, markValidEdge, EdgeArray, selectedCount + 1, maxEdgeNum, stream, false));
+
+    int selectedCountHost[2] = { 0 };
+    CHECKCUDA(cudaMemcpyAsync(selectedCountHost, selectedCount, sizeof(int) * 2, cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaStreamSynchronize(stream));       // 同步流，获得细分顶点与细分边的数量
+    const int VertexArraySize = selectedCountHost[0];
+    const int EdgeArraySize = selectedCountHost[1];
+    if (VertexArraySize == 0 || EdgeArraySize == 0) return;    // 【求隐式表面，顶点和边缺一不可】
+
+    dim3 grid_vertex(divUp(VertexArraySize, block.x));
+    device::maintainSubdivideVertexNodePointer << <grid_vertex, block, 0, stream >> > (CenterBuffer, VertexArraySize, NodeArraySize, RebuildCenter, VertexArray, RebuildArray);
+    dim3 grid_edge(divUp(EdgeArraySize, block.x));
+    device::maintainSubdivideEdgeNodePointer << <grid_edge, block, 0, stream >> > (CenterBuffer, RebuildCenter, EdgeArraySize, NodeArraySize, RebuildArray, EdgeArray);
+
+    /**************************************** 隐式函数值、交点与三角形的数量和偏移：一次同步 ****************************************/
+    float* Vvalue = reserveSubdivideBuffer(SubdivideVvalue, VertexArraySize);
+    if (ReplaceNodeId == NULL) {
+        device::computeSubdivideVertexImplicitFunctionValue << <grid_vertex, block, 0, stream >> > (VertexArray, RebuildArray, NodeArray, dx, encodeNodeIndexInFunction, BaseFunction, BaseFunctionValueTable.Ptr(), NodeArraySize, rootId, VertexArraySize, isoValue, Vvalue);
+    }
+    else {
+        device::computeSubdivideVertexImplicitFunctionValue << <grid_vertex, block, 0, stream >> > (VertexArray, RebuildArray, NodeArray, dx, encodeNodeIndexInFunction, BaseFunction, BaseFunctionValueTable.Ptr(), NodeArraySize, ReplaceNodeId, IsRoot, VertexArraySize, isoValue, Vvalue);
     }
+
+    int* VexNums = reserveSubdivideBuffer(SubdivideVexNums, EdgeArraySize);
+    int* VexAddress = reserveSubdivideBuffer(SubdivideVexAddress, EdgeArraySize);
+    bool* markValidVexNum = reserveSubdivideBuffer(markValidSubdivedeVexNum, EdgeArraySize);
+    EdgeNode* ValidEdgeArray = reserveSubdivideBuffer(SubdivideValidEdgeArray, EdgeArraySize);
+    int* ValidVexAddress = reserveSubdivideBuffer(SubdivideValidVexAddress, EdgeArraySize);
+    CHECKCUDA(cudaMemsetAsync(VexNums, 0, sizeof(int) * EdgeArraySize, stream));
+    device::generateSubdivideVexNums << <grid_edge, block, 0, stream >> > (EdgeArray, RebuildArray, EdgeArraySize, NodeArraySize, Vvalue, VexNums, markValidVexNum);
+
+    int* TriNums = reserveSubdivideBuffer(SubdivideTriNums, DLevelNodeCount);
+    int* TriAddress = reserveSubdivideBuffer(SubdivideTriAddress, DLevelNodeCount);
+    int* CubeCatagory = reserveSubdivideBuffer(SubdivideCubeCatagory, DLevelNodeCount);
+    device::generateTriNums << <grid, block, 0, stream >> > (RebuildArray, DLevelOffset, DLevelNodeCount, Vvalue, TriNums, CubeCatagory);
+
+    size_t tempBytes[4] = { 0 };
+    CHECKCUDA(cub::DeviceScan::ExclusiveSum(NULL, tempBytes[0], VexNums, VexAddress, EdgeArraySize, stream));
+    CHECKCUDA(cub::DeviceScan::ExclusiveSum(NULL, tempBytes[1], TriNums, TriAddress, DLevelNodeCount, stream));
+    CHECKCUDA(cub::DeviceSelect::Flagged(NULL, tempBytes[2], EdgeArray, markValidVexNum, ValidEdgeArray, selectedCount + 2, EdgeArraySize, stream, false));
+    CHECKCUDA(cub::DeviceSelect::Flagged(NULL, tempBytes[3], VexAddress, markValidVexNum, ValidVexAddress, selectedCount + 3, EdgeArraySize, stream, false));
+    tempStorage = reserveSubdivideTempStorage(*std::max_element(tempBytes, tempBytes + 4));
+    CHECKCUDA(cub::DeviceScan::ExclusiveSum(tempStorage, tempBytes[0], VexNums, VexAddress, EdgeArraySize, stream));
+    CHECKCUDA(cub::DeviceScan::ExclusiveSum(tempStorage, tempBytes[1], TriNums, TriAddress, DLevelNodeCount, stream));
+    CHECKCUDA(cub::DeviceSelect::Flagged(tempStorage, tempBytes[2], EdgeArray, markValidVexNum, ValidEdgeArray, selectedCount + 2, EdgeArraySize, stream, false));
+    CHECKCUDA(cub::DeviceSelect::Flagged(tempStorage, tempBytes[3], VexAddress, markValidVexNum, ValidVexAddress, selectedCount + 3, EdgeArraySize, stream, false));
+
+    // 排他前缀和的最后一个元素加上最后一个数量即为总数
+    int lastElement[4] = { 0 };     // 顶点偏移、顶点数量、三角形偏移、三角形数量
+    CHECKCUDA(cudaMemcpyAsync(&lastElement[0], VexAddress + EdgeArraySize - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaMemcpyAsync(&lastElement[1], VexNums + EdgeArraySize - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaMemcpyAsync(&lastElement[2], TriAddress + DLevelNodeCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaMemcpyAsync(&lastElement[3], TriNums + DLevelNodeCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
+    CHECKCUDA(cudaStreamSynchronize(stream));   // 流同步
+    const int AllVexNums = lastElement[0] + lastElement[1];
+    const int AllTriNums = lastElement[2] + lastElement[3];
+    //printf("AllVexNums = %d   AllTriNums = %d\n", AllVexNums, AllTriNums);
+    if (AllVexNums == 0 || AllTriNums == 0) return;
+
+    /**************************************** 生成细分交点与三角形并插入网格 ****************************************/
+    Point3D<float>* VertexBuffer = reserveSubdivideBuffer(SubdivideVertexBuffer, AllVexNums);
+    unsigned long long* VertexKeyBuffer = reserveSubdivideBuffer(SubdivideVertexKeyBuffer, AllVexNums);
+    TriangleIndex* TriangleBuffer = reserveSubdivideBuffer(SubdivideTriangleBuffer, AllTriNums);
+
+    dim3 grid_vex(divUp(AllVexNums, block.x));
+    device::generateSubdivideIntersectionPoint << <grid_vex, block, 0, stream >> > (ValidEdgeArray, VertexArray, RebuildArray, ValidVexAddress, Vvalue, AllVexNums, NodeArraySize, VertexBuffer, VertexKeyBuffer);
+    device::generateSubdivideTrianglePos << <grid, block, 0, stream >> > (RebuildArray, DLevelOffset, DLevelNodeCount, TriNums, CubeCatagory, VexAddress, TriAddress, TriangleBuffer);
+
+    insertTriangle(VertexBuffer, AllVexNums, TriangleBuffer, AllTriNums, VertexKeyBuffer, stream);
 }
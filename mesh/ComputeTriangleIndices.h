@@ -6,6 +6,9 @@
  * \date   June 3rd 2024
  *********************************************************************/
 #pragma once
+#include <mutex>
+#include <vector>
+#include <functional>
 #include <base/Constants.h>
 #include <base/DeviceReadWrite/SynchronizeArray.h>
 #include <base/DeviceReadWrite/DeviceBufferArray.h>
@@ -13,56 +16,116 @@
 
 #include "ConfirmedPPolynomial.h"
 #include "OctNode.cuh"
+#include "ReconstructionConfig.h"
+#include "StageProfiler.h"
+#include "MeshOutputSink.h"
+#include "MeshSimplification.h"
+
+#define BASE_FUNCTION_TABLE_RES ((1 << MAX_DEPTH_OCTREE) + 1)	// 基函数值表每个函数的采样数：maxDepth网格上[0, 1]的所有格点
+#define MAX_CUBE_TRIANGLE_NUM 5									// Marching Cubes中一个立方体最多生成的三角形数量
+#define PREVIEW_MESH_DEFAULT_DEPTH 5							// 预览网格默认提取的层
+#define MAX_PREVIEW_TRIANGLE_COUNT (1 << 18)					// 预览网格三角形容量，超出的三角形丢弃
+#define PREVIEW_ISO_SAMPLE_COUNT (1 << 14)						// 预览等值估计最多使用的采样点数量
+#define MAX_MESH_ROI_COUNT 8									// 等值面提取最多同时指定的感兴趣区域数量
 
 namespace SparseSurfelFusion {
+	/**
+	 * \brief 等值面提取的感兴趣区域(归一化坐标下的轴对齐包围盒)，按值传入核函数.
+	 *        count为0表示不裁剪，提取整个表面.
+	 */
+	struct MeshRegionsOfInterest {
+		int count = 0;									// 区域数量
+		float3 minPoint[MAX_MESH_ROI_COUNT];			// 每个区域的最小点
+		float3 maxPoint[MAX_MESH_ROI_COUNT];			// 每个区域的最大点
+
+		/**
+		 * \brief pos是否落在某个区域向外扩展margin(各维度)后的包围盒内.
+		 */
+		__device__ __forceinline__ bool Contains(const Point3D<float>& pos, const float margin) const {
+			for (int i = 0; i < count; i++) {
+				if (minPoint[i].x - margin <= pos.coords[0] && pos.coords[0] <= maxPoint[i].x + margin &&
+					minPoint[i].y - margin <= pos.coords[1] && pos.coords[1] <= maxPoint[i].y + margin &&
+					minPoint[i].z - margin <= pos.coords[2] && pos.coords[2] <= maxPoint[i].z + margin) return true;
+			}
+			return false;
+		}
+	};
 	namespace device {
+		/**
+		 * \brief 预计算每个基函数在maxDepth网格格点上的值：table[f * BASE_FUNCTION_TABLE_RES + i] = value(BaseFunctions[f], i / 2^maxDepth).
+		 *
+		 * \param BaseFunctions 基函数
+		 * \param tableSize 表的大小
+		 * \param BaseFunctionValueTable 【输出】基函数值表
+		 */
+		__global__ void buildBaseFunctionValueTableKernel(DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const unsigned int tableSize, float* BaseFunctionValueTable);
+
+		/**
+		 * \brief 顶点坐标是否落在maxDepth网格格点上，是则输出格点坐标.
+		 */
+		__device__ __forceinline__ bool vertexGridCoordinate(const Point3D<float>& pos, int3& gridCoord);
+
+		/**
+		 * \brief 计算节点三个维度基函数乘积在顶点处的值：格点上查表，否则逐段求多项式.
+		 */
+		__device__ __forceinline__ float baseFunctionProductValue(const float* BaseFunctionValueTable, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const EncodedFunctionIndex encodeIdx, const Point3D<float>& pos, const bool onGrid, const int3& gridCoord);
+
 		/**
 		 * \brief 计算顶点vertex隐式函数核函数.
 		 * 
 		 * \param VertexArray 顶点数组
-		 * \param NodeArray 节点数组
+		 * \param NodeTopology 节点拓扑(SoA)视图
 		 * \param BaseFunctions 基函数
 		 * \param dx 散度
 		 * \param encodeNodeIndexInFunction 基函数索引
+		 * \param BaseFunctionValueTable 基函数值表
 		 * \param isoValue 等值
+		 * \param regions 感兴趣区域，顶点不在任何区域扩展一个本层节点宽后的范围内时不求值，写入NaN
 		 * \param vvalue 顶点隐函数值
 		 */
-		__global__ void ComputeVertexImplicitFunctionValueKernel(DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, const unsigned int VertexArraySize, const float isoValue, float* vvalue);
+		__global__ void ComputeVertexImplicitFunctionValueKernel(DeviceArrayView<VertexNode> VertexArray, OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float* BaseFunctionValueTable, const unsigned int VertexArraySize, const float isoValue, const MeshRegionsOfInterest regions, float* vvalue);
 	
 		/**
-		 * \brief 生成顶点的vertexNums和顶点的vertexAddress的核函数.
+		 * \brief 线程束聚合的原子预留：线程束内前缀和后只由最后一个线程执行一次atomicAdd.
+		 *        线程束内32个线程必须全部参与调用(越界线程传入count = 0，不能提前返回).
 		 *
-		 * \param EdgeArray 边数组
-		 * \param NodeArray 节点数组
-		 * \param vvalue 顶点隐式函数值
-		 * \param vexNums 辅助计算节点位置VertexAddress
+		 * \param counter 全局计数器
+		 * \param count 当前线程需要预留的数量
+		 * \return 当前线程预留区间的起始位置
 		 */
-		__global__ void generateVertexNumsKernel(DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> vvalue, const unsigned int EdgeArraySize, int* vexNums, bool* markValidVertex);
+		__device__ __forceinline__ int warpAggregatedReserve(int* counter, const int count);
 
 		/**
-		 * \brief 生成TriangleNums以及cubeCatagory核函数.
-		 * 
+		 * \brief 单趟生成等值面顶点：边两端隐式函数值异号则预留顶点位置，插值后直接写入网格顶点数组，并记录边到顶点的映射.
+		 *
+		 * \param EdgeArray 边数组
 		 * \param NodeArray 节点数组
+		 * \param VertexArray 顶点数组
 		 * \param vvalue 顶点隐式函数值
-		 * \param DLevelOffset 第maxDepth层的首节点在NodeArray中偏移
-		 * \param DLevelNodeCount 第maxDepth层节点数量
-		 * \param triNums 三角形数量
-		 * \param cubeCatagory 立方体类型
+		 * \param EdgeArraySize 边的数量
+		 * \param vertexCapacity 网格顶点数组的容量
+		 * \param meshElementCount 【输出】[0]为已生成的顶点数量，[1]为已生成的三角形数量
+		 * \param vexAddress 【输出】边对应的网格顶点index，无顶点(或超出容量)为-1
+		 * \param MeshVertex 【输出】网格顶点
+		 * \param MeshVertexKey 【输出】网格顶点所在边的编码，用于焊接顶点
 		 */
-		__global__ void generateTriangleNumsKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> vvalue, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, int* triNums, int* cubeCatagory);
+		__global__ void generateIsoVerticesKernel(DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<float> vvalue, const unsigned int EdgeArraySize, const unsigned int vertexCapacity, int* meshElementCount, int* vexAddress, Point3D<float>* MeshVertex, unsigned long long* MeshVertexKey);
 
 		/**
-		 * \brief 生成交叉点.
-		 * 
+		 * \brief 单趟生成maxDepth层的三角形：计算立方体类型，预留三角形位置后直接写入网格索引数组，并标记与等值面相交的面.
+		 *
 		 * \param NodeArray 节点数组
-		 * \param validEdgeArray 筛选后有效的边数组
-		 * \param VertexArray 顶点数组
+		 * \param FaceArray 面数组
 		 * \param vvalue 顶点隐式函数值
-		 * \param validVexAddress 有效顶点的位置
-		 * \param validEdgeArraySize 有效边数组的大小
-		 * \param VertexBuffer 有效的顶点
+		 * \param vexAddress 边对应的网格顶点index
+		 * \param DLevelOffset 第maxDepth层的首节点在NodeArray中偏移
+		 * \param DLevelNodeCount 第maxDepth层节点数量
+		 * \param triangleCapacity 网格索引数组的容量
+		 * \param meshElementCount 【输出】[0]为已生成的顶点数量，[1]为已生成的三角形数量
+		 * \param MeshTriangle 【输出】网格三角形索引
+		 * \param hasSurfaceIntersection 【输出】面是否与等值面相交
 		 */
-		__global__ void generateIntersectionPoint(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<float> vvalue, const EdgeNode* validEdgeArray, const int* validVexAddress, const unsigned int validEdgeArraySize, Point3D<float>* VertexBuffer);
+		__global__ void generateIsoTrianglesKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<FaceNode> FaceArray, DeviceArrayView<float> vvalue, const int* vexAddress, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const unsigned int triangleCapacity, int* meshElementCount, TriangleIndex* MeshTriangle, int* hasSurfaceIntersection);
 		
 		/**
 		 * \brief 计算两点之间的插入点.
@@ -77,20 +140,14 @@ namespace SparseSurfelFusion {
 		__device__ void interpolatePoint(const Point3D<float>& p1, const Point3D<float>& p2, const int& dim, const float& v1, const float& v2, Point3D<float>& out);
 
 		/**
-		 * \brief 生成三角形位置以及构造面是否相交的数组.
-		 * 
-		 * \param NodeArray 节点数组
-		 * \param FaceArray 面数组
-		 * \param DLevelOffset 第maxDepth层的首节点在NodeArray中偏移
-		 * \param DLevelNodeCount 第maxDepth层节点数量
-		 * \param triNums 三角形数量
-		 * \param cubeCatagory 立方体类型
-		 * \param vexAddress 顶点偏移地址
-		 * \param triAddress 三角形偏移地址
-		 * \param TriangleBuffer 记录所构成的三角形
+		 * \brief 以边的中点编码一条八叉树边：深度d的边中点在边方向上是2^-(d+1)的奇数倍、另两维是2^-d的整数倍，
+		 *        因此以2^-(maxDepth+1)为单位量化的中点唯一对应(深度, 方向, 位置)，maxDepth层网格与细分网格共享的边编码相同.
+		 *
+		 * \param p1 边的端点1
+		 * \param p2 边的端点2
+		 * \return 边的编码，每维21位
 		 */
-		__global__ void generateTrianglePos(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<FaceNode> FaceArray, DeviceArrayView<int> triNums, DeviceArrayView<int> cubeCatagory, DeviceArrayView<int> vexAddress, DeviceArrayView<int> triAddress, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, TriangleIndex* TriangleBuffer, int* hasSurfaceIntersection);
-
+		__device__ unsigned long long encodeEdgeKey(const Point3D<float>& p1, const Point3D<float>& p2);
 		/**
 		 * \brief 获得细分三角形位置.
 		 */
@@ -115,9 +172,9 @@ namespace SparseSurfelFusion {
 		 * \param DepthBuffer 记录NodeArray深度节点的数组
 		 * \param SubdivideNum 细分节点的数量
 		 * \param SubdivideDepthBuffer 记录细分节点所在深度数组
-		 * \param SubdivideDepthNum 记录当前深度细分节点的总数
+		 * \param SubdivideDepthCount 【输出】每一层细分节点的数量，共maxDepth + 1个，需预先置0(块内共享内存直方图后再累加)
 		 */
-		__global__ void precomputeSubdivideDepth(DeviceArrayView<OctNode> SubdivideNode, DeviceArrayView<unsigned int> DepthBuffer, const int SubdivideNum, int* SubdivideDepthBuffer, int* SubdivideDepthNum);
+		__global__ void precomputeSubdivideDepth(DeviceArrayView<OctNode> SubdivideNode, DeviceArrayView<unsigned int> DepthBuffer, const int SubdivideNum, int* SubdivideDepthBuffer, int* SubdivideDepthCount);
 	
 		/**
 		 * \brief 重构NodeArray，记录在SubdivideArray中.
@@ -148,7 +205,7 @@ namespace SparseSurfelFusion {
 		 * \param currentDepth 当前深度
 		 * \param center 【输出】当前节点的中心点
 		 */
-		__device__ void getNodeCenterAllDepth(const int& key, const int& currentDepth, Point3D<float>& center);
+		__device__ void getNodeCenterAllDepth(const OctKey& key, const int& currentDepth, Point3D<float>& center);
 
 		/**
 		 * \brief 计算重构的节点邻居.
@@ -229,18 +286,19 @@ namespace SparseSurfelFusion {
 		 * \param dx
 		 * \param EncodedNodeIdxInFunction
 		 * \param baseFunctions
+		 * \param BaseFunctionValueTable 基函数值表
 		 * \param NodeArraySize
 		 * \param rootId
 		 * \param SubdivideVertexArraySize
 		 * \param isoValue
 		 * \param SubdivideVvalue 
 		 */
-		__global__ void computeSubdivideVertexImplicitFunctionValue(const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> dx, DeviceArrayView<int> EncodedNodeIdxInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions, const unsigned int NodeArraySize, const unsigned int rootId, const unsigned int SubdivideVertexArraySize, const float isoValue, float* SubdivideVvalue);
+		__global__ void computeSubdivideVertexImplicitFunctionValue(const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> EncodedNodeIdxInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions, const float* BaseFunctionValueTable, const unsigned int NodeArraySize, const unsigned int rootId, const unsigned int SubdivideVertexArraySize, const float isoValue, float* SubdivideVvalue);
 
 		/**
 		 * \brief 计算细分顶点的隐式函数值【Finer】.
 		 */
-		__global__ void computeSubdivideVertexImplicitFunctionValue(const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> dx, DeviceArrayView<int> EncodedNodeIdxInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions, const unsigned int NodeArraySize, const int* ReplacedNodeId, const int* IsRoot, const unsigned int SubdivideVertexArraySize, const float isoValue, float* SubdivideVvalue);
+		__global__ void computeSubdivideVertexImplicitFunctionValue(const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> EncodedNodeIdxInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions, const float* BaseFunctionValueTable, const unsigned int NodeArraySize, const int* ReplacedNodeId, const int* IsRoot, const unsigned int SubdivideVertexArraySize, const float isoValue, float* SubdivideVvalue);
 			 
 			 
 			 
@@ -275,7 +333,7 @@ namespace SparseSurfelFusion {
 		/**
 		 * \brief 生成细分的相交点.
 		 */
-		__global__ void generateSubdivideIntersectionPoint(const EdgeNode* SubdivideValidEdgeArray, const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, const int* SubdivideValidVexAddress, const float* SubdivideVvalue, const unsigned int SubdivideValidEdgeArraySize, const unsigned int NodeArraySize, Point3D<float>* SubdivideVertexBuffer);
+		__global__ void generateSubdivideIntersectionPoint(const EdgeNode* SubdivideValidEdgeArray, const VertexNode* SubdivideVertexArray, const EasyOctNode* SubdivideArray, const int* SubdivideValidVexAddress, const float* SubdivideVvalue, const unsigned int SubdivideValidEdgeArraySize, const unsigned int NodeArraySize, Point3D<float>* SubdivideVertexBuffer, unsigned long long* SubdivideVertexKeyBuffer);
 	
 		/**
 		 * \brief 初始化固定每层的节点数量.
@@ -283,9 +341,21 @@ namespace SparseSurfelFusion {
 		__global__ void initFixedDepthNums(DeviceArrayView<OctNode> SubdivideNode, DeviceArrayView<int> SubdivideDepthBuffer, const unsigned int DepthOffset, const unsigned int DepthNodeCount, int* fixedDepthNums);
 
 		/**
-		 * \brief 重建整个数组.
+		 * \brief 由(深度, 细分节点)排布的节点数量及其整体排他前缀和，取出重建数组中每层的偏移以及节点总数.
+		 *
+		 * \param fixedDepthNums 每个细分节点在每层展开的节点数量，下标为(depth - 1) * finerSubdivideNum + idx
+		 * \param fixedDepthAddress fixedDepthNums的整体排他前缀和
+		 * \param finerSubdivideNum 细分节点数量
+		 * \param depthNodeAddress 【输出】[0, maxDepth]层在重建数组中的偏移，第maxDepth + 1个元素为重建节点总数
 		 */
-		__global__ void wholeRebuildArray(DeviceArrayView<OctNode> SubdivideNode, const unsigned int finerDepthStart, const unsigned int finerSubdivideNum, const unsigned int NodeArraySize, const int* SubdivideDepthBuffer, const int* depthNodeAddress_Device, const int* fixedDepthAddress, EasyOctNode* RebuildArray, int* RebuildDepthBuffer, Point3D<float>* RebuildCenterBuffer, int* ReplaceNodeId, int* IsRoot, OctNode* NodeArray);
+		__global__ void extractRebuildDepthAddress(const int* fixedDepthNums, const int* fixedDepthAddress, const unsigned int finerSubdivideNum, int* depthNodeAddress);
+
+		/**
+		 * \brief 重建整个数组，不同深度的细分节点在同一个重建数组中一起展开.
+		 *
+		 * \param fixedDepthAddress fixedDepthNums的整体排他前缀和，即展开节点在重建数组中的全局位置
+		 */
+		__global__ void wholeRebuildArray(DeviceArrayView<OctNode> SubdivideNode, const unsigned int finerDepthStart, const unsigned int finerSubdivideNum, const unsigned int NodeArraySize, const int* SubdivideDepthBuffer, const int* fixedDepthAddress, EasyOctNode* RebuildArray, int* RebuildDepthBuffer, Point3D<float>* RebuildCenterBuffer, int* ReplaceNodeId, int* IsRoot, OctNode* NodeArray);
 
 		/**
 		 * \brief 获得有效的网格顶点.
@@ -296,11 +366,119 @@ namespace SparseSurfelFusion {
 		 * \brief 获得有效的三角面元索引.
 		 */
 		__global__ void markValidMeshTriangleIndex(TriangleIndex* TriangleBuffer, const unsigned int previousVertexOffset, const unsigned int allTriNums, const unsigned int verticesNum, bool* markValidTriangleIndex);
+
+		/**
+		 * \brief 标记按边编码排序后每组相同编码的第一个顶点(焊接后保留的顶点).
+		 *
+		 * \param sortedKey 排序后的边编码
+		 * \param vertexCount 顶点数量
+		 * \param isRepresentative 【输出】是否为组内第一个顶点
+		 */
+		__global__ void markWeldRepresentativeKernel(const unsigned long long* sortedKey, const unsigned int vertexCount, int* isRepresentative);
+
+		/**
+		 * \brief 写出焊接后的顶点，并记录每个原顶点对应的焊接后index.稳定排序保证每组保留原index最小的顶点(maxDepth层顶点优先).
+		 *
+		 * \param sortedVertexId 排序后的原顶点index
+		 * \param weldedAddress 组内第一个顶点标记的包含前缀和，减1即焊接后的index
+		 * \param isRepresentative 是否为组内第一个顶点
+		 * \param vertices 原顶点
+		 * \param vertexCount 原顶点数量
+		 * \param vertexRemap 【输出】原顶点对应的焊接后index
+		 * \param weldedVertices 【输出】焊接后的顶点
+		 */
+		__global__ void scatterWeldedVerticesKernel(const int* sortedVertexId, const int* weldedAddress, const int* isRepresentative, const Point3D<float>* vertices, const unsigned int vertexCount, int* vertexRemap, Point3D<float>* weldedVertices);
+
+		/**
+		 * \brief 将三角形索引替换为焊接后的顶点index.
+		 *
+		 * \param vertexRemap 原顶点对应的焊接后index
+		 * \param triangleCount 三角形数量
+		 * \param triangles 【输入输出】三角形索引
+		 */
+		__global__ void remapWeldedTrianglesKernel(const int* vertexRemap, const unsigned int triangleCount, TriangleIndex* triangles);
+
+		/**
+		 * \brief 展开三角形的角点：角点3t + j的顶点为triangles[t].idx[j]，所属三角形为t.
+		 *
+		 * \param triangles 三角形索引
+		 * \param triangleCount 三角形数量
+		 * \param cornerVertex 【输出】角点的顶点index
+		 * \param cornerTriangle 【输出】角点所属的三角形index
+		 */
+		__global__ void scatterTriangleCornersKernel(const TriangleIndex* triangles, const unsigned int triangleCount, unsigned int* cornerVertex, int* cornerTriangle);
+
+		/**
+		 * \brief 由按顶点排序的角点计算CSR偏移：offset[v]为第一个顶点不小于v的角点位置，offset[vertexCount]为角点总数.
+		 *
+		 * \param sortedCornerVertex 按顶点index排序的角点顶点
+		 * \param cornerCount 角点数量(3 * 三角形数量)
+		 * \param vertexCount 顶点数量
+		 * \param vertexTriangleOffset 【输出】CSR偏移，大小为vertexCount + 1
+		 */
+		__global__ void computeVertexTriangleOffsetKernel(const unsigned int* sortedCornerVertex, const unsigned int cornerCount, const unsigned int vertexCount, int* vertexTriangleOffset);
+
+		/**
+		 * \brief 只由node及其祖先(深度不超过node的层)的27邻居计算pos处的隐式函数值，即粗层解构成的粗糙隐函数.
+		 *
+		 * \param NodeTopology 节点拓扑(SoA)视图
+		 * \param BaseFunctions 基函数
+		 * \param dx 求解得到的系数
+		 * \param encodeNodeIndexInFunction 基函数索引
+		 * \param node 包含pos的节点
+		 * \param pos 求值位置
+		 * \return 隐式函数值
+		 */
+		__device__ float coarseImplicitFunctionValue(const OctNodeTopologyView& NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, int node, const Point3D<float>& pos);
+
+		/**
+		 * \brief 按步长抽样稠密点，累加粗糙隐函数在采样点处的值，用于估计预览网格的等值.
+		 *
+		 * \param DensePoints 稠密点
+		 * \param PointToNodeArrayDLevel 稠密点对应的D层节点(相对D层首节点)
+		 * \param NodeTopology 节点拓扑(SoA)视图
+		 * \param BaseFunctions 基函数
+		 * \param dx 求解得到的系数
+		 * \param encodeNodeIndexInFunction 基函数索引
+		 * \param DLevelOffset maxDepth层首节点在NodeArray中的偏移
+		 * \param previewDepth 预览层
+		 * \param sampleStride 采样步长
+		 * \param sampleCount 采样点数量
+		 * \param isoValueSum 【输出】采样点隐函数值之和(需预先置0)
+		 */
+		__global__ void accumulatePreviewIsoValueKernel(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const unsigned int DLevelOffset, const int previewDepth, const unsigned int sampleStride, const unsigned int sampleCount, float* isoValueSum);
+
+		/**
+		 * \brief 在预览层节点上做Marching Cubes：8个角点的粗糙隐函数值决定立方体类型，每个三角形独立写出3个顶点(不共享顶点).
+		 *
+		 * \param NodeTopology 节点拓扑(SoA)视图
+		 * \param CenterBuffer 节点中心
+		 * \param BaseFunctions 基函数
+		 * \param dx 求解得到的系数
+		 * \param encodeNodeIndexInFunction 基函数索引
+		 * \param previewOffset 预览层首节点在NodeArray中的偏移
+		 * \param previewNodeCount 预览层节点数量
+		 * \param previewDepth 预览层
+		 * \param isoValueSum 采样点隐函数值之和
+		 * \param sampleCount 采样点数量
+		 * \param triangleCapacity 三角形容量
+		 * \param triangleCount 【输出】三角形计数器(需预先置0)
+		 * \param previewVertices 【输出】预览网格顶点，3 * triangleCapacity
+		 * \param previewTriangles 【输出】预览网格三角形
+		 */
+		__global__ void generatePreviewTrianglesKernel(OctNodeTopologyView NodeTopology, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const unsigned int previewOffset, const unsigned int previewNodeCount, const int previewDepth, const float* isoValueSum, const unsigned int sampleCount, const unsigned int triangleCapacity, int* triangleCount, Point3D<float>* previewVertices, TriangleIndex* previewTriangles);
 	}
+
+	/**
+	 * \brief 预览网格回调，在CUDA回调线程中调用，不能调用CUDA API；指针只在回调期间有效，需要保留时应自行拷贝.
+	 *        预览网格不共享顶点，vertexCount = 3 * triangleCount.
+	 */
+	using PreviewMeshCallback = std::function<void(const Point3D<float>* vertices, const unsigned int vertexCount, const TriangleIndex* triangles, const unsigned int triangleCount)>;
+
 	class ComputeTriangleIndices
 	{
 	public:
-		ComputeTriangleIndices();
+		ComputeTriangleIndices(const ReconstructionConfig& config = ReconstructionConfig());
 
 		~ComputeTriangleIndices();
 
@@ -313,6 +491,7 @@ namespace SparseSurfelFusion {
 		 * \param EdgeArray 边数组
 		 * \param FaceArray 面数组
 		 * \param NodeArray 节点数组
+		 * \param NodeTopology 细分前节点拓扑(SoA)视图，仅用于计算顶点隐函数值
 		 * \param BaseFunction 基函数
 		 * \param dx 散度
 		 * \param encodeNodeIndexInFunction 基函数索引
@@ -321,7 +500,7 @@ namespace SparseSurfelFusion {
 		 * \param DLevelOffset maxDepth层NodeArray偏移
 		 * \param stream cuda流
 		 */
-		void calculateTriangleIndices(DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<FaceNode> FaceArray, DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const float isoValue, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream);
+		void calculateTriangleIndices(DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<FaceNode> FaceArray, DeviceBufferArray<OctNode>& NodeArray, OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, const float isoValue, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream);
 
 		/**
 		 * \brief 获得重建网格的顶点.
@@ -329,7 +508,7 @@ namespace SparseSurfelFusion {
 		 * \return 重建网格的顶点.
 		 */
 		DeviceArrayView<Point3D<float>> GetRebuildMeshVertices() {
-			return MeshTriangleVertex.ArrayView();
+			return DeviceArrayView<Point3D<float>>(outputVertices(), MeshVertexCount);
 		}
 
 		/**
@@ -338,19 +517,131 @@ namespace SparseSurfelFusion {
 		 * \return 重建网格的索引.
 		 */
 		DeviceArrayView<TriangleIndex> GetRebuildMeshTriangleIndices() {
-			return MeshTriangleIndex.ArrayView();
+			return DeviceArrayView<TriangleIndex>(outputTriangles(), MeshTriangleCount);
 		}
 
+		/**
+		 * \brief 设置网格输出槽，之后的等值面提取与细分把最终网格直接写入sink，省去拷贝到消费者缓冲的两次设备间拷贝.
+		 *        GetRebuildMeshVertices/GetRebuildMeshTriangleIndices随之指向sink.
+		 *
+		 * \param sink 输出显存，容量不足时报错
+		 */
+		void SetOutputSink(const MeshOutputSink& sink) { outputSink = sink; }
+
+		/**
+		 * \brief 重置输出槽，网格写回MeshTriangleVertex/MeshTriangleIndex.
+		 */
+		void ResetOutputSink() { outputSink = MeshOutputSink(); }
+
+		/**
+		 * \brief 把输出槽中的网格拷回MeshTriangleVertex/MeshTriangleIndex并重置输出槽，须在sink解除映射前调用.
+		 *        之后GetRebuildMeshVertices/GetRebuildMeshTriangleIndices与导出读取内部缓冲，不再指向已解除映射的显存.
+		 *
+		 * \param stream 写入输出槽的cuda流之后的流
+		 */
+		void DetachOutputSink(cudaStream_t stream);
+
+		/**
+		 * \brief 设置是否焊接顶点(默认开启)：细分网格与maxDepth层网格分批插入，共享边上的顶点各有一份，
+		 *        焊接按顶点所在边的编码去重，输出共享顶点的索引网格；本帧没有插入细分网格时每条边只有一个顶点，跳过焊接.
+		 *
+		 * \param enable 是否开启
+		 */
+		void SetVertexWelding(const bool enable) { vertexWelding = enable; }
+
+		/**
+		 * \brief 设置是否在提取的最后(焊接、简化之后)构建顶点→三角形邻接(CSR)，供绘制时按顶点无原子地计算法线(默认关闭).
+		 *
+		 * \param enable 是否开启
+		 */
+		void SetVertexTriangleAdjacency(const bool enable) { vertexTriangleAdjacency = enable; }
+
+		/**
+		 * \brief 获得顶点→三角形邻接的CSR偏移：顶点v邻接的三角形为GetVertexTriangleList()[offset[v], offset[v + 1])，
+		 *        大小为顶点数量 + 1，最后一个元素为3 * 三角形数量.未开启SetVertexTriangleAdjacency时为空.
+		 */
+		DeviceArrayView<int> GetVertexTriangleOffset() const { return VertexTriangleOffset.ArrayView(); }
+
+		/**
+		 * \brief 获得顶点→三角形邻接的三角形index，同一顶点的三角形按index升序.
+		 */
+		DeviceArrayView<int> GetVertexTriangleList() const { return VertexTriangleList.ArrayView(); }
+
+		/**
+		 * \brief 设置阶段计时器，等值面提取与细分分别计时.
+		 *
+		 * \param stageProfiler 计时器，为NULL时不计时
+		 */
+		void SetProfiler(StageProfiler* stageProfiler) { profiler = stageProfiler; }
+
+		/**
+		 * \brief 设置网格简化，焊接之后原地简化输出网格.
+		 *
+		 * \param meshSimplification 简化器，为NULL或未设置目标时不简化
+		 */
+		void SetSimplification(MeshSimplification* meshSimplification) { simplification = meshSimplification; }
+
+		/**
+		 * \brief 设置等值面提取的感兴趣区域(归一化坐标)：只对与区域相交的节点求顶点隐函数值、生成等值面顶点、三角形与细分，
+		 *        区域外的顶点值记为NaN，角点含NaN的节点不生成三角形也不细分.区域边界外至多多出一圈节点.
+		 *
+		 * \param regions 感兴趣区域，count为0时提取整个表面
+		 */
+		void SetRegionsOfInterest(const MeshRegionsOfInterest& regions) { regionsOfInterest = regions; }
+
+		/**
+		 * \brief 设置渐进预览：求解完粗层后在预览层上提取粗糙网格，写入双缓冲的映射页锁定内存并发布，细层求解继续进行.
+		 *        关闭时释放预览缓冲，调用前须保证没有正在进行的预览提取.
+		 *
+		 * \param enable 是否开启
+		 * \param callback 每次发布预览网格时调用，可为空(通过GetPreviewMesh轮询)
+		 */
+		void SetPreviewMesh(const bool enable, PreviewMeshCallback callback = PreviewMeshCallback());
+
+		/**
+		 * \brief 是否开启了渐进预览.
+		 */
+		bool IsPreviewEnabled() const { return previewSlots[0].vertices != NULL; }
+
+		/**
+		 * \brief 在预览层上用粗层解提取预览网格【无阻塞】，完成后在stream上发布.stream须已等待预览层及更粗层的求解.
+		 *
+		 * \param DensePoints 稠密点
+		 * \param PointToNodeArrayDLevel 稠密点对应的D层节点(相对D层首节点)
+		 * \param NodeTopology 节点拓扑(SoA)视图
+		 * \param CenterBuffer 节点中心
+		 * \param BaseFunction 基函数
+		 * \param dx 求解得到的系数(预览层及更粗层已求解)
+		 * \param encodeNodeIndexInFunction 基函数索引
+		 * \param DLevelOffset maxDepth层首节点在NodeArray中的偏移
+		 * \param previewOffset 预览层首节点在NodeArray中的偏移
+		 * \param previewNodeCount 预览层节点数量
+		 * \param previewDepth 预览层
+		 * \param stream cuda流
+		 */
+		void ExtractPreviewMesh(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, OctNodeTopologyView NodeTopology, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const unsigned int DLevelOffset, const unsigned int previewOffset, const unsigned int previewNodeCount, const int previewDepth, cudaStream_t stream);
+
+		/**
+		 * \brief 拷贝最近一次发布的预览网格，可在任意线程调用.
+		 *
+		 * \param vertices 【输出】预览网格顶点
+		 * \param triangles 【输出】预览网格三角形
+		 * \return 是否已有发布的预览网格
+		 */
+		bool GetPreviewMesh(std::vector<Point3D<float>>& vertices, std::vector<TriangleIndex>& triangles);
 
 	private:
+		StageProfiler* profiler = NULL;									// 阶段计时器
+		MeshSimplification* simplification = NULL;						// 网格简化
 		DeviceBufferArray<float> vvalue;								// 【论文参数】顶点隐式函数值
-		DeviceBufferArray<int> vexNums;									// 【论文参数】顶点的数量
-		DeviceBufferArray<int> vexAddress;								// 【论文参数】顶点的位置
-		DeviceBufferArray<int> triNums;									// 【论文参数】三角形数量
-		DeviceBufferArray<int> triAddress;								// 【论文参数】三角形位置
-		DeviceBufferArray<int> cubeCatagory;							// 记录这是属于哪一种类型的立方体，方便使用Marching Cubes算法构建网格
-
-		DeviceBufferArray<bool> markValidVertex;						// 标记有效的顶点的位置
+		DeviceBufferArray<float> BaseFunctionValueTable;				// 基函数在maxDepth网格格点上的值
+		const void* tabulatedBaseFunction = NULL;						// 基函数值表对应的基函数地址，地址不变则无需重建
+		DeviceBufferArray<int> vexAddress;								// 【论文参数】边对应的网格顶点index
+		DeviceBufferArray<int> hasSurfaceIntersection;					// 面是否与等值面相交
+		DeviceBufferArray<int> meshElementCount;						// maxDepth层单趟生成的顶点、三角形数量(设备端计数器)
+		int* meshElementCountHost = NULL;								// 计数器的页锁定Host副本
+		cudaEvent_t meshElementCountReady;								// 计数器拷贝到Host完成的事件
+		bool meshElementCountPending = false;							// 是否有尚未同步到MeshVertexCount/MeshTriangleCount的计数
 
 		DeviceBufferArray<bool> markValidSubdividedNode;				// 标记节点是否可以被细分优化
 
@@ -358,11 +649,59 @@ namespace SparseSurfelFusion {
 		DeviceBufferArray<bool> markValidTriangleIndex;					// 标记有效的网格索引
 		DeviceBufferArray<Point3D<float>> MeshTriangleVertex;			// 网格顶点
 		DeviceBufferArray<bool> markValidTriangleVertex;				// 标记有效的网格顶点
+		MeshOutputSink outputSink;										// 调用方提供的网格输出显存，无效时写入MeshTriangleVertex/MeshTriangleIndex
+		unsigned int MeshVertexCount = 0;								// 已写入输出的网格顶点数量
+		unsigned int MeshTriangleCount = 0;								// 已写入输出的三角形数量
+		DeviceBufferArray<unsigned long long> MeshVertexKey;			// 网格顶点所在边的编码，与输出顶点一一对应
+		bool vertexWelding = true;										// 是否焊接共享边上的顶点
+		bool subdivisionAppended = false;								// 本帧是否插入了细分网格(只有插入后才存在重复顶点)
+		bool vertexTriangleAdjacency = false;							// 是否构建顶点→三角形邻接
+
+		// 顶点→三角形邻接(CSR)，同样从缓存池中取
+		DeviceBufferArray<unsigned int> AdjacencyCornerVertex;			// 展开的角点顶点index
+		DeviceBufferArray<int> AdjacencyCornerTriangle;					// 展开的角点所属三角形
+		DeviceBufferArray<unsigned int> AdjacencySortedVertex;			// 按顶点排序后的角点顶点index
+		DeviceBufferArray<int> VertexTriangleOffset;					// CSR偏移
+		DeviceBufferArray<int> VertexTriangleList;						// CSR中的三角形index
+		MeshRegionsOfInterest regionsOfInterest;						// 等值面提取的感兴趣区域(归一化坐标)
+
+		/**
+		 * \brief 预览网格的一个缓冲槽位，顶点与三角形在映射的页锁定内存中，核函数直接写入.
+		 */
+		struct PreviewMeshSlot {
+			Point3D<float>* vertices = NULL;				// 顶点(Host地址)
+			TriangleIndex* triangles = NULL;				// 三角形(Host地址)
+			Point3D<float>* verticesDevice = NULL;			// 顶点(设备端地址)
+			TriangleIndex* trianglesDevice = NULL;			// 三角形(设备端地址)
+			int* triangleCount = NULL;						// 三角形数量(页锁定)
+		};
+		PreviewMeshSlot previewSlots[2];								// 双缓冲：提取写入previewPendingSlot，读取只读previewFrontSlot
+		int previewPendingSlot = 1;										// 正在提取的槽位
+		int previewFrontSlot = -1;										// 最近发布的槽位，-1表示尚未发布
+		unsigned int previewFrontTriangleCount = 0;						// 最近发布的三角形数量
+		std::mutex previewMutex;										// 保护previewFrontSlot与previewFrontTriangleCount
+		PreviewMeshCallback previewCallback;							// 发布预览网格时的回调
+		DeviceBufferArray<int> previewTriangleCounter;					// 预览三角形的设备端计数器
+		DeviceBufferArray<float> previewIsoValueSum;					// 预览等值采样之和
+
+		/**
+		 * \brief 发布previewPendingSlot并调用回调，由cudaLaunchHostFunc在流上调用.
+		 */
+		static void CUDART_CB publishPreviewMesh(void* userData);
+
+		/** \brief 网格顶点的输出地址. */
+		Point3D<float>* outputVertices() { return outputSink.IsValid() ? outputSink.vertices : MeshTriangleVertex.Ptr(); }
+		/** \brief 网格顶点的输出容量. */
+		unsigned int outputVertexCapacity() const { return outputSink.IsValid() ? outputSink.vertexCapacity : (unsigned int)MeshTriangleVertex.BufferSize(); }
+		/** \brief 三角形的输出地址. */
+		TriangleIndex* outputTriangles() { return outputSink.IsValid() ? outputSink.triangles : MeshTriangleIndex.Ptr(); }
+		/** \brief 三角形的输出容量. */
+		unsigned int outputTriangleCapacity() const { return outputSink.IsValid() ? outputSink.triangleCapacity : (unsigned int)MeshTriangleIndex.BufferSize(); }
 
 		DeviceBufferArray<OctNode> SubdivideNode;						// 细分节点，将生成的三角剖分细分
 
-		int SubdivideDepthCount[Constants::maxDepth_Host] = { 0 };		// 细分节点每一层节点的数量
-		int SubdivideDepthAddress[Constants::maxDepth_Host] = { 0 };	// 细分节点每层在SubdivideNode的偏移
+		int SubdivideDepthCount[Constants::maxDepth_Host + 1] = { 0 };	// 细分节点每一层节点的数量
+		int SubdivideDepthAddress[Constants::maxDepth_Host + 1] = { 0 };// 细分节点每层在SubdivideNode的偏移
 
 		int SubdivideNodeNumHost = 0;									// 细分节点的个数
 		SynchronizeArray<int> SubdivideDepthBuffer;						// 记录SubdivideNode数组细分节点的深度
@@ -374,58 +713,125 @@ namespace SparseSurfelFusion {
 		int depthNodeCount[Constants::maxDepth_Host + 1] = { 0 };;		// 每层节点的数量【用于Finer层细分】
 		int depthNodeAddress[Constants::maxDepth_Host + 1] = { 0 };;	// 每层节点的偏移【用于Finer层细分】
 
-		DeviceBufferArray<bool> markValidSubdivideVertex;				// 细分节点中标记有效的顶点【用于Coarser层细分】
-		DeviceBufferArray<bool> markValidSubdivideEdge;					// 细分节点中标记有效的边【用于Coarser层细分】
-		DeviceBufferArray<bool> markValidSubdivedeVexNum;				// 细分节点中标记有效的vexNums【用于Coarser层细分】
+		DeviceBufferArray<bool> markValidSubdivideVertex;				// 细分节点中标记有效的顶点
+		DeviceBufferArray<bool> markValidSubdivideEdge;					// 细分节点中标记有效的边
+		DeviceBufferArray<bool> markValidSubdivedeVexNum;				// 细分节点中标记有效的vexNums
+
+		// 细分缓存池：Coarser与Finer细分的每轮中间变量都从这里取，容量不足时扩容，不再每轮cudaMallocAsync/cudaFreeAsync
+		DeviceBufferArray<EasyOctNode> SubdivideRebuildArray;			// 重建节点数组
+		DeviceBufferArray<int> SubdivideRebuildDepth;					// 重建节点深度
+		DeviceBufferArray<Point3D<float>> SubdivideRebuildCenter;		// 重建节点中心
+		DeviceBufferArray<int> SubdivideReplaceNodeId;					// 重建节点所属细分节点在NodeArray中的index【用于Finer层细分】
+		DeviceBufferArray<int> SubdivideIsRoot;							// 重建节点是否为细分节点本身【用于Finer层细分】
+		DeviceBufferArray<int> SubdivideFixedDepthNums;					// 每个细分节点在每层展开的节点数量【用于Finer层细分】
+		DeviceBufferArray<int> SubdivideFixedDepthAddress;				// SubdivideFixedDepthNums的排他前缀和【用于Finer层细分】
+		DeviceBufferArray<VertexNode> SubdividePreVertexArray;			// 筛选前的细分顶点
+		DeviceBufferArray<VertexNode> SubdivideVertexArray;				// 细分顶点
+		DeviceBufferArray<EdgeNode> SubdividePreEdgeArray;				// 筛选前的细分边
+		DeviceBufferArray<EdgeNode> SubdivideEdgeArray;					// 细分边
+		DeviceBufferArray<EdgeNode> SubdivideValidEdgeArray;			// 与等值面相交的细分边
+		DeviceBufferArray<float> SubdivideVvalue;						// 细分顶点隐式函数值
+		DeviceBufferArray<int> SubdivideVexNums;						// 细分边上的等值面顶点数量
+		DeviceBufferArray<int> SubdivideVexAddress;						// 细分边上的等值面顶点偏移
+		DeviceBufferArray<int> SubdivideValidVexAddress;				// 与等值面相交的细分边的顶点偏移
+		DeviceBufferArray<int> SubdivideTriNums;						// 细分节点的三角形数量
+		DeviceBufferArray<int> SubdivideTriAddress;						// 细分节点的三角形偏移
+		DeviceBufferArray<int> SubdivideCubeCatagory;					// 细分节点的立方体类型
+		DeviceBufferArray<Point3D<float>> SubdivideVertexBuffer;		// 细分生成的网格顶点
+		DeviceBufferArray<unsigned long long> SubdivideVertexKeyBuffer;	// 细分生成的网格顶点所在边的编码
+		DeviceBufferArray<TriangleIndex> SubdivideTriangleBuffer;		// 细分生成的三角形
+		DeviceBufferArray<unsigned char> SubdivideTempStorage;			// cub算法的临时存储
+		DeviceBufferArray<int> SubdivideCounter;						// 细分流程的小计数器(每层数量、每层偏移、筛选数量)
+
+		// 顶点焊接的中间变量，同样从缓存池中取
+		DeviceBufferArray<unsigned long long> WeldSortedKey;			// 排序后的边编码
+		DeviceBufferArray<int> WeldVertexId;							// 排序前的顶点index
+		DeviceBufferArray<int> WeldSortedVertexId;						// 排序后的顶点index
+		DeviceBufferArray<int> WeldRepresentative;						// 是否为组内第一个顶点
+		DeviceBufferArray<int> WeldAddress;								// 组内第一个顶点标记的包含前缀和
+		DeviceBufferArray<int> WeldVertexRemap;							// 原顶点对应的焊接后index
+		DeviceBufferArray<Point3D<float>> WeldVertexBuffer;				// 焊接后的顶点
+
+		/**
+		 * \brief 从细分缓存池中取出能容纳size个元素的缓存，容量不足时按1.5倍重新开辟(不保留旧数据).
+		 *
+		 * \param buffer 缓存池中的缓存
+		 * \param size 需要的元素数量
+		 * \return 缓存首地址
+		 */
+		template<typename T>
+		static T* reserveSubdivideBuffer(DeviceBufferArray<T>& buffer, const size_t size) {
+			if (size > buffer.BufferSize()) {
+				buffer.ReleaseBuffer();		// cudaFree会等待设备上已提交的任务完成，旧缓存不会被正在执行的核函数访问
+				buffer.AllocateBuffer(static_cast<size_t>(size * 1.5));
+			}
+			buffer.ResizeArrayOrException(size);
+			return buffer.Ptr();
+		}
+
+		/**
+		 * \brief 获得至少bytes字节的cub临时存储.
+		 */
+		void* reserveSubdivideTempStorage(const size_t bytes) {
+			return reserveSubdivideBuffer(SubdivideTempStorage, bytes > 0 ? bytes : 1);
+		}
+
+		/**
+		 * \brief 首次使用(或基函数变化)时构建基函数值表.
+		 *
+		 * \param BaseFunction 基函数
+		 * \param stream cuda流
+		 */
+		void prepareBaseFunctionValueTable(DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, cudaStream_t stream);
 
-		DeviceBufferArray<bool> markValidFinerVexArray;
-		DeviceBufferArray<bool> markValidFinerEdge;
-		DeviceBufferArray<bool> markValidFinerVexNum;
 		/**
 		 * \brief 计算顶点vertex的隐式函数值.
 		 *
 		 * \param VertexArray 顶点数组
-		 * \param NodeArray 节点数组
+		 * \param NodeTopology 节点拓扑(SoA)视图
 		 * \param BaseFunction 基函数
 		 * \param dx 散度
 		 * \param encodeNodeIndexInFunction 基函数索引
 		 * \param isoValue 等值
 		 * \param stream cuda流
 		 */
-		void ComputeVertexImplicitFunctionValue(DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream);
+		void ComputeVertexImplicitFunctionValue(DeviceArrayView<VertexNode> VertexArray, OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream);
 
 		/**
-		 * \brief 生成顶点的vertexNums和顶点的vertexAddress.
+		 * \brief 单趟生成等值面顶点，直接写入MeshTriangleVertex，不需要Host同步.
 		 *
 		 * \param EdgeArray 边数组
 		 * \param NodeArray 节点数组
-		 * \param vvalue 顶点隐式函数值
+		 * \param VertexArray 顶点数组
 		 * \param stream cuda流
 		 */
-		void generateVertexNumsAndVertexAddress(DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> vvalue, const unsigned int DLevelOffset, cudaStream_t stream);
+		void generateIsoVertices(DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<VertexNode> VertexArray, cudaStream_t stream);
 
 		/**
-		 * \brief 生成TriNums和TriAddress，以及立方体类型cubeCatagory.
+		 * \brief 单趟生成maxDepth层的三角形，直接写入MeshTriangleIndex，并标记与等值面相交的面，不需要Host同步.
 		 *
 		 * \param NodeArray 节点数组
-		 * \param vvalue 顶点隐式函数值
+		 * \param FaceArray 面数组
 		 * \param DLevelOffset 第maxDepth层的首节点在NodeArray中偏移
 		 * \param DLevelNodeCount 第maxDepth层节点数量
 		 * \param stream cuda流
 		 */
-		void generateTriangleNumsAndTriangleAddress(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<float> vvalue, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream);
+		void generateIsoTriangles(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<FaceNode> FaceArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream);
 
 		/**
-		 * \brief 生成顶点以及三角形.
-		 * 
+		 * \brief 标记其他层叶子节点是否含三角形或相交面，并异步取回顶点、三角形数量.
+		 *
+		 * \param NodeArray 节点数组
 		 * \param VertexArray 顶点数组
-		 * \param EdgeArray 边数组
-		 * \param FaceArray 面数组
 		 * \param DLevelOffset 第maxDepth层的首节点在NodeArray中偏移
-		 * \param DLevelNodeCount 第maxDepth层节点数量
 		 * \param stream cuda流
 		 */
-		void generateVerticesAndTriangle(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<VertexNode> VertexArray, DeviceArrayView<EdgeNode> EdgeArray, DeviceArrayView<FaceNode> FaceArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, cudaStream_t stream);
+		void processOtherDepthLeafNodes(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<VertexNode> VertexArray, const unsigned int DLevelOffset, cudaStream_t stream);
+
+		/**
+		 * \brief 等待异步取回的顶点、三角形数量，并设置MeshTriangleVertex、MeshTriangleIndex的大小(在Host需要网格大小前调用).
+		 */
+		void synchronizeMeshElementCount();
 
 		/**
 		 * \brief 插入三角形.
@@ -445,8 +851,23 @@ namespace SparseSurfelFusion {
 		 * \param allVexNums 所有有效顶点数量
 		 * \param TriangleBuffer 三角形数组
 		 * \param allTriNums 所有有效三角形数量
+		 * \param VertexKeyBuffer 顶点所在边的编码，与VertexBuffer一一对应
+		 */
+		void insertTriangle(Point3D<float>* VertexBuffer, const int allVexNums, TriangleIndex* TriangleBuffer, const int allTriNums, const unsigned long long* VertexKeyBuffer, cudaStream_t stream);
+
+		/**
+		 * \brief 按边编码焊接输出网格中的顶点：稳定排序编码后每组保留一个顶点，三角形索引替换为焊接后的index.
+		 *
+		 * \param stream cuda流
+		 */
+		void weldMeshVertices(cudaStream_t stream);
+
+		/**
+		 * \brief 由输出网格构建顶点→三角形邻接：展开角点后按顶点index基数排序(稳定，三角形保持升序)，二分得到每个顶点的偏移.
+		 *
+		 * \param stream cuda流
 		 */
-		void insertTriangle(Point3D<float>* VertexBuffer, const int allVexNums, TriangleIndex* TriangleBuffer, const int allTriNums, cudaStream_t stream);
+		void buildVertexTriangleAdjacency(cudaStream_t stream);
 
 		/**
 		 * \brief 生成细分节点的数组以及不同层细分节点的数量和偏移【GPU硬件限制，无法使用流异步操作，需要Share Memory > 64kb的GPU】.
@@ -470,10 +891,10 @@ namespace SparseSurfelFusion {
 		 * \param isoValue 等值
 		 * \param stream cuda流
 		 */
-		void CoarserSubdivideNodeAndRebuildMesh(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream);
+		void CoarserSubdivideNodeAndRebuildMesh(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream);
 
 		/**
-		 * \brief 精节点细分并重构网格【似乎可以与Coarser并行，开两个线程】.
+		 * \brief 精节点细分并重构网格，[finerDepth, maxDepth)层的全部细分节点放入同一个重建数组一轮完成【似乎可以与Coarser并行，开两个线程】.
 		 *
 		 * \param NodeArray 节点数组
 		 * \param DepthBuffer 节点深度数组
@@ -484,7 +905,27 @@ namespace SparseSurfelFusion {
 		 * \param isoValue 等值
 		 * \param stream cuda流
 		 */
-		void FinerSubdivideNodeAndRebuildMesh(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<int> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream);
+		void FinerSubdivideNodeAndRebuildMesh(DeviceBufferArray<OctNode>& NodeArray, DeviceArrayView<unsigned int> DepthBuffer, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream);
+
+		/**
+		 * \brief 由已建好邻居的重建数组生成细分网格并插入：顶点与边的筛选一起同步一次，顶点数量与三角形数量一起同步一次.
+		 *
+		 * \param NodeArray 节点数组
+		 * \param CenterBuffer 节点中心位置数组
+		 * \param BaseFunction 基函数
+		 * \param dx 节点
+		 * \param encodeNodeIndexInFunction 基函数节点编码
+		 * \param isoValue 等值
+		 * \param RebuildArray 重建节点数组
+		 * \param RebuildCenter 重建节点中心
+		 * \param DLevelOffset 重建数组中maxDepth层的偏移
+		 * \param DLevelNodeCount 重建数组中maxDepth层的节点数量
+		 * \param rootId 单个细分节点重建时，细分节点在NodeArray中的index【用于Coarser层细分】
+		 * \param ReplaceNodeId 多个细分节点一起重建时，重建节点所属细分节点在NodeArray中的index，为NULL时使用rootId【用于Finer层细分】
+		 * \param IsRoot 多个细分节点一起重建时，重建节点是否为细分节点本身【用于Finer层细分】
+		 * \param stream cuda流
+		 */
+		void rebuildSubdivideMesh(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<Point3D<float>> CenterBuffer, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, EasyOctNode* RebuildArray, const Point3D<float>* RebuildCenter, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const int rootId, const int* ReplaceNodeId, const int* IsRoot, cudaStream_t stream);
 
 
 	};
@@ -7,10 +7,13 @@
  *********************************************************************/
 #pragma once
 #include "ComputeVectorField.h"
+#include <cstdio>
+#include <fstream>
 
-SparseSurfelFusion::ComputeVectorField::ComputeVectorField(cudaStream_t stream)
+SparseSurfelFusion::ComputeVectorField::ComputeVectorField(cudaStream_t stream, const ReconstructionConfig& config)
 {
-    AllocateBuffer();
+    tableCacheDirectory = config.tableCacheDirectory;
+    AllocateBuffer(config);
     BuildInnerProductTable(stream);
 }
 
@@ -24,17 +27,18 @@ SparseSurfelFusion::ComputeVectorField::~ComputeVectorField()
     VectorField.ReleaseBuffer();
 }
 
-void SparseSurfelFusion::ComputeVectorField::AllocateBuffer()
+void SparseSurfelFusion::ComputeVectorField::AllocateBuffer(const ReconstructionConfig& config)
 {
-    dot_F_F.AllocateBuffer(F_DATA_RES_SQUARE);
-    dot_F_DF.AllocateBuffer(F_DATA_RES_SQUARE);
-    dot_F_D2F.AllocateBuffer(F_DATA_RES_SQUARE);
+    const int tableSize = InnerProductTableView().SetLayout(0.5 * (CONVTIMES + 1));   // GaussianApproximation的支撑半径为(CONVTIMES + 1) / 2
+    dot_F_F.AllocateBuffer(tableSize);
+    dot_F_DF.AllocateBuffer(tableSize);
+    dot_F_D2F.AllocateBuffer(tableSize);
     baseFunctions_Device.AllocateBuffer(F_DATA_RES);
     BaseFunctionMaxDepth_Device.AllocateBuffer(sizeof(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>));
-    VectorField.AllocateBuffer(D_LEVEL_MAX_NODE);
+    VectorField.AllocateBuffer(config.DLevelMaxNode());
 }
 
-void SparseSurfelFusion::ComputeVectorField::BuildVectorField(DeviceArrayView<OrientedPoint3D<float>> orientedPoints, DeviceArrayView<OctNode> NodeArray, const int* NodeArrayCount, const int* BaseAddressArray, cudaStream_t stream)
+void SparseSurfelFusion::ComputeVectorField::BuildVectorField(DeviceArrayView<OrientedPoint3D<float>> orientedPoints, DeviceArrayView<int> Point2NodeArray, DeviceArrayView<OctNode> NodeArray, const int* NodeArrayCount, const int* BaseAddressArray, cudaStream_t stream)
 {
 #ifdef CHECK_MESH_BUILD_TIME_COST
     auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
@@ -50,7 +54,7 @@ void SparseSurfelFusion::ComputeVectorField::BuildVectorField(DeviceArrayView<Or
     BaseFunctionMaxDepth_Device.ResizeArrayOrException(sizeof(BaseFunctionMaxDepth));
     CHECKCUDA(cudaMemcpyAsync(BaseFunctionMaxDepth_Device.Array().ptr(), &BaseFunctionMaxDepth, sizeof(BaseFunctionMaxDepth), cudaMemcpyHostToDevice, stream));
     VectorField.ResizeArrayOrException(NodeArrayCount[Constants::maxDepth_Host]);
-    CalculateVectorField(BaseFunctionMaxDepth_Device, orientedPoints, NodeArray, BaseAddressArray[Constants::maxDepth_Host], NodeArrayCount[Constants::maxDepth_Host], VectorField, stream);
+    CalculateVectorField(BaseFunctionMaxDepth_Device, orientedPoints, Point2NodeArray, NodeArray, BaseAddressArray[Constants::maxDepth_Host], NodeArrayCount[Constants::maxDepth_Host], VectorField, stream);
 
 
     ///** Check VectorField **/
@@ -81,7 +85,10 @@ void SparseSurfelFusion::ComputeVectorField::BuildInnerProductTable(cudaStream_t
     ReconstructionFunction = PPolynomial<CONVTIMES>::GaussianApproximation();
     FunctionData<CONVTIMES, double> fData;
     fData.set(Constants::maxDepth_Host, ReconstructionFunction, normalize, 0);
-    fData.setDotTables(fData.DOT_FLAG | fData.D_DOT_FLAG | fData.D2_DOT_FLAG);
+    const int tableSize = innerProductTable.SetLayout(fabs(fData.baseFunction.polys[0].start));
+    // 点积表只依赖深度、CONVTIMES与normalize，命中缓存时跳过Host端的点积计算
+    const std::string cachePath = innerProductTablePath();
+    const bool cacheHit = !cachePath.empty() && loadInnerProductTable(cachePath, tableSize, stream);
     PPolynomial<CONVTIMES>& F = ReconstructionFunction;
     switch (normalize) {
     case 2:
@@ -94,14 +101,15 @@ void SparseSurfelFusion::ComputeVectorField::BuildInnerProductTable(cudaStream_t
         F = F / F(0);
     }
 
-    dot_F_F.ResizeArrayOrException(fData.res * fData.res);
-    CHECKCUDA(cudaMemcpyAsync(dot_F_F.Array().ptr(), fData.dotTable, sizeof(double) * fData.res * fData.res, cudaMemcpyHostToDevice, stream));
-    dot_F_DF.ResizeArrayOrException(fData.res * fData.res);
-    CHECKCUDA(cudaMemcpyAsync(dot_F_DF.Array().ptr(), fData.dDotTable, sizeof(double) * fData.res * fData.res, cudaMemcpyHostToDevice, stream));
-    dot_F_D2F.ResizeArrayOrException(fData.res * fData.res);
-    CHECKCUDA(cudaMemcpyAsync(dot_F_D2F.Array().ptr(), fData.d2DotTable, sizeof(double) * fData.res * fData.res, cudaMemcpyHostToDevice, stream));
-
-    fData.clearDotTables(fData.DOT_FLAG | fData.D_DOT_FLAG | fData.D2_DOT_FLAG);
+    if (!cacheHit) {
+        std::vector<double> tables(3 * (size_t)tableSize);
+        fData.setCompactDotTables(innerProductTable.pairBase, innerProductTable.halfRange, tables.data(), tables.data() + tableSize, tables.data() + 2 * tableSize);
+        uploadInnerProductTable(tables.data(), tableSize, stream);
+        if (!cachePath.empty()) saveInnerProductTable(cachePath, tableSize, tables.data());
+    }
+    innerProductTable.dot_F_F = dot_F_F.Ptr();
+    innerProductTable.dot_F_DF = dot_F_DF.Ptr();
+    innerProductTable.dot_F_D2F = dot_F_D2F.Ptr();
 
     std::vector<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions_Host;
     baseFunctions_Host.resize(fData.res);
@@ -114,8 +122,80 @@ void SparseSurfelFusion::ComputeVectorField::BuildInnerProductTable(cudaStream_t
     CHECKCUDA(cudaStreamSynchronize(stream));
     auto end = std::chrono::high_resolution_clock::now();						// 记录结束时间点
     std::chrono::duration<double, std::milli> duration = end - start;			// 计算执行时间（以ms为单位）
-    std::cout << "预先计算点积表时间: " << duration.count() << " ms" << std::endl;		// 输出
+    std::cout << (cacheHit ? "读取缓存点积表时间: " : "预先计算点积表时间: ") << duration.count() << " ms" << std::endl;		// 输出
     std::cout << std::endl;
     std::cout << "-----------------------------------------------------" << std::endl;	// 输出
     std::cout << std::endl;
 }
+
+std::string SparseSurfelFusion::ComputeVectorField::innerProductTablePath() const
+{
+    if (tableCacheDirectory.empty()) return std::string();
+    std::string directory = tableCacheDirectory;
+    if (directory.back() != '/' && directory.back() != '\\') directory += '/';
+    return directory + "InnerProductTable_D" + std::to_string(Constants::maxDepth_Host) + "_C" + std::to_string(CONVTIMES) + "_N" + std::to_string(normalize) + ".bin";
+}
+
+void SparseSurfelFusion::ComputeVectorField::uploadInnerProductTable(const double* tables, const int tableSize, cudaStream_t stream)
+{
+    dot_F_F.ResizeArrayOrException(tableSize);
+    CHECKCUDA(cudaMemcpyAsync(dot_F_F.Array().ptr(), tables, sizeof(double) * tableSize, cudaMemcpyHostToDevice, stream));
+    dot_F_DF.ResizeArrayOrException(tableSize);
+    CHECKCUDA(cudaMemcpyAsync(dot_F_DF.Array().ptr(), tables + tableSize, sizeof(double) * tableSize, cudaMemcpyHostToDevice, stream));
+    dot_F_D2F.ResizeArrayOrException(tableSize);
+    CHECKCUDA(cudaMemcpyAsync(dot_F_D2F.Array().ptr(), tables + 2 * tableSize, sizeof(double) * tableSize, cudaMemcpyHostToDevice, stream));
+    CHECKCUDA(cudaStreamSynchronize(stream));   // tables为可分页内存，返回前保证拷贝完成
+}
+
+bool SparseSurfelFusion::ComputeVectorField::loadInnerProductTable(const std::string& path, const int tableSize, cudaStream_t stream)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    InnerProductTableHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != INNER_PRODUCT_TABLE_MAGIC || header.version != INNER_PRODUCT_TABLE_VERSION ||
+        header.maxDepth != Constants::maxDepth_Host || header.convTimes != CONVTIMES || header.normalize != normalize || header.tableSize != tableSize) {
+        LOGGING(INFO) << "点积表缓存 " << path << " 与当前参数不匹配，重新计算";
+        return false;
+    }
+
+    std::vector<double> tables(3 * (size_t)tableSize);
+    file.read(reinterpret_cast<char*>(tables.data()), sizeof(double) * tables.size());
+    if (!file) {
+        LOGGING(INFO) << "点积表缓存 " << path << " 不完整，重新计算";
+        return false;
+    }
+
+    uploadInnerProductTable(tables.data(), tableSize, stream);
+    return true;
+}
+
+void SparseSurfelFusion::ComputeVectorField::saveInnerProductTable(const std::string& path, const int tableSize, const double* tables) const
+{
+    const std::string tempPath = path + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            LOGGING(INFO) << "无法写入点积表缓存 " << tempPath;
+            return;
+        }
+        InnerProductTableHeader header;
+        header.magic = INNER_PRODUCT_TABLE_MAGIC;
+        header.version = INNER_PRODUCT_TABLE_VERSION;
+        header.maxDepth = Constants::maxDepth_Host;
+        header.convTimes = CONVTIMES;
+        header.normalize = normalize;
+        header.tableSize = tableSize;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(tables), sizeof(double) * 3 * (size_t)tableSize);
+        if (!file) {
+            file.close();
+            std::remove(tempPath.c_str());
+            LOGGING(INFO) << "写入点积表缓存 " << tempPath << " 失败";
+            return;
+        }
+    }
+    std::remove(path.c_str());      // Windows下rename不会覆盖已存在的文件
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) std::remove(tempPath.c_str());
+}
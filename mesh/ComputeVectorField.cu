@@ -15,30 +15,16 @@ namespace SparseSurfelFusion {
 	}
 }
 
-__device__ float SparseSurfelFusion::device::FCenterWidthPoint(int idx, int i, int j, const ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>& BaseFunctionMaxDepth_d, const Point3D<float>& center, const float& width, const Point3D<float>& point)
+__device__ void SparseSurfelFusion::device::FCenterWidthAxisWeights(const ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>& BaseFunctionMaxDepth_d, const float& center, const float& width, const float& point, float* weight)
 {
-	ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2> thisFunction_X = BaseFunctionMaxDepth_d.shift(center.coords[0]);
-	ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2> thisFunction_Y = BaseFunctionMaxDepth_d.shift(center.coords[1]);
-	ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2> thisFunction_Z = BaseFunctionMaxDepth_d.shift(center.coords[2]);
-	float x = value(thisFunction_X, point.coords[0]);
-	float y = value(thisFunction_Y, point.coords[1]);
-	float z = value(thisFunction_Z, point.coords[2]);
-	float ret = x * y * z;
-	switch (device::normalize) {
-	case 2:
-		ret /= sqrt(1.0 / (1 << (device::maxDepth)));
-		break;
-	case 1:
-		ret /= 1.0 / (1 << (device::maxDepth));
-		break;
+#pragma unroll
+	for (int d = 0; d < 3; d++) {
+		// shift(t)(x) = f(x - t)，直接在平移后的自变量上求值，不必每次重建平移后的多项式
+		weight[d] = value(BaseFunctionMaxDepth_d, point - (center + (d - 1) * width));
 	}
-	//if (/*1000 <= idx && idx < 1100*/idx == 1050) {
-	//	printf("index = %d  (%d, %d)  point = (%.10f, %.10f, %.10f)  o_c = (%.5f, %.5f, %.5f)  ret = %.10f\n", idx, i, j, point.coords[0], point.coords[1], point.coords[2], center.coords[0], center.coords[1], center.coords[2], ret);
-	//}
-	return ret;
 }
 
-__device__ void SparseSurfelFusion::device::getFunctionIdxNode(const int& key, const int& maxDepth, int* index)
+__device__ void SparseSurfelFusion::device::getFunctionIdxNode(const OctKey& key, const int& maxDepth, int* index)
 {
 	// (假设device::maxDepth = 8)
 	index[0] = (1 << device::maxDepth) - 1;	// 初值:00011111111 
@@ -58,50 +44,91 @@ __device__ void SparseSurfelFusion::device::getFunctionIdxNode(const int& key, c
 	}
 }
 
-__global__ void SparseSurfelFusion::device::CalculateVectorFieldKernel(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>* BaseFunctionMaxDepth_Device, DeviceArrayView<OrientedPoint3D<float>> DenseOrientedPoints, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeNum, Point3D<float>* VectorField)
+__global__ void SparseSurfelFusion::device::CalculateVectorFieldKernel(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>* BaseFunctionMaxDepth_Device, DeviceArrayView<OrientedPoint3D<float>> DenseOrientedPoints, DeviceArrayView<int> Point2NodeArray, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DensePointsNum, Point3D<float>* VectorField)
 {
 	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
-	if (idx >= DLevelNodeNum) return;
-	const unsigned int offset = DLevelOffset + idx;
-	int index[3];
-	float width;
-	getFunctionIdxNode(NodeArray[offset].key, device::maxDepth, index);
-	Point3D<float> o_c;
-	BinaryNode<float>::CenterAndWidth(index[0], o_c.coords[0], width);
-	BinaryNode<float>::CenterAndWidth(index[1], o_c.coords[1], width);
-	BinaryNode<float>::CenterAndWidth(index[2], o_c.coords[2], width);
+	const int lane = threadIdx.x & 31;
+	// 越界线程同样参与线程束内的归约，不能提前返回
+	int owner = -1;
+	if (idx < DensePointsNum) {
+		owner = DLevelOffset + Point2NodeArray[idx];
+		const OctNode& ownerNode = NodeArray[owner];
+		if ((int)idx < ownerNode.pidx || (int)idx >= ownerNode.pidx + ownerNode.pnum) owner = -1;	// 只累加节点[pidx, pidx + pnum)覆盖的点
+	}
 
-	//if (5000 <= idx && idx < 5100) {
-	//	printf("index = %d   width = %.7f   o_c(%.7f, %.7f, %.7f)\n", idx, width, o_c.coords[0], o_c.coords[1], o_c.coords[2]);
-	//}
+	float weightX[3] = { 0.0f }, weightY[3] = { 0.0f }, weightZ[3] = { 0.0f };
+	Point3D<float> normal;
+	if (owner >= 0) {
+		int index[3];
+		float width;
+		getFunctionIdxNode(NodeArray[owner].key, device::maxDepth, index);
+		Point3D<float> o_c;
+		BinaryNode<float>::CenterAndWidth(index[0], o_c.coords[0], width);
+		BinaryNode<float>::CenterAndWidth(index[1], o_c.coords[1], width);
+		BinaryNode<float>::CenterAndWidth(index[2], o_c.coords[2], width);
+		const OrientedPoint3D<float> point = DenseOrientedPoints[idx];
+		FCenterWidthAxisWeights(*BaseFunctionMaxDepth_Device, o_c.coords[0], width, point.point.coords[0], weightX);
+		FCenterWidthAxisWeights(*BaseFunctionMaxDepth_Device, o_c.coords[1], width, point.point.coords[1], weightY);
+		FCenterWidthAxisWeights(*BaseFunctionMaxDepth_Device, o_c.coords[2], width, point.point.coords[2], weightZ);
+		float scale = 1.0f;
+		switch (device::normalize) {
+		case 2:
+			scale /= sqrt(1.0 / (1 << (device::maxDepth)));
+			break;
+		case 1:
+			scale /= 1.0 / (1 << (device::maxDepth));
+			break;
+		}
+		normal = point.normal;
+		normal.coords[0] *= scale;
+		normal.coords[1] *= scale;
+		normal.coords[2] *= scale;
+	}
 
-	/** 检查index以及o_c,无误 **/
+	// 同一节点的点连续，距离为delta的前驱属于同一节点即说明中间的点都属于该节点
+	unsigned int sameSegment = 0;		// 第k位表示前驱lane - 2^k与本线程属于同一节点
+#pragma unroll
+	for (int k = 0; k < 5; k++) {
+		const int delta = 1 << k;
+		const int neighborOwner = __shfl_up_sync(0xffffffff, owner, delta);
+		if (lane >= delta && neighborOwner == owner) sameSegment |= (1u << k);
+	}
+	const int nextOwner = __shfl_down_sync(0xffffffff, owner, 1);
+	const bool segmentTail = (lane == 31) || (nextOwner != owner);
+	const bool aggregate = __any_sync(0xffffffff, sameSegment & 1u);	// 线程束内点都属于不同节点时直接原子累加
 
-	Point3D<float> val;
 	for (int i = 0; i < 27; i++) {
-		int neighbor = NodeArray[offset].neighs[i];
-		if (neighbor != -1) {
-			for (int j = 0; j < NodeArray[neighbor].pnum; j++) {
-				int pointIdx = NodeArray[neighbor].pidx + j;	// 在稠密点数组中的位置
-				float weight = FCenterWidthPoint(idx, i, j, *BaseFunctionMaxDepth_Device, o_c, width, DenseOrientedPoints[pointIdx].point);
-				val.coords[0] += weight * DenseOrientedPoints[pointIdx].normal.coords[0];
-				val.coords[1] += weight * DenseOrientedPoints[pointIdx].normal.coords[1];
-				val.coords[2] += weight * DenseOrientedPoints[pointIdx].normal.coords[2];
-				//if (idx == 995) {
-				//	printf("(%d, %d)  pnum = %d  pidx = %d  pointIdx[%d] = (%.10f, %.10f, %.10f, %.10f, %.10f, %.10f)\n", i, j, NodeArray[neighbor].pnum, NodeArray[neighbor].pidx, pointIdx, DenseOrientedPoints[pointIdx].point.coords[0], DenseOrientedPoints[pointIdx].point.coords[1], DenseOrientedPoints[pointIdx].point.coords[2], DenseOrientedPoints[pointIdx].normal.coords[0], DenseOrientedPoints[pointIdx].normal.coords[1], DenseOrientedPoints[pointIdx].normal.coords[2]);
-				//}
+		// 邻居下标 i = 9 * (dx + 1) + 3 * (dy + 1) + (dz + 1)
+		const float weight = weightX[i / 9] * weightY[(i / 3) % 3] * weightZ[i % 3];
+		float sum[3] = { weight * normal.coords[0], weight * normal.coords[1], weight * normal.coords[2] };
+		if (aggregate) {
+#pragma unroll
+			for (int k = 0; k < 5; k++) {
+#pragma unroll
+				for (int c = 0; c < 3; c++) {
+					const float neighborSum = __shfl_up_sync(0xffffffff, sum[c], 1 << k);
+					if (sameSegment & (1u << k)) sum[c] += neighborSum;
+				}
+			}
+		}
+		if (owner >= 0 && segmentTail) {
+			const int neighbor = NodeArray[owner].neighs[i];
+			if (neighbor != -1) {
+				const unsigned int target = neighbor - DLevelOffset;
+				atomicAdd(&VectorField[target].coords[0], sum[0]);
+				atomicAdd(&VectorField[target].coords[1], sum[1]);
+				atomicAdd(&VectorField[target].coords[2], sum[2]);
 			}
 		}
 	}
-
-	VectorField[idx].coords[0] += val.coords[0];
-	VectorField[idx].coords[1] += val.coords[1];
-	VectorField[idx].coords[2] += val.coords[2];
 }
 
-void SparseSurfelFusion::ComputeVectorField::CalculateVectorField(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>* BaseFunctionMaxDepth_Device, DeviceArrayView<OrientedPoint3D<float>> DenseOrientedPoints, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeNum, DeviceBufferArray<Point3D<float>>& VectorField, cudaStream_t stream)
+void SparseSurfelFusion::ComputeVectorField::CalculateVectorField(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>* BaseFunctionMaxDepth_Device, DeviceArrayView<OrientedPoint3D<float>> DenseOrientedPoints, DeviceArrayView<int> Point2NodeArray, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeNum, DeviceBufferArray<Point3D<float>>& VectorField, cudaStream_t stream)
 {
+	CHECKCUDA(cudaMemsetAsync(VectorField.Array().ptr(), 0, sizeof(Point3D<float>) * DLevelNodeNum, stream));
+	const unsigned int DensePointsNum = DenseOrientedPoints.Size();
+	if (DensePointsNum == 0) return;
 	dim3 block(128);
-	dim3 grid(divUp(DLevelNodeNum, block.x));
-	device::CalculateVectorFieldKernel << <grid, block, 0, stream >> > (BaseFunctionMaxDepth_Device, DenseOrientedPoints, NodeArray, DLevelOffset, DLevelNodeNum, VectorField.Array().ptr());
-}
\ No newline at end of file
+	dim3 grid(divUp(DensePointsNum, block.x));
+	device::CalculateVectorFieldKernel << <grid, block, 0, stream >> > (BaseFunctionMaxDepth_Device, DenseOrientedPoints, Point2NodeArray, NodeArray, DLevelOffset, DensePointsNum, VectorField.Array().ptr());
+}
@@ -7,6 +7,8 @@
  *********************************************************************/
 #pragma once
 #include <chrono>
+#include <string>
+#include <vector>
 #include <cuda_runtime_api.h>
 #include <device_launch_parameters.h>
 #include <math/PPolynomial.h>
@@ -18,25 +20,46 @@
 #include "Geometry.h"
 #include "BuildOctree.h"
 #include "BinaryNode.h"
+#include "InnerProductTable.cuh"
+
+#define INNER_PRODUCT_TABLE_MAGIC 0x54505049u	// 点积表缓存文件标识("IPPT")
+#define INNER_PRODUCT_TABLE_VERSION 2			// 点积表缓存格式版本，计算方式变化时递增
 
 namespace SparseSurfelFusion {
 	namespace device {
 
-		__device__ float FCenterWidthPoint(int idx, int i, int j, const ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>& BaseFunctionMaxDepth_d, const Point3D<float>& center, const float& width, const Point3D<float>& point);
+		/**
+		 * \brief 计算点在某一维上相对节点及其前后两个同层邻居的基函数值，weight[d]对应中心center + (d - 1) * width.
+		 *        基函数可分离，节点27邻域的权重均为三维各取一项的乘积，每个点只需在每一维求3次值.
+		 */
+		__device__ void FCenterWidthAxisWeights(const ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>& BaseFunctionMaxDepth_d, const float& center, const float& width, const float& point, float* weight);
 
 		/**
 		 * \brief 对前面对节点进行x,y,z分段编码的内容进行解码.
 		 */
-		__device__ void getFunctionIdxNode(const int& key, const int& maxDepth, int* idx);
+		__device__ void getFunctionIdxNode(const OctKey& key, const int& maxDepth, int* idx);
 
-		__global__ void CalculateVectorFieldKernel(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>* BaseFunctionMaxDepth_Device, DeviceArrayView<OrientedPoint3D<float>> DenseOrientedPoints, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeNum, Point3D<float>* VectorField);
+		/**
+		 * \brief 以点为中心散射向量场：每个线程处理一个稠密点，向其所在D层节点的27个邻居累加权重 * 法向量.
+		 *        同一节点的点在数组中连续，线程束内按节点分段归约后由每段最后一个线程原子累加，
+		 *        工作量只与点数相关，不再因个别节点邻域内点数过多而拖慢整个线程束.
+		 *
+		 * \param BaseFunctionMaxDepth_Device 最大层的基函数
+		 * \param DenseOrientedPoints 稠密有向点
+		 * \param Point2NodeArray 稠密点对应的D层节点(相对D层首节点)
+		 * \param NodeArray 八叉树节点数组
+		 * \param DLevelOffset D层首节点在NodeArray中的偏移
+		 * \param DensePointsNum 稠密点数量
+		 * \param VectorField 【输出】向量场，调用前需清零
+		 */
+		__global__ void CalculateVectorFieldKernel(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>* BaseFunctionMaxDepth_Device, DeviceArrayView<OrientedPoint3D<float>> DenseOrientedPoints, DeviceArrayView<int> Point2NodeArray, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DensePointsNum, Point3D<float>* VectorField);
 	}
 
 	class ComputeVectorField
 	{
 	public:
 
-		ComputeVectorField(cudaStream_t stream);
+		ComputeVectorField(cudaStream_t stream, const ReconstructionConfig& config = ReconstructionConfig());
 
 		~ComputeVectorField();
 
@@ -46,12 +69,13 @@ namespace SparseSurfelFusion {
 		 * \brief 构建VectorField【无阻塞】.
 		 * 
 		 * \param orientedPoints 稠密有向点
+		 * \param Point2NodeArray 稠密点对应的D层节点(相对D层首节点)
 		 * \param NodeArray 八叉树节点数组
 		 * \param NodeArrayCount 每一层节点的数量
 		 * \param BaseAddressArray 每一层首节点的偏移
 		 * \param stream cuda流
 		 */
-		void BuildVectorField(DeviceArrayView<OrientedPoint3D<float>> orientedPoints, DeviceArrayView<OctNode> NodeArray, const int* NodeArrayCount, const int* BaseAddressArray, cudaStream_t stream);
+		void BuildVectorField(DeviceArrayView<OrientedPoint3D<float>> orientedPoints, DeviceArrayView<int> Point2NodeArray, DeviceArrayView<OctNode> NodeArray, const int* NodeArrayCount, const int* BaseAddressArray, cudaStream_t stream);
 
 		/**
 		 * \brief 获得向量场.
@@ -61,25 +85,11 @@ namespace SparseSurfelFusion {
 		DeviceArrayView<Point3D<float>> GetVectorField() { return VectorField.ArrayView(); }
 			
 		/**
-		 * \brief 获得点积表<F, F>.
+		 * \brief 获得紧凑点积表<F, F>、<F, dF>、<F, d2F>的设备端视图.
 		 * 
-		 * \return 点积表<F, F>.
+		 * \return 点积表视图
 		 */
-		DeviceArrayView<double> GetValueTable_Dot_F_F() { return dot_F_F.ArrayView(); }
-
-		/**
-		 * \brief 获得一阶导数点积表<F, dF>.
-		 * 
-		 * \return 一阶导数点积表<F, dF>.
-		 */
-		DeviceArrayView<double> GetValueTable_Dot_F_dF() { return dot_F_DF.ArrayView(); }
-
-		/**
-		 * \brief 获得二阶导数点积表<F, d2F>.
-		 * 
-		 * \return 二阶导数点积表<F, d2F>
-		 */
-		DeviceArrayView<double> GetValueTable_Dot_F_d2F() { return dot_F_D2F.ArrayView(); }
+		const InnerProductTableView& GetInnerProductTable() const { return innerProductTable; }
 		/**
 		 * \brief 获得基函数.
 		 * 
@@ -92,7 +102,7 @@ namespace SparseSurfelFusion {
 
 		PPolynomial<CONVTIMES> ReconstructionFunction;		// 预先计算重建基函数
 
-		void AllocateBuffer();
+		void AllocateBuffer(const ReconstructionConfig& config);
 
 		/**
 		 * \brief 预先计算构建点积表.
@@ -101,10 +111,58 @@ namespace SparseSurfelFusion {
 		 */
 		void BuildInnerProductTable(cudaStream_t stream);
 
+		/**
+		 * \brief 点积表缓存文件头，深度、CONVTIMES、normalize任一不同则缓存失效.
+		 */
+		struct InnerProductTableHeader {
+			unsigned int magic;		// INNER_PRODUCT_TABLE_MAGIC
+			int version;			// INNER_PRODUCT_TABLE_VERSION
+			int maxDepth;			// 八叉树最大深度
+			int convTimes;			// 基函数卷积次数
+			int normalize;			// 基函数归一化方式
+			int tableSize;			// 每张紧凑点积表的元素数量
+		};
+
+		std::string tableCacheDirectory;	// 点积表缓存目录，为空则不缓存
+
+		/**
+		 * \brief 点积表缓存文件路径，文件名包含深度、CONVTIMES与normalize.
+		 */
+		std::string innerProductTablePath() const;
+
+		/**
+		 * \brief 读取缓存的点积表并上传，文件不存在或参数不匹配时返回false.
+		 *
+		 * \param path 缓存文件路径
+		 * \param tableSize 每张表的元素数量
+		 * \param stream cuda流
+		 * \return 是否命中缓存
+		 */
+		bool loadInnerProductTable(const std::string& path, const int tableSize, cudaStream_t stream);
+
+		/**
+		 * \brief 将三张连续存放的紧凑点积表上传到显存.
+		 *
+		 * \param tables 依次存放<F, F>、<F, dF>、<F, d2F>的Host端表
+		 * \param tableSize 每张表的元素数量
+		 * \param stream cuda流
+		 */
+		void uploadInnerProductTable(const double* tables, const int tableSize, cudaStream_t stream);
+
+		/**
+		 * \brief 将点积表写入缓存(先写临时文件再重命名，避免并发启动的进程读到不完整文件).
+		 *
+		 * \param path 缓存文件路径
+		 * \param tableSize 每张表的元素数量
+		 * \param tables 依次存放<F, F>、<F, dF>、<F, d2F>的Host端表
+		 */
+		void saveInnerProductTable(const std::string& path, const int tableSize, const double* tables) const;
+
 
 		DeviceBufferArray<double> dot_F_F; 	   // 基函数的点积表
 		DeviceBufferArray<double> dot_F_DF;	   // 基函数一阶导数的点积表
 		DeviceBufferArray<double> dot_F_D2F;   // 基函数二阶导数的点积表
+		InnerProductTableView innerProductTable;	// 紧凑点积表的分段与设备端指针
 		DeviceBufferArray<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions_Device;		// 基函数拷贝到GPU
 		DeviceBufferArray<ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>> BaseFunctionMaxDepth_Device;	// 最大层的基函数【基函数每一层[0, maxDepth]都放缩，每一层的节点都有与之匹配的基函数匹配】
 		DeviceBufferArray<Point3D<float>> VectorField;	// 向量流(有1‰的误差)
@@ -114,13 +172,14 @@ namespace SparseSurfelFusion {
 		 *
 		 * \param BaseFunctionMaxDepth_Device 最大层的基函数
 		 * \param DenseOrientedPoints 稠密有向点
+		 * \param Point2NodeArray 稠密点对应的D层节点(相对D层首节点)
 		 * \param NodeArray 八叉树节点数组
 		 * \param DLevelOffset D层首节点在NodeArray中的偏移
 		 * \param DLevelNodeNum D层节点数量
 		 * \param VectorField 向量场
 		 * \param stream cuda流
 		 */
-		void CalculateVectorField(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>* BaseFunctionMaxDepth_Device, DeviceArrayView<OrientedPoint3D<float>> DenseOrientedPoints, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeNum, DeviceBufferArray<Point3D<float>>& VectorField, cudaStream_t stream);
+		void CalculateVectorField(ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>* BaseFunctionMaxDepth_Device, DeviceArrayView<OrientedPoint3D<float>> DenseOrientedPoints, DeviceArrayView<int> Point2NodeArray, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const unsigned int DLevelNodeNum, DeviceBufferArray<Point3D<float>>& VectorField, cudaStream_t stream);
 	};
 }
 
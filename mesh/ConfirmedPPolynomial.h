@@ -1,13 +1,14 @@
 #pragma once
 #include <math/PPolynomial.h>
-#include <cuda_runtime_api.h>
-#include <device_launch_parameters.h>
+#include <base/HostDeviceCompat.h>
 
 namespace SparseSurfelFusion {
     template<int Degree, int PolyCount>
     class ConfirmedPPolynomial {
     public:
         StartingPolynomial<Degree> polys[PolyCount];
+        float merged[PolyCount][Degree + 1];    // 第i个区间[polys[i].start, polys[i + 1].start)上的多项式：前i + 1段多项式之和，由mergePieces预先合并
+
         __host__ __device__ ConfirmedPPolynomial(void) {
             for (int i = 0; i < PolyCount; ++i) {
                 polys[i].start = 0;
@@ -15,11 +16,29 @@ namespace SparseSurfelFusion {
                     polys[i].p.coefficients[j] = 0;
                 }
             }
+            mergePieces();
         }
 
         __host__ __device__ ConfirmedPPolynomial(const ConfirmedPPolynomial& cpy) {
-            for (int i = 0; i < PolyCount; ++i)
+            for (int i = 0; i < PolyCount; ++i) {
                 polys[i] = cpy.polys[i];
+                for (int j = 0; j <= Degree; ++j) {
+                    merged[i][j] = cpy.merged[i][j];
+                }
+            }
+        }
+
+        /**
+         * \brief 按区间合并各段多项式：merged[i] = polys[0].p + ... + polys[i].p，修改polys之后须重新调用.
+         */
+        __host__ __device__ void mergePieces() {
+            for (int j = 0; j <= Degree; ++j) {
+                float sum = 0;
+                for (int i = 0; i < PolyCount; ++i) {
+                    sum += polys[i].p.coefficients[j];
+                    merged[i][j] = sum;
+                }
+            }
         }
 
         __host__ __device__ ~ConfirmedPPolynomial(void) = default;
@@ -38,6 +57,7 @@ namespace SparseSurfelFusion {
                     }
                 }
             }
+            ret.mergePieces();
             return ret;
         }
 
@@ -50,6 +70,13 @@ namespace SparseSurfelFusion {
                 }
                 //            polys[i]=cpy.polys[i];
             }
+            for (int i = tp; i < PolyCount; ++i) {      // 多出的段不参与求值(value在第一个不满足val > start的段处停止)
+                polys[i].start = 0;
+                for (int j = 0; j <= Degree; j++) {
+                    polys[i].p.coefficients[j] = 0;
+                }
+            }
+            mergePieces();
         }
 
         __host__ __device__ ConfirmedPPolynomial& operator =(const PPolynomial<Degree>& cpy) {
@@ -61,23 +88,65 @@ namespace SparseSurfelFusion {
                 }
                 //            polys[i]=cpy.polys[i];
             }
+            for (int i = tp; i < PolyCount; ++i) {
+                polys[i].start = 0;
+                for (int j = 0; j <= Degree; j++) {
+                    polys[i].p.coefficients[j] = 0;
+                }
+            }
+            mergePieces();
             return *this;
         }
 
     };
 
+    /**
+     * \brief 无分支地选出val所在的区间：起点依次小于val的前缀段数，0表示val不在任何一段上(含val为NaN).
+     */
     template<int Degree, int PolyCount>
-    __device__ float value(const ConfirmedPPolynomial<Degree, PolyCount>& cp, const float& val) {
-        float res = 0;
-        for (int i = 0; i < PolyCount && val > cp.polys[i].start; ++i)  {
-            float temp = 1;
-            float v = 0;
-            for (int j = 0; j <= Degree; ++j) {
-                v += temp * cp.polys[i].p.coefficients[j];
-                temp *= val;
-            }
-            res += v;
+    __host__ __device__ __forceinline__ int activePieceCount(const ConfirmedPPolynomial<Degree, PolyCount>& cp, const float val) {
+        int count = 0;
+        bool active = true;
+#pragma unroll
+        for (int i = 0; i < PolyCount; ++i) {
+            active = active && (val > cp.polys[i].start);
+            count += active ? 1 : 0;
+        }
+        return count;
+    }
+
+    template<int Degree, int PolyCount>
+    __host__ __device__ float value(const ConfirmedPPolynomial<Degree, PolyCount>& cp, const float& val) {
+        const int count = activePieceCount(cp, val);
+        const float* coefficients = cp.merged[count > 0 ? count - 1 : 0];
+        float res = coefficients[Degree];
+#pragma unroll
+        for (int j = Degree - 1; j >= 0; --j) {
+            res = fmaf(res, val, coefficients[j]);      // Horner
+        }
+        return count > 0 ? res : 0.0f;
+    }
+
+    /**
+     * \brief 一次Horner同时求分段多项式的值与导数.
+     *
+     * \param cp 分段多项式
+     * \param val 自变量
+     * \param derivative 【输出】导数值
+     * \return 函数值
+     */
+    template<int Degree, int PolyCount>
+    __host__ __device__ float valueAndDerivative(const ConfirmedPPolynomial<Degree, PolyCount>& cp, const float& val, float& derivative) {
+        const int count = activePieceCount(cp, val);
+        const float* coefficients = cp.merged[count > 0 ? count - 1 : 0];
+        float res = coefficients[Degree];
+        float d = 0.0f;
+#pragma unroll
+        for (int j = Degree - 1; j >= 0; --j) {
+            d = fmaf(d, val, res);
+            res = fmaf(res, val, coefficients[j]);
         }
-        return res;
+        derivative = count > 0 ? d : 0.0f;
+        return count > 0 ? res : 0.0f;
     }
 }
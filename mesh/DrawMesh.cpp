@@ -12,12 +12,19 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 	glViewport(0, 0, width, height);															// 设置视口
 }
 
-SparseSurfelFusion::DrawMesh::DrawMesh()
+SparseSurfelFusion::DrawMesh::DrawMesh(const ReconstructionConfig& config)
 {
-	VerticesAverageNormals.AllocateBuffer(MAX_SURFEL_COUNT);
-	VerticesAverageColors.AllocateBuffer(MAX_SURFEL_COUNT);
-	MeshVertices.AllocateBuffer(MAX_SURFEL_COUNT);
-	MeshTriangleIndices.AllocateBuffer(MAX_MESH_TRIANGLE_COUNT);
+	for (int i = 0; i < DRAW_MESH_SLOT_NUM; i++) {
+		Slots[i].VerticesAverageNormals.AllocateBuffer(config.maxSurfelCount);
+		Slots[i].VerticesAverageColors.AllocateBuffer(config.maxSurfelCount);
+		Slots[i].MeshVertices.AllocateBuffer(config.maxSurfelCount);
+		Slots[i].MeshTriangleIndices.AllocateBuffer(config.maxMeshTriangleCount);
+		Slots[i].DrawCommand.AllocateBuffer(1);
+		Slots[i].DrawCommand.ResizeArrayOrException(1);
+		CHECKCUDA(cudaMemset(Slots[i].DrawCommand.Ptr(), 0, sizeof(DrawElementsIndirectCommand)));
+	}
+	ColorCacheRecomputedCount.AllocateBuffer(1);
+	ColorCacheRecomputedCount.ResizeArrayOrException(1);
 
 	int glfwSate = glfwInit();
 	if (glfwSate == GLFW_FALSE)
@@ -69,42 +76,87 @@ SparseSurfelFusion::DrawMesh::DrawMesh()
 
 	meshShader.Compile(vertexShaderPath, fragmentShaderPath);
 	initialCoordinateSystem();
-	registerCudaResources();
+	for (int i = 0; i < DRAW_MESH_SLOT_NUM; i++) registerCudaResources(Slots[i]);
 }
 
 SparseSurfelFusion::DrawMesh::~DrawMesh()
 {
-	VerticesAverageNormals.ReleaseBuffer();
-	VerticesAverageColors.ReleaseBuffer();
-	MeshVertices.ReleaseBuffer();
-	MeshTriangleIndices.ReleaseBuffer();
-
-
-	glDeleteVertexArrays(1, &GeometryVAO);
-	glDeleteBuffers(1, &GeometryVBO);
-	glDeleteBuffers(1, &GeometryIBO);
+	for (int i = 0; i < DRAW_MESH_SLOT_NUM; i++) {
+		Slots[i].VerticesAverageNormals.ReleaseBuffer();
+		Slots[i].VerticesAverageColors.ReleaseBuffer();
+		Slots[i].MeshVertices.ReleaseBuffer();
+		Slots[i].MeshTriangleIndices.ReleaseBuffer();
+		Slots[i].DrawCommand.ReleaseBuffer();
+
+		if (Slots[i].mapped) unmapFromCuda(Slots[i]);
+		CHECKCUDA(cudaGraphicsUnregisterResource(Slots[i].cudaVBOResources));
+		CHECKCUDA(cudaGraphicsUnregisterResource(Slots[i].cudaIBOResources));
+		CHECKCUDA(cudaGraphicsUnregisterResource(Slots[i].cudaIndirectResources));
+		glDeleteVertexArrays(1, &Slots[i].GeometryVAO);
+		glDeleteBuffers(1, &Slots[i].GeometryVBO);
+		glDeleteBuffers(1, &Slots[i].GeometryIBO);
+		glDeleteBuffers(1, &Slots[i].GeometryIndirectBO);
+	}
+	for (int i = 0; i < 2; i++) {
+		ColorCacheKeys[i].ReleaseBuffer();
+		ColorCacheSignature[i].ReleaseBuffer();
+		ColorCacheCornerColors[i].ReleaseBuffer();
+	}
+	NodeColorSignature.ReleaseBuffer();
+	ColorCacheRecomputedCount.ReleaseBuffer();
 }
 
 void SparseSurfelFusion::DrawMesh::setInput(DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<TriangleIndex> meshTriangleIndices, DeviceArrayView<OrientedPoint3D<float>> samplePoints)
 {
-	TranglesCount = meshTriangleIndices.Size();
-	VerticesCount = meshVertices.Size();
+	RenderSlot& slot = Slots[WriteSlot];
+	slot.TranglesCount = meshTriangleIndices.Size();
+	slot.VerticesCount = meshVertices.Size();
 	DensePointsCount = samplePoints.Size();
-	MeshVertices.ResizeArrayOrException(VerticesCount);
-	VerticesAverageColors.ResizeArrayOrException(VerticesCount);
-	MeshTriangleIndices.ResizeArrayOrException(TranglesCount);
+	slot.MeshVertices.ResizeArrayOrException(slot.VerticesCount);
+	slot.VerticesAverageColors.ResizeArrayOrException(slot.VerticesCount);
+	slot.MeshTriangleIndices.ResizeArrayOrException(slot.TranglesCount);
+}
+
+SparseSurfelFusion::MeshOutputSink SparseSurfelFusion::DrawMesh::MapOutputSink(cudaStream_t stream)
+{
+	glfwMakeContextCurrent(window);
+
+	RenderSlot& slot = Slots[WriteSlot];
+	mapSlotResources(slot, stream);		// 映射保证之前发出的OpenGL命令在stream上之后的写入前完成
+	slot.sinkOutput = true;
+
+	MeshOutputSink sink;
+	sink.vertices = slot.mappedVBO;								// 位置属性位于VBO起始处
+	sink.vertexCapacity = Constants::maxSurfelsNum;
+	sink.triangles = slot.mappedIBO;
+	sink.triangleCapacity = Constants::maxMeshTrianglesNum;
+	return sink;
 }
 
 void SparseSurfelFusion::DrawMesh::DrawRenderedMesh(cudaStream_t stream)
+{
+	UploadRenderedMesh(stream);
+	DrawSlotMesh(WriteSlot);
+}
+
+void SparseSurfelFusion::DrawMesh::UploadRenderedMesh(cudaStream_t stream)
+{
+	glfwMakeContextCurrent(window);
+
+	RenderSlot& slot = Slots[WriteSlot];
+	mapToCuda(slot, stream);
+	unmapFromCuda(slot, stream);	// 解除映射后，之后发出的OpenGL命令在stream上的拷贝完成后才执行
+	slot.uploaded = true;
+}
+
+void SparseSurfelFusion::DrawMesh::DrawSlotMesh(const int slot)
 {
 	glfwMakeContextCurrent(window);
 
-	mapToCuda(MeshVertices.ArrayView(), MeshTriangleIndices.ArrayView(), stream);
 	clearWindow();
-	drawMesh(view, projection, model);
+	drawMesh(Slots[slot], view, projection, model);
 	drawCoordinateSystem(view, projection, model);
 	swapBufferAndCatchEvent();
-	unmapFromCuda(stream);
 }
 
 
@@ -143,17 +195,17 @@ void SparseSurfelFusion::DrawMesh::initialCoordinateSystem()
 	glBindVertexArray(0);						// 解绑VAO
 }
 
-void SparseSurfelFusion::DrawMesh::registerCudaResources()
+void SparseSurfelFusion::DrawMesh::registerCudaResources(RenderSlot& slot)
 {
 	glfwMakeContextCurrent(window);
 
-	glGenVertexArrays(1, &GeometryVAO);	// 生成VAO
-	glBindVertexArray(GeometryVAO);		// 绑定VAO
+	glGenVertexArrays(1, &slot.GeometryVAO);	// 生成VAO
+	glBindVertexArray(slot.GeometryVAO);		// 绑定VAO
 
-	glGenBuffers(1, &GeometryVBO);		// 生成VBO
-	glGenBuffers(1, &GeometryIBO);		// 创建1个IBO，并将标识符存储在IBO变量中
+	glGenBuffers(1, &slot.GeometryVBO);		// 生成VBO
+	glGenBuffers(1, &slot.GeometryIBO);		// 创建1个IBO，并将标识符存储在IBO变量中
 
-	glBindBuffer(GL_ARRAY_BUFFER, GeometryVBO);	// 绑定VBO
+	glBindBuffer(GL_ARRAY_BUFFER, slot.GeometryVBO);	// 绑定VBO
 
 	// x,y,z,nx,ny,nz,r,g,b = 9个GLfloat
 	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * Constants::maxSurfelsNum * 9, NULL, GL_DYNAMIC_DRAW);
@@ -161,7 +213,7 @@ void SparseSurfelFusion::DrawMesh::registerCudaResources()
 	glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * Constants::maxSurfelsNum * 3, sizeof(GLfloat) * Constants::maxSurfelsNum * 3, NULL);	// 分批加载属性数组
 	glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * Constants::maxSurfelsNum * 6, sizeof(GLfloat) * Constants::maxSurfelsNum * 3, NULL);	// 分批加载属性数组
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GeometryIBO);																	// 将EBO绑定到GL_ELEMENT_ARRAY_BUFFER目标
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, slot.GeometryIBO);																	// 将EBO绑定到GL_ELEMENT_ARRAY_BUFFER目标
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * Constants::maxMeshTrianglesNum * 3, NULL, GL_DYNAMIC_DRAW);	// 将索引数据从CPU传输到GPU，绘制顶点还需要索引数组
 
 	// 位置
@@ -177,35 +229,57 @@ void SparseSurfelFusion::DrawMesh::registerCudaResources()
 	glBindBuffer(GL_ARRAY_BUFFER, 0);			// 解绑VBO
 	glBindVertexArray(0);						// 解绑VAO
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// 解绑IBO
-	CHECKCUDA(cudaGraphicsGLRegisterBuffer(&cudaVBOResources, GeometryVBO, cudaGraphicsRegisterFlagsNone));
-	CHECKCUDA(cudaGraphicsGLRegisterBuffer(&cudaIBOResources, GeometryIBO, cudaGraphicsRegisterFlagsNone));
+
+	// 间接绘制命令由CUDA写入，绘制时直接从缓冲读取索引数量
+	glGenBuffers(1, &slot.GeometryIndirectBO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, slot.GeometryIndirectBO);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	CHECKCUDA(cudaGraphicsGLRegisterBuffer(&slot.cudaVBOResources, slot.GeometryVBO, cudaGraphicsRegisterFlagsWriteDiscard));	// CUDA每次整体覆盖写入
+	CHECKCUDA(cudaGraphicsGLRegisterBuffer(&slot.cudaIBOResources, slot.GeometryIBO, cudaGraphicsRegisterFlagsWriteDiscard));
+	CHECKCUDA(cudaGraphicsGLRegisterBuffer(&slot.cudaIndirectResources, slot.GeometryIndirectBO, cudaGraphicsRegisterFlagsWriteDiscard));
 }
 
-void SparseSurfelFusion::DrawMesh::mapToCuda(DeviceArrayView<Point3D<float>> MeshVertices, DeviceArrayView<TriangleIndex> MeshTriangleIndices, cudaStream_t stream)
+void SparseSurfelFusion::DrawMesh::mapSlotResources(RenderSlot& slot, cudaStream_t stream)
 {
-	CHECKCUDA(cudaGraphicsMapResources(1, &cudaVBOResources, stream));	//首先映射资源
-	CHECKCUDA(cudaGraphicsMapResources(1, &cudaIBOResources, stream));	//首先映射资源
+	if (slot.mapped) return;
+	CHECKCUDA(cudaGraphicsMapResources(1, &slot.cudaVBOResources, stream));	//首先映射资源
+	CHECKCUDA(cudaGraphicsMapResources(1, &slot.cudaIBOResources, stream));	//首先映射资源
+	CHECKCUDA(cudaGraphicsMapResources(1, &slot.cudaIndirectResources, stream));
 
-	// 获得buffer
-	Point3D<float>* ptr = NULL;			// 用于获取cuda资源的地址(重复使用)
 	size_t bufferSize = 0;				// 用于获取cuda资源buffer的大小
 	// 获得OpenGL上的资源指针
-	CHECKCUDA(cudaGraphicsResourceGetMappedPointer(reinterpret_cast<void**>(&ptr), &bufferSize, cudaVBOResources));
-	CHECKCUDA(cudaMemcpyAsync(ptr, MeshVertices.RawPtr(), sizeof(Point3D<float>) * VerticesCount, cudaMemcpyDeviceToDevice, stream));
-	CHECKCUDA(cudaMemcpyAsync(ptr + Constants::maxSurfelsNum, VerticesAverageNormals.Ptr(), sizeof(Point3D<float>) * VerticesCount, cudaMemcpyDeviceToDevice, stream));
-	CHECKCUDA(cudaMemcpyAsync(ptr + 2 * Constants::maxSurfelsNum, VerticesAverageColors.Ptr(), sizeof(Point3D<float>) * VerticesCount, cudaMemcpyDeviceToDevice, stream));
-
-	unsigned int* idxPtr = NULL;
-	size_t idxBufferSize = 0;
-	CHECKCUDA(cudaGraphicsResourceGetMappedPointer(reinterpret_cast<void**>(&idxPtr), &idxBufferSize, cudaIBOResources));
-	CHECKCUDA(cudaMemcpyAsync(idxPtr, MeshTriangleIndices.RawPtr(), sizeof(TriangleIndex) * TranglesCount, cudaMemcpyDeviceToDevice, stream));
-	CHECKCUDA(cudaStreamSynchronize(stream));
+	CHECKCUDA(cudaGraphicsResourceGetMappedPointer(reinterpret_cast<void**>(&slot.mappedVBO), &bufferSize, slot.cudaVBOResources));
+	CHECKCUDA(cudaGraphicsResourceGetMappedPointer(reinterpret_cast<void**>(&slot.mappedIBO), &bufferSize, slot.cudaIBOResources));
+	CHECKCUDA(cudaGraphicsResourceGetMappedPointer(reinterpret_cast<void**>(&slot.mappedIndirect), &bufferSize, slot.cudaIndirectResources));
+	slot.mapped = true;
+}
+
+void SparseSurfelFusion::DrawMesh::mapToCuda(RenderSlot& slot, cudaStream_t stream)
+{
+	mapSlotResources(slot, stream);
+
+	Point3D<float>* ptr = slot.mappedVBO;
+	if (!slot.sinkOutput) {		// 网格已由输出槽直接写入时不需要拷贝顶点与索引
+		CHECKCUDA(cudaMemcpyAsync(ptr, slot.MeshVertices.Ptr(), sizeof(Point3D<float>) * slot.VerticesCount, cudaMemcpyDeviceToDevice, stream));
+		CHECKCUDA(cudaMemcpyAsync(slot.mappedIBO, slot.MeshTriangleIndices.Ptr(), sizeof(TriangleIndex) * slot.TranglesCount, cudaMemcpyDeviceToDevice, stream));
+	}
+	CHECKCUDA(cudaMemcpyAsync(ptr + Constants::maxSurfelsNum, slot.VerticesAverageNormals.Ptr(), sizeof(Point3D<float>) * slot.VerticesCount, cudaMemcpyDeviceToDevice, stream));
+	CHECKCUDA(cudaMemcpyAsync(ptr + 2 * Constants::maxSurfelsNum, slot.VerticesAverageColors.Ptr(), sizeof(Point3D<float>) * slot.VerticesCount, cudaMemcpyDeviceToDevice, stream));
+	CHECKCUDA(cudaMemcpyAsync(slot.mappedIndirect, slot.DrawCommand.Ptr(), sizeof(DrawElementsIndirectCommand), cudaMemcpyDeviceToDevice, stream));
 }
 
-void SparseSurfelFusion::DrawMesh::unmapFromCuda(cudaStream_t stream)
+void SparseSurfelFusion::DrawMesh::unmapFromCuda(RenderSlot& slot, cudaStream_t stream)
 {
-	CHECKCUDA(cudaGraphicsUnmapResources(1, &cudaVBOResources, stream));
-	CHECKCUDA(cudaGraphicsUnmapResources(1, &cudaIBOResources, stream));
+	CHECKCUDA(cudaGraphicsUnmapResources(1, &slot.cudaVBOResources, stream));
+	CHECKCUDA(cudaGraphicsUnmapResources(1, &slot.cudaIBOResources, stream));
+	CHECKCUDA(cudaGraphicsUnmapResources(1, &slot.cudaIndirectResources, stream));
+	slot.mappedVBO = NULL;
+	slot.mappedIBO = NULL;
+	slot.mappedIndirect = NULL;
+	slot.mapped = false;
+	slot.sinkOutput = false;
 }
 
 void SparseSurfelFusion::DrawMesh::clearWindow()
@@ -216,7 +290,7 @@ void SparseSurfelFusion::DrawMesh::clearWindow()
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);// 现在同时清除深度缓冲区!(不清除深度画不出来立体图像)
 }
 
-void SparseSurfelFusion::DrawMesh::drawMesh(glm::mat4& view, glm::mat4& projection, glm::mat4& model)
+void SparseSurfelFusion::DrawMesh::drawMesh(const RenderSlot& slot, glm::mat4& view, glm::mat4& projection, glm::mat4& model)
 {
 	// 激活着色器
 	meshShader.BindProgram(); //renderer构造时已经编译
@@ -240,9 +314,11 @@ void SparseSurfelFusion::DrawMesh::drawMesh(glm::mat4& view, glm::mat4& projecti
 	model = glm::rotate(model, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));//绕Up向量(0,1,0)旋转
 	meshShader.setUniformMat4(std::string("model"), model);
 
-	glBindVertexArray(GeometryVAO); // 绑定VAO后绘制
-	glDrawElements(GL_TRIANGLES, TranglesCount * 3, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(slot.GeometryVAO); // 绑定VAO后绘制
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, slot.GeometryIndirectBO);
+	glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0);	// 索引数量由设备端写入的绘制命令给出
 	// 清除绑定
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 	glBindVertexArray(0);
 	meshShader.UnbindProgram();
 }
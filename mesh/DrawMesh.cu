@@ -77,6 +77,80 @@ __device__ __forceinline__ void SparseSurfelFusion::device::bruteForceSearch4KNN
 	}
 }
 
+__device__ int SparseSurfelFusion::device::searchLevelNodeByKey(DeviceArrayView<OctNode> NodeArray, int left, int right, const OctKey key)
+{
+	while (left < right) {
+		const int mid = (left + right) >> 1;
+		const OctKey midKey = NodeArray[mid].key;
+		if (midKey == key) return mid;
+		else if (midKey < key) left = mid + 1;
+		else right = mid;
+	}
+	return -1;
+}
+
+__device__ SparseSurfelFusion::OctKey SparseSurfelFusion::device::computeMaxDepthKey(const float3& vertex, float3& center)
+{
+	// 与device::computePointCode相同的编码规则计算顶点在maxDepth层的key
+	OctKey key = 0;
+	float3 myCenter = make_float3(0.5f, 0.5f, 0.5f);
+	float myWidth = 0.25f;
+	for (int i = MAX_DEPTH_OCTREE - 1; i >= 0; i--) {
+		if (vertex.x > myCenter.x) { key |= OctKey(1) << (3 * i + 2); myCenter.x += myWidth; }
+		else { myCenter.x -= myWidth; }
+		if (vertex.y > myCenter.y) { key |= OctKey(1) << (3 * i + 1); myCenter.y += myWidth; }
+		else { myCenter.y -= myWidth; }
+		if (vertex.z > myCenter.z) { key |= OctKey(1) << (3 * i); myCenter.z += myWidth; }
+		else { myCenter.z -= myWidth; }
+		myWidth /= 2.0f;
+	}
+	center = myCenter;
+	return key;
+}
+
+__device__ int SparseSurfelFusion::device::neighborhoodPointCount(DeviceArrayView<OctNode> NodeArray, const int node)
+{
+	int candidateCount = 0;
+	for (int i = 0; i < 27; i++) {
+		const int neighbor = NodeArray[node].neighs[i];
+		if (neighbor != -1) candidateCount += NodeArray[neighbor].pnum;
+	}
+	return candidateCount;
+}
+
+__device__ void SparseSurfelFusion::device::neighborhoodSearch4KNN(const float3& vertex, DeviceArrayView<OctNode> NodeArray, const int node, DeviceArrayView<OrientedPoint3D<float>> samplePoint, float4& distance, uint4& sampleIndex)
+{
+	KnnHeapDevice heap(distance, sampleIndex);
+	for (int i = 0; i < 27; i++) {
+		const int neighbor = NodeArray[node].neighs[i];
+		if (neighbor == -1) continue;
+		const int pidx = NodeArray[neighbor].pidx;
+		const int pnum = NodeArray[neighbor].pnum;
+		for (int k = pidx; k < pidx + pnum; k++) {
+			const float dx = vertex.x - samplePoint[k].point.coords[0];
+			const float dy = vertex.y - samplePoint[k].point.coords[1];
+			const float dz = vertex.z - samplePoint[k].point.coords[2];
+			heap.update(k, __fmaf_rn(dz, dz, __fmaf_rn(dy, dy, __fmul_rn(dx, dx))));
+		}
+	}
+}
+
+__device__ void SparseSurfelFusion::device::octreeSearch4KNN(const float3& vertex, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, DeviceArrayView<OrientedPoint3D<float>> samplePoint, float4& distance, uint4& sampleIndex)
+{
+	float3 center;
+	const OctKey key = computeMaxDepthKey(vertex, center);
+	for (int depth = MAX_DEPTH_OCTREE; depth >= 0; depth--) {
+		const OctKey levelKey = key & ~((OctKey(1) << (3 * (MAX_DEPTH_OCTREE - depth))) - 1);	// 清零比当前层更细的编码位
+		const int left = BaseAddressArray[depth];
+		const int right = depth == MAX_DEPTH_OCTREE ? NodeArray.Size() : BaseAddressArray[depth + 1];
+		const int node = searchLevelNodeByKey(NodeArray, left, right, levelKey);
+		if (node == -1) continue;	// 该层没有顶点所在的节点(空节点的兄弟不存在)，退到父层
+		if (neighborhoodPointCount(NodeArray, node) < 4 && depth > 0) continue;	// 邻域内稠密点不足4个，退到父层扩大搜索范围
+		neighborhoodSearch4KNN(vertex, NodeArray, node, samplePoint, distance, sampleIndex);
+		return;
+	}
+}
+
 __device__ float3 SparseSurfelFusion::device::VectorNormalize(const float3& normal)
 {
 	float3 result;
@@ -99,13 +173,11 @@ __device__ float3 SparseSurfelFusion::device::CrossProduct(const float3& Vector_
 	return result;
 }
 
-__global__ void SparseSurfelFusion::device::CalculateMeshNormalsKernel(const Point3D<float>* verticesArray, const TriangleIndex* indicesArray, const unsigned int meshCount, Point3D<float>* normalsArray)
+__device__ float3 SparseSurfelFusion::device::TriangleNormal(DeviceArrayView<Point3D<float>> verticesArray, const TriangleIndex& triangle)
 {
-	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-	if (idx >= meshCount) return;
-	Point3D<float> Point_O = verticesArray[indicesArray[idx].idx[0]];
-	Point3D<float> Point_A = verticesArray[indicesArray[idx].idx[1]];
-	Point3D<float> Point_B = verticesArray[indicesArray[idx].idx[2]];
+	const Point3D<float> Point_O = verticesArray[triangle.idx[0]];
+	const Point3D<float> Point_A = verticesArray[triangle.idx[1]];
+	const Point3D<float> Point_B = verticesArray[triangle.idx[2]];
 	float3 Vector_OA, Vector_OB;
 
 	Vector_OA.x = Point_A.coords[0] - Point_O.coords[0];
@@ -116,78 +188,11 @@ __global__ void SparseSurfelFusion::device::CalculateMeshNormalsKernel(const Poi
 	Vector_OB.y = Point_B.coords[1] - Point_O.coords[1];
 	Vector_OB.z = Point_B.coords[2] - Point_O.coords[2];
 
-	float3 Normal = CrossProduct(Vector_OA, Vector_OB);
-	float3 normalizedNormal = VectorNormalize(Normal);
-	normalsArray[idx].coords[0] = normalizedNormal.x;
-	normalsArray[idx].coords[1] = normalizedNormal.y;
-	normalsArray[idx].coords[2] = normalizedNormal.z;
-}
-
-__global__ void SparseSurfelFusion::device::CountConnectedTriangleNumKernel(const TriangleIndex* indicesArray, const unsigned int meshCount, unsigned int* ConnectedTriangleNum)
-{
-	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-	if (idx >= meshCount) return;
-	atomicAdd(&ConnectedTriangleNum[indicesArray[idx].idx[0]], 1);
-	atomicAdd(&ConnectedTriangleNum[indicesArray[idx].idx[1]], 1);
-	atomicAdd(&ConnectedTriangleNum[indicesArray[idx].idx[2]], 1);
-}
-
-__global__ void SparseSurfelFusion::device::VerticesNormalsSumKernel(const Point3D<float>* meshNormals, const TriangleIndex* indicesArray, const unsigned int meshCount, Point3D<float>* VerticesNormalsSum)
-{
-	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-	if (idx >= meshCount)	return;
-	// 三角mesh的每一个顶点都应该加上其法线
-	// 三角面元的第一个顶点
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[0]].coords[0], meshNormals[idx].coords[0]);
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[0]].coords[1], meshNormals[idx].coords[1]);
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[0]].coords[2], meshNormals[idx].coords[2]);
-	// 三角面元的第二个顶点
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[1]].coords[0], meshNormals[idx].coords[0]);
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[1]].coords[1], meshNormals[idx].coords[1]);
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[1]].coords[2], meshNormals[idx].coords[2]);
-	// 三角面元的第三个顶点
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[2]].coords[0], meshNormals[idx].coords[0]);
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[2]].coords[1], meshNormals[idx].coords[1]);
-	atomicAdd(&VerticesNormalsSum[indicesArray[idx].idx[2]].coords[2], meshNormals[idx].coords[2]);
-}
-
-__global__ void SparseSurfelFusion::device::CalculateVerticesAverageNormals(const unsigned int* ConnectedTriangleNum, const Point3D<float>* VerticesNormalsSum, const unsigned int verticesCount, Point3D<float>* VerticesAverageNormals)
-{
-	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-	if (idx >= verticesCount)	return;
-	int meshCount = ConnectedTriangleNum[idx];
-	float AverageNormalX = VerticesNormalsSum[idx].coords[0] / meshCount;
-	float AverageNormalY = VerticesNormalsSum[idx].coords[1] / meshCount;
-	float AverageNormalZ = VerticesNormalsSum[idx].coords[2] / meshCount;
-	//if (meshCount == 0) printf("Error = %d\n", idx);
-	//if (idx % 1000 == 0) printf("meshCount[%d] = %d\n", idx, meshCount);
-	//if (idx % 100 == 0) printf("ScaledVerticesNormalsSum[%d] = (%.10f, %.10f, %.10f)\n", idx, ScaledVerticesNormalsSum[idx].coords[0], ScaledVerticesNormalsSum[idx].coords[1], ScaledVerticesNormalsSum[idx].coords[2]);
-	//if (idx % 1000 == 0) printf("AverageNormals[%d] = (%.10f, %.10f, %.10f)\n", idx, AverageNormalX, AverageNormalY, AverageNormalZ);
-	
-	float3 averageNormal;
-	averageNormal.x = AverageNormalX;
-	averageNormal.y = AverageNormalY;
-	averageNormal.z = AverageNormalZ;
-
-	float3 NormalizedAverageNormal = VectorNormalize(averageNormal);
-
-	VerticesAverageNormals[idx].coords[0] = NormalizedAverageNormal.x;
-	VerticesAverageNormals[idx].coords[1] = NormalizedAverageNormal.y;
-	VerticesAverageNormals[idx].coords[2] = NormalizedAverageNormal.z;
+	return VectorNormalize(CrossProduct(Vector_OA, Vector_OB));
 }
 
-__global__ void SparseSurfelFusion::device::CalculateVerticesAverageColors(DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<OrientedPoint3D<float>> samplePoints, const unsigned int verticesCount, const unsigned int samplePointsCount, Point3D<float>* VerticesAverageColors)
+__device__ float3 SparseSurfelFusion::device::BlendNearestColors(const float3& vertex, const uint4& knnIndex, DeviceArrayView<OrientedPoint3D<float>> samplePoints)
 {
-	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
-	if (idx >= verticesCount)	return;
-	// 使用堆保持优先级队列
-	float4 knnDistance = make_float4(1e6f, 1e6f, 1e6f, 1e6f);
-	uint4 knnIndex = make_uint4(0, 0, 0, 0);
-	float3 vertex = make_float3(meshVertices[idx].coords[0], meshVertices[idx].coords[1], meshVertices[idx].coords[2]);
-
-	// knnIndex中是与vertex最近的四个稠密点邻居
-	bruteForceSearch4KNN(vertex, samplePoints, samplePointsCount, knnDistance, knnIndex);
-
 	// 获得最近的4个采样点
 	float3 nearestSample_1 = make_float3(samplePoints[knnIndex.x].point.coords[0], samplePoints[knnIndex.x].point.coords[1], samplePoints[knnIndex.x].point.coords[2]);
 	float3 nearestSample_2 = make_float3(samplePoints[knnIndex.y].point.coords[0], samplePoints[knnIndex.y].point.coords[1], samplePoints[knnIndex.y].point.coords[2]);
@@ -208,72 +213,232 @@ __global__ void SparseSurfelFusion::device::CalculateVerticesAverageColors(Devic
 	rgbWeight.z = nearestDistance.z * distanceSumInverse;
 	rgbWeight.w = nearestDistance.w * distanceSumInverse;
 
-	VerticesAverageColors[idx].coords[0] = samplePoints[knnIndex.x].color[0] * rgbWeight.x + samplePoints[knnIndex.y].color[0] * rgbWeight.y + samplePoints[knnIndex.z].color[0] * rgbWeight.z + samplePoints[knnIndex.w].color[0] * rgbWeight.w;
-	VerticesAverageColors[idx].coords[1] = samplePoints[knnIndex.x].color[1] * rgbWeight.x + samplePoints[knnIndex.y].color[1] * rgbWeight.y + samplePoints[knnIndex.z].color[1] * rgbWeight.z + samplePoints[knnIndex.w].color[1] * rgbWeight.w;
-	VerticesAverageColors[idx].coords[2] = samplePoints[knnIndex.x].color[2] * rgbWeight.x + samplePoints[knnIndex.y].color[2] * rgbWeight.y + samplePoints[knnIndex.z].color[2] * rgbWeight.z + samplePoints[knnIndex.w].color[2] * rgbWeight.w;
+	float3 color;
+	color.x = samplePoints[knnIndex.x].color[0] * rgbWeight.x + samplePoints[knnIndex.y].color[0] * rgbWeight.y + samplePoints[knnIndex.z].color[0] * rgbWeight.z + samplePoints[knnIndex.w].color[0] * rgbWeight.w;
+	color.y = samplePoints[knnIndex.x].color[1] * rgbWeight.x + samplePoints[knnIndex.y].color[1] * rgbWeight.y + samplePoints[knnIndex.z].color[1] * rgbWeight.z + samplePoints[knnIndex.w].color[1] * rgbWeight.w;
+	color.z = samplePoints[knnIndex.x].color[2] * rgbWeight.x + samplePoints[knnIndex.y].color[2] * rgbWeight.y + samplePoints[knnIndex.z].color[2] * rgbWeight.z + samplePoints[knnIndex.w].color[2] * rgbWeight.w;
+	return color;
 }
 
-void SparseSurfelFusion::DrawMesh::CalculateMeshNormals(DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<TriangleIndex> meshTriangleIndices, cudaStream_t stream)
+__device__ float3 SparseSurfelFusion::device::InterpolateVertexColor(const float3& vertex, DeviceArrayView<OrientedPoint3D<float>> samplePoints, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray)
 {
+	// 使用堆保持优先级队列
+	float4 knnDistance = make_float4(1e6f, 1e6f, 1e6f, 1e6f);
+	uint4 knnIndex = make_uint4(0, 0, 0, 0);
 
-#ifdef CHECK_MESH_BUILD_TIME_COST
-	auto time1 = std::chrono::high_resolution_clock::now();					// 记录开始时间点
-#endif // CHECK_MESH_BUILD_TIME_COST
+	// knnIndex中是与vertex最近的四个稠密点邻居
+	octreeSearch4KNN(vertex, NodeArray, BaseAddressArray, samplePoints, knnDistance, knnIndex);
+	return BlendNearestColors(vertex, knnIndex, samplePoints);
+}
 
-	CHECKCUDA(cudaMemcpyAsync(MeshVertices.Ptr(), meshVertices.RawPtr(), sizeof(Point3D<float>) * VerticesCount, cudaMemcpyDeviceToDevice, stream));
-	CHECKCUDA(cudaMemcpyAsync(MeshTriangleIndices.Ptr(), meshTriangleIndices.RawPtr(), sizeof(TriangleIndex) * TranglesCount, cudaMemcpyDeviceToDevice, stream));
+__device__ float3 SparseSurfelFusion::device::InterpolateCachedColor(const float3& vertex, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const Point3D<float>* cacheCornerColors, bool& hit)
+{
+	float3 center;
+	const OctKey key = computeMaxDepthKey(vertex, center);
+	const int node = searchLevelNodeByKey(NodeArray, DLevelOffset, NodeArray.Size(), key);
+	hit = node != -1;
+	if (!hit) return make_float3(0.0f, 0.0f, 0.0f);		// 顶点位于较粗的叶子中，该处没有maxDepth层节点
+
+	// 顶点在节点内的局部坐标[0, 1]，与角点编号c = (x << 2) | (y << 1) | z一致做三线性插值
+	const float resolution = float(1 << MAX_DEPTH_OCTREE);
+	const float tx = fminf(fmaxf((vertex.x - center.x) * resolution + 0.5f, 0.0f), 1.0f);
+	const float ty = fminf(fmaxf((vertex.y - center.y) * resolution + 0.5f, 0.0f), 1.0f);
+	const float tz = fminf(fmaxf((vertex.z - center.z) * resolution + 0.5f, 0.0f), 1.0f);
+	const Point3D<float>* corners = cacheCornerColors + 8 * (node - DLevelOffset);
+	float3 color = make_float3(0.0f, 0.0f, 0.0f);
+	for (int c = 0; c < 8; c++) {
+		const float weight = ((c & 4) ? tx : 1.0f - tx) * ((c & 2) ? ty : 1.0f - ty) * ((c & 1) ? tz : 1.0f - tz);
+		color.x += corners[c].coords[0] * weight;
+		color.y += corners[c].coords[1] * weight;
+		color.z += corners[c].coords[2] * weight;
+	}
+	return color;
+}
 
-	Point3D<float>* MeshNormalsDevice = NULL;	// 记录计算得到的三角网格的法线
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&MeshNormalsDevice), sizeof(Point3D<float>) * TranglesCount, stream));
+__global__ void SparseSurfelFusion::device::computeNodeColorSignatureKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<OrientedPoint3D<float>> samplePoints, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, unsigned int* nodeSignature)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= DLevelNodeCount) return;
+	const int pidx = NodeArray[DLevelOffset + idx].pidx;
+	const int pnum = NodeArray[DLevelOffset + idx].pnum;
+	unsigned int signature = COLOR_CACHE_SIGNATURE_SEED ^ (unsigned int)pnum;
+	for (int k = pidx; k < pidx + pnum; k++) {
+		for (int i = 0; i < 3; i++) {
+			signature = (signature ^ __float_as_uint(samplePoints[k].point.coords[i])) * COLOR_CACHE_SIGNATURE_PRIME;
+			signature = (signature ^ __float_as_uint(samplePoints[k].color.coords[i])) * COLOR_CACHE_SIGNATURE_PRIME;
+		}
+	}
+	nodeSignature[idx] = signature;
+}
 
-	dim3 block_Mesh(256);
-	dim3 grid_Mesh(divUp(TranglesCount, block_Mesh.x));
-	device::CalculateMeshNormalsKernel << <grid_Mesh, block_Mesh, 0, stream >> > (MeshVertices.ArrayView(), MeshTriangleIndices.ArrayView(), TranglesCount, MeshNormalsDevice);
+__global__ void SparseSurfelFusion::device::updateNodeColorCacheKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, DeviceArrayView<OrientedPoint3D<float>> samplePoints, const unsigned int* nodeSignature, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const OctKey* previousKeys, const unsigned int* previousSignature, const Point3D<float>* previousCornerColors, const unsigned int previousNodeCount, OctKey* cacheKeys, unsigned int* cacheSignature, Point3D<float>* cacheCornerColors, unsigned int* recomputedCount)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= DLevelNodeCount) return;
+	const int node = DLevelOffset + idx;
+	const OctKey key = NodeArray[node].key;
+
+	// 角点颜色只取决于27邻域内的稠密点，邻域签名按邻居顺序合并邻居的签名
+	unsigned int signature = COLOR_CACHE_SIGNATURE_SEED;
+	for (int i = 0; i < 27; i++) {
+		const int neighbor = NodeArray[node].neighs[i];
+		signature = (signature ^ (neighbor == -1 ? 0u : nodeSignature[neighbor - DLevelOffset])) * COLOR_CACHE_SIGNATURE_PRIME;
+	}
+	cacheKeys[idx] = key;
+	cacheSignature[idx] = signature;
+
+	// 邻域内稠密点不足4个时KNN会退到更粗的层，颜色依赖更大范围，每帧重新计算
+	const bool localSearch = neighborhoodPointCount(NodeArray, node) >= 4;
+	if (localSearch) {
+		// 上一帧的缓存按key升序，二分查找同key节点，邻域签名一致则直接复用
+		int left = 0, right = previousNodeCount;
+		while (left < right) {
+			const int mid = (left + right) >> 1;
+			if (previousKeys[mid] < key) left = mid + 1;
+			else right = mid;
+		}
+		if (left < (int)previousNodeCount && previousKeys[left] == key && previousSignature[left] == signature) {
+			for (int c = 0; c < 8; c++) cacheCornerColors[8 * idx + c] = previousCornerColors[8 * left + c];
+			return;
+		}
+	}
 
-	unsigned int* ConnectedTriangleNum = NULL;		// 记录一个顶点有多少邻接的三角形
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&ConnectedTriangleNum), sizeof(unsigned int) * VerticesCount, stream));
-	CHECKCUDA(cudaMemsetAsync(ConnectedTriangleNum, 0, sizeof(unsigned int) * VerticesCount, stream));
-	device::CountConnectedTriangleNumKernel << <grid_Mesh, block_Mesh, 0, stream >> > (MeshTriangleIndices.ArrayView(), TranglesCount, ConnectedTriangleNum);
+	// 由key解码节点在maxDepth层的网格坐标，角点c = (x << 2) | (y << 1) | z
+	int coord[3] = { 0, 0, 0 };
+	for (int i = 0; i < MAX_DEPTH_OCTREE; i++) {
+		coord[0] |= int((key >> (3 * i + 2)) & 1) << i;
+		coord[1] |= int((key >> (3 * i + 1)) & 1) << i;
+		coord[2] |= int((key >> (3 * i)) & 1) << i;
+	}
+	const float width = 1.0f / (1 << MAX_DEPTH_OCTREE);
+	for (int c = 0; c < 8; c++) {
+		const float3 corner = make_float3((coord[0] + ((c >> 2) & 1)) * width, (coord[1] + ((c >> 1) & 1)) * width, (coord[2] + (c & 1)) * width);
+		float4 knnDistance = make_float4(1e6f, 1e6f, 1e6f, 1e6f);
+		uint4 knnIndex = make_uint4(0, 0, 0, 0);
+		if (localSearch) neighborhoodSearch4KNN(corner, NodeArray, node, samplePoints, knnDistance, knnIndex);
+		else octreeSearch4KNN(corner, NodeArray, BaseAddressArray, samplePoints, knnDistance, knnIndex);
+		const float3 color = BlendNearestColors(corner, knnIndex, samplePoints);
+		cacheCornerColors[8 * idx + c] = Point3D<float>(color.x, color.y, color.z);
+	}
+	if (recomputedCount != NULL) atomicAdd(recomputedCount, 1);
+}
 
-	Point3D<float>* VerticesNormalsSum = NULL;		// 记录其邻接的三角Mesh的法线向量和
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&VerticesNormalsSum), sizeof(Point3D<float>) * VerticesCount, stream));
-	CHECKCUDA(cudaMemsetAsync(VerticesNormalsSum, 0.0f, sizeof(Point3D<float>) * VerticesCount, stream));
-	device::VerticesNormalsSumKernel << <grid_Mesh, block_Mesh, 0, stream >> > (MeshNormalsDevice, MeshTriangleIndices.ArrayView(), TranglesCount, VerticesNormalsSum);
+__global__ void SparseSurfelFusion::device::CalculateVerticesNormalsAndColorsKernel(DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<TriangleIndex> meshTriangles, DeviceArrayView<int> vertexTriangleOffset, DeviceArrayView<int> vertexTriangleList, DeviceArrayView<OrientedPoint3D<float>> samplePoints, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, const unsigned int DLevelOffset, const Point3D<float>* cacheCornerColors, const unsigned int verticesCount, Point3D<float>* VerticesAverageNormals, Point3D<float>* VerticesAverageColors, DrawElementsIndirectCommand* drawCommand)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx > verticesCount) return;
+	if (idx == verticesCount) {
+		// 绘制的索引数量取自邻接偏移的末尾(3 * 三角形数量)，绘制时不需要Host端的三角形数量
+		DrawElementsIndirectCommand command;
+		command.count = vertexTriangleOffset[verticesCount];
+		command.instanceCount = 1;
+		command.firstIndex = 0;
+		command.baseVertex = 0;
+		command.baseInstance = 0;
+		*drawCommand = command;
+		return;
+	}
 
-	VerticesAverageNormals.ResizeArrayOrException(VerticesCount);
+	// 遍历邻接三角形累加法线，每个顶点只由自己的线程写入，不需要原子操作
+	float3 normalSum = make_float3(0.0f, 0.0f, 0.0f);
+	const int begin = vertexTriangleOffset[idx];
+	const int end = vertexTriangleOffset[idx + 1];
+	for (int i = begin; i < end; i++) {
+		const float3 normal = TriangleNormal(meshVertices, meshTriangles[vertexTriangleList[i]]);
+		normalSum.x += normal.x;
+		normalSum.y += normal.y;
+		normalSum.z += normal.z;
+	}
+	const float3 averageNormal = VectorNormalize(normalSum);	// 平均后归一化与直接归一化方向相同
+	VerticesAverageNormals[idx].coords[0] = averageNormal.x;
+	VerticesAverageNormals[idx].coords[1] = averageNormal.y;
+	VerticesAverageNormals[idx].coords[2] = averageNormal.z;
+
+	const float3 vertex = make_float3(meshVertices[idx].coords[0], meshVertices[idx].coords[1], meshVertices[idx].coords[2]);
+	bool hit = false;
+	float3 color;
+	if (cacheCornerColors != NULL) color = InterpolateCachedColor(vertex, NodeArray, DLevelOffset, cacheCornerColors, hit);
+	if (!hit) color = InterpolateVertexColor(vertex, samplePoints, NodeArray, BaseAddressArray);	// 未开启缓存或顶点不在maxDepth层节点中
+	VerticesAverageColors[idx].coords[0] = color.x;
+	VerticesAverageColors[idx].coords[1] = color.y;
+	VerticesAverageColors[idx].coords[2] = color.z;
+}
+
+void SparseSurfelFusion::DrawMesh::CalculateMeshNormalsAndColors(DeviceArrayView<OrientedPoint3D<float>> sampleDensePoints, DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<TriangleIndex> meshTriangleIndices, DeviceArrayView<int> vertexTriangleOffset, DeviceArrayView<int> vertexTriangleList, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, const unsigned int DLevelOffset, cudaStream_t stream)
+{
+#ifdef CHECK_MESH_BUILD_TIME_COST
+	auto time1 = std::chrono::high_resolution_clock::now();					// 记录开始时间点
+#endif // CHECK_MESH_BUILD_TIME_COST
+
+	RenderSlot& slot = Slots[WriteSlot];
+	if (vertexTriangleOffset.Size() != slot.VerticesCount + 1 || vertexTriangleList.Size() != 3 * slot.TranglesCount) {
+		LOGGING(FATAL) << "顶点→三角形邻接与网格不一致(需要ComputeTriangleIndices::SetVertexTriangleAdjacency)：偏移 " << vertexTriangleOffset.Size() << " / " << slot.VerticesCount + 1 << "   三角形 " << vertexTriangleList.Size() << " / " << 3 * slot.TranglesCount;
+	}
+
+	DeviceArrayView<Point3D<float>> vertices = meshVertices;
+	DeviceArrayView<TriangleIndex> indices = meshTriangleIndices;
+	if (!slot.sinkOutput || meshVertices.RawPtr() != slot.mappedVBO || meshTriangleIndices.RawPtr() != slot.mappedIBO) {
+		CHECKCUDA(cudaMemcpyAsync(slot.MeshVertices.Ptr(), meshVertices.RawPtr(), sizeof(Point3D<float>) * slot.VerticesCount, cudaMemcpyDeviceToDevice, stream));
+		CHECKCUDA(cudaMemcpyAsync(slot.MeshTriangleIndices.Ptr(), meshTriangleIndices.RawPtr(), sizeof(TriangleIndex) * slot.TranglesCount, cudaMemcpyDeviceToDevice, stream));
+		vertices = slot.MeshVertices.ArrayView();
+		indices = slot.MeshTriangleIndices.ArrayView();
+		slot.sinkOutput = false;	// 网格不在写槽位的输出槽中，上传时需要拷贝
+	}
 
-	dim3 block_vertex(256);
-	dim3 grid_vertex(divUp(VerticesCount, block_vertex.x));
-	device::CalculateVerticesAverageNormals << <grid_vertex, block_vertex, 0, stream >> > (ConnectedTriangleNum, VerticesNormalsSum, VerticesCount, VerticesAverageNormals.Ptr());
+	const Point3D<float>* cacheCornerColors = temporalColorCache ? updateColorCache(sampleDensePoints, NodeArray, BaseAddressArray, DLevelOffset, stream) : NULL;
 
-	CHECKCUDA(cudaFreeAsync(MeshNormalsDevice, stream));
-	CHECKCUDA(cudaFreeAsync(ConnectedTriangleNum, stream));
-	CHECKCUDA(cudaFreeAsync(VerticesNormalsSum, stream));
+	slot.VerticesAverageNormals.ResizeArrayOrException(slot.VerticesCount);
+	slot.VerticesAverageColors.ResizeArrayOrException(slot.VerticesCount);
+
+	dim3 block(256);
+	dim3 grid(divUp(slot.VerticesCount + 1, block.x));		// 多出的一个线程写入间接绘制命令
+	device::CalculateVerticesNormalsAndColorsKernel << <grid, block, 0, stream >> > (vertices, indices, vertexTriangleOffset, vertexTriangleList, sampleDensePoints, NodeArray, BaseAddressArray, DLevelOffset, cacheCornerColors, slot.VerticesCount, slot.VerticesAverageNormals.Ptr(), slot.VerticesAverageColors.Ptr(), slot.DrawCommand.Ptr());
 
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	CHECKCUDA(cudaStreamSynchronize(stream));
 	auto time2 = std::chrono::high_resolution_clock::now();					// 记录结束时间点
 	std::chrono::duration<double, std::milli> duration1 = time2 - time1;		// 计算执行时间（以ms为单位）
-	std::cout << "计算Mesh法向量时间: " << duration1.count() << " ms" << std::endl;
+	std::cout << "计算Mesh法向量与顶点颜色的时间: " << duration1.count() << " ms" << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 }
 
-void SparseSurfelFusion::DrawMesh::CalculateMeshVerticesColor(DeviceArrayView<OrientedPoint3D<float>> sampleDensePoints, DeviceArrayView<Point3D<float>> meshVertices, cudaStream_t stream)
+void SparseSurfelFusion::DrawMesh::SetTemporalColorCache(const bool enable)
+{
+	temporalColorCache = enable;
+	colorCacheNodeCount[0] = 0;		// 重新开启时不复用关闭前的缓存
+	colorCacheNodeCount[1] = 0;
+}
+
+const SparseSurfelFusion::Point3D<float>* SparseSurfelFusion::DrawMesh::updateColorCache(DeviceArrayView<OrientedPoint3D<float>> sampleDensePoints, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, const unsigned int DLevelOffset, cudaStream_t stream)
 {
+	const int previous = colorCacheIndex;
+	const int current = (colorCacheIndex + 1) % 2;
+	const unsigned int DLevelNodeCount = NodeArray.Size() - DLevelOffset;
+	colorCacheIndex = current;
+	colorCacheNodeCount[current] = DLevelNodeCount;
+	if (DLevelNodeCount == 0) return NULL;
+
+	unsigned int* nodeSignature = reserveColorCacheBuffer(NodeColorSignature, DLevelNodeCount);
+	OctKey* cacheKeys = reserveColorCacheBuffer(ColorCacheKeys[current], DLevelNodeCount);
+	unsigned int* cacheSignature = reserveColorCacheBuffer(ColorCacheSignature[current], DLevelNodeCount);
+	Point3D<float>* cacheCornerColors = reserveColorCacheBuffer(ColorCacheCornerColors[current], 8 * DLevelNodeCount);
+
+	unsigned int* recomputedCount = NULL;
 #ifdef CHECK_MESH_BUILD_TIME_COST
-	auto time1 = std::chrono::high_resolution_clock::now();					// 记录开始时间点
+	recomputedCount = ColorCacheRecomputedCount.Ptr();
+	CHECKCUDA(cudaMemsetAsync(recomputedCount, 0, sizeof(unsigned int), stream));
 #endif // CHECK_MESH_BUILD_TIME_COST
 
-	VerticesAverageColors.ResizeArrayOrException(VerticesCount);
-
-	dim3 block(256);
-	dim3 grid(divUp(VerticesCount, block.x));
-	device::CalculateVerticesAverageColors << <grid, block, 0, stream >> > (meshVertices, sampleDensePoints, VerticesCount, DensePointsCount, VerticesAverageColors.Ptr());
+	dim3 block(128);
+	dim3 grid(divUp(DLevelNodeCount, block.x));
+	device::computeNodeColorSignatureKernel << <grid, block, 0, stream >> > (NodeArray, sampleDensePoints, DLevelOffset, DLevelNodeCount, nodeSignature);
+	device::updateNodeColorCacheKernel << <grid, block, 0, stream >> > (NodeArray, BaseAddressArray, sampleDensePoints, nodeSignature, DLevelOffset, DLevelNodeCount, ColorCacheKeys[previous].Ptr(), ColorCacheSignature[previous].Ptr(), ColorCacheCornerColors[previous].Ptr(), colorCacheNodeCount[previous], cacheKeys, cacheSignature, cacheCornerColors, recomputedCount);
 
 #ifdef CHECK_MESH_BUILD_TIME_COST
+	unsigned int recomputedCountHost = 0;
+	CHECKCUDA(cudaMemcpyAsync(&recomputedCountHost, recomputedCount, sizeof(unsigned int), cudaMemcpyDeviceToHost, stream));
 	CHECKCUDA(cudaStreamSynchronize(stream));
-	auto time2 = std::chrono::high_resolution_clock::now();					// 记录结束时间点
-	std::chrono::duration<double, std::milli> duration1 = time2 - time1;		// 计算执行时间（以ms为单位）
-	std::cout << "计算Mesh顶点颜色的时间: " << duration1.count() << " ms" << std::endl;
+	std::cout << "颜色缓存重新计算的节点: " << recomputedCountHost << " / " << DLevelNodeCount << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
-}
\ No newline at end of file
+	return cacheCornerColors;
+}
@@ -20,11 +20,18 @@
 #include <tuple>				// tuple是一个固定大小的不同类型值的集合，是泛化的std::pair
 
 #include "Geometry.h"
+#include "OctNode.cuh"
 #include <chrono>
 #include <render/GLShaderProgram.h>
 #include <base/DeviceReadWrite/DeviceBufferArray.h>
 #include <base/Constants.h>
 #include <math/VectorUtils.h>
+#include "ReconstructionConfig.h"
+#include "MeshOutputSink.h"
+
+#define DRAW_MESH_SLOT_NUM 2		// 渲染槽位数量：流水线模式下一个槽位绘制时另一个槽位写入下一帧
+#define COLOR_CACHE_SIGNATURE_SEED 2166136261u	// 节点颜色缓存签名(FNV-1a)的初值
+#define COLOR_CACHE_SIGNATURE_PRIME 16777619u	// 节点颜色缓存签名(FNV-1a)的乘数
 
 static glm::vec3 box[68] = {
 	// x轴								x轴颜色
@@ -67,6 +74,17 @@ static glm::vec3 box[68] = {
 };
 
 namespace SparseSurfelFusion {
+	/**
+	 * \brief glDrawElementsIndirect的绘制命令，由设备端写入.
+	 */
+	struct DrawElementsIndirectCommand {
+		GLuint count;			// 索引数量
+		GLuint instanceCount;	// 实例数量
+		GLuint firstIndex;		// 第一个索引的位置
+		GLint baseVertex;		// 索引的偏移
+		GLuint baseInstance;	// 第一个实例
+	};
+
 	namespace device {
 
 		/**
@@ -88,6 +106,36 @@ namespace SparseSurfelFusion {
 		 */
 		__device__ __forceinline__ void bruteForceSearch4KNN(const float3& vertex, DeviceArrayView<OrientedPoint3D<float>> samplePoint, const unsigned int samplePointsCount, float4& distance, uint4& sampleIndex);
 
+		/**
+		 * \brief 在有序的某层节点[left, right)中二分查找key，找不到返回-1.
+		 */
+		__device__ int searchLevelNodeByKey(DeviceArrayView<OctNode> NodeArray, int left, int right, const OctKey key);
+
+		/**
+		 * \brief 计算顶点在maxDepth层所在节点的key，与device::computePointCode的编码规则一致.
+		 *
+		 * \param vertex 顶点(归一化坐标)
+		 * \param center 【输出】该节点的中心
+		 * \return maxDepth层的key
+		 */
+		__device__ OctKey computeMaxDepthKey(const float3& vertex, float3& center);
+
+		/**
+		 * \brief 节点27邻域内的稠密点数量.
+		 */
+		__device__ int neighborhoodPointCount(DeviceArrayView<OctNode> NodeArray, const int node);
+
+		/**
+		 * \brief 只在节点27邻域[pidx, pidx + pnum)范围内的稠密点中求解距离顶点最近的4个采样点.
+		 */
+		__device__ void neighborhoodSearch4KNN(const float3& vertex, DeviceArrayView<OctNode> NodeArray, const int node, DeviceArrayView<OrientedPoint3D<float>> samplePoint, float4& distance, uint4& sampleIndex);
+
+		/**
+		 * \brief 借助八叉树求解距离顶点最近的4个采样点：从maxDepth层开始定位顶点所在节点，只遍历其27邻域节点[pidx, pidx + pnum)范围内的稠密点，
+		 *        邻域内点不足4个(或该层没有对应节点)时退到父层，直到根节点(等价于暴力搜索).
+		 */
+		__device__ void octreeSearch4KNN(const float3& vertex, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, DeviceArrayView<OrientedPoint3D<float>> samplePoint, float4& distance, uint4& sampleIndex);
+
 		/**
 		 * \brief 向量归一化.
 		 */
@@ -99,40 +147,63 @@ namespace SparseSurfelFusion {
 		__device__ float3 CrossProduct(const float3& Vector_OA, const float3& Vector_OB);
 
 		/**
-		 * \brief 计算网格法线核函数.
+		 * \brief 三角形的单位法线.
 		 */
-		__global__ void CalculateMeshNormalsKernel(const Point3D<float>* verticesArray, const TriangleIndex* indicesArray, const unsigned int meshCount, Point3D<float>* normalsArray);
+		__device__ float3 TriangleNormal(DeviceArrayView<Point3D<float>> verticesArray, const TriangleIndex& triangle);
 
 		/**
-		 * \brief 计算顶点邻接多少个三角形.
+		 * \brief 按到最近4个采样点的距离加权它们的颜色.
 		 */
-		__global__ void CountConnectedTriangleNumKernel(const TriangleIndex* indicesArray, const unsigned int meshCount, unsigned int* ConnectedTriangleNum);
+		__device__ float3 BlendNearestColors(const float3& vertex, const uint4& knnIndex, DeviceArrayView<OrientedPoint3D<float>> samplePoints);
 
 		/**
-		 * \brief 计算邻接三角形法向量和.
+		 * \brief 根据顶点最近的4个采样点邻居，按距离加权计算顶点的颜色.
 		 */
-		__global__ void VerticesNormalsSumKernel(const Point3D<float>* meshNormals, const TriangleIndex* indicesArray, const unsigned int meshCount, Point3D<float>* VerticesNormalsSum);
+		__device__ float3 InterpolateVertexColor(const float3& vertex, DeviceArrayView<OrientedPoint3D<float>> samplePoints, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray);
 
 		/**
-		 * \brief 通过平均邻接三角Mesh的法线，计算当前顶点的法线.
+		 * \brief 由顶点所在maxDepth层节点缓存的8个角点颜色三线性插值顶点颜色.
+		 *
+		 * \param hit 【输出】顶点所在位置是否有maxDepth层节点，没有时返回值无效
 		 */
-		__global__ void CalculateVerticesAverageNormals(const unsigned int* ConnectedTriangleNum, const Point3D<float>* VerticesNormalsSum, const unsigned int verticesCount, Point3D<float>* VerticesAverageNormals);
+		__device__ float3 InterpolateCachedColor(const float3& vertex, DeviceArrayView<OctNode> NodeArray, const unsigned int DLevelOffset, const Point3D<float>* cacheCornerColors, bool& hit);
 
 		/**
-		 * \brief 根据顶点最近的采样点邻居计算顶点的颜色.
+		 * \brief 计算每个maxDepth层节点所含稠密点(坐标与颜色)的签名.
+		 */
+		__global__ void computeNodeColorSignatureKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<OrientedPoint3D<float>> samplePoints, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, unsigned int* nodeSignature);
+
+		/**
+		 * \brief 更新maxDepth层节点的角点颜色缓存：合并27邻居的签名作为邻域签名，上一帧同key节点的邻域签名一致时复用其角点颜色，
+		 *        否则由KNN重新计算8个角点的颜色.
+		 *
+		 * \param previousKeys 上一帧缓存的节点key(升序)
+		 * \param previousSignature 上一帧缓存的邻域签名
+		 * \param previousCornerColors 上一帧缓存的角点颜色，每个节点8个
+		 * \param previousNodeCount 上一帧缓存的节点数量
+		 * \param cacheKeys 【输出】本帧缓存的节点key
+		 * \param cacheSignature 【输出】本帧缓存的邻域签名
+		 * \param cacheCornerColors 【输出】本帧缓存的角点颜色
+		 * \param recomputedCount 【输出】重新计算的节点数量，可为NULL
 		 */
-		__global__ void CalculateVerticesAverageColors(DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<OrientedPoint3D<float>> samplePoints, const unsigned int verticesCount, const unsigned int samplePointsCount, Point3D<float>* VerticesAverageColors);
+		__global__ void updateNodeColorCacheKernel(DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, DeviceArrayView<OrientedPoint3D<float>> samplePoints, const unsigned int* nodeSignature, const unsigned int DLevelOffset, const unsigned int DLevelNodeCount, const OctKey* previousKeys, const unsigned int* previousSignature, const Point3D<float>* previousCornerColors, const unsigned int previousNodeCount, OctKey* cacheKeys, unsigned int* cacheSignature, Point3D<float>* cacheCornerColors, unsigned int* recomputedCount);
+
+		/**
+		 * \brief 每个顶点一个线程，遍历顶点→三角形邻接计算平均法线，并计算顶点颜色(cacheCornerColors非NULL时由节点颜色缓存插值)；
+		 *        第verticesCount个线程写入间接绘制命令.
+		 */
+		__global__ void CalculateVerticesNormalsAndColorsKernel(DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<TriangleIndex> meshTriangles, DeviceArrayView<int> vertexTriangleOffset, DeviceArrayView<int> vertexTriangleList, DeviceArrayView<OrientedPoint3D<float>> samplePoints, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, const unsigned int DLevelOffset, const Point3D<float>* cacheCornerColors, const unsigned int verticesCount, Point3D<float>* VerticesAverageNormals, Point3D<float>* VerticesAverageColors, DrawElementsIndirectCommand* drawCommand);
 	}
 	class DrawMesh
 	{
 	public:
-		DrawMesh();
+		DrawMesh(const ReconstructionConfig& config = ReconstructionConfig());
 		~DrawMesh();
 		
 		using Ptr = std::shared_ptr<DrawMesh>;
 
 		/**
-		 * \brief 设置参数.
+		 * \brief 设置参数，写入当前的写槽位.
 		 * 
 		 * \param meshVertices 网格顶点
 		 * \param meshTriangleIndices 三角面元索引
@@ -141,36 +212,110 @@ namespace SparseSurfelFusion {
 		void setInput(DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<TriangleIndex> meshTriangleIndices, DeviceArrayView<OrientedPoint3D<float>> samplePoints);
 
 		/**
-		 * \brief 计算重建三角网格的法线.
+		 * \brief 映射写槽位的VBO/IBO并返回其中顶点、索引区域作为网格输出槽，等值面提取直接写入OpenGL缓冲.
+		 *        槽位保持映射直到UploadRenderedMesh，期间不能绘制该槽位；已映射时直接返回同一输出槽.
+		 * 
+		 * \param stream 之后写入输出槽的cuda流
+		 * \return 写槽位的网格输出槽
+		 */
+		MeshOutputSink MapOutputSink(cudaStream_t stream);
+
+		/**
+		 * \brief 在一个核函数中计算网格的顶点法线与顶点颜色，并写入写槽位的间接绘制命令，网格已在写槽位的输出槽中时不再拷贝.
+		 *        法线为邻接三角形法线的平均，由顶点→三角形邻接逐顶点求和，不需要临时显存与原子操作；
+		 *        颜色通过寻找最近的(KNN)采样点，并对其颜色加权平均；开启颜色缓存时顶点由所在maxDepth层节点缓存的角点颜色插值，
+		 *        只有27邻域内稠密点变化的节点重新计算KNN.
 		 * 
+		 * \param sampleDensePoints 采样的稠密点(按八叉树编码排序)
 		 * \param meshVertices 网格重建后的顶点
 		 * \param meshTriangleIndices 网格重建后的三角形索引
+		 * \param vertexTriangleOffset 顶点→三角形邻接的CSR偏移(ComputeTriangleIndices::GetVertexTriangleOffset)
+		 * \param vertexTriangleList 顶点→三角形邻接的三角形index(ComputeTriangleIndices::GetVertexTriangleList)
+		 * \param NodeArray 八叉树节点，节点的pidx、pnum索引sampleDensePoints
+		 * \param BaseAddressArray 每层节点在NodeArray中的首地址
+		 * \param DLevelOffset maxDepth层节点在NodeArray中的首地址(Host)
 		 * \param stream cuda流
 		 */
-		void CalculateMeshNormals(DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<TriangleIndex> meshTriangleIndices, cudaStream_t stream = 0);
+		void CalculateMeshNormalsAndColors(DeviceArrayView<OrientedPoint3D<float>> sampleDensePoints, DeviceArrayView<Point3D<float>> meshVertices, DeviceArrayView<TriangleIndex> meshTriangleIndices, DeviceArrayView<int> vertexTriangleOffset, DeviceArrayView<int> vertexTriangleList, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, const unsigned int DLevelOffset, cudaStream_t stream = 0);
 
 		/**
-		 * \brief 计算网格的顶点颜色，通过寻找最近的(KNN)采样点，并对其颜色加权平均.
+		 * \brief 设置是否跨帧缓存maxDepth层节点的角点颜色(默认开启)：缓存按节点key(Morton编码)存储，
+		 *        节点27邻域内稠密点的坐标与颜色不变时直接复用上一帧的颜色，颜色计算量随场景变化而非场景大小增长.
+		 *        关闭时每个顶点直接做KNN，重新开启时缓存从空开始.
+		 *
+		 * \param enable 是否开启
+		 */
+		void SetTemporalColorCache(const bool enable);
+
+		/**
+		 * \brief 绘制渲染的网格(写槽位上传后立即绘制).
 		 * 
-		 * \param sampleDensePoints 采样的稠密点
-		 * \param meshVertices 网格顶点
 		 * \param stream cuda流
 		 */
-		void CalculateMeshVerticesColor(DeviceArrayView<OrientedPoint3D<float>> sampleDensePoints, DeviceArrayView<Point3D<float>> meshVertices, cudaStream_t stream = 0);
+		void DrawRenderedMesh(cudaStream_t stream);
 
 		/**
-		 * \brief 绘制渲染的网格.
+		 * \brief 将写槽位的顶点、法线、颜色、索引与绘制命令异步拷贝到该槽位的VBO/IBO/间接绘制缓冲(顶点与索引已由输出槽写入时只拷贝法线、颜色与绘制命令).
+		 *        拷贝结束后即解除映射，解除映射保证之后的OpenGL绘制在拷贝完成后执行，Host不需要同步stream.
 		 * 
 		 * \param stream cuda流
 		 */
-		void DrawRenderedMesh(cudaStream_t stream);
+		void UploadRenderedMesh(cudaStream_t stream);
+
+		/**
+		 * \brief 绘制已上传的槽位，只发出OpenGL命令，绘制数量取自槽位的间接绘制缓冲.
+		 * 
+		 * \param slot 槽位
+		 */
+		void DrawSlotMesh(const int slot);
+
+		/**
+		 * \brief 交换写槽位，返回交换前的写槽位.
+		 */
+		int SwapWriteSlot() { const int slot = WriteSlot; WriteSlot = (WriteSlot + 1) % DRAW_MESH_SLOT_NUM; return slot; }
+
+		/**
+		 * \brief 获得当前的写槽位.
+		 */
+		int GetWriteSlot() const { return WriteSlot; }
+
+		/**
+		 * \brief 槽位是否上传过网格.
+		 */
+		bool IsSlotUploaded(const int slot) const { return Slots[slot].uploaded; }
 
 	private:
+		/**
+		 * \brief 一帧网格渲染需要的全部数据，每个槽位拥有独立的显存与注册的OpenGL缓冲.
+		 */
+		struct RenderSlot {
+			DeviceBufferArray<Point3D<float>> VerticesAverageNormals;	// 归一化的顶点平均法向量
+			DeviceBufferArray<Point3D<float>> VerticesAverageColors;	// 顶点颜色
+			DeviceBufferArray<Point3D<float>> MeshVertices;				// 网格顶点
+			DeviceBufferArray<TriangleIndex> MeshTriangleIndices;		// 网格三角面元索引
+			DeviceBufferArray<DrawElementsIndirectCommand> DrawCommand;	// 计算法线与颜色时设备端写入的绘制命令
+
+			GLuint GeometryVAO;					// 点云生成的网格的VAO
+			GLuint GeometryVBO;					// 点云生成的网格的VBO
+			GLuint GeometryIBO;					// 点云生成的网格的EBO/IBO
+			GLuint GeometryIndirectBO;			// 间接绘制命令缓冲
+
+			cudaGraphicsResource_t cudaVBOResources;// 注册缓冲区对象到CUDA
+			cudaGraphicsResource_t cudaIBOResources;// 注册IBO对象到CUDA
+			cudaGraphicsResource_t cudaIndirectResources;// 注册间接绘制缓冲到CUDA
+			Point3D<float>* mappedVBO = NULL;	// 映射期间VBO的设备地址
+			TriangleIndex* mappedIBO = NULL;	// 映射期间IBO的设备地址
+			DrawElementsIndirectCommand* mappedIndirect = NULL;	// 映射期间间接绘制缓冲的设备地址
+			bool mapped = false;				// VBO/IBO是否映射到CUDA
+			bool sinkOutput = false;			// 顶点与索引是否已作为输出槽直接写入VBO/IBO
+
+			unsigned int TranglesCount = 0;		// 传入实时顶点的数量(只用于计算与拷贝，绘制数量由间接绘制缓冲给出)
+			unsigned int VerticesCount = 0;		// 传入点的数量
+			bool uploaded = false;				// 是否已上传到VBO/IBO
+		};
 
-		DeviceBufferArray<Point3D<float>> VerticesAverageNormals;	// 归一化的顶点平均法向量
-		DeviceBufferArray<Point3D<float>> VerticesAverageColors;	// 顶点颜色
-		DeviceBufferArray<Point3D<float>> MeshVertices;				// 网格顶点
-		DeviceBufferArray<TriangleIndex> MeshTriangleIndices;		// 网格三角面元索引
+		RenderSlot Slots[DRAW_MESH_SLOT_NUM];	// 渲染槽位
+		int WriteSlot = 0;						// setInput与计算法线、颜色写入的槽位
 
 		const unsigned int WindowWidth = 1920 * 0.9;
 		const unsigned int WindowHeight = 1080 * 0.9;
@@ -179,27 +324,52 @@ namespace SparseSurfelFusion {
 		GLShaderProgram meshShader;			// 网格渲染
 		GLShaderProgram coordinateShader;	// 坐标系渲染
 
-		// 绘制点云
-		GLuint GeometryVAO;					// 点云生成的网格的VAO
-		GLuint GeometryVBO;					// 点云生成的网格的VBO
-		GLuint GeometryIBO;					// 点云生成的网格的EBO/IBO
-
-		cudaGraphicsResource_t cudaVBOResources;// 注册缓冲区对象到CUDA
-		cudaGraphicsResource_t cudaIBOResources;// 注册IBO对象到CUDA
-
 		// 绘制渲染窗口坐标系
 		GLuint coordinateSystemVAO;			// 坐标系VAO
 		GLuint coordinateSystemVBO;			// 坐标系轴点网格VBO
 
-		unsigned int TranglesCount = 0;		// 传入实时顶点的数量
-		unsigned int VerticesCount = 0;		// 传入点的数量
 		unsigned int DensePointsCount = 0;	// 稠密点的数量
 
+		// maxDepth层节点的角点颜色缓存，两组轮换：本帧由上一帧的一组更新写入另一组
+		bool temporalColorCache = true;							// 是否跨帧缓存节点颜色
+		int colorCacheIndex = 0;								// 最近一次写入的缓存组
+		unsigned int colorCacheNodeCount[2] = { 0, 0 };			// 每组缓存的节点数量
+		DeviceBufferArray<OctKey> ColorCacheKeys[2];			// 缓存节点的key，按key升序
+		DeviceBufferArray<unsigned int> ColorCacheSignature[2];	// 缓存节点的27邻域签名
+		DeviceBufferArray<Point3D<float>> ColorCacheCornerColors[2];// 缓存节点的8个角点颜色
+		DeviceBufferArray<unsigned int> NodeColorSignature;		// 本帧每个maxDepth层节点自身稠密点的签名
+		DeviceBufferArray<unsigned int> ColorCacheRecomputedCount;	// 本帧重新计算的节点数量(计时模式下输出)
+
 		// 创建变换
 		glm::mat4 view = glm::mat4(1.0f);		// 确保初始化矩阵是单位矩阵
 		glm::mat4 projection = glm::mat4(1.0f);	// 投影矩阵，选择是透视还是正射
 		glm::mat4 model = glm::mat4(1.0f);		// 计算每个对象的模型矩阵，并在绘制之前将其传递给着色器
 
+		/**
+		 * \brief 从缓存中取出能容纳size个元素的缓存，容量不足时按1.5倍重新开辟(不保留旧数据).
+		 */
+		template<typename T>
+		static T* reserveColorCacheBuffer(DeviceBufferArray<T>& buffer, const size_t size) {
+			if (size > buffer.BufferSize()) {
+				buffer.ReleaseBuffer();		// cudaFree会等待设备上已提交的任务完成，旧缓存不会被正在执行的核函数访问
+				buffer.AllocateBuffer(static_cast<size_t>(size * 1.5));
+			}
+			buffer.ResizeArrayOrException(size);
+			return buffer.Ptr();
+		}
+
+		/**
+		 * \brief 用上一帧的缓存更新本帧maxDepth层节点的角点颜色缓存.
+		 *
+		 * \param sampleDensePoints 采样的稠密点
+		 * \param NodeArray 八叉树节点
+		 * \param BaseAddressArray 每层节点在NodeArray中的首地址
+		 * \param DLevelOffset maxDepth层节点在NodeArray中的首地址
+		 * \param stream cuda流
+		 * \return 本帧缓存的角点颜色，没有maxDepth层节点时为NULL
+		 */
+		const Point3D<float>* updateColorCache(DeviceArrayView<OrientedPoint3D<float>> sampleDensePoints, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> BaseAddressArray, const unsigned int DLevelOffset, cudaStream_t stream);
+
 		/**
 		 * \brief 初始化并加载坐标系.
 		 *
@@ -209,23 +379,33 @@ namespace SparseSurfelFusion {
 		/**
 		 * \brief 注册cuda资源.
 		 *
+		 * \param slot 槽位
 		 */
-		void registerCudaResources();
+		void registerCudaResources(RenderSlot& slot);
 
 		/**
-		 * \brief 将数据资源映射到cuda.
+		 * \brief 将槽位的VBO/IBO/间接绘制缓冲映射到cuda并取得设备地址，已映射时返回.
 		 *
-		 * \param MeshVertices 网格顶底
-		 * \param MeshTriangleIndices 网格三角面元索引
+		 * \param slot 槽位
 		 * \param stream cuda流
 		 */
-		void mapToCuda(DeviceArrayView<Point3D<float>> MeshVertices, DeviceArrayView<TriangleIndex> MeshTriangleIndices, cudaStream_t stream = 0);
+		void mapSlotResources(RenderSlot& slot, cudaStream_t stream = 0);
 
 		/**
-		 * \brief 将需要渲染的点映射到cuda资源上.
+		 * \brief 将槽位的数据资源映射到cuda，并拷贝到VBO/IBO.
 		 *
+		 * \param slot 槽位
+		 * \param stream cuda流
+		 */
+		void mapToCuda(RenderSlot& slot, cudaStream_t stream = 0);
+
+		/**
+		 * \brief 解除槽位的cuda映射.
+		 *
+		 * \param slot 槽位
+		 * \param stream cuda流
 		 */
-		void unmapFromCuda(cudaStream_t stream = 0);
+		void unmapFromCuda(RenderSlot& slot, cudaStream_t stream = 0);
 
 		/**
 		 * \brief 清空窗口.
@@ -236,11 +416,12 @@ namespace SparseSurfelFusion {
 		/**
 		 * \brief 绘制网格.
 		 *
+		 * \param slot 槽位
 		 * \param view 传入视角矩阵
 		 * \param projection 传入投影矩阵
 		 * \param model 传入模型矩阵
 		 */
-		void drawMesh(glm::mat4& view, glm::mat4& projection, glm::mat4& model);
+		void drawMesh(const RenderSlot& slot, glm::mat4& view, glm::mat4& projection, glm::mat4& model);
 
 		/**
 		 * \brief 绘制坐标系.
@@ -188,6 +188,48 @@ namespace SparseSurfelFusion {
                 }
             }
         }
+        /**
+         * \brief 按(较细深度, 较粗深度, 中心偏移)计算紧凑的点积表，结果与setDotTables中 table[i + res * j] (i >= j) 完全一致.
+         *        紧凑表第(dF, dC)段的第(halfRange[dF - dC] + delta)个元素，对应较细基函数中心为0、较粗基函数中心为 delta * w1 / 2 的基函数对.
+         * 
+         * \param pairBase 每段的起始位置，下标为dF * (depth + 1) + dC
+         * \param halfRange 深度差为k时delta的最大绝对值
+         * \param dot 【输出】基函数的点积表，NULL则不计算
+         * \param dDot 【输出】基函数一阶导数的点积表，NULL则不计算
+         * \param d2Dot 【输出】基函数二阶导数的点积表，NULL则不计算
+         */
+        void setCompactDotTables(const int* pairBase, const int* halfRange, double* dot, double* dDot, double* d2Dot) const {
+            const double t1 = baseFunction.polys[0].start;
+            const double t2 = baseFunction.polys[baseFunction.polyCount - 1].start;
+            for (int dF = 0; dF <= depth; dF++) {
+                const double w1 = 1.0 / (1 << dF);
+                const double start1 = t1 * w1;
+                const double end1 = t2 * w1;
+                for (int dC = 0; dC <= dF; dC++) {
+                    const double w2 = 1.0 / (1 << dC);
+                    const int range = halfRange[dF - dC];
+                    for (int delta = -range; delta <= range; delta++) {
+                        const int idx = pairBase[dF * (depth + 1) + dC] + range + delta;
+                        if (dot) dot[idx] = 0;
+                        if (dDot) dDot[idx] = 0;
+                        if (d2Dot) d2Dot[idx] = 0;
+                        const double c2 = delta * w1 * 0.5;   // 较细基函数的中心平移到0
+                        double start = t1 * w2 + c2;
+                        double end = t2 * w2 + c2;
+                        if (start < start1) { start = start1; }
+                        if (end > end1) { end = end1; }
+                        if (start >= end) { continue; }
+
+                        const double value = dotProduct(0, w1, c2, w2);
+                        if (fabs(value) < 1e-15) { continue; }
+                        if (dot) dot[idx] = value;
+                        if (dDot) dDot[idx] = useDotRatios ? dDotProduct(0, w1, c2, w2) / value : dDotProduct(0, w1, c2, w2);
+                        if (d2Dot) d2Dot[idx] = useDotRatios ? d2DotProduct(0, w1, c2, w2) / value : d2DotProduct(0, w1, c2, w2);
+                    }
+                }
+            }
+        }
+
         /**
          * \brief 清空点积查询表.
          * 
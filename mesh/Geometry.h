@@ -8,8 +8,7 @@
 #pragma once
 #include <math.h>
 #include <vector>
-#include <device_launch_parameters.h>
-#include <cuda_runtime_api.h>
+#include <base/HostDeviceCompat.h>
 
 namespace SparseSurfelFusion {
     /**
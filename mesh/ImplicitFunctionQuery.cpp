@@ -0,0 +1,33 @@
+/*****************************************************************//**
+ * \file   ImplicitFunctionQuery.cpp
+ * \brief  隐式函数查询Host端方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "ImplicitFunctionQuery.h"
+#include "ComputeTriangleIndices.h"
+
+SparseSurfelFusion::ImplicitFunctionQuery::ImplicitFunctionQuery()
+{
+	BaseFunctionValueTable.AllocateBuffer(F_DATA_RES * BASE_FUNCTION_TABLE_RES);
+}
+
+SparseSurfelFusion::ImplicitFunctionQuery::~ImplicitFunctionQuery()
+{
+	BaseFunctionValueTable.ReleaseBuffer();
+	QueryPointsBuffer.ReleaseBuffer();
+	QueryValuesBuffer.ReleaseBuffer();
+}
+
+void SparseSurfelFusion::ImplicitFunctionQuery::QueryPoints(const std::vector<Point3D<float>>& points, std::vector<float>& values, cudaStream_t stream)
+{
+	values.resize(points.size());
+	if (points.empty()) return;
+	QueryPointsBuffer.ResizeArray(points.size(), true);
+	QueryValuesBuffer.ResizeArray(points.size(), true);
+	CHECKCUDA(cudaMemcpyAsync(QueryPointsBuffer.Ptr(), points.data(), sizeof(Point3D<float>) * points.size(), cudaMemcpyHostToDevice, stream));
+	QueryPoints(QueryPointsBuffer.ArrayView(), QueryValuesBuffer.Ptr(), stream);
+	CHECKCUDA(cudaMemcpyAsync(values.data(), QueryValuesBuffer.Ptr(), sizeof(float) * points.size(), cudaMemcpyDeviceToHost, stream));
+	CHECKCUDA(cudaStreamSynchronize(stream));
+}
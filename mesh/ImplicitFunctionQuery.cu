@@ -0,0 +1,188 @@
+/*****************************************************************//**
+ * \file   ImplicitFunctionQuery.cu
+ * \brief  隐式函数查询核函数与方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "ImplicitFunctionQuery.h"
+#include "ComputeTriangleIndices.h"
+
+namespace SparseSurfelFusion {
+	namespace device {
+		__device__ __constant__ int queryDecodeOffset_1 = (1 << (MAX_DEPTH_OCTREE + 1));
+
+		__device__ __constant__ int queryDecodeOffset_2 = (1 << (2 * (MAX_DEPTH_OCTREE + 1)));
+	}
+}
+
+__device__ float SparseSurfelFusion::device::evaluateImplicitFunction(const ImplicitFunctionView& function, const Point3D<float>& pos)
+{
+	for (int i = 0; i < 3; i++) {
+		if (!(0.0f <= pos.coords[i] && pos.coords[i] <= 1.0f)) return -function.isoValue;	// 单位立方体外(含NaN)指示函数为0
+	}
+
+	// pos在maxDepth网格格点上时三个方向的基函数值都可以查表
+	const float scale = float(1 << MAX_DEPTH_OCTREE);
+	int gridCoord[3];
+	bool onGrid = true;
+	for (int i = 0; i < 3; i++) {
+		const float g = pos.coords[i] * scale;
+		gridCoord[i] = __float2int_rn(g);
+		onGrid = onGrid && fabsf(g - gridCoord[i]) <= 1e-3f;
+	}
+
+	// pos所在的单元在某层不存在时，该层的邻居仍可能存在且支撑覆盖pos，因此不能停在包含pos的最深节点：
+	// 沿pos所在的单元逐层下降，第d + 1层的27邻居是第d层27邻居的孩子(孩子号c = (x << 2) | (y << 1) | z)，直到整个邻域为空
+	int neighbor[27];
+	for (int k = 0; k < 27; k++) neighbor[k] = -1;
+	neighbor[13] = 0;
+	int cell[3] = { 0, 0, 0 };
+	float val = 0.0f;
+	for (int depth = 0; ; depth++) {
+		for (int k = 0; k < 27; k++) {
+			if (neighbor[k] == -1) continue;
+			const EncodedFunctionIndex encodeIdx = function.encodeNodeIndexInFunction[neighbor[k]];
+			const int idxX = int(encodeIdx % queryDecodeOffset_1);
+			const int idxY = int((encodeIdx / queryDecodeOffset_1) % queryDecodeOffset_1);
+			const int idxZ = int(encodeIdx / queryDecodeOffset_2);
+			float product;
+			if (onGrid) {
+				const float* table = function.BaseFunctionValueTable;
+				product = __ldg(&table[idxX * BASE_FUNCTION_TABLE_RES + gridCoord[0]]) * __ldg(&table[idxY * BASE_FUNCTION_TABLE_RES + gridCoord[1]]) * __ldg(&table[idxZ * BASE_FUNCTION_TABLE_RES + gridCoord[2]]);
+			}
+			else {
+				product = value(function.BaseFunctions[idxX], pos.coords[0]) * value(function.BaseFunctions[idxY], pos.coords[1]) * value(function.BaseFunctions[idxZ], pos.coords[2]);
+			}
+			val += function.dx[neighbor[k]] * product;
+		}
+		if (depth == MAX_DEPTH_OCTREE) break;
+		const int resolution = 1 << (depth + 1);
+		int finerCell[3];
+		for (int i = 0; i < 3; i++) {
+			finerCell[i] = min(int(pos.coords[i] * resolution), resolution - 1);
+		}
+		int finerNeighbor[27];
+		bool empty = true;
+		for (int k = 0; k < 27; k++) {
+			const int offset[3] = { k / 9 - 1, (k / 3) % 3 - 1, k % 3 - 1 };
+			int parentK = 0, c = 0;
+			bool inside = true;
+			for (int i = 0; i < 3; i++) {
+				const int coord = finerCell[i] + offset[i];
+				if (coord < 0 || coord >= resolution) {
+					inside = false;
+					break;
+				}
+				parentK = 3 * parentK + (coord >> 1) - cell[i] + 1;
+				c = (c << 1) | (coord & 1);
+			}
+			const int parentNode = inside ? neighbor[parentK] : -1;
+			finerNeighbor[k] = parentNode == -1 ? -1 : function.NodeTopology.Child(parentNode, c);
+			if (finerNeighbor[k] != -1) empty = false;
+		}
+		if (empty) break;
+		for (int k = 0; k < 27; k++) neighbor[k] = finerNeighbor[k];
+		for (int i = 0; i < 3; i++) cell[i] = finerCell[i];
+	}
+	return val - function.isoValue;
+}
+
+__global__ void SparseSurfelFusion::device::queryImplicitFunctionKernel(ImplicitFunctionView function, const Point3D<float>* points, const unsigned int pointsNum, float* values)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= pointsNum) return;
+	values[idx] = evaluateImplicitFunction(function, points[idx]);
+}
+
+__global__ void SparseSurfelFusion::device::sampleDenseGridKernel(ImplicitFunctionView function, const int resolutionLog2, float* values)
+{
+	const unsigned int samplesPerAxis = (1u << resolutionLog2) + 1;
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= samplesPerAxis * samplesPerAxis * samplesPerAxis) return;
+	const unsigned int x = idx % samplesPerAxis;
+	const unsigned int y = (idx / samplesPerAxis) % samplesPerAxis;
+	const unsigned int z = idx / (samplesPerAxis * samplesPerAxis);
+	const float step = 1.0f / float(1 << resolutionLog2);	// 2的幂的倒数，格点坐标精确
+	Point3D<float> pos;
+	pos.coords[0] = x * step;
+	pos.coords[1] = y * step;
+	pos.coords[2] = z * step;
+	values[idx] = evaluateImplicitFunction(function, pos);
+}
+
+__global__ void SparseSurfelFusion::device::sampleSparseBricksKernel(ImplicitFunctionView function, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int brickOffset, const unsigned int brickNum, const int brickDepth, const int brickResolutionLog2, float3* brickOrigins, float* values)
+{
+	const unsigned int samplesPerAxis = (1u << brickResolutionLog2) + 1;
+	const unsigned int samplesPerBrick = samplesPerAxis * samplesPerAxis * samplesPerAxis;
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= brickNum * samplesPerBrick) return;
+	const unsigned int brick = idx / samplesPerBrick;
+	const unsigned int sample = idx % samplesPerBrick;
+	const float halfWidth = 1.0f / float(1 << (brickDepth + 1));
+	const Point3D<float> center = CenterBuffer[brickOffset + brick];
+	const float3 origin = make_float3(center.coords[0] - halfWidth, center.coords[1] - halfWidth, center.coords[2] - halfWidth);
+	if (sample == 0) brickOrigins[brick] = origin;
+	const float step = 2.0f * halfWidth / float(1 << brickResolutionLog2);
+	Point3D<float> pos;
+	pos.coords[0] = origin.x + (sample % samplesPerAxis) * step;
+	pos.coords[1] = origin.y + ((sample / samplesPerAxis) % samplesPerAxis) * step;
+	pos.coords[2] = origin.z + (sample / (samplesPerAxis * samplesPerAxis)) * step;
+	values[idx] = evaluateImplicitFunction(function, pos);
+}
+
+void SparseSurfelFusion::ImplicitFunctionQuery::Bind(OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream)
+{
+	if (BaseFunction.RawPtr() != tabulatedBaseFunction) {	// 基函数在重建的整个生命周期内不变，只需构建一次
+		const unsigned int tableSize = BaseFunction.Size() * BASE_FUNCTION_TABLE_RES;
+		BaseFunctionValueTable.ResizeArray(tableSize, true);
+		dim3 block(256);
+		dim3 grid(divUp(tableSize, block.x));
+		device::buildBaseFunctionValueTableKernel << <grid, block, 0, stream >> > (BaseFunction, tableSize, BaseFunctionValueTable.Ptr());
+		tabulatedBaseFunction = BaseFunction.RawPtr();
+	}
+	function.NodeTopology = NodeTopology;
+	function.BaseFunctions = BaseFunction;
+	function.dx = dx.RawPtr();
+	function.encodeNodeIndexInFunction = encodeNodeIndexInFunction.RawPtr();
+	function.BaseFunctionValueTable = BaseFunctionValueTable.Ptr();
+	function.isoValue = isoValue;
+}
+
+void SparseSurfelFusion::ImplicitFunctionQuery::QueryPoints(DeviceArrayView<Point3D<float>> points, float* values, cudaStream_t stream)
+{
+	if (!IsBound()) LOGGING(FATAL) << "ImplicitFunctionQuery: 尚未绑定求解结果";
+	const unsigned int pointsNum = points.Size();
+	if (pointsNum == 0) return;
+	dim3 block(128);
+	dim3 grid(divUp(pointsNum, block.x));
+	device::queryImplicitFunctionKernel << <grid, block, 0, stream >> > (function, points.RawPtr(), pointsNum, values);
+}
+
+void SparseSurfelFusion::ImplicitFunctionQuery::SampleDenseGrid(const int resolutionLog2, DeviceBufferArray<float>& values, cudaStream_t stream)
+{
+	if (!IsBound()) LOGGING(FATAL) << "ImplicitFunctionQuery: 尚未绑定求解结果";
+	if (resolutionLog2 < 0 || resolutionLog2 > MAX_IMPLICIT_GRID_RESOLUTION_LOG2) LOGGING(FATAL) << "ImplicitFunctionQuery: 稠密网格分辨率log2 = " << resolutionLog2 << " 超出[0, " << MAX_IMPLICIT_GRID_RESOLUTION_LOG2 << "]";
+	const unsigned int samplesPerAxis = (1u << resolutionLog2) + 1;
+	const unsigned int sampleNum = samplesPerAxis * samplesPerAxis * samplesPerAxis;
+	values.ResizeArray(sampleNum, true);
+	dim3 block(128);
+	dim3 grid(divUp(sampleNum, block.x));
+	device::sampleDenseGridKernel << <grid, block, 0, stream >> > (function, resolutionLog2, values.Ptr());
+}
+
+void SparseSurfelFusion::ImplicitFunctionQuery::SampleSparseBricks(DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int brickOffset, const unsigned int brickNum, const int brickDepth, const int brickResolutionLog2, DeviceBufferArray<float3>& brickOrigins, DeviceBufferArray<float>& values, cudaStream_t stream)
+{
+	if (!IsBound()) LOGGING(FATAL) << "ImplicitFunctionQuery: 尚未绑定求解结果";
+	if (brickDepth < 0 || brickDepth > MAX_DEPTH_OCTREE) LOGGING(FATAL) << "ImplicitFunctionQuery: 块所在层 " << brickDepth << " 超出[0, " << MAX_DEPTH_OCTREE << "]";
+	if (brickResolutionLog2 < 0 || brickResolutionLog2 > MAX_IMPLICIT_GRID_RESOLUTION_LOG2) LOGGING(FATAL) << "ImplicitFunctionQuery: 块分辨率log2 = " << brickResolutionLog2 << " 超出[0, " << MAX_IMPLICIT_GRID_RESOLUTION_LOG2 << "]";
+	const unsigned int samplesPerAxis = (1u << brickResolutionLog2) + 1;
+	const size_t sampleNum = (size_t)brickNum * samplesPerAxis * samplesPerAxis * samplesPerAxis;
+	if (sampleNum > 0xffffffffull) LOGGING(FATAL) << "ImplicitFunctionQuery: 稀疏块采样数量 " << sampleNum << " 超出32位索引";
+	brickOrigins.ResizeArray(brickNum, true);
+	values.ResizeArray(sampleNum, true);
+	if (sampleNum == 0) return;
+	dim3 block(128);
+	dim3 grid(divUp((unsigned int)sampleNum, block.x));
+	device::sampleSparseBricksKernel << <grid, block, 0, stream >> > (function, CenterBuffer, brickOffset, brickNum, brickDepth, brickResolutionLog2, brickOrigins.Ptr(), values.Ptr());
+}
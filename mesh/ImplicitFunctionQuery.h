@@ -0,0 +1,159 @@
+/*****************************************************************//**
+ * \file   ImplicitFunctionQuery.h
+ * \brief  隐式函数查询：求解得到的指示函数在任意点上批量求值，以及导出稠密/稀疏块网格(供碰撞检测、路径规划或3D纹理使用)
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <cuda_runtime_api.h>
+#include <base/Constants.h>
+#include <base/DeviceReadWrite/DeviceBufferArray.h>
+
+#include "ConfirmedPPolynomial.h"
+#include "OctNode.cuh"
+
+#define MAX_IMPLICIT_GRID_RESOLUTION_LOG2 9		// 稠密网格每维最多2^9 + 1个采样(约0.5GB)
+
+namespace SparseSurfelFusion {
+	namespace device {
+		/**
+		 * \brief 一帧求解结果的只读视图，按值传入核函数.
+		 */
+		struct ImplicitFunctionView {
+			OctNodeTopologyView NodeTopology;										// 节点拓扑(SoA)视图
+			DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions;	// 基函数
+			const float* dx = NULL;													// 求解得到的系数
+			const EncodedFunctionIndex* encodeNodeIndexInFunction = NULL;			// 节点基函数索引
+			const float* BaseFunctionValueTable = NULL;								// 基函数在maxDepth网格格点上的值
+			float isoValue = 0.0f;													// 等值
+		};
+
+		/**
+		 * \brief 沿pos所在的单元由根节点逐层下降，累加每层27邻居中支撑覆盖pos的节点的基函数贡献，直到邻域为空(pos所在单元不存在的层上的邻居也计入).
+		 *        CPU后端的CpuLaplacianSolver::EvaluateImplicitFunction与之一致.
+		 *        pos在maxDepth网格格点上时基函数值查表，否则逐段求多项式.
+		 *
+		 * \param function 求解结果视图
+		 * \param pos 归一化坐标下的查询点
+		 * \return 隐式函数值 - 等值，单位立方体外为 -等值
+		 */
+		__device__ float evaluateImplicitFunction(const ImplicitFunctionView& function, const Point3D<float>& pos);
+
+		/**
+		 * \brief 批量查询任意点的隐式函数值.
+		 *
+		 * \param function 求解结果视图
+		 * \param points 归一化坐标下的查询点
+		 * \param pointsNum 查询点数量
+		 * \param values 【输出】隐式函数值 - 等值
+		 */
+		__global__ void queryImplicitFunctionKernel(ImplicitFunctionView function, const Point3D<float>* points, const unsigned int pointsNum, float* values);
+
+		/**
+		 * \brief 在单位立方体上按(2^resolutionLog2 + 1)^3的格点采样，x变化最快.
+		 *
+		 * \param function 求解结果视图
+		 * \param resolutionLog2 每维的网格数log2，不超过maxDepth时格点都在maxDepth网格上
+		 * \param values 【输出】隐式函数值 - 等值
+		 */
+		__global__ void sampleDenseGridKernel(ImplicitFunctionView function, const int resolutionLog2, float* values);
+
+		/**
+		 * \brief 在brickDepth层每个节点内按(2^brickResolutionLog2 + 1)^3的格点采样，块的格点包含节点边界，x变化最快.
+		 *
+		 * \param function 求解结果视图
+		 * \param CenterBuffer 节点中心
+		 * \param brickOffset brickDepth层首节点在NodeArray中的偏移
+		 * \param brickNum brickDepth层节点数量
+		 * \param brickDepth 块所在层
+		 * \param brickResolutionLog2 每个块每维的网格数log2
+		 * \param brickOrigins 【输出】每个块的最小角点(归一化坐标)
+		 * \param values 【输出】每个块的采样，块i的采样位于[i * (2^brickResolutionLog2 + 1)^3, (i + 1) * (2^brickResolutionLog2 + 1)^3)
+		 */
+		__global__ void sampleSparseBricksKernel(ImplicitFunctionView function, DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int brickOffset, const unsigned int brickNum, const int brickDepth, const int brickResolutionLog2, float3* brickOrigins, float* values);
+	}
+
+	/**
+	 * \brief 隐式函数查询引擎：LaplacianCGSolver之后绑定本帧的dx、基函数、基函数索引与等值，
+	 *        批量查询任意点，或导出覆盖单位立方体的稠密网格与只覆盖表面附近节点的稀疏块网格.
+	 *        输出均为 隐式函数值 - 等值，符号区分内外(占据)，数值不是欧氏距离.
+	 *        绑定的视图在下一帧重建开始前有效.
+	 */
+	class ImplicitFunctionQuery
+	{
+	public:
+		using Ptr = std::shared_ptr<ImplicitFunctionQuery>;
+
+		ImplicitFunctionQuery();
+
+		~ImplicitFunctionQuery();
+
+		/**
+		 * \brief 绑定本帧的求解结果，首次绑定(或基函数变化)时在stream上构建基函数值表.
+		 *
+		 * \param NodeTopology 节点拓扑(SoA)视图
+		 * \param BaseFunction 基函数
+		 * \param dx 求解得到的系数
+		 * \param encodeNodeIndexInFunction 节点基函数索引
+		 * \param isoValue 等值
+		 * \param stream cuda流
+		 */
+		void Bind(OctNodeTopologyView NodeTopology, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunction, DeviceArrayView<float> dx, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const float isoValue, cudaStream_t stream);
+
+		/**
+		 * \brief 是否已绑定求解结果.
+		 */
+		bool IsBound() const { return function.dx != NULL; }
+
+		/**
+		 * \brief 批量查询设备端的点【无阻塞】.
+		 *
+		 * \param points 归一化坐标下的查询点
+		 * \param values 【输出】隐式函数值 - 等值，大小不小于points.Size()
+		 * \param stream cuda流
+		 */
+		void QueryPoints(DeviceArrayView<Point3D<float>> points, float* values, cudaStream_t stream);
+
+		/**
+		 * \brief 批量查询Host端的点【阻塞Host】.
+		 *
+		 * \param points 归一化坐标下的查询点
+		 * \param values 【输出】隐式函数值 - 等值
+		 * \param stream cuda流
+		 */
+		void QueryPoints(const std::vector<Point3D<float>>& points, std::vector<float>& values, cudaStream_t stream);
+
+		/**
+		 * \brief 导出覆盖单位立方体的稠密网格【无阻塞】，每维2^resolutionLog2 + 1个格点，x变化最快.
+		 *
+		 * \param resolutionLog2 每维的网格数log2，不超过MAX_IMPLICIT_GRID_RESOLUTION_LOG2
+		 * \param values 【输出】格点上的隐式函数值 - 等值
+		 * \param stream cuda流
+		 */
+		void SampleDenseGrid(const int resolutionLog2, DeviceBufferArray<float>& values, cudaStream_t stream);
+
+		/**
+		 * \brief 导出稀疏块网格【无阻塞】：brickDepth层每个节点一个块，块内每维2^brickResolutionLog2 + 1个格点.
+		 *        brickDepth + brickResolutionLog2不超过maxDepth时格点都在maxDepth网格上，全部查表.
+		 *
+		 * \param CenterBuffer 节点中心
+		 * \param brickOffset brickDepth层首节点在NodeArray中的偏移
+		 * \param brickNum brickDepth层节点数量
+		 * \param brickDepth 块所在层
+		 * \param brickResolutionLog2 每个块每维的网格数log2
+		 * \param brickOrigins 【输出】每个块的最小角点(归一化坐标)
+		 * \param values 【输出】块的格点上的隐式函数值 - 等值
+		 * \param stream cuda流
+		 */
+		void SampleSparseBricks(DeviceArrayView<Point3D<float>> CenterBuffer, const unsigned int brickOffset, const unsigned int brickNum, const int brickDepth, const int brickResolutionLog2, DeviceBufferArray<float3>& brickOrigins, DeviceBufferArray<float>& values, cudaStream_t stream);
+
+	private:
+		device::ImplicitFunctionView function;							// 绑定的求解结果
+		DeviceBufferArray<float> BaseFunctionValueTable;				// 基函数在maxDepth网格格点上的值
+		const void* tabulatedBaseFunction = NULL;						// 基函数值表对应的基函数地址，地址不变则无需重建
+		DeviceBufferArray<Point3D<float>> QueryPointsBuffer;			// Host查询点的设备端副本
+		DeviceBufferArray<float> QueryValuesBuffer;						// Host查询结果的设备端副本
+	};
+}
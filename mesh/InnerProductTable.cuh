@@ -0,0 +1,126 @@
+/*****************************************************************//**
+ * \file   InnerProductTable.cuh
+ * \brief  按(深度对, 中心偏移)存储的紧凑基函数内积表
+ *
+ * \author LUOJIAXUAN
+ * \date   May 15th 2024
+ *********************************************************************/
+#pragma once
+#include <math.h>
+#include <base/HostDeviceCompat.h>
+
+#define INNER_PRODUCT_TABLE_DEPTH_NUM (MAX_DEPTH_OCTREE + 1)		// 内积表覆盖的深度数量[0, maxDepth]
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 基函数内积表的紧凑视图.
+	 *        基函数是同一个函数按节点宽度缩放、按节点中心平移得到的，两个基函数的内积只依赖两者的深度和中心之差.
+	 *        因此按(较细深度dF, 较粗深度dC)分段，每段以 delta = 2 * (c2 - c1) / w1 (较细节点半宽为单位，必为整数) 为下标，
+	 *        超出支撑范围的delta内积为0不存储，表大小由O(4^maxDepth)降为O(maxDepth * 2^maxDepth).
+	 *        DotFF(i, j)、DotFDF(i, j)、DotFD2F(i, j)与原res * res表中的 table[i + res * j] 完全一致.
+	 */
+	struct InnerProductTableView {
+		const double* dot_F_F = NULL;		// 基函数的点积表
+		const double* dot_F_DF = NULL;		// 基函数一阶导数的点积表
+		const double* dot_F_D2F = NULL;		// 基函数二阶导数的点积表
+		int pairBase[INNER_PRODUCT_TABLE_DEPTH_NUM * INNER_PRODUCT_TABLE_DEPTH_NUM] = { 0 };	// (dF, dC)段的起始位置，下标为dF * INNER_PRODUCT_TABLE_DEPTH_NUM + dC
+		int halfRange[INNER_PRODUCT_TABLE_DEPTH_NUM] = { 0 };		// 深度差为k时delta的最大绝对值
+
+		/**
+		 * \brief 按基函数支撑半径设置分段，返回每张表需要的元素数量.
+		 *
+		 * \param supportRadius 归一化基函数的支撑半径(基函数在[-r, r]外为0)
+		 * \return 每张表的元素数量
+		 */
+		__host__ int SetLayout(const double supportRadius) {
+			for (int k = 0; k < INNER_PRODUCT_TABLE_DEPTH_NUM; k++) {
+				halfRange[k] = (int)ceil(2.0 * supportRadius * (1 + (1 << k)));
+			}
+			int size = 0;
+			for (int dF = 0; dF < INNER_PRODUCT_TABLE_DEPTH_NUM; dF++) {
+				for (int dC = 0; dC <= dF; dC++) {
+					pairBase[dF * INNER_PRODUCT_TABLE_DEPTH_NUM + dC] = size;
+					size += 2 * halfRange[dF - dC] + 1;
+				}
+			}
+			return size;
+		}
+
+		/**
+		 * \brief 基函数index所在的深度.
+		 */
+		__host__ __device__ __forceinline__ static int Depth(const int index) {
+#if defined(__CUDA_ARCH__)
+			return 31 - __clz(index + 1);
+#else
+			int depth = -1;
+			for (int i = index + 1; i; i >>= 1) depth++;
+			return depth;
+#endif
+		}
+
+		/**
+		 * \brief 查找基函数对(i, j)在紧凑表中的位置，i <= j时交换为(j, i)并记录交换.
+		 *
+		 * \param i 基函数index
+		 * \param j 基函数index
+		 * \param swapped 【输出】是否交换了i与j
+		 * \return 紧凑表中的位置，超出支撑范围返回-1
+		 */
+		__host__ __device__ __forceinline__ int Locate(int i, int j, bool& swapped) const {
+			swapped = i <= j;	// i == j时与原表一致取-<F_i', F_i>(理论上为0)
+			if (swapped) { const int t = i; i = j; j = t; }
+			const int dF = Depth(i), dC = Depth(j);
+			const int k = dF - dC;
+			const int oF = i - ((1 << dF) - 1);
+			const int oC = j - ((1 << dC) - 1);
+			const int delta = ((2 * oC + 1) << k) - (2 * oF + 1);
+			if (delta > halfRange[k] || delta < -halfRange[k]) return -1;
+			return pairBase[dF * INNER_PRODUCT_TABLE_DEPTH_NUM + dC] + halfRange[k] + delta;
+		}
+
+		/**
+		 * \brief 只读加载，设备端走只读缓存.
+		 */
+		__host__ __device__ __forceinline__ static double Load(const double* ptr) {
+#if defined(__CUDA_ARCH__)
+			return __ldg(ptr);
+#else
+			return *ptr;
+#endif
+		}
+
+		/** \brief <F_i, F_j>. */
+		__host__ __device__ __forceinline__ double DotFF(const int i, const int j) const {
+			bool swapped;
+			const int pos = Locate(i, j, swapped);
+			return pos < 0 ? 0.0 : Load(&dot_F_F[pos]);
+		}
+
+		/**
+		 * \brief 一次查找同时取<F_i, F_j>与<F_i', F_j'>，Laplace元素需要二者.
+		 */
+		__host__ __device__ __forceinline__ void DotFFAndFD2F(const int i, const int j, double& ff, double& fd2f) const {
+			bool swapped;
+			const int pos = Locate(i, j, swapped);
+			ff = pos < 0 ? 0.0 : Load(&dot_F_F[pos]);
+			fd2f = pos < 0 ? 0.0 : Load(&dot_F_D2F[pos]);
+		}
+
+		/** \brief <F_i', F_j>，交换i与j时变号. */
+		__host__ __device__ __forceinline__ double DotFDF(const int i, const int j) const {
+			bool swapped;
+			const int pos = Locate(i, j, swapped);
+			if (pos < 0) return 0.0;
+			const double value = Load(&dot_F_DF[pos]);
+			return swapped ? -value : value;
+		}
+
+		/** \brief <F_i', F_j'>. */
+		__host__ __device__ __forceinline__ double DotFD2F(const int i, const int j) const {
+			bool swapped;
+			const int pos = Locate(i, j, swapped);
+			return pos < 0 ? 0.0 : Load(&dot_F_D2F[pos]);
+		}
+	};
+}
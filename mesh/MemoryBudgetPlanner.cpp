@@ -0,0 +1,142 @@
+/*****************************************************************//**
+ * \file   MemoryBudgetPlanner.cpp
+ * \brief  显存预算规划实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "MemoryBudgetPlanner.h"
+#include <algorithm>
+#include <pcl/point_types.h>
+#include <base/CommonTypes.h>
+#include "OctNode.cuh"
+
+namespace SparseSurfelFusion {
+	namespace {
+		// 网格几何按实际数量分配，按稀疏表面八叉树的共享关系保守估计：
+		// 满网格中每个节点平均拥有1个顶点、3条边、3个面，表面壳层的共享远少于满网格，取满网格的数倍
+		const double VerticesPerNode = 4.0;			// 每个节点平均的唯一顶点数
+		const double EdgesPerDLevelNode = 6.0;		// 每个maxDepth层节点平均的唯一边数
+		const double FacesPerNode = 4.0;			// 每个节点平均的唯一面数
+
+		/**
+		 * \brief 与BuildMeshGeometry一致的去重哈希表显存：容量取元素上界2倍以上的2的幂，每项一个key与一个Owner.
+		 */
+		size_t dedupHashBytes(const size_t nodeCount, const size_t perSiblingGroup) {
+			const size_t elementsBound = ((nodeCount + 7) / 8 + MAX_DEPTH_OCTREE + 1) * perSiblingGroup;
+			size_t tableCapacity = 1;
+			while (tableCapacity < 2 * elementsBound) tableCapacity <<= 1;
+			return tableCapacity * (sizeof(unsigned long long) + sizeof(int)) + nodeCount * (sizeof(unsigned short) + 2 * sizeof(unsigned int));
+		}
+	}
+}
+
+size_t SparseSurfelFusion::MemoryBudgetPlanner::EstimateStages(const ReconstructionConfig& config, const bool matrixFree, const bool tiled, std::vector<MemoryStageEstimate>& stages)
+{
+	stages.clear();
+	const size_t N = config.maxSurfelCount;
+	const size_t T = config.TotalNodeArrayCount();
+	const size_t D = config.DLevelMaxNode();
+	const size_t C = config.CoarserNodeArrayCount();
+	const size_t M = config.maxMeshTriangleCount;
+	auto add = [&stages](const char* name, const double bytes) {
+		MemoryStageEstimate stage;
+		stage.name = name;
+		stage.bytes = (size_t)bytes;
+		stages.push_back(stage);
+	};
+
+	// 输入：稠密面元、点、法线、颜色
+	add("input", N * (double)(sizeof(DepthSurfel) + sizeof(pcl::PointXYZ) + sizeof(pcl::Normal) + sizeof(float3)));
+	if (tiled) add("tile_upload", 2.0 * N * sizeof(DepthSurfel));	// 分块重建的双缓冲块面元
+
+	// 八叉树：逐点的排序/压缩中间量，NodeArray(各层直接构建在其中)、节点属性与拓扑SoA，以及增量更新的D层签名
+	const double octreePerPoint = 3 * sizeof(OrientedPoint3D<float>) + 4 * sizeof(long long) + 8 * sizeof(unsigned int) + 2 * sizeof(OctNode);
+	const double octreePerNode = sizeof(OctNode) + sizeof(EncodedFunctionIndex) + sizeof(unsigned int) + sizeof(Point3D<float>) + sizeof(OctKey) + (1 + 8 + 27) * sizeof(int);
+	const double octreePerDLevelNode = sizeof(unsigned int) + 2 * (sizeof(OctKey) + sizeof(float4)) + sizeof(unsigned char);
+	add("octree", N * octreePerPoint + T * octreePerNode + D * octreePerDLevelNode);
+
+	// 向量场：maxDepth层节点的向量
+	add("vector_field", D * (double)sizeof(Point3D<float>));
+
+	// 散度：节点散度与工作量划分
+	add("divergence", T * (double)(sizeof(float) + 2 * sizeof(unsigned int)));
+
+	// 求解：解、非级联第一趟的解、上一帧的解与key、CG工作区，显式CSR矩阵每个节点最多27个非零元(未压缩与压缩各一份)
+	double solverPerNode = 3 * sizeof(float) + sizeof(OctKey) + 2 * sizeof(int) + 8 * sizeof(float);
+	if (!matrixFree) solverPerNode += 2 * 27 * (sizeof(int) + sizeof(float));
+	add("solver", T * solverPerNode + N * (double)sizeof(float));
+
+	// 网格几何：顶点/边/面数组、节点到元素的index与三类元素的去重哈希表(三条流同时占用)
+	const double geometryElements = T * VerticesPerNode * sizeof(VertexNode) + D * EdgesPerDLevelNode * sizeof(EdgeNode) + T * FacesPerNode * sizeof(FaceNode);
+	const double geometryIndex = (8.0 * T + 12.0 * D + 6.0 * T) * sizeof(int);
+	const double geometryHash = (double)dedupHashBytes(T, 27) + dedupHashBytes(D, 54) + dedupHashBytes(T, 36);
+	add("mesh_geometry", geometryElements + geometryIndex + geometryHash);
+
+	// 三角剖分：顶点隐式函数值、边上的顶点index、面相交标记、细分节点，以及输出网格与顶点焊接的中间量
+	const double triangulationPerNode = 8 * sizeof(float) + 6 * sizeof(int);
+	const double triangulationPerCoarserNode = sizeof(OctNode) + sizeof(bool) + sizeof(int);
+	const double triangulationPerVertex = 2 * sizeof(Point3D<float>) + sizeof(bool) + 2 * sizeof(unsigned long long) + 5 * sizeof(int);
+	add("triangulation", T * triangulationPerNode + D * 12.0 * sizeof(int) + C * triangulationPerCoarserNode + N * triangulationPerVertex + M * (double)(sizeof(TriangleIndex) + sizeof(bool)));
+
+	// 绘制：每个渲染槽位的顶点、法线、颜色与三角形
+	if (config.enableRender) add("draw", 2.0 * (N * 3.0 * sizeof(Point3D<float>) + M * (double)sizeof(TriangleIndex)));
+
+	add("fixed", (double)MEMORY_PLANNER_FIXED_BYTES);
+
+	size_t total = 0;
+	for (size_t i = 0; i < stages.size(); i++) total += stages[i].bytes;
+	return total;
+}
+
+size_t SparseSurfelFusion::MemoryBudgetPlanner::EstimateBytes(const ReconstructionConfig& config, const bool matrixFree, const bool tiled)
+{
+	std::vector<MemoryStageEstimate> stages;
+	return EstimateStages(config, matrixFree, tiled, stages);
+}
+
+SparseSurfelFusion::ReconstructionConfig SparseSurfelFusion::MemoryBudgetPlanner::ConfigWithCapacity(const ReconstructionConfig& baseConfig, const unsigned int maxSurfelCount)
+{
+	ReconstructionConfig config = baseConfig;
+	config.maxSurfelCount = maxSurfelCount;
+	// 三角形数量按默认上限的 三角形/面元 比例缩放，与FromPointCount一致
+	config.maxMeshTriangleCount = (unsigned int)((double)maxSurfelCount * MAX_MESH_TRIANGLE_COUNT / MAX_SURFEL_COUNT) + 1;
+	return config;
+}
+
+size_t SparseSurfelFusion::MemoryBudgetPlanner::QueryBudget(const int deviceId, const float usableFraction)
+{
+	int currentDevice = 0;
+	CHECKCUDA(cudaGetDevice(&currentDevice));
+	CHECKCUDA(cudaSetDevice(deviceId));
+	size_t freeBytes = 0, totalBytes = 0;
+	CHECKCUDA(cudaMemGetInfo(&freeBytes, &totalBytes));
+	CHECKCUDA(cudaSetDevice(currentDevice));
+	return (size_t)(freeBytes * (double)usableFraction);
+}
+
+SparseSurfelFusion::MemoryBudgetPlan SparseSurfelFusion::MemoryBudgetPlanner::Plan(const unsigned int pointsNum, const MemoryBudgetOptions& options, const ReconstructionConfig& baseConfig)
+{
+	MemoryBudgetPlan plan;
+	plan.budgetBytes = options.budgetBytes > 0 ? options.budgetBytes : QueryBudget(baseConfig.deviceId, options.usableFraction);
+
+	const unsigned int desiredCapacity = std::max((unsigned int)(pointsNum * options.headroom) + 1, MEMORY_PLANNER_MIN_SURFEL_COUNT);
+	plan.config = ConfigWithCapacity(baseConfig, desiredCapacity);
+	if (EstimateBytes(plan.config, options.matrixFree) > plan.budgetBytes) {
+		// 估计值随容量单调增加，二分出预算内的最大容量，以该容量分块重建
+		unsigned int low = MEMORY_PLANNER_MIN_SURFEL_COUNT, high = desiredCapacity;
+		if (EstimateBytes(ConfigWithCapacity(baseConfig, low), options.matrixFree, true) > plan.budgetBytes) {
+			LOGGING(FATAL) << "显存预算 " << (plan.budgetBytes >> 20) << " MB 连 " << low << " 个面元的分块都无法容纳";
+		}
+		while (low + 1 < high) {
+			const unsigned int middle = low + (high - low) / 2;
+			if (EstimateBytes(ConfigWithCapacity(baseConfig, middle), options.matrixFree, true) <= plan.budgetBytes) low = middle;
+			else high = middle;
+		}
+		plan.config = ConfigWithCapacity(baseConfig, low);
+		plan.tiled = true;
+	}
+	plan.config.CheckValid();
+	plan.estimatedBytes = EstimateStages(plan.config, options.matrixFree, plan.tiled, plan.stages);
+	return plan;
+}
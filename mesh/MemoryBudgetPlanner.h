@@ -0,0 +1,95 @@
+/*****************************************************************//**
+ * \file   MemoryBudgetPlanner.h
+ * \brief  显存预算规划：在构造重建之前按点数估计各阶段的显存峰值，选出能放进预算的最大容量配置，放不下时改用分块重建
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <string>
+#include <vector>
+#include <cuda_runtime_api.h>
+#include <base/Logging.h>
+#include <base/DeviceAPI/safe_call.hpp>
+#include "ReconstructionConfig.h"
+
+#define MEMORY_PLANNER_FIXED_BYTES (64ull << 20)		// 与点数无关的显存(点积表、基函数表、细分标记、cub临时空间等)的估计上界
+#define MEMORY_PLANNER_MIN_SURFEL_COUNT (1u << 14)		// 分块重建时每块容量的下限，低于此值块间重叠占比过大
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 一个阶段的显存估计.
+	 */
+	struct MemoryStageEstimate {
+		std::string name;		// 阶段名称，与StageProfiler的阶段名一致
+		size_t bytes = 0;		// 估计的显存字节数
+	};
+
+	/**
+	 * \brief 规划选项.
+	 */
+	struct MemoryBudgetOptions {
+		size_t budgetBytes = 0;				// 显存预算，0表示取设备当前空闲显存 * usableFraction
+		float usableFraction = 0.9f;		// 未指定预算时可使用的空闲显存比例，留出驱动与碎片的余量
+		float headroom = 1.2f;				// 面元容量相对点数的余量倍数
+		bool matrixFree = false;			// 求解是否使用无矩阵Laplace算子(不需要27 * N的CSR矩阵)
+	};
+
+	/**
+	 * \brief 规划结果.
+	 */
+	struct MemoryBudgetPlan {
+		ReconstructionConfig config;					// 选定的容量配置，用于构造PoissonReconstruction
+		bool tiled = false;								// 整体放不下，需用SolveTiledReconstructionMesh分块重建，每块容量为config.maxSurfelCount
+		size_t budgetBytes = 0;							// 实际使用的预算
+		size_t estimatedBytes = 0;						// config的显存估计
+		std::vector<MemoryStageEstimate> stages;		// config下各阶段的显存估计
+	};
+
+	/**
+	 * \brief 显存预算规划器.
+	 *        各模块在构造时按ReconstructionConfig预分配最坏情况的显存(NodeArray按nodeArrayFactor倍面元、maxDepth层按8倍面元)，
+	 *        网格几何等按实际数量增长的缓冲按稀疏表面八叉树的典型共享关系估计，因此估计值与容量线性相关.
+	 *        规划器在预算内取最大的面元容量：能容纳全部点(含余量)则整体重建，否则以能放下的容量分块重建.
+	 *        八叉树深度是编译期常量(MAX_DEPTH_OCTREE)，不能在运行时降低，分块是在固定深度下控制显存的唯一手段，且不损失分辨率.
+	 */
+	class MemoryBudgetPlanner
+	{
+	public:
+		/**
+		 * \brief 为pointsNum个点规划容量配置.
+		 *
+		 * \param pointsNum 输入点数量
+		 * \param options 规划选项
+		 * \param baseConfig 基础配置，deviceId、enableRender、nodeArrayFactor等非容量字段原样保留
+		 * \return 规划结果，预算连最小块都放不下时报错
+		 */
+		static MemoryBudgetPlan Plan(const unsigned int pointsNum, const MemoryBudgetOptions& options = MemoryBudgetOptions(), const ReconstructionConfig& baseConfig = ReconstructionConfig());
+
+		/**
+		 * \brief 估计config下各阶段的显存.
+		 *
+		 * \param config 容量配置
+		 * \param matrixFree 求解是否使用无矩阵Laplace算子
+		 * \param tiled 是否分块重建(额外的双缓冲块面元)
+		 * \param stages 【输出】各阶段的估计
+		 * \return 总字节数
+		 */
+		static size_t EstimateStages(const ReconstructionConfig& config, const bool matrixFree, const bool tiled, std::vector<MemoryStageEstimate>& stages);
+
+		/**
+		 * \brief 估计config下的总显存.
+		 */
+		static size_t EstimateBytes(const ReconstructionConfig& config, const bool matrixFree = false, const bool tiled = false);
+
+		/**
+		 * \brief 按面元容量生成配置，三角形容量按默认上限的比例缩放，其余字段取自baseConfig.
+		 */
+		static ReconstructionConfig ConfigWithCapacity(const ReconstructionConfig& baseConfig, const unsigned int maxSurfelCount);
+
+		/**
+		 * \brief 未指定预算时，查询设备的空闲显存并乘以可用比例.
+		 */
+		static size_t QueryBudget(const int deviceId, const float usableFraction);
+	};
+}
@@ -0,0 +1,211 @@
+/*****************************************************************//**
+ * \file   MeshExporter.cpp
+ * \brief  网格导出实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 12th 2024
+ *********************************************************************/
+#include "MeshExporter.h"
+#include <cstring>
+#include <algorithm>
+
+namespace SparseSurfelFusion {
+	namespace {
+		/**
+		 * \brief 按小端序追加一个值(x86与CUDA平台均为小端序，直接按字节拷贝).
+		 */
+		template<typename T>
+		void appendLittleEndian(std::vector<char>& record, const T& value) {
+			const size_t offset = record.size();
+			record.resize(offset + sizeof(T));
+			std::memcpy(record.data() + offset, &value, sizeof(T));
+		}
+
+		/**
+		 * \brief 颜色分量[0, 1]转为[0, 255].
+		 */
+		unsigned char toColorByte(const float value) {
+			const float scaled = value * 255.0f + 0.5f;
+			return (unsigned char)(scaled < 0.0f ? 0.0f : (scaled > 255.0f ? 255.0f : scaled));
+		}
+	}
+}
+
+SparseSurfelFusion::MeshExporter::MeshExporter(const int deviceId, std::shared_ptr<ThreadPool> threadPool) : deviceId(deviceId), pool(threadPool)
+{
+	if (pool == nullptr) pool = std::make_shared<ThreadPool>(1);
+	CHECKCUDA(cudaSetDevice(deviceId));
+	CHECKCUDA(cudaStreamCreateWithFlags(&downloadStream, cudaStreamNonBlocking));
+	CHECKCUDA(cudaEventCreateWithFlags(&snapshotReady, cudaEventDisableTiming));
+	for (int i = 0; i < 2; i++) {
+		CHECKCUDA(cudaEventCreateWithFlags(&chunkReady[i], cudaEventDisableTiming));
+		CHECKCUDA(cudaMallocHost(reinterpret_cast<void**>(&stagingAttributes[i]), sizeof(Point3D<float>) * MESH_EXPORTER_CHUNK_ELEMENTS * 3));
+		CHECKCUDA(cudaMallocHost(reinterpret_cast<void**>(&stagingTriangles[i]), sizeof(TriangleIndex) * MESH_EXPORTER_CHUNK_ELEMENTS));
+	}
+}
+
+SparseSurfelFusion::MeshExporter::~MeshExporter()
+{
+	Wait();
+	CHECKCUDA(cudaSetDevice(deviceId));
+	for (int i = 0; i < 2; i++) {
+		CHECKCUDA(cudaFreeHost(stagingAttributes[i]));
+		CHECKCUDA(cudaFreeHost(stagingTriangles[i]));
+		CHECKCUDA(cudaEventDestroy(chunkReady[i]));
+	}
+	CHECKCUDA(cudaEventDestroy(snapshotReady));
+	CHECKCUDA(cudaStreamDestroy(downloadStream));
+	snapshotVertices.ReleaseBuffer();
+	snapshotTriangles.ReleaseBuffer();
+	snapshotNormals.ReleaseBuffer();
+	snapshotColors.ReleaseBuffer();
+}
+
+bool SparseSurfelFusion::MeshExporter::Wait()
+{
+	if (!pending.valid()) return true;
+	return pending.get();
+}
+
+std::shared_future<bool> SparseSurfelFusion::MeshExporter::ExportAsync(const std::string& path, const MeshExportInput& mesh, const MeshFileFormat format, cudaStream_t stream)
+{
+	Wait();		// 快照与页锁定缓冲只有一份
+	CHECKCUDA(cudaSetDevice(deviceId));
+	const bool hasNormals = mesh.normals.Size() == mesh.vertices.Size() && mesh.vertices.Size() > 0;
+	const bool hasColors = mesh.colors.Size() == mesh.vertices.Size() && mesh.vertices.Size() > 0;
+
+	// 快照拷贝在调用方的流上排队，之后在该流上的重建天然排在拷贝之后
+	reserveSnapshot(snapshotVertices, mesh.vertices.Size());
+	reserveSnapshot(snapshotTriangles, mesh.triangles.Size());
+	CHECKCUDA(cudaMemcpyAsync(snapshotVertices.Ptr(), mesh.vertices.RawPtr(), sizeof(Point3D<float>) * mesh.vertices.Size(), cudaMemcpyDeviceToDevice, stream));
+	CHECKCUDA(cudaMemcpyAsync(snapshotTriangles.Ptr(), mesh.triangles.RawPtr(), sizeof(TriangleIndex) * mesh.triangles.Size(), cudaMemcpyDeviceToDevice, stream));
+	if (hasNormals) {
+		reserveSnapshot(snapshotNormals, mesh.normals.Size());
+		CHECKCUDA(cudaMemcpyAsync(snapshotNormals.Ptr(), mesh.normals.RawPtr(), sizeof(Point3D<float>) * mesh.normals.Size(), cudaMemcpyDeviceToDevice, stream));
+	}
+	if (hasColors) {
+		reserveSnapshot(snapshotColors, mesh.colors.Size());
+		CHECKCUDA(cudaMemcpyAsync(snapshotColors.Ptr(), mesh.colors.RawPtr(), sizeof(Point3D<float>) * mesh.colors.Size(), cudaMemcpyDeviceToDevice, stream));
+	}
+	CHECKCUDA(cudaEventRecord(snapshotReady, stream));
+
+	const Point3D<float> center = mesh.center;
+	const float scale = mesh.scale;
+	pending = pool->Submit(TaskPriority::Low, [this, path, format, hasNormals, hasColors, center, scale]() {	// 导出可延后，不抢占解析等关键路径任务
+		return exportSnapshot(path, format, hasNormals, hasColors, center, scale);
+	}).share();
+	return pending;
+}
+
+void SparseSurfelFusion::MeshExporter::downloadVertexChunk(const unsigned int chunk, const int buffer, const bool hasNormals, const bool hasColors)
+{
+	const size_t begin = (size_t)chunk * MESH_EXPORTER_CHUNK_ELEMENTS;
+	const size_t count = std::min((size_t)MESH_EXPORTER_CHUNK_ELEMENTS, snapshotVertices.ArraySize() - begin);
+	Point3D<float>* staging = stagingAttributes[buffer];
+	CHECKCUDA(cudaMemcpyAsync(staging, snapshotVertices.Ptr() + begin, sizeof(Point3D<float>) * count, cudaMemcpyDeviceToHost, downloadStream));
+	if (hasNormals) CHECKCUDA(cudaMemcpyAsync(staging + MESH_EXPORTER_CHUNK_ELEMENTS, snapshotNormals.Ptr() + begin, sizeof(Point3D<float>) * count, cudaMemcpyDeviceToHost, downloadStream));
+	if (hasColors) CHECKCUDA(cudaMemcpyAsync(staging + 2 * MESH_EXPORTER_CHUNK_ELEMENTS, snapshotColors.Ptr() + begin, sizeof(Point3D<float>) * count, cudaMemcpyDeviceToHost, downloadStream));
+	CHECKCUDA(cudaEventRecord(chunkReady[buffer], downloadStream));
+}
+
+void SparseSurfelFusion::MeshExporter::downloadTriangleChunk(const unsigned int chunk, const int buffer)
+{
+	const size_t begin = (size_t)chunk * MESH_EXPORTER_CHUNK_ELEMENTS;
+	const size_t count = std::min((size_t)MESH_EXPORTER_CHUNK_ELEMENTS, snapshotTriangles.ArraySize() - begin);
+	CHECKCUDA(cudaMemcpyAsync(stagingTriangles[buffer], snapshotTriangles.Ptr() + begin, sizeof(TriangleIndex) * count, cudaMemcpyDeviceToHost, downloadStream));
+	CHECKCUDA(cudaEventRecord(chunkReady[buffer], downloadStream));
+}
+
+void SparseSurfelFusion::MeshExporter::writeHeader(FILE* file, const MeshFileFormat format, const bool hasNormals, const bool hasColors) const
+{
+	if (format == MeshFileFormat::OBJ) {
+		fprintf(file, "# vertices %zu\n# faces %zu\n", snapshotVertices.ArraySize(), snapshotTriangles.ArraySize());
+		return;
+	}
+	fprintf(file, "ply\nformat binary_little_endian 1.0\n");
+	fprintf(file, "element vertex %zu\nproperty float x\nproperty float y\nproperty float z\n", snapshotVertices.ArraySize());
+	if (hasNormals) fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+	if (hasColors) fprintf(file, "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+	fprintf(file, "element face %zu\nproperty list uchar int vertex_indices\nend_header\n", snapshotTriangles.ArraySize());
+}
+
+bool SparseSurfelFusion::MeshExporter::exportSnapshot(const std::string path, const MeshFileFormat format, const bool hasNormals, const bool hasColors, const Point3D<float> center, const float scale)
+{
+	CHECKCUDA(cudaSetDevice(deviceId));
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		LOGGING(INFO) << "无法写入网格文件 " << path;
+		return false;
+	}
+	writeHeader(file, format, hasNormals, hasColors);
+	CHECKCUDA(cudaStreamWaitEvent(downloadStream, snapshotReady, 0));
+
+	const bool binary = format == MeshFileFormat::BinaryPLY;
+	const unsigned int vertexChunks = (unsigned int)divUp((int)snapshotVertices.ArraySize(), MESH_EXPORTER_CHUNK_ELEMENTS);
+	const unsigned int triangleChunks = (unsigned int)divUp((int)snapshotTriangles.ArraySize(), MESH_EXPORTER_CHUNK_ELEMENTS);
+	char text[128];
+
+	// 第i块写文件时第i+1块已在下载
+	if (vertexChunks > 0) downloadVertexChunk(0, 0, hasNormals, hasColors);
+	for (unsigned int chunk = 0; chunk < vertexChunks; chunk++) {
+		const int buffer = chunk & 1;
+		if (chunk + 1 < vertexChunks) downloadVertexChunk(chunk + 1, buffer ^ 1, hasNormals, hasColors);
+		else if (triangleChunks > 0) downloadTriangleChunk(0, buffer ^ 1);		// 三角形的第一块与最后一块顶点的写入重叠
+		CHECKCUDA(cudaEventSynchronize(chunkReady[buffer]));
+
+		const size_t count = std::min((size_t)MESH_EXPORTER_CHUNK_ELEMENTS, snapshotVertices.ArraySize() - (size_t)chunk * MESH_EXPORTER_CHUNK_ELEMENTS);
+		const Point3D<float>* vertices = stagingAttributes[buffer];
+		const Point3D<float>* normals = vertices + MESH_EXPORTER_CHUNK_ELEMENTS;
+		const Point3D<float>* colors = vertices + 2 * MESH_EXPORTER_CHUNK_ELEMENTS;
+		record.clear();
+		for (size_t i = 0; i < count; i++) {
+			float position[3];
+			for (int k = 0; k < 3; k++) position[k] = vertices[i].coords[k] * scale + center.coords[k];
+			if (binary) {
+				for (int k = 0; k < 3; k++) appendLittleEndian(record, position[k]);
+				if (hasNormals) for (int k = 0; k < 3; k++) appendLittleEndian(record, normals[i].coords[k]);
+				if (hasColors) for (int k = 0; k < 3; k++) appendLittleEndian(record, toColorByte(colors[i].coords[k]));
+			}
+			else {
+				int length = snprintf(text, sizeof(text), "v %.6f %.6f %.6f", position[0], position[1], position[2]);
+				if (hasColors) length += snprintf(text + length, sizeof(text) - length, " %.4f %.4f %.4f", colors[i].coords[0], colors[i].coords[1], colors[i].coords[2]);
+				record.insert(record.end(), text, text + length);
+				record.push_back('\n');
+				if (hasNormals) {
+					length = snprintf(text, sizeof(text), "vn %.6f %.6f %.6f\n", normals[i].coords[0], normals[i].coords[1], normals[i].coords[2]);
+					record.insert(record.end(), text, text + length);
+				}
+			}
+		}
+		fwrite(record.data(), 1, record.size(), file);
+	}
+
+	const int firstTriangleBuffer = vertexChunks & 1;		// 第一块三角形所在的缓冲
+	if (vertexChunks == 0 && triangleChunks > 0) downloadTriangleChunk(0, firstTriangleBuffer);
+	for (unsigned int chunk = 0; chunk < triangleChunks; chunk++) {
+		const int buffer = (chunk + firstTriangleBuffer) & 1;
+		if (chunk + 1 < triangleChunks) downloadTriangleChunk(chunk + 1, buffer ^ 1);
+		CHECKCUDA(cudaEventSynchronize(chunkReady[buffer]));
+
+		const size_t count = std::min((size_t)MESH_EXPORTER_CHUNK_ELEMENTS, snapshotTriangles.ArraySize() - (size_t)chunk * MESH_EXPORTER_CHUNK_ELEMENTS);
+		const TriangleIndex* triangles = stagingTriangles[buffer];
+		record.clear();
+		for (size_t i = 0; i < count; i++) {
+			if (binary) {
+				appendLittleEndian(record, (unsigned char)3);
+				for (int k = 0; k < 3; k++) appendLittleEndian(record, triangles[i].idx[k]);
+			}
+			else {
+				// OBJ的索引从1开始，有法线时顶点与法线同序
+				const int a = triangles[i].idx[0] + 1, b = triangles[i].idx[1] + 1, c = triangles[i].idx[2] + 1;
+				const int length = hasNormals ? snprintf(text, sizeof(text), "f %d//%d %d//%d %d//%d\n", a, a, b, b, c, c) : snprintf(text, sizeof(text), "f %d %d %d\n", a, b, c);
+				record.insert(record.end(), text, text + length);
+			}
+		}
+		fwrite(record.data(), 1, record.size(), file);
+	}
+
+	const bool success = ferror(file) == 0;
+	fclose(file);
+	return success;
+}
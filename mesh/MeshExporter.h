@@ -0,0 +1,132 @@
+/*****************************************************************//**
+ * \file   MeshExporter.h
+ * \brief  网格导出：显存快照 + 页锁定内存分块异步下载，与写文件重叠，在线程池中输出二进制PLY或OBJ
+ *
+ * \author LUOJIAXUAN
+ * \date   June 12th 2024
+ *********************************************************************/
+#pragma once
+#include <string>
+#include <memory>
+#include <future>
+#include <cstdio>
+#include <vector>
+#include <cuda_runtime_api.h>
+#include <base/Logging.h>
+#include <base/ThreadPool.h>
+#include <base/DeviceAPI/safe_call.hpp>
+#include <base/DeviceReadWrite/DeviceBufferArray.h>
+#include "Geometry.h"
+
+#define MESH_EXPORTER_CHUNK_ELEMENTS (1 << 16)		// 每次下载的顶点(或三角形)数量
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 网格文件格式.
+	 */
+	enum class MeshFileFormat {
+		BinaryPLY,		// 二进制小端PLY
+		OBJ				// 文本OBJ
+	};
+
+	/**
+	 * \brief 导出的网格，法线、颜色为空时不写入对应属性.
+	 */
+	struct MeshExportInput {
+		DeviceArrayView<Point3D<float>> vertices;		// 网格顶点
+		DeviceArrayView<TriangleIndex> triangles;		// 三角形索引
+		DeviceArrayView<Point3D<float>> normals;		// 顶点法线(可为空)
+		DeviceArrayView<Point3D<float>> colors;			// 顶点颜色[0, 1](可为空)
+		Point3D<float> center;							// 写出的坐标 = 顶点 * scale + center
+		float scale = 1.0f;								// 顶点缩放
+	};
+
+	/**
+	 * \brief 网格导出器：调用线程只在给定流上把网格拷贝到导出器的显存快照中，之后的重建可以立即覆盖原网格；
+	 *        导出在线程池中进行，快照在专用流上分块下载到两组页锁定缓冲，写第i块时第i+1块正在下载.
+	 *        同一时刻只进行一次导出，上一次尚未完成时ExportAsync等待其结束.
+	 */
+	class MeshExporter
+	{
+	public:
+		using Ptr = std::shared_ptr<MeshExporter>;
+
+		/**
+		 * \brief 构造导出器.
+		 *
+		 * \param deviceId 网格所在的设备
+		 * \param threadPool 执行导出的线程池，为空则创建一个单线程的线程池
+		 */
+		MeshExporter(const int deviceId = 0, std::shared_ptr<ThreadPool> threadPool = nullptr);
+
+		~MeshExporter();
+
+		/**
+		 * \brief 异步导出网格.
+		 *
+		 * \param path 文件路径
+		 * \param mesh 需要导出的网格(显存)
+		 * \param format 文件格式
+		 * \param stream 网格所在的流，快照拷贝在此流上排队，不同步Host
+		 * \return 导出完成后为true，文件无法写入为false
+		 */
+		std::shared_future<bool> ExportAsync(const std::string& path, const MeshExportInput& mesh, const MeshFileFormat format = MeshFileFormat::BinaryPLY, cudaStream_t stream = 0);
+
+		/**
+		 * \brief 阻塞直到当前的导出完成.
+		 *
+		 * \return 最近一次导出是否成功，没有导出时返回true
+		 */
+		bool Wait();
+
+	private:
+		int deviceId = 0;									// 网格所在的设备
+		std::shared_ptr<ThreadPool> pool;					// 执行导出的线程池
+		std::shared_future<bool> pending;					// 正在进行的导出
+
+		cudaStream_t downloadStream = NULL;					// 分块下载的流
+		cudaEvent_t snapshotReady = NULL;					// 快照拷贝完成的事件
+		cudaEvent_t chunkReady[2] = { NULL, NULL };			// 两组页锁定缓冲的下载完成事件
+
+		DeviceBufferArray<Point3D<float>> snapshotVertices;	// 顶点快照
+		DeviceBufferArray<TriangleIndex> snapshotTriangles;	// 三角形快照
+		DeviceBufferArray<Point3D<float>> snapshotNormals;	// 法线快照
+		DeviceBufferArray<Point3D<float>> snapshotColors;	// 颜色快照
+
+		Point3D<float>* stagingAttributes[2] = { NULL, NULL };	// 页锁定缓冲：每块的顶点、法线、颜色依次排布
+		TriangleIndex* stagingTriangles[2] = { NULL, NULL };	// 页锁定缓冲：每块的三角形
+		std::vector<char> record;								// 一块网格编码后的文件内容
+
+		/**
+		 * \brief 保证快照显存能容纳count个元素.
+		 */
+		template<typename T>
+		static void reserveSnapshot(DeviceBufferArray<T>& buffer, const size_t count) {
+			if (count > buffer.Capacity()) {
+				buffer.ReleaseBuffer();
+				buffer.AllocateBuffer(count);
+			}
+			buffer.ResizeArrayOrException(count);
+		}
+
+		/**
+		 * \brief 在线程池中执行的导出：分块下载快照并写入文件.
+		 */
+		bool exportSnapshot(const std::string path, const MeshFileFormat format, const bool hasNormals, const bool hasColors, const Point3D<float> center, const float scale);
+
+		/**
+		 * \brief 在downloadStream上把第chunk块顶点属性下载到页锁定缓冲buffer.
+		 */
+		void downloadVertexChunk(const unsigned int chunk, const int buffer, const bool hasNormals, const bool hasColors);
+
+		/**
+		 * \brief 在downloadStream上把第chunk块三角形下载到页锁定缓冲buffer.
+		 */
+		void downloadTriangleChunk(const unsigned int chunk, const int buffer);
+
+		/**
+		 * \brief 写出文件头.
+		 */
+		void writeHeader(FILE* file, const MeshFileFormat format, const bool hasNormals, const bool hasColors) const;
+	};
+}
@@ -0,0 +1,28 @@
+/*****************************************************************//**
+ * \file   MeshOutputSink.h
+ * \brief  网格输出槽：等值面提取直接把压缩后的顶点与三角形写入调用方提供的显存(如映射的VBO/IBO)
+ *
+ * \author LUOJIAXUAN
+ * \date   June 11th 2024
+ *********************************************************************/
+#pragma once
+#include "Geometry.h"
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 调用方提供的网格输出显存，三角形索引指向vertices中的位置.
+	 *        设置后ComputeTriangleIndices不再写入自己的MeshTriangleVertex/MeshTriangleIndex，
+	 *        显存在下一次设置或重置前必须保持有效(映射的OpenGL缓冲在此期间不能解除映射).
+	 */
+	struct MeshOutputSink {
+		Point3D<float>* vertices = NULL;		// 网格顶点
+		unsigned int vertexCapacity = 0;		// vertices可容纳的顶点数量
+		TriangleIndex* triangles = NULL;		// 网格三角形索引
+		unsigned int triangleCapacity = 0;		// triangles可容纳的三角形数量
+
+		/**
+		 * \brief 是否指定了输出显存.
+		 */
+		bool IsValid() const { return vertices != NULL && triangles != NULL; }
+	};
+}
@@ -0,0 +1,65 @@
+/*****************************************************************//**
+ * \file   MeshSimplification.cpp
+ * \brief  GPU网格简化方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 13th 2024
+ *********************************************************************/
+#include "MeshSimplification.h"
+#include <cmath>
+
+SparseSurfelFusion::MeshSimplification::~MeshSimplification()
+{
+	ClusterKey.ReleaseBuffer();
+	SortedClusterKey.ReleaseBuffer();
+	VertexId.ReleaseBuffer();
+	SortedVertexId.ReleaseBuffer();
+	ClusterHead.ReleaseBuffer();
+	ClusterAddress.ReleaseBuffer();
+	VertexCluster.ReleaseBuffer();
+	ClusterSum.ReleaseBuffer();
+	Quadrics.ReleaseBuffer();
+	ClusterVertices.ReleaseBuffer();
+	ClusteredTriangles.ReleaseBuffer();
+	TriangleKey.ReleaseBuffer();
+	SortedTriangleKey.ReleaseBuffer();
+	TriangleId.ReleaseBuffer();
+	SortedTriangleId.ReleaseBuffer();
+	KeepTriangle.ReleaseBuffer();
+	SelectedTriangles.ReleaseBuffer();
+	ClusterReferenced.ReleaseBuffer();
+	ReferencedAddress.ReleaseBuffer();
+	SelectedCount.ReleaseBuffer();
+	TempStorage.ReleaseBuffer();
+}
+
+void SparseSurfelFusion::MeshSimplification::Simplify(Point3D<float>* vertices, unsigned int& vertexCount, TriangleIndex* triangles, unsigned int& triangleCount, cudaStream_t stream)
+{
+	if (!options.IsEnabled() || vertexCount == 0 || triangleCount == 0) return;
+	const unsigned int target = options.targetTriangleCount;
+	if (target > 0 && triangleCount <= target) return;
+
+	// 聚类网格对角线不超过maxError时，代表点(限制在网格内)的偏移不超过maxError
+	const int maxResolution = (1 << SIMPLIFY_CLUSTER_AXIS_BITS) - 1;
+	int minResolution = 2;
+	if (options.maxError > 0.0f) {
+		const double errorResolution = std::ceil(std::sqrt(3.0) / options.maxError);
+		minResolution = (int)std::min<double>(std::max<double>(errorResolution, minResolution), maxResolution);
+	}
+
+	// Marching Cubes网格的三角形数量约与网格分辨率的平方成正比，以maxDepth网格为基准估计初始分辨率
+	int resolution = minResolution;
+	if (target > 0) {
+		const double estimate = (1 << Constants::maxDepth_Host) * std::sqrt((double)target / triangleCount);
+		resolution = (int)std::min<double>(std::max<double>(estimate, minResolution), maxResolution);
+	}
+
+	unsigned int clusterCount = 0;
+	unsigned int simplifiedCount = clusterMesh(vertices, vertexCount, triangles, triangleCount, resolution, clusterCount, stream);
+	for (int iteration = 1; target > 0 && simplifiedCount > target && resolution > minResolution && iteration < options.maxIterations; iteration++) {
+		const int next = (int)(resolution * std::sqrt((double)target / simplifiedCount) * 0.95);
+		resolution = std::max(minResolution, std::min(next, resolution - 1));
+		simplifiedCount = clusterMesh(vertices, vertexCount, triangles, triangleCount, resolution, clusterCount, stream);
+	}
+	writeBackMesh(clusterCount, simplifiedCount, vertices, vertexCount, triangles, triangleCount, stream);
+}
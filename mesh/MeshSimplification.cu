@@ -0,0 +1,270 @@
+/*****************************************************************//**
+ * \file   MeshSimplification.cu
+ * \brief  GPU网格简化cuda方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 13th 2024
+ *********************************************************************/
+#include "MeshSimplification.h"
+#if defined(__CUDACC__)		// 如果由NVCC编译器编译
+#include <cub/cub.cuh>
+#endif
+#include <thrust/device_ptr.h>
+#include <thrust/sequence.h>
+#include <algorithm>
+
+__global__ void SparseSurfelFusion::device::computeClusterKeyKernel(const Point3D<float>* vertices, const unsigned int vertexCount, const int resolution, const int axisBits, unsigned long long* clusterKey)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= vertexCount) return;
+	unsigned long long key = 0;
+#pragma unroll
+	for (int k = 0; k < 3; k++) {
+		int cell = int(vertices[idx].coords[k] * resolution);
+		cell = min(max(cell, 0), resolution - 1);
+		key |= ((unsigned long long)cell) << (k * axisBits);
+	}
+	clusterKey[idx] = key;
+}
+
+__global__ void SparseSurfelFusion::device::markClusterHeadKernel(const unsigned long long* sortedKey, const unsigned int vertexCount, int* isHead)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= vertexCount) return;
+	isHead[idx] = (idx == 0 || sortedKey[idx] != sortedKey[idx - 1]) ? 1 : 0;
+}
+
+__global__ void SparseSurfelFusion::device::assignVertexClusterKernel(const int* sortedVertexId, const int* clusterAddress, const Point3D<float>* vertices, const unsigned int vertexCount, int* vertexCluster, float4* clusterSum)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= vertexCount) return;
+	const int vertexId = sortedVertexId[idx];
+	const int cluster = clusterAddress[idx] - 1;
+	vertexCluster[vertexId] = cluster;
+	const Point3D<float> vertex = vertices[vertexId];
+	atomicAdd(&clusterSum[cluster].x, vertex.coords[0]);
+	atomicAdd(&clusterSum[cluster].y, vertex.coords[1]);
+	atomicAdd(&clusterSum[cluster].z, vertex.coords[2]);
+	atomicAdd(&clusterSum[cluster].w, 1.0f);
+}
+
+__global__ void SparseSurfelFusion::device::accumulateClusterQuadricKernel(const Point3D<float>* vertices, const TriangleIndex* triangles, const unsigned int triangleCount, const int* vertexCluster, ClusterQuadric* quadrics)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= triangleCount) return;
+	const TriangleIndex triangle = triangles[idx];
+	const Point3D<float> p0 = vertices[triangle.idx[0]];
+	const Point3D<float> p1 = vertices[triangle.idx[1]];
+	const Point3D<float> p2 = vertices[triangle.idx[2]];
+	const float3 e1 = make_float3(p1.coords[0] - p0.coords[0], p1.coords[1] - p0.coords[1], p1.coords[2] - p0.coords[2]);
+	const float3 e2 = make_float3(p2.coords[0] - p0.coords[0], p2.coords[1] - p0.coords[1], p2.coords[2] - p0.coords[2]);
+	float3 normal = make_float3(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+	const float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	if (length < 1e-20f) return;	// 退化三角形没有平面
+	const float invLength = 1.0f / length;
+	normal = make_float3(normal.x * invLength, normal.y * invLength, normal.z * invLength);
+	const float d = -(normal.x * p0.coords[0] + normal.y * p0.coords[1] + normal.z * p0.coords[2]);
+	const float weight = 0.5f * length;		// 按面积加权
+	const float a[6] = { weight * normal.x * normal.x, weight * normal.x * normal.y, weight * normal.x * normal.z, weight * normal.y * normal.y, weight * normal.y * normal.z, weight * normal.z * normal.z };
+	const float b[3] = { weight * d * normal.x, weight * d * normal.y, weight * d * normal.z };
+#pragma unroll
+	for (int v = 0; v < 3; v++) {
+		ClusterQuadric& quadric = quadrics[vertexCluster[triangle.idx[v]]];
+#pragma unroll
+		for (int k = 0; k < 6; k++) atomicAdd(&quadric.a[k], a[k]);
+#pragma unroll
+		for (int k = 0; k < 3; k++) atomicAdd(&quadric.b[k], b[k]);
+	}
+}
+
+__global__ void SparseSurfelFusion::device::solveClusterVertexKernel(const ClusterQuadric* quadrics, const float4* clusterSum, const unsigned long long* sortedKey, const int* clusterAddress, const int* isHead, const unsigned int vertexCount, const int axisBits, const float cellSize, Point3D<float>* clusterVertices)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= vertexCount || !isHead[idx]) return;
+	const int cluster = clusterAddress[idx] - 1;
+	const float4 sum = clusterSum[cluster];
+	const float mean[3] = { sum.x / sum.w, sum.y / sum.w, sum.z / sum.w };
+	const ClusterQuadric quadric = quadrics[cluster];
+
+	// (A + λI)x = λ·mean - b：λ取A迹的千分之一，平坦方向上(如平面、直边)解被拉向顶点均值
+	const float trace = quadric.a[0] + quadric.a[3] + quadric.a[5];
+	float position[3] = { mean[0], mean[1], mean[2] };
+	if (trace > 0.0f) {
+		const float lambda = 1e-3f * trace;
+		const float m00 = quadric.a[0] + lambda, m01 = quadric.a[1], m02 = quadric.a[2];
+		const float m11 = quadric.a[3] + lambda, m12 = quadric.a[4], m22 = quadric.a[5] + lambda;
+		const float r[3] = { lambda * mean[0] - quadric.b[0], lambda * mean[1] - quadric.b[1], lambda * mean[2] - quadric.b[2] };
+		const float c00 = m11 * m22 - m12 * m12, c01 = m02 * m12 - m01 * m22, c02 = m01 * m12 - m02 * m11;
+		const float det = m00 * c00 + m01 * c01 + m02 * c02;
+		if (fabsf(det) > 1e-30f) {
+			const float c11 = m00 * m22 - m02 * m02, c12 = m01 * m02 - m00 * m12, c22 = m00 * m11 - m01 * m01;
+			const float invDet = 1.0f / det;
+			position[0] = (c00 * r[0] + c01 * r[1] + c02 * r[2]) * invDet;
+			position[1] = (c01 * r[0] + c11 * r[1] + c12 * r[2]) * invDet;
+			position[2] = (c02 * r[0] + c12 * r[1] + c22 * r[2]) * invDet;
+		}
+	}
+	// 代表点限制在聚类网格内，保证顶点偏移不超过网格对角线
+	const unsigned long long key = sortedKey[idx];
+	const unsigned long long axisMask = (1ull << axisBits) - 1;
+	Point3D<float> vertex;
+#pragma unroll
+	for (int k = 0; k < 3; k++) {
+		const float cellMin = ((key >> (k * axisBits)) & axisMask) * cellSize;
+		vertex.coords[k] = fminf(fmaxf(position[k], cellMin), cellMin + cellSize);
+	}
+	clusterVertices[cluster] = vertex;
+}
+
+__global__ void SparseSurfelFusion::device::remapClusterTrianglesKernel(const TriangleIndex* triangles, const unsigned int triangleCount, const int* vertexCluster, const bool removeDuplicates, TriangleIndex* clusteredTriangles, unsigned long long* triangleKey)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= triangleCount) return;
+	const TriangleIndex triangle = triangles[idx];
+	TriangleIndex clustered;
+	clustered.idx[0] = vertexCluster[triangle.idx[0]];
+	clustered.idx[1] = vertexCluster[triangle.idx[1]];
+	clustered.idx[2] = vertexCluster[triangle.idx[2]];
+	clusteredTriangles[idx] = clustered;
+	const int a = clustered.idx[0], b = clustered.idx[1], c = clustered.idx[2];
+	if (a == b || b == c || a == c) {
+		triangleKey[idx] = SIMPLIFY_INVALID_TRIANGLE_KEY;
+		return;
+	}
+	if (!removeDuplicates) {
+		triangleKey[idx] = idx;
+		return;
+	}
+	// 三个index升序拼接，正反朝向相同的三角形编码相同
+	const unsigned long long low = min(a, min(b, c)), high = max(a, max(b, c));
+	const unsigned long long middle = (unsigned long long)(a + b + c) - low - high;
+	triangleKey[idx] = low | (middle << SIMPLIFY_CLUSTER_AXIS_BITS) | (high << (2 * SIMPLIFY_CLUSTER_AXIS_BITS));
+}
+
+__global__ void SparseSurfelFusion::device::markUniqueTriangleKernel(const unsigned long long* sortedKey, const int* sortedTriangleId, const TriangleIndex* clusteredTriangles, const unsigned int triangleCount, int* keepTriangle, int* clusterReferenced)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= triangleCount) return;
+	const unsigned long long key = sortedKey[idx];
+	const int triangleId = sortedTriangleId[idx];
+	const bool keep = key != SIMPLIFY_INVALID_TRIANGLE_KEY && (idx == 0 || key != sortedKey[idx - 1]);
+	keepTriangle[triangleId] = keep ? 1 : 0;
+	if (keep) {
+		const TriangleIndex triangle = clusteredTriangles[triangleId];
+		clusterReferenced[triangle.idx[0]] = 1;		// 多个线程写入相同的值，无需原子操作
+		clusterReferenced[triangle.idx[1]] = 1;
+		clusterReferenced[triangle.idx[2]] = 1;
+	}
+}
+
+__global__ void SparseSurfelFusion::device::compactClusterVerticesKernel(const Point3D<float>* clusterVertices, const int* clusterReferenced, const int* referencedAddress, const unsigned int clusterCount, Point3D<float>* vertices)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= clusterCount || !clusterReferenced[idx]) return;
+	vertices[referencedAddress[idx] - 1] = clusterVertices[idx];
+}
+
+__global__ void SparseSurfelFusion::device::remapCompactedTrianglesKernel(const int* referencedAddress, const unsigned int triangleCount, TriangleIndex* triangles)
+{
+	const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+	if (idx >= triangleCount) return;
+	TriangleIndex triangle = triangles[idx];
+	triangle.idx[0] = referencedAddress[triangle.idx[0]] - 1;
+	triangle.idx[1] = referencedAddress[triangle.idx[1]] - 1;
+	triangle.idx[2] = referencedAddress[triangle.idx[2]] - 1;
+	triangles[idx] = triangle;
+}
+
+unsigned int SparseSurfelFusion::MeshSimplification::clusterMesh(const Point3D<float>* vertices, const unsigned int vertexCount, const TriangleIndex* triangles, const unsigned int triangleCount, const int resolution, unsigned int& clusterCount, cudaStream_t stream)
+{
+	int axisBits = 1;
+	while ((1 << axisBits) < resolution) axisBits++;
+	const float cellSize = 1.0f / resolution;
+
+	unsigned long long* clusterKey = reserveBuffer(ClusterKey, vertexCount);
+	unsigned long long* sortedClusterKey = reserveBuffer(SortedClusterKey, vertexCount);
+	int* vertexId = reserveBuffer(VertexId, vertexCount);
+	int* sortedVertexId = reserveBuffer(SortedVertexId, vertexCount);
+	int* clusterHead = reserveBuffer(ClusterHead, vertexCount);
+	int* clusterAddress = reserveBuffer(ClusterAddress, vertexCount);
+	int* vertexCluster = reserveBuffer(VertexCluster, vertexCount);
+	TriangleIndex* clusteredTriangles = reserveBuffer(ClusteredTriangles, triangleCount);
+	unsigned long long* triangleKey = reserveBuffer(TriangleKey, triangleCount);
+	unsigned long long* sortedTriangleKey = reserveBuffer(SortedTriangleKey, triangleCount);
+	int* triangleId = reserveBuffer(TriangleId, triangleCount);
+	int* sortedTriangleId = reserveBuffer(SortedTriangleId, triangleCount);
+	int* keepTriangle = reserveBuffer(KeepTriangle, triangleCount);
+	TriangleIndex* selectedTriangles = reserveBuffer(SelectedTriangles, triangleCount);
+	int* selectedCount = reserveBuffer(SelectedCount, 1);
+
+	size_t vertexSortBytes = 0, scanBytes = 0, triangleSortBytes = 0, selectBytes = 0;
+	CHECKCUDA(cub::DeviceRadixSort::SortPairs(NULL, vertexSortBytes, clusterKey, sortedClusterKey, vertexId, sortedVertexId, vertexCount, 0, 3 * axisBits, stream));
+	CHECKCUDA(cub::DeviceScan::InclusiveSum(NULL, scanBytes, clusterHead, clusterAddress, vertexCount, stream));
+	CHECKCUDA(cub::DeviceRadixSort::SortPairs(NULL, triangleSortBytes, triangleKey, sortedTriangleKey, triangleId, sortedTriangleId, triangleCount, 0, 63, stream));
+	CHECKCUDA(cub::DeviceSelect::Flagged(NULL, selectBytes, clusteredTriangles, keepTriangle, selectedTriangles, selectedCount, triangleCount, stream, false));
+	void* tempStorage = reserveBuffer(TempStorage, std::max(std::max(vertexSortBytes, scanBytes), std::max(triangleSortBytes, selectBytes)));
+
+	/**************************** 顶点按聚类编码排序，相同编码的顶点属于同一聚类 ****************************/
+	dim3 block(128);
+	dim3 grid(divUp(vertexCount, block.x));
+	device::computeClusterKeyKernel << <grid, block, 0, stream >> > (vertices, vertexCount, resolution, axisBits, clusterKey);
+	thrust::device_ptr<int> vertexIdPtr = thrust::device_pointer_cast<int>(vertexId);
+	thrust::sequence(thrust::cuda::par.on(stream), vertexIdPtr, vertexIdPtr + vertexCount);
+	CHECKCUDA(cub::DeviceRadixSort::SortPairs(tempStorage, vertexSortBytes, clusterKey, sortedClusterKey, vertexId, sortedVertexId, vertexCount, 0, 3 * axisBits, stream));
+	device::markClusterHeadKernel << <grid, block, 0, stream >> > (sortedClusterKey, vertexCount, clusterHead);
+	CHECKCUDA(cub::DeviceScan::InclusiveSum(tempStorage, scanBytes, clusterHead, clusterAddress, vertexCount, stream));
+	int clusterCountDevice = 0;
+	CHECKCUDA(cudaMemcpyAsync(&clusterCountDevice, clusterAddress + vertexCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
+	CHECKCUDA(cudaStreamSynchronize(stream));
+	clusterCount = clusterCountDevice;
+
+	/**************************** 累加每个聚类的顶点均值与二次误差，求代表点 ****************************/
+	float4* clusterSum = reserveBuffer(ClusterSum, clusterCount);
+	ClusterQuadric* quadrics = reserveBuffer(Quadrics, clusterCount);
+	Point3D<float>* clusterVertices = reserveBuffer(ClusterVertices, clusterCount);
+	int* clusterReferenced = reserveBuffer(ClusterReferenced, clusterCount);
+	CHECKCUDA(cudaMemsetAsync(clusterSum, 0, sizeof(float4) * clusterCount, stream));
+	CHECKCUDA(cudaMemsetAsync(quadrics, 0, sizeof(ClusterQuadric) * clusterCount, stream));
+	CHECKCUDA(cudaMemsetAsync(clusterReferenced, 0, sizeof(int) * clusterCount, stream));
+	device::assignVertexClusterKernel << <grid, block, 0, stream >> > (sortedVertexId, clusterAddress, vertices, vertexCount, vertexCluster, clusterSum);
+	dim3 grid_tri(divUp(triangleCount, block.x));
+	device::accumulateClusterQuadricKernel << <grid_tri, block, 0, stream >> > (vertices, triangles, triangleCount, vertexCluster, quadrics);
+	device::solveClusterVertexKernel << <grid, block, 0, stream >> > (quadrics, clusterSum, sortedClusterKey, clusterAddress, clusterHead, vertexCount, axisBits, cellSize, clusterVertices);
+
+	/**************************** 三角形重映射，删除退化与重复的三角形 ****************************/
+	const bool removeDuplicates = clusterCount < (1u << SIMPLIFY_CLUSTER_AXIS_BITS);
+	device::remapClusterTrianglesKernel << <grid_tri, block, 0, stream >> > (triangles, triangleCount, vertexCluster, removeDuplicates, clusteredTriangles, triangleKey);
+	thrust::device_ptr<int> triangleIdPtr = thrust::device_pointer_cast<int>(triangleId);
+	thrust::sequence(thrust::cuda::par.on(stream), triangleIdPtr, triangleIdPtr + triangleCount);
+	CHECKCUDA(cub::DeviceRadixSort::SortPairs(tempStorage, triangleSortBytes, triangleKey, sortedTriangleKey, triangleId, sortedTriangleId, triangleCount, 0, 63, stream));
+	device::markUniqueTriangleKernel << <grid_tri, block, 0, stream >> > (sortedTriangleKey, sortedTriangleId, clusteredTriangles, triangleCount, keepTriangle, clusterReferenced);
+	// 按原三角形顺序筛选，保持三角形的空间局部性
+	CHECKCUDA(cub::DeviceSelect::Flagged(tempStorage, selectBytes, clusteredTriangles, keepTriangle, selectedTriangles, selectedCount, triangleCount, stream, false));
+	int selectedCountHost = 0;
+	CHECKCUDA(cudaMemcpyAsync(&selectedCountHost, selectedCount, sizeof(int), cudaMemcpyDeviceToHost, stream));
+	CHECKCUDA(cudaStreamSynchronize(stream));
+	return selectedCountHost;
+}
+
+void SparseSurfelFusion::MeshSimplification::writeBackMesh(const unsigned int clusterCount, const unsigned int selectedCount, Point3D<float>* vertices, unsigned int& simplifiedVertexCount, TriangleIndex* triangles, unsigned int& simplifiedTriangleCount, cudaStream_t stream)
+{
+	int* referencedAddress = reserveBuffer(ReferencedAddress, clusterCount);
+	size_t scanBytes = 0;
+	CHECKCUDA(cub::DeviceScan::InclusiveSum(NULL, scanBytes, ClusterReferenced.Ptr(), referencedAddress, clusterCount, stream));
+	void* tempStorage = reserveBuffer(TempStorage, scanBytes);
+	CHECKCUDA(cub::DeviceScan::InclusiveSum(tempStorage, scanBytes, ClusterReferenced.Ptr(), referencedAddress, clusterCount, stream));
+
+	dim3 block(128);
+	dim3 grid(divUp(clusterCount, block.x));
+	device::compactClusterVerticesKernel << <grid, block, 0, stream >> > (ClusterVertices.Ptr(), ClusterReferenced.Ptr(), referencedAddress, clusterCount, vertices);
+	if (selectedCount > 0) {
+		dim3 grid_tri(divUp(selectedCount, block.x));
+		device::remapCompactedTrianglesKernel << <grid_tri, block, 0, stream >> > (referencedAddress, selectedCount, SelectedTriangles.Ptr());
+		CHECKCUDA(cudaMemcpyAsync(triangles, SelectedTriangles.Ptr(), sizeof(TriangleIndex) * selectedCount, cudaMemcpyDeviceToDevice, stream));
+	}
+	int referencedCount = 0;
+	CHECKCUDA(cudaMemcpyAsync(&referencedCount, referencedAddress + clusterCount - 1, sizeof(int), cudaMemcpyDeviceToHost, stream));
+	CHECKCUDA(cudaStreamSynchronize(stream));
+	simplifiedVertexCount = referencedCount;
+	simplifiedTriangleCount = selectedCount;
+}
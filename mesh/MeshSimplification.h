@@ -0,0 +1,251 @@
+/*****************************************************************//**
+ * \file   MeshSimplification.h
+ * \brief  GPU网格简化：均匀网格顶点聚类 + 二次误差(QEM)求每簇代表点，原地写回重建网格
+ *
+ * \author LUOJIAXUAN
+ * \date   June 13th 2024
+ *********************************************************************/
+#pragma once
+#include <memory>
+#include <cuda_runtime_api.h>
+#include <device_launch_parameters.h>
+#include <base/Constants.h>
+#include <base/DeviceReadWrite/DeviceBufferArray.h>
+#include "Geometry.h"
+
+#define SIMPLIFY_CLUSTER_AXIS_BITS 21		// 聚类网格每个维度的最大编码位数，也是三角形去重编码中每个聚类index的位数
+#define SIMPLIFY_INVALID_TRIANGLE_KEY 0x7FFFFFFFFFFFFFFFull	// 退化三角形的去重编码，排在最后
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 网格简化参数，targetTriangleCount与maxError均为0时不简化.
+	 */
+	struct MeshSimplificationOptions {
+		unsigned int targetTriangleCount = 0;	// 目标三角形数量(上限)，0表示不限制
+		float maxError = 0.0f;					// 顶点最大偏移(归一化坐标，原坐标中再乘以NormalizeMaxEdge)，0表示不限制；与目标数量同时设置时误差优先
+		int maxIterations = 4;					// 按目标数量调整聚类分辨率的最大次数
+
+		/**
+		 * \brief 是否需要简化.
+		 */
+		bool IsEnabled() const { return targetTriangleCount > 0 || maxError > 0.0f; }
+	};
+
+	/**
+	 * \brief 一个聚类的二次误差矩阵：Q(x) = x^T A x + 2 b^T x + c，c不参与求解故不存储.
+	 */
+	struct ClusterQuadric {
+		float a[6];		// 对称矩阵A的上三角(xx, xy, xz, yy, yz, zz)
+		float b[3];		// 向量b
+	};
+
+	namespace device {
+		/**
+		 * \brief 计算网格顶点所在聚类网格的编码.
+		 *
+		 * \param vertices 网格顶点(归一化坐标[0, 1])
+		 * \param vertexCount 顶点数量
+		 * \param resolution 每个维度的聚类网格数量
+		 * \param axisBits 编码中每个维度的位数
+		 * \param clusterKey 【输出】聚类编码
+		 */
+		__global__ void computeClusterKeyKernel(const Point3D<float>* vertices, const unsigned int vertexCount, const int resolution, const int axisBits, unsigned long long* clusterKey);
+
+		/**
+		 * \brief 标记排序后每个聚类的第一个顶点.
+		 *
+		 * \param sortedKey 升序排列的聚类编码
+		 * \param vertexCount 顶点数量
+		 * \param isHead 【输出】是否为聚类的第一个顶点
+		 */
+		__global__ void markClusterHeadKernel(const unsigned long long* sortedKey, const unsigned int vertexCount, int* isHead);
+
+		/**
+		 * \brief 记录每个顶点所属的聚类，并累加聚类内顶点坐标.
+		 *
+		 * \param sortedVertexId 排序后的顶点index
+		 * \param clusterAddress isHead的包含前缀和
+		 * \param vertices 网格顶点
+		 * \param vertexCount 顶点数量
+		 * \param vertexCluster 【输出】原顶点对应的聚类index
+		 * \param clusterSum 【输出】聚类内顶点坐标之和(w为顶点数量)
+		 */
+		__global__ void assignVertexClusterKernel(const int* sortedVertexId, const int* clusterAddress, const Point3D<float>* vertices, const unsigned int vertexCount, int* vertexCluster, float4* clusterSum);
+
+		/**
+		 * \brief 每个三角形的平面二次误差按面积加权累加到三个顶点所属的聚类.
+		 *
+		 * \param vertices 网格顶点
+		 * \param triangles 三角形
+		 * \param triangleCount 三角形数量
+		 * \param vertexCluster 顶点对应的聚类index
+		 * \param quadrics 【输出】聚类的二次误差矩阵
+		 */
+		__global__ void accumulateClusterQuadricKernel(const Point3D<float>* vertices, const TriangleIndex* triangles, const unsigned int triangleCount, const int* vertexCluster, ClusterQuadric* quadrics);
+
+		/**
+		 * \brief 求每个聚类的代表点：最小化二次误差并限制在聚类网格内，矩阵病态时取顶点均值.
+		 *
+		 * \param quadrics 聚类的二次误差矩阵
+		 * \param clusterSum 聚类内顶点坐标之和
+		 * \param sortedKey 升序排列的聚类编码
+		 * \param clusterAddress isHead的包含前缀和
+		 * \param isHead 是否为聚类的第一个顶点
+		 * \param vertexCount 顶点数量
+		 * \param axisBits 编码中每个维度的位数
+		 * \param cellSize 聚类网格边长
+		 * \param clusterVertices 【输出】聚类代表点
+		 */
+		__global__ void solveClusterVertexKernel(const ClusterQuadric* quadrics, const float4* clusterSum, const unsigned long long* sortedKey, const int* clusterAddress, const int* isHead, const unsigned int vertexCount, const int axisBits, const float cellSize, Point3D<float>* clusterVertices);
+
+		/**
+		 * \brief 三角形索引重映射到聚类，计算去重编码(三个聚类index升序拼接)，退化三角形编码为SIMPLIFY_INVALID_TRIANGLE_KEY.
+		 *
+		 * \param triangles 三角形
+		 * \param triangleCount 三角形数量
+		 * \param vertexCluster 顶点对应的聚类index
+		 * \param removeDuplicates 是否去重，聚类数量超过编码位数时不去重，编码为三角形index
+		 * \param clusteredTriangles 【输出】重映射后的三角形
+		 * \param triangleKey 【输出】去重编码
+		 */
+		__global__ void remapClusterTrianglesKernel(const TriangleIndex* triangles, const unsigned int triangleCount, const int* vertexCluster, const bool removeDuplicates, TriangleIndex* clusteredTriangles, unsigned long long* triangleKey);
+
+		/**
+		 * \brief 每组相同编码只保留第一个三角形，并标记保留的三角形引用的聚类.
+		 *
+		 * \param sortedKey 升序排列的去重编码
+		 * \param sortedTriangleId 排序后的三角形index
+		 * \param clusteredTriangles 重映射后的三角形
+		 * \param triangleCount 三角形数量
+		 * \param keepTriangle 【输出】是否保留(按原三角形index)
+		 * \param clusterReferenced 【输出】聚类是否被保留的三角形引用
+		 */
+		__global__ void markUniqueTriangleKernel(const unsigned long long* sortedKey, const int* sortedTriangleId, const TriangleIndex* clusteredTriangles, const unsigned int triangleCount, int* keepTriangle, int* clusterReferenced);
+
+		/**
+		 * \brief 压缩被引用的聚类代表点写回网格顶点.
+		 *
+		 * \param clusterVertices 聚类代表点
+		 * \param clusterReferenced 聚类是否被引用
+		 * \param referencedAddress clusterReferenced的包含前缀和
+		 * \param clusterCount 聚类数量
+		 * \param vertices 【输出】简化后的网格顶点
+		 */
+		__global__ void compactClusterVerticesKernel(const Point3D<float>* clusterVertices, const int* clusterReferenced, const int* referencedAddress, const unsigned int clusterCount, Point3D<float>* vertices);
+
+		/**
+		 * \brief 三角形索引从聚类index映射到压缩后的顶点index.
+		 *
+		 * \param referencedAddress clusterReferenced的包含前缀和
+		 * \param triangleCount 三角形数量
+		 * \param triangles 【输入输出】三角形
+		 */
+		__global__ void remapCompactedTrianglesKernel(const int* referencedAddress, const unsigned int triangleCount, TriangleIndex* triangles);
+	}
+
+	/**
+	 * \brief GPU网格简化：顶点按均匀网格聚类(Lindstrom, Out-of-Core Simplification)，每簇的代表点最小化簇内三角形平面的二次误差，
+	 *        重映射后删除退化与重复的三角形，结果原地写回输入网格.
+	 *        目标三角形数量通过调整聚类分辨率逼近(每次从原网格重新聚类)，误差上限直接决定聚类网格边长.
+	 */
+	class MeshSimplification
+	{
+	public:
+		using Ptr = std::shared_ptr<MeshSimplification>;
+
+		MeshSimplification() = default;
+
+		~MeshSimplification();
+
+		/**
+		 * \brief 设置简化参数.
+		 */
+		void SetOptions(const MeshSimplificationOptions& simplificationOptions) { options = simplificationOptions; }
+
+		/**
+		 * \brief 获得简化参数.
+		 */
+		const MeshSimplificationOptions& GetOptions() const { return options; }
+
+		/**
+		 * \brief 是否需要简化.
+		 */
+		bool IsEnabled() const { return options.IsEnabled(); }
+
+		/**
+		 * \brief 原地简化网格【阻塞Host：每次聚类后同步聚类与三角形数量】.
+		 *
+		 * \param vertices 【输入输出】网格顶点(归一化坐标[0, 1])
+		 * \param vertexCount 【输入输出】顶点数量
+		 * \param triangles 【输入输出】三角形
+		 * \param triangleCount 【输入输出】三角形数量
+		 * \param stream cuda流
+		 */
+		void Simplify(Point3D<float>* vertices, unsigned int& vertexCount, TriangleIndex* triangles, unsigned int& triangleCount, cudaStream_t stream);
+
+	private:
+		MeshSimplificationOptions options;						// 简化参数
+
+		DeviceBufferArray<unsigned long long> ClusterKey;		// 顶点的聚类编码
+		DeviceBufferArray<unsigned long long> SortedClusterKey;	// 排序后的聚类编码
+		DeviceBufferArray<int> VertexId;						// 排序前的顶点index
+		DeviceBufferArray<int> SortedVertexId;					// 排序后的顶点index
+		DeviceBufferArray<int> ClusterHead;						// 是否为聚类的第一个顶点
+		DeviceBufferArray<int> ClusterAddress;					// ClusterHead的包含前缀和
+		DeviceBufferArray<int> VertexCluster;					// 原顶点对应的聚类index
+		DeviceBufferArray<float4> ClusterSum;					// 聚类内顶点坐标之和
+		DeviceBufferArray<ClusterQuadric> Quadrics;				// 聚类的二次误差矩阵
+		DeviceBufferArray<Point3D<float>> ClusterVertices;		// 聚类代表点
+		DeviceBufferArray<TriangleIndex> ClusteredTriangles;	// 重映射后的三角形
+		DeviceBufferArray<unsigned long long> TriangleKey;		// 三角形去重编码
+		DeviceBufferArray<unsigned long long> SortedTriangleKey;// 排序后的去重编码
+		DeviceBufferArray<int> TriangleId;						// 排序前的三角形index
+		DeviceBufferArray<int> SortedTriangleId;				// 排序后的三角形index
+		DeviceBufferArray<int> KeepTriangle;					// 是否保留三角形
+		DeviceBufferArray<TriangleIndex> SelectedTriangles;		// 保留的三角形
+		DeviceBufferArray<int> ClusterReferenced;				// 聚类是否被保留的三角形引用
+		DeviceBufferArray<int> ReferencedAddress;				// ClusterReferenced的包含前缀和
+		DeviceBufferArray<int> SelectedCount;					// cub筛选的数量
+		DeviceBufferArray<unsigned char> TempStorage;			// cub算法的临时存储
+
+		/**
+		 * \brief 取出能容纳size个元素的缓存，容量不足时按1.5倍重新开辟(不保留旧数据).
+		 */
+		template<typename T>
+		static T* reserveBuffer(DeviceBufferArray<T>& buffer, const size_t size) {
+			if (size > buffer.BufferSize()) {
+				buffer.ReleaseBuffer();
+				buffer.AllocateBuffer(static_cast<size_t>(size * 1.5) + 1);
+			}
+			buffer.ResizeArrayOrException(size);
+			return buffer.Ptr();
+		}
+
+		/**
+		 * \brief 按给定分辨率聚类原网格，结果留在ClusterVertices/SelectedTriangles/ClusterReferenced中.
+		 *
+		 * \param vertices 网格顶点
+		 * \param vertexCount 顶点数量
+		 * \param triangles 三角形
+		 * \param triangleCount 三角形数量
+		 * \param resolution 每个维度的聚类网格数量
+		 * \param clusterCount 【输出】聚类数量
+		 * \param stream cuda流
+		 * \return 简化后的三角形数量
+		 */
+		unsigned int clusterMesh(const Point3D<float>* vertices, const unsigned int vertexCount, const TriangleIndex* triangles, const unsigned int triangleCount, const int resolution, unsigned int& clusterCount, cudaStream_t stream);
+
+		/**
+		 * \brief 把最近一次聚类的结果压缩写回网格.
+		 *
+		 * \param clusterCount 聚类数量
+		 * \param selectedCount 保留的三角形数量
+		 * \param vertices 【输出】网格顶点
+		 * \param simplifiedVertexCount 【输出】顶点数量
+		 * \param triangles 【输出】三角形
+		 * \param simplifiedTriangleCount 【输出】三角形数量
+		 * \param stream cuda流
+		 */
+		void writeBackMesh(const unsigned int clusterCount, const unsigned int selectedCount, Point3D<float>* vertices, unsigned int& simplifiedVertexCount, TriangleIndex* triangles, unsigned int& simplifiedTriangleCount, cudaStream_t stream);
+	};
+}
@@ -0,0 +1,65 @@
+/*****************************************************************//**
+ * \file   MultiDeviceReconstruction.cpp
+ * \brief  多GPU泊松重建：按块在多个设备上并行重建并拼接
+ * 
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#include "MultiDeviceReconstruction.h"
+
+SparseSurfelFusion::MultiDeviceReconstruction::MultiDeviceReconstruction(const ReconstructionConfig& config, std::vector<int> devices)
+{
+	if (devices.empty()) {
+		int deviceCount = 0;
+		CHECKCUDA(cudaGetDeviceCount(&deviceCount));
+		for (int i = 0; i < std::min(deviceCount, MAX_RECONSTRUCTION_DEVICES); i++) devices.push_back(i);
+	}
+	if (devices.empty()) LOGGING(FATAL) << "没有可用的GPU设备";
+	for (const int device : devices) {
+		ReconstructionConfig deviceConfig = config;
+		deviceConfig.deviceId = device;
+		deviceConfig.enableRender = false;
+		reconstructions.push_back(std::make_shared<PoissonReconstruction>(deviceConfig));
+	}
+}
+
+void SparseSurfelFusion::MultiDeviceReconstruction::SolveTiledReconstructionMesh(const std::vector<DepthSurfel>& surfels, std::vector<Point3D<float>>& meshVertices, std::vector<TriangleIndex>& meshTriangles, const float overlapRatio)
+{
+	meshVertices.clear();
+	meshTriangles.clear();
+	if (surfels.empty()) return;
+
+	std::vector<PoissonReconstruction::ReconstructionTile> tiles;
+	reconstructions[0]->PartitionReconstructionTiles(surfels, overlapRatio, tiles);	// 划分只在Host端进行，任一实例均可
+
+	// 块之间相互独立，按面元数量从大到小贪心分配给当前负载最小的设备
+	const int deviceCount = reconstructions.size();
+	std::vector<unsigned int> order(tiles.size());
+	for (unsigned int i = 0; i < tiles.size(); i++) order[i] = i;
+	std::sort(order.begin(), order.end(), [&](const unsigned int a, const unsigned int b) { return tiles[a].indices.size() > tiles[b].indices.size(); });
+	std::vector<std::vector<PoissonReconstruction::ReconstructionTile>> deviceTiles(deviceCount);
+	std::vector<size_t> deviceLoad(deviceCount, 0);
+	for (const unsigned int index : order) {
+		const int device = std::min_element(deviceLoad.begin(), deviceLoad.end()) - deviceLoad.begin();
+		deviceLoad[device] += tiles[index].indices.size();
+		deviceTiles[device].push_back(std::move(tiles[index]));
+	}
+
+	std::vector<std::vector<Point3D<float>>> deviceVertices(deviceCount);
+	std::vector<std::vector<TriangleIndex>> deviceTriangles(deviceCount);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < deviceCount; i++) {
+		workers.emplace_back([&, i]() { reconstructions[i]->SolveReconstructionTiles(surfels, deviceTiles[i], deviceVertices[i], deviceTriangles[i]); });
+	}
+	for (std::thread& worker : workers) worker.join();
+
+	// 各设备的网格按顶点偏移拼接
+	for (int i = 0; i < deviceCount; i++) {
+		const int vertexOffset = meshVertices.size();
+		meshVertices.insert(meshVertices.end(), deviceVertices[i].begin(), deviceVertices[i].end());
+		for (TriangleIndex triangle : deviceTriangles[i]) {
+			for (int j = 0; j < 3; j++) triangle.idx[j] += vertexOffset;
+			meshTriangles.push_back(triangle);
+		}
+	}
+}
@@ -0,0 +1,52 @@
+/*****************************************************************//**
+ * \file   MultiDeviceReconstruction.h
+ * \brief  多GPU泊松重建：按块在多个设备上并行重建并拼接
+ * 
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "PoissonReconstruction.h"
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 多GPU重建，每个设备持有一个无渲染的PoissonReconstruction实例，块按面元数量均衡分配到各设备.
+	 */
+	class MultiDeviceReconstruction
+	{
+	public:
+		using Ptr = std::shared_ptr<MultiDeviceReconstruction>;
+
+		/**
+		 * \brief 在给定设备上分别构造重建实例.
+		 * 
+		 * \param config 每个设备实例的容量配置(deviceId与enableRender会被覆盖)
+		 * \param devices 参与重建的设备号，为空则使用全部可见设备
+		 */
+		MultiDeviceReconstruction(const ReconstructionConfig& config = ReconstructionConfig(), std::vector<int> devices = std::vector<int>());
+
+		~MultiDeviceReconstruction() = default;
+
+		/**
+		 * \brief 分块并在多个设备上并行重建，最后拼接成一个网格.
+		 * 
+		 * \param surfels Host端的全部稠密面元
+		 * \param meshVertices 【输出】拼接后的网格顶点(原始坐标系)
+		 * \param meshTriangles 【输出】拼接后的三角形索引
+		 * \param overlapRatio 块向外扩展的重叠宽度与块核心区域最长边之比
+		 */
+		void SolveTiledReconstructionMesh(const std::vector<DepthSurfel>& surfels, std::vector<Point3D<float>>& meshVertices, std::vector<TriangleIndex>& meshTriangles, const float overlapRatio = 0.1f);
+
+		/**
+		 * \brief 参与重建的设备数量.
+		 */
+		int DeviceCount() const { return reconstructions.size(); }
+
+	private:
+		std::vector<std::shared_ptr<PoissonReconstruction>> reconstructions;	// 每个设备一个重建实例
+	};
+}
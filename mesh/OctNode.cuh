@@ -6,15 +6,32 @@
  * \date   May 2nd 2024
  *********************************************************************/
 #pragma once
+#include <base/GlobalConfigs.h>
 #include "Geometry.h"
 
 namespace SparseSurfelFusion{
+#if MAX_DEPTH_OCTREE > 10
+    using OctKey = long long;               // 节点key：每层3位，超过10层时需要64位
+    #define MAX_OCTKEY_VALUE 0x7fffffffffffffffll
+#else
+    using OctKey = int;                     // 节点key：每层3位，不超过10层时32位即可
+    #define MAX_OCTKEY_VALUE 0x7fffffff
+#endif
+
+#if 3 * (MAX_DEPTH_OCTREE + 1) > 31
+    using EncodedFunctionIndex = long long; // 节点基函数索引编码：每个维度(maxDepth + 1)位
+#else
+    using EncodedFunctionIndex = int;       // 节点基函数索引编码：每个维度(maxDepth + 1)位
+#endif
+
+    static_assert(MAX_SURFEL_COUNT <= OCTREE_INDEX_MASK, "稠密点数量超过了64位排序编码中index的位数");
+
     /**
      * \brief 记录八叉树节点的数据类型，大小 276 Bytes.
      */
     class OctNode {
     public:
-        int key;            // 节点的键key
+        OctKey key;         // 节点的键key
         int pidx;           // 节点在SortedArray中的第一个元素的index
         int pnum;           // 与当前节点key相同的稠密点的数量
         int parent;         // 1个父节点
@@ -38,12 +55,81 @@ namespace SparseSurfelFusion{
         int hasIntersection;
     };
 
+    /**
+     * \brief OctNode中拓扑属性(key、父节点、孩子节点、邻居节点)按访问阶段拆分的SoA视图.
+     *        只读取邻居或父子关系的核函数(Laplace矩阵、隐函数值)通过该视图访问紧凑的拓扑数组，不必将276字节的节点整体拖过L2；
+     *        顶点、边、面等网格属性仍在OctNode数组中，已有代码继续使用OctNode数组.
+     *        压缩拓扑模式下不存储27 * N的邻居数组(neighs为NULL)，邻居由节点key解码出网格坐标、加上偏移后重新编码，
+     *        在同层按key有序的节点中二分查找得到，以每次查询O(log N)次key读取换取SoA副本每个节点108字节的显存；
+     *        OctNode::neighs不受影响，仍随NodeArray分配.
+     */
+    struct OctNodeTopologyView {
+        const OctKey* key = NULL;       // 节点的键key，大小为N
+        const int* parent = NULL;       // 父节点，大小为N
+        const int* children = NULL;     // 孩子节点，大小为8 * N，第i个节点的孩子为children[8 * i + c]
+        const int* neighs = NULL;       // 邻居节点，大小为27 * N，第i个节点的邻居为neighs[27 * i + k]，压缩拓扑模式下为NULL
+        const unsigned int* depth = NULL;               // 节点所在深度，大小为N，仅压缩拓扑模式下用于查找邻居
+        int levelOffset[MAX_DEPTH_OCTREE + 2] = { 0 };  // 第d层节点位于[levelOffset[d], levelOffset[d + 1])，仅压缩拓扑模式下使用
+        unsigned int nodeNum = 0;       // 节点数量N
+
+        __host__ __device__ __forceinline__ unsigned int Size() const { return nodeNum; }
+        __host__ __device__ __forceinline__ bool IsCompressed() const { return neighs == NULL; }
+        __device__ __forceinline__ OctKey Key(const int node) const { return key[node]; }
+        __device__ __forceinline__ int Parent(const int node) const { return parent[node]; }
+        __device__ __forceinline__ int Child(const int node, const int c) const { return children[8 * node + c]; }
+        __device__ __forceinline__ int Neighbor(const int node, const int k) const {
+            if (neighs != NULL) return neighs[27 * node + k];
+            return FindNeighbor(node, k);
+        }
+
+        /**
+         * \brief 由key查找同层邻居：k = (dx + 1) * 9 + (dy + 1) * 3 + (dz + 1)，与OctNode::neighs的排列一致.
+         *
+         * \param node 节点index
+         * \param k 邻居序号[0, 27)
+         * \return 邻居节点index，不存在(越界或未被细分出)时为-1
+         */
+        __device__ __forceinline__ int FindNeighbor(const int node, const int k) const {
+            if (k == 13) return node;
+            const int d = depth[node];
+            const int shift = 3 * (MAX_DEPTH_OCTREE - d);
+            const OctKey levelKey = key[node] >> shift;
+            int x = 0, y = 0, z = 0;
+            for (int level = d - 1; level >= 0; level--) {     // 由高位(浅层)到低位(深层)解码
+                const int sonKey = int(levelKey >> (3 * level)) & 7;
+                x = (x << 1) | (sonKey >> 2);
+                y = (y << 1) | ((sonKey >> 1) & 1);
+                z = (z << 1) | (sonKey & 1);
+            }
+            x += k / 9 - 1;
+            y += (k / 3) % 3 - 1;
+            z += k % 3 - 1;
+            const int width = 1 << d;
+            if (x < 0 || y < 0 || z < 0 || x >= width || y >= width || z >= width) return -1;
+            OctKey neighborKey = 0;
+            for (int level = d - 1; level >= 0; level--) {
+                const OctKey sonKey = OctKey((((x >> level) & 1) << 2) | (((y >> level) & 1) << 1) | ((z >> level) & 1));
+                neighborKey |= sonKey << (3 * level);
+            }
+            neighborKey <<= shift;
+            int left = levelOffset[d], right = levelOffset[d + 1] - 1;
+            while (left <= right) {
+                const int middle = (left + right) >> 1;
+                const OctKey middleKey = key[middle];
+                if (middleKey == neighborKey) return middle;
+                else if (middleKey < neighborKey) left = middle + 1;
+                else right = middle - 1;
+            }
+            return -1;
+        }
+    };
+
     /**
      * \brief OctNode的简化版，去除了face和三角标记相交标记.
      */
     class EasyOctNode {
     public:
-        int key;
+        OctKey key;
         int parent;
         int children[8];
         int neighs[27];
@@ -0,0 +1,602 @@
+/*****************************************************************//**
+ * \file   PointCloudLoader.cpp
+ * \brief  点云文件加载方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#include "PointCloudLoader.h"
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <utility>
+#include <vector_functions.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace SparseSurfelFusion {
+	namespace {
+		// 10的幂次表，parseNumber拼接尾数与指数时使用
+		const double Pow10Table[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		inline bool isBlank(const char c) { return c == ' ' || c == '\t' || c == '\r' || c == ',';  }
+
+		/**
+		 * \brief 从begin开始数非空行，数到limit行(为0时不限)或end为止.
+		 *
+		 * \param lines 【输出】非空行的数量
+		 * \return 最后一个被数到的行之后的位置
+		 */
+		inline const char* countNonBlankLines(const char* begin, const char* end, const size_t limit, size_t& lines) {
+			const char* ptr = begin;
+			lines = 0;
+			while (ptr < end && (limit == 0 || lines < limit)) {
+				const char* lineEnd = static_cast<const char*>(memchr(ptr, '\n', end - ptr));
+				if (lineEnd == NULL) lineEnd = end;
+				const char* p = ptr;
+				while (p < lineEnd && isBlank(*p)) p++;
+				if (p < lineEnd) lines++;
+				ptr = lineEnd < end ? lineEnd + 1 : end;
+			}
+			return ptr;
+		}
+
+		inline std::string lowerExtension(const std::string& path) {
+			const size_t dot = path.find_last_of('.');
+			if (dot == std::string::npos) return std::string();
+			std::string extension = path.substr(dot + 1);
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+			return extension;
+		}
+
+		inline float readBinaryCoordinate(const char* ptr, const bool isDouble) {
+			if (isDouble) {
+				double value;
+				memcpy(&value, ptr, sizeof(double));
+				return float(value);
+			}
+			float value;
+			memcpy(&value, ptr, sizeof(float));
+			return value;
+		}
+
+		inline float3 unpackColor(const unsigned int rgb) {
+			return make_float3(((rgb >> 16) & 0xFF) / 255.0f, ((rgb >> 8) & 0xFF) / 255.0f, (rgb & 0xFF) / 255.0f);
+		}
+	}
+}
+
+SparseSurfelFusion::PointCloudLoader::PointCloudLoader(const unsigned int threadNum, std::shared_ptr<ThreadPool> threadPool) : pool(threadPool)
+{
+	if (pool == nullptr) {
+		pool = threadNum == 0 ? ThreadPool::Shared() : std::make_shared<ThreadPool>(threadNum);
+		this->threadNum = pool->ThreadNum();
+	}
+	else this->threadNum = pool->ThreadNum();
+}
+
+SparseSurfelFusion::PointCloudLoader::~PointCloudLoader()
+{
+	unmapFile();
+	if (stagingPoints != NULL) {
+		CHECKCUDA(cudaFreeHost(stagingPoints));
+		CHECKCUDA(cudaFreeHost(stagingColors));
+		stagingPoints = NULL;
+		stagingColors = NULL;
+	}
+}
+
+bool SparseSurfelFusion::PointCloudLoader::LoadToDevice(const std::string& path, DeviceBufferArray<pcl::PointXYZ>& points, cudaStream_t stream, DeviceBufferArray<float3>* colors)
+{
+#ifdef CHECK_MESH_BUILD_TIME_COST
+	auto time1 = std::chrono::high_resolution_clock::now();
+#endif // CHECK_MESH_BUILD_TIME_COST
+
+	mapFile(path);
+	PointLayout layout;
+	const std::string extension = lowerExtension(path);
+	bool supported = true;
+	if (extension == "pcd") supported = parsePCDHeader(layout);
+	else if (extension == "ply") supported = parsePLYHeader(layout);
+	if (!supported) {
+		unmapFile();
+		return false;
+	}
+
+	if (colors == NULL) layout.colorEncoding = ColorEncoding::None;	// 不需要颜色时不解析
+	loadedColors = layout.colorEncoding != ColorEncoding::None;
+	DeviceBufferArray<float3>* colorOutput = loadedColors ? colors : NULL;
+	points.ResizeArray(0);
+	if (colors != NULL) colors->ResizeArray(0);
+	if (layout.binary) loadedPointsNum = loadBinaryPoints(layout, points, colorOutput, stream);
+	else loadedPointsNum = loadAsciiPoints(layout, points, colorOutput, stream);
+	CHECKCUDA(cudaStreamSynchronize(stream));
+	unmapFile();
+
+#ifdef CHECK_MESH_BUILD_TIME_COST
+	auto time2 = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::milli> duration = time2 - time1;
+	std::cout << "点云加载时间: " << duration.count() << " ms" << std::endl;
+#endif // CHECK_MESH_BUILD_TIME_COST
+	return true;
+}
+
+bool SparseSurfelFusion::PointCloudLoader::CountPoints(const std::string& path, unsigned int& count)
+{
+	count = 0;
+	mapFile(path);
+	PointLayout layout;
+	const std::string extension = lowerExtension(path);
+	bool supported = true;
+	if (extension == "pcd") supported = parsePCDHeader(layout);
+	else if (extension == "ply") supported = parsePLYHeader(layout);
+	if (supported) {
+		if (layout.binary) {
+			count = static_cast<unsigned int>(std::min<size_t>(layout.pointsNum, (mappedSize - layout.dataOffset) / layout.stride));
+		}
+		else {
+			size_t lines = 0;
+			countNonBlankLines(mappedData + layout.dataOffset, mappedData + mappedSize, layout.pointsNum, lines);
+			count = static_cast<unsigned int>(lines);
+		}
+	}
+	unmapFile();
+	return supported;
+}
+
+void SparseSurfelFusion::PointCloudLoader::mapFile(const std::string& path)
+{
+	unmapFile();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) LOGGING(FATAL) << "点云读取错误：" << path;
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	mappedSize = size_t(fileSize.QuadPart);
+	fileHandle = file;
+	if (mappedSize == 0) return;
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) LOGGING(FATAL) << "点云文件映射失败：" << path;
+	mappingHandle = mapping;
+	mappedData = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	fileDescriptor = open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0) LOGGING(FATAL) << "点云读取错误：" << path;
+	struct stat fileStat;
+	fstat(fileDescriptor, &fileStat);
+	mappedSize = size_t(fileStat.st_size);
+	if (mappedSize == 0) return;
+	void* data = mmap(NULL, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (data == MAP_FAILED) LOGGING(FATAL) << "点云文件映射失败：" << path;
+	madvise(data, mappedSize, MADV_SEQUENTIAL);
+	mappedData = static_cast<const char*>(data);
+#endif
+	if (mappedData == NULL) LOGGING(FATAL) << "点云文件映射失败：" << path;
+}
+
+void SparseSurfelFusion::PointCloudLoader::unmapFile()
+{
+#ifdef _WIN32
+	if (mappedData != NULL) UnmapViewOfFile(mappedData);
+	if (mappingHandle != NULL) CloseHandle(static_cast<HANDLE>(mappingHandle));
+	if (fileHandle != NULL) CloseHandle(static_cast<HANDLE>(fileHandle));
+	mappingHandle = NULL;
+	fileHandle = NULL;
+#else
+	if (mappedData != NULL) munmap(const_cast<char*>(mappedData), mappedSize);
+	if (fileDescriptor >= 0) close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	mappedData = NULL;
+	mappedSize = 0;
+}
+
+void SparseSurfelFusion::PointCloudLoader::reserveStaging(const size_t count)
+{
+	if (count <= stagingCapacity) return;
+	const size_t capacity = static_cast<size_t>(count * 1.5);
+	pcl::PointXYZ* staging = NULL;
+	float3* stagingColor = NULL;
+	CHECKCUDA(cudaMallocHost((void**)&staging, sizeof(pcl::PointXYZ) * capacity));
+	CHECKCUDA(cudaMallocHost((void**)&stagingColor, sizeof(float3) * capacity));
+	if (stagingPoints != NULL) {
+		memcpy(staging, stagingPoints, sizeof(pcl::PointXYZ) * stagingCapacity);	// 调用方保证旧内存上的拷贝已完成
+		memcpy(stagingColor, stagingColors, sizeof(float3) * stagingCapacity);
+		CHECKCUDA(cudaFreeHost(stagingPoints));
+		CHECKCUDA(cudaFreeHost(stagingColors));
+	}
+	stagingPoints = staging;
+	stagingColors = stagingColor;
+	stagingCapacity = capacity;
+}
+
+bool SparseSurfelFusion::PointCloudLoader::parsePCDHeader(PointLayout& layout) const
+{
+	std::vector<std::string> fields;
+	std::vector<unsigned int> sizes, counts;
+	std::vector<char> types;
+	const char* ptr = mappedData;
+	const char* end = mappedData + mappedSize;
+	while (ptr < end) {
+		const char* lineEnd = static_cast<const char*>(memchr(ptr, '\n', end - ptr));
+		if (lineEnd == NULL) lineEnd = end;
+		std::istringstream line(std::string(ptr, lineEnd));
+		ptr = lineEnd < end ? lineEnd + 1 : end;
+		std::string keyword;
+		if (!(line >> keyword) || keyword[0] == '#') continue;
+		if (keyword == "FIELDS") { std::string f; while (line >> f) fields.push_back(f); }
+		else if (keyword == "SIZE") { unsigned int s; while (line >> s) sizes.push_back(s); }
+		else if (keyword == "TYPE") { char t; while (line >> t) types.push_back(t); }
+		else if (keyword == "COUNT") { unsigned int c; while (line >> c) counts.push_back(c); }
+		else if (keyword == "POINTS") line >> layout.pointsNum;
+		else if (keyword == "DATA") {
+			std::string data;
+			line >> data;
+			if (data == "ascii") layout.binary = false;
+			else if (data == "binary") layout.binary = true;
+			else return false;	// binary_compressed
+			layout.dataOffset = ptr - mappedData;
+			break;
+		}
+	}
+	if (layout.dataOffset == 0) return false;
+	if (counts.empty()) counts.assign(fields.size(), 1);
+	if (sizes.size() != fields.size() || types.size() != fields.size() || counts.size() != fields.size()) return false;
+
+	unsigned int valueIndex = 0, byteOffset = 0;
+	int found = 0;
+	for (size_t i = 0; i < fields.size(); i++) {
+		const int axis = fields[i] == "x" ? 0 : (fields[i] == "y" ? 1 : (fields[i] == "z" ? 2 : -1));
+		if (axis >= 0) {
+			if (types[i] != 'F') return false;
+			layout.fieldIndex[axis] = valueIndex;
+			layout.byteOffset[axis] = byteOffset;
+			layout.isDouble[axis] = sizes[i] == 8;
+			found++;
+		}
+		else if ((fields[i] == "rgb" || fields[i] == "rgba") && sizes[i] == 4 && counts[i] == 1) {
+			layout.colorEncoding = types[i] == 'F' ? ColorEncoding::PackedFloat : ColorEncoding::PackedUInt;
+			layout.colorFieldIndex[0] = valueIndex;
+			layout.colorByteOffset[0] = byteOffset;
+		}
+		valueIndex += counts[i];
+		byteOffset += sizes[i] * counts[i];
+	}
+	if (found != 3) return false;
+	layout.fieldsPerPoint = valueIndex;
+	layout.stride = byteOffset;
+	return true;
+}
+
+bool SparseSurfelFusion::PointCloudLoader::parsePLYHeader(PointLayout& layout) const
+{
+	const char* ptr = mappedData;
+	const char* end = mappedData + mappedSize;
+	bool inVertex = false, vertexSeen = false;
+	unsigned int valueIndex = 0, byteOffset = 0;
+	int found = 0, colorFound = 0;
+	ColorEncoding colorEncoding = ColorEncoding::None;
+	while (ptr < end) {
+		const char* lineEnd = static_cast<const char*>(memchr(ptr, '\n', end - ptr));
+		if (lineEnd == NULL) lineEnd = end;
+		std::istringstream line(std::string(ptr, lineEnd));
+		ptr = lineEnd < end ? lineEnd + 1 : end;
+		std::string keyword;
+		if (!(line >> keyword)) continue;
+		if (keyword == "format") {
+			std::string format;
+			line >> format;
+			if (format == "ascii") layout.binary = false;
+			else if (format == "binary_little_endian") layout.binary = true;
+			else return false;	// 大端
+		}
+		else if (keyword == "element") {
+			std::string name;
+			unsigned int count;
+			line >> name >> count;
+			if (name == "vertex") {
+				if (vertexSeen) return false;
+				inVertex = vertexSeen = true;
+				layout.pointsNum = count;
+			}
+			else {
+				if (!vertexSeen) return false;	// vertex之前还有别的element，二进制偏移无法直接确定
+				inVertex = false;
+			}
+		}
+		else if (keyword == "property" && inVertex) {
+			std::string type, name;
+			line >> type;
+			if (type == "list") return false;
+			line >> name;
+			unsigned int size;
+			if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") size = 1;
+			else if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") size = 2;
+			else if (type == "int" || type == "uint" || type == "float" || type == "int32" || type == "uint32" || type == "float32") size = 4;
+			else if (type == "double" || type == "float64") size = 8;
+			else return false;
+			const int axis = name == "x" ? 0 : (name == "y" ? 1 : (name == "z" ? 2 : -1));
+			if (axis >= 0) {
+				if (type != "float" && type != "float32" && type != "double" && type != "float64") return false;
+				layout.fieldIndex[axis] = valueIndex;
+				layout.byteOffset[axis] = byteOffset;
+				layout.isDouble[axis] = size == 8;
+				found++;
+			}
+			const int channel = name == "red" ? 0 : (name == "green" ? 1 : (name == "blue" ? 2 : -1));
+			if (channel >= 0) {
+				ColorEncoding encoding = ColorEncoding::None;
+				if (type == "uchar" || type == "uint8") encoding = ColorEncoding::UChar;
+				else if (type == "ushort" || type == "uint16") encoding = ColorEncoding::UShort;
+				else if (type == "float" || type == "float32") encoding = ColorEncoding::Float;
+				if (encoding != ColorEncoding::None && (colorFound == 0 || encoding == colorEncoding)) {	// 三个通道的类型需一致
+					colorEncoding = encoding;
+					layout.colorFieldIndex[channel] = valueIndex;
+					layout.colorByteOffset[channel] = byteOffset;
+					colorFound++;
+				}
+			}
+			valueIndex++;
+			byteOffset += size;
+		}
+		else if (keyword == "end_header") {
+			layout.dataOffset = ptr - mappedData;
+			break;
+		}
+	}
+	if (layout.dataOffset == 0 || found != 3) return false;
+	if (colorFound == 3) layout.colorEncoding = colorEncoding;
+	layout.fieldsPerPoint = valueIndex;
+	layout.stride = byteOffset;
+	return true;
+}
+
+unsigned int SparseSurfelFusion::PointCloudLoader::loadAsciiPoints(const PointLayout& layout, DeviceBufferArray<pcl::PointXYZ>& points, DeviceBufferArray<float3>* colors, cudaStream_t stream)
+{
+	const char* dataBegin = mappedData + layout.dataOffset;
+	const char* dataEnd = mappedData + mappedSize;
+	if (layout.pointsNum > 0) {	// PLY的vertex后面可能还有face，只解析前pointsNum个非空行
+		size_t lines = 0;
+		dataEnd = countNonBlankLines(dataBegin, dataEnd, layout.pointsNum, lines);
+	}
+
+	// 按行边界切块，每块交给一个线程解析
+	const bool withColors = colors != NULL;
+	typedef std::pair<std::vector<pcl::PointXYZ>, std::vector<float3>> ParsedChunk;
+	std::vector<std::future<ParsedChunk>> chunks;
+	const char* chunkBegin = dataBegin;
+	while (chunkBegin < dataEnd) {
+		const char* chunkEnd = chunkBegin + std::min<size_t>(POINT_CLOUD_LOADER_CHUNK_BYTES, dataEnd - chunkBegin);
+		if (chunkEnd < dataEnd) {
+			const char* lineEnd = static_cast<const char*>(memchr(chunkEnd, '\n', dataEnd - chunkEnd));
+			chunkEnd = lineEnd == NULL ? dataEnd : lineEnd + 1;
+		}
+		chunks.push_back(pool->Submit(TaskPriority::High, [chunkBegin, chunkEnd, layout, withColors]() {	// 解析在重建的关键路径上
+			ParsedChunk output;
+			output.first.reserve((chunkEnd - chunkBegin) / 16);
+			parseAsciiLines(chunkBegin, chunkEnd, layout, output.first, withColors ? &output.second : NULL);
+			return output;
+		}));
+		chunkBegin = chunkEnd;
+	}
+
+	// 预估点数：已知点数直接使用，txt按首块的字节/点外推
+	size_t estimated = layout.pointsNum;
+	size_t uploaded = 0;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		ParsedChunk parsed = chunks[i].get();
+		const std::vector<pcl::PointXYZ>& chunk = parsed.first;
+		if (i == 0 && estimated == 0 && !chunk.empty()) {
+			const size_t firstBytes = std::min<size_t>(POINT_CLOUD_LOADER_CHUNK_BYTES, dataEnd - dataBegin);
+			estimated = size_t(double(dataEnd - dataBegin) / firstBytes * chunk.size()) + 1;
+		}
+		const size_t required = std::max(estimated, uploaded + chunk.size());
+		if (required > stagingCapacity || uploaded + chunk.size() > points.BufferSize() || (withColors && uploaded + chunk.size() > colors->BufferSize())) {
+			// 扩容前需要等待已发出的异步拷贝完成
+			CHECKCUDA(cudaStreamSynchronize(stream));
+			reserveStaging(required);
+			points.ResizeArray(required, true);
+			points.ResizeArray(uploaded);
+			if (withColors) {
+				colors->ResizeArray(required, true);
+				colors->ResizeArray(uploaded);
+			}
+		}
+		if (chunk.empty()) continue;
+		memcpy(stagingPoints + uploaded, chunk.data(), sizeof(pcl::PointXYZ) * chunk.size());
+		CHECKCUDA(cudaMemcpyAsync(points.Ptr() + uploaded, stagingPoints + uploaded, sizeof(pcl::PointXYZ) * chunk.size(), cudaMemcpyHostToDevice, stream));
+		if (withColors) {
+			memcpy(stagingColors + uploaded, parsed.second.data(), sizeof(float3) * chunk.size());
+			CHECKCUDA(cudaMemcpyAsync(colors->Ptr() + uploaded, stagingColors + uploaded, sizeof(float3) * chunk.size(), cudaMemcpyHostToDevice, stream));
+		}
+		uploaded += chunk.size();
+		points.ResizeArray(uploaded);
+		if (withColors) colors->ResizeArray(uploaded);
+	}
+	return static_cast<unsigned int>(uploaded);
+}
+
+unsigned int SparseSurfelFusion::PointCloudLoader::loadBinaryPoints(const PointLayout& layout, DeviceBufferArray<pcl::PointXYZ>& points, DeviceBufferArray<float3>* colors, cudaStream_t stream)
+{
+	const size_t available = (mappedSize - layout.dataOffset) / layout.stride;
+	const size_t pointsNum = std::min<size_t>(layout.pointsNum, available);
+	if (pointsNum < layout.pointsNum) LOGGING(INFO) << "点云文件被截断，声明 " << layout.pointsNum << " 个点，实际 " << pointsNum << " 个";
+	reserveStaging(pointsNum);
+	if (pointsNum > points.BufferSize()) points.ResizeArray(pointsNum, true);	// 数组为空，扩容无需拷贝
+	if (colors != NULL && pointsNum > colors->BufferSize()) colors->ResizeArray(pointsNum, true);
+
+	// 每块点数取文件块大小对应的点数，块之间互不依赖，直接写入页锁定内存的最终位置
+	const size_t chunkPoints = std::max<size_t>(1, POINT_CLOUD_LOADER_CHUNK_BYTES / layout.stride);
+	const char* dataBegin = mappedData + layout.dataOffset;
+	pcl::PointXYZ* staging = stagingPoints;
+	float3* stagingColor = colors != NULL ? stagingColors : NULL;
+	std::vector<std::future<void>> chunks;
+	for (size_t begin = 0; begin < pointsNum; begin += chunkPoints) {
+		const size_t end = std::min(pointsNum, begin + chunkPoints);
+		chunks.push_back(pool->Submit(TaskPriority::High, [dataBegin, staging, stagingColor, begin, end, layout]() {
+			for (size_t i = begin; i < end; i++) {
+				const char* point = dataBegin + i * layout.stride;
+				staging[i].x = readBinaryCoordinate(point + layout.byteOffset[0], layout.isDouble[0]);
+				staging[i].y = readBinaryCoordinate(point + layout.byteOffset[1], layout.isDouble[1]);
+				staging[i].z = readBinaryCoordinate(point + layout.byteOffset[2], layout.isDouble[2]);
+				staging[i].data[3] = 1.0f;
+				if (stagingColor != NULL) stagingColor[i] = readBinaryColor(point, layout);
+			}
+		}));
+	}
+	for (size_t i = 0; i < chunks.size(); i++) {
+		chunks[i].get();
+		const size_t begin = i * chunkPoints;
+		const size_t count = std::min(pointsNum, begin + chunkPoints) - begin;
+		CHECKCUDA(cudaMemcpyAsync(points.Ptr() + begin, stagingPoints + begin, sizeof(pcl::PointXYZ) * count, cudaMemcpyHostToDevice, stream));
+		if (colors != NULL) CHECKCUDA(cudaMemcpyAsync(colors->Ptr() + begin, stagingColors + begin, sizeof(float3) * count, cudaMemcpyHostToDevice, stream));
+	}
+	points.ResizeArray(pointsNum);
+	if (colors != NULL) colors->ResizeArray(pointsNum);
+	return static_cast<unsigned int>(pointsNum);
+}
+
+void SparseSurfelFusion::PointCloudLoader::parseAsciiLines(const char* begin, const char* end, const PointLayout& layout, std::vector<pcl::PointXYZ>& output, std::vector<float3>* colors)
+{
+	int lastField = std::max(layout.fieldIndex[0], std::max(layout.fieldIndex[1], layout.fieldIndex[2]));
+	if (colors != NULL) lastField = std::max(lastField, std::max(layout.colorFieldIndex[0], std::max(layout.colorFieldIndex[1], layout.colorFieldIndex[2])));
+	const char* ptr = begin;
+	while (ptr < end) {
+		const char* lineEnd = static_cast<const char*>(memchr(ptr, '\n', end - ptr));
+		if (lineEnd == NULL) lineEnd = end;
+		float values[3];
+		double colorValues[3] = { 0.0, 0.0, 0.0 };
+		int field = 0;
+		const char* p = ptr;
+		while (field <= lastField) {
+			while (p < lineEnd && isBlank(*p)) p++;
+			if (p >= lineEnd) break;
+			double value;
+			if (!parseNumber(p, lineEnd, value)) break;
+			for (int axis = 0; axis < 3; axis++) {
+				if (layout.fieldIndex[axis] == field) values[axis] = float(value);
+				if (layout.colorFieldIndex[axis] == field) colorValues[axis] = value;
+			}
+			field++;
+		}
+		if (field > lastField) {		// 空行、注释或数值不足的行直接跳过
+			pcl::PointXYZ point;
+			point.x = values[0];
+			point.y = values[1];
+			point.z = values[2];
+			output.push_back(point);
+			if (colors != NULL) colors->push_back(convertAsciiColor(colorValues, layout));
+		}
+		ptr = lineEnd < end ? lineEnd + 1 : end;
+	}
+}
+
+float3 SparseSurfelFusion::PointCloudLoader::readBinaryColor(const char* point, const PointLayout& layout)
+{
+	float3 color = make_float3(0.0f, 0.0f, 0.0f);
+	float* channels = &color.x;
+	switch (layout.colorEncoding) {
+	case ColorEncoding::PackedFloat:
+	case ColorEncoding::PackedUInt: {
+		unsigned int rgb;
+		memcpy(&rgb, point + layout.colorByteOffset[0], sizeof(unsigned int));
+		return unpackColor(rgb);
+	}
+	case ColorEncoding::UChar:
+		for (int k = 0; k < 3; k++) channels[k] = static_cast<unsigned char>(point[layout.colorByteOffset[k]]) / 255.0f;
+		break;
+	case ColorEncoding::UShort:
+		for (int k = 0; k < 3; k++) {
+			unsigned short value;
+			memcpy(&value, point + layout.colorByteOffset[k], sizeof(unsigned short));
+			channels[k] = value / 65535.0f;
+		}
+		break;
+	case ColorEncoding::Float:
+		for (int k = 0; k < 3; k++) channels[k] = readBinaryCoordinate(point + layout.colorByteOffset[k], false);
+		break;
+	default:
+		break;
+	}
+	return color;
+}
+
+float3 SparseSurfelFusion::PointCloudLoader::convertAsciiColor(const double values[3], const PointLayout& layout)
+{
+	switch (layout.colorEncoding) {
+	case ColorEncoding::PackedFloat: {	// ASCII中写出的是打包整数按float解释后的值
+		const float packed = float(values[0]);
+		unsigned int rgb;
+		memcpy(&rgb, &packed, sizeof(unsigned int));
+		return unpackColor(rgb);
+	}
+	case ColorEncoding::PackedUInt:
+		return unpackColor(static_cast<unsigned int>(values[0]));
+	case ColorEncoding::UChar:
+		return make_float3(float(values[0] / 255.0), float(values[1] / 255.0), float(values[2] / 255.0));
+	case ColorEncoding::UShort:
+		return make_float3(float(values[0] / 65535.0), float(values[1] / 65535.0), float(values[2] / 65535.0));
+	case ColorEncoding::Float:
+		return make_float3(float(values[0]), float(values[1]), float(values[2]));
+	default:
+		return make_float3(0.0f, 0.0f, 0.0f);
+	}
+}
+
+bool SparseSurfelFusion::PointCloudLoader::parseNumber(const char*& ptr, const char* end, double& value)
+{
+	const char* p = ptr;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+	unsigned long long mantissa = 0;
+	int exponent = 0, digits = 0;
+	for (; p < end && unsigned(*p - '0') < 10; p++, digits++) {
+		if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0');
+		else exponent++;		// 超出有效位数的整数部分只计入指数
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && unsigned(*p - '0') < 10; p++, digits++) {
+			if (mantissa < 100000000000000000ull) {
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+		}
+	}
+	if (digits == 0) return false;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+')) negativeExponent = (*e++ == '-');
+		if (e < end && unsigned(*e - '0') < 10) {
+			int exponentValue = 0;
+			for (; e < end && unsigned(*e - '0') < 10; e++) exponentValue = std::min(exponentValue * 10 + (*e - '0'), 1000);
+			exponent += negativeExponent ? -exponentValue : exponentValue;
+			p = e;
+		}
+	}
+	double result = double(mantissa);
+	if (exponent < 0) {
+		while (exponent < -22) { result /= 1e22; exponent += 22; }
+		result /= Pow10Table[-exponent];
+	}
+	else {
+		while (exponent > 22) { result *= 1e22; exponent -= 22; }
+		result *= Pow10Table[exponent];
+	}
+	value = negative ? -result : result;
+	ptr = p;
+	return true;
+}
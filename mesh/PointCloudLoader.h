@@ -0,0 +1,183 @@
+/*****************************************************************//**
+ * \file   PointCloudLoader.h
+ * \brief  点云文件加载：内存映射 + 多线程解析 + 页锁定内存异步上传，支持txt、ASCII/二进制的PCD与PLY及其逐点颜色
+ *
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cuda_runtime_api.h>
+#include <pcl/point_types.h>
+#include <base/Logging.h>
+#include <base/ThreadPool.h>
+#include <base/DeviceReadWrite/DeviceBufferArray.h>
+
+#define POINT_CLOUD_LOADER_CHUNK_BYTES (8 << 20)	// ASCII解析时每个任务处理的字节数
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 点云文件加载器：文件整体内存映射，ASCII数据按行边界切块并行解析，二进制数据按点切块并行拆包，
+	 *        解析完成的块按顺序写入页锁定内存并立即异步上传，上传与后续块的解析重叠.
+	 *        点统一输出为pcl::PointXYZ排布(x, y, z, 1)，颜色(PCD的rgb/rgba，PLY的red/green/blue)统一输出为[0, 1]的float3.
+	 */
+	class PointCloudLoader
+	{
+	public:
+		using Ptr = std::shared_ptr<PointCloudLoader>;
+
+		/**
+		 * \brief 构造加载器.
+		 *
+		 * \param threadNum 解析线程数量，0表示使用进程内共享的线程池(ThreadPool::Shared)，传入threadPool时忽略
+		 * \param threadPool 共享的线程池，为空且threadNum不为0时创建threadNum个线程的线程池
+		 */
+		PointCloudLoader(const unsigned int threadNum = 0, std::shared_ptr<ThreadPool> threadPool = nullptr);
+
+		~PointCloudLoader();
+
+		/**
+		 * \brief 读取点云文件(按扩展名区分.txt/.pcd/.ply)，并异步上传到显存.
+		 *
+		 * \param path 文件路径
+		 * \param points 【输出】显存中的点，容量不足时扩容
+		 * \param stream 上传使用的cuda流，返回时已同步
+		 * \param colors 【输出】显存中的逐点颜色，为NULL时不解析颜色；文件没有颜色时数组大小为0
+		 * \return 文件格式不支持(如binary_compressed的PCD、大端PLY)时返回false，调用方应退回其他读取方式
+		 */
+		bool LoadToDevice(const std::string& path, DeviceBufferArray<pcl::PointXYZ>& points, cudaStream_t stream = 0, DeviceBufferArray<float3>* colors = NULL);
+
+		/**
+		 * \brief 只在Host端统计文件中的点数量，不解析坐标、不上传显存：二进制按文件头与数据段大小计算，
+		 *        ASCII数非空行(txt中无法解析的行也计入，适合按点数估计重建规模).
+		 *
+		 * \param path 文件路径
+		 * \param count 【输出】点数量
+		 * \return 文件格式不支持时返回false，count为0
+		 */
+		bool CountPoints(const std::string& path, unsigned int& count);
+
+		/**
+		 * \brief 获得最近一次加载的Host端点(页锁定内存)，下一次加载前有效.
+		 */
+		const pcl::PointXYZ* GetHostPoints() const { return stagingPoints; }
+
+		/**
+		 * \brief 获得最近一次加载的点数量.
+		 */
+		unsigned int GetPointsCount() const { return loadedPointsNum; }
+
+		/**
+		 * \brief 最近一次加载是否输出了逐点颜色.
+		 */
+		bool HasColors() const { return loadedColors; }
+
+	private:
+		/**
+		 * \brief 颜色在文件中的编码.
+		 */
+		enum class ColorEncoding {
+			None,			// 没有颜色
+			PackedFloat,	// PCD的rgb：float的位模式为0x00RRGGBB
+			PackedUInt,		// PCD的rgba：无符号整数0xAARRGGBB
+			UChar,			// 三个通道分别为[0, 255]
+			UShort,			// 三个通道分别为[0, 65535]
+			Float			// 三个通道分别为[0, 1]
+		};
+
+		/**
+		 * \brief 点数据在文件中的排布.
+		 */
+		struct PointLayout {
+			bool binary = false;				// 数据段是否为二进制
+			size_t dataOffset = 0;				// 数据段在文件中的偏移
+			unsigned int pointsNum = 0;			// 头中声明的点数量，0表示未知(txt)
+			unsigned int fieldsPerPoint = 3;	// ASCII：每行的数值个数
+			int fieldIndex[3] = { 0, 1, 2 };	// ASCII：x、y、z在一行中是第几个数值
+			unsigned int stride = 0;			// 二进制：每个点的字节数
+			unsigned int byteOffset[3] = { 0, 4, 8 };	// 二进制：x、y、z在点中的字节偏移
+			bool isDouble[3] = { false, false, false };	// 二进制：x、y、z是否为double
+			ColorEncoding colorEncoding = ColorEncoding::None;	// 颜色编码，打包编码只使用第0个通道的位置
+			int colorFieldIndex[3] = { -1, -1, -1 };	// ASCII：r、g、b在一行中是第几个数值
+			unsigned int colorByteOffset[3] = { 0, 0, 0 };	// 二进制：r、g、b在点中的字节偏移
+		};
+
+		std::shared_ptr<ThreadPool> pool;		// 解析线程池
+		unsigned int threadNum = 1;				// 解析线程数量
+
+		const char* mappedData = NULL;			// 映射的文件首地址
+		size_t mappedSize = 0;					// 映射的文件大小
+		void* fileHandle = NULL;				// Windows下的文件句柄
+		void* mappingHandle = NULL;				// Windows下的映射句柄
+		int fileDescriptor = -1;				// Linux下的文件描述符
+
+		pcl::PointXYZ* stagingPoints = NULL;	// 页锁定的Host端点
+		float3* stagingColors = NULL;			// 页锁定的Host端颜色，容量与stagingPoints相同
+		size_t stagingCapacity = 0;				// 页锁定内存能容纳的点数量
+		unsigned int loadedPointsNum = 0;		// 最近一次加载的点数量
+		bool loadedColors = false;				// 最近一次加载是否输出了颜色
+
+		/**
+		 * \brief 将文件只读映射到内存.
+		 */
+		void mapFile(const std::string& path);
+
+		/**
+		 * \brief 解除文件映射.
+		 */
+		void unmapFile();
+
+		/**
+		 * \brief 保证页锁定内存能容纳count个点(及其颜色).
+		 */
+		void reserveStaging(const size_t count);
+
+		/**
+		 * \brief 解析PCD文件头，binary_compressed等不支持的格式返回false.
+		 */
+		bool parsePCDHeader(PointLayout& layout) const;
+
+		/**
+		 * \brief 解析PLY文件头，大端或vertex不是首个element时返回false.
+		 */
+		bool parsePLYHeader(PointLayout& layout) const;
+
+		/**
+		 * \brief 多线程解析ASCII数据段，解析完成的块按顺序写入页锁定内存并异步上传.
+		 */
+		unsigned int loadAsciiPoints(const PointLayout& layout, DeviceBufferArray<pcl::PointXYZ>& points, DeviceBufferArray<float3>* colors, cudaStream_t stream);
+
+		/**
+		 * \brief 多线程拆包二进制数据段，拆包完成的块按顺序异步上传.
+		 */
+		unsigned int loadBinaryPoints(const PointLayout& layout, DeviceBufferArray<pcl::PointXYZ>& points, DeviceBufferArray<float3>* colors, cudaStream_t stream);
+
+		/**
+		 * \brief 解析[begin, end)中的ASCII行，每行取出x、y、z，colors非NULL时同时取出颜色.
+		 */
+		static void parseAsciiLines(const char* begin, const char* end, const PointLayout& layout, std::vector<pcl::PointXYZ>& output, std::vector<float3>* colors);
+
+		/**
+		 * \brief 从二进制点中读取颜色.
+		 */
+		static float3 readBinaryColor(const char* point, const PointLayout& layout);
+
+		/**
+		 * \brief 把ASCII行中颜色字段的数值转为[0, 1]的颜色.
+		 */
+		static float3 convertAsciiColor(const double values[3], const PointLayout& layout);
+
+		/**
+		 * \brief 解析一个数值，不依赖locale，失败返回false.
+		 *
+		 * \param ptr 当前位置，成功后指向数值之后
+		 * \param end 当前行的终点
+		 * \param value 【输出】解析得到的值(double保证打包颜色的32位整数不丢失精度)
+		 */
+		static bool parseNumber(const char*& ptr, const char* end, double& value);
+	};
+}
@@ -7,35 +7,164 @@
  *********************************************************************/
 #include "PoissonReconstruction.h"
 
-SparseSurfelFusion::PoissonReconstruction::PoissonReconstruction()
+SparseSurfelFusion::PoissonReconstruction::PoissonReconstruction(const ReconstructionConfig& reconstructionConfig) : config(reconstructionConfig)
 {
+	config.CheckValid();
+	CHECKCUDA(cudaSetDevice(config.deviceId));	// 本实例的显存、流均开辟在config.deviceId上
+	DeviceMemoryPool::Instance(config.deviceId).SetReleaseThreshold(config.memoryPoolReleaseThreshold);
 	initCudaStream();	// 初始化执行mesh任务的cuda流
+	MeshScheduler = std::make_shared<StreamScheduler>(MeshStream, MAX_MESH_STREAM, MeshResourceCount);
 	
-	DrawConstructedMesh = std::make_shared<DrawMesh>();
+#if RECONSTRUCTION_WITH_RENDER
+	if (config.enableRender) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::Render);
+		DrawConstructedMesh = std::make_shared<DrawMesh>(config);
+		CHECKCUDA(cudaStreamCreate(&RenderStream));
+		CHECKCUDA(cudaEventCreateWithFlags(&RenderInputReleasedEvent, cudaEventDisableTiming));
+	}
+#endif // RECONSTRUCTION_WITH_RENDER
 
 	cloud = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>();
 	normals = std::make_shared<pcl::PointCloud<pcl::Normal>>();
 
-	OctreePtr = std::make_shared<BuildOctree>();
-	VectorFieldPtr = std::make_shared<ComputeVectorField>(MeshStream[0]);	// 初始化的时候即构建点积表
-	NodeDivergencePtr = std::make_shared<ComputeNodesDivergence>();
-	LaplacianSolverPtr = std::make_shared<LaplacianSolver>();
-	MeshGeometryPtr = std::make_shared<BuildMeshGeometry>();
-	TriangleIndicesPtr = std::make_shared<ComputeTriangleIndices>();
-
-	DenseSurfel.AllocateBuffer(MAX_SURFEL_COUNT);
-	PointNormalDevice.AllocateBuffer(MAX_SURFEL_COUNT);
-	PointCloudDevice.AllocateBuffer(MAX_SURFEL_COUNT);
-	PointCloudColor.AllocateBuffer(MAX_SURFEL_COUNT);
+	// 各模块构造时预分配的显存按模块记入显存池统计
+	{ MemoryPoolTagScope memoryTag(MemoryPoolTag::Octree);			OctreePtr = std::make_shared<BuildOctree>(config); }
+	{ MemoryPoolTagScope memoryTag(MemoryPoolTag::VectorField);		VectorFieldPtr = std::make_shared<ComputeVectorField>(MeshStream[0], config); }	// 初始化的时候即构建点积表
+	{ MemoryPoolTagScope memoryTag(MemoryPoolTag::Divergence);		NodeDivergencePtr = std::make_shared<ComputeNodesDivergence>(config); }
+	{ MemoryPoolTagScope memoryTag(MemoryPoolTag::Solver);			LaplacianSolverPtr = std::make_shared<LaplacianSolver>(config); }
+	{ MemoryPoolTagScope memoryTag(MemoryPoolTag::Geometry);		MeshGeometryPtr = std::make_shared<BuildMeshGeometry>(config); }
+	{ MemoryPoolTagScope memoryTag(MemoryPoolTag::Triangulation);	TriangleIndicesPtr = std::make_shared<ComputeTriangleIndices>(config); }
+	ImplicitQueryPtr = std::make_shared<ImplicitFunctionQuery>();
+	PointNormalsPtr = std::make_shared<ComputePointNormals>(config);
+	pool = ThreadPool::Shared();	// 批量重建的各通道共用一个池，避免线程数随通道数成倍增加
+	PointCloudLoaderPtr = std::make_shared<PointCloudLoader>(0, pool);
+	ProfilerPtr = std::make_shared<StageProfiler>();
+	MeshExporterPtr = std::make_shared<MeshExporter>(config.deviceId, pool);
+	LaplacianSolverPtr->SetProfiler(ProfilerPtr.get());
+	TriangleIndicesPtr->SetProfiler(ProfilerPtr.get());
+	SimplificationPtr = std::make_shared<MeshSimplification>();
+	TriangleIndicesPtr->SetSimplification(SimplificationPtr.get());
+#if RECONSTRUCTION_WITH_RENDER
+	TriangleIndicesPtr->SetVertexTriangleAdjacency(DrawConstructedMesh != nullptr);	// 绘制时按顶点计算法线
+#endif // RECONSTRUCTION_WITH_RENDER
+
+	MemoryPoolTagScope memoryTag(MemoryPoolTag::Input);
+	DenseSurfel.AllocateBuffer(config.maxSurfelCount);
+	PointNormalDevice.AllocateBuffer(config.maxSurfelCount);
+	PointCloudDevice.AllocateBuffer(config.maxSurfelCount);
+	PointCloudColor.AllocateBuffer(config.maxSurfelCount);
 }
 
 SparseSurfelFusion::PoissonReconstruction::~PoissonReconstruction()
 {
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	MeshExporterPtr.reset();	// 等待正在进行的导出
+	MeshScheduler.reset();		// 事件先于流销毁
 	releaseCudaStream();
+#if RECONSTRUCTION_WITH_RENDER
+	if (RenderStream != NULL) {
+		CHECKCUDA(cudaStreamSynchronize(RenderStream));		// 渲染槽位的显存随DrawConstructedMesh释放
+		CHECKCUDA(cudaEventDestroy(RenderInputReleasedEvent));
+		CHECKCUDA(cudaStreamDestroy(RenderStream));
+		RenderStream = NULL;
+	}
+#endif // RECONSTRUCTION_WITH_RENDER
 	DenseSurfel.ReleaseBuffer();
 	PointNormalDevice.ReleaseBuffer();
 	PointCloudDevice.ReleaseBuffer();
 	PointCloudColor.ReleaseBuffer();
+	ImplicitGridValues.ReleaseBuffer();
+	ImplicitBrickOrigins.ReleaseBuffer();
+	for (int i = 0; i < 2; i++) {
+		TileSurfel[i].ReleaseBuffer();
+		if (TileSurfelHost[i] != NULL) {
+			CHECKCUDA(cudaFreeHost(TileSurfelHost[i]));
+			CHECKCUDA(cudaEventDestroy(TileUploadEvent[i]));
+			TileSurfelHost[i] = NULL;
+		}
+	}
+	if (TileUploadStream != NULL) {
+		CHECKCUDA(cudaStreamDestroy(TileUploadStream));
+		TileUploadStream = NULL;
+	}
+	if (PreviewStream != NULL) {
+		CHECKCUDA(cudaStreamSynchronize(PreviewStream));	// 发布回调引用TriangleIndicesPtr的预览缓冲
+		CHECKCUDA(cudaStreamDestroy(PreviewStream));
+		PreviewStream = NULL;
+	}
+}
+
+void SparseSurfelFusion::PoissonReconstruction::SetProgressivePreview(const bool enable, const int depth, PreviewMeshCallback callback)
+{
+	if (enable && (depth < 1 || depth >= Constants::maxDepth_Host)) LOGGING(FATAL) << "预览层须在[1, " << Constants::maxDepth_Host << ")之间，当前为 " << depth;
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	if (PreviewStream != NULL) CHECKCUDA(cudaStreamSynchronize(PreviewStream));	// 预览缓冲可能仍在被写入
+	else if (enable) CHECKCUDA(cudaStreamCreateWithFlags(&PreviewStream, cudaStreamNonBlocking));
+	previewDepth = enable ? depth : -1;
+	LaplacianSolverPtr->SetPreviewDepth(previewDepth);
+	TriangleIndicesPtr->SetPreviewMesh(enable, callback);
+}
+
+void SparseSurfelFusion::PoissonReconstruction::AddRegionOfInterest(const Point3D<float>& minPoint, const Point3D<float>& maxPoint)
+{
+	if (regionsOfInterest.count >= MAX_MESH_ROI_COUNT) LOGGING(FATAL) << "感兴趣区域最多 " << MAX_MESH_ROI_COUNT << " 个";
+	const int i = regionsOfInterest.count++;
+	regionsOfInterest.minPoint[i] = make_float3(std::min(minPoint.coords[0], maxPoint.coords[0]), std::min(minPoint.coords[1], maxPoint.coords[1]), std::min(minPoint.coords[2], maxPoint.coords[2]));
+	regionsOfInterest.maxPoint[i] = make_float3(std::max(minPoint.coords[0], maxPoint.coords[0]), std::max(minPoint.coords[1], maxPoint.coords[1]), std::max(minPoint.coords[2], maxPoint.coords[2]));
+}
+
+SparseSurfelFusion::MeshRegionsOfInterest SparseSurfelFusion::PoissonReconstruction::normalizedRegionsOfInterest() const
+{
+	MeshRegionsOfInterest regions = regionsOfInterest;
+	if (regions.count == 0) return regions;
+	const Point3D<float> center = OctreePtr->GetNormalizeCenter();
+	const float maxEdge = OctreePtr->GetNormalizeMaxEdge();
+	for (int i = 0; i < regions.count; i++) {
+		regions.minPoint[i] = make_float3((regions.minPoint[i].x - center.coords[0]) / maxEdge, (regions.minPoint[i].y - center.coords[1]) / maxEdge, (regions.minPoint[i].z - center.coords[2]) / maxEdge);
+		regions.maxPoint[i] = make_float3((regions.maxPoint[i].x - center.coords[0]) / maxEdge, (regions.maxPoint[i].y - center.coords[1]) / maxEdge, (regions.maxPoint[i].z - center.coords[2]) / maxEdge);
+	}
+	return regions;
+}
+
+void SparseSurfelFusion::PoissonReconstruction::QueryImplicitFunction(const std::vector<Point3D<float>>& points, std::vector<float>& values)
+{
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	const Point3D<float> center = OctreePtr->GetNormalizeCenter();
+	const float maxEdge = OctreePtr->GetNormalizeMaxEdge();
+	std::vector<Point3D<float>> normalizedPoints(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		for (int j = 0; j < 3; j++) normalizedPoints[i].coords[j] = (points[i].coords[j] - center.coords[j]) / maxEdge;
+	}
+	ImplicitQueryPtr->QueryPoints(normalizedPoints, values, MeshStream[0]);
+}
+
+void SparseSurfelFusion::PoissonReconstruction::ExportImplicitGrid(const int resolutionLog2, std::vector<float>& values)
+{
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	ImplicitQueryPtr->SampleDenseGrid(resolutionLog2, ImplicitGridValues, MeshStream[0]);
+	CHECKCUDA(cudaStreamSynchronize(MeshStream[0]));
+	ImplicitGridValues.ArrayView().Download(values);
+}
+
+void SparseSurfelFusion::PoissonReconstruction::ExportImplicitBricks(const int brickDepth, const int brickResolutionLog2, std::vector<Point3D<float>>& brickOrigins, std::vector<float>& values)
+{
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	const int* NodeArrayCount = OctreePtr->GetNodeArrayCount();
+	const int* BaseAddressArray = OctreePtr->GetBaseAddressArray();
+	if (brickDepth < 0 || brickDepth > Constants::maxDepth_Host) LOGGING(FATAL) << "块所在层须在[0, " << Constants::maxDepth_Host << "]之间，当前为 " << brickDepth;
+	ImplicitQueryPtr->SampleSparseBricks(OctreePtr->GetNodeArrayNodeCenter(), BaseAddressArray[brickDepth], NodeArrayCount[brickDepth], brickDepth, brickResolutionLog2, ImplicitBrickOrigins, ImplicitGridValues, MeshStream[0]);
+	CHECKCUDA(cudaStreamSynchronize(MeshStream[0]));
+	ImplicitGridValues.ArrayView().Download(values);
+	std::vector<float3> origins;
+	ImplicitBrickOrigins.ArrayView().Download(origins);
+	const Point3D<float> center = OctreePtr->GetNormalizeCenter();
+	const float maxEdge = OctreePtr->GetNormalizeMaxEdge();
+	brickOrigins.resize(origins.size());
+	for (size_t i = 0; i < origins.size(); i++) {
+		brickOrigins[i].coords[0] = origins[i].x * maxEdge + center.coords[0];
+		brickOrigins[i].coords[1] = origins[i].y * maxEdge + center.coords[1];
+		brickOrigins[i].coords[2] = origins[i].z * maxEdge + center.coords[2];
+	}
 }
 
 void SparseSurfelFusion::PoissonReconstruction::initCudaStream()
@@ -62,45 +191,62 @@ void SparseSurfelFusion::PoissonReconstruction::synchronizeAllCudaStream()
 
 void SparseSurfelFusion::PoissonReconstruction::readTXTFile(std::string path)
 {
-	FILE* file;
-	if (fopen_s(&file, path.c_str(), "r") != 0) LOGGING(FATAL) << "点云读取错误";	// 只读
-	else {
-		int count = 0;
-		float num;
-		while (fscanf_s(file, "%f", &num) == 1) {
-			PointCloud.push_back(num);
-			count++;
-		}
-		pointsNum = count / 3;
-		std::cout << "总共读取点云个数：" << pointsNum << std::endl;
-		fclose(file);
-	}
-	PointCloudDevice.ResizeArrayOrException(pointsNum * 3);
-	CHECKCUDA(cudaMemcpy(PointCloudDevice.Array().ptr(), PointCloud.data(), sizeof(float) * pointsNum * 3, cudaMemcpyHostToDevice));
-	buildDenseSurfel(PointCloudDevice, DenseSurfel);
+	// 每行"x y z"，映射后多线程解析，解析完的块异步上传到PointCloudDevice
+	if (!PointCloudLoaderPtr->LoadToDevice(path, PointCloudDevice, MeshStream[0], &PointCloudColor)) LOGGING(FATAL) << "点云读取错误";
+	pointsNum = PointCloudLoaderPtr->GetPointsCount();
+	std::cout << "总共读取点云个数：" << pointsNum << std::endl;
+	DenseSurfel.ResizeArrayOrException(pointsNum);
+	buildDenseSurfel(PointCloudDevice, DenseSurfel, PointCloudColor.ArrayView(), MeshStream[0]);
+	CHECKCUDA(cudaStreamSynchronize(MeshStream[0]));
 }
 
 void SparseSurfelFusion::PoissonReconstruction::readPCDFile(std::string path)
 {
 	// 读取 PCD 文件
 
-	pcl::io::loadPCDFile(path, *cloud);
-	CalculatePointCloudNormal(cloud, normals);
+#if !RECONSTRUCTION_WITH_PCL_IO
+	if (!gpuNormalEstimation) LOGGING(FATAL) << "未编译PCL文件读写，readPCDFile只能在GPU上估计法线";
+#endif // !RECONSTRUCTION_WITH_PCL_IO
+	if (PointCloudLoaderPtr->LoadToDevice(path, PointCloudDevice, MeshStream[0], &PointCloudColor)) {
+		if (!gpuNormalEstimation) {	// CPU法线估计需要Host端的pcl点云
+			const pcl::PointXYZ* hostPoints = PointCloudLoaderPtr->GetHostPoints();
+			cloud->points.assign(hostPoints, hostPoints + PointCloudLoaderPtr->GetPointsCount());
+			cloud->width = PointCloudLoaderPtr->GetPointsCount();
+			cloud->height = 1;
+		}
+	}
+	else {	// binary_compressed等加载器不支持的格式交给PCL
+#if RECONSTRUCTION_WITH_PCL_IO
+		pcl::io::loadPCDFile(path, *cloud);
+		PointCloudColor.ResizeArrayOrException(0);
+		PointCloudDevice.ResizeArrayOrException(cloud->size());
+		CHECKCUDA(cudaMemcpy(PointCloudDevice.Array().ptr(), cloud->data(), sizeof(pcl::PointXYZ) * cloud->size(), cudaMemcpyHostToDevice));
+#else
+		LOGGING(FATAL) << "未编译PCL文件读写，无法读取 " << path;
+#endif // RECONSTRUCTION_WITH_PCL_IO
+	}
+#if RECONSTRUCTION_WITH_PCL_IO
+	if (!gpuNormalEstimation) CalculatePointCloudNormal(cloud, normals);
+#endif // RECONSTRUCTION_WITH_PCL_IO
 
-	CHECKCUDA(cudaMalloc((void**)&cudaStates, cloud->size() * sizeof(curandState)));
+	const unsigned int pointsNum = PointCloudDevice.ArraySize();
+	DenseSurfel.ResizeArrayOrException(pointsNum);
+	if (gpuNormalEstimation) {
+		// 法线直接在显存中估计，省去Host端kd-tree和往返拷贝
+		PointNormalsPtr->EstimateNormals(PointCloudDevice.ArrayView(), PointNormalDevice, 10, MeshStream[0]);
+		CHECKCUDA(cudaStreamSynchronize(MeshStream[0]));
+	}
+	else {
+		PointNormalDevice.ResizeArrayOrException(normals->size());
+		CHECKCUDA(cudaMemcpy(PointNormalDevice.Array().ptr(), normals->data(), sizeof(pcl::Normal) * pointsNum, cudaMemcpyHostToDevice));
+	}
 
-	printf("点云数量 = %zu   法线数量 = %zu\n", cloud->size(), normals->size());
+	printf("点云数量 = %u   法线数量 = %zu\n", pointsNum, PointNormalDevice.ArraySize());
 	std::cout << std::endl;
 	std::cout << "-----------------------------------------------------" << std::endl;	// 输出
 	std::cout << std::endl;
 
-	const unsigned int pointsNum = cloud->size();
-	PointCloudDevice.ResizeArrayOrException(cloud->size());
-	PointNormalDevice.ResizeArrayOrException(normals->size());
-	DenseSurfel.ResizeArrayOrException(pointsNum);
-	CHECKCUDA(cudaMemcpy(PointCloudDevice.Array().ptr(), cloud->data(), sizeof(pcl::PointXYZ) * pointsNum, cudaMemcpyHostToDevice));
-	CHECKCUDA(cudaMemcpy(PointNormalDevice.Array().ptr(), normals->data(), sizeof(pcl::Normal) * pointsNum, cudaMemcpyHostToDevice));
-	buildDenseSurfel(PointCloudDevice, PointNormalDevice, DenseSurfel);
+	buildDenseSurfel(PointCloudDevice, PointNormalDevice, DenseSurfel, PointCloudColor.ArrayView());
 	CHECKCUDA(cudaDeviceSynchronize());
 
 	//// 创建 PCL 可视化对象
@@ -116,6 +262,7 @@ void SparseSurfelFusion::PoissonReconstruction::readPCDFile(std::string path)
 	
 }
 
+#if RECONSTRUCTION_WITH_PCL_IO
 void SparseSurfelFusion::PoissonReconstruction::readPLYFile(std::string path)
 {
 	// 创建PCL可视化对象
@@ -184,6 +331,7 @@ void SparseSurfelFusion::PoissonReconstruction::CalculatePointCloudNormal(pcl::P
 	//}
 
 }
+#endif // RECONSTRUCTION_WITH_PCL_IO
 
 
 
@@ -192,73 +340,351 @@ SparseSurfelFusion::DeviceArrayView<SparseSurfelFusion::DepthSurfel> SparseSurfe
 	return DenseSurfel.ArrayView();
 }
 
-void SparseSurfelFusion::PoissonReconstruction::SolvePoissionReconstructionMesh(DeviceArrayView<DepthSurfel> denseSurfel)
+void SparseSurfelFusion::PoissonReconstruction::SolvePoissionReconstructionMesh(DeviceArrayView<DepthSurfel> denseSurfel, cudaEvent_t inputReady, cudaEvent_t inputConsumed)
 {
 
+	CHECKCUDA(cudaSetDevice(config.deviceId));	// 允许从任意线程调用
 	const unsigned int DenseSurfelCount = denseSurfel.Size();
-	OctreePtr->BuildNodesArray(denseSurfel, cloud, normals, MeshStream[0]);						// 构建Octree
+	if (DenseSurfelCount > config.maxSurfelCount) LOGGING(FATAL) << "稠密面元数量 " << DenseSurfelCount << " 超出ReconstructionConfig::maxSurfelCount = " << config.maxSurfelCount;
+	// 流水线绘制的上一帧仍可能在读取八叉树与网格，所有阶段都在MeshStream[0]构建八叉树之后，只需让它等待
+#if RECONSTRUCTION_WITH_RENDER
+	if (renderInputPending) {
+		CHECKCUDA(cudaStreamWaitEvent(MeshStream[0], RenderInputReleasedEvent, 0));
+		renderInputPending = false;
+	}
+	if (zeroCopyRender && DrawConstructedMesh != nullptr) {
+		TriangleIndicesPtr->SetOutputSink(DrawConstructedMesh->MapOutputSink(MeshStream[0]));	// 网格在MeshStream[0]上的映射之后写入
+	}
+#endif // RECONSTRUCTION_WITH_RENDER
+	// 每个阶段声明读写的资源，调度器在流之间连接事件依赖：编码 || 向量场 || 顶点边面去重，顶点边面生成 || 散度 || 求解
+	MeshScheduler->BeginFrame();
+	ProfilerPtr->BeginFrame();
+	StageProfiler* profiler = ProfilerPtr.get();
+	MeshScheduler->Run(0, {}, { OctreeResource }, [&](cudaStream_t stream) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::Octree);
+		StageProfiler::Scope stage(profiler, "octree", stream);
+		OctreePtr->BuildNodesArray(denseSurfel, cloud, normals, stream, inputReady, inputConsumed);	// 构建Octree
+	});
 	DeviceArrayView<OrientedPoint3D<float>> orientedPoints = OctreePtr->GetOrientedPoints();	// 获得有向点云
 	DeviceArrayView<OctNode> OctreeNodeArray = OctreePtr->GetOctreeNodeArray();					// 获得八叉树的NodeArray
+	OctNodeTopologyView OctreeTopology = OctreePtr->GetOctreeTopologyView();					// 获得八叉树拓扑的SoA视图
 	const int* NodeArrayCount = OctreePtr->GetNodeArrayCount();									// 获得每一层节点的数量，是一个maxDepth大小的数组
 	const int* BaseAddressArray = OctreePtr->GetBaseAddressArray();								// 获得每层节点在数组中的偏移(每层第一个节点在数组中的位置)
-	DeviceArrayView<int> BaseAddressArrayDevice = OctreePtr->GetBaseAddressArrayDevice();
-	// 计算节点编码、构建VectorField、生成顶点Array同时进行
-	OctreePtr->ComputeEncodedFunctionNodeIndex(MeshStream[0]);									// 计算节点基函数索引
-	VectorFieldPtr->BuildVectorField(orientedPoints, OctreeNodeArray, NodeArrayCount, BaseAddressArray, MeshStream[1]);	// 构建VectorField
-	CHECKCUDA(cudaDeviceSynchronize());	// 所有算法完成，同步整个GPU，VectorFieldPtr中的一些参数后面需要调用
 	DeviceArrayView<unsigned int> NodeArrayDepthIndex = OctreePtr->GetNodeArrayDepthIndex();
 	DeviceArrayView<Point3D<float>> NodeArrayNodeCenter = OctreePtr->GetNodeArrayNodeCenter();
 	DeviceBufferArray<OctNode>& OctreeNodeArrayHandle = OctreePtr->GetOctreeNodeArrayHandle();
-	//pool->AddTask([&]() { MeshGeometryPtr->GenerateVertexArray(OctreeNodeArrayHandle, NodeArrayDepthIndex, NodeArrayNodeCenter, MeshStream[2]); });
-	//pool->AddTask([&]() { MeshGeometryPtr->GenerateEdgeArray(OctreeNodeArrayHandle, BaseAddressArray[Constants::maxDepth_Host], NodeArrayCount[Constants::maxDepth_Host], NodeArrayDepthIndex, NodeArrayNodeCenter, MeshStream[3]); });
-	//pool->AddTask([&]() { MeshGeometryPtr->GenerateFaceArray(OctreeNodeArrayHandle, NodeArrayDepthIndex, NodeArrayNodeCenter, MeshStream[4]); });
-	MeshGeometryPtr->GenerateVertexArray(OctreeNodeArrayHandle, NodeArrayDepthIndex, NodeArrayNodeCenter, MeshStream[2]);
-	MeshGeometryPtr->GenerateEdgeArray(OctreeNodeArrayHandle, BaseAddressArray[Constants::maxDepth_Host], NodeArrayCount[Constants::maxDepth_Host], NodeArrayDepthIndex, NodeArrayNodeCenter, MeshStream[3]);
-	MeshGeometryPtr->GenerateFaceArray(OctreeNodeArrayHandle, NodeArrayDepthIndex, NodeArrayNodeCenter, MeshStream[4]);
-
-	DeviceArrayView<int> encodeNodeIndexInFunction = OctreePtr->GetEncodedFunctionNodeIndex();
+
+	MeshScheduler->Run(0, { OctreeResource }, { EncodedFunctionResource }, [&](cudaStream_t stream) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::Octree);
+		StageProfiler::Scope stage(profiler, "encoded_function", stream);
+		OctreePtr->ComputeEncodedFunctionNodeIndex(stream);										// 计算节点基函数索引
+	});
+	MeshScheduler->Run(1, { OctreeResource }, { VectorFieldResource }, [&](cudaStream_t stream) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::VectorField);
+		StageProfiler::Scope stage(profiler, "vector_field", stream);
+		VectorFieldPtr->BuildVectorField(orientedPoints, OctreePtr->GetPoint2NodeArray(), OctreeNodeArray, NodeArrayCount, BaseAddressArray, stream);	// 构建VectorField
+	});
+	// 顶点、边、面在MeshGeometryPtr自己的三条流上去重，只读NodeArray，结果写入独立的节点表，CommitNodeElementIndex时汇合
+	MeshScheduler->Run(2, { OctreeResource }, {}, [&](cudaStream_t stream) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::Geometry);
+		StageProfiler::Scope stage(profiler, "mesh_geometry", stream);	// 只包含提交，三条去重流上的工作不在此流上
+		MeshGeometryPtr->BeginGenerate(OctreeNodeArray, BaseAddressArray[Constants::maxDepth_Host], NodeArrayCount[Constants::maxDepth_Host], NodeArrayDepthIndex, NodeArrayNodeCenter, stream);
+	});
+
+	DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction = OctreePtr->GetEncodedFunctionNodeIndex();
 	DeviceArrayView<Point3D<float>> vectorField = VectorFieldPtr->GetVectorField();
-	DeviceArrayView<double> dot_F_dF = VectorFieldPtr->GetValueTable_Dot_F_dF();
-	DeviceArrayView<double> dot_F_F = VectorFieldPtr->GetValueTable_Dot_F_F();
-	DeviceArrayView<double> dot_F_d2F = VectorFieldPtr->GetValueTable_Dot_F_d2F();
+	const InnerProductTableView& innerProduct = VectorFieldPtr->GetInnerProductTable();
 	DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions = VectorFieldPtr->GetBaseFunction();
-	//pool->AddTask([=]() { NodeDivergencePtr->CalculateNodesDivergence(BaseAddressArray, NodeArrayCount, BaseAddressArrayDevice, encodeNodeIndexInFunction, OctreeNodeArray, vectorField, dot_F_dF, MeshStream[0], MeshStream[1]); });
-	NodeDivergencePtr->CalculateNodesDivergence(BaseAddressArray, NodeArrayCount, BaseAddressArrayDevice, encodeNodeIndexInFunction, OctreeNodeArray, vectorField, dot_F_dF, MeshStream[0], MeshStream[1]);
-	CHECKCUDA(cudaDeviceSynchronize());	// 所有算法完成，同步整个GPU，此处需要同步，因为后面需要调用dot_F_dF、dot_F_F、dot_F_d2F、DivergencePtr
+	MeshScheduler->Run(0, { OctreeResource, EncodedFunctionResource, VectorFieldResource }, { DivergenceResource }, [&](cudaStream_t stream) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::Divergence);
+		StageProfiler::Scope stage(profiler, "divergence", stream);
+		NodeDivergencePtr->CalculateNodesDivergence(BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, OctreeNodeArray, vectorField, innerProduct, stream);	// 所有层一次启动，不需要Host端同步
+	});
+	MeshGeometryPtr->FinishGenerate(OctreeNodeArray, NodeArrayDepthIndex, NodeArrayNodeCenter);	// Host只在此处等待三个去重数量
 	float* DivergencePtr = NodeDivergencePtr->GetDivergenceRawPtr();
 	DeviceArrayView<int> Point2NodeArray = OctreePtr->GetPoint2NodeArray();
 
-	//pool->AddTask([&]() { LaplacianSolverPtr->LaplacianCGSolver(BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, OctreeNodeArray, DivergencePtr, dot_F_F, dot_F_d2F, MeshStream[0]); });
-	//pool->AddTask([&]() { LaplacianSolverPtr->CalculatePointsImplicitFunctionValue(orientedPoints, Point2NodeArray, OctreeNodeArray, encodeNodeIndexInFunction, baseFunctions, BaseAddressArray[Constants::maxDepth_Host], DenseSurfelCount, MeshStream[0]); });
-	LaplacianSolverPtr->LaplacianCGSolver(BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, OctreeNodeArray, DivergencePtr, dot_F_F, dot_F_d2F, MeshStream[0]);
-	LaplacianSolverPtr->CalculatePointsImplicitFunctionValue(orientedPoints, Point2NodeArray, OctreeNodeArray, encodeNodeIndexInFunction, baseFunctions, BaseAddressArray[Constants::maxDepth_Host], DenseSurfelCount, MeshStream[0]);
-	CHECKCUDA(cudaDeviceSynchronize());	// 所有算法完成，同步整个GPU
+	MeshScheduler->Run(0, { OctreeResource, EncodedFunctionResource, DivergenceResource }, { ImplicitFunctionResource }, [&](cudaStream_t stream) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::Solver);
+		const int screeningStage = profiler->Begin("screening", stream);
+		LaplacianSolverPtr->PrepareScreeningSamples(orientedPoints, Point2NodeArray, BaseAddressArray, NodeArrayCount, OctreeTopology, encodeNodeIndexInFunction, baseFunctions, stream);	// 未开启屏蔽泊松时直接返回
+		profiler->End(screeningStage, stream);
+		LaplacianSolverPtr->LaplacianCGSolver(BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, OctreeTopology, DivergencePtr, innerProduct, MeshStream, MAX_MESH_STREAM);	// 各层从MeshStream[0]派生并发求解，结束时MeshStream[0]等待全部层
+		if (previewDepth >= 0) {
+			// 预览流只等待预览层及更粗层的求解，粗糙网格的提取与细层求解并行
+			LaplacianSolverPtr->WaitPreviewDepthSolved(PreviewStream);
+			TriangleIndicesPtr->ExtractPreviewMesh(orientedPoints, Point2NodeArray, OctreeTopology, NodeArrayNodeCenter, baseFunctions, LaplacianSolverPtr->GetDx(), encodeNodeIndexInFunction, BaseAddressArray[Constants::maxDepth_Host], BaseAddressArray[previewDepth], NodeArrayCount[previewDepth], previewDepth, PreviewStream);
+		}
+		StageProfiler::Scope stage(profiler, "iso_value", stream);
+		LaplacianSolverPtr->CalculatePointsImplicitFunctionValue(orientedPoints, Point2NodeArray, OctreeTopology, encodeNodeIndexInFunction, baseFunctions, BaseAddressArray[Constants::maxDepth_Host], DenseSurfelCount, stream);	// 等值需要读回Host
+	});
+	// 顶点、边、面的index写回NodeArray，八叉树同样是本阶段的输出，之后读八叉树的阶段排在它之后
+	MeshScheduler->Run(0, {}, { OctreeResource, MeshGeometryResource }, [&](cudaStream_t stream) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::Geometry);
+		StageProfiler::Scope stage(profiler, "commit_geometry", stream);
+		MeshGeometryPtr->CommitNodeElementIndex(OctreeNodeArrayHandle, stream);				// 通过事件等待顶点、边、面生成完毕，再写回NodeArray
+	});
 
 	DeviceArrayView<VertexNode> vertexArray = MeshGeometryPtr->GetVertexArray();
 	DeviceArrayView<EdgeNode> edgeArray = MeshGeometryPtr->GetEdgeArray();
 	DeviceArrayView<FaceNode> faceArray = MeshGeometryPtr->GetFaceArray();
 	DeviceArrayView<float> dx = LaplacianSolverPtr->GetDx();
 	const float isoValue = LaplacianSolverPtr->GetIsoValue();
-	TriangleIndicesPtr->calculateTriangleIndices(vertexArray, edgeArray, faceArray, OctreeNodeArrayHandle, baseFunctions, dx, encodeNodeIndexInFunction, NodeArrayDepthIndex, NodeArrayNodeCenter, isoValue, BaseAddressArray[Constants::maxDepth_Host], NodeArrayCount[Constants::maxDepth_Host], MeshStream[0]);
+	TriangleIndicesPtr->SetRegionsOfInterest(normalizedRegionsOfInterest());	// 等值已读回Host，归一化变换早已就绪
+	MeshScheduler->Run(0, { OctreeResource, EncodedFunctionResource, ImplicitFunctionResource, MeshGeometryResource }, {}, [&](cudaStream_t stream) {
+		MemoryPoolTagScope memoryTag(MemoryPoolTag::Triangulation);
+		ImplicitQueryPtr->Bind(OctreeTopology, baseFunctions, dx, encodeNodeIndexInFunction, isoValue, stream);	// 首帧在此构建基函数值表，之后只记录视图
+		TriangleIndicesPtr->calculateTriangleIndices(vertexArray, edgeArray, faceArray, OctreeNodeArrayHandle, OctreeTopology, baseFunctions, dx, encodeNodeIndexInFunction, NodeArrayDepthIndex, NodeArrayNodeCenter, isoValue, BaseAddressArray[Constants::maxDepth_Host], NodeArrayCount[Constants::maxDepth_Host], stream);
+	});
+
+	MeshScheduler->Synchronize();	// 网格读回前同步本实例的所有流(不同步整个GPU，以便多个实例并发)
+	if (PreviewStream != NULL) CHECKCUDA(cudaStreamSynchronize(PreviewStream));	// 预览通常早已发布，下一帧会覆盖其读取的八叉树与解
+}
 
-	CHECKCUDA(cudaDeviceSynchronize());	// 所有算法完成，同步整个GPU
+bool SparseSurfelFusion::PoissonReconstruction::SolveNextIngestedFrame(SurfelIngestQueue& ingest)
+{
+	IngestFrame frame;
+	if (!ingest.AcquireFrame(frame)) return false;
+	SolvePoissionReconstructionMesh(frame.surfels, frame.uploaded, frame.consumed);
+	ingest.ReleaseFrame(frame);		// consumed已在八叉树构建时入队，槽位的下一次上传在GPU上等待它
+	return true;
 }
 
+void SparseSurfelFusion::PoissonReconstruction::SolveTiledReconstructionMesh(const std::vector<DepthSurfel>& surfels, std::vector<Point3D<float>>& meshVertices, std::vector<TriangleIndex>& meshTriangles, const float overlapRatio)
+{
+	meshVertices.clear();
+	meshTriangles.clear();
+	if (surfels.empty()) return;
+
+	std::vector<ReconstructionTile> tiles;
+	PartitionReconstructionTiles(surfels, overlapRatio, tiles);
+	SolveReconstructionTiles(surfels, tiles, meshVertices, meshTriangles);
+}
 
+void SparseSurfelFusion::PoissonReconstruction::SolveReconstructionTiles(const std::vector<DepthSurfel>& surfels, const std::vector<ReconstructionTile>& tiles, std::vector<Point3D<float>>& meshVertices, std::vector<TriangleIndex>& meshTriangles)
+{
+	if (tiles.empty()) return;
+	CHECKCUDA(cudaSetDevice(config.deviceId));	// 允许从任意线程调用
+
+	// 双缓冲按容量开辟一次，后续分块重建复用
+	if (TileUploadStream == NULL) {
+		CHECKCUDA(cudaStreamCreate(&TileUploadStream));
+		for (int i = 0; i < 2; i++) {
+			MemoryPoolTagScope memoryTag(MemoryPoolTag::Input);
+			TileSurfel[i].AllocateBuffer(config.maxSurfelCount);
+			CHECKCUDA(cudaMallocHost((void**)&TileSurfelHost[i], sizeof(DepthSurfel) * config.maxSurfelCount));
+			CHECKCUDA(cudaEventCreateWithFlags(&TileUploadEvent[i], cudaEventDisableTiming));
+		}
+	}
+
+	uploadReconstructionTile(surfels, tiles[0], 0);
+	for (int i = 0; i < tiles.size(); i++) {
+		const int slot = i & 1;
+		// 上一块已经计算完毕，另一个槽位空闲，先发起下一块的上传与当前块的计算重叠
+		if (i + 1 < tiles.size()) uploadReconstructionTile(surfels, tiles[i + 1], slot ^ 1);
+		CHECKCUDA(cudaEventSynchronize(TileUploadEvent[slot]));
+		SolvePoissionReconstructionMesh(TileSurfel[slot].ArrayView());
+		appendTileMesh(tiles[i], meshVertices, meshTriangles);
+	}
+	CHECKCUDA(cudaStreamSynchronize(TileUploadStream));
+}
+
+void SparseSurfelFusion::PoissonReconstruction::PartitionReconstructionTiles(const std::vector<DepthSurfel>& surfels, const float overlapRatio, std::vector<ReconstructionTile>& tiles)
+{
+	tiles.clear();
+	ReconstructionTile root;
+	root.coreMin = Point3D<float>(float(1e30), float(1e30), float(1e30));
+	root.coreMax = Point3D<float>(float(-1e30), float(-1e30), float(-1e30));
+	for (const DepthSurfel& surfel : surfels) {
+		const float coor[3] = { surfel.VertexAndConfidence.x, surfel.VertexAndConfidence.y, surfel.VertexAndConfidence.z };
+		for (int k = 0; k < DIMENSION; k++) {
+			root.coreMin.coords[k] = std::min(root.coreMin.coords[k], coor[k]);
+			root.coreMax.coords[k] = std::max(root.coreMax.coords[k], coor[k]);
+		}
+	}
+	float rootEdge = 0.0f;
+	for (int k = 0; k < DIMENSION; k++) rootEdge = std::max(rootEdge, root.coreMax.coords[k] - root.coreMin.coords[k]);
+	for (int k = 0; k < DIMENSION; k++) root.coreMax.coords[k] += 1e-5f * rootEdge + 1e-6f;	// 核心区域右边界开区间，最大点也要落在根块内
+	root.indices.resize(surfels.size());
+	for (unsigned int i = 0; i < surfels.size(); i++) root.indices[i] = i;
+
+	std::vector<ReconstructionTile> stack;
+	stack.push_back(std::move(root));
+	while (!stack.empty()) {
+		ReconstructionTile tile = std::move(stack.back());
+		stack.pop_back();
+		int splitAxis = 0;
+		float longestEdge = 0.0f;
+		for (int k = 0; k < DIMENSION; k++) {
+			const float edge = tile.coreMax.coords[k] - tile.coreMin.coords[k];
+			if (edge > longestEdge) { longestEdge = edge; splitAxis = k; }
+		}
+		// 子块的扩展区域一定包含在父块扩展区域内，因此只需在父块候选中筛选
+		const float margin = overlapRatio * longestEdge;
+		std::vector<unsigned int> expanded;
+		expanded.reserve(tile.indices.size());
+		bool hasCorePoint = false;
+		for (const unsigned int index : tile.indices) {
+			const float coor[3] = { surfels[index].VertexAndConfidence.x, surfels[index].VertexAndConfidence.y, surfels[index].VertexAndConfidence.z };
+			bool inExpanded = true, inCore = true;
+			for (int k = 0; k < DIMENSION; k++) {
+				if (coor[k] < tile.coreMin.coords[k] - margin || coor[k] >= tile.coreMax.coords[k] + margin) inExpanded = false;
+				if (coor[k] < tile.coreMin.coords[k] || coor[k] >= tile.coreMax.coords[k]) inCore = false;
+			}
+			if (inExpanded) expanded.push_back(index);
+			hasCorePoint |= inCore;
+		}
+		if (!hasCorePoint) continue;	// 核心区域内没有点，不会贡献三角形
+		if (expanded.size() <= config.maxSurfelCount) {
+			tile.indices = std::move(expanded);
+			tiles.push_back(std::move(tile));
+			continue;
+		}
+		if (longestEdge < 1e-6f * rootEdge) LOGGING(FATAL) << "分块重建无法继续划分：过多面元(" << expanded.size() << ")集中在同一位置";
+		ReconstructionTile left, right;
+		left.coreMin = tile.coreMin;
+		left.coreMax = tile.coreMax;
+		right.coreMin = tile.coreMin;
+		right.coreMax = tile.coreMax;
+		const float middle = 0.5f * (tile.coreMin.coords[splitAxis] + tile.coreMax.coords[splitAxis]);
+		left.coreMax.coords[splitAxis] = middle;
+		right.coreMin.coords[splitAxis] = middle;
+		right.indices = expanded;
+		left.indices = std::move(expanded);
+		stack.push_back(std::move(right));
+		stack.push_back(std::move(left));
+	}
+}
+
+void SparseSurfelFusion::PoissonReconstruction::uploadReconstructionTile(const std::vector<DepthSurfel>& surfels, const ReconstructionTile& tile, const int slot)
+{
+	const unsigned int count = tile.indices.size();
+	for (unsigned int i = 0; i < count; i++) TileSurfelHost[slot][i] = surfels[tile.indices[i]];
+	TileSurfel[slot].ResizeArrayOrException(count);
+	CHECKCUDA(cudaMemcpyAsync(TileSurfel[slot].Array().ptr(), TileSurfelHost[slot], sizeof(DepthSurfel) * count, cudaMemcpyHostToDevice, TileUploadStream));
+	CHECKCUDA(cudaEventRecord(TileUploadEvent[slot], TileUploadStream));
+}
+
+void SparseSurfelFusion::PoissonReconstruction::appendTileMesh(const ReconstructionTile& tile, std::vector<Point3D<float>>& meshVertices, std::vector<TriangleIndex>& meshTriangles)
+{
+	std::vector<Point3D<float>> tileVertices;
+	std::vector<TriangleIndex> tileTriangles;
+	TriangleIndicesPtr->GetRebuildMeshVertices().Download(tileVertices);
+	TriangleIndicesPtr->GetRebuildMeshTriangleIndices().Download(tileTriangles);
+
+	// 块内顶点是归一化坐标，变换回原始坐标系
+	const Point3D<float> center = OctreePtr->GetNormalizeCenter();
+	const float maxEdge = OctreePtr->GetNormalizeMaxEdge();
+	for (Point3D<float>& vertex : tileVertices) {
+		for (int k = 0; k < DIMENSION; k++) vertex.coords[k] = vertex.coords[k] * maxEdge + center.coords[k];
+	}
+
+	// 重叠区域由相邻块重复重建，仅保留重心落在核心区域的三角形，使每个位置只被一个块输出
+	std::vector<int> vertexRemap(tileVertices.size(), -1);
+	for (const TriangleIndex& triangle : tileTriangles) {
+		bool inCore = true;
+		for (int k = 0; k < DIMENSION; k++) {
+			const float centroid = (tileVertices[triangle.idx[0]].coords[k] + tileVertices[triangle.idx[1]].coords[k] + tileVertices[triangle.idx[2]].coords[k]) / 3.0f;
+			if (centroid < tile.coreMin.coords[k] || centroid >= tile.coreMax.coords[k]) { inCore = false; break; }
+		}
+		if (!inCore) continue;
+		TriangleIndex stitched;
+		for (int j = 0; j < 3; j++) {
+			const int vertexIndex = triangle.idx[j];
+			if (vertexRemap[vertexIndex] < 0) {
+				vertexRemap[vertexIndex] = meshVertices.size();
+				meshVertices.push_back(tileVertices[vertexIndex]);
+			}
+			stitched.idx[j] = vertexRemap[vertexIndex];
+		}
+		meshTriangles.push_back(stitched);
+	}
+}
+
+
+#if RECONSTRUCTION_WITH_RENDER
 void SparseSurfelFusion::PoissonReconstruction::DrawRebuildMesh()
 {
+	if (DrawConstructedMesh == nullptr) LOGGING(FATAL) << "ReconstructionConfig::enableRender为false，无法绘制网格";
+	CHECKCUDA(cudaSetDevice(config.deviceId));
 	DeviceArrayView<Point3D<float>> MeshVertices = TriangleIndicesPtr->GetRebuildMeshVertices();
 	DeviceArrayView<TriangleIndex> MeshTriangleIndices = TriangleIndicesPtr->GetRebuildMeshTriangleIndices();
 	DeviceArrayView<OrientedPoint3D<float>> SampleDensePoints = OctreePtr->GetOrientedPoints();
 	DrawConstructedMesh->setInput(MeshVertices, MeshTriangleIndices, SampleDensePoints);
-	DrawConstructedMesh->CalculateMeshVerticesColor(SampleDensePoints, MeshVertices, MeshStream[0]); // 并行进行
-	DrawConstructedMesh->CalculateMeshNormals(MeshVertices, MeshTriangleIndices, MeshStream[1]);	 // 并行进行
-	CHECKCUDA(cudaStreamSynchronize(MeshStream[0]));	 // 两个流同步
-	CHECKCUDA(cudaStreamSynchronize(MeshStream[1]));	 // 两个流同步
-	DrawConstructedMesh->DrawRenderedMesh(MeshStream[0]);
+	const int shadingStage = ProfilerPtr->Begin("mesh_shading", MeshStream[0]);
+	DrawConstructedMesh->CalculateMeshNormalsAndColors(SampleDensePoints, MeshVertices, MeshTriangleIndices, TriangleIndicesPtr->GetVertexTriangleOffset(), TriangleIndicesPtr->GetVertexTriangleList(), OctreePtr->GetOctreeNodeArray(), OctreePtr->GetBaseAddressArrayDevice(), OctreePtr->GetBaseAddressArray()[Constants::maxDepth_Host], MeshStream[0]);
+	ProfilerPtr->End(shadingStage, MeshStream[0]);
+	{
+		StageProfiler::Scope stage(ProfilerPtr.get(), "draw", MeshStream[0]);	// 计时只包含CUDA侧的上传，OpenGL绘制本身只有NVTX区间
+		TriangleIndicesPtr->DetachOutputSink(MeshStream[0]);	// 解除映射后VBO/IBO不可再读，获取网格与导出改读内部缓冲
+		DrawConstructedMesh->DrawRenderedMesh(MeshStream[0]);
+	}
 	CHECKCUDA(cudaDeviceSynchronize());
 }
 
+void SparseSurfelFusion::PoissonReconstruction::DrawRebuildMeshPipelined()
+{
+	if (DrawConstructedMesh == nullptr) LOGGING(FATAL) << "ReconstructionConfig::enableRender为false，无法绘制网格";
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	DeviceArrayView<Point3D<float>> MeshVertices = TriangleIndicesPtr->GetRebuildMeshVertices();
+	DeviceArrayView<TriangleIndex> MeshTriangleIndices = TriangleIndicesPtr->GetRebuildMeshTriangleIndices();
+	DeviceArrayView<OrientedPoint3D<float>> SampleDensePoints = OctreePtr->GetOrientedPoints();
+
+	// SolvePoissionReconstructionMesh返回时网格已完成，RenderStream不需要等待MeshStream
+	DrawConstructedMesh->setInput(MeshVertices, MeshTriangleIndices, SampleDensePoints);
+	const int shadingStage = ProfilerPtr->Begin("mesh_shading", RenderStream);
+	DrawConstructedMesh->CalculateMeshNormalsAndColors(SampleDensePoints, MeshVertices, MeshTriangleIndices, TriangleIndicesPtr->GetVertexTriangleOffset(), TriangleIndicesPtr->GetVertexTriangleList(), OctreePtr->GetOctreeNodeArray(), OctreePtr->GetBaseAddressArrayDevice(), OctreePtr->GetBaseAddressArray()[Constants::maxDepth_Host], RenderStream);	// 网格先拷贝到写槽位
+	ProfilerPtr->End(shadingStage, RenderStream);
+	TriangleIndicesPtr->DetachOutputSink(RenderStream);		// 解除映射后VBO/IBO不可再读，获取网格与导出改读内部缓冲
+	CHECKCUDA(cudaEventRecord(RenderInputReleasedEvent, RenderStream));
+	renderInputPending = true;
+	const int uploadStage = ProfilerPtr->Begin("draw", RenderStream);	// 计时只包含CUDA侧的上传，OpenGL绘制本身只有NVTX区间
+	DrawConstructedMesh->UploadRenderedMesh(RenderStream);	// 只读写槽位，与下一帧重建重叠
+	ProfilerPtr->End(uploadStage, RenderStream);
+
+	// 上一帧的槽位在上一次调用时已上传，OpenGL按解除映射的顺序等待拷贝，Host不需要同步
+	const int writeSlot = DrawConstructedMesh->SwapWriteSlot();
+	const int drawSlot = DrawConstructedMesh->GetWriteSlot();
+	if (DrawConstructedMesh->IsSlotUploaded(drawSlot)) DrawConstructedMesh->DrawSlotMesh(drawSlot);
+	else DrawConstructedMesh->DrawSlotMesh(writeSlot);		// 第一帧没有上一帧可绘制
+}
+#endif // RECONSTRUCTION_WITH_RENDER
+
+std::shared_future<bool> SparseSurfelFusion::PoissonReconstruction::ExportRebuildMesh(const std::string& path, const MeshFileFormat format)
+{
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	MeshExportInput mesh;
+	mesh.vertices = GetRebuildMeshVertices();
+	mesh.triangles = GetRebuildMeshTriangleIndices();
+	mesh.center = GetNormalizeCenter();
+	mesh.scale = GetNormalizeMaxEdge();
+	return MeshExporterPtr->ExportAsync(path, mesh, format, MeshStream[0]);
+}
+
+void SparseSurfelFusion::PoissonReconstruction::ResolveProfile()
+{
+	if (!ProfilerPtr->IsEnabled()) return;
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+	std::vector<int> iterations;
+	std::vector<double> residuals;
+	LaplacianSolverPtr->GetCGIterations(iterations);
+	LaplacianSolverPtr->GetCGResiduals(residuals);
+	for (int depth = 0; depth < (int)iterations.size(); depth++) {
+		ProfilerPtr->RecordMetric("cg_iterations", depth, iterations[depth]);
+		ProfilerPtr->RecordMetric("cg_residual", depth, sqrt(residuals[depth]));
+	}
+	ProfilerPtr->RecordMetric("solver_workspace_high_water_mb", -1, LaplacianSolverPtr->GetWorkspaceHighWaterMark() / (1024.0 * 1024.0));
+	const MemoryPoolStatistics memory = GetMemoryPoolStatistics();
+	ProfilerPtr->RecordMetric("pool_current_mb", -1, memory.currentBytes / (1024.0 * 1024.0));
+	ProfilerPtr->RecordMetric("pool_peak_mb", -1, memory.peakBytes / (1024.0 * 1024.0));
+	ProfilerPtr->RecordMetric("pool_reserved_mb", -1, memory.reservedBytes / (1024.0 * 1024.0));
+	for (int tag = 0; tag < (int)MemoryPoolTag::TagNum; tag++) {
+		ProfilerPtr->RecordMetric((std::string("pool_") + MemoryPoolTagName((MemoryPoolTag)tag) + "_peak_mb").c_str(), -1, memory.tagPeakBytes[tag] / (1024.0 * 1024.0));
+	}
+	ProfilerPtr->Resolve();
+}
+
+#if RECONSTRUCTION_WITH_PCL_IO
 void SparseSurfelFusion::PoissonReconstruction::saveCloudWithNormal(pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals)
 {
 	// 创建带有法线的点云
@@ -284,4 +710,5 @@ void SparseSurfelFusion::PoissonReconstruction::saveCloudWithNormal(pcl::PointCl
 	writer.write(PlySavePath, *cloud_with_normals, false); // true 表示二进制模式
 
 	std::cout << "保存点云法线ply文件" << std::endl;
-}
\ No newline at end of file
+}
+#endif // RECONSTRUCTION_WITH_PCL_IO
@@ -7,7 +7,17 @@
  *********************************************************************/
 #include "PoissonReconstruction.h"
 
-__global__ void SparseSurfelFusion::device::buildDenseSurfelKernel(pcl::PointXYZ* coor, DepthSurfel* surfel, const unsigned int pointsNum)
+#define DENSE_SURFEL_RANDOM_SEED 1234		// 生成随机颜色的种子，与原curand_init(1234, ...)保持一致
+
+__device__ __forceinline__ float4 SparseSurfelFusion::device::statelessUniform4(const unsigned int idx, const unsigned int seed)
+{
+	// Philox是计数器型随机数：同一(计数器, 密钥)总得到同一结果，不需要为每个点开辟并初始化curandState
+	const uint4 bits = curand_Philox4x32_10(make_uint4(idx, 0, 0, 0), make_uint2(seed, 0));
+	// 与curand_uniform相同的映射：32位整数映射到(0, 1]
+	return make_float4(bits.x * CURAND_2POW32_INV + (CURAND_2POW32_INV / 2.0f), bits.y * CURAND_2POW32_INV + (CURAND_2POW32_INV / 2.0f), bits.z * CURAND_2POW32_INV + (CURAND_2POW32_INV / 2.0f), bits.w * CURAND_2POW32_INV + (CURAND_2POW32_INV / 2.0f));
+}
+
+__global__ void SparseSurfelFusion::device::buildDenseSurfelKernel(pcl::PointXYZ* coor, const float3* color, DepthSurfel* surfel, const unsigned int seed, const unsigned int pointsNum)
 {
 	unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
 	if (idx >= pointsNum) return;
@@ -15,9 +25,13 @@ __global__ void SparseSurfelFusion::device::buildDenseSurfelKernel(pcl::PointXYZ
 	surfel[idx].VertexAndConfidence.y = coor[idx].y;
 	surfel[idx].VertexAndConfidence.z = coor[idx].z;
 	surfel[idx].VertexAndConfidence.w = 0;
+
+	const float4 random = statelessUniform4(idx, seed);
+	if (color != NULL) surfel[idx].ColorAndTime = make_float4(color[idx].x, color[idx].y, color[idx].z, random.w);
+	else surfel[idx].ColorAndTime = random;
 }
 
-__global__ void SparseSurfelFusion::device::buildOrientedDenseSurfelKernel(pcl::PointXYZ* coor, pcl::Normal* normal, DepthSurfel* surfel, curandState* cudaStates, const unsigned int pointsNum)
+__global__ void SparseSurfelFusion::device::buildOrientedDenseSurfelKernel(pcl::PointXYZ* coor, pcl::Normal* normal, const float3* color, DepthSurfel* surfel, const unsigned int seed, const unsigned int pointsNum)
 {
 	unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
 	if (idx >= pointsNum) return;
@@ -31,26 +45,26 @@ __global__ void SparseSurfelFusion::device::buildOrientedDenseSurfelKernel(pcl::
 	surfel[idx].NormalAndRadius.z = normal[idx].normal_z;
 	surfel[idx].NormalAndRadius.w = normal[idx].curvature;
 
-	// 初始化CURAND状态
-	curand_init(1234, idx, 0, &cudaStates[idx]);
-	surfel[idx].ColorAndTime.x = curand_uniform(&cudaStates[idx]);
-	surfel[idx].ColorAndTime.y = curand_uniform(&cudaStates[idx]);
-	surfel[idx].ColorAndTime.z = curand_uniform(&cudaStates[idx]);
-	surfel[idx].ColorAndTime.w = curand_uniform(&cudaStates[idx]);
+	// 有真实颜色时直接使用，否则取随机颜色
+	const float4 random = statelessUniform4(idx, seed);
+	if (color != NULL) surfel[idx].ColorAndTime = make_float4(color[idx].x, color[idx].y, color[idx].z, random.w);
+	else surfel[idx].ColorAndTime = random;
 }
 
-void SparseSurfelFusion::PoissonReconstruction::buildDenseSurfel(DeviceBufferArray<pcl::PointXYZ>& PointCloudDevice, DeviceBufferArray<DepthSurfel>& DenseSurfel, cudaStream_t stream)
+void SparseSurfelFusion::PoissonReconstruction::buildDenseSurfel(DeviceBufferArray<pcl::PointXYZ>& PointCloudDevice, DeviceBufferArray<DepthSurfel>& DenseSurfel, DeviceArrayView<float3> PointColor, cudaStream_t stream)
 {
 	const unsigned int PointsNum = PointCloudDevice.ArrayView().Size();
+	const float3* color = PointColor.Size() == PointsNum ? PointColor.RawPtr() : NULL;
 	dim3 block(128);
 	dim3 grid(divUp(PointsNum, block.x));
-	device::buildDenseSurfelKernel << <grid, block, 0, stream >> > (PointCloudDevice.Array().ptr(), DenseSurfel.Array().ptr(), PointsNum);
+	device::buildDenseSurfelKernel << <grid, block, 0, stream >> > (PointCloudDevice.Array().ptr(), color, DenseSurfel.Array().ptr(), DENSE_SURFEL_RANDOM_SEED, PointsNum);
 }
 
-void SparseSurfelFusion::PoissonReconstruction::buildDenseSurfel(DeviceBufferArray<pcl::PointXYZ>& PointCloudDevice, DeviceBufferArray<pcl::Normal>& PointNormalDevice, DeviceBufferArray<DepthSurfel>& DenseSurfel, cudaStream_t stream)
+void SparseSurfelFusion::PoissonReconstruction::buildDenseSurfel(DeviceBufferArray<pcl::PointXYZ>& PointCloudDevice, DeviceBufferArray<pcl::Normal>& PointNormalDevice, DeviceBufferArray<DepthSurfel>& DenseSurfel, DeviceArrayView<float3> PointColor, cudaStream_t stream)
 {
 	const unsigned int PointsNum = PointCloudDevice.ArrayView().Size();
+	const float3* color = PointColor.Size() == PointsNum ? PointColor.RawPtr() : NULL;
 	dim3 block(128);
 	dim3 grid(divUp(PointsNum, block.x));
-	device::buildOrientedDenseSurfelKernel << <grid, block, 0, stream >> > (PointCloudDevice.Array().ptr(), PointNormalDevice.Array().ptr(), DenseSurfel.Array().ptr(), cudaStates, PointsNum);
+	device::buildOrientedDenseSurfelKernel << <grid, block, 0, stream >> > (PointCloudDevice.Array().ptr(), PointNormalDevice.Array().ptr(), color, DenseSurfel.Array().ptr(), DENSE_SURFEL_RANDOM_SEED, PointsNum);
 }
\ No newline at end of file
@@ -11,21 +11,27 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <base/GlobalConfigs.h>
+
+#include <pcl/point_cloud.h>
+#if RECONSTRUCTION_WITH_PCL_IO
 #include <pcl/io/ply_io.h>  // ply 文件读取头文件
 #include <pcl/visualization/cloud_viewer.h>
 
 #include <pcl/io/pcd_io.h>
-#include <pcl/point_cloud.h>
 #include <pcl/visualization/pcl_visualizer.h>
 
 #include <pcl/kdtree/kdtree_flann.h>
 #include <pcl/features/normal_3d_omp.h>
+#endif // RECONSTRUCTION_WITH_PCL_IO
 #include <boost/thread/thread.hpp>
 
 #include <random>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <base/ThreadPool.h>
+#include <base/DeviceAPI/device_memory_pool.h>
 #include <curand_kernel.h>
 
 #include "BuildOctree.h"
@@ -34,36 +40,72 @@
 #include "ComputeNodesDivergence.h"
 #include "solver/LaplacianSolver.h"
 #include "ComputeTriangleIndices.h"
-
+#include "ImplicitFunctionQuery.h"
+#include "ComputePointNormals.h"
+#include "PointCloudLoader.h"
+#include "StreamScheduler.h"
+#include "StageProfiler.h"
+#include "MeshExporter.h"
+#include "SurfelIngestQueue.h"
+#include "MemoryBudgetPlanner.h"
+
+#if RECONSTRUCTION_WITH_RENDER
 #include "DrawMesh.h"
+#endif // RECONSTRUCTION_WITH_RENDER
 
 namespace SparseSurfelFusion {
 	namespace device {
 
+		/**
+		 * \brief 无状态的均匀随机数：以(点的index, 种子)为计数器和密钥做一次Philox4x32-10，一次得到4个(0, 1]的随机数.
+		 *
+		 * \param idx 点的index
+		 * \param seed 随机种子
+		 * \return 4个相互独立的随机数
+		 */
+		__device__ __forceinline__ float4 statelessUniform4(const unsigned int idx, const unsigned int seed);
+
 		/**
 		 * \brief 构建稠密面元.
 		 * 
 		 * \param coor 传入点云三维坐标
+		 * \param color 逐点颜色，为NULL时颜色取随机值
 		 * \param surfel 坐标写入面元
+		 * \param seed 随机种子
 		 * \param pointsNum 面元数量
 		 */
-		__global__ void buildDenseSurfelKernel(pcl::PointXYZ* coor, DepthSurfel* surfel, const unsigned int pointsNum);
+		__global__ void buildDenseSurfelKernel(pcl::PointXYZ* coor, const float3* color, DepthSurfel* surfel, const unsigned int seed, const unsigned int pointsNum);
 
 		/**
 		 * \brief 构建有法向量的稠密点云.
 		 * 
 		 * \param coor 传入点云三维坐标
 		 * \param normal 法向量
+		 * \param color 逐点颜色，为NULL时颜色取随机值
 		 * \param surfel 坐标写入面元
-		 * \param cudaStates 用以生成随机数
+		 * \param seed 随机种子
 		 * \param pointsNum 面元数量
 		 */
-		__global__ void buildOrientedDenseSurfelKernel(pcl::PointXYZ* coor, pcl::Normal* normal, DepthSurfel* surfel, curandState* cudaStates, const unsigned int pointsNum);
+		__global__ void buildOrientedDenseSurfelKernel(pcl::PointXYZ* coor, pcl::Normal* normal, const float3* color, DepthSurfel* surfel, const unsigned int seed, const unsigned int pointsNum);
 	}
 	class PoissonReconstruction
 	{
 	public:
-		PoissonReconstruction();
+		/**
+		 * \brief 分块重建的一个块.
+		 */
+		struct ReconstructionTile {
+			Point3D<float> coreMin;					// 核心区域最小点，三角形重心落在[coreMin, coreMax)内才保留
+			Point3D<float> coreMax;					// 核心区域最大点
+			std::vector<unsigned int> indices;		// 落在扩展(核心 + 重叠)区域内的面元索引
+		};
+
+		/**
+		 * \brief 构造泊松重建，各模块按config中的容量预分配显存.
+		 * 
+		 * \param reconstructionConfig 运行时容量配置(可用ReconstructionConfig::FromPointCount按实际输入点数生成，或用MemoryBudgetPlanner::Plan按显存预算生成)
+		 */
+		PoissonReconstruction(const ReconstructionConfig& reconstructionConfig = ReconstructionConfig());
 
 		~PoissonReconstruction();
 
@@ -92,7 +134,15 @@ namespace SparseSurfelFusion {
 		LaplacianSolver::Ptr LaplacianSolverPtr;			// Laplace求解器
 		BuildMeshGeometry::Ptr MeshGeometryPtr;				// 网格构建顶点、边、面三种元素
 		ComputeTriangleIndices::Ptr TriangleIndicesPtr;		// 三角剖分构建索引
+		ImplicitFunctionQuery::Ptr ImplicitQueryPtr;		// 隐式函数查询与网格导出
+#if RECONSTRUCTION_WITH_RENDER
 		DrawMesh::Ptr DrawConstructedMesh;					// OpenGL绘制被构建的网格
+#endif // RECONSTRUCTION_WITH_RENDER
+		ComputePointNormals::Ptr PointNormalsPtr;			// GPU估计读入点云的法线
+		PointCloudLoader::Ptr PointCloudLoaderPtr;			// 点云文件加载
+		StageProfiler::Ptr ProfilerPtr;						// GPU阶段计时
+		MeshExporter::Ptr MeshExporterPtr;					// 异步导出网格文件
+		MeshSimplification::Ptr SimplificationPtr;			// GPU网格简化
 
 	public:
 		/**
@@ -103,40 +153,417 @@ namespace SparseSurfelFusion {
 		void readTXTFile(std::string path);
 
 		/**
-		 * \brief 读取pcd文件.
+		 * \brief 读取pcd文件，不编译PCL文件读写时只支持加载器可解析的格式，法线总在GPU上估计.
 		 * 
 		 * \param path 文件路径
 		 */
 		void readPCDFile(std::string path);
 
+#if RECONSTRUCTION_WITH_PCL_IO
 		/**
 		 * \brief 读取ply文件.
 		 * 
 		 * \param path 文件路径
 		 */
 		void readPLYFile(std::string path);
+#endif // RECONSTRUCTION_WITH_PCL_IO
 
 		/**
 		 * \brief 初始化八叉树的树结构.
 		 *
 		 * \param denseSurfel 传入稠密点
+		 * \param inputReady 面元上传完成的事件，非NULL时八叉树构建只在GPU上等待该事件
+		 * \param inputConsumed 非NULL时在八叉树读取完denseSurfel后记录
+		 */
+		void SolvePoissionReconstructionMesh(DeviceArrayView<DepthSurfel> denseSurfel, cudaEvent_t inputReady = NULL, cudaEvent_t inputConsumed = NULL);
+
+		/**
+		 * \brief 从输入队列取出下一帧并重建：八叉树构建在GPU上等待该帧上传完成，读取完面元后立即归还槽位，
+		 *        下一帧的上传与本帧的求解重叠.队列需在config.deviceId上构造.
+		 *
+		 * \param ingest 输入队列
+		 * \return 队列已关闭且没有剩余的帧时返回false
+		 */
+		bool SolveNextIngestedFrame(SurfelIngestQueue& ingest);
+
+		/**
+		 * \brief 分块(out-of-core)重建：点云超出容量时将包围盒递归二分为带重叠的块，每块点数不超过config.maxSurfelCount，
+		 *        逐块复用SolvePoissionReconstructionMesh重建(下一块的上传与当前块的计算双缓冲重叠)，最后按块的核心区域裁剪三角形并拼接.
+		 * 
+		 * \param surfels Host端的全部稠密面元
+		 * \param meshVertices 【输出】拼接后的网格顶点(原始坐标系)
+		 * \param meshTriangles 【输出】拼接后的三角形索引
+		 * \param overlapRatio 块向外扩展的重叠宽度与块核心区域最长边之比
+		 */
+		void SolveTiledReconstructionMesh(const std::vector<DepthSurfel>& surfels, std::vector<Point3D<float>>& meshVertices, std::vector<TriangleIndex>& meshTriangles, const float overlapRatio = 0.1f);
+
+		/**
+		 * \brief 将包围盒递归二分，直到每个块(含重叠区域)的面元数量不超过config.maxSurfelCount.
+		 * 
+		 * \param surfels Host端的全部稠密面元
+		 * \param overlapRatio 重叠宽度与核心区域最长边之比
+		 * \param tiles 【输出】划分得到的块
+		 */
+		void PartitionReconstructionTiles(const std::vector<DepthSurfel>& surfels, const float overlapRatio, std::vector<ReconstructionTile>& tiles);
+
+		/**
+		 * \brief 依次重建给定的块并拼接(块间双缓冲上传)，块由PartitionReconstructionTiles划分.
+		 * 
+		 * \param surfels Host端的全部稠密面元
+		 * \param tiles 需要重建的块
+		 * \param meshVertices 【输出】追加拼接的网格顶点(原始坐标系)
+		 * \param meshTriangles 【输出】追加拼接的三角形索引
 		 */
-		void SolvePoissionReconstructionMesh(DeviceArrayView<DepthSurfel> denseSurfel);
+		void SolveReconstructionTiles(const std::vector<DepthSurfel>& surfels, const std::vector<ReconstructionTile>& tiles, std::vector<Point3D<float>>& meshVertices, std::vector<TriangleIndex>& meshTriangles);
 
+#if RECONSTRUCTION_WITH_RENDER
 		/**
 		 * \brief OpenGL绘制重建的网格.
 		 */
 		void DrawRebuildMesh();
 
+		/**
+		 * \brief 流水线模式绘制重建的网格：本帧网格在RenderStream上拷贝到DrawMesh的写槽位并计算颜色、法线、上传VBO/IBO，
+		 *        Host随即绘制上一帧上传好的槽位并返回，不同步设备.下一帧SolvePoissionReconstructionMesh构建八叉树前
+		 *        只在GPU上等待本帧读取八叉树与网格完毕，其余渲染工作与下一帧重建重叠，显示滞后一帧.
+		 *        不能与DrawRebuildMesh混用.
+		 */
+		void DrawRebuildMeshPipelined();
+#endif // RECONSTRUCTION_WITH_RENDER
+
 		DeviceArrayView<DepthSurfel> getDenseSurfel();
 
+		/**
+		 * \brief 获得最近一次重建的网格顶点(归一化坐标，原坐标 = 顶点 * GetNormalizeMaxEdge() + GetNormalizeCenter()).
+		 */
+		DeviceArrayView<Point3D<float>> GetRebuildMeshVertices() { return TriangleIndicesPtr->GetRebuildMeshVertices(); }
+
+		/**
+		 * \brief 获得最近一次重建的三角形索引.
+		 */
+		DeviceArrayView<TriangleIndex> GetRebuildMeshTriangleIndices() { return TriangleIndicesPtr->GetRebuildMeshTriangleIndices(); }
+
+		/**
+		 * \brief 设置网格输出槽：之后的重建把最终网格直接写入调用方的显存，GetRebuildMeshVertices/GetRebuildMeshTriangleIndices指向sink.
+		 *        sink需在重建所在设备(config.deviceId)上，开启零拷贝绘制时每帧会被写槽位的VBO/IBO覆盖.
+		 *
+		 * \param sink 输出显存
+		 */
+		void SetMeshOutputSink(const MeshOutputSink& sink) { TriangleIndicesPtr->SetOutputSink(sink); }
+
+		/**
+		 * \brief 重置网格输出槽，网格写回内部缓冲.
+		 */
+		void ResetMeshOutputSink() { TriangleIndicesPtr->ResetOutputSink(); }
+
+		/**
+		 * \brief 获得最近一次重建的归一化偏移.
+		 */
+		Point3D<float> GetNormalizeCenter() const { return OctreePtr->GetNormalizeCenter(); }
+
+		/**
+		 * \brief 获得最近一次重建的归一化放缩边长.
+		 */
+		float GetNormalizeMaxEdge() const { return OctreePtr->GetNormalizeMaxEdge(); }
+
+		/**
+		 * \brief 设置GPU网格简化：在三角剖分之后、绘制与导出之前原地简化网格，目标与误差均为0时关闭(默认).
+		 *
+		 * \param options 目标三角形数量或顶点最大偏移(归一化坐标)
+		 */
+		void SetMeshSimplification(const MeshSimplificationOptions& options) { SimplificationPtr->SetOptions(options); }
+
+		/**
+		 * \brief 异步导出最近一次重建的网格(原坐标)，只在MeshStream[0]上排队快照拷贝，不阻塞Host，下一帧重建可以立即开始.
+		 *
+		 * \param path 文件路径
+		 * \param format 文件格式
+		 * \return 导出完成后为true，文件无法写入为false
+		 */
+		std::shared_future<bool> ExportRebuildMesh(const std::string& path, const MeshFileFormat format = MeshFileFormat::BinaryPLY);
+
+		/**
+		 * \brief 阻塞直到网格导出完成.
+		 */
+		bool WaitMeshExport() { return MeshExporterPtr->Wait(); }
+
+		/**
+		 * \brief 获得当前重建的容量配置.
+		 */
+		const ReconstructionConfig& GetConfig() const { return config; }
+
+		/**
+		 * \brief 设置拉普拉斯求解阶段是否使用CUDA Graph捕获、重放(需要CUDA 12及以上，低于12时退回逐个核函数启动).
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetGraphMode(const bool enable) { LaplacianSolverPtr->SetGraphMode(enable); }
+
+		/**
+		 * \brief 设置拉普拉斯求解是否使用由粗到细的级联求解.
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetCascadicMode(const bool enable) { LaplacianSolverPtr->SetCascadicMode(enable); }
+
+		/**
+		 * \brief 设置拉普拉斯求解CG使用的预条件子.
+		 * 
+		 * \param type 预条件子类型
+		 */
+		void SetPreconditioner(const CGPreconditioner type) { LaplacianSolverPtr->SetPreconditioner(type); }
+
+		/**
+		 * \brief 设置拉普拉斯求解是否使用上一帧的解热启动(连续重建近似相同的场景时).
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetWarmStart(const bool enable) { LaplacianSolverPtr->SetWarmStart(enable); }
+
+		/**
+		 * \brief 设置拉普拉斯求解是否使用无矩阵算子(不组装CSR).
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetMatrixFree(const bool enable) { LaplacianSolverPtr->SetMatrixFree(enable); }
+
+		/**
+		 * \brief 设置拉普拉斯求解CG的精度策略.
+		 * 
+		 * \param type 精度策略
+		 * \param refinementSteps FloatRefined时迭代修正的次数
+		 */
+		void SetPrecision(const SolverPrecision type, const int refinementSteps = 2) { LaplacianSolverPtr->SetPrecision(type, refinementSteps); }
+
+		/**
+		 * \brief 设置是否使用屏蔽泊松(按点密度加权的采样约束隐函数在点处为0).
+		 * 
+		 * \param enable 是否开启
+		 * \param weight 屏蔽项权重α
+		 */
+		void SetScreening(const bool enable, const float weight = 4.0f) { LaplacianSolverPtr->SetScreening(enable, weight); }
+
+		/**
+		 * \brief 获得Laplace求解器工作区曾达到的最大显存占用(字节).
+		 */
+		size_t GetSolverWorkspaceHighWaterMark() const { return LaplacianSolverPtr->GetWorkspaceHighWaterMark(); }
+
+		/**
+		 * \brief 获得本实例所在设备显存池的统计(当前与峰值占用、按模块的占用、池从驱动取得的显存)，同设备的实例共用一个池.
+		 */
+		MemoryPoolStatistics GetMemoryPoolStatistics() const { return DeviceMemoryPool::Instance(config.deviceId).GetStatistics(); }
+
+		/**
+		 * \brief 设置是否焊接maxDepth层网格与细分网格共享边上的顶点(默认开启)，焊接后输出共享顶点的索引网格.
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetVertexWelding(const bool enable) { TriangleIndicesPtr->SetVertexWelding(enable); }
+
+		/**
+		 * \brief 设置八叉树增量模式(连续帧只有少量面元变化时)：冻结归一化，标记变化的D层节点，拓扑不变时复用邻居与基函数索引.
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetIncrementalMode(const bool enable) { OctreePtr->SetIncrementalMode(enable); }
+
+		/**
+		 * \brief 设置八叉树压缩拓扑模式：不存储27 * N的SoA邻居数组，求解与隐函数值核函数按key查找邻居，以计算换显存.
+		 *        OctNode::neighs仍在NodeArray中分配并填充(构建、散度、向量场、网格几何与细分依赖它)，只省去SoA邻居副本.
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetCompressedTopology(const bool enable) { OctreePtr->SetCompressedTopology(enable); }
+
+		/**
+		 * \brief 设置固定包围盒(静止的采集装置)：每帧跳过包围盒归约，以该包围盒归一化.
+		 * 
+		 * \param minPoint 包围盒最小点
+		 * \param maxPoint 包围盒最大点
+		 */
+		void SetFixedBoundingBox(const Point3D<float>& minPoint, const Point3D<float>& maxPoint) { OctreePtr->SetFixedBoundingBox(minPoint, maxPoint); }
+
+		/**
+		 * \brief 取消固定包围盒，恢复每帧在设备端归约包围盒.
+		 */
+		void ClearFixedBoundingBox() { OctreePtr->ClearFixedBoundingBox(); }
+
+		/**
+		 * \brief 设置渐进预览：previewDepth及更粗的层求解完成后，在独立的预览流上用粗层解对previewDepth层节点做Marching Cubes，
+		 *        粗糙网格(归一化坐标，不共享顶点)写入双缓冲并发布，与细层求解并行，完整网格照常输出.
+		 *
+		 * \param enable 是否开启
+		 * \param previewDepth 预览层，须在[1, maxDepth)之间
+		 * \param callback 发布预览网格时在CUDA回调线程中调用，不能调用CUDA API，可为空(通过GetPreviewMesh轮询)
+		 */
+		void SetProgressivePreview(const bool enable, const int previewDepth = PREVIEW_MESH_DEFAULT_DEPTH, PreviewMeshCallback callback = PreviewMeshCallback());
+
+		/**
+		 * \brief 拷贝最近一次发布的预览网格，可在任意线程调用(包括重建进行中).
+		 *
+		 * \param vertices 【输出】预览网格顶点(归一化坐标)
+		 * \param triangles 【输出】预览网格三角形
+		 * \return 是否已有发布的预览网格
+		 */
+		bool GetPreviewMesh(std::vector<Point3D<float>>& vertices, std::vector<TriangleIndex>& triangles) { return TriangleIndicesPtr->GetPreviewMesh(vertices, triangles); }
+
+		/**
+		 * \brief 添加一个等值面提取的感兴趣区域(原坐标)：求解仍是全局的，只在与区域相交的节点上求顶点隐函数值、三角剖分与细分，
+		 *        提取开销随区域体积下降.最多MAX_MESH_ROI_COUNT个区域，每帧按该帧的归一化变换换算.
+		 *
+		 * \param minPoint 区域最小点
+		 * \param maxPoint 区域最大点
+		 */
+		void AddRegionOfInterest(const Point3D<float>& minPoint, const Point3D<float>& maxPoint);
+
+		/**
+		 * \brief 清除全部感兴趣区域，恢复提取整个表面.
+		 */
+		void ClearRegionsOfInterest() { regionsOfInterest = MeshRegionsOfInterest(); }
+
+		/**
+		 * \brief 在最近一次重建的隐式函数上批量查询任意点【阻塞Host】，在SolvePoissionReconstructionMesh之后调用.
+		 *
+		 * \param points 查询点(原坐标)
+		 * \param values 【输出】隐式函数值 - 等值：小于0为内部、大于0为外部(法线朝外时)，数值不是欧氏距离.
+		 *        八叉树只在采样点附近细分，符号只在采样点(表面)附近可靠，远离表面处(如封闭物体的中心)可能为任意符号
+		 */
+		void QueryImplicitFunction(const std::vector<Point3D<float>>& points, std::vector<float>& values);
+
+		/**
+		 * \brief 导出最近一次重建的隐式函数的稠密网格【阻塞Host】：覆盖归一化立方体，每维2^resolutionLog2 + 1个格点，x变化最快.
+		 *        格点(i, j, k)的原坐标为 (i, j, k) / 2^resolutionLog2 * GetNormalizeMaxEdge() + GetNormalizeCenter().
+		 *
+		 * \param resolutionLog2 每维网格数log2，不超过maxDepth时全部查表
+		 * \param values 【输出】格点上的隐式函数值 - 等值
+		 */
+		void ExportImplicitGrid(const int resolutionLog2, std::vector<float>& values);
+
+		/**
+		 * \brief 导出最近一次重建的隐式函数的稀疏块网格【阻塞Host】：八叉树只在表面附近细分，brickDepth层每个节点一个块，
+		 *        块内每维2^brickResolutionLog2 + 1个格点(x变化最快)，相邻块共享边界格点，格点间距为 GetNormalizeMaxEdge() / 2^(brickDepth + brickResolutionLog2).
+		 *
+		 * \param brickDepth 块所在层
+		 * \param brickResolutionLog2 每个块每维的网格数log2
+		 * \param brickOrigins 【输出】每个块的最小角点(原坐标)
+		 * \param values 【输出】块的格点上的隐式函数值 - 等值，每个块(2^brickResolutionLog2 + 1)^3个
+		 */
+		void ExportImplicitBricks(const int brickDepth, const int brickResolutionLog2, std::vector<Point3D<float>>& brickOrigins, std::vector<float>& values);
+
+		/**
+		 * \brief 获得隐式函数查询引擎，可在设备端直接批量查询(归一化坐标)，绑定的视图在下一帧重建开始前有效.
+		 */
+		ImplicitFunctionQuery::Ptr GetImplicitFunctionQuery() { return ImplicitQueryPtr; }
+
+		/**
+		 * \brief 设置readPCDFile的法线估计方式：true为GPU网格kNN(默认)，false为PCL NormalEstimationOMP并保存带法线的点云.
+		 * 
+		 * \param enable 是否使用GPU估计
+		 */
+		void SetGpuNormalEstimation(const bool enable) { gpuNormalEstimation = enable; }
+
+#if RECONSTRUCTION_WITH_RENDER
+		/**
+		 * \brief 设置是否零拷贝绘制(默认开启)：重建前映射DrawMesh写槽位的VBO/IBO作为网格输出槽，
+		 *        等值面提取直接写入OpenGL缓冲，省去拷贝到渲染槽位与VBO/IBO的两次拷贝.
+		 *        开启后每次重建都需要调用DrawRebuildMesh或DrawRebuildMeshPipelined解除映射，且须在OpenGL上下文所在线程调用；
+		 *        解除映射前网格拷回内部缓冲，之后GetRebuildMeshVertices/ExportRebuildMesh读取内部缓冲.
+		 *
+		 * \param enable 是否开启
+		 */
+		void SetZeroCopyRender(const bool enable) { zeroCopyRender = enable; if (!enable) TriangleIndicesPtr->ResetOutputSink(); }
+
+		/**
+		 * \brief 设置绘制时是否跨帧缓存maxDepth层节点的颜色(默认开启)，见DrawMesh::SetTemporalColorCache.
+		 *        固定机位的流式输入中大部分表面与采样点不变，只有27邻域内采样点变化的节点重新计算颜色.
+		 *
+		 * \param enable 是否开启
+		 */
+		void SetTemporalMeshColoring(const bool enable) { if (DrawConstructedMesh != nullptr) DrawConstructedMesh->SetTemporalColorCache(enable); }
+#endif // RECONSTRUCTION_WITH_RENDER
+
+		/**
+		 * \brief 设置是否对每个阶段(及每层的组装与CG)做GPU事件计时，并标注NVTX区间.
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetProfiling(const bool enable) { ProfilerPtr->SetEnable(enable); }
+
+		/**
+		 * \brief 等待本帧计时事件，并记录每层CG的迭代次数与残差、求解器工作区显存最高水位、显存池占用【阻塞Host】，在SolvePoissionReconstructionMesh(及绘制)之后调用.
+		 *        结果通过GetProfiler()->GetTimings()/GetMetrics()读取，或ExportJSON/ExportCSV导出.
+		 */
+		void ResolveProfile();
+
+		/**
+		 * \brief 获得阶段计时器.
+		 */
+		StageProfiler::Ptr GetProfiler() { return ProfilerPtr; }
+
 	private:
 
-		std::shared_ptr<ThreadPool> pool;
+		std::shared_ptr<ThreadPool> pool;	// CPU端流水线任务(文件解析、网格导出)的工作窃取线程池，进程内全部重建实例共享
+
+		ReconstructionConfig config;	// 运行时容量配置
+
+		bool gpuNormalEstimation = true;	// readPCDFile是否在GPU上估计法线
+
+		DeviceBufferArray<DepthSurfel> TileSurfel[2];		// 分块重建时双缓冲的块面元
+		DepthSurfel* TileSurfelHost[2] = { NULL, NULL };	// 分块重建时双缓冲的页锁定Host块面元
+		cudaStream_t TileUploadStream = NULL;				// 分块上传流
+		cudaEvent_t TileUploadEvent[2];						// 分块上传完成事件
+
+		/**
+		 * \brief 异步上传一个块的面元到TileSurfel[slot].
+		 * 
+		 * \param surfels Host端的全部稠密面元
+		 * \param tile 需要上传的块
+		 * \param slot 双缓冲槽位
+		 */
+		void uploadReconstructionTile(const std::vector<DepthSurfel>& surfels, const ReconstructionTile& tile, const int slot);
+
+		/**
+		 * \brief 下载当前块重建的网格，变换回原始坐标系，保留重心落在核心区域的三角形并追加到输出.
+		 * 
+		 * \param tile 当前块
+		 * \param meshVertices 【输出】拼接的网格顶点
+		 * \param meshTriangles 【输出】拼接的三角形索引
+		 */
+		void appendTileMesh(const ReconstructionTile& tile, std::vector<Point3D<float>>& meshVertices, std::vector<TriangleIndex>& meshTriangles);
 
 		cudaStream_t MeshStream[MAX_MESH_STREAM];
+		cudaStream_t PreviewStream = NULL;			// 渐进预览网格的提取流，只等待预览层及更粗层的求解
+		int previewDepth = -1;						// 渐进预览层，小于0表示关闭
+		MeshRegionsOfInterest regionsOfInterest;	// 等值面提取的感兴趣区域(原坐标)
+		DeviceBufferArray<float> ImplicitGridValues;		// 导出的稠密/稀疏块网格采样
+		DeviceBufferArray<float3> ImplicitBrickOrigins;		// 导出的稀疏块最小角点(归一化坐标)
+
+		/**
+		 * \brief 按本帧的归一化变换把感兴趣区域换算到归一化坐标【没有区域时不阻塞，否则等待归一化变换读回】.
+		 */
+		MeshRegionsOfInterest normalizedRegionsOfInterest() const;
+
+		/**
+		 * \brief 重建各阶段之间传递的资源，供MeshScheduler连接依赖.
+		 */
+		enum MeshResource {
+			OctreeResource = 0,				// 八叉树NodeArray、深度与中心查询表、拓扑
+			EncodedFunctionResource,		// 节点基函数索引
+			VectorFieldResource,			// 向量场
+			DivergenceResource,				// 节点散度
+			ImplicitFunctionResource,		// 求解得到的dx与等值
+			MeshGeometryResource,			// 顶点、边、面数组及NodeArray中的索引
+			MeshResourceCount
+		};
+		StreamScheduler::Ptr MeshScheduler;					// 按资源依赖在MeshStream之间连接事件
+
+#if RECONSTRUCTION_WITH_RENDER
+		cudaStream_t RenderStream = NULL;					// 流水线模式下计算颜色、法线并上传渲染槽位的流
+		cudaEvent_t RenderInputReleasedEvent = NULL;		// 渲染读取完本帧八叉树与网格的事件
+		bool renderInputPending = false;					// 下一帧重建是否需要等待RenderInputReleasedEvent
+		bool zeroCopyRender = true;							// 是否把网格直接写入映射的VBO/IBO
+#endif // RECONSTRUCTION_WITH_RENDER
 
-		std::vector<float> PointCloud;
 		unsigned int pointsNum = 0;
 		DeviceBufferArray<pcl::PointXYZ> PointCloudDevice;
 		DeviceBufferArray<pcl::Normal> PointNormalDevice;
@@ -146,9 +573,9 @@ namespace SparseSurfelFusion {
 		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
 		pcl::PointCloud<pcl::Normal>::Ptr normals;
 
-		curandState* cudaStates = NULL;		// 用以生成随机数
 
 
+#if RECONSTRUCTION_WITH_PCL_IO
 		/**
 		 * \brief 传入点云计算法线.
 		 *
@@ -156,6 +583,7 @@ namespace SparseSurfelFusion {
 		 * \param normals 计算得到法线
 		 */
 		void CalculatePointCloudNormal(pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals);
+#endif // RECONSTRUCTION_WITH_PCL_IO
 
 
 
@@ -165,9 +593,10 @@ namespace SparseSurfelFusion {
 		 * 
 		 * \param PointCloudDevice
 		 * \param DenseSurfel
+		 * \param PointColor 逐点颜色([0, 1])，数量与点不一致(如文件没有颜色)时颜色取随机值
 		 * \param stream 
 		 */
-		void buildDenseSurfel(DeviceBufferArray<pcl::PointXYZ>& PointCloudDevice, DeviceBufferArray<DepthSurfel>& DenseSurfel, cudaStream_t stream = 0);
+		void buildDenseSurfel(DeviceBufferArray<pcl::PointXYZ>& PointCloudDevice, DeviceBufferArray<DepthSurfel>& DenseSurfel, DeviceArrayView<float3> PointColor, cudaStream_t stream = 0);
 
 		/**
 		 * \brief.
@@ -175,12 +604,15 @@ namespace SparseSurfelFusion {
 		 * \param PointCloudDevice
 		 * \param PointNormalDevice
 		 * \param DenseSurfel
+		 * \param PointColor 逐点颜色([0, 1])，数量与点不一致(如文件没有颜色)时颜色取随机值
 		 * \param stream
 		 */
-		void buildDenseSurfel(DeviceBufferArray<pcl::PointXYZ>& PointCloudDevice, DeviceBufferArray<pcl::Normal>& PointNormalDevice, DeviceBufferArray<DepthSurfel>& DenseSurfel, cudaStream_t stream = 0);
+		void buildDenseSurfel(DeviceBufferArray<pcl::PointXYZ>& PointCloudDevice, DeviceBufferArray<pcl::Normal>& PointNormalDevice, DeviceBufferArray<DepthSurfel>& DenseSurfel, DeviceArrayView<float3> PointColor, cudaStream_t stream = 0);
 
 
+#if RECONSTRUCTION_WITH_PCL_IO
 		void saveCloudWithNormal(pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals);
+#endif // RECONSTRUCTION_WITH_PCL_IO
 	};
 }
 
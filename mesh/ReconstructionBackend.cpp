@@ -0,0 +1,53 @@
+/*****************************************************************//**
+ * \file   ReconstructionBackend.cpp
+ * \brief  重建后端选择方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "ReconstructionBackend.h"
+#include <base/GlobalConfigs.h>
+#if RECONSTRUCTION_WITH_CUDA
+#include <cuda_runtime_api.h>
+#endif // RECONSTRUCTION_WITH_CUDA
+
+int SparseSurfelFusion::VisibleGpuCount()
+{
+#if RECONSTRUCTION_WITH_CUDA
+	int deviceCount = 0;
+	// 没有驱动时返回cudaErrorNoDevice或cudaErrorInsufficientDriver，属于正常的CPU节点，不用CHECKCUDA
+	const cudaError_t status = cudaGetDeviceCount(&deviceCount);
+	if (status != cudaSuccess) {
+		cudaGetLastError();		// 清除错误状态，避免影响之后的CUDA调用
+		return 0;
+	}
+	return deviceCount;
+#else
+	return 0;
+#endif // RECONSTRUCTION_WITH_CUDA
+}
+
+SparseSurfelFusion::ReconstructionBackend SparseSurfelFusion::ResolveReconstructionBackend(const ReconstructionBackend requested)
+{
+	switch (requested) {
+	case ReconstructionBackend::Cpu:
+		return ReconstructionBackend::Cpu;
+	case ReconstructionBackend::Gpu:
+		if (VisibleGpuCount() == 0) LOGGING(FATAL) << "要求使用GPU重建后端，但没有可用的GPU设备";
+		return ReconstructionBackend::Gpu;
+	default:
+		return VisibleGpuCount() > 0 ? ReconstructionBackend::Gpu : ReconstructionBackend::Cpu;
+	}
+}
+
+const char* SparseSurfelFusion::ReconstructionBackendName(const ReconstructionBackend backend)
+{
+	switch (backend) {
+	case ReconstructionBackend::Gpu:
+		return "GPU";
+	case ReconstructionBackend::Cpu:
+		return "CPU";
+	default:
+		return "Auto";
+	}
+}
@@ -0,0 +1,38 @@
+/*****************************************************************//**
+ * \file   ReconstructionBackend.h
+ * \brief  按硬件选择重建后端：有可用的NVIDIA GPU时使用PoissonReconstruction，否则使用cpu::CpuPoissonReconstruction
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <base/Logging.h>
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 重建后端.
+	 */
+	enum class ReconstructionBackend {
+		Auto,	// 有可用GPU时为Gpu，否则为Cpu
+		Gpu,	// PoissonReconstruction
+		Cpu		// cpu::CpuPoissonReconstruction
+	};
+
+	/**
+	 * \brief 可见的GPU数量，没有驱动或没有设备时为0(不报错)，未编译CUDA(RECONSTRUCTION_WITH_CUDA = 0)时总为0.
+	 */
+	int VisibleGpuCount();
+
+	/**
+	 * \brief 确定实际使用的后端：Auto按VisibleGpuCount选择，显式要求Gpu但没有可用设备时报错.
+	 *
+	 * \param requested 要求的后端
+	 * \return Gpu或Cpu
+	 */
+	ReconstructionBackend ResolveReconstructionBackend(const ReconstructionBackend requested);
+
+	/**
+	 * \brief 后端名称，用于日志.
+	 */
+	const char* ReconstructionBackendName(const ReconstructionBackend backend);
+}
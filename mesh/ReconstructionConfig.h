@@ -0,0 +1,63 @@
+/*****************************************************************//**
+ * \file   ReconstructionConfig.h
+ * \brief  泊松重建运行时容量配置(各模块按此预分配显存)
+ *
+ * \author LUOJIAXUAN
+ * \date   May 4th 2024
+ *********************************************************************/
+#pragma once
+#include <string>
+#include <cstdint>
+#include <base/GlobalConfigs.h>
+#include <base/Logging.h>
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 重建的运行时容量配置，默认值与GlobalConfigs中的编译期上限一致.
+	 *        八叉树深度仍然是编译期常量(device::maxDepth、OctKey位宽、点积表尺寸均由MAX_DEPTH_OCTREE决定)，
+	 *        此处的maxDepth仅用于校验调用方的期望与编译配置一致.
+	 */
+	struct ReconstructionConfig {
+		unsigned int maxSurfelCount = MAX_SURFEL_COUNT;					// 最大面元个数
+		unsigned int maxMeshTriangleCount = MAX_MESH_TRIANGLE_COUNT;	// 最大网格三角形数量
+		unsigned int nodeArrayFactor = 10;								// NodeArray最大数量 = nodeArrayFactor * maxSurfelCount
+		int maxDepth = MAX_DEPTH_OCTREE;								// 期望的八叉树深度(必须与编译期MAX_DEPTH_OCTREE一致)
+		int deviceId = 0;												// 重建所在的GPU设备号
+		bool enableRender = RECONSTRUCTION_WITH_RENDER != 0;			// 是否创建OpenGL窗口绘制网格(多GPU的工作实例、无窗口库不需要)
+		std::string tableCacheDirectory = ".";							// 基函数点积表缓存目录，为空则每次启动重新计算
+		size_t memoryPoolReleaseThreshold = SIZE_MAX;					// 设备显存池保留的空闲显存上限(字节)，SIZE_MAX表示从不归还驱动，同设备多个实例取最大值
+
+		/**
+		 * \brief 按实际输入点数生成配置，留有一定余量.
+		 *
+		 * \param pointsNum 输入点数量
+		 * \param headroom 余量倍数
+		 * \return 配置
+		 */
+		static ReconstructionConfig FromPointCount(const unsigned int pointsNum, const float headroom = 1.2f) {
+			ReconstructionConfig config;
+			config.maxSurfelCount = (unsigned int)(pointsNum * headroom) + 1;
+			// 三角形数量按默认上限的 三角形/面元 比例缩放
+			config.maxMeshTriangleCount = (unsigned int)((double)config.maxSurfelCount * MAX_MESH_TRIANGLE_COUNT / MAX_SURFEL_COUNT) + 1;
+			return config;
+		}
+
+		/**
+		 * \brief 校验配置是否能被当前编译配置支持，不支持则直接报错.
+		 */
+		void CheckValid() const {
+			if (maxDepth != MAX_DEPTH_OCTREE) LOGGING(FATAL) << "ReconstructionConfig::maxDepth = " << maxDepth << " 与编译期MAX_DEPTH_OCTREE = " << MAX_DEPTH_OCTREE << " 不一致，需以对应深度重新编译";
+			if (maxSurfelCount == 0 || (long long)maxSurfelCount > OCTREE_INDEX_MASK) LOGGING(FATAL) << "ReconstructionConfig::maxSurfelCount = " << maxSurfelCount << " 超出排序编码可记录的稠密点index范围";
+			if (deviceId < 0 || deviceId >= MAX_RECONSTRUCTION_DEVICES) LOGGING(FATAL) << "ReconstructionConfig::deviceId = " << deviceId << " 超出MAX_RECONSTRUCTION_DEVICES";
+			if (enableRender && !RECONSTRUCTION_WITH_RENDER) LOGGING(FATAL) << "ReconstructionConfig::enableRender为true，但未编译渲染(RECONSTRUCTION_WITH_RENDER = 0)";
+			if (nodeArrayFactor <= 8) LOGGING(FATAL) << "ReconstructionConfig::nodeArrayFactor 必须大于8(NodeArray需容纳maxDepth层最坏情况的8倍面元节点及其余层节点)";
+		}
+
+		size_t DLevelMaxNode() const { return 8 * (size_t)maxSurfelCount; }								// maxDepth层节点的最坏情况
+		size_t TotalNodeArrayCount() const { return (size_t)nodeArrayFactor * maxSurfelCount; }				// NodeArray最大的数量
+		size_t TotalVertexArrayCount() const { return 8 * TotalNodeArrayCount(); }							// NodeArray最大的数量 * 8(8个顶点)
+		size_t TotalEdgeArrayCount() const { return 12 * DLevelMaxNode(); }									// maxDepth层中节点数量 * 12
+		size_t TotalFaceArrayCount() const { return 6 * TotalNodeArrayCount(); }							// NodeArray最大的数量 * 6(6个面)
+		size_t CoarserNodeArrayCount() const { return TotalNodeArrayCount() - DLevelMaxNode(); }			// 非maxDepth层的最大节点数量
+	};
+}
@@ -0,0 +1,125 @@
+/*****************************************************************//**
+ * \file   StageProfiler.cpp
+ * \brief  GPU阶段计时实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 9th 2024
+ *********************************************************************/
+#include "StageProfiler.h"
+#include <fstream>
+
+SparseSurfelFusion::StageProfiler::~StageProfiler()
+{
+	for (size_t i = 0; i < eventPool.size(); i++) {
+		CHECKCUDA(cudaEventDestroy(eventPool[i]));
+	}
+	eventPool.clear();
+}
+
+cudaEvent_t SparseSurfelFusion::StageProfiler::nextEvent()
+{
+	if (usedEvents == eventPool.size()) {
+		cudaEvent_t event;
+		CHECKCUDA(cudaEventCreate(&event));		// 需要计时，不能使用cudaEventDisableTiming
+		eventPool.push_back(event);
+	}
+	return eventPool[usedEvents++];
+}
+
+void SparseSurfelFusion::StageProfiler::BeginFrame()
+{
+	for (size_t i = 0; i < pending.size(); i++) {
+		if (!pending[i].ended) nvtxRangeEnd(pending[i].range);
+	}
+	pending.clear();
+	pendingMetrics.clear();
+	usedEvents = 0;
+	frame++;
+}
+
+int SparseSurfelFusion::StageProfiler::Begin(const char* name, cudaStream_t stream, const int depth)
+{
+	if (!enabled) return -1;
+	PendingStage stage;
+	stage.name = name;
+	stage.depth = depth;
+	stage.start = nextEvent();
+	stage.end = nextEvent();
+	if (depth < 0) {
+		stage.range = nvtxRangeStartA(name);
+	}
+	else {
+		const std::string label = stage.name + "[" + std::to_string(depth) + "]";
+		stage.range = nvtxRangeStartA(label.c_str());
+	}
+	CHECKCUDA(cudaEventRecord(stage.start, stream));
+	pending.push_back(stage);
+	return (int)pending.size() - 1;
+}
+
+void SparseSurfelFusion::StageProfiler::End(const int stage, cudaStream_t stream)
+{
+	if (stage < 0) return;
+	if (stage >= (int)pending.size()) LOGGING(FATAL) << "StageProfiler: 阶段编号 " << stage << " 不属于当前帧";
+	PendingStage& current = pending[stage];
+	if (current.ended) return;
+	CHECKCUDA(cudaEventRecord(current.end, stream));
+	nvtxRangeEnd(current.range);
+	current.ended = true;
+}
+
+void SparseSurfelFusion::StageProfiler::RecordMetric(const char* name, const int depth, const double value)
+{
+	if (!enabled) return;
+	StageMetric metric;
+	metric.name = name;
+	metric.depth = depth;
+	metric.value = value;
+	pendingMetrics.push_back(metric);
+}
+
+void SparseSurfelFusion::StageProfiler::Resolve()
+{
+	timings.clear();
+	for (size_t i = 0; i < pending.size(); i++) {
+		if (!pending[i].ended) continue;		// 未结束的阶段没有有效的结束事件
+		StageTiming timing;
+		timing.name = pending[i].name;
+		timing.depth = pending[i].depth;
+		CHECKCUDA(cudaEventSynchronize(pending[i].end));
+		CHECKCUDA(cudaEventElapsedTime(&timing.milliseconds, pending[i].start, pending[i].end));
+		timings.push_back(timing);
+	}
+	metrics = pendingMetrics;
+	resolvedFrame = frame;
+}
+
+bool SparseSurfelFusion::StageProfiler::ExportJSON(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open()) return false;
+	file << "{\n  \"frame\": " << resolvedFrame << ",\n  \"stages\": [";
+	for (size_t i = 0; i < timings.size(); i++) {
+		file << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << timings[i].name << "\", \"depth\": " << timings[i].depth << ", \"ms\": " << timings[i].milliseconds << "}";
+	}
+	file << (timings.empty() ? "" : "\n  ") << "],\n  \"metrics\": [";
+	for (size_t i = 0; i < metrics.size(); i++) {
+		file << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << metrics[i].name << "\", \"depth\": " << metrics[i].depth << ", \"value\": " << metrics[i].value << "}";
+	}
+	file << (metrics.empty() ? "" : "\n  ") << "]\n}\n";
+	return file.good();
+}
+
+bool SparseSurfelFusion::StageProfiler::ExportCSV(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open()) return false;
+	file << "type,name,depth,value\n";
+	for (size_t i = 0; i < timings.size(); i++) {
+		file << "stage," << timings[i].name << "," << timings[i].depth << "," << timings[i].milliseconds << "\n";
+	}
+	for (size_t i = 0; i < metrics.size(); i++) {
+		file << "metric," << metrics[i].name << "," << metrics[i].depth << "," << metrics[i].value << "\n";
+	}
+	return file.good();
+}
@@ -0,0 +1,170 @@
+/*****************************************************************//**
+ * \file   StageProfiler.h
+ * \brief  运行时开关的GPU阶段计时：每个阶段(及每层)在所在流上记录一对cudaEvent，并标注NVTX区间
+ *
+ * \author LUOJIAXUAN
+ * \date   June 9th 2024
+ *********************************************************************/
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cuda_runtime_api.h>
+#include <nvtx3/nvToolsExt.h>
+#include <base/DeviceAPI/safe_call.hpp>
+#include <base/Logging.h>
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 阶段计时结果.
+	 */
+	struct StageTiming {
+		std::string name;			// 阶段名称
+		int depth = -1;				// 所属八叉树层，-1表示整个阶段
+		float milliseconds = 0.0f;	// GPU上的耗时
+	};
+
+	/**
+	 * \brief 阶段附带的数值(如每层CG迭代次数与残差).
+	 */
+	struct StageMetric {
+		std::string name;			// 数值名称
+		int depth = -1;				// 所属八叉树层，-1表示整个阶段
+		double value = 0.0;			// 数值
+	};
+
+	/**
+	 * \brief GPU阶段计时器：Begin/End在阶段所在的流上记录事件，不同步流，不影响被测的并发；
+	 *        同时以NVTX区间标注Host端的提交，便于在Nsight Systems中与核函数对应.
+	 *        Resolve时才等待事件并计算耗时，只在需要读取结果时付出同步代价.
+	 *        未开启时Begin返回-1，End忽略-1，开销只有一次判断.
+	 *        CUDA Graph捕获期间不能记录计时事件，调用方应跳过捕获内的阶段.
+	 */
+	class StageProfiler
+	{
+	public:
+		using Ptr = std::shared_ptr<StageProfiler>;
+
+		StageProfiler() = default;
+
+		~StageProfiler();
+
+		/**
+		 * \brief 设置是否计时.
+		 */
+		void SetEnable(const bool enable) { enabled = enable; }
+
+		/**
+		 * \brief 是否正在计时.
+		 */
+		bool IsEnabled() const { return enabled; }
+
+		/**
+		 * \brief 开始新一帧：丢弃上一帧未Resolve的阶段，事件在帧间复用.
+		 */
+		void BeginFrame();
+
+		/**
+		 * \brief 在stream上开始一个阶段.
+		 *
+		 * \param name 阶段名称
+		 * \param stream 阶段所在的流
+		 * \param depth 所属八叉树层，-1表示整个阶段
+		 * \return 阶段编号，未开启计时返回-1
+		 */
+		int Begin(const char* name, cudaStream_t stream, const int depth = -1);
+
+		/**
+		 * \brief 在stream上结束一个阶段.
+		 *
+		 * \param stage Begin返回的阶段编号，-1时忽略
+		 * \param stream 阶段所在的流(与Begin一致)
+		 */
+		void End(const int stage, cudaStream_t stream);
+
+		/**
+		 * \brief 记录本帧的一个数值，Resolve时与计时结果一同输出.
+		 */
+		void RecordMetric(const char* name, const int depth, const double value);
+
+		/**
+		 * \brief 等待本帧所有阶段的结束事件并计算耗时【阻塞线程】.
+		 */
+		void Resolve();
+
+		/**
+		 * \brief 获得最近一次Resolve的计时结果，按Begin的顺序.
+		 */
+		const std::vector<StageTiming>& GetTimings() const { return timings; }
+
+		/**
+		 * \brief 获得最近一次Resolve的数值.
+		 */
+		const std::vector<StageMetric>& GetMetrics() const { return metrics; }
+
+		/**
+		 * \brief 获得最近一次Resolve的帧序号.
+		 */
+		unsigned int GetFrameIndex() const { return resolvedFrame; }
+
+		/**
+		 * \brief 将最近一次Resolve的结果写为JSON.
+		 *
+		 * \param path 文件路径
+		 * \return 文件无法写入时返回false
+		 */
+		bool ExportJSON(const std::string& path) const;
+
+		/**
+		 * \brief 将最近一次Resolve的结果写为CSV，列为type,name,depth,value(阶段的value单位为ms).
+		 *
+		 * \param path 文件路径
+		 * \return 文件无法写入时返回false
+		 */
+		bool ExportCSV(const std::string& path) const;
+
+		/**
+		 * \brief 作用域内的阶段，析构时结束.
+		 */
+		class Scope {
+		public:
+			Scope(StageProfiler* profiler, const char* name, cudaStream_t stream, const int depth = -1)
+				: profiler(profiler), stream(stream), stage(profiler == NULL ? -1 : profiler->Begin(name, stream, depth)) {}
+			~Scope() { if (profiler != NULL) profiler->End(stage, stream); }
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+		private:
+			StageProfiler* profiler;
+			cudaStream_t stream;
+			int stage;
+		};
+
+	private:
+		/**
+		 * \brief 本帧提交的阶段.
+		 */
+		struct PendingStage {
+			std::string name;				// 阶段名称
+			int depth = -1;					// 所属八叉树层
+			cudaEvent_t start = NULL;		// 开始事件
+			cudaEvent_t end = NULL;			// 结束事件
+			nvtxRangeId_t range = 0;		// NVTX区间
+			bool ended = false;				// 是否已调用End
+		};
+
+		bool enabled = false;						// 是否计时
+		std::vector<cudaEvent_t> eventPool;			// 计时事件池
+		unsigned int usedEvents = 0;				// 本帧已使用的事件数量
+		std::vector<PendingStage> pending;			// 本帧提交的阶段
+		std::vector<StageMetric> pendingMetrics;	// 本帧记录的数值
+		unsigned int frame = 0;						// 当前帧序号
+		unsigned int resolvedFrame = 0;				// 最近一次Resolve的帧序号
+		std::vector<StageTiming> timings;			// 最近一次Resolve的计时结果
+		std::vector<StageMetric> metrics;			// 最近一次Resolve的数值
+
+		/**
+		 * \brief 从事件池取出一个本帧未使用的事件.
+		 */
+		cudaEvent_t nextEvent();
+	};
+}
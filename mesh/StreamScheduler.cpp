@@ -0,0 +1,107 @@
+/*****************************************************************//**
+ * \file   StreamScheduler.cpp
+ * \brief  多流阶段调度器实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 2nd 2024
+ *********************************************************************/
+#include "StreamScheduler.h"
+#include <algorithm>
+
+SparseSurfelFusion::StreamScheduler::StreamScheduler(cudaStream_t* streams, const unsigned int streamNum, const unsigned int resourceNum)
+	: streams(streams, streams + streamNum), resources(resourceNum)
+{
+}
+
+SparseSurfelFusion::StreamScheduler::~StreamScheduler()
+{
+	for (size_t i = 0; i < eventPool.size(); i++) {
+		CHECKCUDA(cudaEventDestroy(eventPool[i]));
+	}
+	eventPool.clear();
+}
+
+void SparseSurfelFusion::StreamScheduler::BeginFrame()
+{
+	for (size_t i = 0; i < resources.size(); i++) {
+		resources[i] = ResourceState();
+	}
+	usedEvents = 0;
+}
+
+cudaEvent_t SparseSurfelFusion::StreamScheduler::nextEvent()
+{
+	if (usedEvents == eventPool.size()) {
+		cudaEvent_t event;
+		CHECKCUDA(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+		eventPool.push_back(event);
+	}
+	return eventPool[usedEvents++];
+}
+
+void SparseSurfelFusion::StreamScheduler::addWait(const cudaEvent_t event, const int eventStream, const unsigned int streamIndex)
+{
+	if (event == NULL || eventStream == (int)streamIndex) return;	// 同一条流上天然有序
+	if (std::find(pendingWaits.begin(), pendingWaits.end(), event) != pendingWaits.end()) return;
+	pendingWaits.push_back(event);
+}
+
+void SparseSurfelFusion::StreamScheduler::Run(const unsigned int streamIndex, std::initializer_list<unsigned int> inputs, std::initializer_list<unsigned int> outputs, const std::function<void(cudaStream_t)>& stage)
+{
+	if (streamIndex >= streams.size()) LOGGING(FATAL) << "StreamScheduler: 流编号 " << streamIndex << " 超出范围";
+	for (const unsigned int resource : inputs) {
+		if (resource >= resources.size()) LOGGING(FATAL) << "StreamScheduler: 资源编号 " << resource << " 超出范围";
+	}
+	for (const unsigned int resource : outputs) {
+		if (resource >= resources.size()) LOGGING(FATAL) << "StreamScheduler: 资源编号 " << resource << " 超出范围";
+	}
+
+	// 写后读
+	pendingWaits.clear();
+	for (const unsigned int resource : inputs) {
+		addWait(resources[resource].writer, resources[resource].writerStream, streamIndex);
+	}
+	// 写后写、读后写
+	for (const unsigned int resource : outputs) {
+		const ResourceState& state = resources[resource];
+		addWait(state.writer, state.writerStream, streamIndex);
+		for (size_t i = 0; i < state.readers.size(); i++) {
+			addWait(state.readers[i], state.readerStreams[i], streamIndex);
+		}
+	}
+	cudaStream_t stream = streams[streamIndex];
+	for (const cudaEvent_t event : pendingWaits) {
+		CHECKCUDA(cudaStreamWaitEvent(stream, event, 0));
+	}
+
+	stage(stream);
+
+	const cudaEvent_t done = nextEvent();
+	CHECKCUDA(cudaEventRecord(done, stream));
+	for (const unsigned int resource : inputs) {
+		resources[resource].readers.push_back(done);
+		resources[resource].readerStreams.push_back(streamIndex);
+	}
+	for (const unsigned int resource : outputs) {
+		ResourceState& state = resources[resource];
+		state.writer = done;
+		state.writerStream = streamIndex;
+		state.readers.clear();
+		state.readerStreams.clear();
+	}
+}
+
+void SparseSurfelFusion::StreamScheduler::SynchronizeResource(const unsigned int resource)
+{
+	if (resource >= resources.size()) LOGGING(FATAL) << "StreamScheduler: 资源编号 " << resource << " 超出范围";
+	if (resources[resource].writer != NULL) {
+		CHECKCUDA(cudaEventSynchronize(resources[resource].writer));
+	}
+}
+
+void SparseSurfelFusion::StreamScheduler::Synchronize()
+{
+	for (size_t i = 0; i < streams.size(); i++) {
+		CHECKCUDA(cudaStreamSynchronize(streams[i]));
+	}
+}
@@ -0,0 +1,94 @@
+/*****************************************************************//**
+ * \file   StreamScheduler.h
+ * \brief  按阶段声明的输入、输出资源，在多条cuda流之间用事件连接依赖
+ *
+ * \author LUOJIAXUAN
+ * \date   June 2nd 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include <initializer_list>
+#include <cuda_runtime_api.h>
+#include <base/DeviceAPI/safe_call.hpp>
+#include <base/Logging.h>
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 多流阶段调度器：每个阶段声明运行在哪条流上、读哪些资源、写哪些资源，
+	 *        调度器在阶段提交前让该流等待输入的最后一次写入(写后读)，以及输出的最后一次写入与之后的所有读取(写后写、读后写)，
+	 *        提交后在该流上记录事件.同一条流上的阶段天然有序，不额外等待.
+	 *        阶段内部若使用多条流，需要从所给的流派生并在结束时汇合回所给的流.
+	 *        Host只在需要读取结果(如数量)时同步对应资源，不再在阶段之间同步整个流组.
+	 */
+	class StreamScheduler
+	{
+	public:
+		using Ptr = std::shared_ptr<StreamScheduler>;
+
+		/**
+		 * \brief 构造调度器.
+		 *
+		 * \param streams 可调度的流(由调用方创建与销毁)
+		 * \param streamNum 流的数量
+		 * \param resourceNum 资源数量，资源以[0, resourceNum)编号
+		 */
+		StreamScheduler(cudaStream_t* streams, const unsigned int streamNum, const unsigned int resourceNum);
+
+		~StreamScheduler();
+
+		/**
+		 * \brief 开始新一帧：清空所有资源的读写记录，事件在帧间复用.
+		 *        调用前上一帧提交的阶段必须已经全部入队(事件等待在入队时即已捕获，复用事件是安全的).
+		 */
+		void BeginFrame();
+
+		/**
+		 * \brief 提交一个阶段.
+		 *
+		 * \param streamIndex 阶段运行的流
+		 * \param inputs 阶段读取的资源
+		 * \param outputs 阶段写入的资源
+		 * \param stage 阶段本身，参数为阶段运行的流
+		 */
+		void Run(const unsigned int streamIndex, std::initializer_list<unsigned int> inputs, std::initializer_list<unsigned int> outputs, const std::function<void(cudaStream_t)>& stage);
+
+		/**
+		 * \brief Host阻塞直到资源的最后一次写入完成.
+		 */
+		void SynchronizeResource(const unsigned int resource);
+
+		/**
+		 * \brief Host阻塞直到所有流完成.
+		 */
+		void Synchronize();
+
+	private:
+		/**
+		 * \brief 资源的读写记录.
+		 */
+		struct ResourceState {
+			cudaEvent_t writer = NULL;					// 最后一次写入完成的事件
+			int writerStream = -1;						// 最后一次写入所在的流
+			std::vector<cudaEvent_t> readers;			// 最后一次写入之后的读取完成事件
+			std::vector<int> readerStreams;				// 读取所在的流
+		};
+
+		std::vector<cudaStream_t> streams;				// 可调度的流
+		std::vector<ResourceState> resources;			// 资源读写记录
+		std::vector<cudaEvent_t> eventPool;				// 事件池，每个阶段占用一个
+		unsigned int usedEvents = 0;					// 本帧已使用的事件数量
+		std::vector<cudaEvent_t> pendingWaits;			// 当前阶段需要等待的事件(去重)
+
+		/**
+		 * \brief 从事件池取出一个本帧未使用的事件.
+		 */
+		cudaEvent_t nextEvent();
+
+		/**
+		 * \brief 记录当前阶段需要等待的事件，同一条流上的事件或重复的事件跳过.
+		 */
+		void addWait(const cudaEvent_t event, const int eventStream, const unsigned int streamIndex);
+	};
+}
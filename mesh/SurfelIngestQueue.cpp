@@ -0,0 +1,119 @@
+/*****************************************************************//**
+ * \file   SurfelIngestQueue.cpp
+ * \brief  流式输入队列实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 14th 2024
+ *********************************************************************/
+#include "SurfelIngestQueue.h"
+#include <cstring>
+
+SparseSurfelFusion::SurfelIngestQueue::SurfelIngestQueue(const ReconstructionConfig& config, const int slotNum) : deviceId(config.deviceId), slotCapacity(config.maxSurfelCount), slots(slotNum)
+{
+	if (slotNum < 2) LOGGING(FATAL) << "SurfelIngestQueue至少需要2个槽位才能让上传与重建重叠";
+	CHECKCUDA(cudaSetDevice(deviceId));
+	CHECKCUDA(cudaStreamCreateWithFlags(&uploadStream, cudaStreamNonBlocking));
+	for (int i = 0; i < slotNum; i++) {
+		CHECKCUDA(cudaMallocHost(reinterpret_cast<void**>(&slots[i].hostSurfels), sizeof(DepthSurfel) * slotCapacity));
+		slots[i].surfels.AllocateBuffer(slotCapacity);
+		CHECKCUDA(cudaEventCreateWithFlags(&slots[i].uploaded, cudaEventDisableTiming));
+		CHECKCUDA(cudaEventCreateWithFlags(&slots[i].consumed, cudaEventDisableTiming));
+		freeSlots.push_back(i);
+	}
+}
+
+SparseSurfelFusion::SurfelIngestQueue::~SurfelIngestQueue()
+{
+	Close();
+	CHECKCUDA(cudaSetDevice(deviceId));
+	CHECKCUDA(cudaStreamSynchronize(uploadStream));
+	for (size_t i = 0; i < slots.size(); i++) {
+		CHECKCUDA(cudaEventSynchronize(slots[i].consumed));		// 重建流可能仍在读取槽位显存
+		CHECKCUDA(cudaFreeHost(slots[i].hostSurfels));
+		slots[i].surfels.ReleaseBuffer();
+		CHECKCUDA(cudaEventDestroy(slots[i].uploaded));
+		CHECKCUDA(cudaEventDestroy(slots[i].consumed));
+	}
+	CHECKCUDA(cudaStreamDestroy(uploadStream));
+}
+
+SparseSurfelFusion::DepthSurfel* SparseSurfelFusion::SurfelIngestQueue::BeginFrame()
+{
+	int slot = -1;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (writingSlot >= 0) LOGGING(FATAL) << "SurfelIngestQueue: 上一帧尚未CommitFrame";
+		slotAvailable.wait(lock, [this]() { return closed || !freeSlots.empty(); });
+		if (closed) return NULL;
+		slot = freeSlots.front();
+		freeSlots.pop_front();
+		writingSlot = slot;
+	}
+	// 上一次从该缓冲的上传早已完成(该帧已被重建取走)，同步只是保证Host写入不与DMA读取重叠
+	CHECKCUDA(cudaSetDevice(deviceId));
+	CHECKCUDA(cudaEventSynchronize(slots[slot].uploaded));
+	return slots[slot].hostSurfels;
+}
+
+void SparseSurfelFusion::SurfelIngestQueue::CommitFrame(const unsigned int count)
+{
+	if (writingSlot < 0) LOGGING(FATAL) << "SurfelIngestQueue: CommitFrame之前没有BeginFrame";
+	if (count > slotCapacity) LOGGING(FATAL) << "SurfelIngestQueue: 面元数量 " << count << " 超出槽位容量 " << slotCapacity;
+	IngestSlot& current = slots[writingSlot];
+	CHECKCUDA(cudaSetDevice(deviceId));
+	// 槽位显存被上一帧的重建读取完之后才能覆盖，只在上传流上等待
+	CHECKCUDA(cudaStreamWaitEvent(uploadStream, current.consumed, 0));
+	CHECKCUDA(cudaMemcpyAsync(current.surfels.Ptr(), current.hostSurfels, sizeof(DepthSurfel) * count, cudaMemcpyHostToDevice, uploadStream));
+	CHECKCUDA(cudaEventRecord(current.uploaded, uploadStream));
+	current.surfels.ResizeArrayOrException(count);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	current.frameIndex = committedFrames++;
+	readySlots.push_back(writingSlot);
+	writingSlot = -1;
+	frameAvailable.notify_one();
+}
+
+bool SparseSurfelFusion::SurfelIngestQueue::PushFrame(const DepthSurfel* surfels, const unsigned int count)
+{
+	if (count > slotCapacity) LOGGING(FATAL) << "SurfelIngestQueue: 面元数量 " << count << " 超出槽位容量 " << slotCapacity;
+	DepthSurfel* hostSurfels = BeginFrame();
+	if (hostSurfels == NULL) return false;
+	std::memcpy(hostSurfels, surfels, sizeof(DepthSurfel) * count);
+	CommitFrame(count);
+	return true;
+}
+
+bool SparseSurfelFusion::SurfelIngestQueue::AcquireFrame(IngestFrame& frame)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	frameAvailable.wait(lock, [this]() { return closed || !readySlots.empty(); });
+	if (readySlots.empty()) {
+		frame = IngestFrame();
+		return false;
+	}
+	const int slot = readySlots.front();
+	readySlots.pop_front();
+	frame.slot = slot;
+	frame.frameIndex = slots[slot].frameIndex;
+	frame.surfels = slots[slot].surfels.ArrayView();
+	frame.uploaded = slots[slot].uploaded;
+	frame.consumed = slots[slot].consumed;
+	return true;
+}
+
+void SparseSurfelFusion::SurfelIngestQueue::ReleaseFrame(const IngestFrame& frame)
+{
+	if (!frame.IsValid()) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	freeSlots.push_back(frame.slot);
+	slotAvailable.notify_one();
+}
+
+void SparseSurfelFusion::SurfelIngestQueue::Close()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	closed = true;
+	slotAvailable.notify_all();
+	frameAvailable.notify_all();
+}
@@ -0,0 +1,135 @@
+/*****************************************************************//**
+ * \file   SurfelIngestQueue.h
+ * \brief  流式输入：生产者线程把帧写入页锁定Host缓冲环，在专用流上异步上传，用事件通知八叉树构建
+ *
+ * \author LUOJIAXUAN
+ * \date   June 14th 2024
+ *********************************************************************/
+#pragma once
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+#include <cuda_runtime_api.h>
+#include <base/Logging.h>
+#include <base/CommonTypes.h>
+#include <base/DeviceAPI/safe_call.hpp>
+#include <base/DeviceReadWrite/DeviceBufferArray.h>
+#include "ReconstructionConfig.h"
+
+#define DEFAULT_INGEST_SLOT_NUM 3		// 默认的缓冲槽位数量：一帧在写入，一帧在上传，一帧在重建
+
+namespace SparseSurfelFusion {
+	/**
+	 * \brief 已上传(或正在上传)的一帧.
+	 */
+	struct IngestFrame {
+		int slot = -1;								// 所在的槽位
+		unsigned long long frameIndex = 0;			// 帧序号(从0开始)
+		DeviceArrayView<DepthSurfel> surfels;		// 槽位的显存面元，uploaded之后才有效
+		cudaEvent_t uploaded = NULL;				// 上传完成的事件，重建流等待该事件后读取surfels
+		cudaEvent_t consumed = NULL;				// 重建读取完surfels后在重建流上记录，之后槽位的显存才能被覆盖
+
+		/**
+		 * \brief 是否为有效帧.
+		 */
+		bool IsValid() const { return slot >= 0; }
+	};
+
+	/**
+	 * \brief 面元输入队列：固定数量的槽位，每个槽位有一块页锁定Host缓冲与一块显存.
+	 *        生产者(单线程)用BeginFrame/CommitFrame直接写页锁定缓冲(或用PushFrame拷贝)，提交后在专用上传流上cudaMemcpyAsync到显存；
+	 *        消费者AcquireFrame取出最早提交的帧，重建流只在GPU上等待其上传事件，不阻塞Host，
+	 *        因此第N+1帧的上传与第N帧的求解重叠.槽位在ReleaseFrame后回收，覆盖显存前上传流在GPU上等待consumed事件.
+	 */
+	class SurfelIngestQueue
+	{
+	public:
+		using Ptr = std::shared_ptr<SurfelIngestQueue>;
+
+		/**
+		 * \brief 构造输入队列.
+		 *
+		 * \param config 重建配置，每个槽位容纳config.maxSurfelCount个面元，显存开辟在config.deviceId上
+		 * \param slotNum 槽位数量(至少2)
+		 */
+		SurfelIngestQueue(const ReconstructionConfig& config = ReconstructionConfig(), const int slotNum = DEFAULT_INGEST_SLOT_NUM);
+
+		~SurfelIngestQueue();
+
+		/**
+		 * \brief 【生产者】取得一个空闲槽位的页锁定缓冲，没有空闲槽位时阻塞.
+		 *
+		 * \return 可写入GetSlotCapacity()个面元的缓冲，队列已关闭时返回NULL
+		 */
+		DepthSurfel* BeginFrame();
+
+		/**
+		 * \brief 【生产者】提交BeginFrame取得的缓冲，异步上传前count个面元.
+		 *
+		 * \param count 面元数量，不超过GetSlotCapacity()
+		 */
+		void CommitFrame(const unsigned int count);
+
+		/**
+		 * \brief 【生产者】拷贝一帧面元到空闲槽位并异步上传，没有空闲槽位时阻塞.
+		 *
+		 * \param surfels Host端面元
+		 * \param count 面元数量
+		 * \return 队列已关闭时返回false
+		 */
+		bool PushFrame(const DepthSurfel* surfels, const unsigned int count);
+
+		/**
+		 * \brief 【消费者】取出最早提交的帧，队列为空时阻塞.
+		 *
+		 * \param frame 【输出】帧
+		 * \return 队列已关闭且没有剩余的帧时返回false
+		 */
+		bool AcquireFrame(IngestFrame& frame);
+
+		/**
+		 * \brief 【消费者】归还槽位，调用前frame.consumed必须已经在读取surfels的流上记录.
+		 *
+		 * \param frame AcquireFrame取得的帧
+		 */
+		void ReleaseFrame(const IngestFrame& frame);
+
+		/**
+		 * \brief 关闭队列：生产者不再提交，阻塞中的BeginFrame/PushFrame返回，AcquireFrame取完剩余帧后返回false.
+		 */
+		void Close();
+
+		/**
+		 * \brief 每个槽位可容纳的面元数量.
+		 */
+		unsigned int GetSlotCapacity() const { return slotCapacity; }
+
+	private:
+		/**
+		 * \brief 一个缓冲槽位.
+		 */
+		struct IngestSlot {
+			DepthSurfel* hostSurfels = NULL;			// 页锁定Host缓冲
+			DeviceBufferArray<DepthSurfel> surfels;		// 显存
+			cudaEvent_t uploaded = NULL;				// 上传完成的事件
+			cudaEvent_t consumed = NULL;				// 重建读取完成的事件
+			unsigned long long frameIndex = 0;			// 最近一次提交的帧序号
+		};
+
+		int deviceId = 0;								// 显存所在的设备
+		unsigned int slotCapacity = 0;					// 每个槽位可容纳的面元数量
+		cudaStream_t uploadStream = NULL;				// 上传流
+		std::vector<IngestSlot> slots;					// 缓冲槽位
+
+		std::mutex mutex;								// 保护下列队列状态
+		std::condition_variable slotAvailable;			// 有空闲槽位或队列关闭
+		std::condition_variable frameAvailable;			// 有已提交的帧或队列关闭
+		std::deque<int> freeSlots;						// 空闲槽位
+		std::deque<int> readySlots;						// 已提交、等待重建的槽位
+		int writingSlot = -1;							// 生产者正在写入的槽位
+		unsigned long long committedFrames = 0;			// 已提交的帧数
+		bool closed = false;							// 队列是否关闭
+	};
+}
@@ -0,0 +1,360 @@
+/*****************************************************************//**
+ * \file   CpuLaplacianSolver.cpp
+ * \brief  CPU后端求解器的方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "CpuLaplacianSolver.h"
+#include "CpuParallel.h"
+#include <mesh/FunctionData.h>
+#include <mesh/BinaryNode.h>
+#include <cmath>
+#include <algorithm>
+
+SparseSurfelFusion::cpu::CpuLaplacianSolver::CpuLaplacianSolver()
+{
+	PPolynomial<CONVTIMES> F = PPolynomial<CONVTIMES>::GaussianApproximation();
+	FunctionData<CONVTIMES, double> fData;
+	fData.set(MAX_DEPTH_OCTREE, F, NORMALIZE, 0);
+	const int tableSize = innerProduct.SetLayout(fabs(fData.baseFunction.polys[0].start));
+	switch (NORMALIZE) {
+	case 2:
+		F = F / sqrt((F * F).integral(F.polys[0].start, F.polys[F.polyCount - 1].start));
+		break;
+	case 1:
+		F = F / F.integral(F.polys[0].start, F.polys[F.polyCount - 1].start);
+		break;
+	default:
+		F = F / F(0);
+	}
+	BaseFunctionMaxDepth = ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2>(F.scale(1.0 / (1 << MAX_DEPTH_OCTREE)));
+
+	innerProductTables.resize(3 * (size_t)tableSize);
+	double* tables = innerProductTables.data();
+	fData.setCompactDotTables(innerProduct.pairBase, innerProduct.halfRange, tables, tables + tableSize, tables + 2 * tableSize);
+	innerProduct.dot_F_F = tables;
+	innerProduct.dot_F_DF = tables + tableSize;
+	innerProduct.dot_F_D2F = tables + 2 * tableSize;
+
+	baseFunctions.resize(fData.res);
+	for (int i = 0; i < fData.res; i++) {
+		baseFunctions[i] = fData.baseFunctions[i];
+	}
+}
+
+void SparseSurfelFusion::cpu::CpuLaplacianSolver::BuildVectorField(const CpuOctree& octree)
+{
+	const int pointsNum = octree.PointCount();
+	const int DLevelOffset = octree.DLevelOffset();
+	const int DLevelNodeCount = octree.DLevelNodeCount();
+	float scale = 1.0f;
+	switch (NORMALIZE) {
+	case 2:
+		scale /= sqrt(1.0 / (1 << MAX_DEPTH_OCTREE));
+		break;
+	case 1:
+		scale /= 1.0 / (1 << MAX_DEPTH_OCTREE);
+		break;
+	}
+
+	// 每个点在所在节点中心附近3个位置上每个维度的权重，weights[9 * i + 3 * axis + d]
+	std::vector<float> weights(9 * (size_t)pointsNum);
+#pragma omp parallel for if (pointsNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < pointsNum; i++) {
+		const int* index = octree.FunctionIndex(DLevelOffset + octree.point2Node[i]);
+		const Point3D<float>& point = octree.sortedPoints[i];
+		for (int axis = 0; axis < 3; axis++) {
+			float center, width;
+			BinaryNode<float>::CenterAndWidth(index[axis], center, width);
+			for (int d = 0; d < 3; d++) {
+				weights[9 * i + 3 * axis + d] = value(BaseFunctionMaxDepth, point.coords[axis] - (center + (d - 1) * width));
+			}
+		}
+	}
+
+	// 节点t是其邻居n的第26 - k个邻居(偏移取反)，收集n中所有点在t上的贡献
+	VectorField.assign(DLevelNodeCount, Point3D<float>());
+#pragma omp parallel for schedule(dynamic, 256) if (DLevelNodeCount > CPU_PARALLEL_GRAIN)
+	for (int t = 0; t < DLevelNodeCount; t++) {
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		for (int k = 0; k < 27; k++) {
+			const int neighbor = octree.Neighbor(DLevelOffset + t, k);
+			if (neighbor == -1) continue;
+			const int source = neighbor - DLevelOffset;
+			const int reverse = 26 - k;
+			const int pointsBegin = octree.pidx[source];
+			const int pointsEnd = pointsBegin + octree.pnum[source];
+			for (int i = pointsBegin; i < pointsEnd; i++) {
+				const float* w = &weights[9 * i];
+				const float weight = w[reverse / 9] * w[3 + (reverse / 3) % 3] * w[6 + reverse % 3];
+				const Point3D<float>& normal = octree.sortedNormals[i];
+				sum[0] += weight * normal.coords[0];
+				sum[1] += weight * normal.coords[1];
+				sum[2] += weight * normal.coords[2];
+			}
+		}
+		VectorField[t] = Point3D<float>(float(sum[0] * scale), float(sum[1] * scale), float(sum[2] * scale));
+	}
+}
+
+void SparseSurfelFusion::cpu::CpuLaplacianSolver::ComputeDivergence(const CpuOctree& octree)
+{
+	const int nodeNum = octree.NodeCount();
+	const int DLevelOffset = octree.DLevelOffset();
+	Divergence.assign(nodeNum, 0.0f);
+	// 浅层节点下属的maxDepth层节点多，动态调度避免负载不均
+#pragma omp parallel for schedule(dynamic, 64)
+	for (int o = 0; o < nodeNum; o++) {
+		const int* idxO = octree.FunctionIndex(o);
+		double val = 0.0;
+		for (int k = 0; k < 27; k++) {
+			const int neighbor = octree.Neighbor(o, k);
+			if (neighbor == -1) continue;
+			const int begin = octree.didx[neighbor];
+			const int end = begin + octree.dnum[neighbor];
+			for (int j = begin; j < end; j++) {
+				const Point3D<float>& vo = VectorField[j];
+				if (vo.coords[0] == 0.0f && vo.coords[1] == 0.0f && vo.coords[2] == 0.0f) continue;
+				const int* idxQ = octree.FunctionIndex(DLevelOffset + j);
+				// 与computeNodesDivergenceKernel一致：u = (<F_o, F_q'>_x, <F_o, F_q'>_y, <F_o, F_q'>_z)，val += V_q · u
+				val += vo.coords[0] * float(innerProduct.DotFDF(idxO[0], idxQ[0])) + vo.coords[1] * float(innerProduct.DotFDF(idxO[1], idxQ[1])) + vo.coords[2] * float(innerProduct.DotFDF(idxO[2], idxQ[2]));
+			}
+		}
+		Divergence[o] = float(val);
+	}
+}
+
+double SparseSurfelFusion::cpu::CpuLaplacianSolver::laplacianEntry(const int* idxO_1, const int* idxO_2) const
+{
+	double dot[3], d2Dot[3];
+	for (int i = 0; i < 3; i++) {
+		innerProduct.DotFFAndFD2F(idxO_2[i], idxO_1[i], dot[i], d2Dot[i]);
+	}
+	return double(dot[0] * dot[1] * dot[2] * (d2Dot[0] + d2Dot[1] + d2Dot[2]));
+}
+
+void SparseSurfelFusion::cpu::CpuLaplacianSolver::buildLaplacianMatrix(const CpuOctree& octree, const int depth)
+{
+	const int begin = octree.LevelOffset(depth);
+	const int nodeNum = octree.LevelNodeCount(depth);
+	laplacian.rows = nodeNum;
+	std::vector<int> rowCount(nodeNum);
+	std::vector<int> denseCol(27 * (size_t)nodeNum);
+	std::vector<float> denseVal(27 * (size_t)nodeNum);
+#pragma omp parallel for if (nodeNum > CPU_PARALLEL_GRAIN / 27)
+	for (int i = 0; i < nodeNum; i++) {
+		const int* idxO_1 = octree.FunctionIndex(begin + i);
+		int count = 0;
+		for (int k = 0; k < 27; k++) {
+			const int neighbor = octree.Neighbor(begin + i, k);
+			if (neighbor == -1) continue;
+			const double entry = laplacianEntry(idxO_1, octree.FunctionIndex(neighbor));
+			if (fabs(entry) > EPSILON) {
+				denseCol[27 * i + count] = neighbor - begin;
+				denseVal[27 * i + count] = float(entry);
+				count++;
+			}
+		}
+		rowCount[i] = count;
+	}
+	std::vector<int>& rowOffset = laplacian.rowOffset;
+	rowOffset.assign(rowCount.begin(), rowCount.end());
+	rowOffset.push_back(0);
+	const int nonZeroNum = ExclusiveSum(rowOffset);
+	laplacian.colIndex.resize(nonZeroNum);
+	laplacian.val.resize(nonZeroNum);
+#pragma omp parallel for if (nodeNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < nodeNum; i++) {
+		std::copy(&denseCol[27 * i], &denseCol[27 * i] + rowCount[i], &laplacian.colIndex[rowOffset[i]]);
+		std::copy(&denseVal[27 * i], &denseVal[27 * i] + rowCount[i], &laplacian.val[rowOffset[i]]);
+	}
+}
+
+void SparseSurfelFusion::cpu::CpuLaplacianSolver::subtractCoarserSolution(const CpuOctree& octree, const int depth, const std::vector<float>& coarser)
+{
+	const int begin = octree.LevelOffset(depth);
+	const int nodeNum = octree.LevelNodeCount(depth);
+	cascadicRhs.resize(nodeNum);
+#pragma omp parallel for if (nodeNum > CPU_PARALLEL_GRAIN / 27)
+	for (int i = 0; i < nodeNum; i++) {
+		const int* idxO_1 = octree.FunctionIndex(begin + i);
+		double contribution = 0.0;
+		for (int ancestor = octree.parent[begin + i]; ancestor != -1; ancestor = octree.parent[ancestor]) {
+			for (int k = 0; k < 27; k++) {
+				const int neighbor = octree.Neighbor(ancestor, k);
+				if (neighbor == -1 || coarser[neighbor] == 0.0f) continue;
+				contribution += laplacianEntry(idxO_1, octree.FunctionIndex(neighbor)) * coarser[neighbor];
+			}
+		}
+		cascadicRhs[i] = float(Divergence[begin + i] - contribution);
+	}
+}
+
+int SparseSurfelFusion::cpu::CpuLaplacianSolver::conjugateGradient(const CpuCSRMatrix& A, const float* b, float* x, float& residual)
+{
+	const int n = A.rows;
+	const int* rowOffset = A.rowOffset.data();
+	const int* colIndex = A.colIndex.data();
+	const float* val = A.val.data();
+	cgResidual.resize(n);
+	cgDirection.resize(n);
+	cgAx.resize(n);
+	float* r = cgResidual.data();
+	float* p = cgDirection.data();
+	float* Ap = cgAx.data();
+
+	// x0 = 0，r = b - A * x0 = b
+	double r1 = 0.0;
+#pragma omp parallel for reduction(+:r1) if (n > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < n; i++) {
+		x[i] = 0.0f;
+		r[i] = b[i];
+		r1 += double(r[i]) * r[i];
+	}
+
+	const double tolerance = double(CPU_CG_TOLERANCE) * CPU_CG_TOLERANCE;
+	double r0 = 0.0;
+	int k = 1;
+	while (r1 > tolerance && k <= CPU_CG_MAX_ITERATIONS) {
+		const float beta = k > 1 ? float(r1 / r0) : 0.0f;
+		// p = r + beta * p 与 Ap = A * p 分两趟：SpMV需要完整的p
+#pragma omp parallel for if (n > CPU_PARALLEL_GRAIN)
+		for (int i = 0; i < n; i++) {
+			p[i] = k > 1 ? r[i] + beta * p[i] : r[i];
+		}
+		double pAp = 0.0;
+#pragma omp parallel for reduction(+:pAp) if (n > CPU_PARALLEL_GRAIN / 27)
+		for (int i = 0; i < n; i++) {
+			float sum = 0.0f;
+			for (int e = rowOffset[i]; e < rowOffset[i + 1]; e++) {
+				sum += val[e] * p[colIndex[e]];
+			}
+			Ap[i] = sum;
+			pAp += double(p[i]) * sum;
+		}
+		if (!(pAp > 0.0)) break;	// 矩阵半正定，方向退化时停止，避免NaN污染后续层
+		const float alpha = float(r1 / pAp);
+		r0 = r1;
+		r1 = 0.0;
+#pragma omp parallel for reduction(+:r1) if (n > CPU_PARALLEL_GRAIN)
+		for (int i = 0; i < n; i++) {
+			x[i] += alpha * p[i];
+			r[i] -= alpha * Ap[i];
+			r1 += double(r[i]) * r[i];
+		}
+		k++;
+	}
+	residual = float(sqrt(r1));
+	return k - 1;
+}
+
+void SparseSurfelFusion::cpu::CpuLaplacianSolver::solveDepth(const CpuOctree& octree, const int depth, const std::vector<float>* coarser, std::vector<float>& solution)
+{
+	const int begin = octree.LevelOffset(depth);
+	if (octree.LevelNodeCount(depth) == 0) {
+		cgIterations[depth] = 0;
+		cgResiduals[depth] = 0.0f;
+		return;
+	}
+	buildLaplacianMatrix(octree, depth);
+	const float* rhs = Divergence.data() + begin;
+	if (coarser != NULL && depth > 0) {
+		subtractCoarserSolution(octree, depth, *coarser);
+		rhs = cascadicRhs.data();
+	}
+	cgIterations[depth] = conjugateGradient(laplacian, rhs, solution.data() + begin, cgResiduals[depth]);
+}
+
+void SparseSurfelFusion::cpu::CpuLaplacianSolver::SolveLaplacian(const CpuOctree& octree)
+{
+	dx.assign(octree.NodeCount(), 0.0f);
+	if (!cascadicMode) {
+		// 与LaplacianSolver::enqueueLaplacianSolve一致：第一趟独立求解0 ~ maxDepth - 1层，只作为第二趟的粗层解
+		coarseDx.assign(octree.NodeCount(), 0.0f);
+		for (int depth = 0; depth < MAX_DEPTH_OCTREE; depth++) {
+			solveDepth(octree, depth, NULL, coarseDx);
+		}
+	}
+	const std::vector<float>& coarser = cascadicMode ? dx : coarseDx;
+	for (int depth = 0; depth <= MAX_DEPTH_OCTREE; depth++) {
+		solveDepth(octree, depth, &coarser, dx);
+	}
+}
+
+float SparseSurfelFusion::cpu::CpuLaplacianSolver::accumulateImplicitFunction(const CpuOctree& octree, int node, const Point3D<float>& pos) const
+{
+	float val = 0.0f;
+	while (node != -1) {
+		for (int k = 0; k < 27; k++) {
+			const int neighbor = octree.Neighbor(node, k);
+			if (neighbor == -1 || dx[neighbor] == 0.0f) continue;
+			const int* index = octree.FunctionIndex(neighbor);
+			val += dx[neighbor] * value(baseFunctions[index[0]], pos.coords[0]) * value(baseFunctions[index[1]], pos.coords[1]) * value(baseFunctions[index[2]], pos.coords[2]);
+		}
+		node = octree.parent[node];
+	}
+	return val;
+}
+
+void SparseSurfelFusion::cpu::CpuLaplacianSolver::ComputeIsoValue(const CpuOctree& octree)
+{
+	const int pointsNum = octree.PointCount();
+	const int DLevelOffset = octree.DLevelOffset();
+	double sum = 0.0;
+#pragma omp parallel for reduction(+:sum) schedule(dynamic, 1024)
+	for (int i = 0; i < pointsNum; i++) {
+		sum += accumulateImplicitFunction(octree, DLevelOffset + octree.point2Node[i], octree.sortedPoints[i]);
+	}
+	isoValue = pointsNum > 0 ? float(sum / pointsNum) : 0.0f;
+}
+
+float SparseSurfelFusion::cpu::CpuLaplacianSolver::EvaluateImplicitFunction(const CpuOctree& octree, const Point3D<float>& pos) const
+{
+	for (int i = 0; i < 3; i++) {
+		if (!(pos.coords[i] >= 0.0f && pos.coords[i] <= 1.0f)) return -isoValue;
+	}
+	// pos所在的单元在某层不存在时，该层的邻居仍可能存在且支撑覆盖pos(等值面单元的角点常落在这种位置)，
+	// 因此不能停在包含pos的最深节点：沿pos所在的单元逐层下降，第d + 1层的27邻居是第d层27邻居的孩子，直到整个邻域为空
+	int neighbor[27], finerNeighbor[27];
+	std::fill(neighbor, neighbor + 27, -1);
+	neighbor[13] = 0;
+	int cell[3] = { 0, 0, 0 };
+	float val = 0.0f;
+	for (int depth = 0; ; depth++) {
+		for (int k = 0; k < 27; k++) {
+			const int node = neighbor[k];
+			if (node == -1 || dx[node] == 0.0f) continue;
+			const int* index = octree.FunctionIndex(node);
+			val += dx[node] * value(baseFunctions[index[0]], pos.coords[0]) * value(baseFunctions[index[1]], pos.coords[1]) * value(baseFunctions[index[2]], pos.coords[2]);
+		}
+		if (depth == MAX_DEPTH_OCTREE) break;
+		const int resolution = 1 << (depth + 1);
+		int finerCell[3];
+		for (int i = 0; i < 3; i++) {
+			finerCell[i] = std::min(int(pos.coords[i] * resolution), resolution - 1);
+		}
+		bool empty = true;
+		for (int k = 0; k < 27; k++) {
+			const int offset[3] = { k / 9 - 1, (k / 3) % 3 - 1, k % 3 - 1 };
+			int parentK = 0, childIndex = 0;
+			bool inside = true;
+			for (int i = 0; i < 3; i++) {
+				const int c = finerCell[i] + offset[i];
+				if (c < 0 || c >= resolution) {
+					inside = false;
+					break;
+				}
+				parentK = 3 * parentK + (c >> 1) - cell[i] + 1;
+				childIndex = (childIndex << 1) | (c & 1);
+			}
+			const int parentNode = inside ? neighbor[parentK] : -1;
+			finerNeighbor[k] = parentNode == -1 ? -1 : octree.Child(parentNode, childIndex);
+			if (finerNeighbor[k] != -1) empty = false;
+		}
+		if (empty) break;
+		std::copy(finerNeighbor, finerNeighbor + 27, neighbor);
+		std::copy(finerCell, finerCell + 3, cell);
+	}
+	return val - isoValue;
+}
@@ -0,0 +1,166 @@
+/*****************************************************************//**
+ * \file   CpuLaplacianSolver.h
+ * \brief  CPU后端的向量场、散度与逐层Laplace方程求解，方程组与GPU(ComputeVectorField、ComputeNodesDivergence、LaplacianSolver)逐元素一致
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <memory>
+#include <base/GlobalConfigs.h>
+#include <base/Logging.h>
+#include <mesh/ConfirmedPPolynomial.h>
+#include <mesh/InnerProductTable.cuh>
+
+#include "CpuOctree.h"
+
+#define CPU_CG_TOLERANCE 1e-5f			// 残差二范数的收敛阈值，与solverCG_DeviceToDevice一致
+#define CPU_CG_MAX_ITERATIONS 10000		// 最大迭代次数，与gpuConjugateGradient一致
+
+namespace SparseSurfelFusion {
+	namespace cpu {
+		/**
+		 * \brief 一层的CSR矩阵，列号相对于该层首节点.
+		 *        不复用math/SparseMatrix与math/Vector：前者按行存指针数组，后者的成员定义在Vector.cu中(需要nvcc，且没有显式实例化)，
+		 *        SolveSymmetric的相对残差判据与提前退出也复现不了gpuConjugateGradient的迭代.
+		 */
+		struct CpuCSRMatrix {
+			int rows = 0;
+			std::vector<int> rowOffset;		// 大小为rows + 1
+			std::vector<int> colIndex;		// 非零元列号
+			std::vector<float> val;			// 非零元
+		};
+
+		/**
+		 * \brief CPU后端的求解器：散射改为收集(每个maxDepth层节点汇总邻居中点的贡献)，不需要原子操作，结果与线程数无关.
+		 *        逐层求解 A_d x_d = b_d，A_d只含同层27邻居且丢弃|v| <= EPSILON的元素；级联模式下右端项减去所有祖先的27邻居的贡献，
+		 *        非级联模式与LaplacianSolver相同分两趟：先独立求解0 ~ maxDepth - 1层，再以其作为粗层解修正右端项求解全部层.
+		 *        不支持筛选(screening)、热启动与预条件，这些选项只在GPU后端可用.
+		 */
+		class CpuLaplacianSolver
+		{
+		public:
+			using Ptr = std::shared_ptr<CpuLaplacianSolver>;
+
+			/**
+			 * \brief 构造时预先计算基函数点积表与基函数，与ComputeVectorField::BuildInnerProductTable一致.
+			 */
+			CpuLaplacianSolver();
+
+			~CpuLaplacianSolver() = default;
+
+			/**
+			 * \brief 设置是否使用级联求解：由粗到细，每层求解前从右端项中减去已求得的粗层解的贡献；关闭时两趟求解，与LaplacianSolver::SetCascadicMode一致.
+			 */
+			void SetCascadicMode(const bool enable) { cascadicMode = enable; }
+
+			/**
+			 * \brief 构建maxDepth层节点的向量场.
+			 */
+			void BuildVectorField(const CpuOctree& octree);
+
+			/**
+			 * \brief 计算所有节点的散度.
+			 */
+			void ComputeDivergence(const CpuOctree& octree);
+
+			/**
+			 * \brief 由粗到细逐层组装Laplace矩阵并用共轭梯度法求解.
+			 */
+			void SolveLaplacian(const CpuOctree& octree);
+
+			/**
+			 * \brief 等值为输入点上隐式函数值的平均.
+			 */
+			void ComputeIsoValue(const CpuOctree& octree);
+
+			/**
+			 * \brief 任意点的隐式函数值 - 等值：累加所有支撑覆盖pos的节点(包括pos所在单元不存在的层上的邻居)，与device::evaluateImplicitFunction一致.
+			 *
+			 * \param octree 八叉树
+			 * \param pos 归一化坐标下的查询点
+			 * \return 隐式函数值 - 等值，单位立方体外为 -等值
+			 */
+			float EvaluateImplicitFunction(const CpuOctree& octree, const Point3D<float>& pos) const;
+
+			float GetIsoValue() const { return isoValue; }
+			const std::vector<float>& GetSolution() const { return dx; }
+			const std::vector<float>& GetDivergence() const { return Divergence; }
+			const std::vector<Point3D<float>>& GetVectorField() const { return VectorField; }
+
+			/**
+			 * \brief 第depth层共轭梯度的迭代次数与最终残差.
+			 */
+			int GetIterations(const int depth) const { return cgIterations[depth]; }
+			float GetResidual(const int depth) const { return cgResiduals[depth]; }
+
+		private:
+			InnerProductTableView innerProduct;												// 紧凑点积表视图，指向innerProductTables
+			std::vector<double> innerProductTables;											// <F, F>、<F', F>、<F', F'>三张表
+			std::vector<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> baseFunctions;	// 每个BinaryNode的基函数
+			ConfirmedPPolynomial<CONVTIMES, CONVTIMES + 2> BaseFunctionMaxDepth;				// maxDepth层宽度的基函数，构建向量场使用
+
+			std::vector<Point3D<float>> VectorField;	// maxDepth层节点的向量场
+			std::vector<float> Divergence;				// 节点散度
+			std::vector<float> dx;						// 求解得到的系数
+			std::vector<float> coarseDx;				// 非级联模式第一趟(0 ~ maxDepth - 1层独立求解)的系数
+
+			CpuCSRMatrix laplacian;						// 当前层的Laplace矩阵
+			std::vector<float> cascadicRhs;				// 减去粗层解贡献后的右端项
+			std::vector<float> cgResidual;				// 共轭梯度的残差r
+			std::vector<float> cgDirection;				// 共轭梯度的搜索方向p
+			std::vector<float> cgAx;					// A * p
+
+			float isoValue = 0.0f;
+			bool cascadicMode = false;
+			int cgIterations[MAX_DEPTH_OCTREE + 1] = { 0 };
+			float cgResiduals[MAX_DEPTH_OCTREE + 1] = { 0 };
+
+			/**
+			 * \brief Laplace矩阵元素，与device::GetLaplacianEntry一致.
+			 *
+			 * \param idxO_1 行节点每个维度的基函数index
+			 * \param idxO_2 列节点每个维度的基函数index
+			 */
+			double laplacianEntry(const int* idxO_1, const int* idxO_2) const;
+
+			/**
+			 * \brief 组装第depth层的CSR矩阵：每行最多27个元素，先按27 * N写出再按行偏移压缩.
+			 */
+			void buildLaplacianMatrix(const CpuOctree& octree, const int depth);
+
+			/**
+			 * \brief 右端项减去所有祖先的27邻居(粗层解)的贡献，与SubtractCoarserSolutionKernel一致.
+			 *
+			 * \param coarser 粗层解：级联模式为dx，非级联模式为第一趟的coarseDx
+			 */
+			void subtractCoarserSolution(const CpuOctree& octree, const int depth, const std::vector<float>& coarser);
+
+			/**
+			 * \brief 组装第depth层的矩阵并求解.
+			 *
+			 * \param coarser 右端项减去其中粗层解的贡献，NULL表示直接以散度为右端项
+			 * \param solution 【输出】解(dx或coarseDx)
+			 */
+			void solveDepth(const CpuOctree& octree, const int depth, const std::vector<float>* coarser, std::vector<float>& solution);
+
+			/**
+			 * \brief 共轭梯度法，x的初值为0，迭代与gpuConjugateGradient一致，内积用double累加.
+			 *
+			 * \param A 系数矩阵
+			 * \param b 右端项
+			 * \param x 【输出】解
+			 * \param residual 【输出】最终残差的二范数
+			 * \return 迭代次数
+			 */
+			int conjugateGradient(const CpuCSRMatrix& A, const float* b, float* x, float& residual);
+
+			/**
+			 * \brief 从node开始沿祖先链累加每层27邻居的基函数贡献，与CalculatePointsImplicitFunctionValueKernel一致.
+			 *        pos须位于maxDepth层节点node内，此时祖先的27邻居包含了所有支撑覆盖pos的节点.
+			 */
+			float accumulateImplicitFunction(const CpuOctree& octree, int node, const Point3D<float>& pos) const;
+		};
+	}
+}
@@ -0,0 +1,242 @@
+/*****************************************************************//**
+ * \file   CpuMarchingCubes.cpp
+ * \brief  CPU后端Marching Cubes的方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "CpuMarchingCubes.h"
+#include "CpuParallel.h"
+#include <mesh/MarchingCubesTables.h>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+	const int LatticeBits = MAX_DEPTH_OCTREE + 1;		// 角点坐标取值[0, 2^maxDepth]，需要maxDepth + 1位
+	const SparseSurfelFusion::cpu::CpuKey LatticeMask = (SparseSurfelFusion::cpu::CpuKey(1) << LatticeBits) - 1;
+
+	const int cubeEdgeVertex[12][2] = MARCHING_CUBES_EDGE_VERTEX;
+	const int cubeTrianglesCount[256] = MARCHING_CUBES_TRIANGLES_COUNT;
+	const int cubeTriangles[256][16] = MARCHING_CUBES_TRIANGLES;
+
+	inline SparseSurfelFusion::cpu::CpuKey encodeLattice(const int x, const int y, const int z) {
+		return SparseSurfelFusion::cpu::CpuKey(x) | (SparseSurfelFusion::cpu::CpuKey(y) << LatticeBits) | (SparseSurfelFusion::cpu::CpuKey(z) << (2 * LatticeBits));
+	}
+
+	inline void decodeLattice(const SparseSurfelFusion::cpu::CpuKey key, int* coord) {
+		coord[0] = int(key & LatticeMask);
+		coord[1] = int((key >> LatticeBits) & LatticeMask);
+		coord[2] = int((key >> (2 * LatticeBits)) & LatticeMask);
+	}
+
+	/**
+	 * \brief 角点i相对单元最小角点的偏移，编号与GPU的NodeArray.vertices一致.
+	 */
+	inline void cornerOffset(const int i, int* offset) {
+		offset[1] = (i & 2) >> 1;
+		offset[0] = (i & 1) ^ offset[1];
+		offset[2] = (i & 4) >> 2;
+	}
+
+	/**
+	 * \brief 与device::interpolatePoint一致.
+	 */
+	inline void interpolatePoint(const SparseSurfelFusion::Point3D<float>& p1, const SparseSurfelFusion::Point3D<float>& p2, const int dim, const float v1, const float v2, SparseSurfelFusion::Point3D<float>& out) {
+		for (int i = 0; i < 3; i++) {
+			if (i != dim) out.coords[i] = p1.coords[i];
+		}
+		const float pivot = v1 / (v1 - v2);
+		const float anotherPivot = 1 - pivot;
+		out.coords[dim] = p2.coords[dim] * pivot + p1.coords[dim] * anotherPivot;
+	}
+
+	/**
+	 * \brief 升序序列去重.
+	 */
+	void sortUnique(std::vector<SparseSurfelFusion::cpu::CpuKey>& keys) {
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	}
+}
+
+void SparseSurfelFusion::cpu::CpuMarchingCubes::ExtractMesh(const CpuOctree& octree, const CpuLaplacianSolver& solver)
+{
+	const int resolution = 1 << MAX_DEPTH_OCTREE;
+	cornerKeys.clear();
+	cornerValues.clear();
+	surfaceCells.clear();
+	cellCategory.clear();
+
+	// 面f = 2 * axis + side包含的角点
+	int faceMask[6] = { 0 };
+	for (int i = 0; i < 8; i++) {
+		int offset[3];
+		cornerOffset(i, offset);
+		for (int axis = 0; axis < 3; axis++) faceMask[2 * axis + offset[axis]] |= 1 << i;
+	}
+
+	const int DLevelOffset = octree.DLevelOffset();
+	const int DLevelNodeCount = octree.DLevelNodeCount();
+	std::vector<CpuKey> frontier(DLevelNodeCount);
+#pragma omp parallel for if (DLevelNodeCount > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < DLevelNodeCount; i++) {
+		int coord[3];
+		DecodeLevelKey(octree.key[DLevelOffset + i], MAX_DEPTH_OCTREE, coord);
+		frontier[i] = encodeLattice(coord[0], coord[1], coord[2]);
+	}
+	sortUnique(frontier);
+	std::vector<CpuKey> visited = frontier;
+
+	std::vector<unsigned char> category;
+	std::vector<int> leaf;
+	std::vector<CpuKey> candidates, next, merged;
+	while (!frontier.empty()) {
+		evaluateCorners(octree, solver, frontier);
+		const int cellNum = (int)frontier.size();
+		category.resize(cellNum);
+		leaf.resize(cellNum);
+#pragma omp parallel for if (cellNum > CPU_PARALLEL_GRAIN)
+		for (int i = 0; i < cellNum; i++) {
+			int coord[3];
+			decodeLattice(frontier[i], coord);
+			leaf[i] = octree.LeafContaining(coord);
+			int cubeCatagory = 0;
+			for (int c = 0; c < 8; c++) {
+				int offset[3];
+				cornerOffset(c, offset);
+				if (cornerValue(frontier[i] + encodeLattice(offset[0], offset[1], offset[2])) < 0) cubeCatagory |= 1 << c;
+			}
+			category[i] = (unsigned char)cubeCatagory;
+		}
+
+		// 等值面穿过某个面(面上角点内外不一致)时，面另一侧的单元同样有等值面.
+		// 与GPU的细分一致：maxDepth层单元可进入相邻的粗叶子，粗叶子内的单元只在同一叶子内扩展，避免沿粗层解的伪零点扩散
+		candidates.clear();
+		for (int i = 0; i < cellNum; i++) {
+			const int cubeCatagory = category[i];
+			if (cubeTrianglesCount[cubeCatagory] == 0) continue;
+			surfaceCells.push_back(frontier[i]);
+			cellCategory.push_back(category[i]);
+			int coord[3];
+			decodeLattice(frontier[i], coord);
+			for (int f = 0; f < 6; f++) {
+				const int inside = cubeCatagory & faceMask[f];
+				if (inside == 0 || inside == faceMask[f]) continue;
+				int neighbor[3] = { coord[0], coord[1], coord[2] };
+				neighbor[f >> 1] += (f & 1) ? 1 : -1;
+				if (neighbor[f >> 1] < 0 || neighbor[f >> 1] >= resolution) continue;
+				if (octree.depth[leaf[i]] != MAX_DEPTH_OCTREE && octree.LeafContaining(neighbor) != leaf[i]) continue;
+				candidates.push_back(encodeLattice(neighbor[0], neighbor[1], neighbor[2]));
+			}
+		}
+		sortUnique(candidates);
+		next.clear();
+		std::set_difference(candidates.begin(), candidates.end(), visited.begin(), visited.end(), std::back_inserter(next));
+		merged.clear();
+		std::merge(visited.begin(), visited.end(), next.begin(), next.end(), std::back_inserter(merged));
+		visited.swap(merged);
+		frontier.swap(next);
+	}
+	buildTriangles();
+}
+
+void SparseSurfelFusion::cpu::CpuMarchingCubes::evaluateCorners(const CpuOctree& octree, const CpuLaplacianSolver& solver, const std::vector<CpuKey>& frontier)
+{
+	const int cellNum = (int)frontier.size();
+	std::vector<CpuKey> required(8 * (size_t)cellNum);
+#pragma omp parallel for if (cellNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < cellNum; i++) {
+		for (int c = 0; c < 8; c++) {
+			int offset[3];
+			cornerOffset(c, offset);
+			required[8 * i + c] = frontier[i] + encodeLattice(offset[0], offset[1], offset[2]);
+		}
+	}
+	sortUnique(required);
+	std::vector<CpuKey> fresh;
+	std::set_difference(required.begin(), required.end(), cornerKeys.begin(), cornerKeys.end(), std::back_inserter(fresh));
+
+	const int freshNum = (int)fresh.size();
+	const float inverseResolution = 1.0f / (1 << MAX_DEPTH_OCTREE);
+	std::vector<float> freshValues(freshNum);
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < freshNum; i++) {
+		int coord[3];
+		decodeLattice(fresh[i], coord);
+		const Point3D<float> pos(coord[0] * inverseResolution, coord[1] * inverseResolution, coord[2] * inverseResolution);
+		freshValues[i] = solver.EvaluateImplicitFunction(octree, pos);
+	}
+
+	std::vector<CpuKey> mergedKeys(cornerKeys.size() + fresh.size());
+	std::vector<float> mergedValues(mergedKeys.size());
+	size_t a = 0, b = 0;
+	for (size_t i = 0; i < mergedKeys.size(); i++) {
+		if (b == fresh.size() || (a < cornerKeys.size() && cornerKeys[a] < fresh[b])) {
+			mergedKeys[i] = cornerKeys[a];
+			mergedValues[i] = cornerValues[a++];
+		}
+		else {
+			mergedKeys[i] = fresh[b];
+			mergedValues[i] = freshValues[b++];
+		}
+	}
+	cornerKeys.swap(mergedKeys);
+	cornerValues.swap(mergedValues);
+}
+
+float SparseSurfelFusion::cpu::CpuMarchingCubes::cornerValue(const CpuKey key) const
+{
+	return cornerValues[std::lower_bound(cornerKeys.begin(), cornerKeys.end(), key) - cornerKeys.begin()];
+}
+
+void SparseSurfelFusion::cpu::CpuMarchingCubes::buildTriangles()
+{
+	const int cellNum = (int)surfaceCells.size();
+	std::vector<int> triangleOffset(cellNum);
+	for (int i = 0; i < cellNum; i++) triangleOffset[i] = cubeTrianglesCount[cellCategory[i]];
+	const int triangleNum = ExclusiveSum(triangleOffset);
+
+	// 边的key = 较小端点的key * 3 + 方向，相邻单元共享的边得到同一个key
+	std::vector<CpuKey> edgeKeys(3 * (size_t)triangleNum);
+#pragma omp parallel for if (cellNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < cellNum; i++) {
+		const int cubeCatagory = cellCategory[i];
+		for (int t = 0; t < cubeTrianglesCount[cubeCatagory]; t++) {
+			for (int j = 0; j < 3; j++) {
+				const int edgeIdx = cubeTriangles[cubeCatagory][3 * t + j];
+				const int dir = edgeIdx >> 2;
+				int offset1[3], offset2[3];
+				cornerOffset(cubeEdgeVertex[edgeIdx][0], offset1);
+				cornerOffset(cubeEdgeVertex[edgeIdx][1], offset2);
+				const int* lower = offset1[dir] < offset2[dir] ? offset1 : offset2;
+				const CpuKey corner = surfaceCells[i] + encodeLattice(lower[0], lower[1], lower[2]);
+				edgeKeys[3 * ((size_t)triangleOffset[i] + t) + j] = corner * 3 + dir;
+			}
+		}
+	}
+
+	std::vector<CpuKey> uniqueEdges = edgeKeys;
+	sortUnique(uniqueEdges);
+	const int vertexNum = (int)uniqueEdges.size();
+	const float inverseResolution = 1.0f / (1 << MAX_DEPTH_OCTREE);
+	vertices.resize(vertexNum);
+#pragma omp parallel for if (vertexNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < vertexNum; i++) {
+		const CpuKey corner = uniqueEdges[i] / 3;
+		const int dir = int(uniqueEdges[i] % 3);
+		int coord[3];
+		decodeLattice(corner, coord);
+		const Point3D<float> p1(coord[0] * inverseResolution, coord[1] * inverseResolution, coord[2] * inverseResolution);
+		coord[dir]++;
+		const Point3D<float> p2(coord[0] * inverseResolution, coord[1] * inverseResolution, coord[2] * inverseResolution);
+		interpolatePoint(p1, p2, dir, cornerValue(corner), cornerValue(encodeLattice(coord[0], coord[1], coord[2])), vertices[i]);
+	}
+
+	triangles.resize(triangleNum);
+#pragma omp parallel for if (triangleNum > CPU_PARALLEL_GRAIN)
+	for (int t = 0; t < triangleNum; t++) {
+		for (int j = 0; j < 3; j++) {
+			triangles[t].idx[j] = int(std::lower_bound(uniqueEdges.begin(), uniqueEdges.end(), edgeKeys[3 * (size_t)t + j]) - uniqueEdges.begin());
+		}
+	}
+}
@@ -0,0 +1,68 @@
+/*****************************************************************//**
+ * \file   CpuMarchingCubes.h
+ * \brief  CPU后端的Marching Cubes：在maxDepth层的规则网格上追踪等值面，与GPU共用MarchingCubesTables.h
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <memory>
+#include <mesh/Geometry.h>
+
+#include "CpuOctree.h"
+#include "CpuLaplacianSolver.h"
+
+namespace SparseSurfelFusion {
+	namespace cpu {
+		/**
+		 * \brief 网格单元为maxDepth层节点大小的立方体，单元与角点的key均为 x | y << (maxDepth + 1) | z << 2(maxDepth + 1).
+		 *        以所有maxDepth层节点为种子，逐波沿等值面穿过的面扩展到相邻单元，因此等值面延伸到较粗叶子中时同样连续.
+		 *        每波的角点去重后并行求值，边顶点按边的key去重后只插值一次，三角形绕序与GPU的查找表一致.
+		 *        顶点为归一化坐标，与GPU的GetRebuildMeshVertices一致.
+		 */
+		class CpuMarchingCubes
+		{
+		public:
+			using Ptr = std::shared_ptr<CpuMarchingCubes>;
+
+			CpuMarchingCubes() = default;
+
+			~CpuMarchingCubes() = default;
+
+			/**
+			 * \brief 提取隐式函数的零等值面(求解器返回的值已减去等值).
+			 *
+			 * \param octree 八叉树
+			 * \param solver 已求解的求解器
+			 */
+			void ExtractMesh(const CpuOctree& octree, const CpuLaplacianSolver& solver);
+
+			const std::vector<Point3D<float>>& GetVertices() const { return vertices; }
+			const std::vector<TriangleIndex>& GetTriangles() const { return triangles; }
+
+		private:
+			std::vector<CpuKey> cornerKeys;			// 已求值的角点，按key升序
+			std::vector<float> cornerValues;		// 与cornerKeys对应的隐式函数值
+			std::vector<CpuKey> surfaceCells;		// 等值面穿过的单元
+			std::vector<unsigned char> cellCategory;// 与surfaceCells对应的立方体类型
+			std::vector<Point3D<float>> vertices;	// 网格顶点
+			std::vector<TriangleIndex> triangles;	// 网格三角形
+
+			/**
+			 * \brief 对frontier中单元的所有角点中尚未求值的角点求值，并合并到cornerKeys.
+			 */
+			void evaluateCorners(const CpuOctree& octree, const CpuLaplacianSolver& solver, const std::vector<CpuKey>& frontier);
+
+			/**
+			 * \brief 已求值角点的隐式函数值.
+			 */
+			float cornerValue(const CpuKey key) const;
+
+			/**
+			 * \brief 由等值面单元生成去重的顶点与三角形.
+			 */
+			void buildTriangles();
+		};
+	}
+}
@@ -0,0 +1,292 @@
+/*****************************************************************//**
+ * \file   CpuOctree.cpp
+ * \brief  CPU后端八叉树构建方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "CpuOctree.h"
+#include <cmath>
+#include "CpuParallel.h"
+
+namespace SparseSurfelFusion {
+	namespace cpu {
+		namespace {
+			/**
+			 * \brief 与device::computePointCode相同的逐层二分：坐标大于当前中心时该位为1，x为每3位中的高位.
+			 */
+			CpuKey computePointCode(const Point3D<float>& point) {
+				CpuKey code = 0;
+				float myCenter[3] = { 0.5f, 0.5f, 0.5f };
+				float myWidth = 0.25f;
+				for (int i = MAX_DEPTH_OCTREE - 1; i >= 0; i--) {
+					for (int axis = 0; axis < 3; axis++) {
+						if (point.coords[axis] > myCenter[axis]) {
+							code |= CpuKey(1) << (3 * i + 2 - axis);
+							myCenter[axis] += myWidth;
+						}
+						else {
+							myCenter[axis] -= myWidth;
+						}
+					}
+					myWidth /= 2.0f;
+				}
+				return code;
+			}
+
+			/**
+			 * \brief 有序key去重，可选记录每个唯一key首次出现的位置.
+			 *
+			 * \param sorted 升序的key
+			 * \param unique 【输出】去重后的key
+			 * \param first 【输出】每个唯一key在sorted中首次出现的位置，末尾追加sorted.size()，为NULL则不记录
+			 */
+			void uniqueSortedKeys(const std::vector<CpuKey>& sorted, std::vector<CpuKey>& unique, std::vector<int>* first) {
+				const int n = (int)sorted.size();
+				std::vector<int> label(n);
+#pragma omp parallel for if (n > CPU_PARALLEL_GRAIN)
+				for (int i = 0; i < n; i++) label[i] = (i == 0 || sorted[i] != sorted[i - 1]) ? 1 : 0;
+				const int uniqueNum = ExclusiveSum(label);
+				unique.resize(uniqueNum);
+				if (first != NULL) first->resize(uniqueNum + 1);
+#pragma omp parallel for if (n > CPU_PARALLEL_GRAIN)
+				for (int i = 0; i < n; i++) {
+					if (i == 0 || sorted[i] != sorted[i - 1]) {
+						unique[label[i]] = sorted[i];
+						if (first != NULL) (*first)[label[i]] = i;
+					}
+				}
+				if (first != NULL) (*first)[uniqueNum] = n;
+			}
+		}
+	}
+}
+
+void SparseSurfelFusion::cpu::CpuOctree::BuildOctree(const std::vector<Point3D<float>>& points, const std::vector<Point3D<float>>& normals)
+{
+	if (points.empty()) LOGGING(FATAL) << "CpuOctree: 输入点云为空";
+	if (points.size() != normals.size()) LOGGING(FATAL) << "CpuOctree: 点数量 " << points.size() << " 与法线数量 " << normals.size() << " 不一致";
+	const int pointsNum = (int)points.size();
+
+	std::vector<Point3D<float>> normalizedPoints, scaledNormals;
+	normalizePoints(points, normals, normalizedPoints, scaledNormals);
+
+	// 编码并排序，key相同的点保持输入顺序
+	std::vector<CpuKey> codes(pointsNum);
+	std::vector<int> order(pointsNum);
+#pragma omp parallel for if (pointsNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < pointsNum; i++) {
+		codes[i] = computePointCode(normalizedPoints[i]);
+		order[i] = i;
+	}
+	RadixSortPairs(codes, order, 3 * MAX_DEPTH_OCTREE);
+	sortedPoints.resize(pointsNum);
+	sortedNormals.resize(pointsNum);
+#pragma omp parallel for if (pointsNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < pointsNum; i++) {
+		sortedPoints[i] = normalizedPoints[order[i]];
+		sortedNormals[i] = scaledNormals[order[i]];
+	}
+
+	// 每层含点节点的key：maxDepth层为点编码去重，向上逐层取前缀去重
+	std::vector<std::vector<CpuKey>> occupied(MAX_DEPTH_OCTREE + 1);
+	std::vector<int> firstPoint;
+	uniqueSortedKeys(codes, occupied[MAX_DEPTH_OCTREE], &firstPoint);
+	for (int d = MAX_DEPTH_OCTREE - 1; d >= 0; d--) {
+		const std::vector<CpuKey>& finer = occupied[d + 1];
+		const int finerNum = (int)finer.size();
+		std::vector<CpuKey> prefix(finerNum);
+#pragma omp parallel for if (finerNum > CPU_PARALLEL_GRAIN)
+		for (int i = 0; i < finerNum; i++) prefix[i] = finer[i] >> 3;
+		uniqueSortedKeys(prefix, occupied[d], NULL);
+	}
+
+	std::vector<std::vector<int>> occupiedNode;
+	buildLevels(occupied, occupiedNode);
+	computeNeighbors();
+	computeDLevelRange();
+
+	// maxDepth层节点的点范围与点到节点的映射
+	const int DLevelOffset = levelOffset[MAX_DEPTH_OCTREE];
+	const int DLevelNodeNum = LevelNodeCount(MAX_DEPTH_OCTREE);
+	pidx.assign(DLevelNodeNum, 0);
+	pnum.assign(DLevelNodeNum, 0);
+	point2Node.resize(pointsNum);
+	const int uniqueNum = (int)occupied[MAX_DEPTH_OCTREE].size();
+#pragma omp parallel for if (uniqueNum > CPU_PARALLEL_GRAIN)
+	for (int r = 0; r < uniqueNum; r++) {
+		const int node = occupiedNode[MAX_DEPTH_OCTREE][r] - DLevelOffset;
+		pidx[node] = firstPoint[r];
+		pnum[node] = firstPoint[r + 1] - firstPoint[r];
+		for (int i = firstPoint[r]; i < firstPoint[r + 1]; i++) point2Node[i] = node;
+	}
+}
+
+int SparseSurfelFusion::cpu::CpuOctree::LeafContaining(const int* cell) const
+{
+	int node = 0;
+	for (int d = 0; d < MAX_DEPTH_OCTREE; d++) {
+		const int shift = MAX_DEPTH_OCTREE - 1 - d;
+		const int c = (((cell[0] >> shift) & 1) << 2) | (((cell[1] >> shift) & 1) << 1) | ((cell[2] >> shift) & 1);
+		const int child = Child(node, c);
+		if (child == -1) break;
+		node = child;
+	}
+	return node;
+}
+
+void SparseSurfelFusion::cpu::CpuOctree::normalizePoints(const std::vector<Point3D<float>>& points, const std::vector<Point3D<float>>& normals, std::vector<Point3D<float>>& normalizedPoints, std::vector<Point3D<float>>& scaledNormals)
+{
+	const int pointsNum = (int)points.size();
+	const int threadNum = ThreadNumFor(pointsNum);
+	std::vector<Point3D<float>> threadMin(threadNum, points[0]), threadMax(threadNum, points[0]);
+	// OpenMP 2.0没有min/max归约，每个线程先求自己区间的包围盒
+#pragma omp parallel num_threads(threadNum)
+	{
+		int rank, size;
+		ThreadRank(rank, size);
+		const int begin = (int)((long long)pointsNum * rank / size);
+		const int end = (int)((long long)pointsNum * (rank + 1) / size);
+		for (int i = begin; i < end; i++) {
+			for (int j = 0; j < 3; j++) {
+				threadMin[rank].coords[j] = std::min(threadMin[rank].coords[j], points[i].coords[j]);
+				threadMax[rank].coords[j] = std::max(threadMax[rank].coords[j], points[i].coords[j]);
+			}
+		}
+	}
+	Point3D<float> minPoint = threadMin[0], maxPoint = threadMax[0];
+	for (int t = 1; t < threadNum; t++) {
+		for (int j = 0; j < 3; j++) {
+			minPoint.coords[j] = std::min(minPoint.coords[j], threadMin[t].coords[j]);
+			maxPoint.coords[j] = std::max(maxPoint.coords[j], threadMax[t].coords[j]);
+		}
+	}
+
+	// 与BuildOctree相同：最长边放缩1.25倍，包围盒中点移到[0, 1]立方体中心
+	const float scaleFactor = 1.25f;
+	maxEdge = std::max(std::max(maxPoint.coords[0] - minPoint.coords[0], maxPoint.coords[1] - minPoint.coords[1]), maxPoint.coords[2] - minPoint.coords[2]) * scaleFactor;
+	for (int j = 0; j < 3; j++) center.coords[j] = (maxPoint.coords[j] + minPoint.coords[j]) / 2.0f - maxEdge / 2.0f;
+
+	normalizedPoints.resize(pointsNum);
+	scaledNormals.resize(pointsNum);
+#pragma omp parallel for if (pointsNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < pointsNum; i++) {
+		for (int j = 0; j < 3; j++) normalizedPoints[i].coords[j] = (points[i].coords[j] - center.coords[j]) / maxEdge;
+		// 将法线放缩到[-2^(maxDepth + 1), 2^(maxDepth + 1)]这个区间，而非[-1, 1]
+		const Point3D<float>& normal = normals[i];
+		float len = sqrtf(normal.coords[0] * normal.coords[0] + normal.coords[1] * normal.coords[1] + normal.coords[2] * normal.coords[2]);
+		if (len > EPSILON) len = 1.0f / len;
+		len *= (2 << MAX_DEPTH_OCTREE);
+		for (int j = 0; j < 3; j++) scaledNormals[i].coords[j] = normal.coords[j] * len;
+	}
+}
+
+void SparseSurfelFusion::cpu::CpuOctree::buildLevels(const std::vector<std::vector<CpuKey>>& occupied, std::vector<std::vector<int>>& occupiedNode)
+{
+	levelOffset[0] = 0;
+	levelOffset[1] = 1;
+	for (int d = 1; d <= MAX_DEPTH_OCTREE; d++) {
+		levelOffset[d + 1] = levelOffset[d] + 8 * (int)occupied[d - 1].size();
+	}
+	const int nodeNum = levelOffset[MAX_DEPTH_OCTREE + 1];
+	key.resize(nodeNum);
+	depth.resize(nodeNum);
+	parent.resize(nodeNum);
+	children.assign(8 * (size_t)nodeNum, -1);
+	functionIndex.resize(3 * (size_t)nodeNum);
+	key[0] = 0;
+	depth[0] = 0;
+	parent[0] = -1;
+	functionIndex[0] = functionIndex[1] = functionIndex[2] = 0;
+
+	// 含点节点在八叉树中的位置：第e层第r个含点节点的父节点是第e - 1层含点节点中的第parentRank个
+	occupiedNode.assign(MAX_DEPTH_OCTREE + 1, std::vector<int>());
+	occupiedNode[0].assign(1, 0);
+	for (int d = 1; d <= MAX_DEPTH_OCTREE; d++) {
+		const std::vector<CpuKey>& levelKeys = occupied[d];
+		const std::vector<CpuKey>& parentKeys = occupied[d - 1];
+		const int num = (int)levelKeys.size();
+		occupiedNode[d].resize(num);
+#pragma omp parallel for if (num > CPU_PARALLEL_GRAIN)
+		for (int r = 0; r < num; r++) {
+			const int parentRank = (int)(std::lower_bound(parentKeys.begin(), parentKeys.end(), levelKeys[r] >> 3) - parentKeys.begin());
+			occupiedNode[d][r] = levelOffset[d] + 8 * parentRank + int(levelKeys[r] & 7);
+		}
+	}
+
+	for (int d = 1; d <= MAX_DEPTH_OCTREE; d++) {
+		const std::vector<CpuKey>& parentKeys = occupied[d - 1];
+		const int num = LevelNodeCount(d);
+#pragma omp parallel for if (num > CPU_PARALLEL_GRAIN)
+		for (int i = 0; i < num; i++) {
+			const int node = levelOffset[d] + i;
+			key[node] = (parentKeys[i >> 3] << 3) | CpuKey(i & 7);
+			depth[node] = (unsigned char)d;
+			parent[node] = occupiedNode[d - 1][i >> 3];
+			int coord[3];
+			DecodeLevelKey(key[node], d, coord);
+			for (int j = 0; j < 3; j++) functionIndex[3 * node + j] = (1 << d) - 1 + coord[j];
+		}
+	}
+
+	for (int d = 0; d < MAX_DEPTH_OCTREE; d++) {
+		const int num = (int)occupied[d].size();
+#pragma omp parallel for if (num > CPU_PARALLEL_GRAIN)
+		for (int r = 0; r < num; r++) {
+			const int node = occupiedNode[d][r];
+			for (int c = 0; c < 8; c++) children[8 * node + c] = levelOffset[d + 1] + 8 * r + c;
+		}
+	}
+}
+
+void SparseSurfelFusion::cpu::CpuOctree::computeNeighbors()
+{
+	neighs.assign(27 * (size_t)NodeCount(), -1);
+	neighs[13] = 0;		// 根节点只有自己
+	for (int d = 1; d <= MAX_DEPTH_OCTREE; d++) {
+		const int num = LevelNodeCount(d);
+#pragma omp parallel for if (num > CPU_PARALLEL_GRAIN)
+		for (int i = 0; i < num; i++) {
+			const int node = levelOffset[d] + i;
+			const int father = parent[node];
+			const int sonKey = int(key[node] & 7);
+			const int bit[3] = { sonKey >> 2, (sonKey >> 1) & 1, sonKey & 1 };
+			for (int k = 0; k < 27; k++) {
+				const int offset[3] = { k / 9 - 1, (k / 3) % 3 - 1, k % 3 - 1 };
+				// 邻居在父节点网格上的偏移与其在所属父节点中的孩子号，与LUTparent、LUTchild的查表结果一致
+				int parentK = 0, childC = 0;
+				for (int j = 0; j < 3; j++) {
+					const int t = bit[j] + offset[j];	// [-1, 2]
+					parentK = parentK * 3 + (t < 0 ? 0 : (t > 1 ? 2 : 1));
+					childC = (childC << 1) | (t & 1);
+				}
+				const int neighborParent = neighs[27 * (size_t)father + parentK];
+				neighs[27 * (size_t)node + k] = neighborParent == -1 ? -1 : children[8 * (size_t)neighborParent + childC];
+			}
+		}
+	}
+}
+
+void SparseSurfelFusion::cpu::CpuOctree::computeDLevelRange()
+{
+	const int nodeNum = NodeCount();
+	didx.assign(nodeNum, 0);
+	dnum.assign(nodeNum, 0);
+	const int DLevelOffset = levelOffset[MAX_DEPTH_OCTREE];
+	for (int i = DLevelOffset; i < nodeNum; i++) {
+		didx[i] = i - DLevelOffset;
+		dnum[i] = 1;
+	}
+	for (int d = MAX_DEPTH_OCTREE - 1; d >= 0; d--) {
+		const int num = LevelNodeCount(d);
+#pragma omp parallel for if (num > CPU_PARALLEL_GRAIN)
+		for (int i = 0; i < num; i++) {
+			const int node = levelOffset[d] + i;
+			if (children[8 * (size_t)node] == -1) continue;		// 空节点没有下属的maxDepth层节点
+			didx[node] = didx[children[8 * (size_t)node]];
+			int count = 0;
+			for (int c = 0; c < 8; c++) count += dnum[children[8 * (size_t)node + c]];
+			dnum[node] = count;
+		}
+	}
+}
@@ -0,0 +1,129 @@
+/*****************************************************************//**
+ * \file   CpuOctree.h
+ * \brief  CPU后端的八叉树：并行基数排序点的Morton编码，逐层构建与GPU完全相同的节点集合与拓扑
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <memory>
+#include <base/GlobalConfigs.h>
+#include <base/Logging.h>
+
+#include <mesh/Geometry.h>
+
+namespace SparseSurfelFusion {
+	namespace cpu {
+		using CpuKey = unsigned long long;		// 节点在本层的key：每层3位(x为高位)，第d层共3d位，不左移到maxDepth
+
+		/**
+		 * \brief 由本层key解码节点在第depth层网格上的坐标.
+		 */
+		inline void DecodeLevelKey(const CpuKey key, const int depth, int* coord) {
+			coord[0] = coord[1] = coord[2] = 0;
+			for (int level = depth - 1; level >= 0; level--) {	// 由高位(浅层)到低位(深层)
+				const int sonKey = int(key >> (3 * level)) & 7;
+				coord[0] = (coord[0] << 1) | (sonKey >> 2);
+				coord[1] = (coord[1] << 1) | ((sonKey >> 1) & 1);
+				coord[2] = (coord[2] << 1) | (sonKey & 1);
+			}
+		}
+
+		/**
+		 * \brief 八叉树，节点按层存储，每层按key有序，与GPU的NodeArray顺序一致.
+		 *        第d(d >= 1)层节点是第d - 1层所有含点节点的8个孩子(含空孩子)，第r个含点父节点的孩子位于第d层的[8r, 8r + 8).
+		 *        第0层只有根节点.
+		 */
+		class CpuOctree
+		{
+		public:
+			using Ptr = std::shared_ptr<CpuOctree>;
+
+			CpuOctree() = default;
+
+			~CpuOctree() = default;
+
+			/**
+			 * \brief 归一化点云并构建八叉树：最长边放缩1.25倍后居中到[0, 1]，法线放缩到2^(maxDepth + 1)长度，与BuildOctree一致.
+			 *
+			 * \param points 点坐标(原坐标)
+			 * \param normals 点法线
+			 */
+			void BuildOctree(const std::vector<Point3D<float>>& points, const std::vector<Point3D<float>>& normals);
+
+			int NodeCount() const { return levelOffset[MAX_DEPTH_OCTREE + 1]; }
+			int LevelOffset(const int depth) const { return levelOffset[depth]; }
+			int LevelNodeCount(const int depth) const { return levelOffset[depth + 1] - levelOffset[depth]; }
+			int DLevelOffset() const { return levelOffset[MAX_DEPTH_OCTREE]; }
+			int DLevelNodeCount() const { return LevelNodeCount(MAX_DEPTH_OCTREE); }
+			int PointCount() const { return (int)sortedPoints.size(); }
+			Point3D<float> GetNormalizeCenter() const { return center; }
+			float GetNormalizeMaxEdge() const { return maxEdge; }
+
+			/**
+			 * \brief 第node个节点的孩子c，c = (x << 2) | (y << 1) | z，不存在为-1.
+			 */
+			int Child(const int node, const int c) const { return children[8 * node + c]; }
+
+			/**
+			 * \brief 同层邻居：k = (dx + 1) * 9 + (dy + 1) * 3 + (dz + 1)，与OctNode::neighs的排列一致，不存在为-1.
+			 */
+			int Neighbor(const int node, const int k) const { return neighs[27 * node + k]; }
+
+			/**
+			 * \brief 节点每个维度的基函数index((1 << depth) - 1 + 坐标)，与EncodedFunctionIndex解码的结果一致.
+			 */
+			const int* FunctionIndex(const int node) const { return &functionIndex[3 * node]; }
+
+			/**
+			 * \brief 包含maxDepth层网格单元cell的最深节点(叶子或maxDepth层节点).
+			 *
+			 * \param cell 单元在maxDepth层网格上的坐标
+			 */
+			int LeafContaining(const int* cell) const;
+
+			std::vector<CpuKey> key;						// 节点在本层的key
+			std::vector<unsigned char> depth;				// 节点所在深度
+			std::vector<int> parent;						// 父节点，根节点为-1
+			std::vector<int> children;						// 孩子节点，大小为8 * N
+			std::vector<int> neighs;						// 同层邻居，大小为27 * N
+			std::vector<int> functionIndex;					// 每个维度的基函数index，大小为3 * N
+			std::vector<int> didx;							// 节点下属的maxDepth层节点中第一个(相对于maxDepth层首节点)
+			std::vector<int> dnum;							// 节点下属的maxDepth层节点数量，含空节点
+			std::vector<int> pidx;							// maxDepth层节点在sortedPoints中的第一个点
+			std::vector<int> pnum;							// maxDepth层节点包含的点数量
+			std::vector<Point3D<float>> sortedPoints;		// 按key排序的归一化点
+			std::vector<Point3D<float>> sortedNormals;		// 按key排序的放缩后法线
+			std::vector<int> point2Node;					// 排序后的点所在的maxDepth层节点(相对于maxDepth层首节点)
+
+		private:
+			int levelOffset[MAX_DEPTH_OCTREE + 2] = { 0 };	// 第d层节点位于[levelOffset[d], levelOffset[d + 1])
+			Point3D<float> center;							// 归一化的最小角点
+			float maxEdge = 1.0f;							// 归一化的边长
+
+			/**
+			 * \brief 计算归一化变换，并得到归一化后的点与放缩后的法线.
+			 */
+			void normalizePoints(const std::vector<Point3D<float>>& points, const std::vector<Point3D<float>>& normals, std::vector<Point3D<float>>& normalizedPoints, std::vector<Point3D<float>>& scaledNormals);
+
+			/**
+			 * \brief 逐层构建节点的key、深度、父子关系与基函数index.
+			 *
+			 * \param occupied 每层含点节点的key，按key升序
+			 * \param occupiedNode 【输出】每层含点节点在八叉树中的index
+			 */
+			void buildLevels(const std::vector<std::vector<CpuKey>>& occupied, std::vector<std::vector<int>>& occupiedNode);
+
+			/**
+			 * \brief 由父节点的邻居与孩子逐层(由浅到深)得到同层27邻居.
+			 */
+			void computeNeighbors();
+
+			/**
+			 * \brief 由maxDepth层向上累加每个节点下属的maxDepth层节点范围.
+			 */
+			void computeDLevelRange();
+		};
+	}
+}
@@ -0,0 +1,149 @@
+/*****************************************************************//**
+ * \file   CpuParallel.h
+ * \brief  CPU后端的OpenMP并行原语：基数排序与前缀和
+ *         循环下标均为有符号int，兼容只支持OpenMP 2.0的MSVC；未开启OpenMP时退化为单线程
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define CPU_PARALLEL_GRAIN (1 << 14)		// 每个线程至少处理的元素数量，元素过少时多线程的同步开销大于收益
+
+namespace SparseSurfelFusion {
+	namespace cpu {
+		/**
+		 * \brief 可用的最大线程数.
+		 */
+		inline int MaxThreadNum() {
+#ifdef _OPENMP
+			return omp_get_max_threads();
+#else
+			return 1;
+#endif
+		}
+
+		/**
+		 * \brief 处理n个元素时使用的线程数.
+		 */
+		inline int ThreadNumFor(const int n) {
+			return std::max(1, std::min(MaxThreadNum(), n / CPU_PARALLEL_GRAIN));
+		}
+
+		/**
+		 * \brief 并行区域内当前线程的编号与线程总数.
+		 */
+		inline void ThreadRank(int& rank, int& size) {
+#ifdef _OPENMP
+			rank = omp_get_thread_num();
+			size = omp_get_num_threads();
+#else
+			rank = 0;
+			size = 1;
+#endif
+		}
+
+		/**
+		 * \brief 并行LSD基数排序(稳定)：每趟8位，每个线程统计自己连续区间的直方图，按(数字, 线程)顺序计算写入位置后分散.
+		 *        key相同的元素保持输入顺序，与GPU排序编码低位记录原始index的效果一致.
+		 *
+		 * \param keys 【输入输出】排序的key
+		 * \param values 【输入输出】随key移动的负载
+		 * \param keyBits key的有效位数，只排序低keyBits位
+		 */
+		template<class Key, class Value>
+		void RadixSortPairs(std::vector<Key>& keys, std::vector<Value>& values, const int keyBits) {
+			const int n = (int)keys.size();
+			if (n <= 1) return;
+			std::vector<Key> keysBuffer(n);
+			std::vector<Value> valuesBuffer(n);
+			const int threadNum = ThreadNumFor(n);
+			std::vector<int> histogram(256 * threadNum);
+			for (int shift = 0; shift < keyBits; shift += 8) {
+				bool constantDigit = false;		// 本趟所有key的数字相同，不需要分散
+#pragma omp parallel num_threads(threadNum)
+				{
+					int rank, size;
+					ThreadRank(rank, size);
+					const int begin = (int)((long long)n * rank / size);
+					const int end = (int)((long long)n * (rank + 1) / size);
+					int* count = &histogram[256 * rank];
+					std::fill(count, count + 256, 0);
+					for (int i = begin; i < end; i++) count[(keys[i] >> shift) & 0xff]++;
+#pragma omp barrier
+#pragma omp single
+					{
+						int offset = 0;
+						for (int digit = 0; digit < 256; digit++) {
+							for (int t = 0; t < size; t++) {
+								const int c = histogram[256 * t + digit];
+								histogram[256 * t + digit] = offset;
+								offset += c;
+							}
+						}
+						int nonEmptyDigits = 0;		// 0号线程的写入位置即各数字的起点
+						for (int digit = 0; digit < 256; digit++) {
+							const int first = histogram[digit];
+							const int next = digit == 255 ? n : histogram[digit + 1];
+							if (next > first) nonEmptyDigits++;
+						}
+						constantDigit = nonEmptyDigits <= 1;
+					}
+					if (!constantDigit) {
+						for (int i = begin; i < end; i++) {
+							const int position = count[(keys[i] >> shift) & 0xff]++;
+							keysBuffer[position] = keys[i];
+							valuesBuffer[position] = values[i];
+						}
+					}
+				}
+				if (!constantDigit) {
+					keys.swap(keysBuffer);
+					values.swap(valuesBuffer);
+				}
+			}
+		}
+
+		/**
+		 * \brief 原地排他前缀和，分块并行：各线程先求块内和，再由块偏移完成块内扫描.
+		 *
+		 * \param data 【输入输出】输入为计数，输出为排他前缀和
+		 * \return 总和
+		 */
+		template<class T>
+		T ExclusiveSum(std::vector<T>& data) {
+			const int n = (int)data.size();
+			const int threadNum = ThreadNumFor(n);
+			std::vector<T> blockSum(threadNum + 1, T(0));
+			int blockNum = 1;
+#pragma omp parallel num_threads(threadNum)
+			{
+				int rank, size;
+				ThreadRank(rank, size);
+				if (rank == 0) blockNum = size;
+				const int begin = (int)((long long)n * rank / size);
+				const int end = (int)((long long)n * (rank + 1) / size);
+				T sum = T(0);
+				for (int i = begin; i < end; i++) sum += data[i];
+				blockSum[rank + 1] = sum;
+#pragma omp barrier
+#pragma omp single
+				{
+					for (int t = 0; t < size; t++) blockSum[t + 1] += blockSum[t];
+				}
+				T running = blockSum[rank];
+				for (int i = begin; i < end; i++) {
+					const T value = data[i];
+					data[i] = running;
+					running += value;
+				}
+			}
+			return blockSum[blockNum];
+		}
+	}
+}
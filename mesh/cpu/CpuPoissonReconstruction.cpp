@@ -0,0 +1,96 @@
+/*****************************************************************//**
+ * \file   CpuPoissonReconstruction.cpp
+ * \brief  CPU后端泊松重建的方法实现
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#include "CpuPoissonReconstruction.h"
+#include "CpuParallel.h"
+#include <cmath>
+#include <chrono>
+#include <iostream>
+
+SparseSurfelFusion::cpu::CpuPoissonReconstruction::CpuPoissonReconstruction()
+{
+	OctreePtr = std::make_shared<CpuOctree>();
+	SolverPtr = std::make_shared<CpuLaplacianSolver>();
+	MarchingCubesPtr = std::make_shared<CpuMarchingCubes>();
+}
+
+void SparseSurfelFusion::cpu::CpuPoissonReconstruction::SolvePoissionReconstructionMesh(const std::vector<DepthSurfel>& denseSurfel)
+{
+	const int pointsNum = (int)denseSurfel.size();
+	std::vector<Point3D<float>> points(pointsNum), normals(pointsNum);
+#pragma omp parallel for if (pointsNum > CPU_PARALLEL_GRAIN)
+	for (int i = 0; i < pointsNum; i++) {
+		const float4& vertex = denseSurfel[i].VertexAndConfidence;
+		const float4& normal = denseSurfel[i].NormalAndRadius;
+		points[i] = Point3D<float>(vertex.x, vertex.y, vertex.z);
+		normals[i] = Point3D<float>(normal.x, normal.y, normal.z);
+	}
+	SolvePoissionReconstructionMesh(points, normals);
+}
+
+void SparseSurfelFusion::cpu::CpuPoissonReconstruction::SolvePoissionReconstructionMesh(const std::vector<Point3D<float>>& points, const std::vector<Point3D<float>>& normals)
+{
+	if (points.size() != normals.size()) LOGGING(FATAL) << "CPU重建错误：点数量(" << points.size() << ")与法线数量(" << normals.size() << ")不一致";
+	if (points.empty()) LOGGING(FATAL) << "CPU重建错误：输入点云为空";
+
+#ifdef CHECK_MESH_BUILD_TIME_COST
+	auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
+#endif // CHECK_MESH_BUILD_TIME_COST
+
+	OctreePtr->BuildOctree(points, normals);
+	SolverPtr->BuildVectorField(*OctreePtr);
+	SolverPtr->ComputeDivergence(*OctreePtr);
+	SolverPtr->SolveLaplacian(*OctreePtr);
+	SolverPtr->ComputeIsoValue(*OctreePtr);
+	MarchingCubesPtr->ExtractMesh(*OctreePtr, *SolverPtr);
+
+#ifdef CHECK_MESH_BUILD_TIME_COST
+	auto end = std::chrono::high_resolution_clock::now();						// 记录结束时间点
+	std::chrono::duration<double, std::milli> duration = end - start;			// 计算执行时间（以ms为单位）
+	std::cout << "CPU重建时间(" << MaxThreadNum() << "线程): " << duration.count() << " ms   节点数 = " << OctreePtr->NodeCount()
+		<< "   顶点数 = " << GetRebuildMeshVertices().size() << "   三角形数 = " << GetRebuildMeshTriangleIndices().size() << std::endl;
+	for (int depth = 0; depth <= MAX_DEPTH_OCTREE; depth++) {
+		std::cout << "第 " << depth << " 层迭代次数 = " << SolverPtr->GetIterations(depth) << "   残差 = " << SolverPtr->GetResidual(depth) << std::endl;
+	}
+	std::cout << std::endl;
+#endif // CHECK_MESH_BUILD_TIME_COST
+}
+
+void SparseSurfelFusion::cpu::CpuPoissonReconstruction::QueryImplicitFunction(const std::vector<Point3D<float>>& points, std::vector<float>& values) const
+{
+	const Point3D<float> center = OctreePtr->GetNormalizeCenter();
+	const float maxEdge = OctreePtr->GetNormalizeMaxEdge();
+	const int pointsNum = (int)points.size();
+	values.resize(pointsNum);
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < pointsNum; i++) {
+		Point3D<float> normalized;
+		for (int j = 0; j < 3; j++) normalized.coords[j] = (points[i].coords[j] - center.coords[j]) / maxEdge;
+		values[i] = SolverPtr->EvaluateImplicitFunction(*OctreePtr, normalized);
+	}
+}
+
+SparseSurfelFusion::cpu::ImplicitFunctionComparison SparseSurfelFusion::cpu::CpuPoissonReconstruction::CompareImplicitFunction(const std::vector<float>& cpuValues, const std::vector<float>& gpuValues)
+{
+	if (cpuValues.size() != gpuValues.size()) LOGGING(FATAL) << "CPU与GPU的查询值数量不一致：" << cpuValues.size() << " vs " << gpuValues.size();
+	ImplicitFunctionComparison comparison;
+	const int n = (int)cpuValues.size();
+	if (n == 0) return comparison;
+	double sum = 0.0;
+	int mismatch = 0;
+	float maxDifference = 0.0f;
+	for (int i = 0; i < n; i++) {
+		const float difference = fabs(cpuValues[i] - gpuValues[i]);
+		sum += difference;
+		maxDifference = std::max(maxDifference, difference);
+		if ((cpuValues[i] < 0) != (gpuValues[i] < 0)) mismatch++;
+	}
+	comparison.maxAbsDifference = maxDifference;
+	comparison.meanAbsDifference = float(sum / n);
+	comparison.signMismatchRatio = float(mismatch) / n;
+	return comparison;
+}
@@ -0,0 +1,98 @@
+/*****************************************************************//**
+ * \file   CpuPoissonReconstruction.h
+ * \brief  CPU后端的泊松重建：没有NVIDIA GPU的节点上使用，接口与PoissonReconstruction的同名方法一致，
+ *         也可用于校验GPU的重建结果
+ *
+ * \author LUOJIAXUAN
+ * \date   June 15th 2024
+ *********************************************************************/
+#pragma once
+#include <vector>
+#include <memory>
+#include <base/SurfelTypes.h>
+#include <base/GlobalConfigs.h>
+#include <base/Logging.h>
+#include <mesh/Geometry.h>
+
+#include "CpuOctree.h"
+#include "CpuLaplacianSolver.h"
+#include "CpuMarchingCubes.h"
+
+namespace SparseSurfelFusion {
+	namespace cpu {
+		/**
+		 * \brief CPU与GPU在同一批查询点上的隐式函数值差异.
+		 */
+		struct ImplicitFunctionComparison {
+			float maxAbsDifference = 0.0f;		// 最大绝对误差
+			float meanAbsDifference = 0.0f;		// 平均绝对误差
+			float signMismatchRatio = 0.0f;		// 内外判断不一致的比例
+		};
+
+		class CpuPoissonReconstruction
+		{
+		public:
+			using Ptr = std::shared_ptr<CpuPoissonReconstruction>;
+
+			CpuPoissonReconstruction();
+
+			~CpuPoissonReconstruction() = default;
+
+			/**
+			 * \brief 由面元重建网格，使用VertexAndConfidence与NormalAndRadius的(x, y, z).
+			 *
+			 * \param denseSurfel 稠密面元
+			 */
+			void SolvePoissionReconstructionMesh(const std::vector<DepthSurfel>& denseSurfel);
+
+			/**
+			 * \brief 由有向点云重建网格.
+			 *
+			 * \param points 点坐标(原坐标)
+			 * \param normals 点法线
+			 */
+			void SolvePoissionReconstructionMesh(const std::vector<Point3D<float>>& points, const std::vector<Point3D<float>>& normals);
+
+			/**
+			 * \brief 获得最近一次重建的网格顶点(归一化坐标，原坐标 = 顶点 * GetNormalizeMaxEdge() + GetNormalizeCenter()).
+			 */
+			const std::vector<Point3D<float>>& GetRebuildMeshVertices() const { return MarchingCubesPtr->GetVertices(); }
+
+			/**
+			 * \brief 获得最近一次重建的网格三角形.
+			 */
+			const std::vector<TriangleIndex>& GetRebuildMeshTriangleIndices() const { return MarchingCubesPtr->GetTriangles(); }
+
+			Point3D<float> GetNormalizeCenter() const { return OctreePtr->GetNormalizeCenter(); }
+			float GetNormalizeMaxEdge() const { return OctreePtr->GetNormalizeMaxEdge(); }
+			float GetIsoValue() const { return SolverPtr->GetIsoValue(); }
+
+			/**
+			 * \brief 设置是否使用级联求解，与PoissonReconstruction::SetCascadicMode一致.
+			 */
+			void SetCascadicMode(const bool enable) { SolverPtr->SetCascadicMode(enable); }
+
+			/**
+			 * \brief 在最近一次重建的隐式函数上批量并行查询任意点，在SolvePoissionReconstructionMesh之后调用.
+			 *
+			 * \param points 查询点(原坐标)
+			 * \param values 【输出】隐式函数值 - 等值，符号约定与GPU后端一致，数值不是欧氏距离
+			 */
+			void QueryImplicitFunction(const std::vector<Point3D<float>>& points, std::vector<float>& values) const;
+
+			/**
+			 * \brief 比较CPU查询值与GPU(PoissonReconstruction::QueryImplicitFunction)在同一批点上的查询值.
+			 *
+			 * \param cpuValues CPU后端的查询值
+			 * \param gpuValues GPU后端的查询值
+			 * \return 差异统计
+			 */
+			static ImplicitFunctionComparison CompareImplicitFunction(const std::vector<float>& cpuValues, const std::vector<float>& gpuValues);
+
+		private:
+			CpuOctree::Ptr OctreePtr;					// 八叉树
+			CpuLaplacianSolver::Ptr SolverPtr;			// 向量场、散度与Laplace求解
+			CpuMarchingCubes::Ptr MarchingCubesPtr;		// 等值面提取
+		};
+	}
+}
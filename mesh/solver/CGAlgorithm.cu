@@ -7,7 +7,7 @@
  *********************************************************************/
 #include "CGAlgorithm.cuh"
 
-extern "C" __global__ void gpuConjugateGradient(int* I, int* J, float* val, float* x, float* Ax, float* p, float* r, double* dot_result, int nnz, int N, float tol)
+extern "C" __global__ void gpuConjugateGradient(int* I, int* J, float* val, float* x, float* Ax, float* p, float* r, double* dot_result, int* iterations, int nnz, int N, float tol)
 {
     cg::thread_block cta = cg::this_thread_block();
     cg::grid_group grid = cg::this_grid();
@@ -77,6 +77,101 @@ extern "C" __global__ void gpuConjugateGradient(int* I, int* J, float* val, floa
 
         k++;
     }
+
+    if (threadIdx.x == 0 && blockIdx.x == 0) *iterations = k - 1;
+}
+
+extern "C" __global__ void gpuJacobiPreconditionedConjugateGradient(int* I, int* J, float* val, const float* invDiagonal, float* x, float* Ax, float* p, float* r, float* z, double* dot_result, int* iterations, int nnz, int N, float tol)
+{
+    cg::thread_block cta = cg::this_thread_block();
+    cg::grid_group grid = cg::this_grid();
+
+    int max_iter = 10000;
+
+    float alpha = 1.0;
+    float alpham1 = -1.0;
+    double rz = 0.0, rz_old = 0.0, rr;
+    float b, a, na;
+
+    SparseSurfelFusion::device::gpuSpMV(I, J, val, nnz, N, alpha, x, Ax, cta, grid);
+
+    cg::sync(grid);
+
+    SparseSurfelFusion::device::gpuSaxpy(Ax, r, alpham1, N, grid);
+
+    cg::sync(grid);
+
+    SparseSurfelFusion::device::gpuJacobiPrecondition(invDiagonal, r, z, N, grid);
+
+    cg::sync(grid);
+
+    SparseSurfelFusion::device::gpuDotProduct(r, z, &dot_result[0], N, cta, grid);
+
+    cg::sync(grid);
+
+    SparseSurfelFusion::device::gpuDotProduct(r, r, &dot_result[1], N, cta, grid);
+
+    cg::sync(grid);
+
+    rz = dot_result[0];
+    rr = dot_result[1];
+
+    int k = 1;
+    while (rr > tol * tol && k <= max_iter) {
+        if (k > 1) {
+            b = rz / rz_old;
+            SparseSurfelFusion::device::gpuScaleVectorAndSaxpy(z, p, alpha, b, N, grid);
+        }
+        else {
+            SparseSurfelFusion::device::gpuCopyVector(z, p, N, grid);
+        }
+
+        cg::sync(grid);
+
+        SparseSurfelFusion::device::gpuSpMV(I, J, val, nnz, N, alpha, p, Ax, cta, grid);
+
+        if (threadIdx.x == 0 && blockIdx.x == 0) dot_result[0] = 0.0;
+
+        cg::sync(grid);
+
+        SparseSurfelFusion::device::gpuDotProduct(p, Ax, &dot_result[0], N, cta, grid);
+
+        cg::sync(grid);
+
+        a = rz / dot_result[0];
+
+        SparseSurfelFusion::device::gpuSaxpy(p, x, a, N, grid);
+
+        na = -a;
+        SparseSurfelFusion::device::gpuSaxpy(Ax, r, na, N, grid);
+
+        cg::sync(grid);
+
+        SparseSurfelFusion::device::gpuJacobiPrecondition(invDiagonal, r, z, N, grid);
+
+        if (threadIdx.x == 0 && blockIdx.x == 0) {
+            dot_result[0] = 0.0;
+            dot_result[1] = 0.0;
+        }
+
+        cg::sync(grid);
+
+        SparseSurfelFusion::device::gpuDotProduct(r, z, &dot_result[0], N, cta, grid);
+
+        cg::sync(grid);
+
+        SparseSurfelFusion::device::gpuDotProduct(r, r, &dot_result[1], N, cta, grid);
+
+        cg::sync(grid);
+
+        rz_old = rz;
+        rz = dot_result[0];
+        rr = dot_result[1];
+
+        k++;
+    }
+
+    if (threadIdx.x == 0 && blockIdx.x == 0) *iterations = k - 1;
 }
 
 __device__ void SparseSurfelFusion::device::gpuSpMV(int* I, int* J, float* val, int nnz, int num_rows, float alpha, float* inputVecX, float* outputVecY, cg::thread_block& cta, const cg::grid_group& grid)
@@ -149,6 +244,86 @@ __device__ void SparseSurfelFusion::device::gpuScaleVectorAndSaxpy(const float*
 
 
 
+__device__ void SparseSurfelFusion::device::gpuJacobiPrecondition(const float* invDiagonal, const float* r, float* z, int size, const cg::grid_group& grid)
+{
+    for (int i = grid.thread_rank(); i < size; i += grid.size()) {
+        z[i] = invDiagonal[i] * r[i];
+    }
+}
+
+__global__ void SparseSurfelFusion::device::extractInverseDiagonal(const int* I, const int* J, const float* val, const int N, float* invDiagonal)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= N)	return;
+    float inv = 1.0f;
+    for (int i = I[idx]; i < I[idx + 1]; i++) {
+        if (J[i] == idx) {
+            if (fabsf(val[i]) > EPSILON) inv = 1.0f / val[i];
+            break;
+        }
+    }
+    invDiagonal[idx] = inv;
+}
+
+__global__ void SparseSurfelFusion::device::gpuComputeResidualDouble(const int* I, const int* J, const float* val, const float* x, const float* rhs, const int N, float* residual)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= N)	return;
+    double sum = 0.0;
+    for (int i = I[idx]; i < I[idx + 1]; i++) {
+        sum += static_cast<double>(val[i]) * static_cast<double>(x[J[i]]);
+    }
+    residual[idx] = static_cast<float>(static_cast<double>(rhs[idx]) - sum);
+}
+
+__global__ void SparseSurfelFusion::device::gpuResidualSquaredNormDouble(const int* I, const int* J, const float* val, const float* x, const float* rhs, const int N, double* squaredNorm)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    double residual = 0.0;
+    if (idx < N) {
+        double sum = 0.0;
+        for (int i = I[idx]; i < I[idx + 1]; i++) {
+            sum += static_cast<double>(val[i]) * static_cast<double>(x[J[i]]);
+        }
+        residual = static_cast<double>(rhs[idx]) - sum;
+    }
+    double squared = residual * residual;
+    for (int offset = 16; offset > 0; offset >>= 1) squared += __shfl_down_sync(0xFFFFFFFF, squared, offset);
+    if ((threadIdx.x & 31) == 0) atomicAdd(squaredNorm, squared);
+}
+
+__global__ void SparseSurfelFusion::device::gpuAddCorrection(const float* correction, const int N, float* x)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= N)	return;
+    x[idx] += correction[idx];
+}
+
+__global__ void SparseSurfelFusion::device::computeMaxAbsDiagonal(const int* I, const int* J, const float* val, const int N, float* maxAbsDiagonal)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    float diagonal = 0.0f;
+    if (idx < N) {
+        for (int i = I[idx]; i < I[idx + 1]; i++) {
+            if (J[i] == idx) {
+                diagonal = fabsf(val[i]);
+                break;
+            }
+        }
+    }
+    for (int offset = 16; offset > 0; offset >>= 1) diagonal = fmaxf(diagonal, __shfl_down_sync(0xFFFFFFFF, diagonal, offset));
+    // 非负float的位模式与数值同序，按int比较即可
+    if ((threadIdx.x & 31) == 0) atomicMax(reinterpret_cast<int*>(maxAbsDiagonal), __float_as_int(diagonal));
+}
+
+__global__ void SparseSurfelFusion::device::convertToHalf(const float* src, const int* nnz, const float* scale, __half* dst)
+{
+    const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
+    if (idx >= *nnz)	return;
+    const float inverseScale = (*scale > 0.0f) ? 1.0f / (*scale) : 1.0f;
+    dst[idx] = __float2half(src[idx] * inverseScale);
+}
+
 __global__ void SparseSurfelFusion::device::gpuGetTestSummary(int* I, int* J, float* val, float* x, float* rhs, int* err, int num)
 {
     const unsigned int idx = threadIdx.x + blockDim.x * blockIdx.x;
@@ -293,45 +468,58 @@ bool SparseSurfelFusion::areAlmostEqual(float a, float b, float maxRelDiff)
     }
 }
 
-void SparseSurfelFusion::solverCG_DeviceToDevice(const int& N, const int& nz, int* I, int* J, float* val, float* rhs, float* x, cudaStream_t stream)
+void SparseSurfelFusion::solverCG_DeviceToDevice(const int& N, const int& nz, int* I, int* J, float* val, float* rhs, float* x, const CGWorkspace& workspace, cudaStream_t stream)
 {
     const float tol = 1e-5f;
-    double r1 = 0;      // 记录残差
-    float* r = NULL;    // 运行 CG 算法的临时内存
-    float* p = NULL;    // 运行 CG 算法的临时内存
-    float* Ax = NULL;   // 运行 CG 算法的临时内存
+    double r1 = 0;                  // 记录残差
+    float* r = workspace.r;         // 运行 CG 算法的临时内存
+    float* p = workspace.p;         // 运行 CG 算法的临时内存
+    float* Ax = workspace.Ax;       // 运行 CG 算法的临时内存
+    double* dot_result = workspace.dot_result;
     //cudaEvent_t start, stop;
 
     //printf("开始 [%s]...\n", "共轭梯度多块计算 (Conjugate Gradient MultiBlock CG)");
 
-    // This will pick the best possible CUDA capable device
-    cudaDeviceProp deviceProp;
+    // 设备属性与占用率每个设备只查询一次，之后每层、每帧复用
+    // 多个线程(如批量重建的各通道)可能同时在同一设备上求解，查询放在call_once中，返回后其余线程读到的都是完整的值
+    static int numSmsOfDevice[MAX_RECONSTRUCTION_DEVICES] = { 0 };
+    static int numBlocksPerSmOfDevice[MAX_RECONSTRUCTION_DEVICES] = { 0 };
+    static int numBlocksPerSmOfDevice_PCG[MAX_RECONSTRUCTION_DEVICES] = { 0 };
+    static std::once_flag deviceQueried[MAX_RECONSTRUCTION_DEVICES];
     int devID = 0;
-    CHECKCUDA(cudaGetDeviceProperties(&deviceProp, devID));
-
-    if (!deviceProp.managedMemory) {
-        // This sample requires being run on a device that supports Unified Memory
-        fprintf(stderr, "此设备不支持统一内存 \n");
-        exit(EXIT_WAIVED);
-    }
+    CHECKCUDA(cudaGetDevice(&devID));
+    if (devID >= MAX_RECONSTRUCTION_DEVICES) LOGGING(FATAL) << "设备号 " << devID << " 超出MAX_RECONSTRUCTION_DEVICES";
+    int sMemSize = sizeof(double) * ((THREADS_PER_BLOCK / 32) + 1);
+    int numThreads = THREADS_PER_BLOCK;
+    std::call_once(deviceQueried[devID], [devID, numThreads, sMemSize]() {
+        // This will pick the best possible CUDA capable device
+        cudaDeviceProp deviceProp;
+        CHECKCUDA(cudaGetDeviceProperties(&deviceProp, devID));
+
+        if (!deviceProp.managedMemory) {
+            // This sample requires being run on a device that supports Unified Memory
+            fprintf(stderr, "此设备不支持统一内存 \n");
+            exit(EXIT_WAIVED);
+        }
 
-    // This sample requires being run on a device that supports Cooperative Kernel Launch
-    if (!deviceProp.cooperativeLaunch) {
-        printf( "\n选择的 GPU (%d) 不支持协作核函数启动 (Cooperative Kernel Launch), 放弃运行\n", devID);
-        exit(EXIT_WAIVED);
-    }
+        // This sample requires being run on a device that supports Cooperative Kernel Launch
+        if (!deviceProp.cooperativeLaunch) {
+            printf( "\n选择的 GPU (%d) 不支持协作核函数启动 (Cooperative Kernel Launch), 放弃运行\n", devID);
+            exit(EXIT_WAIVED);
+        }
 
-    // Statistics about the GPU device
-    //printf("> GPU 设备有 %d 个流处理器, 流处理器计算能力 %d.%d \n\n", deviceProp.multiProcessorCount, deviceProp.major, deviceProp.minor);
+        // Statistics about the GPU device
+        //printf("> GPU 设备有 %d 个流处理器, 流处理器计算能力 %d.%d \n\n", deviceProp.multiProcessorCount, deviceProp.major, deviceProp.minor);
 
-    double* dot_result = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&dot_result), sizeof(double), stream));
-    CHECKCUDA(cudaMemsetAsync(dot_result, 0.0, sizeof(double), stream));
+        CHECKCUDA(cudaOccupancyMaxActiveBlocksPerMultiprocessor(&numBlocksPerSmOfDevice[devID], gpuConjugateGradient, numThreads, sMemSize));
+        CHECKCUDA(cudaOccupancyMaxActiveBlocksPerMultiprocessor(&numBlocksPerSmOfDevice_PCG[devID], gpuJacobiPreconditionedConjugateGradient, numThreads, sMemSize));
+        numSmsOfDevice[devID] = deviceProp.multiProcessorCount;
+    });
+    const int numSms = numSmsOfDevice[devID];
+    const int numBlocksPerSm = numBlocksPerSmOfDevice[devID];
+    const int numBlocksPerSm_PCG = numBlocksPerSmOfDevice_PCG[devID];
 
-    // 运行 CG 算法的临时内存
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&r) , N * sizeof(float), stream));
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&p) , N * sizeof(float), stream));
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&Ax), N * sizeof(float), stream));
+    CHECKCUDA(cudaMemsetAsync(dot_result, 0.0, sizeof(double) * 2, stream));
 
 #if ENABLE_CPU_DEBUG_CODE
     float* Ax_cpu = reinterpret_cast<float*>(malloc(sizeof(float) * N));
@@ -347,38 +535,80 @@ void SparseSurfelFusion::solverCG_DeviceToDevice(const int& N, const int& nz, in
 #endif
 
     CHECKCUDA(cudaMemcpyAsync(r, rhs, sizeof(float) * N, cudaMemcpyDeviceToDevice, stream));
-    CHECKCUDA(cudaMemsetAsync(x, 0.0, sizeof(float) * N, stream));
+    if (!workspace.useInitialGuess) CHECKCUDA(cudaMemsetAsync(x, 0.0, sizeof(float) * N, stream));
 
-    void* kernelArgs[] = {
-            (void*)&I , (void*)&J, (void*)&val, (void*)&x,
-            (void*)&Ax, (void*)&p, (void*)&r  , (void*)&dot_result,
-            (void*)&nz, (void*)&N, (void*)&tol,
-    };
+    int* iterations = workspace.iterations;
+    dim3 dimBlock(THREADS_PER_BLOCK, 1, 1);
+    // 协作核函数的网格按系统规模缩小，粗层的小系统不再独占全部SM，多个流上的求解可以同时驻留
+    const int neededBlocks = pcl::gpu::divUp(N, THREADS_PER_BLOCK);
+    if (workspace.invDiagonal == NULL) {
+        void* kernelArgs[] = {
+                (void*)&I , (void*)&J, (void*)&val, (void*)&x,
+                (void*)&Ax, (void*)&p, (void*)&r  , (void*)&dot_result,
+                (void*)&iterations, (void*)&nz, (void*)&N, (void*)&tol,
+        };
+        dim3 dimGrid(std::max(1, std::min(numSms * numBlocksPerSm, neededBlocks)), 1, 1);
+        CHECKCUDA(cudaLaunchCooperativeKernel((void*)gpuConjugateGradient, dimGrid, dimBlock, kernelArgs, sMemSize, stream));
+    }
+    else {
+        const float* invDiagonal = workspace.invDiagonal;
+        float* z = workspace.z;
+        dim3 block(128);
+        dim3 grid(pcl::gpu::divUp(N, block.x));
+        if (!workspace.invDiagonalReady) device::extractInverseDiagonal << <grid, block, 0, stream >> > (I, J, val, N, workspace.invDiagonal);	// 对角Jacobi预条件子
+        void* kernelArgs[] = {
+                (void*)&I , (void*)&J, (void*)&val, (void*)&invDiagonal, (void*)&x,
+                (void*)&Ax, (void*)&p, (void*)&r  , (void*)&z, (void*)&dot_result,
+                (void*)&iterations, (void*)&nz, (void*)&N, (void*)&tol,
+        };
+        dim3 dimGrid(std::max(1, std::min(numSms * numBlocksPerSm_PCG, neededBlocks)), 1, 1);
+        CHECKCUDA(cudaLaunchCooperativeKernel((void*)gpuJacobiPreconditionedConjugateGradient, dimGrid, dimBlock, kernelArgs, sMemSize, stream));
+    }
 
-    int sMemSize = sizeof(double) * ((THREADS_PER_BLOCK / 32) + 1);
-    int numBlocksPerSm = 0;
-    int numThreads = THREADS_PER_BLOCK;
+#if ENABLE_CPU_DEBUG_CODE
+    cpuConjugateGrad(I, J, val, x_cpu, Ax_cpu, p_cpu, r_cpu, nz, N, tol);
 
-    CHECKCUDA(cudaOccupancyMaxActiveBlocksPerMultiprocessor(&numBlocksPerSm, gpuConjugateGradient, numThreads, sMemSize));
+    free(Ax_cpu);
+    free(r_cpu);
+    free(p_cpu);
+    free(x_cpu);
+#endif
 
-    int numSms = deviceProp.multiProcessorCount;
-    dim3 dimGrid(numSms * numBlocksPerSm, 1, 1);
-    dim3 dimBlock(THREADS_PER_BLOCK, 1, 1);
-    CHECKCUDA(cudaLaunchCooperativeKernel((void*)gpuConjugateGradient, dimGrid, dimBlock, kernelArgs, sMemSize, stream));
+    if (workspace.residual != NULL) {   // 无预条件时dot_result[0]为r·r，预条件时dot_result[1]为r·r
+        CHECKCUDA(cudaMemcpyAsync(workspace.residual, dot_result + (workspace.invDiagonal == NULL ? 0 : 1), sizeof(double), cudaMemcpyDeviceToDevice, stream));
+    }
 
-    CHECKCUDA(cudaMemcpyAsync(&r1, dot_result, sizeof(double), cudaMemcpyDeviceToHost, stream));
+    // fp64残差迭代修正：以double累加计算真实残差，再用fp32 CG求解修正量，抵消fp32递推残差的漂移
+    if (workspace.refinementSteps > 0) {
+        CGWorkspace correctionWorkspace = workspace;
+        correctionWorkspace.refinementSteps = 0;
+        correctionWorkspace.useInitialGuess = false;
+        correctionWorkspace.residual = NULL;    // 只记录原系统的残差
+        correctionWorkspace.iterations = workspace.refineIterations;    // 迭代次数只记录原系统的求解
+        correctionWorkspace.invDiagonalReady = true;    // 修正量的系统矩阵不变，预条件子沿用上面提取的
+        dim3 block(128);
+        dim3 grid(pcl::gpu::divUp(N, block.x));
+        for (int step = 0; step < workspace.refinementSteps; step++) {
+            device::gpuComputeResidualDouble << <grid, block, 0, stream >> > (I, J, val, x, rhs, N, workspace.refineResidual);
+            solverCG_DeviceToDevice(N, nz, I, J, val, workspace.refineResidual, workspace.refineCorrection, correctionWorkspace, stream);
+            device::gpuAddCorrection << <grid, block, 0, stream >> > (workspace.refineCorrection, N, x);
+        }
+        // 修正后fp32递推的r·r已不对应x，以double重新计算真实残差覆盖上面记录的值
+        if (workspace.residual != NULL) {
+            CHECKCUDA(cudaMemsetAsync(workspace.residual, 0, sizeof(double), stream));
+            device::gpuResidualSquaredNormDouble << <grid, block, 0, stream >> > (I, J, val, x, rhs, N, workspace.residual);
+        }
+    }
 
-    //r1 = *dot_result;
+    // 残差与误差量仅用于输出统计，不统计时整个求解过程无需阻塞Host
 #ifdef CHECK_MESH_BUILD_TIME_COST
-    printf("残差 = %e  ", sqrt(r1));    // 科学计数法输出
-#endif // CHECK_MESH_BUILD_TIME_COST
-
-#if ENABLE_CPU_DEBUG_CODE
-    cpuConjugateGrad(I, J, val, x_cpu, Ax_cpu, p_cpu, r_cpu, nz, N, tol);
-#endif
+    // 无预条件时dot_result[0]为r·r，预条件时dot_result[1]为r·r；迭代修正后输出修正后的真实残差
+    const double* finalResidual = (workspace.refinementSteps > 0 && workspace.residual != NULL) ? workspace.residual : dot_result + (workspace.invDiagonal == NULL ? 0 : 1);
+    CHECKCUDA(cudaMemcpyAsync(&r1, finalResidual, sizeof(double), cudaMemcpyDeviceToHost, stream));
+    int iterations_Host;
+    CHECKCUDA(cudaMemcpyAsync(&iterations_Host, iterations, sizeof(int), cudaMemcpyDeviceToHost, stream));
 
-    int* err = NULL;
-    CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&err), sizeof(int), stream));
+    int* err = workspace.err;
     CHECKCUDA(cudaMemsetAsync(err, 0, sizeof(int), stream));
 
     int err_Int_Host;
@@ -389,20 +619,7 @@ void SparseSurfelFusion::solverCG_DeviceToDevice(const int& N, const int& nz, in
     CHECKCUDA(cudaStreamSynchronize(stream));
     float errHost = err_Int_Host / 1e10;
 
-    CHECKCUDA(cudaFreeAsync(r, stream));
-    CHECKCUDA(cudaFreeAsync(p, stream));
-    CHECKCUDA(cudaFreeAsync(Ax, stream));
-    CHECKCUDA(cudaFreeAsync(dot_result, stream));
-    CHECKCUDA(cudaFreeAsync(err, stream));
-
-#if ENABLE_CPU_DEBUG_CODE
-    free(Ax_cpu);
-    free(r_cpu);
-    free(p_cpu);
-    free(x_cpu);
-#endif
-
-#ifdef CHECK_MESH_BUILD_TIME_COST
+    printf("迭代次数 = %d  残差 = %e  ", iterations_Host, sqrt(r1));    // 科学计数法输出
     printf("误差量 = %e \n", errHost);
 #endif // CHECK_MESH_BUILD_TIME_COST
 }
@@ -14,13 +14,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <mutex>
 
 #include <base/DeviceAPI/safe_call.hpp>
 
 #include <base/GlobalConfigs.h>
+#include <base/Logging.h>
 
 #include <cooperative_groups.h>
 #include <cooperative_groups/reduce.h>
+#include <cuda_fp16.h>
 
 #define ENABLE_CPU_DEBUG_CODE 0
 #define THREADS_PER_BLOCK 512
@@ -31,7 +35,10 @@
 
 namespace cg = cooperative_groups;
 
-extern "C" __global__ void gpuConjugateGradient(int* I, int* J, float* val, float* x, float* Ax, float* p, float* r, double* dot_result, int nnz, int N, float tol);
+extern "C" __global__ void gpuConjugateGradient(int* I, int* J, float* val, float* x, float* Ax, float* p, float* r, double* dot_result, int* iterations, int nnz, int N, float tol);
+
+// 对角Jacobi预条件共轭梯度法：z = D^-1 * r，dot_result至少2个元素，[0]为r·z或p·Ap，[1]为r·r(收敛判据)
+extern "C" __global__ void gpuJacobiPreconditionedConjugateGradient(int* I, int* J, float* val, const float* invDiagonal, float* x, float* Ax, float* p, float* r, float* z, double* dot_result, int* iterations, int nnz, int N, float tol);
 
 namespace SparseSurfelFusion {
     namespace device {
@@ -44,6 +51,41 @@ namespace SparseSurfelFusion {
         __device__ void gpuCopyVector(float* srcA, float* destB, int size, const cg::grid_group& grid);
 
         __device__ void gpuScaleVectorAndSaxpy(const float* x, float* y, float a, float scale, int size, const cg::grid_group& grid);
+
+        __device__ void gpuJacobiPrecondition(const float* invDiagonal, const float* r, float* z, int size, const cg::grid_group& grid);
+
+        /**
+         * \brief 从CSR矩阵中提取对角元的倒数，对角元缺失或过小时取1(不做预条件).
+         */
+        __global__ void extractInverseDiagonal(const int* I, const int* J, const float* val, const int N, float* invDiagonal);
+
+        /**
+         * \brief 以double累加计算真实残差 residual = rhs - A * x，用于迭代修正.
+         */
+        __global__ void gpuComputeResidualDouble(const int* I, const int* J, const float* val, const float* x, const float* rhs, const int N, float* residual);
+
+        /**
+         * \brief 以double累加计算真实残差的平方和 squaredNorm += |rhs - A * x|^2，squaredNorm须预先置0.
+         */
+        __global__ void gpuResidualSquaredNormDouble(const int* I, const int* J, const float* val, const float* x, const float* rhs, const int N, double* squaredNorm);
+
+        /**
+         * \brief x = x + correction.
+         */
+        __global__ void gpuAddCorrection(const float* correction, const int N, float* x);
+
+        /**
+         * \brief 统计CSR矩阵对角元绝对值的最大值，maxAbsDiagonal须预先置0.
+         *        Laplace(及屏蔽项)矩阵半正定，|a_ij| <= sqrt(a_ii * a_jj)，全部元素的绝对值都不超过该值.
+         */
+        __global__ void computeMaxAbsDiagonal(const int* I, const int* J, const float* val, const int N, float* maxAbsDiagonal);
+
+        /**
+         * \brief 将float矩阵元素除以scale[0]后转换为半精度存储：Laplace元素随层数约按2^-2d缩小，
+         *        不缩放时深层的非对角元落入fp16的非规格化数甚至下溢为0.scale[0]不大于0时不缩放.
+         *        只转换前nnz[0]个元素(Device端的有效元素数量)，网格可按上界启动，超出的线程直接返回.
+         */
+        __global__ void convertToHalf(const float* src, const int* nnz, const float* scale, __half* dst);
     
         __global__ void gpuGetTestSummary(int* I, int* J, float* val, float* x, float* rhs, int* err, int num);
     }
@@ -68,7 +110,217 @@ namespace SparseSurfelFusion {
 
     bool areAlmostEqual(float a, float b, float maxRelDiff);
 
-    void solverCG_DeviceToDevice(const int& N, const int& nz, int* I, int* J, float* val, float* rhs, float* x, cudaStream_t stream);
+    /**
+     * \brief CG迭代所需的临时内存，由调用者预先开辟并复用，r、p、Ax的大小不小于N.
+     */
+    struct CGWorkspace {
+        float* r = NULL;            // 残差
+        float* p = NULL;            // 搜索方向
+        float* Ax = NULL;           // A * p
+        double* dot_result = NULL;  // 点积结果(2个)
+        int* err = NULL;            // 求解误差统计(1个)
+        int* iterations = NULL;     // 【输出】实际迭代次数(1个)
+        int* refineIterations = NULL;   // 迭代修正中求解修正量的CG迭代次数(1个)，refinementSteps > 0时必须提供，不覆盖iterations
+        double* residual = NULL;    // 【输出】结束时的r·r(1个)，为NULL时不记录
+        float* z = NULL;            // 预条件后的残差，仅预条件CG使用
+        float* invDiagonal = NULL;  // Jacobi预条件子(对角元倒数)，为NULL时使用无预条件CG
+        bool invDiagonalReady = false;  // 为true时invDiagonal已由同一矩阵提取，CSR求解不再重新提取
+        bool useInitialGuess = false;   // 为true时以x中已有的值作为初值(热启动)，否则x从0开始
+        int refinementSteps = 0;        // fp64残差迭代修正的次数，0为不修正
+        float* refineResidual = NULL;   // 迭代修正的残差，大小不小于N
+        float* refineCorrection = NULL; // 迭代修正的修正量，大小不小于N
+    };
+
+    void solverCG_DeviceToDevice(const int& N, const int& nz, int* I, int* J, float* val, float* rhs, float* x, const CGWorkspace& workspace, cudaStream_t stream);
+
+    namespace device {
+        /**
+         * \brief 通用线性算子的(预条件)共轭梯度法，算子A无需显式存储矩阵，只需提供
+         *        __device__ void Apply(const float* x, float* y, const cg::grid_group& grid) const，计算y = A * x.
+         *        invDiagonal为NULL时z与r为同一块内存，即无预条件CG；dot_result至少2个元素.
+         */
+        template<typename LinearOperator>
+        __global__ void gpuOperatorConjugateGradient(LinearOperator A, const float* invDiagonal, float* x, float* Ax, float* p, float* r, float* z, double* dot_result, int* iterations, int N, float tol)
+        {
+            cg::thread_block cta = cg::this_thread_block();
+            cg::grid_group grid = cg::this_grid();
+
+            const int max_iter = 10000;
+            const bool preconditioned = (invDiagonal != NULL);
+            double rz = 0.0, rz_old = 0.0, rr;
+            float b, a;
+
+            A.Apply(x, Ax, grid);
+
+            cg::sync(grid);
+
+            gpuSaxpy(Ax, r, -1.0f, N, grid);
+
+            cg::sync(grid);
+
+            if (preconditioned) {
+                gpuJacobiPrecondition(invDiagonal, r, z, N, grid);
+                cg::sync(grid);
+            }
+
+            gpuDotProduct(r, z, &dot_result[0], N, cta, grid);
+
+            cg::sync(grid);
+
+            if (preconditioned) {
+                gpuDotProduct(r, r, &dot_result[1], N, cta, grid);
+                cg::sync(grid);
+            }
+
+            rz = dot_result[0];
+            rr = preconditioned ? dot_result[1] : rz;
+
+            int k = 1;
+            while (rr > tol * tol && k <= max_iter) {
+                if (k > 1) {
+                    b = rz / rz_old;
+                    gpuScaleVectorAndSaxpy(z, p, 1.0f, b, N, grid);
+                }
+                else {
+                    gpuCopyVector(z, p, N, grid);
+                }
+
+                cg::sync(grid);
+
+                A.Apply(p, Ax, grid);
+
+                if (threadIdx.x == 0 && blockIdx.x == 0) dot_result[0] = 0.0;
+
+                cg::sync(grid);
+
+                gpuDotProduct(p, Ax, &dot_result[0], N, cta, grid);
+
+                cg::sync(grid);
+
+                a = rz / dot_result[0];
+
+                gpuSaxpy(p, x, a, N, grid);
+                gpuSaxpy(Ax, r, -a, N, grid);
+
+                cg::sync(grid);
+
+                if (preconditioned) gpuJacobiPrecondition(invDiagonal, r, z, N, grid);
+
+                if (threadIdx.x == 0 && blockIdx.x == 0) {
+                    dot_result[0] = 0.0;
+                    dot_result[1] = 0.0;
+                }
+
+                cg::sync(grid);
+
+                gpuDotProduct(r, z, &dot_result[0], N, cta, grid);
+
+                cg::sync(grid);
+
+                if (preconditioned) {
+                    gpuDotProduct(r, r, &dot_result[1], N, cta, grid);
+                    cg::sync(grid);
+                }
+
+                rz_old = rz;
+                rz = dot_result[0];
+                rr = preconditioned ? dot_result[1] : rz;
+
+                k++;
+            }
+
+            if (threadIdx.x == 0 && blockIdx.x == 0) *iterations = k - 1;
+        }
+    }
+
+    /**
+     * \brief CSR矩阵算子，矩阵元素的存储类型ValueT可为float或__half(半精度存储，访存减半)，乘法与累加均为float.
+     */
+    template<typename ValueT>
+    struct CSROperator {
+        const int* I;       // 行偏移，大小为N + 1
+        const int* J;       // 列索引
+        const ValueT* val;  // 矩阵元素
+        int N;              // 行数
+        const float* valueScale = NULL;     // 矩阵元素的缩放(1个)，A = valueScale[0] * val，为NULL时不缩放
+
+        __device__ void Apply(const float* x, float* y, const cg::grid_group& grid) const {
+            const float scale = (valueScale == NULL) ? 1.0f : *valueScale;
+            for (int i = grid.thread_rank(); i < N; i += grid.size()) {
+                float output = 0.0f;
+                for (int j = I[i]; j < I[i + 1]; j++) {
+                    output += static_cast<float>(val[j]) * x[J[j]];
+                }
+                y[i] = output * scale;
+            }
+        }
+    };
+
+    /**
+     * \brief 以通用线性算子(无显式矩阵)求解A * x = rhs，接口与solverCG_DeviceToDevice一致.
+     *        workspace.invDiagonal不为NULL时须已由调用者写入Jacobi预条件子.
+     *
+     * \param A 线性算子
+     * \param N 未知数数量
+     * \param rhs 右端项
+     * \param x 解
+     * \param workspace CG临时内存
+     * \param stream cuda流
+     */
+    template<typename LinearOperator>
+    void solverCG_Operator(const LinearOperator& A, const int& N, float* rhs, float* x, const CGWorkspace& workspace, cudaStream_t stream)
+    {
+        float tol = 1e-5f;
+        int sMemSize = sizeof(double) * ((THREADS_PER_BLOCK / 32) + 1);
+        static int maxBlocksOfDevice[MAX_RECONSTRUCTION_DEVICES] = { 0 };      // 每种算子在每个设备上只查询一次占用率
+        static std::once_flag deviceQueried[MAX_RECONSTRUCTION_DEVICES];      // 多个线程同时在同一设备上求解时只有一个线程查询
+        int devID = 0;
+        CHECKCUDA(cudaGetDevice(&devID));
+        if (devID >= MAX_RECONSTRUCTION_DEVICES) LOGGING(FATAL) << "设备号 " << devID << " 超出MAX_RECONSTRUCTION_DEVICES";
+        std::call_once(deviceQueried[devID], [devID, sMemSize]() {
+            cudaDeviceProp deviceProp;
+            CHECKCUDA(cudaGetDeviceProperties(&deviceProp, devID));
+            int numBlocksPerSm = 0;
+            CHECKCUDA(cudaOccupancyMaxActiveBlocksPerMultiprocessor(&numBlocksPerSm, device::gpuOperatorConjugateGradient<LinearOperator>, THREADS_PER_BLOCK, sMemSize));
+            maxBlocksOfDevice[devID] = deviceProp.multiProcessorCount * numBlocksPerSm;
+        });
+        const int maxBlocks = maxBlocksOfDevice[devID];
+
+        CHECKCUDA(cudaMemsetAsync(workspace.dot_result, 0, sizeof(double) * 2, stream));
+        CHECKCUDA(cudaMemcpyAsync(workspace.r, rhs, sizeof(float) * N, cudaMemcpyDeviceToDevice, stream));
+        if (!workspace.useInitialGuess) CHECKCUDA(cudaMemsetAsync(x, 0, sizeof(float) * N, stream));
+
+        LinearOperator op = A;
+        const float* invDiagonal = workspace.invDiagonal;
+        float* z = (workspace.invDiagonal == NULL) ? workspace.r : workspace.z;
+        float* r = workspace.r;
+        float* p = workspace.p;
+        float* Ax = workspace.Ax;
+        double* dot_result = workspace.dot_result;
+        int* iterations = workspace.iterations;
+        int num = N;
+        void* kernelArgs[] = {
+                (void*)&op, (void*)&invDiagonal, (void*)&x, (void*)&Ax,
+                (void*)&p, (void*)&r, (void*)&z, (void*)&dot_result,
+                (void*)&iterations, (void*)&num, (void*)&tol,
+        };
+        const int neededBlocks = (N + THREADS_PER_BLOCK - 1) / THREADS_PER_BLOCK;
+        dim3 dimGrid(std::max(1, std::min(maxBlocks, neededBlocks)), 1, 1);
+        dim3 dimBlock(THREADS_PER_BLOCK, 1, 1);
+        CHECKCUDA(cudaLaunchCooperativeKernel((void*)device::gpuOperatorConjugateGradient<LinearOperator>, dimGrid, dimBlock, kernelArgs, sMemSize, stream));
+        if (workspace.residual != NULL) {   // 无预条件时dot_result[0]为r·r，预条件时dot_result[1]为r·r
+            CHECKCUDA(cudaMemcpyAsync(workspace.residual, dot_result + (workspace.invDiagonal == NULL ? 0 : 1), sizeof(double), cudaMemcpyDeviceToDevice, stream));
+        }
+
+#ifdef CHECK_MESH_BUILD_TIME_COST
+        double r1 = 0;
+        int iterations_Host = 0;
+        CHECKCUDA(cudaMemcpyAsync(&r1, dot_result + (workspace.invDiagonal == NULL ? 0 : 1), sizeof(double), cudaMemcpyDeviceToHost, stream));
+        CHECKCUDA(cudaMemcpyAsync(&iterations_Host, iterations, sizeof(int), cudaMemcpyDeviceToHost, stream));
+        CHECKCUDA(cudaStreamSynchronize(stream));
+        printf("迭代次数 = %d  残差 = %e \n", iterations_Host, sqrt(r1));
+#endif // CHECK_MESH_BUILD_TIME_COST
+    }
 
 }
 
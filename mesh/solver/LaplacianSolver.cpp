@@ -7,17 +7,200 @@
  *********************************************************************/
 #include "LaplacianSolver.h"
 
-SparseSurfelFusion::LaplacianSolver::LaplacianSolver()
+SparseSurfelFusion::LaplacianSolver::LaplacianSolver(const ReconstructionConfig& config)
 {
 	//pool = std::make_shared<ThreadPool>(Constants::maxDepth_Host);
-	dx.AllocateBuffer(TOTAL_NODEARRAY_MAX_COUNT);
-	DensePointsImplicitFunctionValue.AllocateBuffer(MAX_SURFEL_COUNT);
+	dx.AllocateBuffer(config.TotalNodeArrayCount());
+	coarseDx.AllocateBuffer(config.TotalNodeArrayCount());
+	DensePointsImplicitFunctionValue.AllocateBuffer(config.maxSurfelCount);
+
+	// 通道0承担最细层，按上限预先开辟；其余通道只承担较粗层，按需开辟
+	workspace[0].AllocateBuffer(config.TotalNodeArrayCount());
+	for (int i = 1; i < MAX_MESH_STREAM; i++) workspace[i].AllocateBuffer(0);
+	cgIterations.AllocateBuffer(MAX_DEPTH_OCTREE + 1);
+	cgIterations.ResizeArrayOrException(Constants::maxDepth_Host + 1);
+	cgResiduals.AllocateBuffer(MAX_DEPTH_OCTREE + 1);
+	cgResiduals.ResizeArrayOrException(Constants::maxDepth_Host + 1);
+	updateWorkspaceHighWaterMark();
+
+	previousKeys.AllocateBuffer(config.TotalNodeArrayCount());
+	previousDx.AllocateBuffer(config.TotalNodeArrayCount());
+
+	CHECKCUDA(cudaEventCreateWithFlags(&forkEvent, cudaEventDisableTiming));
+	for (int i = 0; i < MAX_MESH_STREAM; i++) {
+		CHECKCUDA(cudaEventCreateWithFlags(&joinEvents[i], cudaEventDisableTiming));
+		CHECKCUDA(cudaEventCreateWithFlags(&previewEvents[i], cudaEventDisableTiming));
+	}
 }
 
 SparseSurfelFusion::LaplacianSolver::~LaplacianSolver()
 {
 	dx.ReleaseBuffer();
+	coarseDx.ReleaseBuffer();
 	DensePointsImplicitFunctionValue.ReleaseBuffer();
+
+	for (int i = 0; i < MAX_MESH_STREAM; i++) workspace[i].ReleaseBuffer();
+	cgIterations.ReleaseBuffer();
+	cgResiduals.ReleaseBuffer();
+	previousKeys.ReleaseBuffer();
+	previousDx.ReleaseBuffer();
+	ScreeningPointSum.ReleaseBuffer();
+	ScreeningSamples.ReleaseBuffer();
+
+	CHECKCUDA(cudaEventDestroy(forkEvent));
+	for (int i = 0; i < MAX_MESH_STREAM; i++) {
+		CHECKCUDA(cudaEventDestroy(joinEvents[i]));
+		CHECKCUDA(cudaEventDestroy(previewEvents[i]));
+	}
+
+	if (solverGraphExec != NULL) {
+		CHECKCUDA(cudaGraphExecDestroy(solverGraphExec));
+		solverGraphExec = NULL;
+	}
+}
+
+void SparseSurfelFusion::LaplacianSolver::SetGraphMode(const bool enable)
+{
+#if CUDART_VERSION >= 12000
+	graphMode = enable;
+#else
+	if (enable) LOGGING(INFO) << "CUDA " << CUDART_VERSION / 1000 << "." << (CUDART_VERSION % 1000) / 10 << " 不支持捕获协作核函数，CUDA Graph模式需要CUDA 12及以上，退回逐个核函数启动";
+	graphMode = false;
+#endif
+}
+
+void SparseSurfelFusion::LaplacianSolver::collectGraphSignature(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const OctNodeTopologyView& NodeTopology, const float* Divergence, const InnerProductTableView& innerProduct, cudaStream_t* streams, const unsigned int laneNum, std::vector<uintptr_t>& signature) const
+{
+	signature.clear();
+	const bool warmStartActive = warmStart && hasPreviousFrame;
+	for (int depth = 0; depth <= Constants::maxDepth_Host; depth++) {
+		signature.push_back((uintptr_t)BaseAddressArray[depth]);
+		signature.push_back((uintptr_t)NodeArrayCount[depth]);
+		signature.push_back(warmStartActive ? (uintptr_t)previousBaseAddress[depth] : 0);
+		signature.push_back(warmStartActive ? (uintptr_t)previousNodeCount[depth] : 0);
+	}
+	// 地址：输入输出、拓扑、点积表与工作区(工作区以重新开辟的次数代表其全部buffer的地址)
+	signature.push_back((uintptr_t)Divergence);
+	signature.push_back((uintptr_t)dx.Ptr());
+	signature.push_back((uintptr_t)coarseDx.Ptr());
+	signature.push_back((uintptr_t)encodeNodeIndexInFunction.RawPtr());
+	signature.push_back((uintptr_t)NodeTopology.key);
+	signature.push_back((uintptr_t)NodeTopology.parent);
+	signature.push_back((uintptr_t)NodeTopology.children);
+	signature.push_back((uintptr_t)NodeTopology.neighs);
+	signature.push_back((uintptr_t)NodeTopology.depth);
+	signature.push_back((uintptr_t)NodeTopology.nodeNum);
+	for (int depth = 0; depth <= Constants::maxDepth_Host + 1; depth++) signature.push_back((uintptr_t)NodeTopology.levelOffset[depth]);
+	signature.push_back((uintptr_t)innerProduct.dot_F_F);
+	signature.push_back((uintptr_t)innerProduct.dot_F_DF);
+	signature.push_back((uintptr_t)innerProduct.dot_F_D2F);
+	signature.push_back((uintptr_t)(screening ? ScreeningSamples.Ptr() : NULL));
+	for (unsigned int lane = 0; lane < laneNum; lane++) {
+		signature.push_back((uintptr_t)streams[lane]);
+		signature.push_back((uintptr_t)workspace[lane].allocationCount);
+	}
+	// 求解设置
+	signature.push_back((uintptr_t)laneNum);
+	signature.push_back((uintptr_t)warmStart);
+	signature.push_back((uintptr_t)cascadicMode);
+	signature.push_back((uintptr_t)matrixFree);
+	signature.push_back((uintptr_t)preconditioner);
+	signature.push_back((uintptr_t)precision);
+	signature.push_back((uintptr_t)refinementSteps);
+	signature.push_back((uintptr_t)(previewDepth + 1));
+}
+
+void SparseSurfelFusion::LaplacianSolver::updateSolverGraphExec(cudaGraph_t graph)
+{
+#if CUDART_VERSION >= 12000
+	if (solverGraphExec != NULL) {
+		cudaGraphExecUpdateResultInfo updateResult;
+		if (cudaGraphExecUpdate(solverGraphExec, graph, &updateResult) == cudaSuccess) return;
+		cudaGetLastError();		// 清除更新失败产生的错误，重新实例化
+		CHECKCUDA(cudaGraphExecDestroy(solverGraphExec));
+		solverGraphExec = NULL;
+	}
+	CHECKCUDA(cudaGraphInstantiateWithFlags(&solverGraphExec, graph, 0));
+#endif
+}
+
+void SparseSurfelFusion::LaplacianSolver::updateWorkspaceHighWaterMark()
+{
+	size_t bytes = cgIterations.Capacity() * sizeof(int) + cgResiduals.Capacity() * sizeof(double);
+	bytes += ScreeningPointSum.Capacity() * sizeof(float4) + ScreeningSamples.Capacity() * sizeof(float);
+	for (int i = 0; i < MAX_MESH_STREAM; i++) bytes += workspace[i].Bytes();
+	if (bytes > workspaceHighWaterMark) workspaceHighWaterMark = bytes;
+}
+
+void SparseSurfelFusion::LaplacianSolverWorkspace::AllocateBuffer(const size_t capacity)
+{
+	cgDotResult.AllocateBuffer(2);
+	cgError.AllocateBuffer(1);
+	cgRefineIterations.AllocateBuffer(1);
+	cgHalfScale.AllocateBuffer(1);
+	if (capacity == 0) return;
+	rowCount.AllocateBuffer(capacity + 2);
+	RowBaseAddress.AllocateBuffer(capacity + 2);
+	cgResidual.AllocateBuffer(capacity);
+	cgDirection.AllocateBuffer(capacity);
+	cgAx.AllocateBuffer(capacity);
+	cascadicRhs.AllocateBuffer(capacity);
+	cgPreconditionedResidual.AllocateBuffer(capacity);
+	cgInverseDiagonal.AllocateBuffer(capacity);
+	cgRefineResidual.AllocateBuffer(capacity);
+	cgRefineCorrection.AllocateBuffer(capacity);
 }
 
+void SparseSurfelFusion::LaplacianSolverWorkspace::ReleaseBuffer()
+{
+	rowCount.ReleaseBuffer();
+	RowBaseAddress.ReleaseBuffer();
+	colIndex.ReleaseBuffer();
+	val.ReleaseBuffer();
+	MergedColIndex.ReleaseBuffer();
+	MergedVal.ReleaseBuffer();
+	tempStorage.ReleaseBuffer();
+	cgResidual.ReleaseBuffer();
+	cgDirection.ReleaseBuffer();
+	cgAx.ReleaseBuffer();
+	cgDotResult.ReleaseBuffer();
+	cgError.ReleaseBuffer();
+	cgRefineIterations.ReleaseBuffer();
+	cgHalfScale.ReleaseBuffer();
+	cascadicRhs.ReleaseBuffer();
+	cgPreconditionedResidual.ReleaseBuffer();
+	cgInverseDiagonal.ReleaseBuffer();
+	cgRefineResidual.ReleaseBuffer();
+	cgRefineCorrection.ReleaseBuffer();
+}
 
+void SparseSurfelFusion::LaplacianSolverWorkspace::Prepare(const unsigned int nodeNum, const bool assembleCSR)
+{
+	const size_t nodeNum_27 = static_cast<size_t>(nodeNum) * 27;
+	reserve(rowCount, nodeNum + 2);
+	reserve(RowBaseAddress, nodeNum + 2);
+	if (assembleCSR) {		// 无矩阵求解不需要27 * N的CSR相关内存
+		reserve(colIndex, nodeNum_27);
+		reserve(val, nodeNum_27);
+		reserve(MergedColIndex, nodeNum_27);	// 有效元素数量不会超过27 * N
+		reserve(MergedVal, nodeNum_27);
+	}
+	reserve(cgResidual, nodeNum);
+	reserve(cgDirection, nodeNum);
+	reserve(cgAx, nodeNum);
+	reserve(cascadicRhs, nodeNum);
+	reserve(cgPreconditionedResidual, nodeNum);
+	reserve(cgInverseDiagonal, nodeNum);
+	reserve(cgRefineResidual, nodeNum);
+	reserve(cgRefineCorrection, nodeNum);
+}
+
+size_t SparseSurfelFusion::LaplacianSolverWorkspace::Bytes() const
+{
+	size_t bytes = 0;
+	bytes += (rowCount.Capacity() + RowBaseAddress.Capacity() + colIndex.Capacity() + MergedColIndex.Capacity() + cgError.Capacity() + cgRefineIterations.Capacity()) * sizeof(int);
+	bytes += (val.Capacity() + MergedVal.Capacity() + cgResidual.Capacity() + cgDirection.Capacity() + cgAx.Capacity() + cascadicRhs.Capacity() + cgPreconditionedResidual.Capacity() + cgInverseDiagonal.Capacity() + cgRefineResidual.Capacity() + cgRefineCorrection.Capacity() + cgHalfScale.Capacity()) * sizeof(float);
+	bytes += tempStorage.Capacity() * sizeof(unsigned char);
+	bytes += cgDotResult.Capacity() * sizeof(double);
+	return bytes;
+}
@@ -21,10 +21,74 @@ namespace SparseSurfelFusion {
 		__device__ __constant__ int decodeOffset_1 = (1 << (MAX_DEPTH_OCTREE + 1));
 
 		__device__ __constant__ int decodeOffset_2 = (1 << (2 * (MAX_DEPTH_OCTREE + 1)));
+
+		/**
+		 * \brief 无矩阵(matrix-free)的Laplace算子：每次乘法时按节点的27邻居由点积表现场计算矩阵元素，
+		 *		  与GenerateSingleNodeLaplacian生成的CSR完全一致(同样舍弃fabs(value) <= eps的元素)，但不占用27 * N的CSR内存.
+		 */
+		struct MatrixFreeLaplacianOperator {
+			OctNodeTopologyView NodeTopology;			// 八叉树节点拓扑(SoA)视图
+			const EncodedFunctionIndex* encodeNodeIndexInFunction;		// 编码节点在基函数中索引
+			InnerProductTableView innerProduct;			// 基函数紧凑内积表
+			int begin;									// 当前层首节点在NodeArray中的位置
+			int nodeNum;								// 当前层节点数量
+			const float* screeningSamples = NULL;		// 屏蔽项采样，为NULL时不加屏蔽项
+
+			__device__ __forceinline__ void decode(const int node, int* idxO) const {
+				const EncodedFunctionIndex encodeIndex = encodeNodeIndexInFunction[node];
+				idxO[0] = encodeIndex % decodeOffset_1;
+				idxO[1] = (encodeIndex / decodeOffset_1) % decodeOffset_1;
+				idxO[2] = encodeIndex / decodeOffset_2;
+			}
+
+			__device__ __forceinline__ double entry(const int* idxO_1, const int* idxO_2) const {
+				return GetLaplacianEntry(innerProduct, idxO_1, idxO_2);
+			}
+
+			/** \brief y = A * x. */
+			__device__ void Apply(const float* x, float* y, const cg::grid_group& grid) const {
+				for (int i = grid.thread_rank(); i < nodeNum; i += grid.size()) {
+					const int offset = begin + i;
+					int idxO_1[3];
+					decode(offset, idxO_1);
+					float output = 0.0f;
+					for (int k = 0; k < 27; k++) {
+						const int neighbor = NodeTopology.Neighbor(offset, k);
+						if (neighbor == -1) continue;
+						int idxO_2[3];
+						decode(neighbor, idxO_2);
+						double value = entry(idxO_1, idxO_2);
+						if (screeningSamples != NULL) value += GetScreeningEntry(screeningSamples, NodeTopology, offset, k);
+						if (fabs(value) > eps) output += float(value) * x[neighbor - begin];
+					}
+					y[i] = output;
+				}
+			}
+
+			/** \brief 第i行的对角元. */
+			__device__ float Diagonal(const int i) const {
+				int idxO[3];
+				decode(begin + i, idxO);
+				double value = entry(idxO, idxO);
+				if (screeningSamples != NULL) value += GetScreeningEntry(screeningSamples, NodeTopology, begin + i, 13);
+				return float(value);
+			}
+		};
+
+		/**
+		 * \brief 计算无矩阵Laplace算子的Jacobi预条件子(对角元倒数).
+		 */
+		__global__ void MatrixFreeInverseDiagonalKernel(MatrixFreeLaplacianOperator A, float* invDiagonal)
+		{
+			const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+			if (idx >= A.nodeNum) return;
+			const float diagonal = A.Diagonal(idx);
+			invDiagonal[idx] = fabsf(diagonal) > EPSILON ? 1.0f / diagonal : 1.0f;
+		}
 	}
 }
 
-__global__ void SparseSurfelFusion::device::GenerateSingleNodeLaplacian(const unsigned int depth, DeviceArrayView<double> dot_F_F, DeviceArrayView<double> dot_F_D2F, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, const unsigned int begin, const unsigned int calculatedNodeNum, int* rowCount, int* colIndex, float* val)
+__global__ void SparseSurfelFusion::device::GenerateSingleNodeLaplacian(const unsigned int depth, InnerProductTableView innerProduct, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, const unsigned int begin, const unsigned int calculatedNodeNum, const float* ScreeningSamples, int* rowCount, int* colIndex, float* val)
 {
 	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
 	if (idx >= calculatedNodeNum) return;
@@ -32,7 +96,7 @@ __global__ void SparseSurfelFusion::device::GenerateSingleNodeLaplacian(const un
 	int count = 0;
 	int colStart = idx * 27;
 	int idxO_1[3];
-	int encodeIndex = encodeNodeIndexInFunction[offset];
+	EncodedFunctionIndex encodeIndex = encodeNodeIndexInFunction[offset];
 	idxO_1[0] = encodeIndex % device::decodeOffset_1;
 	idxO_1[1] = (encodeIndex / device::decodeOffset_1) % device::decodeOffset_1;
 	idxO_1[2] = encodeIndex / device::decodeOffset_2;
@@ -42,7 +106,7 @@ __global__ void SparseSurfelFusion::device::GenerateSingleNodeLaplacian(const un
 	//}
 
 	for (int i = 0; i < 27; i++) {
-		int neighbor = NodeArray[offset].neighs[i];	// 节点的邻居节点
+		int neighbor = NodeTopology.Neighbor(offset, i);	// 节点的邻居节点
 		if (neighbor == -1) continue;
 		int colIdx = neighbor - begin;				// 相对于邻居的偏移
 		int idxO_2[3];
@@ -53,12 +117,8 @@ __global__ void SparseSurfelFusion::device::GenerateSingleNodeLaplacian(const un
 		//if (depth == 1 && idx == 0) {
 		//	printf("idx = %d   offset = %d   neighborIdx = %d   neighbor = %d   idxO_2 = (%d, %d, %d)\n", idx, offset, i, neighbor, idxO_2[0], idxO_2[1], idxO_2[2]);
 		//}
-		int scratch[3];
-		scratch[0] = idxO_1[0] * device::res + idxO_2[0];
-		scratch[1] = idxO_1[1] * device::res + idxO_2[1];
-		scratch[2] = idxO_1[2] * device::res + idxO_2[2];
-
-		double LaplacianEntryValue = GetLaplacianEntry(dot_F_F, dot_F_D2F, scratch);
+		double LaplacianEntryValue = GetLaplacianEntry(innerProduct, idxO_1, idxO_2);
+		if (ScreeningSamples != NULL) LaplacianEntryValue += GetScreeningEntry(ScreeningSamples, NodeTopology, offset, i);
 		if (fabs(LaplacianEntryValue) > device::eps) {
 			colIndex[colStart + count] = colIdx;
 			val[colStart + count] = LaplacianEntryValue;
@@ -68,21 +128,164 @@ __global__ void SparseSurfelFusion::device::GenerateSingleNodeLaplacian(const un
 	rowCount[idx] = count;
 }
 
-__device__ double SparseSurfelFusion::device::GetLaplacianEntry(DeviceArrayView<double> dot_F_F, DeviceArrayView<double> dot_F_D2F, const int* index)
+__device__ double SparseSurfelFusion::device::GetLaplacianEntry(const InnerProductTableView& innerProduct, const int* idxO_1, const int* idxO_2)
 {
-	return double(dot_F_F[index[0]] * dot_F_F[index[1]] * dot_F_F[index[2]] * (dot_F_D2F[index[0]] + dot_F_D2F[index[1]] + dot_F_D2F[index[2]]));
+	double dot[3], d2Dot[3];
+#pragma unroll
+	for (int i = 0; i < 3; i++) {
+		innerProduct.DotFFAndFD2F(idxO_2[i], idxO_1[i], dot[i], d2Dot[i]);	// 与原表 table[idxO_1 * res + idxO_2] 一致
+	}
+	return double(dot[0] * dot[1] * dot[2] * (d2Dot[0] + d2Dot[1] + d2Dot[2]));
 }
 
-__global__ void SparseSurfelFusion::device::markValidColIndex(const int* colIndex, const unsigned int nodeNum, bool* flag)
+__device__ float SparseSurfelFusion::device::GetScreeningEntry(const float* ScreeningSamples, const OctNodeTopologyView& NodeTopology, const int node, const int k)
+{
+	const int fx = k / 9 - 1, fy = (k / 3) % 3 - 1, fz = k % 3 - 1;		// 列节点相对行节点的偏移
+	float entry = 0.0f;
+	for (int e = 0; e < 27; e++) {
+		const int ex = e / 9 - 1, ey = (e / 3) % 3 - 1, ez = e % 3 - 1;	// 采样节点相对行节点的偏移
+		const int gx = fx - ex, gy = fy - ey, gz = fz - ez;				// 列节点相对采样节点的偏移
+		if (abs(gx) > 1 || abs(gy) > 1 || abs(gz) > 1) continue;		// 列节点的支撑不包含该采样节点
+		const int sampleNode = NodeTopology.Neighbor(node, e);
+		if (sampleNode == -1) continue;
+		const float* sample = ScreeningSamples + SCREENING_SAMPLE_STRIDE * sampleNode;
+		if (sample[0] == 0.0f) continue;
+		// 行节点相对采样节点偏移为-e，列节点偏移为g
+		const float rowValue = sample[1 + (1 - ex)] * sample[4 + (1 - ey)] * sample[7 + (1 - ez)];
+		const float columnValue = sample[1 + (gx + 1)] * sample[4 + (gy + 1)] * sample[7 + (gz + 1)];
+		entry += sample[0] * rowValue * columnValue;
+	}
+	return entry;
+}
+
+__global__ void SparseSurfelFusion::device::AccumulateScreeningPointsKernel(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, float4* ScreeningPointSum)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= DenseVertexCount) return;
+	const int node = DLevelOffset + PointToNodeArrayDLevel[idx];
+	const Point3D<float> point = DensePoints[idx].point;
+	atomicAdd(&ScreeningPointSum[node].x, point.coords[0]);
+	atomicAdd(&ScreeningPointSum[node].y, point.coords[1]);
+	atomicAdd(&ScreeningPointSum[node].z, point.coords[2]);
+	atomicAdd(&ScreeningPointSum[node].w, 1.0f);
+}
+
+__global__ void SparseSurfelFusion::device::AggregateScreeningPointsKernel(OctNodeTopologyView NodeTopology, const unsigned int begin, const unsigned int calculatedNodeNum, float4* ScreeningPointSum)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= calculatedNodeNum) return;
+	const unsigned int offset = begin + idx;
+	float4 sum = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+	for (int c = 0; c < 8; c++) {
+		const int child = NodeTopology.Child(offset, c);
+		if (child == -1) continue;
+		const float4 childSum = ScreeningPointSum[child];
+		sum.x += childSum.x;
+		sum.y += childSum.y;
+		sum.z += childSum.z;
+		sum.w += childSum.w;
+	}
+	ScreeningPointSum[offset] = sum;
+}
+
+__global__ void SparseSurfelFusion::device::ComputeScreeningSamplesKernel(DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const float4* ScreeningPointSum, const unsigned int nodeNum, const float weightScale, float* ScreeningSamples)
 {
 	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
 	if (idx >= nodeNum) return;
-	bool valid = false;
-	if (colIndex[idx] >= 0) { valid = true;}
-	flag[idx] = valid;
+	float* sample = ScreeningSamples + SCREENING_SAMPLE_STRIDE * idx;
+	const float4 sum = ScreeningPointSum[idx];
+	if (sum.w <= 0.0f) {
+		for (int i = 0; i < SCREENING_SAMPLE_STRIDE; i++) sample[i] = 0.0f;
+		return;
+	}
+	const float centroid[3] = { sum.x / sum.w, sum.y / sum.w, sum.z / sum.w };
+	int idxO[3];
+	const EncodedFunctionIndex encodeIndex = encodeNodeIndexInFunction[idx];
+	idxO[0] = encodeIndex % decodeOffset_1;
+	idxO[1] = (encodeIndex / decodeOffset_1) % decodeOffset_1;
+	idxO[2] = encodeIndex / decodeOffset_2;
+	for (int axis = 0; axis < 3; axis++) {
+		const int depth = InnerProductTableView::Depth(idxO[axis]);
+		for (int d = 0; d < 3; d++) {
+			const int functionIndex = idxO[axis] + d - 1;	// 同层前后邻居的基函数index，越过该层范围的邻居不存在
+			const bool valid = functionIndex >= 0 && InnerProductTableView::Depth(functionIndex) == depth;
+			sample[1 + 3 * axis + d] = valid ? value(BaseFunctions[functionIndex], centroid[axis]) : 0.0f;
+		}
+	}
+	sample[0] = weightScale * sum.w;
+}
+
+__global__ void SparseSurfelFusion::device::CompactLaplacianRows(const int* rowCount, const int* RowBaseAddress, const int* colIndex, const float* val, const unsigned int nodeNum, int* MergedColIndex, float* MergedVal)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= nodeNum) return;
+	const int count = rowCount[idx];
+	const int src = idx * 27;
+	const int dst = RowBaseAddress[idx];
+	for (int i = 0; i < count; i++) {
+		MergedColIndex[dst + i] = colIndex[src + i];
+		MergedVal[dst + i] = val[src + i];
+	}
+}
+
+__global__ void SparseSurfelFusion::device::SubtractCoarserSolutionKernel(InnerProductTableView innerProduct, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, const float* dx, const float* Divergence, const unsigned int begin, const unsigned int calculatedNodeNum, float* rhs)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= calculatedNodeNum) return;
+	const unsigned int offset = begin + idx;
+	int idxO_1[3];
+	EncodedFunctionIndex encodeIndex = encodeNodeIndexInFunction[offset];
+	idxO_1[0] = encodeIndex % device::decodeOffset_1;
+	idxO_1[1] = (encodeIndex / device::decodeOffset_1) % device::decodeOffset_1;
+	idxO_1[2] = encodeIndex / device::decodeOffset_2;
+
+	double coarserContribution = 0.0;
+	int nowNode = NodeTopology.Parent(offset);
+	while (nowNode != -1) {		// 遍历所有祖先节点，祖先的27个邻居覆盖了与当前节点基函数支撑相交的粗层节点
+		for (int i = 0; i < 27; i++) {
+			int neighbor = NodeTopology.Neighbor(nowNode, i);
+			if (neighbor == -1) continue;
+			int idxO_2[3];
+			encodeIndex = encodeNodeIndexInFunction[neighbor];
+			idxO_2[0] = encodeIndex % device::decodeOffset_1;
+			idxO_2[1] = (encodeIndex / device::decodeOffset_1) % device::decodeOffset_1;
+			idxO_2[2] = encodeIndex / device::decodeOffset_2;
+
+			coarserContribution += GetLaplacianEntry(innerProduct, idxO_1, idxO_2) * dx[neighbor];
+		}
+		nowNode = NodeTopology.Parent(nowNode);
+	}
+	rhs[idx] = Divergence[offset] - coarserContribution;
+}
+
+__global__ void SparseSurfelFusion::device::CollectNodeKeysKernel(OctNodeTopologyView NodeTopology, const unsigned int nodeNum, OctKey* keys)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= nodeNum) return;
+	keys[idx] = NodeTopology.Key(idx);
 }
 
-__global__ void SparseSurfelFusion::device::CalculatePointsImplicitFunctionValueKernel(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, float* pointsValue)
+__global__ void SparseSurfelFusion::device::RemapPreviousSolutionKernel(OctNodeTopologyView NodeTopology, const unsigned int begin, const unsigned int calculatedNodeNum, const OctKey* previousKeys, const float* previousDx, const unsigned int previousBegin, const unsigned int previousNodeNum, float* x)
+{
+	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= calculatedNodeNum) return;
+	const OctKey key = NodeTopology.Key(begin + idx);
+	int left = 0, right = (int)previousNodeNum - 1;
+	float initial = 0.0f;
+	while (left <= right) {		// 二分查找上一帧该层中key相同的节点
+		const int mid = (left + right) >> 1;
+		const OctKey midKey = previousKeys[previousBegin + mid];
+		if (midKey == key) {
+			initial = previousDx[previousBegin + mid];
+			break;
+		}
+		else if (midKey < key) left = mid + 1;
+		else right = mid - 1;
+	}
+	x[idx] = initial;
+}
+
+__global__ void SparseSurfelFusion::device::CalculatePointsImplicitFunctionValueKernel(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, OctNodeTopologyView NodeTopology, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, float* pointsValue)
 {
 	const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
 	if (idx >= DenseVertexCount) return;
@@ -91,22 +294,22 @@ __global__ void SparseSurfelFusion::device::CalculatePointsImplicitFunctionValue
 	Point3D<float> samplePoint = DensePoints[idx].point;
 	while (nowNode != -1) {
 		for (int i = 0; i < 27; i++) {
-			int neighbor = NodeArray[nowNode].neighs[i];
+			int neighbor = NodeTopology.Neighbor(nowNode, i);
 			if (neighbor != -1) {
 				int idxO[3];
-				int encodeIndex = encodeNodeIndexInFunction[neighbor];
+				EncodedFunctionIndex encodeIndex = encodeNodeIndexInFunction[neighbor];
 				idxO[0] = encodeIndex % decodeOffset_1;
 				idxO[1] = (encodeIndex / decodeOffset_1) % decodeOffset_1;
 				idxO[2] = encodeIndex / decodeOffset_2;
 
-				ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcX = BaseFunctions[idxO[0]];
-				ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcY = BaseFunctions[idxO[1]];
-				ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2> funcZ = BaseFunctions[idxO[2]];
+				const ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>& funcX = BaseFunctions[idxO[0]];	// 按引用访问避免复制多项式
+				const ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>& funcY = BaseFunctions[idxO[1]];
+				const ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>& funcZ = BaseFunctions[idxO[2]];
 
 				val += dx[neighbor] * value(funcX, samplePoint.coords[0]) * value(funcY, samplePoint.coords[1]) * value(funcZ, samplePoint.coords[2]);
 			}
 		}
-		nowNode = NodeArray[nowNode].parent;
+		nowNode = NodeTopology.Parent(nowNode);
 		//if (idx == 1000) {
 		//	printf("NowNodeIndex = %d\n", nowNode);
 		//}
@@ -117,133 +320,58 @@ __global__ void SparseSurfelFusion::device::CalculatePointsImplicitFunctionValue
 	//}
 }
 
-void SparseSurfelFusion::LaplacianSolver::LaplacianCGSolver(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, float* Divergence, DeviceArrayView<double> dot_F_F, DeviceArrayView<double> dot_F_D2F, cudaStream_t stream)
+void SparseSurfelFusion::LaplacianSolver::LaplacianCGSolver(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, float* Divergence, const InnerProductTableView& innerProduct, cudaStream_t* streams, const unsigned int streamNum)
 {
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
 #endif // CHECK_MESH_BUILD_TIME_COST
 
-	dx.ResizeArrayOrException(NodeArray.Size());
+	cudaStream_t stream = streams[0];
+	dx.ResizeArrayOrException(NodeTopology.Size());
 
-	for (int depth = 0; depth <= Constants::maxDepth_Host; depth++) {
-		int CurrentLevelNodesNum = NodeArrayCount[depth];	// 当前层节点总数
-		int CurrentLevelNodesNum_27 = CurrentLevelNodesNum * 27;
-		//cudaStream_t stream = streams[depth];
-		int* rowCount = NULL;	// 【中间变量，用完即释放，初始值为0】记录当前节点的邻居节点有多少个满足构成Laplace矩阵的元素 value ∈ [0, 26]
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&rowCount), sizeof(int) * (CurrentLevelNodesNum + 2), stream));
-		CHECKCUDA(cudaMemsetAsync(rowCount, 0, sizeof(int) * (CurrentLevelNodesNum + 2), stream));
-
-		int* colIndex = NULL;	// 【中间变量，用完即释放，初始值为-1】记录当前节点的邻居中满足"构成Laplace矩阵的元素"这一条件的节点，距离每层首节点的距离(neighbor - begin)
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&colIndex), sizeof(int) * CurrentLevelNodesNum_27, stream));
-		CHECKCUDA(cudaMemsetAsync(colIndex, -1, sizeof(int) * CurrentLevelNodesNum_27, stream));
-
-		float* val = NULL;		// 【中间变量，用完即释放】记录节点的所有邻居的Laplace元素的值，与colIndddex对应
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&val), sizeof(float) * CurrentLevelNodesNum_27, stream));
-
-		dim3 block_1(128);
-		dim3 grid_1(divUp(CurrentLevelNodesNum, block_1.x));
-		device::GenerateSingleNodeLaplacian << <grid_1, block_1, 0, stream >> > (depth, dot_F_F, dot_F_D2F, encodeNodeIndexInFunction, NodeArray, BaseAddressArray[depth], NodeArrayCount[depth], rowCount + 1, colIndex, val);
-
-		int* RowBaseAddress = NULL;	//【中间变量，用完即释放】记录当前节点之前的节点(及其邻居)，满足Laplace元素值的，总共有多少个(不计算当前节点，并且是从index=1开始，而非index=0)
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&RowBaseAddress), sizeof(int) * (CurrentLevelNodesNum + 2), stream));
-
-		void* tempRowAddressStorage = NULL;	//【算法临时变量，用完即释放】排他前缀和的临时变量
-		size_t tempRowAddressStorageBytes = 0;
-		cub::DeviceScan::ExclusiveSum(tempRowAddressStorage, tempRowAddressStorageBytes, rowCount, RowBaseAddress, CurrentLevelNodesNum + 2, stream);
-		CHECKCUDA(cudaMallocAsync(&tempRowAddressStorage, tempRowAddressStorageBytes, stream));
-		cub::DeviceScan::ExclusiveSum(tempRowAddressStorage, tempRowAddressStorageBytes, rowCount, RowBaseAddress, CurrentLevelNodesNum + 2, stream);
-		int valNums;				// 记录一共有多少个有效的Laplace元素，为了给MergedColIndex和MergedVal分配内存
-		int lastRowNum;				// 记录最后一个节点的有效的Laplace元素
-		CHECKCUDA(cudaMemcpyAsync(&valNums, RowBaseAddress + CurrentLevelNodesNum, sizeof(int), cudaMemcpyDeviceToHost, stream));
-		CHECKCUDA(cudaMemcpyAsync(&lastRowNum, rowCount + CurrentLevelNodesNum, sizeof(int), cudaMemcpyDeviceToHost, stream));
-		CHECKCUDA(cudaStreamSynchronize(stream));	// 阻塞Host线程，这里必须等待valNums计算完成，才能动态分配内存
-		valNums += lastRowNum;		// 前面排他前缀和并未包含最后一个元素，第index = n + 1个应该是[0, n]个的和，这里rowCount的第0个一直是0，从1开始计算rowCount的
-		CHECKCUDA(cudaMemcpyAsync(RowBaseAddress + CurrentLevelNodesNum + 1, &valNums, sizeof(int), cudaMemcpyHostToDevice, stream));	// 补齐index = n + 1个元素
-		
-		//CHECKCUDA(cudaStreamSynchronize(stream));	// 阻塞Host线程，这里必须等待valNums计算完成，才能动态分配内存
-		//printf("depth = %d   valNums = %d\n", depth, valNums);
-
-		int* MergedColIndex = NULL;	// 【中间变量，用完即释放】压缩的节点及邻居位置的有效值
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&MergedColIndex), sizeof(int) * valNums, stream));
-
-		float* MergedVal = NULL;	// 【中间变量，用完即释放】压缩的节点及邻居有效的Laplace值
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&MergedVal), sizeof(float) * valNums, stream));
-
-		bool* flag = NULL;			// 【中间变量，用完即释放】标记当前节点的邻居中满足"构成Laplace矩阵的元素"这一条件的节点的位置
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&flag), sizeof(bool) * CurrentLevelNodesNum_27, stream));
-
-		dim3 block_2(128);
-		dim3 grid_2(divUp(CurrentLevelNodesNum_27, block_2.x));
-		device::markValidColIndex << <grid_2, block_2, 0, stream >> > (colIndex, CurrentLevelNodesNum_27, flag);
-
-		int* MergedValSelectedNum = NULL;		// 【中间变量，用完即释放】获得压缩val后数量，理论上应该和valNums相等
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&MergedValSelectedNum), sizeof(int), stream));
-		int* MergedColIndexSelectedNum = NULL;	// 【中间变量，用完即释放】获得压缩colIndex后的数量，理论上应该和valNums相等
-		CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&MergedColIndexSelectedNum), sizeof(int), stream));
-
-		void* d_temp_storage_1 = NULL;
-		size_t temp_storage_bytes_1 = 0;
-		CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, val, flag, MergedVal, MergedValSelectedNum, CurrentLevelNodesNum_27, stream, false));	// 确定临时设备存储需求
-		CHECKCUDA(cudaMallocAsync(&d_temp_storage_1, temp_storage_bytes_1, stream));	
-		CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_1, temp_storage_bytes_1, val, flag, MergedVal, MergedValSelectedNum, CurrentLevelNodesNum_27, stream, false));	// 筛选																				
-
-		void* d_temp_storage_2 = NULL;
-		size_t temp_storage_bytes_2 = 0;
-		CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, colIndex, flag, MergedColIndex, MergedColIndexSelectedNum, CurrentLevelNodesNum_27, stream, false));
-		CHECKCUDA(cudaMallocAsync(&d_temp_storage_2, temp_storage_bytes_2, stream)); 			 
-		CHECKCUDA(cub::DeviceSelect::Flagged(d_temp_storage_2, temp_storage_bytes_2, colIndex, flag, MergedColIndex, MergedColIndexSelectedNum, CurrentLevelNodesNum_27, stream, false));
-
-		int MergedValSelectedNum_Host;			// 获得压缩val后数量，理论上应该和valNums相等
-		int MergedColIndexSelectedNum_Host;		// 获得压缩colIndex后的数量，理论上应该和valNums相等
-		CHECKCUDA(cudaMemcpyAsync(&MergedValSelectedNum_Host, MergedValSelectedNum, sizeof(int), cudaMemcpyDeviceToHost, stream));
-		CHECKCUDA(cudaMemcpyAsync(&MergedColIndexSelectedNum_Host, MergedColIndexSelectedNum, sizeof(int), cudaMemcpyDeviceToHost, stream));
-		
-		CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
-
-		assert(MergedValSelectedNum_Host == valNums);		// 顺便Check一下压缩的是否正确
-		assert(MergedColIndexSelectedNum_Host == valNums);	// 顺便Check一下压缩的是否正确
-
-		//if (depth == 1) {
-		//	std::vector<int> MergedColIndexHost;
-		//	MergedColIndexHost.resize(valNums);
-		//	std::vector<float> MergedValHost;
-		//	MergedValHost.resize(valNums);
-		//	CHECKCUDA(cudaMemcpyAsync(MergedColIndexHost.data(), MergedColIndex, sizeof(int) * valNums, cudaMemcpyDeviceToHost, stream));
-		//	CHECKCUDA(cudaMemcpyAsync(MergedValHost.data(), MergedVal, sizeof(float) * valNums, cudaMemcpyDeviceToHost, stream));
-		//	printf("valNum = %d\n", valNums);
-		//	for (int i = 0; i < valNums; i++) {
-		//		if ((i + 1) % 8 == 0) {
-		//			printf("%10.5f\n",MergedValHost[i]);
-		//		}
-		//		else {
-		//			printf("%10.5f   ",MergedValHost[i]);
-		//		}
-		//	}
-		//}
+	// 级联求解时细层依赖粗层的解，只能在同一个流上顺序求解
+	unsigned int laneNum = cascadicMode ? 1 : std::min(streamNum, (unsigned int)MAX_MESH_STREAM);
+	if (laneNum < 1) laneNum = 1;
 
-#ifdef CHECK_MESH_BUILD_TIME_COST
-		printf("第 %d 层节点的", depth);
-#endif // CHECK_MESH_BUILD_TIME_COST
-		solverCG_DeviceToDevice(CurrentLevelNodesNum, valNums, RowBaseAddress + 1, MergedColIndex, MergedVal, Divergence + BaseAddressArray[depth], dx.Ptr() + BaseAddressArray[depth], stream);
-	
-		cudaFreeAsync(tempRowAddressStorage, stream);	 // 临时空间
-		cudaFreeAsync(d_temp_storage_1, stream);		 // 临时空间
-		cudaFreeAsync(d_temp_storage_2, stream);		 // 临时空间
-
-		cudaFreeAsync(rowCount, stream);
-		cudaFreeAsync(colIndex, stream);
-		cudaFreeAsync(val, stream);
-		cudaFreeAsync(RowBaseAddress, stream);
-
-		cudaFreeAsync(MergedColIndex, stream);
-		cudaFreeAsync(MergedVal, stream);
-		cudaFreeAsync(flag, stream); 
-
-		cudaFreeAsync(MergedValSelectedNum, stream);
-		cudaFreeAsync(MergedColIndexSelectedNum, stream);
+	// 按每个通道承担的最大层节点数量一次性准备工作区(包括cub临时空间)，之后的压入过程中不再开辟内存
+	int laneMaxNodesNum[MAX_MESH_STREAM] = { 0 };
+	for (int depth = 0; depth <= Constants::maxDepth_Host; depth++) {
+		const unsigned int lane = solverLane(depth, laneNum);
+		if (NodeArrayCount[depth] > laneMaxNodesNum[lane]) laneMaxNodesNum[lane] = NodeArrayCount[depth];
+	}
+	for (unsigned int lane = 0; lane < laneNum; lane++) {
+		LaplacianSolverWorkspace& ws = workspace[lane];
+		ws.Prepare(laneMaxNodesNum[lane], !matrixFree);
+		size_t tempStorageBytes = 0;
+		CHECKCUDA(cub::DeviceScan::ExclusiveSum(NULL, tempStorageBytes, ws.rowCount.Ptr(), ws.RowBaseAddress.Ptr(), laneMaxNodesNum[lane] + 2, stream));
+		ws.ReserveTempStorage(tempStorageBytes);
+	}
+	updateWorkspaceHighWaterMark();
+
+	StageProfiler::Scope solveStage(profiler, "laplacian_solve", stream);
+#ifndef CHECK_MESH_BUILD_TIME_COST
+	if (graphMode) {
+		// 输入与上一次捕获完全相同时(静态场景)直接重放：热启动等Host端状态在上一次压入时已是本帧的值
+		std::vector<uintptr_t> signature;
+		collectGraphSignature(BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, NodeTopology, Divergence, innerProduct, streams, laneNum, signature);
+		if (solverGraphExec == NULL || signature != solverGraphSignature) {
+			cudaGraph_t graph;
+			CHECKCUDA(cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal));
+			capturingGraph = true;
+			enqueueLaplacianSolve(BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, NodeTopology, Divergence, innerProduct, streams, laneNum);
+			capturingGraph = false;
+			CHECKCUDA(cudaStreamEndCapture(stream, &graph));
+			updateSolverGraphExec(graph);
+			CHECKCUDA(cudaGraphDestroy(graph));
+			solverGraphSignature.swap(signature);
+		}
+		CHECKCUDA(cudaGraphLaunch(solverGraphExec, stream));
+	}
+	else
+#endif // !CHECK_MESH_BUILD_TIME_COST
+	{
+		enqueueLaplacianSolve(BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, NodeTopology, Divergence, innerProduct, streams, laneNum);
 	}
-
-
 
 	//CHECKCUDA(cudaStreamSynchronize(stream));	// 流同步
 	//std::vector<float>dxHost;
@@ -260,13 +388,218 @@ void SparseSurfelFusion::LaplacianSolver::LaplacianCGSolver(const int* BaseAddre
 	auto end = std::chrono::high_resolution_clock::now();						// 记录结束时间点
 	std::chrono::duration<double, std::milli> duration = end - start;			// 计算执行时间（以ms为单位）
 	std::cout << "拉普拉斯求解的时间: " << duration.count() << " ms" << std::endl;		// 输出
+	std::cout << "求解器工作区显存最高水位: " << workspaceHighWaterMark / (1024.0 * 1024.0) << " MB" << std::endl;		// 输出
 	std::cout << std::endl;
 	std::cout << "-----------------------------------------------------" << std::endl;	// 输出
 	std::cout << std::endl;
 #endif // CHECK_MESH_BUILD_TIME_COST
 }
 
-void SparseSurfelFusion::LaplacianSolver::CalculatePointsImplicitFunctionValue(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, cudaStream_t stream)
+void SparseSurfelFusion::LaplacianSolver::enqueueLaplacianSolve(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, float* Divergence, const InnerProductTableView& innerProduct, cudaStream_t* streams, const unsigned int laneNum)
+{
+	// 分发：其余通道等待主流之前的任务(散度等)完成
+	forkSolverLanes(streams, laneNum);
+
+	if (!cascadicMode) {
+		// 非级联第一趟：0 ~ maxDepth - 1层互不依赖地独立求解，结果只作为第二趟的粗层解
+		for (int depth = 0; depth < Constants::maxDepth_Host; depth++) {
+			enqueueDepthSolve(depth, NULL, coarseDx.Ptr(), BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, NodeTopology, Divergence, innerProduct, streams, laneNum);
+		}
+		// 第二趟的每一层都读取全部更粗层第一趟的解，各通道汇合后重新分发
+		joinSolverLanes(streams, laneNum);
+		forkSolverLanes(streams, laneNum);
+	}
+
+	// 级联求解时每层减去同一通道上已求得的粗层解；非级联的第二趟各层减去第一趟的粗层解，仍互不依赖
+	const float* coarserSolution = cascadicMode ? dx.Ptr() : coarseDx.Ptr();
+	previewLaneMask = 0;
+	for (int depth = 0; depth <= Constants::maxDepth_Host; depth++) {
+		enqueueDepthSolve(depth, coarserSolution, dx.Ptr(), BaseAddressArray, NodeArrayCount, encodeNodeIndexInFunction, NodeTopology, Divergence, innerProduct, streams, laneNum);
+
+		// 每个通道按由粗到细的顺序压入，预览层压入后各通道上更粗的层都已在前面
+		if (depth == previewDepth) {
+			for (int coarser = 0; coarser <= depth; coarser++) previewLaneMask |= 1u << solverLane(coarser, laneNum);
+			for (unsigned int lane = 0; lane < laneNum; lane++) {
+				if (!(previewLaneMask & (1u << lane))) continue;
+				// 捕获期间普通的事件记录只连接捕获内的依赖，捕获外的流要等待必须记录为外部事件节点
+				CHECKCUDA(cudaEventRecordWithFlags(previewEvents[lane], streams[lane], capturingGraph ? cudaEventRecordExternal : cudaEventRecordDefault));
+			}
+		}
+	}
+
+	// 汇合：主流等待其余通道全部层求解完成
+	joinSolverLanes(streams, laneNum);
+
+	// 保留本帧的解与节点key，供下一帧热启动
+	if (warmStart) {
+		const unsigned int totalNodeNum = NodeTopology.Size();
+		dim3 block(128);
+		dim3 grid(divUp(totalNodeNum, block.x));
+		device::CollectNodeKeysKernel << <grid, block, 0, streams[0] >> > (NodeTopology, totalNodeNum, previousKeys.Ptr());
+		CHECKCUDA(cudaMemcpyAsync(previousDx.Ptr(), dx.Ptr(), sizeof(float) * totalNodeNum, cudaMemcpyDeviceToDevice, streams[0]));
+		for (int depth = 0; depth <= Constants::maxDepth_Host; depth++) {
+			previousBaseAddress[depth] = BaseAddressArray[depth];
+			previousNodeCount[depth] = NodeArrayCount[depth];
+		}
+		hasPreviousFrame = true;
+	}
+}
+
+void SparseSurfelFusion::LaplacianSolver::forkSolverLanes(cudaStream_t* streams, const unsigned int laneNum)
+{
+	if (laneNum <= 1) return;
+	CHECKCUDA(cudaEventRecord(forkEvent, streams[0]));
+	for (unsigned int lane = 1; lane < laneNum; lane++) {
+		CHECKCUDA(cudaStreamWaitEvent(streams[lane], forkEvent, 0));
+	}
+}
+
+void SparseSurfelFusion::LaplacianSolver::joinSolverLanes(cudaStream_t* streams, const unsigned int laneNum)
+{
+	if (laneNum <= 1) return;
+	for (unsigned int lane = 1; lane < laneNum; lane++) {
+		CHECKCUDA(cudaEventRecord(joinEvents[lane], streams[lane]));
+		CHECKCUDA(cudaStreamWaitEvent(streams[0], joinEvents[lane], 0));
+	}
+}
+
+void SparseSurfelFusion::LaplacianSolver::enqueueDepthSolve(const int depth, const float* coarserSolution, float* solution, const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, float* Divergence, const InnerProductTableView& innerProduct, cudaStream_t* streams, const unsigned int laneNum)
+{
+	const float* screeningSamples = screening ? ScreeningSamples.Ptr() : NULL;	// 由PrepareScreeningSamples在streams[0]上生成
+	int CurrentLevelNodesNum = NodeArrayCount[depth];	// 当前层节点总数
+	int CurrentLevelNodesNum_27 = CurrentLevelNodesNum * 27;
+	cudaStream_t stream = streams[solverLane(depth, laneNum)];
+	LaplacianSolverWorkspace& ws = workspace[solverLane(depth, laneNum)];
+	StageProfiler* depthProfiler = capturingGraph ? NULL : profiler;	// 捕获期间的事件不能计时
+	const int assemblyStage = depthProfiler == NULL ? -1 : depthProfiler->Begin("laplacian_assembly", stream, depth);
+
+	dim3 block_1(128);
+	dim3 grid_1(divUp(CurrentLevelNodesNum, block_1.x));
+	if (!matrixFree) {
+		// rowCount：记录当前节点的邻居节点有多少个满足构成Laplace矩阵的元素 value ∈ [0, 26]，初始值为0
+		CHECKCUDA(cudaMemsetAsync(ws.rowCount.Ptr(), 0, sizeof(int) * (CurrentLevelNodesNum + 2), stream));
+
+		device::GenerateSingleNodeLaplacian << <grid_1, block_1, 0, stream >> > (depth, innerProduct, encodeNodeIndexInFunction, NodeTopology, BaseAddressArray[depth], NodeArrayCount[depth], screeningSamples, ws.rowCount.Ptr() + 1, ws.colIndex.Ptr(), ws.val.Ptr());
+
+		// rowCount[0]与rowCount[N + 1]恒为0，因此排他前缀和的RowBaseAddress[N + 1]即为有效元素总数，CSR行偏移完全在Device端得到
+		size_t tempStorageBytes = ws.tempStorage.Capacity();
+		CHECKCUDA(cub::DeviceScan::ExclusiveSum(ws.tempStorage.Ptr(), tempStorageBytes, ws.rowCount.Ptr(), ws.RowBaseAddress.Ptr(), CurrentLevelNodesNum + 2, stream));
+
+		// 按行偏移直接写出CSR，MergedColIndex与MergedVal按27 * N上界开辟，无需Host读回有效元素数量
+		device::CompactLaplacianRows << <grid_1, block_1, 0, stream >> > (ws.rowCount.Ptr() + 1, ws.RowBaseAddress.Ptr() + 1, ws.colIndex.Ptr(), ws.val.Ptr(), CurrentLevelNodesNum, ws.MergedColIndex.Ptr(), ws.MergedVal.Ptr());
+	}
+
+	// 右端项减去更粗层解的贡献：级联求解时粗层解已在同一stream中求得，非级联的第二趟读取第一趟的解
+	float* rhs = Divergence + BaseAddressArray[depth];
+	if (coarserSolution != NULL && depth > 0) {
+		device::SubtractCoarserSolutionKernel << <grid_1, block_1, 0, stream >> > (innerProduct, encodeNodeIndexInFunction, NodeTopology, coarserSolution, Divergence, BaseAddressArray[depth], CurrentLevelNodesNum, ws.cascadicRhs.Ptr());
+		rhs = ws.cascadicRhs.Ptr();
+	}
+
+#ifdef CHECK_MESH_BUILD_TIME_COST
+	printf("第 %d 层节点的", depth);
+#endif // CHECK_MESH_BUILD_TIME_COST
+	if (depthProfiler != NULL) depthProfiler->End(assemblyStage, stream);
+	StageProfiler::Scope cgStage(depthProfiler, "cg", stream, depth);
+	CGWorkspace cgWorkspace;
+	cgWorkspace.r = ws.cgResidual.Ptr();
+	cgWorkspace.p = ws.cgDirection.Ptr();
+	cgWorkspace.Ax = ws.cgAx.Ptr();
+	cgWorkspace.dot_result = ws.cgDotResult.Ptr();
+	cgWorkspace.err = ws.cgError.Ptr();
+	cgWorkspace.iterations = cgIterations.Ptr() + depth;
+	cgWorkspace.residual = cgResiduals.Ptr() + depth;
+	if (preconditioner == CGPreconditioner::Jacobi) {
+		cgWorkspace.z = ws.cgPreconditionedResidual.Ptr();
+		cgWorkspace.invDiagonal = ws.cgInverseDiagonal.Ptr();
+	}
+	// 热启动：上一帧该层存在时，以映射后的上一帧解作为初值
+	if (solution == dx.Ptr() && warmStart && hasPreviousFrame && previousNodeCount[depth] > 0) {
+		device::RemapPreviousSolutionKernel << <grid_1, block_1, 0, stream >> > (NodeTopology, BaseAddressArray[depth], CurrentLevelNodesNum, previousKeys.Ptr(), previousDx.Ptr(), previousBaseAddress[depth], previousNodeCount[depth], solution + BaseAddressArray[depth]);
+		cgWorkspace.useInitialGuess = true;
+	}
+	if (!matrixFree && precision == SolverPrecision::HalfStorage) {
+		// 压缩后val已不再使用，半精度矩阵元素直接写入val的显存
+		// 按本层对角元绝对值的最大值缩放到[-1, 1]再存储，算子乘法时乘回缩放，CG求解的仍是原矩阵
+		__half* halfVal = reinterpret_cast<__half*>(ws.val.Ptr());
+		float* halfScale = ws.cgHalfScale.Ptr();
+		CHECKCUDA(cudaMemsetAsync(halfScale, 0, sizeof(float), stream));
+		device::computeMaxAbsDiagonal << <grid_1, block_1, 0, stream >> > (ws.RowBaseAddress.Ptr() + 1, ws.MergedColIndex.Ptr(), ws.MergedVal.Ptr(), CurrentLevelNodesNum, halfScale);
+		// 有效元素数量nnz = I[N] = RowBaseAddress[N + 1]只在Device端，网格按27 * N上界启动，nnz之后未初始化的部分不转换
+		dim3 block_27(128);
+		dim3 grid_27(divUp(CurrentLevelNodesNum_27, block_27.x));
+		device::convertToHalf << <grid_27, block_27, 0, stream >> > (ws.MergedVal.Ptr(), ws.RowBaseAddress.Ptr() + 1 + CurrentLevelNodesNum, halfScale, halfVal);
+		if (cgWorkspace.invDiagonal != NULL) {
+			device::extractInverseDiagonal << <grid_1, block_1, 0, stream >> > (ws.RowBaseAddress.Ptr() + 1, ws.MergedColIndex.Ptr(), ws.MergedVal.Ptr(), CurrentLevelNodesNum, cgWorkspace.invDiagonal);
+		}
+		CSROperator<__half> A;
+		A.I = ws.RowBaseAddress.Ptr() + 1;
+		A.J = ws.MergedColIndex.Ptr();
+		A.val = halfVal;
+		A.N = CurrentLevelNodesNum;
+		A.valueScale = halfScale;
+		solverCG_Operator(A, CurrentLevelNodesNum, rhs, solution + BaseAddressArray[depth], cgWorkspace, stream);
+	}
+	else if (!matrixFree) {
+		if (precision == SolverPrecision::FloatRefined) {
+			cgWorkspace.refinementSteps = refinementSteps;
+			cgWorkspace.refineResidual = ws.cgRefineResidual.Ptr();
+			cgWorkspace.refineCorrection = ws.cgRefineCorrection.Ptr();
+			cgWorkspace.refineIterations = ws.cgRefineIterations.Ptr();
+		}
+		solverCG_DeviceToDevice(CurrentLevelNodesNum, CurrentLevelNodesNum_27, ws.RowBaseAddress.Ptr() + 1, ws.MergedColIndex.Ptr(), ws.MergedVal.Ptr(), rhs, solution + BaseAddressArray[depth], cgWorkspace, stream);
+	}
+	else {
+		device::MatrixFreeLaplacianOperator A;
+		A.NodeTopology = NodeTopology;
+		A.encodeNodeIndexInFunction = encodeNodeIndexInFunction.RawPtr();
+		A.innerProduct = innerProduct;
+		A.begin = BaseAddressArray[depth];
+		A.nodeNum = CurrentLevelNodesNum;
+		A.screeningSamples = screeningSamples;
+		if (cgWorkspace.invDiagonal != NULL) {
+			device::MatrixFreeInverseDiagonalKernel << <grid_1, block_1, 0, stream >> > (A, cgWorkspace.invDiagonal);
+		}
+		solverCG_Operator(A, CurrentLevelNodesNum, rhs, solution + BaseAddressArray[depth], cgWorkspace, stream);
+	}
+}
+
+void SparseSurfelFusion::LaplacianSolver::WaitPreviewDepthSolved(cudaStream_t stream)
+{
+	for (unsigned int lane = 0; lane < MAX_MESH_STREAM; lane++) {
+		if (previewLaneMask & (1u << lane)) CHECKCUDA(cudaStreamWaitEvent(stream, previewEvents[lane], 0));
+	}
+}
+
+void SparseSurfelFusion::LaplacianSolver::PrepareScreeningSamples(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, const int* BaseAddressArray, const int* NodeArrayCount, OctNodeTopologyView NodeTopology, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, cudaStream_t stream)
+{
+	if (!screening) return;
+	const unsigned int nodeNum = NodeTopology.Size();
+	const unsigned int DenseVertexCount = DensePoints.Size();
+	if (nodeNum > ScreeningPointSum.Capacity()) ScreeningPointSum.AllocateBuffer(static_cast<size_t>(nodeNum * 1.5));
+	if (nodeNum * SCREENING_SAMPLE_STRIDE > ScreeningSamples.Capacity()) ScreeningSamples.AllocateBuffer(static_cast<size_t>(nodeNum * 1.5) * SCREENING_SAMPLE_STRIDE);
+	ScreeningPointSum.ResizeArrayOrException(nodeNum);
+	ScreeningSamples.ResizeArrayOrException(nodeNum * SCREENING_SAMPLE_STRIDE);
+
+	CHECKCUDA(cudaMemsetAsync(ScreeningPointSum.Ptr(), 0, sizeof(float4) * nodeNum, stream));
+	if (DenseVertexCount > 0) {
+		dim3 block(128);
+		dim3 grid(divUp(DenseVertexCount, block.x));
+		device::AccumulateScreeningPointsKernel << <grid, block, 0, stream >> > (DensePoints, PointToNodeArrayDLevel, BaseAddressArray[Constants::maxDepth_Host], DenseVertexCount, ScreeningPointSum.Ptr());
+	}
+	// 自底向上，每层节点的点为其孩子的点之和
+	for (int depth = Constants::maxDepth_Host - 1; depth >= 0; depth--) {
+		dim3 block(128);
+		dim3 grid(divUp(NodeArrayCount[depth], block.x));
+		device::AggregateScreeningPointsKernel << <grid, block, 0, stream >> > (NodeTopology, BaseAddressArray[depth], NodeArrayCount[depth], ScreeningPointSum.Ptr());
+	}
+	const float weightScale = DenseVertexCount > 0 ? screeningWeight / DenseVertexCount : 0.0f;	// 采样权重为点数占比，使α与点云规模无关
+	dim3 block(128);
+	dim3 grid(divUp(nodeNum, block.x));
+	device::ComputeScreeningSamplesKernel << <grid, block, 0, stream >> > (encodeNodeIndexInFunction, BaseFunctions, ScreeningPointSum.Ptr(), nodeNum, weightScale, ScreeningSamples.Ptr());
+}
+
+void SparseSurfelFusion::LaplacianSolver::CalculatePointsImplicitFunctionValue(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, OctNodeTopologyView NodeTopology, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, cudaStream_t stream)
 {
 #ifdef CHECK_MESH_BUILD_TIME_COST
 	auto start = std::chrono::high_resolution_clock::now();						// 记录开始时间点
@@ -274,23 +607,20 @@ void SparseSurfelFusion::LaplacianSolver::CalculatePointsImplicitFunctionValue(D
 
 	dim3 block(128);
 	dim3 grid(divUp(DenseVertexCount, block.x));
-	device::CalculatePointsImplicitFunctionValueKernel << <grid, block, 0, stream >> > (DensePoints, PointToNodeArrayDLevel, NodeArray, encodeNodeIndexInFunction, BaseFunctions, dx.ArrayView(), DLevelOffset, DenseVertexCount, DensePointsImplicitFunctionValue.Array().ptr());
+	device::CalculatePointsImplicitFunctionValueKernel << <grid, block, 0, stream >> > (DensePoints, PointToNodeArrayDLevel, NodeTopology, encodeNodeIndexInFunction, BaseFunctions, dx.ArrayView(), DLevelOffset, DenseVertexCount, DensePointsImplicitFunctionValue.Array().ptr());
 
-	// 规约加法
-	float* isoValueDevice = NULL;
-	CHECKCUDA(cudaMallocAsync(reinterpret_cast<void**>(&isoValueDevice), sizeof(float), stream));
-	void* d_temp_storage = NULL;
+	// 规约加法，结果与临时空间均复用求解器工作区
+	LaplacianSolverWorkspace& ws = workspace[0];
+	float* isoValueDevice = ws.cgResidual.Ptr();
 	size_t temp_storage_bytes = 0;
-	cub::DeviceReduce::Sum(d_temp_storage, temp_storage_bytes, DensePointsImplicitFunctionValue.Array().ptr(), isoValueDevice, DenseVertexCount, stream);
-	CHECKCUDA(cudaMallocAsync(&d_temp_storage, temp_storage_bytes, stream));
-	cub::DeviceReduce::Sum(d_temp_storage, temp_storage_bytes, DensePointsImplicitFunctionValue.Array().ptr(), isoValueDevice, DenseVertexCount, stream);
+	CHECKCUDA(cub::DeviceReduce::Sum(NULL, temp_storage_bytes, DensePointsImplicitFunctionValue.Array().ptr(), isoValueDevice, DenseVertexCount, stream));
+	ws.ReserveTempStorage(temp_storage_bytes);
+	updateWorkspaceHighWaterMark();
+	CHECKCUDA(cub::DeviceReduce::Sum(ws.tempStorage.Ptr(), temp_storage_bytes, DensePointsImplicitFunctionValue.Array().ptr(), isoValueDevice, DenseVertexCount, stream));
 	CHECKCUDA(cudaMemcpyAsync(&isoValue, isoValueDevice, sizeof(float), cudaMemcpyDeviceToHost, stream));
 	CHECKCUDA(cudaStreamSynchronize(stream));
 	isoValue /= DenseVertexCount;
 
-	CHECKCUDA(cudaFreeAsync(isoValueDevice, stream)); // 释放临时内存
-	CHECKCUDA(cudaFreeAsync(d_temp_storage, stream)); // 释放临时内存
-
 	//printf("isoValue = %.9f\n", isoValue);
 
 #ifdef CHECK_MESH_BUILD_TIME_COST
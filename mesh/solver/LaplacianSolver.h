@@ -13,65 +13,247 @@
 #include <mesh/Geometry.h>
 #include <mesh/BuildOctree.h>
 #include <mesh/ConfirmedPPolynomial.h>
+#include <mesh/InnerProductTable.cuh>
 
 #if defined(__CUDACC__)		//如果由NVCC编译器编译
 #include <mesh/solver/CGAlgorithm.cuh>
+#include <mesh/StageProfiler.h>
 #endif
 
+#define SCREENING_SAMPLE_STRIDE 10	// 屏蔽项采样：[0]为权重，[1 + 3 * axis + d]为重心处该维偏移d - 1的基函数值
+
 namespace SparseSurfelFusion {
 	namespace device {
 		/**
 		 * \brief 根据点积表计算矩阵每个元素的Laplace元素值，并标记无效值防止减少元素个数，防止后续参与计算.
 		 * 
-		 * \param dot_F_F 基函数内积表
-		 * \param dot_F_D2F 基函数二阶导函数内积表
+		 * \param innerProduct 基函数紧凑内积表
 		 * \param encodeNodeIndexInFunction 编码节点的在函数中索引
-		 * \param NodeArray 八叉树一维节点
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
 		 * \param begin 当前核函数遍历NodeArray的起始位置
 		 * \param calculatedNodeNum 当前核函数需要遍历的节点数量
+		 * \param ScreeningSamples 屏蔽项采样(每个节点SCREENING_SAMPLE_STRIDE个float)，为NULL时不加屏蔽项
 		 * \param rowCount 记录一个节点及其邻居有效的colIndex的个数，以便后面计算所需开辟的空间
 		 * \param colIndex 记录一个节点及其邻居有效的colIndex(有效 <==> fabs(LaplacianEntryValue) > device::eps)
 		 * \param val 记录一个节点及其邻居有效的LaplacianEntryValue的值
 		 */
-		__global__ void GenerateSingleNodeLaplacian(const unsigned int depth, DeviceArrayView<double> dot_F_F, DeviceArrayView<double> dot_F_D2F, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, const unsigned int begin, const unsigned int calculatedNodeNum, int* rowCount, int* colIndex, float* val);
+		__global__ void GenerateSingleNodeLaplacian(const unsigned int depth, InnerProductTableView innerProduct, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, const unsigned int begin, const unsigned int calculatedNodeNum, const float* ScreeningSamples, int* rowCount, int* colIndex, float* val);
 	
 		/**
 		 * \brief 计算获得Laplace矩阵的元素.
 		 * 
-		 * \param dot_F_F 基函数内积元素
-		 * \param dot_F_D2F 基函数二阶导函数内积元素
-		 * \param index 访问基函数点积表的index
+		 * \param innerProduct 基函数紧凑内积表
+		 * \param idxO_1 行节点在x、y、z三个维度的基函数index
+		 * \param idxO_2 列节点在x、y、z三个维度的基函数index
+		 */
+		__device__ double GetLaplacianEntry(const InnerProductTableView& innerProduct, const int* idxO_1, const int* idxO_2);
+
+		/**
+		 * \brief 屏蔽项矩阵元素 α * Σ_k w_k * B_node(c_k) * B_column(c_k)，column为node的第k个邻居.
+		 *        采样c_k取node的27邻居节点(同层)的点重心，只有同时落在node与column支撑内的采样才有贡献.
+		 * 
+		 * \param ScreeningSamples 屏蔽项采样
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
+		 * \param node 行节点
+		 * \param k 列节点是行节点的第k个邻居
+		 */
+		__device__ float GetScreeningEntry(const float* ScreeningSamples, const OctNodeTopologyView& NodeTopology, const int node, const int k);
+
+		/**
+		 * \brief 将稠密点累加到其所在的D层节点：ScreeningPointSum[node] = (Σx, Σy, Σz, 点数).
+		 * 
+		 * \param DensePoints 稠密点
+		 * \param PointToNodeArrayDLevel 稠密点对应的D层节点(相对D层首节点)
+		 * \param DLevelOffset D层首节点在NodeArray中的位置
+		 * \param DenseVertexCount 稠密点数量
+		 * \param ScreeningPointSum 【输出】每个节点的点坐标和与点数，调用前需清零
+		 */
+		__global__ void AccumulateScreeningPointsKernel(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, float4* ScreeningPointSum);
+
+		/**
+		 * \brief 自底向上汇总：当前层节点的点坐标和与点数为其孩子之和.
+		 * 
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
+		 * \param begin 当前层首节点在NodeArray中的位置
+		 * \param calculatedNodeNum 当前层节点数量
+		 * \param ScreeningPointSum 【输入输出】每个节点的点坐标和与点数
+		 */
+		__global__ void AggregateScreeningPointsKernel(OctNodeTopologyView NodeTopology, const unsigned int begin, const unsigned int calculatedNodeNum, float4* ScreeningPointSum);
+
+		/**
+		 * \brief 由节点的点重心计算屏蔽项采样：权重α * 点数 / 总点数，以及重心处节点自身与每一维前后邻居基函数的值.
+		 * 
+		 * \param encodeNodeIndexInFunction 编码节点在基函数中索引
+		 * \param BaseFunctions 基函数
+		 * \param ScreeningPointSum 每个节点的点坐标和与点数
+		 * \param nodeNum 节点总数
+		 * \param weightScale α / 总点数
+		 * \param ScreeningSamples 【输出】屏蔽项采样
+		 */
+		__global__ void ComputeScreeningSamplesKernel(DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const float4* ScreeningPointSum, const unsigned int nodeNum, const float weightScale, float* ScreeningSamples);
+
+		/**
+		 * \brief 依据每行有效元素数量及其排他前缀和，将每个节点27邻居槽位中的有效元素直接写入CSR，替代标记 + cub::DeviceSelect的压缩方式.
+		 * 
+		 * \param rowCount 每个节点有效的Laplace元素个数
+		 * \param RowBaseAddress rowCount的排他前缀和，即CSR的行偏移
+		 * \param colIndex 未压缩的列索引，每个节点占27个槽位，有效元素连续存放在槽位前部
+		 * \param val 未压缩的Laplace元素值，与colIndex对应
+		 * \param nodeNum 当前层节点数量
+		 * \param MergedColIndex 压缩后的列索引(CSR的J)
+		 * \param MergedVal 压缩后的Laplace元素值(CSR的val)
 		 */
-		__device__ double GetLaplacianEntry(DeviceArrayView<double> dot_F_F, DeviceArrayView<double> dot_F_D2F, const int* index);
+		__global__ void CompactLaplacianRows(const int* rowCount, const int* RowBaseAddress, const int* colIndex, const float* val, const unsigned int nodeNum, int* MergedColIndex, float* MergedVal);
 
 		/**
-		 * \brief 标记有效的col列数，小于device::eps会被认为是无效的.
+		 * \brief 级联(cascadic)求解：从当前层节点的右端项中减去更粗层已求得的解的贡献.
+		 *		  沿parent链遍历每个祖先节点的27个邻居，累加跨层Laplace元素 * dx，rhs = Divergence - Σ L(node, coarseNode) * dx[coarseNode].
 		 * 
-		 * \param 传入需要判别的colIndex
-		 * \param 一共有多少列
-		 * \param 传出标志位，true是有效的col
+		 * \param innerProduct 基函数紧凑内积表
+		 * \param encodeNodeIndexInFunction 编码节点在函数中索引
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
+		 * \param dx 已求得的更粗层的解
+		 * \param Divergence 节点散度
+		 * \param begin 当前层首节点在NodeArray中的位置
+		 * \param calculatedNodeNum 当前层节点数量
+		 * \param rhs 【输出】当前层修正后的右端项
 		 */
-		__global__ void markValidColIndex(const int* colIndex, const unsigned int nodeNum, bool* flag);
+		__global__ void SubtractCoarserSolutionKernel(InnerProductTableView innerProduct, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, const float* dx, const float* Divergence, const unsigned int begin, const unsigned int calculatedNodeNum, float* rhs);
+
+		/**
+		 * \brief 记录每个节点的key，供下一帧热启动时匹配节点.
+		 * 
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
+		 * \param nodeNum 节点数量
+		 * \param keys 【输出】节点的key
+		 */
+		__global__ void CollectNodeKeysKernel(OctNodeTopologyView NodeTopology, const unsigned int nodeNum, OctKey* keys);
+
+		/**
+		 * \brief 热启动：将上一帧同一层、相同key节点的解作为当前层CG的初值，没有对应节点的初值为0.
+		 *		  同一层的节点在NodeArray中按key升序排列，因此在上一帧该层的key中二分查找.
+		 * 
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
+		 * \param begin 当前层首节点在NodeArray中的位置
+		 * \param calculatedNodeNum 当前层节点数量
+		 * \param previousKeys 上一帧全部节点的key
+		 * \param previousDx 上一帧的解
+		 * \param previousBegin 上一帧该层首节点的位置
+		 * \param previousNodeNum 上一帧该层节点数量
+		 * \param x 【输出】当前层CG的初值
+		 */
+		__global__ void RemapPreviousSolutionKernel(OctNodeTopologyView NodeTopology, const unsigned int begin, const unsigned int calculatedNodeNum, const OctKey* previousKeys, const float* previousDx, const unsigned int previousBegin, const unsigned int previousNodeNum, float* x);
 
 		/**
 		 * \brief 计算稠密点的隐函数的值.
 		 * 
 		 * \param DensePoints 稠密点
 		 * \param PointToNodeArrayDLevel 从原始稠密sampleOrientedPoints数组中点对应NodeArrayD中node的位置，没有对应的一律写为-1
-		 * \param NodeArray 八叉树节点数组
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
 		 * \param encodeNodeIndexInFunction 编码节点在基函数中索引
 		 * \param BaseFunctions 基函数
 		 * \param DLevelOffset maxDepth层在NodeArray中首节点的位置
 		 * \param DenseVertexCount 稠密点数量
 		 * \param pointsValue 稠密点的隐函数值
 		 */
-		__global__ void CalculatePointsImplicitFunctionValueKernel(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, float* pointsValue);
+		__global__ void CalculatePointsImplicitFunctionValueKernel(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, OctNodeTopologyView NodeTopology, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, DeviceArrayView<float> dx, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, float* pointsValue);
 	}
 
+	/**
+	 * \brief CG求解使用的预条件子类型.
+	 */
+	enum class CGPreconditioner {
+		None = 0,	// 无预条件
+		Jacobi = 1	// 对角Jacobi预条件(对角元取自当前层CSR矩阵)
+	};
+
+	/**
+	 * \brief CG求解的精度策略(仅对显式CSR矩阵生效，无矩阵求解始终为Float).
+	 */
+	enum class SolverPrecision {
+		Float = 0,			// fp32矩阵、向量与乘法，点积以fp64规约
+		FloatRefined = 1,	// 在Float基础上，以fp64累加计算真实残差并做迭代修正
+		HalfStorage = 2		// CSR矩阵元素按层缩放后以fp16存储(SpMV访存减半)，向量、乘法与规约保持fp32/fp64
+	};
+
+	/**
+	 * \brief 拉普拉斯求解器工作区：一个求解通道(cuda流)上CSR组装与CG迭代所需的中间变量，只开辟一次，跨层、跨帧复用，容量不足时按1.5倍几何增长.
+	 */
+	struct LaplacianSolverWorkspace {
+		DeviceBufferArray<int> rowCount;				// 记录当前节点的邻居节点有多少个满足构成Laplace矩阵的元素，大小为N + 2
+		DeviceBufferArray<int> RowBaseAddress;			// rowCount的排他前缀和，大小为N + 2
+		DeviceBufferArray<int> colIndex;				// 未压缩的节点及邻居的列索引，大小为27 * N
+		DeviceBufferArray<float> val;					// 未压缩的节点及邻居的Laplace元素值，大小为27 * N
+		DeviceBufferArray<int> MergedColIndex;			// 压缩后的列索引(CSR的J)
+		DeviceBufferArray<float> MergedVal;				// 压缩后的Laplace元素值(CSR的val)
+		DeviceBufferArray<unsigned char> tempStorage;	// cub算法临时空间
+		DeviceBufferArray<float> cgResidual;			// CG迭代的残差r
+		DeviceBufferArray<float> cgDirection;			// CG迭代的搜索方向p
+		DeviceBufferArray<float> cgAx;					// CG迭代的A * p
+		DeviceBufferArray<double> cgDotResult;			// CG迭代的点积结果
+		DeviceBufferArray<int> cgError;					// CG求解误差统计
+		DeviceBufferArray<int> cgRefineIterations;		// 迭代修正中求解修正量的CG迭代次数
+		DeviceBufferArray<float> cgHalfScale;			// 半精度存储时当前层矩阵元素的缩放(对角元绝对值的最大值)
+		DeviceBufferArray<float> cascadicRhs;			// 级联求解时修正后的右端项
+		DeviceBufferArray<float> cgPreconditionedResidual;	// 预条件CG的z = M^-1 * r
+		DeviceBufferArray<float> cgInverseDiagonal;		// Jacobi预条件子(对角元倒数)
+		DeviceBufferArray<float> cgRefineResidual;		// 迭代修正时以fp64累加得到的真实残差
+		DeviceBufferArray<float> cgRefineCorrection;	// 迭代修正时求得的修正量
+		unsigned int allocationCount = 0;				// 工作区buffer重新开辟的次数，地址改变后已捕获的求解Graph不能直接重放
+
+		/**
+		 * \brief 预先开辟与节点数量线性相关的工作区，27倍邻居相关的工作区按需几何增长.
+		 * 
+		 * \param capacity 预先开辟的节点数量，为0时全部按需开辟
+		 */
+		void AllocateBuffer(const size_t capacity);
+
+		/**
+		 * \brief 释放工作区.
+		 */
+		void ReleaseBuffer();
+
+		/**
+		 * \brief 按节点数量准备工作区，已有容量足够则直接复用.
+		 * 
+		 * \param nodeNum 节点数量
+		 * \param assembleCSR 是否需要组装显式CSR矩阵(无矩阵求解时为false)
+		 */
+		void Prepare(const unsigned int nodeNum, const bool assembleCSR = true);
+
+		/**
+		 * \brief 保证cub临时空间不小于bytes.
+		 * 
+		 * \param bytes 临时空间字节数
+		 */
+		void ReserveTempStorage(const size_t bytes) { reserve(tempStorage, bytes); }
+
+		/**
+		 * \brief 统计工作区当前占用的显存(字节).
+		 */
+		size_t Bytes() const;
+
+	private:
+		/**
+		 * \brief 保证工作区buffer的容量不小于size，不足时按1.5倍重新开辟(工作区无需保留旧数据)，并将Array大小设为size.
+		 * 
+		 * \param buffer 工作区buffer
+		 * \param size 需要的元素数量
+		 */
+		template<typename T>
+		void reserve(DeviceBufferArray<T>& buffer, const size_t size) {
+			if (size > buffer.Capacity()) {
+				buffer.AllocateBuffer(static_cast<size_t>(size * 1.5));
+				allocationCount++;
+			}
+			buffer.ResizeArrayOrException(size);
+		}
+	};
+
 	class LaplacianSolver
 	{
 	public:
-		LaplacianSolver();
+		LaplacianSolver(const ReconstructionConfig& config = ReconstructionConfig());
 
 		~LaplacianSolver();
 
@@ -79,31 +261,31 @@ namespace SparseSurfelFusion {
 
 
 		/**
-		 * \brief 共轭梯度法(CG)求解散度拉普拉斯算子【后续速度优化：1、可加入多线程   2、如果内存可控可以预先开辟内存】.
+		 * \brief 共轭梯度法(CG)求解散度拉普拉斯算子【中间变量均使用预先开辟的工作区，后续速度优化：可加入多线程】.
 		 * 
 		 * \param BaseAddressArray 每层首节点在NodeArray中的偏移
 		 * \param NodeArrayCount 每层的节点数量
 		 * \param encodeNodeIndexInFunction 编码节点在基函数中索引
-		 * \param NodeArray 八叉树节点数组
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
 		 * \param Divergence 节点散度
-		 * \param dot_F_F 基函数内积表
-		 * \param dot_F_D2F 二阶基函数内积表
-		 * \param streams cuda流数组
+		 * \param innerProduct 基函数紧凑内积表
+		 * \param streams cuda流数组，各层的独立系统分发到不同流上并发求解(级联求解时各层相互依赖，只使用streams[0])，结束时streams[0]等待全部层求解完成
+		 * \param streamNum cuda流数量
 		 */
-		void LaplacianCGSolver(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<OctNode> NodeArray, float* Divergence, DeviceArrayView<double> dot_F_F, DeviceArrayView<double> dot_F_D2F, cudaStream_t stream);
+		void LaplacianCGSolver(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, float* Divergence, const InnerProductTableView& innerProduct, cudaStream_t* streams, const unsigned int streamNum);
 
 		/**
 		 * \brief 计算稠密点的隐式函数值.
 		 * 
 		 * \param DensePoints 稠密点
 		 * \param PointToNodeArrayDLevel 从原始稠密sampleOrientedPoints数组中点对应NodeArrayD中node的位置，没有对应的一律写为-1
-		 * \param NodeArray 八叉树节点数组
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
 		 * \param encodeNodeIndexInFunction 编码节点在基函数中索引
 		 * \param BaseFunctions 基函数
 		 * \param DLevelOffset maxDepth层在NodeArray中首节点的位置
 		 * \param DenseVertexCount 稠密点数量
 		 */
-		void CalculatePointsImplicitFunctionValue(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, DeviceArrayView<OctNode> NodeArray, DeviceArrayView<int> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, cudaStream_t stream);
+		void CalculatePointsImplicitFunctionValue(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, OctNodeTopologyView NodeTopology, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, const unsigned int DLevelOffset, const unsigned int DenseVertexCount, cudaStream_t stream);
 
 		/**
 		 * \brief 获得dx.
@@ -119,9 +301,235 @@ namespace SparseSurfelFusion {
 		 */
 		float GetIsoValue() const { return isoValue; }
 
+		/**
+		 * \brief 设置是否使用CUDA Graph模式：全部层的CSR组装与CG求解捕获为一个Graph整体重放，减少逐个核函数的启动开销.
+		 *		  各层节点数量、工作区地址与求解设置均与上一次捕获相同时直接重放已实例化的Graph，不再捕获；
+		 *		  否则重新捕获并以cudaGraphExecUpdate原位更新节点参数，只有拓扑改变时才重新实例化.
+		 *		  协作核函数(CG)的流捕获需要CUDA 12及以上，低于12时该设置无效，退回逐个核函数启动.
+		 *		  计时模式(CHECK_MESH_BUILD_TIME_COST)下求解过程中存在Host同步，无法捕获，该设置同样无效.
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetGraphMode(const bool enable);
+
+		/**
+		 * \brief 设置是否使用级联求解：由粗到细逐层求解，每层的右端项先减去更粗层解的贡献(与原始PoissonRecon一致)，
+		 *		  细层只需求解残差，CG迭代次数更少，但各层只能在同一个流上顺序求解.
+		 *		  关闭时分两趟，每趟内各层互不依赖、在多个流上并发：第一趟独立求解0 ~ maxDepth - 1层，
+		 *		  第二趟每层的右端项减去第一趟更粗层解的贡献后求解全部层.只做一趟(各层完全独立求解再相加)时，
+		 *		  细层窄带之外的隐函数只由粗层决定，球内的函数值与等值相差很小，在较粗的叶子中产生伪零点与朝内的碎片.
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetCascadicMode(const bool enable) { cascadicMode = enable; }
+
+		/**
+		 * \brief 设置CG求解使用的预条件子，可在运行时切换.
+		 * 
+		 * \param type 预条件子类型
+		 */
+		void SetPreconditioner(const CGPreconditioner type) { preconditioner = type; }
+
+		/**
+		 * \brief 下载上一帧每一层CG求解的实际迭代次数【阻塞Host】.
+		 * 
+		 * \param iterations 【输出】下标为层数的迭代次数
+		 */
+		void GetCGIterations(std::vector<int>& iterations) const { cgIterations.ArrayView().Download(iterations); }
+
+		/**
+		 * \brief 下载上一帧每一层CG结束时的残差平方r·r【阻塞Host】，FloatRefined时为迭代修正后以fp64计算的真实残差.
+		 * 
+		 * \param residuals 【输出】下标为层数的残差平方
+		 */
+		void GetCGResiduals(std::vector<double>& residuals) const { cgResiduals.ArrayView().Download(residuals); }
+
+		/**
+		 * \brief 设置阶段计时器，每一层的组装与CG求解分别计时；Graph模式下只计时整个求解.
+		 * 
+		 * \param stageProfiler 计时器，为NULL时不计时
+		 */
+		void SetProfiler(StageProfiler* stageProfiler) { profiler = stageProfiler; }
+
+		/**
+		 * \brief 设置是否热启动：保留上一帧的解与节点key，下一帧CG从按key映射后的上一帧解开始迭代，静态场景下迭代次数大幅减少.
+		 * 
+		 * \param enable 是否开启，关闭时丢弃已保留的上一帧
+		 */
+		void SetWarmStart(const bool enable) { warmStart = enable; if (!enable) hasPreviousFrame = false; }
+
+		/**
+		 * \brief 设置是否使用无矩阵(matrix-free)的Laplace算子：不组装CSR，CG每次乘法时由点积表和27邻居现场计算矩阵元素，
+		 *		  省去27 * N的CSR内存(深层八叉树时最大的临时内存)，以计算换访存.
+		 * 
+		 * \param enable 是否开启
+		 */
+		void SetMatrixFree(const bool enable) { matrixFree = enable; }
+
+		/**
+		 * \brief 设置CG求解的精度策略，可在运行时切换.
+		 * 
+		 * \param type 精度策略
+		 * \param refinementSteps FloatRefined时迭代修正的次数(固定次数，不需要Host读回残差)
+		 */
+		void SetPrecision(const SolverPrecision type, const int refinementSteps = 2) { precision = type; this->refinementSteps = refinementSteps; }
+
+		/**
+		 * \brief 设置是否使用屏蔽泊松(screened Poisson)：每层系统矩阵加上点插值项 α * Σ_p w_p * B_i(p) * B_j(p)，
+		 *        使隐函数在采样点处趋于0，系统条件数更好，CG迭代次数更少.采样为每个节点内点的重心，权重为点数占比.
+		 *        级联求解时跨层的屏蔽项忽略，只修正Laplace项.
+		 * 
+		 * \param enable 是否开启
+		 * \param weight 屏蔽项权重α
+		 */
+		void SetScreening(const bool enable, const float weight = 4.0f) { screening = enable; screeningWeight = weight; }
+
+		/**
+		 * \brief 屏蔽泊松开启时，由稠密点计算每个节点的屏蔽项采样【无阻塞】，需在LaplacianCGSolver之前调用；未开启时直接返回.
+		 * 
+		 * \param DensePoints 稠密点
+		 * \param PointToNodeArrayDLevel 稠密点对应的D层节点(相对D层首节点)
+		 * \param BaseAddressArray 每层首节点在NodeArray中的偏移
+		 * \param NodeArrayCount 每层的节点数量
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
+		 * \param encodeNodeIndexInFunction 编码节点在基函数中索引
+		 * \param BaseFunctions 基函数
+		 * \param stream cuda流
+		 */
+		void PrepareScreeningSamples(DeviceArrayView<OrientedPoint3D<float>> DensePoints, DeviceArrayView<int> PointToNodeArrayDLevel, const int* BaseAddressArray, const int* NodeArrayCount, OctNodeTopologyView NodeTopology, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, DeviceArrayView<ConfirmedPPolynomial<CONVTIMES + 1, CONVTIMES + 2>> BaseFunctions, cudaStream_t stream);
+
+		/**
+		 * \brief 获得求解器工作区曾达到的最大显存占用(字节)，包括各通道工作区、每层CG的迭代次数与残差、屏蔽项采样，与编译选项无关.
+		 * 
+		 * \return 工作区显存最高水位
+		 */
+		size_t GetWorkspaceHighWaterMark() const { return workspaceHighWaterMark; }
+
+		/**
+		 * \brief 设置预览层：求解压入该层(及更粗的层)后在对应通道上记录事件，供预览网格提取在另一条流上等待，
+		 *        不必等到全部层求解完成.Graph模式下以外部事件节点记录.
+		 *
+		 * \param depth 预览层，小于0时不记录
+		 */
+		void SetPreviewDepth(const int depth) { previewDepth = depth; }
+
+		/**
+		 * \brief 令stream等待预览层及更粗层的求解完成【无阻塞】，需在LaplacianCGSolver之后调用；未设置预览层时直接返回.
+		 *
+		 * \param stream 等待的流
+		 */
+		void WaitPreviewDepthSolved(cudaStream_t stream);
+
 	private:
 		//std::shared_ptr<ThreadPool> pool;
 		DeviceBufferArray<float> dx;	// 散度的Laplace迭代后的解
+		DeviceBufferArray<float> coarseDx;	// 非级联求解第一趟(0 ~ maxDepth - 1层独立求解)的解，第二趟作为粗层解读取
+
+		LaplacianSolverWorkspace workspace[MAX_MESH_STREAM];	// 每个求解通道(cuda流)独立的工作区，通道0预先开辟
+		DeviceBufferArray<int> cgIterations;			// 每一层CG的实际迭代次数，大小为maxDepth + 1
+		DeviceBufferArray<double> cgResiduals;			// 每一层CG结束时的r·r，大小为maxDepth + 1
+		StageProfiler* profiler = NULL;					// 阶段计时器
+		bool capturingGraph = false;					// 正在捕获求解Graph，捕获期间不记录计时事件
+
+		size_t workspaceHighWaterMark = 0;				// 工作区显存最高水位(字节)
+
+		bool warmStart = false;							// 是否使用上一帧的解热启动
+		bool hasPreviousFrame = false;					// 是否已保留上一帧
+		DeviceBufferArray<OctKey> previousKeys;			// 上一帧全部节点的key
+		DeviceBufferArray<float> previousDx;			// 上一帧的解
+		int previousBaseAddress[MAX_DEPTH_OCTREE + 1];	// 上一帧每层首节点的位置
+		int previousNodeCount[MAX_DEPTH_OCTREE + 1];	// 上一帧每层节点数量
+
+		bool cascadicMode = false;						// 是否使用级联求解
+		bool screening = false;							// 是否使用屏蔽泊松
+		float screeningWeight = 4.0f;					// 屏蔽项权重α
+		DeviceBufferArray<float4> ScreeningPointSum;	// 每个节点内点的坐标和与点数
+		DeviceBufferArray<float> ScreeningSamples;		// 每个节点的屏蔽项采样，SCREENING_SAMPLE_STRIDE个float
+		bool matrixFree = false;						// 是否使用无矩阵Laplace算子
+		CGPreconditioner preconditioner = CGPreconditioner::None;	// CG预条件子类型
+		SolverPrecision precision = SolverPrecision::Float;			// CG求解的精度策略
+		int refinementSteps = 2;						// FloatRefined时迭代修正的次数
+		bool graphMode = false;							// 是否使用CUDA Graph捕获、重放求解过程
+		cudaGraphExec_t solverGraphExec = NULL;			// 已实例化的求解Graph，拓扑不变时仅更新节点参数
+		std::vector<uintptr_t> solverGraphSignature;	// 捕获solverGraphExec时的全部输入(节点数量、地址、设置)，不变时跳过捕获
+
+		/**
+		 * \brief 将全部层的CSR组装与CG求解压入stream，过程中不阻塞Host，也不开辟内存(工作区须已准备好).
+		 * 
+		 * \param BaseAddressArray 每层首节点在NodeArray中的偏移
+		 * \param NodeArrayCount 每层的节点数量
+		 * \param encodeNodeIndexInFunction 编码节点在基函数中索引
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
+		 * \param Divergence 节点散度
+		 * \param innerProduct 基函数紧凑内积表
+		 * \param streams cuda流数组，streams[0]为主流，其余流在开始前等待主流、结束后主流等待其余流
+		 * \param laneNum 使用的求解通道(流)数量，为1时全部层在streams[0]上顺序求解
+		 */
+		void enqueueLaplacianSolve(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, float* Divergence, const InnerProductTableView& innerProduct, cudaStream_t* streams, const unsigned int laneNum);
+
+		/**
+		 * \brief 在depth层所在的通道上压入该层的CSR组装与CG求解.
+		 * 
+		 * \param depth 层数
+		 * \param coarserSolution 右端项减去其中更粗层解的贡献，NULL表示直接以散度为右端项
+		 * \param solution 【输出】解(dx或coarseDx)，只有写入dx时使用热启动
+		 * 其余参数与enqueueLaplacianSolve相同
+		 */
+		void enqueueDepthSolve(const int depth, const float* coarserSolution, float* solution, const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, OctNodeTopologyView NodeTopology, float* Divergence, const InnerProductTableView& innerProduct, cudaStream_t* streams, const unsigned int laneNum);
+
+		/**
+		 * \brief 分发：通道1 ~ laneNum - 1等待streams[0]上已压入的任务.
+		 */
+		void forkSolverLanes(cudaStream_t* streams, const unsigned int laneNum);
+
+		/**
+		 * \brief 汇合：streams[0]等待其余通道上已压入的任务.
+		 */
+		void joinSolverLanes(cudaStream_t* streams, const unsigned int laneNum);
+
+		/**
+		 * \brief 层到求解通道的映射：最细层独占通道0，其余层轮流分配，粗层的小规模系统共享通道.
+		 * 
+		 * \param depth 层数
+		 * \param laneNum 求解通道数量
+		 * \return 求解通道
+		 */
+		unsigned int solverLane(const int depth, const unsigned int laneNum) const { return (Constants::maxDepth_Host - depth) % laneNum; }
+
+		cudaEvent_t forkEvent = NULL;					// 主流分发各层求解的事件
+		cudaEvent_t joinEvents[MAX_MESH_STREAM];		// 各通道求解完成的事件
+
+		int previewDepth = -1;							// 预览层，小于0表示不记录预览事件
+		unsigned int previewLaneMask = 0;				// 本帧求解过预览层及更粗层的通道
+		cudaEvent_t previewEvents[MAX_MESH_STREAM];		// 各通道完成预览层及更粗层求解的事件
+
+		/**
+		 * \brief 收集决定求解Graph内容的全部输入：每层节点数量与偏移、热启动的上一帧信息、工作区与输入输出地址、流与求解设置.
+		 *        与solverGraphSignature相同时，重新捕获得到的Graph与已实例化的完全一致.
+		 * 
+		 * \param BaseAddressArray 每层首节点在NodeArray中的偏移
+		 * \param NodeArrayCount 每层的节点数量
+		 * \param encodeNodeIndexInFunction 编码节点在基函数中索引
+		 * \param NodeTopology 八叉树节点拓扑(SoA)视图
+		 * \param Divergence 节点散度
+		 * \param innerProduct 基函数紧凑内积表
+		 * \param streams cuda流数组
+		 * \param laneNum 使用的求解通道(流)数量
+		 * \param signature 【输出】求解Graph的输入
+		 */
+		void collectGraphSignature(const int* BaseAddressArray, const int* NodeArrayCount, DeviceArrayView<EncodedFunctionIndex> encodeNodeIndexInFunction, const OctNodeTopologyView& NodeTopology, const float* Divergence, const InnerProductTableView& innerProduct, cudaStream_t* streams, const unsigned int laneNum, std::vector<uintptr_t>& signature) const;
+
+		/**
+		 * \brief 用新捕获的graph更新已实例化的solverGraphExec，拓扑改变而无法更新时重新实例化.
+		 * 
+		 * \param graph 新捕获的graph
+		 */
+		void updateSolverGraphExec(cudaGraph_t graph);
+
+		/**
+		 * \brief 统计所有通道工作区、CG迭代次数与残差、屏蔽项采样的当前容量，更新显存最高水位.
+		 */
+		void updateWorkspaceHighWaterMark();
 
 		DeviceBufferArray<float> DensePointsImplicitFunctionValue;	// 稠密点隐函数值
 
@@ -0,0 +1,164 @@
+/*****************************************************************//**
+ * \file   CpuReconstructionTest.cpp
+ * \brief  CPU后端的回归测试：法线朝外的球面点云分别用非级联与级联模式重建，检查网格的闭合性、朝向、
+ *         到球面的距离，以及隐式函数在球面内外两侧的符号(CompareImplicitFunction与理想的内外符号比较)
+ *
+ * \author LUOJIAXUAN
+ * \date   June 20th 2024
+ *********************************************************************/
+#include <cmath>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <mesh/cpu/CpuPoissonReconstruction.h>
+
+using namespace SparseSurfelFusion;
+
+namespace {
+	const unsigned int SpherePointsNum = 100000;	// 球面采样点数
+	const unsigned int ProbeDirectionsNum = 2000;	// 内外符号检查的方向数
+	const float SphereRadius = 2.0f;				// 球半径
+	const float SphereCenter[3] = { 1.0f, -0.5f, 0.25f };	// 球心，不与归一化中心重合
+	const float ProbeOffset = 0.05f;				// 检查点距球面的相对距离，0.05R约为maxDepth层单元宽度的2.5倍
+
+	/**
+	 * \brief 两种求解模式共用的误差上界，取实测值(见提交记录)并留出余量：网格应闭合且朝向一致.
+	 *        八叉树只在采样点附近细分，远离球面的内部隐式函数不可靠，因此内外符号只在球面两侧各0.05R处检查.
+	 */
+	struct MeshBounds {
+		float boundaryEdgeRatio;		// 只属于一个三角形的边占所有边的比例
+		float inwardTriangleRatio;		// 法线朝向球心的三角形比例
+		float meanDistance;				// 顶点到球面的平均距离(原坐标)
+		float maxDistance;				// 顶点到球面的最大距离(原坐标)
+		float signMismatchRatio;		// 检查点内外符号错误的比例
+	};
+
+	const MeshBounds Bounds = { 0.0f, 0.001f, 0.005f, 0.04f, 0.01f };	// 最大距离不超过maxDepth层单元宽度(5 / 128)
+
+	/**
+	 * \brief 单位球面上按Fibonacci螺旋均匀分布的第i个方向.
+	 */
+	Point3D<float> fibonacciDirection(const unsigned int i, const unsigned int num)
+	{
+		const float goldenAngle = 3.14159265358979f * (3.0f - sqrtf(5.0f));
+		const float y = 1.0f - 2.0f * (i + 0.5f) / num;
+		const float r = sqrtf(1.0f - y * y);
+		const float theta = goldenAngle * i;
+		return Point3D<float>(r * cosf(theta), y, r * sinf(theta));
+	}
+
+	Point3D<float> pointOnSphere(const Point3D<float>& direction, const float radius)
+	{
+		return Point3D<float>(SphereCenter[0] + radius * direction.coords[0], SphereCenter[1] + radius * direction.coords[1], SphereCenter[2] + radius * direction.coords[2]);
+	}
+
+	float distanceToCenter(const Point3D<float>& point)
+	{
+		const float x = point.coords[0] - SphereCenter[0], y = point.coords[1] - SphereCenter[1], z = point.coords[2] - SphereCenter[2];
+		return sqrtf(x * x + y * y + z * z);
+	}
+
+	/**
+	 * \brief 重建一次并检查网格与隐式函数，返回超出上界的项数.
+	 */
+	int checkReconstruction(const std::vector<Point3D<float>>& points, const std::vector<Point3D<float>>& normals, const bool cascadic, const MeshBounds& bounds)
+	{
+		cpu::CpuPoissonReconstruction reconstruction;
+		reconstruction.SetCascadicMode(cascadic);
+		reconstruction.SolvePoissionReconstructionMesh(points, normals);
+
+		// 顶点是归一化坐标，还原到原坐标后再与球面比较
+		const Point3D<float> center = reconstruction.GetNormalizeCenter();
+		const float maxEdge = reconstruction.GetNormalizeMaxEdge();
+		const std::vector<Point3D<float>>& normalizedVertices = reconstruction.GetRebuildMeshVertices();
+		const std::vector<TriangleIndex>& triangles = reconstruction.GetRebuildMeshTriangleIndices();
+		std::vector<Point3D<float>> vertices(normalizedVertices.size());
+		double distanceSum = 0.0;
+		float maxDistance = 0.0f;
+		for (size_t i = 0; i < vertices.size(); i++) {
+			for (int j = 0; j < 3; j++) vertices[i].coords[j] = normalizedVertices[i].coords[j] * maxEdge + center.coords[j];
+			const float distance = fabsf(distanceToCenter(vertices[i]) - SphereRadius);
+			distanceSum += distance;
+			maxDistance = std::max(maxDistance, distance);
+		}
+
+		// 边按(较小顶点, 较大顶点)计数：闭合流形网格的每条边恰好属于两个三角形
+		std::map<std::pair<int, int>, int> edgeCount;
+		int inwardTriangles = 0;
+		for (size_t t = 0; t < triangles.size(); t++) {
+			const int* idx = triangles[t].idx;
+			for (int j = 0; j < 3; j++) {
+				const int a = idx[j], b = idx[(j + 1) % 3];
+				edgeCount[std::make_pair(std::min(a, b), std::max(a, b))]++;
+			}
+			const Point3D<float>& p0 = vertices[idx[0]];
+			const Point3D<float>& p1 = vertices[idx[1]];
+			const Point3D<float>& p2 = vertices[idx[2]];
+			float e1[3], e2[3], radial[3];
+			for (int j = 0; j < 3; j++) {
+				e1[j] = p1.coords[j] - p0.coords[j];
+				e2[j] = p2.coords[j] - p0.coords[j];
+				radial[j] = (p0.coords[j] + p1.coords[j] + p2.coords[j]) / 3.0f - SphereCenter[j];
+			}
+			const float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			if (normal[0] * radial[0] + normal[1] * radial[1] + normal[2] * radial[2] < 0.0f) inwardTriangles++;
+		}
+		int boundaryEdges = 0, nonManifoldEdges = 0;
+		for (std::map<std::pair<int, int>, int>::const_iterator it = edgeCount.begin(); it != edgeCount.end(); ++it) {
+			if (it->second == 1) boundaryEdges++;
+			else if (it->second > 2) nonManifoldEdges++;
+		}
+
+		// 球面内外两侧的检查点：理想的隐式函数值 - 等值在内侧为负、外侧为正
+		std::vector<Point3D<float>> probes;
+		std::vector<float> expected;
+		for (unsigned int i = 0; i < ProbeDirectionsNum; i++) {
+			const Point3D<float> direction = fibonacciDirection(i, ProbeDirectionsNum);
+			probes.push_back(pointOnSphere(direction, (1.0f - ProbeOffset) * SphereRadius));
+			expected.push_back(-1.0f);
+			probes.push_back(pointOnSphere(direction, (1.0f + ProbeOffset) * SphereRadius));
+			expected.push_back(1.0f);
+		}
+		std::vector<float> values;
+		reconstruction.QueryImplicitFunction(probes, values);
+		const cpu::ImplicitFunctionComparison comparison = cpu::CpuPoissonReconstruction::CompareImplicitFunction(values, expected);
+
+		const float edgeNum = float(std::max<size_t>(edgeCount.size(), 1));
+		const float triangleNum = float(std::max<size_t>(triangles.size(), 1));
+		const float boundaryEdgeRatio = boundaryEdges / edgeNum;
+		const float inwardTriangleRatio = inwardTriangles / triangleNum;
+		const float meanDistance = vertices.empty() ? 0.0f : float(distanceSum / vertices.size());
+		std::cout << (cascadic ? "级联" : "非级联") << "：顶点 = " << vertices.size() << "   三角形 = " << triangles.size()
+			<< "   边界边 = " << boundaryEdges << "(" << boundaryEdgeRatio * 100.0f << "%)   非流形边 = " << nonManifoldEdges
+			<< "   朝内三角形 = " << inwardTriangles << "(" << inwardTriangleRatio * 100.0f << "%)" << std::endl;
+		std::cout << "      到球面的平均距离 = " << meanDistance << "   最大距离 = " << maxDistance
+			<< "   内外符号错误 = " << comparison.signMismatchRatio * 100.0f << "%" << std::endl;
+
+		int failed = 0;
+		if (triangles.empty()) { std::cout << "      网格为空" << std::endl; failed++; }
+		if (nonManifoldEdges > 0) { std::cout << "      存在非流形边" << std::endl; failed++; }
+		if (boundaryEdgeRatio > bounds.boundaryEdgeRatio) { std::cout << "      边界边比例超过 " << bounds.boundaryEdgeRatio * 100.0f << "%" << std::endl; failed++; }
+		if (inwardTriangleRatio > bounds.inwardTriangleRatio) { std::cout << "      朝内三角形比例超过 " << bounds.inwardTriangleRatio * 100.0f << "%" << std::endl; failed++; }
+		if (meanDistance > bounds.meanDistance) { std::cout << "      平均距离超过 " << bounds.meanDistance << std::endl; failed++; }
+		if (maxDistance > bounds.maxDistance) { std::cout << "      最大距离超过 " << bounds.maxDistance << std::endl; failed++; }
+		if (comparison.signMismatchRatio > bounds.signMismatchRatio) { std::cout << "      内外符号错误比例超过 " << bounds.signMismatchRatio * 100.0f << "%" << std::endl; failed++; }
+		return failed;
+	}
+}
+
+int main()
+{
+	std::vector<Point3D<float>> points(SpherePointsNum), normals(SpherePointsNum);
+	for (unsigned int i = 0; i < SpherePointsNum; i++) {
+		normals[i] = fibonacciDirection(i, SpherePointsNum);
+		points[i] = pointOnSphere(normals[i], SphereRadius);
+	}
+
+	int failed = 0;
+	failed += checkReconstruction(points, normals, false, Bounds);
+	failed += checkReconstruction(points, normals, true, Bounds);
+	std::cout << "CpuReconstructionTest: " << (failed == 0 ? "通过" : "失败") << std::endl;
+	return failed == 0 ? 0 : 1;
+}
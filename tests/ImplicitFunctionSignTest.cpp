@@ -0,0 +1,96 @@
+/*****************************************************************//**
+ * \file   ImplicitFunctionSignTest.cpp
+ * \brief  固定QueryImplicitFunction的符号约定：法线朝外的球面点云重建后，球面内侧的隐式函数值 - 等值小于0，外侧大于0.
+ *         八叉树只在采样点附近细分到maxDepth层，远离球面(如球心)的符号由粗层决定、不可靠，因此只在球面两侧各一个maxDepth层单元宽度处检查
+ *
+ * \author LUOJIAXUAN
+ * \date   June 20th 2024
+ *********************************************************************/
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <mesh/PoissonReconstruction.h>
+
+using namespace SparseSurfelFusion;
+
+namespace {
+	const unsigned int SpherePointsNum = 100000;	// 球面采样点数
+	const float SphereRadius = 2.0f;				// 球半径
+	const float SphereCenter[3] = { 1.0f, -0.5f, 0.25f };	// 球心，不与归一化中心重合
+	const float CellWidth = 1.25f * 2.0f * SphereRadius / (1 << MAX_DEPTH_OCTREE);	// maxDepth层单元宽度：包围盒最长边2R按BuildOctree放缩1.25倍后等分
+
+	/**
+	 * \brief 在球面上按Fibonacci螺旋均匀采样面元，法线朝外.
+	 */
+	std::vector<DepthSurfel> sampleSphere(const unsigned int num, const float radius)
+	{
+		std::vector<DepthSurfel> surfels(num);
+		const float goldenAngle = 3.14159265358979f * (3.0f - sqrtf(5.0f));
+		for (unsigned int i = 0; i < num; i++) {
+			const float y = 1.0f - 2.0f * (i + 0.5f) / num;
+			const float r = sqrtf(1.0f - y * y);
+			const float theta = goldenAngle * i;
+			const float normal[3] = { r * cosf(theta), y, r * sinf(theta) };
+			DepthSurfel& surfel = surfels[i];
+			surfel.pixelCoordinate = PixelCoordinate();
+			surfel.VertexAndConfidence = make_float4(SphereCenter[0] + radius * normal[0], SphereCenter[1] + radius * normal[1], SphereCenter[2] + radius * normal[2], 1.0f);
+			surfel.NormalAndRadius = make_float4(normal[0], normal[1], normal[2], 0.0f);
+			surfel.ColorAndTime = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+		return surfels;
+	}
+
+	/**
+	 * \brief 沿三个坐标轴正负方向，在球心距离为distance处取6个点.
+	 */
+	void appendAxisPoints(const float distance, std::vector<Point3D<float>>& points)
+	{
+		for (int axis = 0; axis < 3; axis++) {
+			for (int sign = -1; sign <= 1; sign += 2) {
+				Point3D<float> point(SphereCenter[0], SphereCenter[1], SphereCenter[2]);
+				point.coords[axis] += sign * distance;
+				points.push_back(point);
+			}
+		}
+	}
+}
+
+int main()
+{
+	ReconstructionConfig config = ReconstructionConfig::FromPointCount(SpherePointsNum);
+	config.enableRender = false;
+	CHECKCUDA(cudaSetDevice(config.deviceId));
+
+	const std::vector<DepthSurfel> surfels = sampleSphere(SpherePointsNum, SphereRadius);
+	DeviceArray<DepthSurfel> surfelsDevice;
+	surfelsDevice.upload(surfels);
+
+	PoissonReconstruction reconstruction(config);
+	reconstruction.SolvePoissionReconstructionMesh(DeviceArrayView<DepthSurfel>(surfelsDevice));
+	CHECKCUDA(cudaDeviceSynchronize());
+
+	std::vector<Point3D<float>> insidePoints, outsidePoints;
+	// 距球面一个单元宽度：超出等值面在单元内的位置误差，又在采样点所在maxDepth层节点的基函数支撑(1.5倍单元宽度)之内
+	appendAxisPoints(SphereRadius - CellWidth, insidePoints);
+	appendAxisPoints(SphereRadius + CellWidth, outsidePoints);
+
+	std::vector<float> insideValues, outsideValues;
+	reconstruction.QueryImplicitFunction(insidePoints, insideValues);
+	reconstruction.QueryImplicitFunction(outsidePoints, outsideValues);
+
+	int failed = 0;
+	for (size_t i = 0; i < insideValues.size(); i++) {
+		if (!(insideValues[i] < 0.0f)) {
+			std::cout << "球内点 " << i << " 的隐式函数值 - 等值 = " << insideValues[i] << "，应小于0" << std::endl;
+			failed++;
+		}
+	}
+	for (size_t i = 0; i < outsideValues.size(); i++) {
+		if (!(outsideValues[i] > 0.0f)) {
+			std::cout << "球外点 " << i << " 的隐式函数值 - 等值 = " << outsideValues[i] << "，应大于0" << std::endl;
+			failed++;
+		}
+	}
+	std::cout << "ImplicitFunctionSignTest: " << (failed == 0 ? "通过" : "失败") << std::endl;
+	return failed == 0 ? 0 : 1;
+}